@@ -0,0 +1,216 @@
+/**
+ * @file bench_codecs.c
+ * @brief Channel codec benchmarks (PackBits and ZIP)
+ *
+ * The inputs are one channel plane with the mix of flat runs and noisy
+ * stretches seen in real artwork, encoded the way Photoshop does: PackBits
+ * per row for RLE, zlib for ZIP, and 16-bit deltas before zlib for ZIP
+ * with prediction.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "openpsd_bench.h"
+#include "psd_rle.h"
+#include "psd_zip.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(OPENPSD_BENCH_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+/* Deterministic plane: runs of one value broken up by noise */
+static void fill_plane(uint8_t *plane, size_t size)
+{
+    uint32_t seed = 0x2545F491u;
+    size_t i = 0;
+    uint8_t level = 128;
+    while (i < size) {
+        seed = seed * 1664525u + 1013904223u;
+        size_t run = 1 + ((seed >> 16) & 63u);
+        bool flat = (seed >> 8) & 1u;
+        level = (uint8_t)(level + (int8_t)(seed >> 24) / 8);
+        for (size_t j = 0; j < run && i < size; j++, i++) {
+            if (flat) {
+                plane[i] = level;
+            } else {
+                seed = seed * 1664525u + 1013904223u;
+                plane[i] = (uint8_t)(level + ((seed >> 24) & 15u));
+            }
+        }
+    }
+}
+
+/* PackBits one row into dst (at least row_bytes + row_bytes / 128 + 1) */
+static size_t packbits_row(const uint8_t *src, size_t row_bytes, uint8_t *dst)
+{
+    size_t in = 0, out = 0;
+    while (in < row_bytes) {
+        size_t run = 1;
+        while (in + run < row_bytes && run < 128 && src[in + run] == src[in]) run++;
+        if (run >= 2) {
+            dst[out++] = (uint8_t)(257 - run);
+            dst[out++] = src[in];
+            in += run;
+            continue;
+        }
+        size_t start = in, count = 0;
+        while (in < row_bytes && count < 128 &&
+               !(in + 1 < row_bytes && src[in + 1] == src[in])) {
+            in++;
+            count++;
+        }
+        dst[out++] = (uint8_t)(count - 1);
+        memcpy(dst + out, src + start, count);
+        out += count;
+    }
+    return out;
+}
+
+typedef struct {
+    const uint8_t *compressed;
+    size_t compressed_len;
+    size_t rows;
+    size_t row_bytes;
+    uint8_t *out;
+    psd_zip_pool_t *pool;
+} codec_state_t;
+
+static psd_status_t op_rle_decode(void *state)
+{
+    codec_state_t *s = (codec_state_t *)state;
+    size_t out_len = 0;
+    return psd_rle_decode(s->compressed, s->compressed_len, s->rows, s->row_bytes, s->out,
+                          &out_len);
+}
+
+#if defined(OPENPSD_BENCH_HAVE_ZLIB)
+static psd_status_t op_zip_decompress(void *state)
+{
+    codec_state_t *s = (codec_state_t *)state;
+    return psd_zip_decompress(s->compressed, s->compressed_len, s->out, s->rows * s->row_bytes,
+                              NULL, s->pool);
+}
+
+static psd_status_t op_zip_decompress_predicted(void *state)
+{
+    codec_state_t *s = (codec_state_t *)state;
+    return psd_zip_decompress_with_prediction(s->compressed, s->compressed_len, s->out,
+                                              s->rows * s->row_bytes, s->row_bytes, 2, NULL,
+                                              s->pool);
+}
+
+/* zlib-compress src; NULL on failure */
+static uint8_t *deflate_plane(const uint8_t *src, size_t size, size_t *out_len)
+{
+    uLongf len = compressBound((uLong)size);
+    uint8_t *dst = (uint8_t *)malloc(len);
+    if (dst && compress2(dst, &len, src, (uLong)size, 6) != Z_OK) {
+        free(dst);
+        return NULL;
+    }
+    *out_len = (size_t)len;
+    return dst;
+}
+#endif
+
+static void bench_rle(bench_runner_t *runner, const uint8_t *plane, size_t rows,
+                      size_t row_bytes, uint8_t *out)
+{
+    const char *name = "codec/rle_decode";
+    if (!bench_wanted(runner, name)) return;
+
+    uint8_t *rle = (uint8_t *)malloc(rows * (row_bytes + row_bytes / 128 + 1));
+    if (!rle) return;
+    size_t length = 0;
+    for (size_t y = 0; y < rows; y++) {
+        length += packbits_row(plane + y * row_bytes, row_bytes, rle + length);
+    }
+
+    codec_state_t state = { rle, length, rows, row_bytes, out, NULL };
+    bench_run(runner, name, rows * row_bytes, op_rle_decode, &state);
+    free(rle);
+}
+
+static void bench_zip(bench_runner_t *runner, const uint8_t *plane, size_t rows,
+                      size_t row_bytes, uint8_t *out)
+{
+    const char *plain = "codec/zip_decompress";
+    const char *predicted = "codec/zip_decompress_prediction16";
+#if defined(OPENPSD_BENCH_HAVE_ZLIB)
+    size_t size = rows * row_bytes;
+    psd_zip_pool_t pool;
+    psd_zip_pool_init(&pool, NULL);
+
+    if (bench_wanted(runner, plain)) {
+        size_t length = 0;
+        uint8_t *zip = deflate_plane(plane, size, &length);
+        if (zip) {
+            codec_state_t state = { zip, length, rows, row_bytes, out, &pool };
+            bench_run(runner, plain, size, op_zip_decompress, &state);
+        }
+        free(zip);
+    }
+
+    if (bench_wanted(runner, predicted)) {
+        /* The plane read as big-endian 16-bit samples, delta-coded per row */
+        uint8_t *delta = (uint8_t *)malloc(size);
+        if (delta) {
+            for (size_t y = 0; y < rows; y++) {
+                const uint8_t *src = plane + y * row_bytes;
+                uint8_t *dst = delta + y * row_bytes;
+                uint16_t previous = 0;
+                for (size_t x = 0; x + 1 < row_bytes; x += 2) {
+                    uint16_t sample = (uint16_t)((src[x] << 8) | src[x + 1]);
+                    uint16_t d = (uint16_t)(sample - previous);
+                    dst[x] = (uint8_t)(d >> 8);
+                    dst[x + 1] = (uint8_t)d;
+                    previous = sample;
+                }
+            }
+            size_t length = 0;
+            uint8_t *zip = deflate_plane(delta, size, &length);
+            if (zip) {
+                codec_state_t state = { zip, length, rows, row_bytes, out, &pool };
+                bench_run(runner, predicted, size, op_zip_decompress_predicted, &state);
+            }
+            free(zip);
+            free(delta);
+        }
+    }
+
+    psd_zip_pool_destroy(&pool);
+#else
+    (void)plane;
+    (void)rows;
+    (void)row_bytes;
+    (void)out;
+    bench_skip(runner, plain, "built without zlib");
+    bench_skip(runner, predicted, "built without zlib");
+#endif
+}
+
+void bench_codecs(bench_runner_t *runner)
+{
+    size_t side = bench_quick(runner) ? 256 : 2048;
+    size_t size = side * side;
+    uint8_t *plane = (uint8_t *)malloc(size);
+    uint8_t *out = (uint8_t *)malloc(size);
+    if (plane && out) {
+        fill_plane(plane, size);
+        bench_rle(runner, plane, side, side, out);
+        bench_zip(runner, plane, side, side, out);
+    }
+    free(plane);
+    free(out);
+}
@@ -0,0 +1,202 @@
+/**
+ * @file bench_descriptor.c
+ * @brief ActionDescriptor parsing benchmark
+ *
+ * The input is shaped like the descriptors of text and effect blocks: a
+ * few scalar properties, a bounds object of unit floats, and a long list of
+ * style objects that each nest a color object.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "openpsd_bench.h"
+#include "psd_descriptor.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    bool failed;
+} byte_writer_t;
+
+static void put_bytes(byte_writer_t *w, const void *bytes, size_t length)
+{
+    if (w->failed) return;
+    if (w->size + length > w->capacity) {
+        size_t capacity = w->capacity ? w->capacity * 2 : 4096;
+        while (capacity < w->size + length) capacity *= 2;
+        uint8_t *data = (uint8_t *)realloc(w->data, capacity);
+        if (!data) {
+            w->failed = true;
+            return;
+        }
+        w->data = data;
+        w->capacity = capacity;
+    }
+    memcpy(w->data + w->size, bytes, length);
+    w->size += length;
+}
+
+static void put_u32(byte_writer_t *w, uint32_t v)
+{
+    uint8_t b[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+    put_bytes(w, b, 4);
+}
+
+static void put_f64(byte_writer_t *w, double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put_u32(w, (uint32_t)(bits >> 32));
+    put_u32(w, (uint32_t)bits);
+}
+
+/* Unicode string: length in code units, then UTF-16BE */
+static void put_unicode(byte_writer_t *w, const char *ascii)
+{
+    size_t length = strlen(ascii);
+    put_u32(w, (uint32_t)length);
+    for (size_t i = 0; i < length; i++) {
+        uint8_t unit[2] = { 0, (uint8_t)ascii[i] };
+        put_bytes(w, unit, 2);
+    }
+}
+
+/* Key or class ID: four-character codes use the zero-length form */
+static void put_id(byte_writer_t *w, const char *id)
+{
+    size_t length = strlen(id);
+    put_u32(w, length == 4 ? 0 : (uint32_t)length);
+    put_bytes(w, id, length);
+}
+
+static void put_type(byte_writer_t *w, const char *type)
+{
+    put_bytes(w, type, 4);
+}
+
+/* Descriptor header: name, class ID, property count */
+static void put_descriptor(byte_writer_t *w, const char *class_id, uint32_t count)
+{
+    put_unicode(w, "");
+    put_id(w, class_id);
+    put_u32(w, count);
+}
+
+/* Obj value: name and class ID, then the descriptor itself */
+static void put_object(byte_writer_t *w, const char *class_id, uint32_t count)
+{
+    put_type(w, "Obj ");
+    put_unicode(w, "");
+    put_id(w, class_id);
+    put_descriptor(w, class_id, count);
+}
+
+static void put_unit_float(byte_writer_t *w, const char *key, double v)
+{
+    put_id(w, key);
+    put_type(w, "UntF");
+    put_type(w, "#Pxl");
+    put_f64(w, v);
+}
+
+static void put_color(byte_writer_t *w, uint32_t seed)
+{
+    put_id(w, "Clr ");
+    put_object(w, "RGBC", 3);
+    put_id(w, "Rd  ");
+    put_type(w, "doub");
+    put_f64(w, (double)(seed % 256));
+    put_id(w, "Grn ");
+    put_type(w, "doub");
+    put_f64(w, (double)(seed * 7 % 256));
+    put_id(w, "Bl  ");
+    put_type(w, "doub");
+    put_f64(w, (double)(seed * 13 % 256));
+}
+
+static void build_descriptor(byte_writer_t *w, uint32_t styles)
+{
+    put_descriptor(w, "TxLr", 5);
+
+    put_id(w, "Txt ");
+    put_type(w, "TEXT");
+    put_unicode(w, "The quick brown fox jumps over the lazy dog");
+
+    put_id(w, "textGridding");
+    put_type(w, "enum");
+    put_id(w, "textGridding");
+    put_id(w, "None");
+
+    put_id(w, "antiAlias");
+    put_type(w, "bool");
+    put_bytes(w, "\1", 1);
+
+    put_id(w, "bounds");
+    put_object(w, "bounds", 4);
+    put_unit_float(w, "Left", 12.0);
+    put_unit_float(w, "Top ", -30.5);
+    put_unit_float(w, "Rght", 480.25);
+    put_unit_float(w, "Btom", 8.0);
+
+    put_id(w, "styleRunList");
+    put_type(w, "VlLs");
+    put_u32(w, styles);
+    for (uint32_t i = 0; i < styles; i++) {
+        put_object(w, "styleRun", 4);
+        put_id(w, "from");
+        put_type(w, "long");
+        put_u32(w, i * 4);
+        put_id(w, "to  ");
+        put_type(w, "long");
+        put_u32(w, i * 4 + 4);
+        put_unit_float(w, "size", 12.0 + i % 5);
+        put_color(w, i);
+    }
+}
+
+typedef struct {
+    psd_stream_t *stream;
+} descriptor_state_t;
+
+static psd_status_t op_parse_descriptor(void *state)
+{
+    descriptor_state_t *s = (descriptor_state_t *)state;
+    if (psd_stream_seek(s->stream, 0) < 0) return PSD_ERR_STREAM_SEEK;
+
+    psd_descriptor_t *descriptor = NULL;
+    psd_status_t st = psd_parse_descriptor(s->stream, NULL, false, &descriptor);
+    psd_descriptor_free(descriptor, NULL);
+    return st;
+}
+
+void bench_descriptor(bench_runner_t *runner)
+{
+    const char *name = "descriptor/parse_text_styles";
+    if (!bench_wanted(runner, name)) return;
+
+    byte_writer_t w;
+    memset(&w, 0, sizeof(w));
+    build_descriptor(&w, bench_quick(runner) ? 16 : 512);
+
+    psd_stream_t *stream = w.failed ? NULL : psd_stream_create_buffer(NULL, w.data, w.size);
+    if (stream) {
+        descriptor_state_t state = { stream };
+        bench_run(runner, name, w.size, op_parse_descriptor, &state);
+        psd_stream_destroy(stream);
+    } else {
+        bench_skip(runner, name, "could not build the input descriptor");
+    }
+    free(w.data);
+}
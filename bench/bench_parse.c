@@ -0,0 +1,135 @@
+/**
+ * @file bench_parse.c
+ * @brief Whole-document parse and decode benchmarks
+ *
+ * Synthetic documents stand in for the files that stress the parser: many
+ * small layers (layer records and per-channel setup dominate), one large
+ * PSB (bulk RLE throughput) and 16-bit layers saved as ZIP with prediction.
+ * Each document is parsed from memory with and without layer pixels, and
+ * parsed then fully decoded with psd_document_decode_all_layers().
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "openpsd_bench.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const uint8_t *bytes;
+    size_t size;
+    uint32_t flags;
+    bool decode;
+} parse_state_t;
+
+static psd_status_t op_parse(void *state)
+{
+    parse_state_t *s = (parse_state_t *)state;
+    psd_stream_t *stream = psd_stream_create_buffer(NULL, s->bytes, s->size);
+    if (!stream) return PSD_ERR_OUT_OF_MEMORY;
+
+    psd_parse_options_t options = { s->flags, NULL };
+    psd_status_t st = PSD_OK;
+    psd_document_t *doc = psd_parse_with_options(stream, NULL, &options, &st);
+    if (doc && s->decode) st = psd_document_decode_all_layers(doc, NULL);
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    return st;
+}
+
+/* Time the three passes over one document */
+static void bench_document(bench_runner_t *runner, const char *group,
+                           const psd_test_doc_spec_t *spec)
+{
+    static const struct {
+        const char *name;
+        uint32_t flags;
+        bool decode;
+    } passes[] = {
+        { "parse", 0, false },
+        { "parse_skip_pixels", PSD_PARSE_SKIP_LAYER_PIXELS, false },
+        { "parse_decode_all", 0, true },
+    };
+
+    char names[3][96];
+    bool wanted = false;
+    for (size_t i = 0; i < 3; i++) {
+        (void)snprintf(names[i], sizeof(names[i]), "parse/%s/%s", group, passes[i].name);
+        if (bench_wanted(runner, names[i])) wanted = true;
+    }
+    if (!wanted) return;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(spec, &size);
+    for (size_t i = 0; i < 3; i++) {
+        if (!bytes) {
+            bench_skip(runner, names[i], "could not build the input document");
+            continue;
+        }
+        parse_state_t state = { bytes, size, passes[i].flags, passes[i].decode };
+        bench_run(runner, names[i], size, op_parse, &state);
+    }
+    free(bytes);
+}
+
+void bench_parse(bench_runner_t *runner)
+{
+    bool quick = bench_quick(runner);
+    psd_test_doc_spec_t spec;
+
+    /* Many small layers tiled over the canvas */
+    uint16_t layer_count = quick ? 64 : 1000;
+    psd_test_layer_t *layers = (psd_test_layer_t *)calloc(layer_count, sizeof(*layers));
+    if (layers) {
+        for (uint16_t i = 0; i < layer_count; i++) {
+            layers[i].opacity = 255;
+            layers[i].top = (uint32_t)(i / 32) * 32;
+            layers[i].left = (uint32_t)(i % 32) * 32;
+            layers[i].bottom = layers[i].top + 64;
+            layers[i].right = layers[i].left + 64;
+        }
+        psd_test_default_spec(&spec);
+        spec.width = 1088;
+        spec.height = (uint32_t)(layer_count / 32 + 1) * 32 + 32;
+        spec.layer_count = layer_count;
+        spec.layers = layers;
+        bench_document(runner, "many_layers", &spec);
+        free(layers);
+    }
+
+    /* One large RLE document in the PSB format */
+    psd_test_default_spec(&spec);
+    spec.width = quick ? 512 : 4096;
+    spec.height = spec.width;
+    spec.layer_count = 2;
+    spec.psb = true;
+    bench_document(runner, "psb_large", &spec);
+
+    /* 16-bit layers saved as ZIP with prediction */
+    psd_test_default_spec(&spec);
+    spec.width = quick ? 256 : 1024;
+    spec.height = spec.width;
+    spec.depth = 16;
+    spec.layer_count = 8;
+    spec.layer_compression = 3;
+    spec.composite_compression = 0;
+#if defined(OPENPSD_BENCH_HAVE_ZIP)
+    bench_document(runner, "zip_prediction16", &spec);
+#else
+    bench_skip(runner, "parse/zip_prediction16/parse", "built without ZIP support");
+    bench_skip(runner, "parse/zip_prediction16/parse_skip_pixels", "built without ZIP support");
+    bench_skip(runner, "parse/zip_prediction16/parse_decode_all", "built without ZIP support");
+#endif
+}
@@ -0,0 +1,333 @@
+/**
+ * @file openpsd_bench.c
+ * @brief Benchmark runner: calibration, timing and JSON output
+ *
+ * Each benchmark is warmed up once, calibrated to an iteration count that
+ * runs for at least --min-time, and then timed over --samples samples. The
+ * median time per op is reported (the minimum alongside it), so a run is
+ * stable enough to compare across commits. --json writes the results in a
+ * fixed layout and order for regression tracking.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* clock_gettime under strict C17 */
+#endif
+
+#include "openpsd_bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define BENCH_MAX_SAMPLES 64
+
+typedef struct {
+    char name[96];
+    const char *skipped;    /* Reason, or NULL when it ran */
+    psd_status_t status;    /* First failing op, PSD_OK otherwise */
+    uint64_t iterations;    /* Ops per sample */
+    uint32_t samples;
+    double median_ns;       /* Per op */
+    double min_ns;
+    uint64_t bytes_per_op;
+} bench_result_t;
+
+struct bench_runner {
+    const char *filter;
+    bool quick;
+    bool list_only;
+    uint32_t samples;
+    double min_time_ns;
+    FILE *report;           /* Human-readable table */
+
+    bench_result_t *results;
+    size_t count;
+    size_t capacity;
+};
+
+static double now_ns(void)
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1e9 / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+static bench_result_t *add_result(bench_runner_t *runner, const char *name)
+{
+    if (runner->count == runner->capacity) {
+        size_t capacity = runner->capacity ? runner->capacity * 2 : 64;
+        bench_result_t *results =
+            (bench_result_t *)realloc(runner->results, capacity * sizeof(*results));
+        if (!results) return NULL;
+        runner->results = results;
+        runner->capacity = capacity;
+    }
+    bench_result_t *result = &runner->results[runner->count++];
+    memset(result, 0, sizeof(*result));
+    (void)snprintf(result->name, sizeof(result->name), "%s", name);
+    return result;
+}
+
+bool bench_wanted(const bench_runner_t *runner, const char *name)
+{
+    return !runner->filter || strstr(name, runner->filter) != NULL;
+}
+
+bool bench_quick(const bench_runner_t *runner)
+{
+    return runner->quick;
+}
+
+void bench_skip(bench_runner_t *runner, const char *name, const char *reason)
+{
+    if (!bench_wanted(runner, name)) return;
+    bench_result_t *result = add_result(runner, name);
+    if (!result) return;
+    result->skipped = reason;
+    fprintf(runner->report, "%-44s skipped: %s\n", name, reason);
+}
+
+/* Time iterations ops; 0 if one of them failed */
+static double time_ops(bench_op_fn op, void *state, uint64_t iterations, psd_status_t *status)
+{
+    double start = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        psd_status_t st = op(state);
+        if (st != PSD_OK) {
+            *status = st;
+            return 0.0;
+        }
+    }
+    return now_ns() - start;
+}
+
+void bench_run(bench_runner_t *runner, const char *name, uint64_t bytes_per_op,
+               bench_op_fn op, void *state)
+{
+    if (!bench_wanted(runner, name)) return;
+    if (runner->list_only) {
+        fprintf(runner->report, "%s\n", name);
+        return;
+    }
+
+    bench_result_t *result = add_result(runner, name);
+    if (!result) return;
+    result->bytes_per_op = bytes_per_op;
+
+    /* Warm-up also catches broken inputs before they are timed */
+    psd_status_t status = PSD_OK;
+    time_ops(op, state, 1, &status);
+
+    uint64_t iterations = 1;
+    while (status == PSD_OK) {
+        double elapsed = time_ops(op, state, iterations, &status);
+        if (elapsed >= runner->min_time_ns || iterations >= (UINT64_C(1) << 40)) break;
+        /* Aim past the target in one step once there is a usable estimate */
+        uint64_t next = iterations * 2;
+        if (elapsed > runner->min_time_ns / 16) {
+            next = (uint64_t)((double)iterations * runner->min_time_ns * 1.2 / elapsed) + 1;
+        }
+        iterations = next;
+    }
+
+    double per_op[BENCH_MAX_SAMPLES];
+    uint32_t samples = 0;
+    while (status == PSD_OK && samples < runner->samples) {
+        double elapsed = time_ops(op, state, iterations, &status);
+        per_op[samples++] = elapsed / (double)iterations;
+    }
+
+    result->status = status;
+    if (status != PSD_OK) {
+        fprintf(runner->report, "%-44s FAILED: %s\n", name, psd_error_string(status));
+        return;
+    }
+
+    qsort(per_op, samples, sizeof(double), compare_double);
+    result->iterations = iterations;
+    result->samples = samples;
+    result->median_ns = (samples % 2) ? per_op[samples / 2]
+                                      : (per_op[samples / 2 - 1] + per_op[samples / 2]) / 2;
+    result->min_ns = per_op[0];
+
+    fprintf(runner->report, "%-44s %14.1f ns/op", name, result->median_ns);
+    if (bytes_per_op) {
+        fprintf(runner->report, " %10.1f MB/s",
+                (double)bytes_per_op * 1e3 / result->median_ns);
+    }
+    fprintf(runner->report, "\n");
+}
+
+/* Names are plain ASCII from the cases, but quote them properly anyway */
+static void write_json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(out, "\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned)(unsigned char)*s);
+        } else {
+            fputc(*s, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_json(const bench_runner_t *runner, FILE *out)
+{
+    uint32_t zip = 0, threads = 0;
+    const char *backend = psd_get_deflate_backend();
+#if defined(OPENPSD_BENCH_HAVE_ZIP)
+    zip = 1;
+#endif
+#if defined(OPENPSD_BENCH_HAVE_THREADS)
+    threads = 1;
+#endif
+
+    fprintf(out, "{\n  \"schema\": 1,\n  \"library_version\": ");
+    write_json_string(out, psd_get_version());
+    fprintf(out, ",\n  \"config\": { \"zip\": %s, \"threads\": %s, \"deflate_backend\": ",
+            zip ? "true" : "false", threads ? "true" : "false");
+    write_json_string(out, backend ? backend : "none");
+    fprintf(out, ", \"quick\": %s },\n  \"benchmarks\": [", runner->quick ? "true" : "false");
+
+    for (size_t i = 0; i < runner->count; i++) {
+        const bench_result_t *r = &runner->results[i];
+        fprintf(out, "%s\n    { \"name\": ", i ? "," : "");
+        write_json_string(out, r->name);
+        if (r->skipped) {
+            fprintf(out, ", \"skipped\": ");
+            write_json_string(out, r->skipped);
+        } else if (r->status != PSD_OK) {
+            fprintf(out, ", \"error\": ");
+            write_json_string(out, psd_error_string(r->status));
+        } else {
+            fprintf(out,
+                    ", \"iterations\": %llu, \"samples\": %u, \"median_ns\": %.1f, "
+                    "\"min_ns\": %.1f, \"bytes_per_op\": %llu",
+                    (unsigned long long)r->iterations, r->samples, r->median_ns, r->min_ns,
+                    (unsigned long long)r->bytes_per_op);
+            if (r->bytes_per_op) {
+                fprintf(out, ", \"mb_per_s\": %.1f",
+                        (double)r->bytes_per_op * 1e3 / r->median_ns);
+            }
+        }
+        fprintf(out, " }");
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+static void usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --filter TEXT    only run benchmarks whose name contains TEXT\n"
+            "  --json PATH      write results as JSON to PATH (- for stdout)\n"
+            "  --samples N      timed samples per benchmark (default 5)\n"
+            "  --min-time MS    minimum duration of one sample (default 50)\n"
+            "  --quick          small inputs and short samples (smoke test)\n"
+            "  --list           print benchmark names and exit\n",
+            program);
+}
+
+int main(int argc, char **argv)
+{
+    bench_runner_t runner;
+    memset(&runner, 0, sizeof(runner));
+    runner.samples = 5;
+    runner.min_time_ns = 50e6;
+    runner.report = stdout;
+
+    const char *json_path = NULL;
+    bool min_time_set = false;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--filter") == 0 && value) {
+            runner.filter = value;
+            i++;
+        } else if (strcmp(arg, "--json") == 0 && value) {
+            json_path = value;
+            i++;
+        } else if (strcmp(arg, "--samples") == 0 && value) {
+            long n = strtol(value, NULL, 10);
+            runner.samples = (uint32_t)(n < 1 ? 1 : (n > BENCH_MAX_SAMPLES ? BENCH_MAX_SAMPLES : n));
+            i++;
+        } else if (strcmp(arg, "--min-time") == 0 && value) {
+            double ms = strtod(value, NULL);
+            runner.min_time_ns = (ms > 0 ? ms : 0) * 1e6;
+            min_time_set = true;
+            i++;
+        } else if (strcmp(arg, "--quick") == 0) {
+            runner.quick = true;
+        } else if (strcmp(arg, "--list") == 0) {
+            runner.list_only = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (runner.quick && !min_time_set) {
+        runner.min_time_ns = 2e6;
+        runner.samples = runner.samples < 3 ? runner.samples : 3;
+    }
+    if (json_path && strcmp(json_path, "-") == 0) {
+        runner.report = stderr;
+    }
+
+    bench_codecs(&runner);
+    bench_render(&runner);
+    bench_descriptor(&runner);
+    bench_parse(&runner);
+
+    int failed = 0;
+    for (size_t i = 0; i < runner.count; i++) {
+        if (runner.results[i].status != PSD_OK) failed = 1;
+    }
+
+    if (json_path && !runner.list_only) {
+        FILE *out = strcmp(json_path, "-") == 0 ? stdout : fopen(json_path, "w");
+        if (!out) {
+            fprintf(stderr, "cannot write %s\n", json_path);
+            failed = 1;
+        } else {
+            write_json(&runner, out);
+            if (out != stdout) fclose(out);
+        }
+    }
+
+    free(runner.results);
+    return failed;
+}
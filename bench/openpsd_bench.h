@@ -0,0 +1,72 @@
+/**
+ * @file openpsd_bench.h
+ * @brief Benchmark runner shared by the openpsd_bench cases
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef OPENPSD_BENCH_H
+#define OPENPSD_BENCH_H
+
+#include <openpsd/psd.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief One operation of a benchmark; returns PSD_OK or stops the benchmark
+ */
+typedef psd_status_t (*bench_op_fn)(void *state);
+
+/**
+ * @brief Runner state, passed to every case
+ */
+typedef struct bench_runner bench_runner_t;
+
+/**
+ * @brief Time op and record the result under name
+ *
+ * Skipped (without calling op) when name does not match the filter.
+ *
+ * @param runner Runner
+ * @param name Stable benchmark name, "group/case"
+ * @param bytes_per_op Bytes one op processes, for MB/s (0 for none)
+ * @param op Operation to time
+ * @param state Passed to op
+ */
+void bench_run(bench_runner_t *runner, const char *name, uint64_t bytes_per_op,
+               bench_op_fn op, void *state);
+
+/**
+ * @brief Record a benchmark that could not run in this build
+ */
+void bench_skip(bench_runner_t *runner, const char *name, const char *reason);
+
+/**
+ * @brief Whether the benchmark called name would run (matches the filter)
+ *
+ * Lets cases skip building inputs nobody asked for.
+ */
+bool bench_wanted(const bench_runner_t *runner, const char *name);
+
+/**
+ * @brief Whether the small --quick inputs were requested
+ */
+bool bench_quick(const bench_runner_t *runner);
+
+/* Cases, one file each */
+void bench_codecs(bench_runner_t *runner);
+void bench_render(bench_runner_t *runner);
+void bench_descriptor(bench_runner_t *runner);
+void bench_parse(bench_runner_t *runner);
+
+#endif /* OPENPSD_BENCH_H */
@@ -139,59 +139,32 @@ static cairo_surface_t *render_pixel_layer_surface(psd_document_t *doc, int32_t
         return NULL;
     }
 
-    /* Use library conversion so non-RGB documents (Lab/CMYK/Indexed/etc) render correctly. */
-    size_t required = 0;
-    psd_status_t st = psd_document_render_layer_rgba8(doc, layer_index, NULL, 0, &required);
-    if (st != PSD_OK && st != PSD_ERR_BUFFER_TOO_SMALL) {
-        return NULL;
-    }
-    if (required == 0) {
-        return NULL;
-    }
-
-    uint8_t *rgba = (uint8_t *)malloc(required);
-    if (!rgba) {
-        return NULL;
-    }
-
-    st = psd_document_render_layer_rgba8(doc, layer_index, rgba, required, NULL);
-    if (st != PSD_OK) {
-        free(rgba);
-        return NULL;
-    }
-
     cairo_surface_t *surf = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
     if (!surf) {
-        free(rgba);
         return NULL;
     }
+    cairo_surface_flush(surf);
     uint8_t *dst = cairo_image_surface_get_data(surf);
     if (!dst) {
         cairo_surface_destroy(surf);
-        free(rgba);
         return NULL;
     }
-    int stride = cairo_image_surface_get_stride(surf);
-
-    for (uint32_t y = 0; y < height; y++) {
-        uint32_t *row = (uint32_t *)(dst + (int)y * stride);
-        for (uint32_t x = 0; x < width; x++) {
-            size_t off = ((size_t)y * (size_t)width + (size_t)x) * 4u;
-            uint8_t r = rgba[off + 0];
-            uint8_t g = rgba[off + 1];
-            uint8_t b = rgba[off + 2];
-            uint8_t a = rgba[off + 3];
-            if (a < 255) {
-                r = (uint8_t)((uint16_t)r * (uint16_t)a / 255u);
-                g = (uint8_t)((uint16_t)g * (uint16_t)a / 255u);
-                b = (uint8_t)((uint16_t)b * (uint16_t)a / 255u);
-            }
-            row[x] = ((uint32_t)a << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b;
-        }
+
+    /* Use library conversion so non-RGB documents (Lab/CMYK/Indexed/etc) render correctly,
+       written straight into the surface as premultiplied ARGB32. */
+    psd_render_target_t target;
+    memset(&target, 0, sizeof(target));
+    target.pixels = dst;
+    target.stride = (size_t)cairo_image_surface_get_stride(surf);
+    target.size = target.stride * height;
+    target.format = PSD_PIXEL_FORMAT_ARGB32;
+    target.premultiplied = true;
+    if (psd_document_render_layer_to_target(doc, layer_index, NULL, &target) != PSD_OK) {
+        cairo_surface_destroy(surf);
+        return NULL;
     }
 
     cairo_surface_mark_dirty(surf);
-    free(rgba);
     return surf;
 }
 
@@ -1049,38 +1022,18 @@ static void load_psd_file(AppData *app, const char *filename) {
             (int)color_mode, color_mode_name(color_mode),
             (unsigned)channel_count);
 
-    /* Render composite via library color conversion to RGBA8 */
-    size_t required = 0;
-    psd_status_t status = psd_document_render_composite_rgba8(app->current_doc, NULL, 0, &required);
-    if (status == PSD_OK || status == PSD_ERR_BUFFER_TOO_SMALL) {
-        uint8_t *rgba = (uint8_t *)malloc(required);
-        if (!rgba) {
-            status = PSD_ERR_OUT_OF_MEMORY;
-        } else {
-            status = psd_document_render_composite_rgba8(app->current_doc, rgba, required, NULL);
-            if (status == PSD_OK) {
-                uint8_t *surface_data = cairo_image_surface_get_data(app->composite_surface);
-                int stride = cairo_image_surface_get_stride(app->composite_surface);
-                for (uint32_t y = 0; y < height; y++) {
-                    uint32_t *row = (uint32_t *)(surface_data + y * stride);
-                    for (uint32_t x = 0; x < width; x++) {
-                        size_t off = ((size_t)y * (size_t)width + (size_t)x) * 4u;
-                        uint8_t r = rgba[off + 0];
-                        uint8_t g = rgba[off + 1];
-                        uint8_t b = rgba[off + 2];
-                        uint8_t a = rgba[off + 3];
-                        if (a < 255) {
-                            r = (uint8_t)((uint16_t)r * (uint16_t)a / 255u);
-                            g = (uint8_t)((uint16_t)g * (uint16_t)a / 255u);
-                            b = (uint8_t)((uint16_t)b * (uint16_t)a / 255u);
-                        }
-                        row[x] = ((uint32_t)a << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b;
-                    }
-                }
-                cairo_surface_mark_dirty(app->composite_surface);
-            }
-            free(rgba);
-        }
+    /* Render composite via library color conversion, straight into the surface */
+    cairo_surface_flush(app->composite_surface);
+    psd_render_target_t target;
+    memset(&target, 0, sizeof(target));
+    target.pixels = cairo_image_surface_get_data(app->composite_surface);
+    target.stride = (size_t)cairo_image_surface_get_stride(app->composite_surface);
+    target.size = target.stride * height;
+    target.format = PSD_PIXEL_FORMAT_ARGB32;
+    target.premultiplied = true;
+    psd_status_t status = psd_document_render_composite_to_target(app->current_doc, NULL, &target);
+    if (status == PSD_OK) {
+        cairo_surface_mark_dirty(app->composite_surface);
     }
 
     if (status != PSD_OK) {
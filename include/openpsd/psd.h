@@ -61,11 +61,59 @@ PSD_API void psd_version_components(
     int *patch
 );
 
+/**
+ * @brief Caller-supplied inflate implementation for ZIP data
+ *
+ * inflate must decompress one complete DEFLATE stream from src into exactly
+ * dst_len bytes of dst. zlib_wrapped tells whether the stream carries the
+ * RFC 1950 zlib header and checksum or is raw DEFLATE; when the data does not
+ * decode in the form given, the library calls again with the other form.
+ *
+ * inflate may be called from several threads at once (see
+ * psd_document_decode_all_layers()).
+ *
+ * @return PSD_OK when exactly dst_len bytes were produced,
+ *         PSD_ERR_CORRUPT_DATA when the data does not decode to that size,
+ *         or another error code (e.g. PSD_ERR_OUT_OF_MEMORY) to stop
+ */
+typedef struct {
+    psd_status_t (*inflate)(void *codec_data,
+                            const uint8_t *src, size_t src_len,
+                            uint8_t *dst, size_t dst_len,
+                            bool zlib_wrapped);
+    void *codec_data;   /**< Passed to inflate */
+} psd_codec_t;
+
+/**
+ * @brief Replace the built-in inflate used for ZIP data
+ *
+ * Lets applications plug in their own (e.g. hardware-accelerated) inflate.
+ * It also decodes ZIP data in builds without a built-in backend. The codec is
+ * process-wide and copied; set it before parsing or decoding anything, as the
+ * call is not synchronized with decodes in progress.
+ *
+ * With a custom codec, ZIP composites are read in full before they are
+ * inflated, rather than inflated while reading.
+ *
+ * @param codec Codec to use, or NULL to restore the built-in backend
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT if codec has no inflate
+ */
+PSD_API psd_status_t psd_set_codec(const psd_codec_t *codec);
+
+/**
+ * @brief Name of the built-in inflate backend
+ *
+ * @return "zlib", "zlib-ng", "libdeflate", or "none" when the library was
+ *         built without ZIP support (static string)
+ */
+PSD_API const char *psd_get_deflate_backend(void);
+
 /**
  * @brief Opaque document handle
  *
  * Represents a parsed PSD document. All state is encapsulated in this
- * structure - there is no global state in the library.
+ * structure; the only process-wide settings are the optional codec set with
+ * psd_set_codec() and read-only lookup tables.
  */
 typedef struct psd_document psd_document_t;
 
@@ -101,8 +149,9 @@ typedef struct {
 /**
  * @brief Single-style text layer rendering parameters
  *
- * All text layers are treated as a single style run.
- * Advanced features (warp/stroke/multi-run/paragraph composer) are ignored.
+ * Describes one style run (see psd_text_layer_get_style_runs()), or the
+ * layer's first run for psd_text_layer_get_default_style().
+ * Advanced features (warp/stroke/paragraph composer) are ignored.
  */
 #define PSD_TEXT_FONT_NAME_MAX 128
 typedef struct {
@@ -114,6 +163,61 @@ typedef struct {
     psd_text_justification_t justification;      /* Paragraph justification */
 } psd_text_style_t;
 
+/**
+ * @brief Character range of a text layer sharing one style
+ *
+ * Offsets count UTF-16 code units of the layer's text, as Photoshop does.
+ */
+typedef struct {
+    uint32_t start;                             /* First code unit of the run */
+    uint32_t length;                            /* Code units in the run */
+    psd_text_style_t style;                     /* Style; justification from the run's paragraph */
+} psd_text_style_run_t;
+
+/**
+ * @brief Character range of a text layer sharing one paragraph setting
+ */
+typedef struct {
+    uint32_t start;                             /* First code unit of the paragraph run */
+    uint32_t length;                            /* Code units in the run */
+    psd_text_justification_t justification;
+    double first_line_indent;                   /* Points */
+    double start_indent;                        /* Points */
+    double end_indent;                          /* Points */
+    double space_before;                        /* Points */
+    double space_after;                         /* Points */
+} psd_text_paragraph_run_t;
+
+/*
+ * Sharing a document between threads
+ *
+ * Once parsed, a document can serve several threads at once. Every call that
+ * only reads it may run concurrently on the same document: the getters,
+ * psd_document_get_layer_channel_data(), psd_document_decode_layer_channel_into(),
+ * psd_document_decode_all_layers(), psd_document_get_composite_image(), the
+ * psd_document_render_* functions, content bounds, tagged blocks and
+ * descriptors, the thumbnail, the psd_text_layer_* queries and
+ * psd_document_open_embedded() / psd_document_open_embedded_stream(). The
+ * streams and nested documents those return may be used and freed on other
+ * threads than the parent's. Work they do
+ * lazily (deferred loads, channel and composite decodes, descriptor and
+ * EngineData parses) runs once per item; a thread asking for an item another
+ * thread is preparing waits for it, and the pointers returned stay valid
+ * until the document is freed.
+ *
+ * Calls that change the document need it to themselves:
+ * psd_document_free(), psd_document_set_layer_properties(),
+ * psd_document_set_render_flags(), psd_document_set_decode_budget() and
+ * psd_document_release_layer_pixels(). A document with a decode budget
+ * evicts planes other threads may still be reading, so share it only with no
+ * budget set; the same goes for PSD_RENDER_NO_CACHE renders. The source
+ * stream of deferred loads is only read under the document's own lock (by
+ * the document and by the embedded streams opened from it), but must not be
+ * used by anything else meanwhile.
+ * Streams, psd_composite_cache_t, psd_parser_t and psd_writer_t objects are
+ * used by one thread at a time.
+ */
+
 /**
  * @brief Parse a PSD file from a stream
  *
@@ -147,6 +251,217 @@ PSD_API psd_document_t* psd_parse_ex(
     psd_status_t *out_status
 );
 
+/**
+ * @brief Parse option flags
+ *
+ * Skipped data is not read during parsing. Its location in the stream is
+ * recorded instead and it is loaded on first access (channel data, resource
+ * and composite queries, rendering).
+ */
+typedef enum {
+    PSD_PARSE_SKIP_LAYER_PIXELS = 1u << 0, /**< Don't read layer channel payloads */
+    PSD_PARSE_SKIP_COMPOSITE = 1u << 1,    /**< Don't read the composite image data section */
+    PSD_PARSE_SKIP_RESOURCES = 1u << 2,    /**< Don't parse the image resources section */
+    PSD_PARSE_STOP_AFTER_RESOURCES = 1u << 3, /**< Read nothing past the image resources:
+                                                   no layers and no composite */
+    PSD_PARSE_COLLECT_STATS = 1u << 4,     /**< Keep psd_stats_t counters (psd_document_get_stats) */
+} psd_parse_flags_t;
+
+/**
+ * @brief Phases of parsing and decoding timed by psd_stats_t
+ *
+ * PSD_PHASE_LAYER_INFO covers the whole layer and mask section, including the
+ * PSD_PHASE_CHANNEL_READ time spent reading channel payloads. Deferred loads
+ * (skip flags) count toward the phase of the section they load.
+ */
+typedef enum {
+    PSD_PHASE_HEADER = 0,        /**< File header */
+    PSD_PHASE_COLOR_MODE_DATA,   /**< Color mode data section */
+    PSD_PHASE_RESOURCES,         /**< Image resources section */
+    PSD_PHASE_LAYER_INFO,        /**< Layer records, masks and tagged blocks */
+    PSD_PHASE_CHANNEL_READ,      /**< Reading layer channel payloads */
+    PSD_PHASE_TEXT_LAYERS,       /**< Text layer extraction */
+    PSD_PHASE_COMPOSITE_READ,    /**< Reading the composite image data section */
+    PSD_PHASE_LAYER_DECODE,      /**< Decoding layer channels (summed over threads) */
+    PSD_PHASE_COMPOSITE_DECODE,  /**< Decoding the composite into planes */
+    PSD_PHASE_COUNT
+} psd_phase_t;
+
+/**
+ * @brief Counters kept for a document parsed with PSD_PARSE_COLLECT_STATS
+ *
+ * Stream counters are callback calls (what reaches the file or the caller's
+ * stream), not library reads served from the read-ahead window. Allocation
+ * counters cover every allocation made for the document through its
+ * allocator.
+ */
+typedef struct {
+    uint64_t phase_ns[PSD_PHASE_COUNT];    /**< Wall time per phase */
+    uint64_t phase_count[PSD_PHASE_COUNT]; /**< Times each phase ran */
+
+    uint64_t bytes_read;         /**< Bytes read from the stream (mapped bytes included) */
+    uint64_t stream_reads;       /**< Read and positional read callbacks */
+    uint64_t stream_seeks;       /**< Seek callbacks */
+
+    uint64_t allocations;        /**< malloc and realloc calls */
+    uint64_t frees;              /**< free calls */
+    uint64_t bytes_in_use;       /**< Bytes currently allocated */
+    uint64_t peak_bytes;         /**< Largest bytes_in_use so far */
+
+    uint64_t channels_decoded[4]; /**< Channel decodes by compression (RAW, RLE, ZIP, ZIP + prediction) */
+    uint64_t channel_bytes_decoded; /**< Bytes of decoded planes produced */
+    uint64_t decode_cache_hits;  /**< Channel requests served by an already decoded plane */
+    uint64_t decode_cache_misses; /**< Channel requests that had to decode */
+    uint64_t tile_cache_hits;    /**< Composite cache tiles that were still valid */
+    uint64_t tile_cache_misses;  /**< Composite cache tiles that were recomposed */
+} psd_stats_t;
+
+/**
+ * @brief One layer channel decode, as reported to psd_trace_hooks_t
+ */
+typedef struct {
+    int16_t channel_id;          /**< Channel id (-1 = alpha, -2/-3 = masks) */
+    uint32_t compression;        /**< 0 = RAW, 1 = RLE, 2 = ZIP, 3 = ZIP + prediction */
+    uint64_t compressed_bytes;   /**< Payload size */
+    uint64_t decoded_bytes;      /**< Plane size */
+    uint64_t elapsed_ns;         /**< Decode time */
+    psd_status_t status;         /**< Result of the decode */
+} psd_trace_channel_t;
+
+/**
+ * @brief Callbacks told about parse phases and channel decodes as they happen
+ *
+ * Any callback may be NULL. Decode callbacks may run on worker threads, so
+ * they must be thread-safe when decodes can run in parallel.
+ */
+typedef struct {
+    void (*phase_begin)(void *user_data, psd_phase_t phase);
+    void (*phase_end)(void *user_data, psd_phase_t phase, uint64_t elapsed_ns);
+    void (*channel_decoded)(void *user_data, const psd_trace_channel_t *channel);
+    void *user_data;
+} psd_trace_hooks_t;
+
+/**
+ * @brief Options for psd_parse_with_options()
+ */
+typedef struct {
+    uint32_t flags;    /**< Bitwise OR of psd_parse_flags_t values */
+    const psd_trace_hooks_t *trace; /**< Trace callbacks (copied), or NULL; only read
+                                         with PSD_PARSE_COLLECT_STATS */
+} psd_parse_options_t;
+
+/**
+ * @brief Parse a PSD/PSB file from a stream with options
+ *
+ * Same as psd_parse_ex(), but allows skipping pixel payloads and resources for
+ * fast metadata-only scans. When any skip flag is set, the document seeks back
+ * into the stream to load skipped data on demand, so the stream must stay
+ * valid until the document is freed and must not be read by anyone else while
+ * document calls are in progress.
+ *
+ * @param stream Stream to read from (required)
+ * @param allocator Custom memory allocator (NULL for default)
+ * @param options Parse options (NULL for defaults: read everything)
+ * @param out_status Where to store status (can be NULL)
+ * @return Parsed document on success, NULL on failure
+ */
+PSD_API psd_document_t* psd_parse_with_options(
+    psd_stream_t *stream,
+    const psd_allocator_t *allocator,
+    const psd_parse_options_t *options,
+    psd_status_t *out_status
+);
+
+/**
+ * @brief Save where a document's layer records and channel payloads live
+ *
+ * The index lets psd_parse_with_index() re-open the same file without
+ * probing PSB length widths or walking the channel image data, which on
+ * large documents is most of the cost of a metadata-only parse. It is a
+ * small byte blob (about 18 bytes per channel) for the caller to keep
+ * next to the file or in a cache.
+ *
+ * source_tag is stored as given and must be passed again on re-open; use it
+ * for whatever identifies the file version cheaply (size and modification
+ * time, a content ID). A hash of the file header and layer records is
+ * stored as well, so an edited file is detected even with a reused tag.
+ *
+ * @param doc Document parsed from stream (layer section must have been read)
+ * @param stream Stream the document was parsed from, read positionally
+ * @param source_tag Caller's identifier for this version of the file
+ * @param out_index Destination buffer (NULL to query the size)
+ * @param out_index_size Size of out_index in bytes
+ * @param out_required_size Where to store the index size (can be NULL)
+ * @return PSD_OK on success,
+ *         PSD_ERR_BUFFER_TOO_SMALL if out_index is NULL or too small,
+ *         PSD_ERR_INVALID_ARGUMENT if the document has no layer layout
+ *         (parsed with PSD_PARSE_STOP_AFTER_RESOURCES)
+ */
+PSD_API psd_status_t psd_document_save_index(
+    const psd_document_t *doc,
+    psd_stream_t *stream,
+    uint64_t source_tag,
+    uint8_t *out_index,
+    size_t out_index_size,
+    size_t *out_required_size
+);
+
+/**
+ * @brief Parse a PSD/PSB file using a saved layout index
+ *
+ * Same as psd_parse_with_options() with PSD_PARSE_SKIP_LAYER_PIXELS always
+ * set, but length widths and channel payload offsets come from the index.
+ * The index is checked against the stream before use; a stale index fails
+ * the parse so the caller can fall back to psd_parse_with_options() and save
+ * a fresh one.
+ *
+ * @param stream Stream to read from (required)
+ * @param allocator Custom memory allocator (NULL for default)
+ * @param options Parse options (NULL for defaults)
+ * @param index_data Index from psd_document_save_index() (required)
+ * @param index_size Size of index_data in bytes
+ * @param source_tag Tag the index was saved with
+ * @param out_status Where to store status (can be NULL):
+ *        PSD_ERR_INVALID_FORMAT if index_data is not an intact index,
+ *        PSD_ERR_INVALID_ARGUMENT if it does not match the stream or tag
+ * @return Parsed document on success, NULL on failure
+ */
+PSD_API psd_document_t* psd_parse_with_index(
+    psd_stream_t *stream,
+    const psd_allocator_t *allocator,
+    const psd_parse_options_t *options,
+    const uint8_t *index_data,
+    size_t index_size,
+    uint64_t source_tag,
+    psd_status_t *out_status
+);
+
+/**
+ * @brief Get the counters of a document parsed with PSD_PARSE_COLLECT_STATS
+ *
+ * Counters keep running after parsing: later loads, decodes and renders of
+ * the document add to them. While the document keeps reading its source
+ * stream (skip flags), other use of that stream is counted too.
+ *
+ * @param doc Document to query (required)
+ * @param out_stats Receives a snapshot of the counters (required)
+ * @return PSD_OK on success, PSD_ERR_NULL_POINTER on NULL arguments,
+ *         PSD_ERR_NOT_INITIALIZED if the document does not collect stats
+ */
+PSD_API psd_status_t psd_document_get_stats(const psd_document_t *doc, psd_stats_t *out_stats);
+
+/**
+ * @brief Zero a document's counters, to measure one operation at a time
+ *
+ * bytes_in_use is kept (the memory is still allocated) and peak_bytes
+ * restarts from it.
+ *
+ * @param doc Document to reset (required)
+ * @return PSD_OK on success, PSD_ERR_NULL_POINTER if doc is NULL,
+ *         PSD_ERR_NOT_INITIALIZED if the document does not collect stats
+ */
+PSD_API psd_status_t psd_document_reset_stats(psd_document_t *doc);
+
 /**
  * @brief Free a parsed document
  *
@@ -296,6 +611,69 @@ PSD_API psd_status_t psd_document_find_resource(
     size_t *index
 );
 
+/**
+ * @brief Thumbnail formats of the thumbnail resource
+ */
+typedef enum {
+    PSD_THUMBNAIL_RAW_RGB = 0,  /**< Uncompressed rows (kRawRGB) */
+    PSD_THUMBNAIL_JPEG_RGB = 1, /**< JPEG stream (kJpegRGB) */
+} psd_thumbnail_format_t;
+
+/**
+ * @brief Thumbnail stored in image resource 1036 (or 1033)
+ */
+typedef struct {
+    uint16_t resource_id;      /**< 1036, or 1033 for Photoshop 4.0 files (BGR order) */
+    uint32_t format;           /**< psd_thumbnail_format_t value */
+    uint32_t width;            /**< Width in pixels */
+    uint32_t height;           /**< Height in pixels */
+    uint32_t width_bytes;      /**< Padded bytes per row of the raw image */
+    uint16_t bits_per_pixel;   /**< Normally 24 */
+    uint16_t planes;           /**< Normally 1 */
+    const uint8_t *data;       /**< JPEG stream or raw rows (valid while the document exists) */
+    uint64_t length;           /**< Bytes at data */
+} psd_thumbnail_t;
+
+/**
+ * @brief Get the thumbnail stored in the image resources
+ *
+ * Reads the header of resource 1036 (falling back to 1033) and points at the
+ * image data, which for JPEG thumbnails is a complete JPEG file. Together with
+ * PSD_PARSE_STOP_AFTER_RESOURCES only the start of the file is read.
+ *
+ * @param doc Document to query (required)
+ * @param thumbnail Receives the thumbnail (required)
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT if there is no
+ *         thumbnail, PSD_ERR_CORRUPT_DATA for a truncated resource, or other
+ *         error
+ */
+PSD_API psd_status_t psd_document_get_thumbnail(
+    const psd_document_t *doc,
+    psd_thumbnail_t *thumbnail
+);
+
+/**
+ * @brief Decode the thumbnail to RGB8
+ *
+ * Writes width * height * 3 bytes of tightly packed RGB, with 1033 thumbnails
+ * swapped to RGB order. JPEG thumbnails need a library built with
+ * OPENPSD_ENABLE_JPEG.
+ *
+ * @param doc Document to query (required)
+ * @param out_rgb Output buffer (may be NULL to query required size)
+ * @param out_rgb_size Size of output buffer in bytes
+ * @param out_required_size Where to store required size in bytes (can be NULL)
+ * @return PSD_OK on success, PSD_ERR_BUFFER_TOO_SMALL if buffer is too small,
+ *         PSD_ERR_UNSUPPORTED_COMPRESSION if JPEG decoding is not built in,
+ *         or other error
+ */
+PSD_API psd_status_t psd_document_get_thumbnail_rgb8(
+    const psd_document_t *doc,
+    uint8_t *out_rgb,
+    size_t out_rgb_size,
+    size_t *out_required_size
+);
+
 /**
  * @brief Get number of layers in document
  *
@@ -342,6 +720,56 @@ PSD_API psd_status_t psd_document_get_layer_bounds(
     int32_t *right
 );
 
+/**
+ * @brief Get the tight bounding box of a layer's visible pixels
+ *
+ * Scans the transparency channel once and caches the result with the
+ * layer. RLE channels are read without decompressing them (a row that is a
+ * single zero run costs one byte); ZIP channels are decoded. A layer with no
+ * transparency channel is opaque, so its content bounds are its bounds.
+ *
+ * @param doc Document (required; deferred channel data is loaded)
+ * @param layer_index Layer index (0-based)
+ * @param out_bounds Receives the box in document coordinates, all zero when
+ *        every pixel is transparent (required)
+ * @param out_empty_rows Receives how many of the layer's rows are fully
+ *        transparent (can be NULL)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE for a bad index, or the
+ *         error from reading the channel
+ */
+PSD_API psd_status_t psd_document_get_layer_content_bounds(
+    psd_document_t *doc,
+    int32_t layer_index,
+    psd_rect_t *out_bounds,
+    uint32_t *out_empty_rows
+);
+
+/**
+ * @brief Get a hash identifying a layer's pixels and placement
+ *
+ * Hashes every channel's compressed payload as stored in the file, without
+ * decoding it, together with the layer's bounds, blend mode, opacity,
+ * clipping and flags. Equal layers give equal fingerprints across parses,
+ * sources and platforms, so the value can be kept as a cache key; a changed
+ * layer gives a different one with overwhelming likelihood. It is not a
+ * cryptographic hash.
+ *
+ * The payload hash is computed once and kept with the layer, so later calls
+ * only fold in the record fields (which psd_document_set_layer_properties()
+ * may have changed). Equal pixels compressed differently hash differently.
+ *
+ * @param doc Document (required; deferred channel data is loaded)
+ * @param layer_index Layer index (0-based)
+ * @param out_fingerprint Receives the fingerprint (required)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE for a bad index, or the
+ *         error from reading a deferred channel
+ */
+PSD_API psd_status_t psd_document_get_layer_fingerprint(
+    psd_document_t *doc,
+    int32_t layer_index,
+    uint64_t *out_fingerprint
+);
+
 /**
  * @brief Get layer blend mode
  *
@@ -374,6 +802,26 @@ PSD_API psd_status_t psd_document_get_layer_properties(
     uint8_t *flags
 );
 
+/**
+ * @brief Set layer opacity and flags
+ *
+ * Changes how psd_document_flatten_rgba8() composites the layer, e.g. setting
+ * flags bit 1 hides it. Nothing is written back to the file. Call
+ * psd_composite_cache_invalidate_layer() for caches built on the document.
+ *
+ * @param doc Document to modify (required)
+ * @param index Layer index (0-based)
+ * @param opacity New opacity 0-255
+ * @param flags New layer flags
+ * @return PSD_OK on success, negative error code on failure
+ */
+PSD_API psd_status_t psd_document_set_layer_properties(
+    psd_document_t *doc,
+    int32_t index,
+    uint8_t opacity,
+    uint8_t flags
+);
+
 /**
  * @brief Get number of channels in a layer
  *
@@ -408,6 +856,25 @@ PSD_API psd_status_t psd_document_get_layer_name(
     size_t *name_length
 );
 
+/**
+ * @brief Find a layer by name
+ *
+ * Names are compared byte for byte against the UTF-8 names returned by
+ * psd_document_get_layer_name(). When several layers share the name, the
+ * lowest layer index is returned. Lookups use an index built while parsing
+ * and take constant time on average.
+ *
+ * @param doc Document to query (required)
+ * @param name NUL-terminated UTF-8 layer name (required)
+ * @param layer_index Where to store the layer index if found (required)
+ * @return PSD_OK if found, PSD_ERR_INVALID_ARGUMENT if no layer has that name
+ */
+PSD_API psd_status_t psd_document_find_layer_by_name(
+    const psd_document_t *doc,
+    const char *name,
+    int32_t *layer_index
+);
+
 /**
  * @brief Get layer features
  *
@@ -476,6 +943,15 @@ PSD_API psd_bool_t psd_document_is_background_layer(
  * Returns the final composite (flattened) image. The data is organized
  * in planar format: all scanlines of channel 0, then channel 1, etc.
  *
+ * Parsing only keeps the compressed section; the first call decodes it and
+ * later calls return the same buffer. Corrupt compressed data is reported
+ * here rather than by psd_parse(). The exception is a ZIP or
+ * ZIP-with-prediction composite read from a stream other than
+ * psd_stream_create_file_mmap(): psd_parse() inflates it straight from the
+ * stream, so parse time and memory grow with the composite, and data that
+ * does not inflate leaves no composite. Parse with PSD_PARSE_SKIP_COMPOSITE
+ * to defer that work to the first call here.
+ *
  * @param doc Document to query (required)
  * @param data Where to store pointer to image data (can be NULL if no composite)
  * @param length Where to store data length in bytes (can be NULL)
@@ -499,6 +975,47 @@ typedef struct {
     uint32_t compression;            /**< Composite compression (0..3) */
 } psd_render_composite_info_t;
 
+/**
+ * @brief Render option flags
+ */
+typedef enum {
+    PSD_RENDER_EXACT_COLOR = 1u << 0, /**< Convert Lab with the full powf() math instead of lookup tables */
+    PSD_RENDER_FAST_SCALE = 1u << 1,  /**< Scaled renders convert one pixel per block instead of averaging */
+    PSD_RENDER_NO_CACHE = 1u << 2,    /**< Layer renders stream rows from the compressed channels and keep no decoded planes */
+} psd_render_flags_t;
+
+/**
+ * @brief Set render options for a document
+ *
+ * Applies to every later render call on the document. By default RGBA8
+ * renders convert 8- and 16-bit Lab through lookup tables built once per
+ * process. They are within one level of the exact math for nearly all
+ * channels (up to 10 levels for a few strongly out-of-gamut 8-bit colors);
+ * PSD_RENDER_EXACT_COLOR converts each pixel with the exact math instead.
+ *
+ * PSD_RENDER_NO_CACHE suits one-shot renders. RGBA8 layer renders then
+ * decode RAW and RLE channels one row at a time and convert each row while
+ * it is in cache (16-bit RGB and grayscale rows go straight from the
+ * PackBits data into the output), and release what the call loaded or
+ * decoded (ZIP planes, payloads of a deferred document) before returning.
+ * Output is identical either way. Since they release memory, such renders
+ * need the document to themselves.
+ *
+ * @param doc Document to configure (required)
+ * @param flags Bitwise OR of psd_render_flags_t values
+ * @return PSD_OK on success, PSD_ERR_NULL_POINTER if doc is NULL
+ */
+PSD_API psd_status_t psd_document_set_render_flags(psd_document_t *doc, uint32_t flags);
+
+/**
+ * @brief Get the render options of a document
+ *
+ * @param doc Document to query (required)
+ * @param flags Receives the psd_render_flags_t bits (required)
+ * @return PSD_OK on success, PSD_ERR_NULL_POINTER on NULL arguments
+ */
+PSD_API psd_status_t psd_document_get_render_flags(const psd_document_t *doc, uint32_t *flags);
+
 /**
  * @brief Render composite image to RGBA8
  *
@@ -568,85 +1085,1251 @@ PSD_API psd_status_t psd_document_render_layer_rgba8(
 );
 
 /**
- * @brief Get layer channel info and decode on demand
- *
- * Returns information about a layer channel with lazy decoding support.
- * The channel data is decompressed only when this function is called.
- * Supports RAW and RLE formats. ZIP formats are returned as compressed.
- *
- * @param doc Document to query (required)
- * @param layer_index Layer index (0-based)
- * @param channel_index Channel index within layer (0-based)
- * @param channel_id Where to store channel ID (can be NULL)
- * @param data Where to store decoded pixel data pointer (can be NULL)
- * @param length Where to store decoded data length in bytes (can be NULL)
- * @param compression Where to store original compression type (can be NULL)
- * @return PSD_OK on success, negative error code on failure
+ * @brief Scanline callback for streaming renders
+ *
+ * @param user_data Context passed to the render call
+ * @param y Row index relative to the top of the rendered region
+ * @param rgba Row of interleaved RGBA8 pixels (valid only during the call)
+ * @param width Number of pixels in the row
+ * @return PSD_OK to continue; any other value stops rendering and is returned
+ *         by the render call
  */
-PSD_API psd_status_t psd_document_get_layer_channel_data(
-    psd_document_t *doc,
-    int32_t layer_index,
-    size_t channel_index,
-    int16_t *channel_id,
-    const uint8_t **data,
-    uint64_t *length,
-    uint32_t *compression
+typedef psd_status_t (*psd_render_scanline_fn)(
+    void *user_data,
+    uint32_t y,
+    const uint8_t *rgba,
+    uint32_t width
 );
 
 /**
- * @brief Get layer raw descriptor data
- *
- * Returns the raw binary descriptor data for a layer (layer effects, text, etc).
- * The descriptor structure is preserved as raw bytes for forward compatibility.
- * Interpretation is left to the application.
- *
- * @param doc Document to query (required)
- * @param layer_index Layer index (0-based)
- * @param descriptor_data Where to store raw descriptor bytes (can be NULL if no descriptor)
- * @param descriptor_length Where to store descriptor data length (can be NULL)
- * @return PSD_OK on success, negative error code on failure
+ * @brief Render a region of the composite image to RGBA8
+ *
+ * Same conversion as psd_document_render_composite_rgba8(), limited to rect.
+ * RAW and RLE composites are decoded row by row for just the rows of rect,
+ * without decoding (or caching) the whole image; ZIP composites cannot be
+ * read from the middle and are decoded in full on first use.
+ *
+ * @param doc Document to render (required)
+ * @param rect Region in document coordinates (NULL for the whole image);
+ *             must lie within the document
+ * @param out_rgba Output, (rect height - 1) * out_stride + rect width * 4 bytes
+ * @param out_stride Bytes between output rows (at least rect width * 4)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE if rect is outside the
+ *         document, PSD_ERR_INVALID_ARGUMENT if there is no composite or the
+ *         stride is too small, or other error
  */
-PSD_API psd_status_t psd_document_get_layer_descriptor(
+PSD_API psd_status_t psd_document_render_composite_rgba8_rect(
     const psd_document_t *doc,
-    int32_t layer_index,
-    const uint8_t **descriptor_data,
-    uint64_t *descriptor_length
+    const psd_rect_t *rect,
+    uint8_t *out_rgba,
+    size_t out_stride
 );
 
 /**
- * @brief Extract text content from a text layer
+ * @brief Render a region of the composite image one scanline at a time
+ *
+ * Like psd_document_render_composite_rgba8_rect(), but hands each RGBA8 row
+ * to callback instead of writing to a caller buffer. Memory use is a few rows
+ * regardless of image size.
+ *
+ * @param doc Document to render (required)
+ * @param rect Region in document coordinates (NULL for the whole image)
+ * @param callback Called once per row, top to bottom (required)
+ * @param user_data Passed to callback
+ * @return PSD_OK on success, the callback's status if it stopped rendering,
+ *         or other error
+ */
+PSD_API psd_status_t psd_document_render_composite_rgba8_scanlines(
+    const psd_document_t *doc,
+    const psd_rect_t *rect,
+    psd_render_scanline_fn callback,
+    void *user_data
+);
+
+/**
+ * @brief Render the composite image downsampled by a power of two
+ *
+ * Each output pixel covers a block of 2^level x 2^level document pixels
+ * (smaller at the right and bottom edges), and planes are decimated while they
+ * are converted, so no full-size RGBA buffer is needed. Blocks are averaged in
+ * premultiplied form; with PSD_RENDER_FAST_SCALE set (see
+ * psd_document_set_render_flags()) only each block's center pixel is
+ * converted and the other rows of RAW and RLE composites are never decoded,
+ * so the cost follows the output size rather than the document size.
+ *
+ * @param doc Document to render (required)
+ * @param level Scale level: output is ceil(width / 2^level) x ceil(height / 2^level)
+ *              (0 = full size, at most 31)
+ * @param out_rgba Output buffer (may be NULL to query required size)
+ * @param out_rgba_size Size of output buffer in bytes
+ * @param out_required_size Where to store required size in bytes (can be NULL)
+ * @param out_width Receives the output width (can be NULL)
+ * @param out_height Receives the output height (can be NULL)
+ * @return PSD_OK on success, PSD_ERR_BUFFER_TOO_SMALL if buffer is too small,
+ *         PSD_ERR_INVALID_ARGUMENT for a bad level or if there is no
+ *         composite, or other error
+ */
+PSD_API psd_status_t psd_document_render_composite_rgba8_scaled(
+    const psd_document_t *doc,
+    uint32_t level,
+    uint8_t *out_rgba,
+    size_t out_rgba_size,
+    size_t *out_required_size,
+    uint32_t *out_width,
+    uint32_t *out_height
+);
+
+/**
+ * @brief Render a region of a pixel layer to RGBA8
  *
- * Attempts to extract the actual text string from a text layer's descriptor data.
- * This requires parsing the TySh descriptor which is expensive, so it's done on-demand.
+ * Same conversion as psd_document_render_layer_rgba8(), limited to rect.
+ * Only the rows of rect are decoded from RAW and RLE channels.
  *
- * @param doc Document containing the text layer (required)
+ * @param doc Document (required)
  * @param layer_index Layer index (0-based)
- * @param buffer Buffer to store extracted text
- * @param buffer_size Size of buffer in bytes
- * @return PSD_OK on success, negative error code on failure
+ * @param rect Region relative to the layer's bounding box (NULL for the whole
+ *             layer); must lie within it
+ * @param out_rgba Output, (rect height - 1) * out_stride + rect width * 4 bytes
+ * @param out_stride Bytes between output rows (at least rect width * 4)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE if rect is outside the
+ *         layer, or other error
  */
-PSD_API psd_status_t psd_text_layer_get_text(
+PSD_API psd_status_t psd_document_render_layer_rgba8_rect(
     psd_document_t *doc,
-    uint32_t layer_index,
-    char *buffer,
-    size_t buffer_size
+    int32_t layer_index,
+    const psd_rect_t *rect,
+    uint8_t *out_rgba,
+    size_t out_stride
 );
 
 /**
- * @brief Get the default (single-run) text style for a text layer
+ * @brief Render a region of a pixel layer one scanline at a time
  *
- * Extraction of font name, size, color, tracking, leading, and justification.
- * Treats the text layer as a single style run.
- *
- * @param doc Document containing the text layer (required)
+ * @param doc Document (required)
  * @param layer_index Layer index (0-based)
- * @param out_style Output style structure (required)
- * @return PSD_OK on success, or error on failure / unsupported structure
+ * @param rect Region relative to the layer's bounding box (NULL for the whole layer)
+ * @param callback Called once per row, top to bottom (required)
+ * @param user_data Passed to callback
+ * @return PSD_OK on success, the callback's status if it stopped rendering,
+ *         or other error
  */
-PSD_API psd_status_t psd_text_layer_get_default_style(
+PSD_API psd_status_t psd_document_render_layer_rgba8_scanlines(
     psd_document_t *doc,
-    uint32_t layer_index,
-    psd_text_style_t *out_style
+    int32_t layer_index,
+    const psd_rect_t *rect,
+    psd_render_scanline_fn callback,
+    void *user_data
+);
+
+/**
+ * @brief Convert the composite image to interleaved RGBA16
+ *
+ * Four native-endian uint16 samples per pixel, tightly packed. 16-bit
+ * samples are kept exactly, 8-bit ones are scaled by 257, and 32-bit float
+ * samples are clamped to [0, 1] and scaled to 65535. Lab is converted to
+ * sRGB at full precision; an alpha plane becomes A, otherwise A = 65535.
+ *
+ * @param doc Document to render (required)
+ * @param out_rgba Output buffer, or NULL to query the size
+ * @param out_size Size of out_rgba in bytes
+ * @param out_required_size Receives width * height * 8 (can be NULL)
+ * @return PSD_OK on success, PSD_ERR_BUFFER_TOO_SMALL if out_rgba is NULL or
+ *         too small, or other error
+ */
+PSD_API psd_status_t psd_document_render_composite_rgba16(
+    const psd_document_t *doc,
+    uint16_t *out_rgba,
+    size_t out_size,
+    size_t *out_required_size
+);
+
+/**
+ * @brief Convert the composite image to interleaved 32-bit float RGBA
+ *
+ * Four floats per pixel, tightly packed. 8- and 16-bit samples are
+ * normalized to [0, 1]; 32-bit samples are passed through unchanged (HDR
+ * values above 1 are kept, and like Photoshop's 32-bit files they are
+ * linear). Lab is converted to sRGB.
+ *
+ * @param doc Document to render (required)
+ * @param out_rgba Output buffer, or NULL to query the size
+ * @param out_size Size of out_rgba in bytes
+ * @param out_required_size Receives width * height * 16 (can be NULL)
+ * @return PSD_OK on success, PSD_ERR_BUFFER_TOO_SMALL if out_rgba is NULL or
+ *         too small, or other error
+ */
+PSD_API psd_status_t psd_document_render_composite_rgbaf32(
+    const psd_document_t *doc,
+    float *out_rgba,
+    size_t out_size,
+    size_t *out_required_size
+);
+
+/**
+ * @brief Convert a pixel layer to interleaved RGBA16
+ *
+ * Same conversion as psd_document_render_composite_rgba16(), over the
+ * layer's bounding box.
+ *
+ * @param doc Document (required)
+ * @param layer_index Layer index (0-based)
+ * @param out_rgba Output buffer, or NULL to query the size
+ * @param out_size Size of out_rgba in bytes
+ * @param out_required_size Receives width * height * 8 (can be NULL)
+ * @return PSD_OK on success, PSD_ERR_BUFFER_TOO_SMALL if out_rgba is NULL or
+ *         too small, or other error
+ */
+PSD_API psd_status_t psd_document_render_layer_rgba16(
+    psd_document_t *doc,
+    int32_t layer_index,
+    uint16_t *out_rgba,
+    size_t out_size,
+    size_t *out_required_size
+);
+
+/**
+ * @brief Convert a pixel layer to interleaved 32-bit float RGBA
+ *
+ * Same conversion as psd_document_render_composite_rgbaf32(), over the
+ * layer's bounding box.
+ *
+ * @param doc Document (required)
+ * @param layer_index Layer index (0-based)
+ * @param out_rgba Output buffer, or NULL to query the size
+ * @param out_size Size of out_rgba in bytes
+ * @param out_required_size Receives width * height * 16 (can be NULL)
+ * @return PSD_OK on success, PSD_ERR_BUFFER_TOO_SMALL if out_rgba is NULL or
+ *         too small, or other error
+ */
+PSD_API psd_status_t psd_document_render_layer_rgbaf32(
+    psd_document_t *doc,
+    int32_t layer_index,
+    float *out_rgba,
+    size_t out_size,
+    size_t *out_required_size
+);
+
+/**
+ * @brief Pixel layouts a render target can receive
+ */
+typedef enum {
+    PSD_PIXEL_FORMAT_RGBA8 = 0,  /**< Bytes R, G, B, A */
+    PSD_PIXEL_FORMAT_BGRA8 = 1,  /**< Bytes B, G, R, A */
+    PSD_PIXEL_FORMAT_ARGB32 = 2  /**< Native-endian uint32 0xAARRGGBB (Cairo ARGB32) */
+} psd_pixel_format_t;
+
+/**
+ * @brief Caller-owned destination for a render, written in its final layout
+ *
+ * Lets a render land directly in a toolkit surface or GPU upload buffer:
+ * rows are converted, swizzled and (optionally) premultiplied as they are
+ * produced, with no intermediate image.
+ */
+typedef struct {
+    uint8_t *pixels;             /**< Destination buffer (required) */
+    size_t size;                 /**< Bytes available at pixels */
+    size_t stride;               /**< Bytes between row starts; 0 = (x + width) * 4 */
+    psd_pixel_format_t format;   /**< Pixel layout */
+    bool premultiplied;          /**< Store color multiplied by alpha */
+    uint32_t x;                  /**< Column where the region's left edge lands */
+    uint32_t y;                  /**< Row where the region's top edge lands */
+} psd_render_target_t;
+
+/**
+ * @brief Render a region of the composite image into a render target
+ *
+ * Same conversion as psd_document_render_composite_rgba8_rect(); the region
+ * is written at (target->x, target->y) in the target's format and stride.
+ *
+ * @param doc Document to render (required)
+ * @param rect Region of the composite (NULL for the whole image); must lie
+ *             within it
+ * @param target Destination (required)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE if rect is outside the
+ *         image, PSD_ERR_INVALID_ARGUMENT for a stride narrower than the
+ *         region or an unknown format, PSD_ERR_BUFFER_TOO_SMALL if the
+ *         placed region does not fit in target->size, or other error
+ */
+PSD_API psd_status_t psd_document_render_composite_to_target(
+    const psd_document_t *doc,
+    const psd_rect_t *rect,
+    const psd_render_target_t *target
+);
+
+/**
+ * @brief Render a region of a pixel layer into a render target
+ *
+ * Same conversion as psd_document_render_layer_rgba8_rect(); the region is
+ * written at (target->x, target->y) in the target's format and stride.
+ *
+ * @param doc Document (required)
+ * @param layer_index Layer index (0-based)
+ * @param rect Region relative to the layer's bounding box (NULL for the whole
+ *             layer); must lie within it
+ * @param target Destination (required)
+ * @return As psd_document_render_composite_to_target()
+ */
+PSD_API psd_status_t psd_document_render_layer_to_target(
+    psd_document_t *doc,
+    int32_t layer_index,
+    const psd_rect_t *rect,
+    const psd_render_target_t *target
+);
+
+/**
+ * @brief Composite the document's layers into RGBA8
+ *
+ * Blends the layers bottom-up (record order) into interleaved, non-premultiplied
+ * RGBA8, honoring each layer's bounds, opacity, visibility (flags bit 1 set
+ * hides a layer), blend mode, clipping and group nesting, including
+ * pass-through groups. Layers that lie entirely outside rect are skipped
+ * without being decoded.
+ *
+ * Normal, multiply and screen use SIMD row kernels; the other blend modes take
+ * a per-pixel path. Layer masks, adjustment layers and layer effects are not
+ * applied, and layers can clip only to a pixel layer, not to a group.
+ *
+ * @param doc Document (required)
+ * @param rect Region in document coordinates (NULL for the whole canvas)
+ * @param out_rgba Receives the region's rows (required)
+ * @param out_stride Bytes between output rows (at least width * 4)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE if rect is outside the
+ *         canvas, PSD_ERR_UNSUPPORTED_FEATURE for 32-bit documents, or other
+ *         error
+ */
+PSD_API psd_status_t psd_document_flatten_rgba8(
+    psd_document_t *doc,
+    const psd_rect_t *rect,
+    uint8_t *out_rgba,
+    size_t out_stride
+);
+
+/**
+ * @brief Tiled cache of layer composites (opaque)
+ *
+ * Keeps each tile's composite together with snapshots of the canvas below
+ * every top-level group, so that after a layer change only the tiles under
+ * that layer are recomposed, starting from the nearest snapshot beneath it.
+ * A cache is tied to one document and must be destroyed before it.
+ */
+typedef struct psd_composite_cache psd_composite_cache_t;
+
+/**
+ * @brief Create a composite cache for a document
+ *
+ * @param doc Document to composite (required)
+ * @param tile_size Tile edge in pixels (0 for 256)
+ * @param max_bytes Memory budget for group snapshots (0 for no limit); tile
+ *                  composites are always kept
+ * @param out_cache Receives the cache (required)
+ * @return PSD_OK on success, PSD_ERR_UNSUPPORTED_FEATURE for 32-bit
+ *         documents, or other error
+ */
+PSD_API psd_status_t psd_composite_cache_create(
+    psd_document_t *doc,
+    uint32_t tile_size,
+    uint64_t max_bytes,
+    psd_composite_cache_t **out_cache
+);
+
+/**
+ * @brief Free a composite cache (NULL is ignored)
+ */
+PSD_API void psd_composite_cache_destroy(psd_composite_cache_t *cache);
+
+/**
+ * @brief Render a region of the layer composite through the cache
+ *
+ * Output matches psd_document_flatten_rgba8() for the same rect. Tiles
+ * composed earlier and not invalidated since are copied without touching any
+ * layer.
+ *
+ * @param cache Cache (required)
+ * @param rect Region in document coordinates (NULL for the whole canvas)
+ * @param out_rgba Receives the region's rows (required)
+ * @param out_stride Bytes between output rows (at least width * 4)
+ * @return PSD_OK on success, negative error code on failure
+ */
+PSD_API psd_status_t psd_composite_cache_render(
+    psd_composite_cache_t *cache,
+    const psd_rect_t *rect,
+    uint8_t *out_rgba,
+    size_t out_stride
+);
+
+/**
+ * @brief Drop cached pixels a layer change affects
+ *
+ * Call after changing a layer's opacity, visibility or blend mode. Only the
+ * tiles under the layer's bounds (a group's members' bounds for a group
+ * record) are recomposed on the next render.
+ *
+ * @param cache Cache (required)
+ * @param layer_index Layer index (0-based)
+ * @return PSD_OK on success, negative error code on failure
+ */
+PSD_API psd_status_t psd_composite_cache_invalidate_layer(
+    psd_composite_cache_t *cache,
+    int32_t layer_index
+);
+
+/**
+ * @brief Drop every cached pixel under a rect
+ *
+ * @param cache Cache (required)
+ * @param rect Region in document coordinates (NULL for the whole canvas)
+ * @return PSD_OK on success, negative error code on failure
+ */
+PSD_API psd_status_t psd_composite_cache_invalidate_rect(
+    psd_composite_cache_t *cache,
+    const psd_rect_t *rect
+);
+
+/**
+ * @brief Get layer channel info and decode on demand
+ *
+ * Returns information about a layer channel with lazy decoding support.
+ * The channel data is decompressed only when this function is called.
+ * Supports RAW and RLE formats. ZIP formats are returned as compressed.
+ *
+ * The data stays valid until psd_document_release_layer_pixels() for the
+ * layer or psd_document_free(), or, with a decode budget, until it is evicted
+ * (see psd_document_set_decode_budget()).
+ *
+ * @param doc Document to query (required)
+ * @param layer_index Layer index (0-based)
+ * @param channel_index Channel index within layer (0-based)
+ * @param channel_id Where to store channel ID (can be NULL)
+ * @param data Where to store decoded pixel data pointer (can be NULL)
+ * @param length Where to store decoded data length in bytes (can be NULL)
+ * @param compression Where to store original compression type (can be NULL)
+ * @return PSD_OK on success, negative error code on failure
+ */
+PSD_API psd_status_t psd_document_get_layer_channel_data(
+    psd_document_t *doc,
+    int32_t layer_index,
+    size_t channel_index,
+    int16_t *channel_id,
+    const uint8_t **data,
+    uint64_t *length,
+    uint32_t *compression
+);
+
+/**
+ * @brief Decode a layer channel straight into caller memory
+ *
+ * Decodes RAW, RLE, ZIP and ZIP-with-prediction channels into dst, for
+ * example a mapped staging buffer, without keeping a decoded copy in the
+ * document. Row y of the layer's bounding box is written at
+ * dst + y * dst_stride, as big-endian samples of the document depth (user
+ * masks are 8-bit); bytes between rows are left untouched. A row holds
+ * width * depth / 8 bytes, or (width + 7) / 8 for 1-bit documents. Channels
+ * already decoded by psd_document_get_layer_channel_data() are copied.
+ * Empty layers write nothing.
+ *
+ * No decoded plane is allocated: RAW rows are copied, and RLE and ZIP rows
+ * decode straight into place. Only the libdeflate backend and custom codecs
+ * (see psd_set_codec()), which inflate whole buffers, go through a temporary
+ * plane when dst_stride is wider than a row.
+ *
+ * @param doc Document (required; a deferred payload is read on demand)
+ * @param layer_index Layer index (0-based)
+ * @param channel_index Channel index within layer (0-based)
+ * @param dst Output, at least (height - 1) * dst_stride + row bytes long (required)
+ * @param dst_stride Bytes between the starts of consecutive rows
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT if dst_stride is shorter
+ *         than a row, PSD_ERR_UNSUPPORTED_COMPRESSION for ZIP channels when ZIP
+ *         support is not available, or another error code
+ */
+PSD_API psd_status_t psd_document_decode_layer_channel_into(
+    psd_document_t *doc,
+    int32_t layer_index,
+    size_t channel_index,
+    uint8_t *dst,
+    size_t dst_stride
+);
+
+/**
+ * @brief Task callback run by a psd_thread_pool_t
+ *
+ * @param task_data Context passed to parallel_for
+ * @param index Task index in [0, count)
+ */
+typedef void (*psd_task_fn)(void *task_data, size_t index);
+
+/**
+ * @brief Caller-supplied worker pool
+ *
+ * parallel_for must call fn(task_data, i) exactly once for every i in
+ * [0, count), on any threads and in any order, and return only after all of
+ * the calls have finished.
+ */
+typedef struct {
+    void (*parallel_for)(void *pool_data, size_t count, psd_task_fn fn, void *task_data);
+    void *pool_data;   /**< Passed to parallel_for */
+} psd_thread_pool_t;
+
+/**
+ * @brief Announce the layer payloads that are about to be read
+ *
+ * For documents parsed with PSD_PARSE_SKIP_LAYER_PIXELS from a stream with a
+ * prefetch callback, passes the byte ranges of the listed layers' payloads
+ * that are not in memory to that callback in one call, sorted and with
+ * neighbouring payloads merged. psd_document_flatten_rgba8(), the composite
+ * cache and psd_document_decode_all_layers() do this themselves for the
+ * layers they need. A no-op for other documents.
+ *
+ * @param doc Document (required)
+ * @param layer_indices Layers to prefetch (NULL for every layer)
+ * @param count Number of entries in layer_indices (ignored when it is NULL)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE for a bad index, or the
+ *         prefetch callback's error
+ */
+PSD_API psd_status_t psd_document_prefetch_layers(
+    psd_document_t *doc,
+    const int32_t *layer_indices,
+    size_t count
+);
+
+/**
+ * @brief Decode the pixel data of every layer channel
+ *
+ * Channel payloads deferred with PSD_PARSE_SKIP_LAYER_PIXELS are read from
+ * the source stream first, on the calling thread. The decodes then run as
+ * one task per channel on pool, or on built-in worker threads (one per
+ * online CPU) when pool is NULL. Each channel is decoded by exactly one task.
+ * Libraries built without thread support decode serially.
+ *
+ * The document must not be used from other threads during the call, and a
+ * custom allocator must be thread-safe. Afterwards
+ * psd_document_get_layer_channel_data() returns the decoded data directly.
+ *
+ * @param doc Document to decode (required)
+ * @param pool Worker pool (NULL for the built-in workers)
+ * @return PSD_OK on success, otherwise the error of a failed decode (other
+ *         channels are still decoded)
+ */
+PSD_API psd_status_t psd_document_decode_all_layers(
+    psd_document_t *doc,
+    const psd_thread_pool_t *pool
+);
+
+/**
+ * @brief Get the fingerprints of every layer
+ *
+ * Computes psd_document_get_layer_fingerprint() for all layers, one task per
+ * layer on pool, or on the built-in worker threads when pool is NULL.
+ * Deferred payloads are read first, on the calling thread. The same
+ * threading rules as psd_document_decode_all_layers() apply.
+ *
+ * @param doc Document (required)
+ * @param pool Worker pool (NULL for the built-in workers)
+ * @param out_fingerprints Receives one fingerprint per layer, in layer order
+ *        (required unless the document has no layers)
+ * @param capacity Number of entries out_fingerprints can hold
+ * @return PSD_OK on success, PSD_ERR_BUFFER_TOO_SMALL if capacity is below
+ *         the layer count, or the first error of a failed layer
+ */
+PSD_API psd_status_t psd_document_get_layer_fingerprints(
+    psd_document_t *doc,
+    const psd_thread_pool_t *pool,
+    uint64_t *out_fingerprints,
+    size_t capacity
+);
+
+/**
+ * @brief Bound the memory held by decoded layer pixels
+ *
+ * Decoded channel planes, and payloads read from the source stream of a
+ * deferred document (see psd_parse_with_options()), are kept for reuse, least
+ * recently used first out once they exceed max_bytes. Released channels are
+ * decoded again, or read again from the source stream, on their next use. A
+ * call never releases the channels of the layer it works on, so a single
+ * layer may exceed the budget. Payloads parsed into memory from a non-deferred
+ * stream are the only copy and stay.
+ *
+ * With a budget, data returned by psd_document_get_layer_channel_data() for
+ * other layers stays valid only until the next call that decodes or renders.
+ * Setting a lower budget releases the excess right away.
+ *
+ * @param doc Document (required)
+ * @param max_bytes Budget in bytes, 0 for unlimited (the default)
+ * @return PSD_OK on success, PSD_ERR_NULL_POINTER if doc is NULL
+ */
+PSD_API psd_status_t psd_document_set_decode_budget(
+    psd_document_t *doc,
+    uint64_t max_bytes
+);
+
+/**
+ * @brief Bytes of layer pixel memory held under the decode budget
+ *
+ * @param doc Document (required)
+ * @param bytes Receives the byte count (required)
+ * @return PSD_OK on success, PSD_ERR_NULL_POINTER on NULL arguments
+ */
+PSD_API psd_status_t psd_document_get_decode_cache_usage(
+    const psd_document_t *doc,
+    uint64_t *bytes
+);
+
+/**
+ * @brief Release the decoded pixels of a layer
+ *
+ * Frees the layer's decoded channel planes, and its payloads when they can be
+ * read again from a deferred source stream. They are decoded again on next
+ * use. Data pointers previously returned for the layer become invalid.
+ *
+ * @param doc Document (required)
+ * @param layer_index Layer index (0-based)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE for a bad index
+ */
+PSD_API psd_status_t psd_document_release_layer_pixels(
+    psd_document_t *doc,
+    int32_t layer_index
+);
+
+/**
+ * @brief Batch of documents processed on shared workers (opaque)
+ *
+ * A batch runs a queue of documents through parse and the requested jobs,
+ * several at a time. Each worker slot keeps its inflate states and output
+ * buffers from one document to the next, so a run allocates per document
+ * little more than the document itself.
+ */
+typedef struct psd_batch psd_batch_t;
+
+/**
+ * @brief Jobs a batch runs on every document
+ */
+typedef enum {
+    PSD_BATCH_COMPOSITE = 1u << 0, /**< Render the composite to RGBA8 */
+    PSD_BATCH_THUMBNAIL = 1u << 1, /**< Decode the embedded thumbnail to RGB8 */
+} psd_batch_job_flags_t;
+
+/**
+ * @brief Outcome of one batch document, passed to the batch callback
+ *
+ * Pixel buffers belong to the worker slot and are reused for its next
+ * document; copy them out if they are needed after the callback returns.
+ * Jobs that were not requested leave their status PSD_OK and buffer NULL.
+ */
+typedef struct {
+    size_t index;                    /**< Position in the batch queue */
+    void *item_data;                 /**< As passed when the document was added */
+    psd_status_t status;             /**< Open and parse status */
+    psd_document_t *doc;             /**< Parsed document (NULL on failure), freed after the callback */
+    psd_status_t composite_status;   /**< PSD_BATCH_COMPOSITE result */
+    const uint8_t *composite_rgba;   /**< Composite pixels, composite_width * 4 bytes per row */
+    uint32_t composite_width;        /**< Composite width in pixels */
+    uint32_t composite_height;       /**< Composite height in pixels */
+    psd_status_t thumbnail_status;   /**< PSD_BATCH_THUMBNAIL result */
+    const uint8_t *thumbnail_rgb;    /**< Thumbnail pixels, thumbnail_width * 3 bytes per row */
+    uint32_t thumbnail_width;        /**< Thumbnail width in pixels */
+    uint32_t thumbnail_height;       /**< Thumbnail height in pixels */
+} psd_batch_result_t;
+
+/**
+ * @brief Called once per batch document, on the worker that processed it
+ *
+ * Calls for different documents may run concurrently.
+ */
+typedef void (*psd_batch_callback_fn)(void *user_data, const psd_batch_result_t *result);
+
+/**
+ * @brief Batch settings
+ */
+typedef struct {
+    uint32_t jobs;             /**< Bitwise OR of psd_batch_job_flags_t values */
+    uint32_t parse_flags;      /**< psd_parse_flags_t used for every document */
+    uint32_t composite_level;  /**< Downsampling of PSD_BATCH_COMPOSITE, see
+                                    psd_document_render_composite_rgba8_scaled() */
+    size_t max_documents;      /**< Documents in flight at once (0 = one per online CPU) */
+    uint64_t decode_budget;    /**< Per-document psd_document_set_decode_budget() (0 = none) */
+    psd_batch_callback_fn callback; /**< Receives every result (required) */
+    void *user_data;           /**< Passed to callback */
+} psd_batch_options_t;
+
+/**
+ * @brief Create an empty batch
+ *
+ * @param allocator Allocator for the batch and its documents (NULL for the
+ *                  default); must be thread-safe
+ * @param options Settings (required, callback must be set)
+ * @param out_batch Receives the batch (required)
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT without a callback, or
+ *         PSD_ERR_OUT_OF_MEMORY
+ */
+PSD_API psd_status_t psd_batch_create(
+    const psd_allocator_t *allocator,
+    const psd_batch_options_t *options,
+    psd_batch_t **out_batch
+);
+
+/**
+ * @brief Destroy a batch (safe to call with NULL)
+ */
+PSD_API void psd_batch_destroy(psd_batch_t *batch);
+
+/**
+ * @brief Queue a document read from a caller's stream
+ *
+ * The stream must stay valid, and unused by others, until psd_batch_run()
+ * returns.
+ *
+ * @param batch Batch (required)
+ * @param stream Stream positioned at the start of the file (required)
+ * @param item_data Passed back in the document's result
+ * @return PSD_OK on success, or PSD_ERR_OUT_OF_MEMORY
+ */
+PSD_API psd_status_t psd_batch_add_stream(
+    psd_batch_t *batch,
+    psd_stream_t *stream,
+    void *item_data
+);
+
+/**
+ * @brief Queue a document by file path
+ *
+ * The file is memory-mapped only while its document is processed, so a long
+ * queue holds no open files.
+ *
+ * @param batch Batch (required)
+ * @param path Path of the file, copied (required)
+ * @param item_data Passed back in the document's result
+ * @return PSD_OK on success, or PSD_ERR_OUT_OF_MEMORY
+ */
+PSD_API psd_status_t psd_batch_add_file(
+    psd_batch_t *batch,
+    const char *path,
+    void *item_data
+);
+
+/**
+ * @brief Process every queued document and empty the queue
+ *
+ * At most max_documents documents are open at once and each is handled by a
+ * single worker, so a run scales across documents rather than within them.
+ * Once no document is left waiting for a worker, the remaining ones may also
+ * split RLE channel rows over the built-in workers, so the tail of a run does
+ * not leave cores idle (unless pool is given, which decides its own
+ * parallelism). Per-document failures are reported through the callback and
+ * do not stop the run.
+ *
+ * @param batch Batch (required)
+ * @param pool Worker pool (NULL for the built-in workers)
+ * @return PSD_OK once every document has been reported, or
+ *         PSD_ERR_OUT_OF_MEMORY if the worker slots could not be set up
+ */
+PSD_API psd_status_t psd_batch_run(
+    psd_batch_t *batch,
+    const psd_thread_pool_t *pool
+);
+
+/**
+ * @brief Push parser (opaque)
+ *
+ * Parses a file from bytes handed to it in chunks of any size, in file
+ * order, with no stream or seeking. Events are reported as soon as the bytes
+ * behind them have arrived: the header, the image resources, each layer
+ * record, each layer channel, and each composite row. Only the section part
+ * being read is buffered (one resource section, layer record, channel or RLE
+ * row); earlier sections are parsed into the parser's document and their
+ * bytes dropped.
+ */
+typedef struct psd_parser psd_parser_t;
+
+/**
+ * @brief Events of a push parser
+ *
+ * Any callback may be NULL. All of them run inside psd_parser_feed() or
+ * psd_parser_finish() on the calling thread, and receive the parser's
+ * document, which holds everything parsed so far and can be queried with the
+ * psd_document_* getters. A callback returning anything other than PSD_OK
+ * stops the parse with that status.
+ */
+typedef struct {
+    /** Header parsed: dimensions, depth, channels and color mode are known */
+    psd_status_t (*header)(void *user_data, psd_document_t *doc);
+    /** Color mode data and image resources parsed (thumbnail available) */
+    psd_status_t (*resources)(void *user_data, psd_document_t *doc);
+    /** Record layer_index parsed: bounds, name, blend mode, tagged blocks;
+     *  psd_document_get_layer_count() counts the records parsed so far */
+    psd_status_t (*layer_record)(void *user_data, psd_document_t *doc, int32_t layer_index);
+    /** Payload of one layer channel arrived. It can be decoded with
+     *  psd_document_decode_layer_channel_into() or
+     *  psd_document_get_layer_channel_data() during the call only; it is
+     *  dropped (with any decoded copy) when the callback returns */
+    psd_status_t (*layer_channel)(void *user_data, psd_document_t *doc, int32_t layer_index,
+                                  size_t channel_index);
+    /** Row y of composite plane channel decoded: row_bytes bytes of planar,
+     *  big-endian samples (packed bits for 1-bit documents), valid during the
+     *  call. Rows arrive plane by plane, top to bottom */
+    psd_status_t (*composite_row)(void *user_data, psd_document_t *doc, uint16_t channel,
+                                  uint32_t y, const uint8_t *row, size_t row_bytes);
+    void *user_data;
+} psd_parser_callbacks_t;
+
+/**
+ * @brief Create a push parser
+ *
+ * @param allocator Allocator for the parser and its document (NULL for the default)
+ * @param callbacks Events to report (copied; NULL for none)
+ * @param out_parser Receives the parser (required)
+ * @return PSD_OK on success, PSD_ERR_NULL_POINTER, or PSD_ERR_OUT_OF_MEMORY
+ */
+PSD_API psd_status_t psd_parser_create(
+    const psd_allocator_t *allocator,
+    const psd_parser_callbacks_t *callbacks,
+    psd_parser_t **out_parser
+);
+
+/**
+ * @brief Destroy a push parser and its document (safe to call with NULL)
+ */
+PSD_API void psd_parser_destroy(psd_parser_t *parser);
+
+/**
+ * @brief Hand the next bytes of the file to the parser
+ *
+ * Parses as far as the bytes allow and reports the events they complete.
+ * RAW and RLE composite rows are reported as each one arrives, and ZIP rows
+ * as they inflate, except with the libdeflate backend or a codec set with
+ * psd_set_codec(), which need the whole payload: their rows are reported by
+ * psd_parser_finish(). Composite compression this build cannot decode is
+ * skipped, as psd_parse() leaves such a document without a composite. Bytes
+ * after the composite are ignored. Once a call fails, every later call
+ * returns the same error.
+ *
+ * RLE byte counts are 2 bytes wide in PSD files and 4 in PSB files, and
+ * layer channel lengths 4 and 8, as the specification says; the width
+ * probing psd_parse() does for files that deviate needs the whole file.
+ *
+ * @param parser Parser (required)
+ * @param bytes Next bytes (may be NULL when length is 0)
+ * @param length Number of bytes
+ * @return PSD_OK on success, a parse error such as PSD_ERR_INVALID_FILE_FORMAT
+ *         or PSD_ERR_CORRUPT_DATA, a callback's status, or
+ *         PSD_ERR_INVALID_ARGUMENT after psd_parser_finish()
+ */
+PSD_API psd_status_t psd_parser_feed(
+    psd_parser_t *parser,
+    const void *bytes,
+    size_t length
+);
+
+/**
+ * @brief Signal the end of the file
+ *
+ * Reports the composite rows that were waiting for the whole payload. A file
+ * may end where the composite would start (the document then has none).
+ *
+ * @param parser Parser (required)
+ * @return PSD_OK if the file was complete, PSD_ERR_STREAM_EOF if it ended
+ *         early, or the error that stopped the parse
+ */
+PSD_API psd_status_t psd_parser_finish(psd_parser_t *parser);
+
+/**
+ * @brief Document a push parser fills in
+ *
+ * Metadata only: layer channel payloads and composite rows are not kept.
+ * The document belongs to the parser and is freed with it.
+ *
+ * @param parser Parser (required)
+ * @param out_doc Receives the document, NULL until the header has been parsed (required)
+ * @return PSD_OK on success, or PSD_ERR_NULL_POINTER
+ */
+PSD_API psd_status_t psd_parser_get_document(
+    const psd_parser_t *parser,
+    psd_document_t **out_doc
+);
+
+/**
+ * @brief Writer of PSD and PSB files (opaque)
+ *
+ * A writer serializes a document to a stream in file order: the header when
+ * it is created, then the color mode data and image resources as they are
+ * added, and the layer records, channel data and composite image when it is
+ * finished. Channels are compressed in parallel and each one is written as
+ * soon as it and every channel before it are ready; the length fields ahead
+ * of them are patched at the end with one seek back.
+ */
+typedef struct psd_writer psd_writer_t;
+
+/**
+ * @brief Document settings of a writer
+ */
+typedef struct {
+    uint32_t width;                 /**< Canvas width (1-30000, 1-300000 for PSB) */
+    uint32_t height;                /**< Canvas height (same limits) */
+    uint16_t channels;              /**< Composite channels (1-56) */
+    uint16_t depth;                 /**< Bits per sample: 1 (bitmap only), 8, 16 or 32 */
+    psd_color_mode_t color_mode;    /**< Color mode */
+    psd_bool_t psb;                 /**< Write a PSB (version 2) file */
+    psd_compression_t compression;  /**< Used for layer channels and the composite */
+    int32_t compression_level;      /**< ZIP level 1 (fastest) to 9 (smallest), 0 for the default */
+    const psd_thread_pool_t *pool;  /**< Compression workers (NULL for the built-in workers) */
+} psd_writer_options_t;
+
+/**
+ * @brief One channel of a layer to write
+ *
+ * Samples are big-endian, as stored in the file: rows of the layer's width
+ * (bits packed MSB first for 1-bit data), top to bottom.
+ */
+typedef struct {
+    int16_t id;               /**< 0.. for color channels, -1 for transparency */
+    const void *data;         /**< Samples (may be NULL for an empty layer) */
+    size_t stride;            /**< Bytes between rows (0 = tightly packed) */
+} psd_writer_channel_t;
+
+/**
+ * @brief One layer to write
+ *
+ * Layers are listed bottom first, as in the file.
+ */
+typedef struct {
+    psd_rect_t bounds;                       /**< Layer rectangle on the canvas */
+    uint32_t blend_key;                      /**< Blend mode key, e.g. 'mul ' (0 for 'norm') */
+    uint8_t opacity;                         /**< 0-255 */
+    uint8_t clipping;                        /**< 0 = base, 1 = clipped to the layer below */
+    uint8_t flags;                           /**< Layer flags (bit 1 hides the layer) */
+    const char *name;                        /**< Pascal name, up to 255 bytes (NULL for none) */
+    const psd_writer_channel_t *channels;    /**< Channels in file order */
+    uint16_t channel_count;                  /**< Number of channels (at most 56) */
+    const uint8_t *blocks;                   /**< Tagged blocks written after the name (may be NULL) */
+    size_t blocks_length;                    /**< Length of blocks (a multiple of 2) */
+} psd_writer_layer_t;
+
+/**
+ * @brief Create a writer and write the file header
+ *
+ * The stream must support write, seek and tell, and must stay valid until
+ * psd_writer_destroy(). During psd_writer_finish() its callbacks may be
+ * called from worker threads, one call at a time.
+ *
+ * @param stream Destination stream, positioned where the file starts (required)
+ * @param allocator Allocator for the writer and its buffers (NULL for the
+ *                  default); must be thread-safe
+ * @param options Document settings (required)
+ * @param out_writer Receives the writer (required)
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT for unsupported
+ *         settings, PSD_ERR_UNSUPPORTED_COMPRESSION for ZIP in a build
+ *         without a deflate backend, or a stream error code
+ */
+PSD_API psd_status_t psd_writer_create(
+    psd_stream_t *stream,
+    const psd_allocator_t *allocator,
+    const psd_writer_options_t *options,
+    psd_writer_t **out_writer
+);
+
+/**
+ * @brief Destroy a writer (safe to call with NULL)
+ *
+ * A writer destroyed before psd_writer_finish() leaves an incomplete file.
+ */
+PSD_API void psd_writer_destroy(psd_writer_t *writer);
+
+/**
+ * @brief Write the color mode data section
+ *
+ * Indexed documents need their 768-byte palette here and duotone documents
+ * their duotone data. Only allowed before any resource or layer is added;
+ * without a call the section is written empty.
+ *
+ * @param writer Writer (required)
+ * @param data Section contents (may be NULL when length is 0)
+ * @param length Length of data
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT when called too late,
+ *         or a stream error code
+ */
+PSD_API psd_status_t psd_writer_set_color_mode_data(
+    psd_writer_t *writer,
+    const uint8_t *data,
+    size_t length
+);
+
+/**
+ * @brief Write one image resource
+ *
+ * Resources are written right away with an empty name. Only allowed before
+ * any layer is added.
+ *
+ * @param writer Writer (required)
+ * @param id Resource ID
+ * @param data Resource data (may be NULL when length is 0)
+ * @param length Length of data (less than 4 GB)
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT when called too late,
+ *         or a stream error code
+ */
+PSD_API psd_status_t psd_writer_add_resource(
+    psd_writer_t *writer,
+    uint16_t id,
+    const uint8_t *data,
+    size_t length
+);
+
+/**
+ * @brief Queue a layer
+ *
+ * The description is copied, but the name, channel array, samples and blocks
+ * are read only by psd_writer_finish() and must stay valid until then.
+ *
+ * @param writer Writer (required)
+ * @param layer Layer to add (required)
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT for bad bounds,
+ *         channel IDs or missing samples, PSD_ERR_OUT_OF_RANGE past 32767
+ *         layers, or PSD_ERR_OUT_OF_MEMORY
+ */
+PSD_API psd_status_t psd_writer_add_layer(
+    psd_writer_t *writer,
+    const psd_writer_layer_t *layer
+);
+
+/**
+ * @brief Write the layers and the composite image, completing the file
+ *
+ * Layer channels are compressed on the workers and streamed out in order;
+ * the composite follows the global layer mask section. RLE rows that do not
+ * fit a PSD's 16-bit row counts are written uncompressed instead.
+ *
+ * @param writer Writer (required)
+ * @param planes One plane of width x height samples per composite channel
+ *               (required)
+ * @param stride Bytes between rows of each plane (0 = tightly packed)
+ * @return PSD_OK on success, or the first compression or stream error; the
+ *         writer accepts no further calls either way
+ */
+PSD_API psd_status_t psd_writer_finish(
+    psd_writer_t *writer,
+    const void *const *planes,
+    size_t stride
+);
+
+/**
+ * @brief Get layer raw descriptor data
+ *
+ * Returns the raw binary descriptor data for a layer (layer effects, text, etc).
+ * The descriptor structure is preserved as raw bytes for forward compatibility.
+ * Interpretation is left to the application.
+ *
+ * The effects descriptor ('lfx2') is preferred; otherwise the first tagged
+ * block that carries a descriptor is used. Sets NULL and 0 when the layer has
+ * none. The bytes alias the document and start at the descriptor's class
+ * name, after the block's version fields.
+ *
+ * @param doc Document to query (required)
+ * @param layer_index Layer index (0-based)
+ * @param descriptor_data Where to store raw descriptor bytes (can be NULL if no descriptor)
+ * @param descriptor_length Where to store descriptor data length (can be NULL)
+ * @return PSD_OK on success, negative error code on failure
+ */
+PSD_API psd_status_t psd_document_get_layer_descriptor(
+    const psd_document_t *doc,
+    int32_t layer_index,
+    const uint8_t **descriptor_data,
+    uint64_t *descriptor_length
+);
+
+/**
+ * @brief Get one of a layer's additional layer information blocks by key
+ *
+ * Tagged blocks are indexed while layer records are parsed; their payloads
+ * are returned in place, without copying. The key is the block's four
+ * characters packed big-endian, e.g. 0x6C667832 for 'lfx2'. A layer with the
+ * same key twice reports the first block.
+ *
+ * The descriptor outputs are filled only when requested: the block's
+ * ActionDescriptor ('lfx2', 'SoCo', 'GdFl', 'PtFl', 'SoLd', 'TySh', ...) is
+ * parsed on the first such call to find its extent and cached for later
+ * ones. Blocks without a descriptor set them to NULL and 0.
+ *
+ * @param doc Document to query (required)
+ * @param layer_index Layer index (0-based)
+ * @param key Block key
+ * @param data Receives the payload, without the 8BIM/key/length header (can be NULL)
+ * @param length Receives the payload length in bytes (can be NULL)
+ * @param descriptor_data Receives the descriptor inside the payload (can be NULL)
+ * @param descriptor_length Receives the descriptor length in bytes (can be NULL)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE for a bad layer index,
+ *         PSD_ERR_INVALID_ARGUMENT if the layer has no block with this key,
+ *         or PSD_ERR_CORRUPT_DATA if a requested descriptor does not parse
+ */
+PSD_API psd_status_t psd_document_get_layer_tagged_block(
+    const psd_document_t *doc,
+    int32_t layer_index,
+    uint32_t key,
+    const uint8_t **data,
+    uint64_t *length,
+    const uint8_t **descriptor_data,
+    uint64_t *descriptor_length
+);
+
+/**
+ * @brief A file embedded in the document for a smart object layer
+ *
+ * Embedded files are the 'liFD' entries of the document's linked layer
+ * blocks ('lnk2', 'lnkD', 'lnk3'). Only their headers are read while
+ * parsing; the file bytes stay in the source and are read through
+ * psd_document_open_embedded_stream() or psd_document_open_embedded().
+ */
+typedef struct {
+    const char *unique_id;  /**< ID the layer's SoLd/PlLd block refers to (valid while the document exists) */
+    const char *name;       /**< Original file name, UTF-8 (valid while the document exists) */
+    uint32_t file_type;     /**< File type packed big-endian, e.g. '8BPB' or 'png ' (0 if unset) */
+    uint64_t offset;        /**< Position of the file bytes in the document's source stream */
+    uint64_t length;        /**< File size in bytes */
+} psd_embedded_file_t;
+
+/**
+ * @brief Get the embedded file a smart object layer shows
+ *
+ * The layer's placed-layer data ('SoLd', 'SoLE' or 'PlLd') names the file by
+ * its unique ID.
+ *
+ * @param doc Document to query (required)
+ * @param layer_index Layer index (0-based)
+ * @param out_file Receives the file (required)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE for a bad layer index,
+ *         PSD_ERR_INVALID_ARGUMENT if the layer is not a smart object with
+ *         an embedded file (linked and external files are not embedded)
+ */
+PSD_API psd_status_t psd_document_get_layer_embedded_file(
+    const psd_document_t *doc,
+    int32_t layer_index,
+    psd_embedded_file_t *out_file
+);
+
+/**
+ * @brief Open a stream over the embedded file of a smart object layer
+ *
+ * Nothing is copied (see psd_stream_create_substream()). A document parsed
+ * from a memory-mapped file serves the bytes from the mapping, and the
+ * stream stays valid after the document is freed. Otherwise the bytes are
+ * read through the stream the document keeps for deferred loads, under the
+ * document's lock, so the new stream can be read while other threads use the
+ * document; the document and its stream must then outlive the new stream.
+ *
+ * @param doc Document the layer belongs to (required)
+ * @param layer_index Layer index (0-based)
+ * @param out_status Where to store status (can be NULL): the errors of
+ *        psd_document_get_layer_embedded_file(), or PSD_ERR_STREAM_INVALID
+ *        if the document was parsed from an unmapped stream without any
+ *        skip flag, so it no longer has a source to read from
+ * @return New stream (destroy with psd_stream_destroy()), NULL on failure
+ */
+PSD_API psd_stream_t* psd_document_open_embedded_stream(
+    psd_document_t *doc,
+    int32_t layer_index,
+    psd_status_t *out_status
+);
+
+/**
+ * @brief Parse the PSD/PSB file embedded in a smart object layer
+ *
+ * Parses the file through psd_document_open_embedded_stream(), with no
+ * copy of its bytes. With NULL options the nested document is parsed
+ * lazily (PSD_PARSE_SKIP_LAYER_PIXELS | PSD_PARSE_SKIP_COMPOSITE): layer
+ * and composite pixels are read when first used. The nested document owns
+ * its stream and can open its own embedded files in turn. When the
+ * document is not memory-mapped, the nested one reads through the same
+ * source stream, so free it first.
+ *
+ * @param doc Document the layer belongs to (required)
+ * @param layer_index Layer index (0-based)
+ * @param options Parse options for the nested document (NULL for lazy defaults)
+ * @param out_status Where to store status (can be NULL): the errors of
+ *        psd_document_open_embedded_stream(), or the parse error, e.g.
+ *        PSD_ERR_INVALID_FILE_FORMAT for an embedded PNG
+ * @return Parsed document (free with psd_document_free()), NULL on failure
+ */
+PSD_API psd_document_t* psd_document_open_embedded(
+    psd_document_t *doc,
+    int32_t layer_index,
+    const psd_parse_options_t *options,
+    psd_status_t *out_status
+);
+
+/**
+ * @brief Extract text content from a text layer
+ *
+ * Attempts to extract the actual text string from a text layer's descriptor data.
+ * This requires parsing the TySh descriptor which is expensive, so it's done on-demand.
+ *
+ * @param doc Document containing the text layer (required)
+ * @param layer_index Layer index (0-based)
+ * @param buffer Buffer to store extracted text
+ * @param buffer_size Size of buffer in bytes
+ * @return PSD_OK on success, negative error code on failure
+ */
+PSD_API psd_status_t psd_text_layer_get_text(
+    psd_document_t *doc,
+    uint32_t layer_index,
+    char *buffer,
+    size_t buffer_size
+);
+
+/**
+ * @brief Get the default (single-run) text style for a text layer
+ *
+ * Extraction of font name, size, color, tracking, leading, and justification.
+ * Returns the first style run; see psd_text_layer_get_style_runs() for all.
+ *
+ * @param doc Document containing the text layer (required)
+ * @param layer_index Layer index (0-based)
+ * @param out_style Output style structure (required)
+ * @return PSD_OK on success, or error on failure / unsupported structure
+ */
+PSD_API psd_status_t psd_text_layer_get_default_style(
+    psd_document_t *doc,
+    uint32_t layer_index,
+    psd_text_style_t *out_style
+);
+
+/**
+ * @brief Get every style run of a text layer
+ *
+ * Each run carries the resolved style of its character range: values the run
+ * does not set come from the document's normal style sheet. Call with
+ * runs = NULL and capacity = 0 to learn the count; out_count is set even when
+ * the array is too small.
+ *
+ * @param doc Document containing the text layer (required)
+ * @param layer_index Layer index (0-based)
+ * @param runs Output array (may be NULL when capacity is 0)
+ * @param capacity Number of entries in runs
+ * @param out_count Receives the number of runs (required)
+ * @return PSD_OK, PSD_ERR_BUFFER_TOO_SMALL (out_count still set), or error on
+ *         failure / unsupported structure
+ */
+PSD_API psd_status_t psd_text_layer_get_style_runs(
+    psd_document_t *doc,
+    uint32_t layer_index,
+    psd_text_style_run_t *runs,
+    size_t capacity,
+    size_t *out_count
+);
+
+/**
+ * @brief Get every paragraph run of a text layer
+ *
+ * Same calling convention as psd_text_layer_get_style_runs().
+ *
+ * @param doc Document containing the text layer (required)
+ * @param layer_index Layer index (0-based)
+ * @param runs Output array (may be NULL when capacity is 0)
+ * @param capacity Number of entries in runs
+ * @param out_count Receives the number of runs (required)
+ * @return PSD_OK, PSD_ERR_BUFFER_TOO_SMALL (out_count still set), or error on failure
+ */
+PSD_API psd_status_t psd_text_layer_get_paragraph_runs(
+    psd_document_t *doc,
+    uint32_t layer_index,
+    psd_text_paragraph_run_t *runs,
+    size_t capacity,
+    size_t *out_count
 );
 
 /**
@@ -102,11 +102,63 @@ typedef psd_status_t (*psd_stream_close_fn)(
     void *user_data
 );
 
+/**
+ * @brief Positional read callback
+ *
+ * Reads at an absolute offset without moving the stream position, so
+ * deferred loads need no seek round trip.
+ *
+ * @param stream Stream context
+ * @param offset Absolute position to read from
+ * @param buffer Where to store read data
+ * @param count Number of bytes to read
+ * @param user_data User-defined context
+ * @return Number of bytes actually read, or negative error code
+ */
+typedef int64_t (*psd_stream_read_at_fn)(
+    psd_stream_t *stream,
+    uint64_t offset,
+    void *buffer,
+    size_t count,
+    void *user_data
+);
+
+/**
+ * @brief Byte range of a stream
+ */
+typedef struct {
+    uint64_t offset;    /**< Absolute position */
+    uint64_t length;    /**< Number of bytes */
+} psd_stream_range_t;
+
+/**
+ * @brief Prefetch callback
+ *
+ * Announces ranges that are about to be read (sorted by offset and not
+ * overlapping), so a backend can fetch them in one batched request, or start
+ * asynchronous I/O that later reads then wait on. Purely a hint: the ranges
+ * are still read with read or read_at afterwards.
+ *
+ * @param stream Stream context
+ * @param ranges Ranges about to be read
+ * @param count Number of ranges
+ * @param user_data User-defined context
+ * @return PSD_OK, or a negative error code (reported to the caller only by
+ *         psd_stream_prefetch() and psd_document_prefetch_layers())
+ */
+typedef psd_status_t (*psd_stream_prefetch_fn)(
+    psd_stream_t *stream,
+    const psd_stream_range_t *ranges,
+    size_t count,
+    void *user_data
+);
+
 /**
  * @brief Virtual method table for stream operations
  *
- * All function pointers except close are required.
- * Close is optional (can be NULL for streams that don't need cleanup).
+ * read, write, seek and tell are required. close, read_at and prefetch are
+ * optional (NULL when the stream doesn't need cleanup or has no positional or
+ * batched reads).
  */
 typedef struct {
     psd_stream_read_fn read;     /**< Read data from stream (required) */
@@ -114,6 +166,8 @@ typedef struct {
     psd_stream_seek_fn seek;     /**< Seek to position (required) */
     psd_stream_tell_fn tell;     /**< Get current position (required) */
     psd_stream_close_fn close;   /**< Cleanup (optional) */
+    psd_stream_read_at_fn read_at;   /**< Read at an offset without seeking (optional) */
+    psd_stream_prefetch_fn prefetch; /**< Hint of ranges about to be read (optional) */
 } psd_stream_vtable_t;
 
 /**
@@ -133,6 +187,24 @@ PSD_API psd_stream_t* psd_stream_create_buffer(
     size_t length
 );
 
+/**
+ * @brief Create a stream over a memory-mapped file
+ *
+ * Maps the whole file read-only (mmap on POSIX, MapViewOfFile on Windows).
+ * Documents parsed from this stream do not copy layer channel payloads or
+ * image resource data; they point straight into the mapping and keep it
+ * alive, so the stream may be destroyed before the document is freed.
+ *
+ * @param allocator Memory allocator (can be NULL for default)
+ * @param path Path of the file to map
+ * @return New stream on success, NULL if the file cannot be opened, is empty,
+ *         or cannot be mapped
+ */
+PSD_API psd_stream_t* psd_stream_create_file_mmap(
+    const psd_allocator_t *allocator,
+    const char *path
+);
+
 /**
  * @brief Create a stream from custom operations
  *
@@ -150,6 +222,49 @@ PSD_API psd_stream_t* psd_stream_create_custom(
     void *user_data
 );
 
+/**
+ * @brief Create a stream over a byte range of another stream
+ *
+ * Nothing is copied. Over a buffer or memory-mapped stream the new stream
+ * reads the same memory; a mapped view keeps the mapping alive on its own
+ * and documents parsed from it borrow payloads from the mapping as usual.
+ * Over any other stream it reads through psd_stream_read_at() of the
+ * parent, which must then outlive it. A sub-stream of a sub-stream reads
+ * straight from the outermost stream.
+ *
+ * Positions of the new stream start at 0 at offset in the parent, and reads
+ * stop at length. The stream is read-only and uses the parent's allocator.
+ *
+ * @param parent Stream holding the bytes (required)
+ * @param offset Start of the range in the parent
+ * @param length Size of the range (non-zero)
+ * @return New stream on success, NULL if parent is NULL, length is 0, the
+ *         range does not fit a buffer or mapped parent, or memory runs out
+ */
+PSD_API psd_stream_t* psd_stream_create_substream(
+    psd_stream_t *parent,
+    uint64_t offset,
+    uint64_t length
+);
+
+/**
+ * @brief Set the read-ahead buffer size of a stream
+ *
+ * Custom streams buffer reads in a 64 KB window by default, so small reads,
+ * short skips and seeks that land inside the window never reach the
+ * callbacks; reads of at least size bytes go straight through. The window is
+ * dropped (and the callbacks repositioned) before writes and resizes. Buffer
+ * and memory-mapped streams read from memory and ignore this setting.
+ *
+ * Because the window reads ahead, the callbacks' own position runs ahead of
+ * psd_stream_tell() while it holds data.
+ *
+ * @param stream Stream to configure (required)
+ * @param size Window size in bytes (0 = unbuffered)
+ * @return PSD_OK on success, or the callback's error if repositioning fails
+ */
+PSD_API psd_status_t psd_stream_set_read_buffer(psd_stream_t *stream, size_t size);
+
 /**
  * @brief Destroy a stream
  *
@@ -209,6 +324,42 @@ PSD_API int64_t psd_stream_seek(psd_stream_t *stream, int64_t offset);
  */
 PSD_API int64_t psd_stream_tell(psd_stream_t *stream);
 
+/**
+ * @brief Read at an absolute offset without changing the position
+ *
+ * Uses the read_at callback when the stream has one; otherwise seeks, reads
+ * and seeks back.
+ *
+ * @param stream Stream to read from
+ * @param offset Absolute position to read from
+ * @param buffer Where to store data
+ * @param count Number of bytes to read
+ * @return Number of bytes read (short only at the end of the stream), or
+ *         negative error code
+ */
+PSD_API int64_t psd_stream_read_at(
+    psd_stream_t *stream,
+    uint64_t offset,
+    void *buffer,
+    size_t count
+);
+
+/**
+ * @brief Announce ranges that are about to be read
+ *
+ * Passes the ranges to the prefetch callback; a no-op for streams without one.
+ *
+ * @param stream Stream the ranges belong to
+ * @param ranges Ranges sorted by offset (can be NULL when count is 0)
+ * @param count Number of ranges
+ * @return PSD_OK, or the callback's error
+ */
+PSD_API psd_status_t psd_stream_prefetch(
+    psd_stream_t *stream,
+    const psd_stream_range_t *ranges,
+    size_t count
+);
+
 /**
  * @brief Read exactly the specified number of bytes
  *
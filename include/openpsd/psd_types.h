@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /**
  * @brief Boolean type for API returns (compatibility with C89)
@@ -134,6 +135,9 @@ typedef struct {
  *
  * Allows users to provide custom memory allocation functions.
  * All functions must have the same semantics as malloc/realloc/free.
+ *
+ * Documents take their metadata (layer records, names, resources,
+ * descriptors) from it in large chunks and allocate pixel buffers one by one.
  */
 typedef struct {
     /**
@@ -0,0 +1,237 @@
+/**
+ * @file psd_arena.c
+ * @brief Bump allocator for per-document metadata
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_arena.h"
+#include "psd_alloc.h"
+#include "psd_threads.h"
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+
+struct psd_arena_chunk {
+    psd_arena_chunk_t *prev;    /**< Previous large chunk (unused for bump chunks) */
+    psd_arena_chunk_t *next;    /**< Next chunk in its list */
+    max_align_t data[];         /**< Allocations */
+};
+
+/* Sits in front of every allocation; keeps the payload maximally aligned */
+typedef union {
+    struct {
+        size_t size;               /**< Requested size */
+        psd_arena_chunk_t *chunk;  /**< Dedicated chunk, NULL for bump allocations */
+    } h;
+    max_align_t align;
+} psd_arena_header_t;
+
+#define PSD_ARENA_ALIGN alignof(max_align_t)
+
+static size_t psd_arena_round(size_t size)
+{
+    return (size + (PSD_ARENA_ALIGN - 1)) & ~(size_t)(PSD_ARENA_ALIGN - 1);
+}
+
+static psd_arena_header_t *psd_arena_header(void *ptr)
+{
+    return (psd_arena_header_t *)ptr - 1;
+}
+
+/* Large allocation with a chunk of its own, freed back to the parent */
+static void *psd_arena_alloc_large(psd_arena_t *arena, size_t size)
+{
+    if (size > SIZE_MAX - sizeof(psd_arena_chunk_t) - sizeof(psd_arena_header_t)) {
+        return NULL;
+    }
+    psd_arena_chunk_t *chunk = (psd_arena_chunk_t *)psd_alloc_malloc(
+        arena->parent, sizeof(psd_arena_chunk_t) + sizeof(psd_arena_header_t) + size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->prev = NULL;
+    chunk->next = arena->large;
+    if (arena->large) {
+        arena->large->prev = chunk;
+    }
+    arena->large = chunk;
+
+    psd_arena_header_t *header = (psd_arena_header_t *)chunk->data;
+    header->h.size = size;
+    header->h.chunk = chunk;
+    return header + 1;
+}
+
+static void *psd_arena_alloc(psd_arena_t *arena, size_t size)
+{
+    if (size > PSD_ARENA_LARGE_SIZE) {
+        return psd_arena_alloc_large(arena, size);
+    }
+
+    size_t need = sizeof(psd_arena_header_t) + psd_arena_round(size);
+    if (!arena->cursor || (size_t)(arena->limit - arena->cursor) < need) {
+        psd_arena_chunk_t *chunk = (psd_arena_chunk_t *)psd_alloc_malloc(
+            arena->parent, sizeof(psd_arena_chunk_t) + PSD_ARENA_CHUNK_SIZE);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->prev = NULL;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->cursor = (unsigned char *)chunk->data;
+        arena->limit = arena->cursor + PSD_ARENA_CHUNK_SIZE;
+    }
+
+    psd_arena_header_t *header = (psd_arena_header_t *)arena->cursor;
+    arena->cursor += need;
+    header->h.size = size;
+    header->h.chunk = NULL;
+    arena->last = header + 1;
+    return arena->last;
+}
+
+static void psd_arena_free(psd_arena_t *arena, void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    psd_arena_header_t *header = psd_arena_header(ptr);
+    psd_arena_chunk_t *chunk = header->h.chunk;
+    if (chunk) {
+        if (chunk->prev) {
+            chunk->prev->next = chunk->next;
+        } else {
+            arena->large = chunk->next;
+        }
+        if (chunk->next) {
+            chunk->next->prev = chunk->prev;
+        }
+        psd_alloc_free(arena->parent, chunk);
+    } else if (ptr == arena->last) {
+        /* Roll back the most recent allocation */
+        arena->cursor = (unsigned char *)header;
+        arena->last = NULL;
+    }
+}
+
+static void *psd_arena_realloc(psd_arena_t *arena, void *ptr, size_t size)
+{
+    if (!ptr) {
+        return psd_arena_alloc(arena, size);
+    }
+    psd_arena_header_t *header = psd_arena_header(ptr);
+
+    if (header->h.chunk && size > PSD_ARENA_LARGE_SIZE) {
+        if (size > SIZE_MAX - sizeof(psd_arena_chunk_t) - sizeof(psd_arena_header_t)) {
+            return NULL;
+        }
+        psd_arena_chunk_t *chunk = (psd_arena_chunk_t *)psd_alloc_realloc(
+            arena->parent, header->h.chunk,
+            sizeof(psd_arena_chunk_t) + sizeof(psd_arena_header_t) + size);
+        if (!chunk) {
+            return NULL;
+        }
+        /* The chunk may have moved; relink its neighbours */
+        if (chunk->prev) {
+            chunk->prev->next = chunk;
+        } else {
+            arena->large = chunk;
+        }
+        if (chunk->next) {
+            chunk->next->prev = chunk;
+        }
+        header = (psd_arena_header_t *)chunk->data;
+        header->h.size = size;
+        header->h.chunk = chunk;
+        return header + 1;
+    }
+
+    if (!header->h.chunk && size <= PSD_ARENA_LARGE_SIZE) {
+        /* The latest allocation grows or shrinks in place */
+        if (ptr == arena->last &&
+            psd_arena_round(size) <= (size_t)(arena->limit - (unsigned char *)ptr)) {
+            arena->cursor = (unsigned char *)ptr + psd_arena_round(size);
+            header->h.size = size;
+            return ptr;
+        }
+        if (size <= header->h.size) {
+            header->h.size = size;
+            return ptr;
+        }
+    }
+
+    void *moved = psd_arena_alloc(arena, size);
+    if (!moved) {
+        return NULL;
+    }
+    memcpy(moved, ptr, header->h.size < size ? header->h.size : size);
+    psd_arena_free(arena, ptr);
+    return moved;
+}
+
+/* Lazy parses of a shared document allocate from several threads; the lock
+ * is held for one bump or chunk allocation */
+static void *psd_arena_malloc_cb(size_t size, void *user_data)
+{
+    psd_arena_t *arena = (psd_arena_t *)user_data;
+    psd_lock_acquire(&arena->lock);
+    void *ptr = psd_arena_alloc(arena, size);
+    psd_once_reset(&arena->lock);
+    return ptr;
+}
+
+static void *psd_arena_realloc_cb(void *ptr, size_t size, void *user_data)
+{
+    psd_arena_t *arena = (psd_arena_t *)user_data;
+    psd_lock_acquire(&arena->lock);
+    void *moved = psd_arena_realloc(arena, ptr, size);
+    psd_once_reset(&arena->lock);
+    return moved;
+}
+
+static void psd_arena_free_cb(void *ptr, void *user_data)
+{
+    psd_arena_t *arena = (psd_arena_t *)user_data;
+    psd_lock_acquire(&arena->lock);
+    psd_arena_free(arena, ptr);
+    psd_once_reset(&arena->lock);
+}
+
+void psd_arena_init(psd_arena_t *arena, const psd_allocator_t *parent)
+{
+    arena->allocator.malloc = psd_arena_malloc_cb;
+    arena->allocator.realloc = psd_arena_realloc_cb;
+    arena->allocator.free = psd_arena_free_cb;
+    arena->allocator.user_data = arena;
+    arena->parent = parent;
+    arena->chunks = NULL;
+    arena->large = NULL;
+    arena->cursor = NULL;
+    arena->limit = NULL;
+    arena->last = NULL;
+    psd_once_reset(&arena->lock);
+}
+
+void psd_arena_destroy(psd_arena_t *arena)
+{
+    psd_arena_chunk_t *lists[2] = { arena->chunks, arena->large };
+    for (size_t i = 0; i < 2; i++) {
+        psd_arena_chunk_t *chunk = lists[i];
+        while (chunk) {
+            psd_arena_chunk_t *next = chunk->next;
+            psd_alloc_free(arena->parent, chunk);
+            chunk = next;
+        }
+    }
+    psd_arena_init(arena, arena->parent);
+}
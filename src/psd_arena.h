@@ -0,0 +1,78 @@
+/**
+ * @file psd_arena.h
+ * @brief Bump allocator for per-document metadata
+ *
+ * Layer records, names, resource blocks, descriptors and text layer items are
+ * many small allocations that all live until the document is freed. The arena
+ * carves them out of large chunks taken from the document allocator and
+ * releases everything at once. Pixel buffers keep using the document
+ * allocator directly.
+ *
+ * The arena is exposed as a psd_allocator_t, so code written against an
+ * allocator can switch to it unchanged. Freeing is cheap: the most recent
+ * allocation is rolled back, large allocations (which get a chunk of their
+ * own) go back to the parent, and anything else waits for psd_arena_destroy().
+ * The arena is not thread-safe.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_ARENA_H
+#define PSD_ARENA_H
+
+#include <stddef.h>
+#include "psd_once.h"
+#include "../include/openpsd/psd_types.h"
+#include "../include/openpsd/psd_export.h"
+
+/** Size of the chunks small allocations are carved from */
+#define PSD_ARENA_CHUNK_SIZE ((size_t)64 * 1024)
+
+/** Allocations above this size get a chunk of their own */
+#define PSD_ARENA_LARGE_SIZE (PSD_ARENA_CHUNK_SIZE / 8)
+
+typedef struct psd_arena_chunk psd_arena_chunk_t;
+
+/**
+ * @brief Metadata arena
+ *
+ * Embed it in the owning object and hand &arena->allocator to allocating code.
+ * The allocator view may be used from several threads at once.
+ */
+typedef struct {
+    psd_allocator_t allocator;        /**< Allocator view of the arena (user_data = arena) */
+    const psd_allocator_t *parent;    /**< Where chunks come from (NULL for default) */
+    psd_arena_chunk_t *chunks;        /**< Bump chunks, current one first */
+    psd_arena_chunk_t *large;         /**< Dedicated chunks of large allocations */
+    unsigned char *cursor;            /**< Next free byte of the current chunk */
+    unsigned char *limit;             /**< End of the current chunk */
+    void *last;                       /**< Most recent bump allocation (may grow in place) */
+    psd_once_t lock;                  /**< Held by the allocator callbacks */
+} psd_arena_t;
+
+/**
+ * @brief Set up an empty arena
+ *
+ * Takes no memory until the first allocation.
+ *
+ * @param arena Arena to initialize
+ * @param parent Allocator chunks come from (NULL for default)
+ */
+PSD_INTERNAL void psd_arena_init(psd_arena_t *arena, const psd_allocator_t *parent);
+
+/**
+ * @brief Release every allocation made from the arena
+ *
+ * Leaves the arena empty and ready for reuse.
+ */
+PSD_INTERNAL void psd_arena_destroy(psd_arena_t *arena);
+
+#endif /* PSD_ARENA_H */
@@ -0,0 +1,253 @@
+/**
+ * @file psd_batch.c
+ * @brief Queue of documents processed on shared worker slots
+ *
+ * psd_batch_run() starts at most max_documents workers, each owning a slot:
+ * an inflate pool that its documents decode through, and composite and
+ * thumbnail buffers that only grow. Workers take queued documents in order,
+ * so memory is bounded by the slot count and the largest document per slot.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "psd_alloc.h"
+#include "psd_context.h"
+#include "psd_threads.h"
+#include "psd_zip.h"
+
+#include <string.h>
+
+#define PSD_BATCH_INITIAL_CAPACITY 16u
+
+typedef struct {
+    psd_stream_t *stream;   /* Caller's stream, or NULL when path is set */
+    char *path;             /* Owned copy, mapped while processed */
+    void *item_data;
+} psd_batch_item_t;
+
+typedef struct {
+    psd_zip_pool_t zip;     /* Shared by every document of the slot */
+    uint8_t *rgba;
+    size_t rgba_capacity;
+    uint8_t *rgb;
+    size_t rgb_capacity;
+} psd_batch_slot_t;
+
+struct psd_batch {
+    const psd_allocator_t *allocator;
+    psd_batch_options_t options;
+    psd_batch_item_t *items;
+    size_t count;
+    size_t capacity;
+
+    /* Valid during psd_batch_run() */
+    psd_batch_slot_t *slots;
+    bool rows_may_split;    /* No caller pool, so rows may use the built-in workers */
+};
+
+/* Grow a slot buffer to at least size bytes (contents are not kept) */
+static psd_status_t reserve(const psd_allocator_t *allocator, uint8_t **buffer,
+                            size_t *capacity, size_t size)
+{
+    if (size <= *capacity) return PSD_OK;
+    psd_alloc_free(allocator, *buffer);
+    *buffer = (uint8_t *)psd_alloc_malloc(allocator, size);
+    *capacity = *buffer ? size : 0;
+    return *buffer ? PSD_OK : PSD_ERR_OUT_OF_MEMORY;
+}
+
+static void run_composite(psd_batch_t *batch, psd_batch_slot_t *slot,
+                          psd_batch_result_t *result)
+{
+    size_t required = 0;
+    psd_status_t st = psd_document_render_composite_rgba8_scaled(
+        result->doc, batch->options.composite_level, NULL, 0, &required, NULL, NULL);
+    if (st == PSD_ERR_BUFFER_TOO_SMALL) {
+        st = reserve(batch->allocator, &slot->rgba, &slot->rgba_capacity, required);
+        if (st == PSD_OK) {
+            st = psd_document_render_composite_rgba8_scaled(
+                result->doc, batch->options.composite_level, slot->rgba, slot->rgba_capacity,
+                NULL, &result->composite_width, &result->composite_height);
+        }
+    }
+    result->composite_status = st;
+    if (st == PSD_OK) result->composite_rgba = slot->rgba;
+}
+
+static void run_thumbnail(psd_batch_t *batch, psd_batch_slot_t *slot,
+                          psd_batch_result_t *result)
+{
+    psd_thumbnail_t thumbnail;
+    size_t required = 0;
+    psd_status_t st = psd_document_get_thumbnail(result->doc, &thumbnail);
+    if (st == PSD_OK) {
+        st = psd_document_get_thumbnail_rgb8(result->doc, NULL, 0, &required);
+    }
+    if (st == PSD_ERR_BUFFER_TOO_SMALL) {
+        st = reserve(batch->allocator, &slot->rgb, &slot->rgb_capacity, required);
+        if (st == PSD_OK) {
+            st = psd_document_get_thumbnail_rgb8(result->doc, slot->rgb, slot->rgb_capacity,
+                                                 NULL);
+        }
+    }
+    result->thumbnail_status = st;
+    if (st == PSD_OK) {
+        result->thumbnail_rgb = slot->rgb;
+        result->thumbnail_width = thumbnail.width;
+        result->thumbnail_height = thumbnail.height;
+    }
+}
+
+static void process_item(void *task_data, size_t slot_index, size_t index)
+{
+    psd_batch_t *batch = (psd_batch_t *)task_data;
+    psd_batch_slot_t *slot = &batch->slots[slot_index];
+    psd_batch_item_t *item = &batch->items[index];
+
+    psd_batch_result_t result;
+    memset(&result, 0, sizeof(result));
+    result.index = index;
+    result.item_data = item->item_data;
+
+    psd_stream_t *stream = item->stream;
+    if (!stream) {
+        stream = psd_stream_create_file_mmap(batch->allocator, item->path);
+        if (!stream) result.status = PSD_ERR_STREAM_INVALID;
+    }
+
+    if (stream) {
+        psd_parse_options_t options = { batch->options.parse_flags, NULL };
+        result.doc = psd_parse_with_options(stream, batch->allocator, &options, &result.status);
+    }
+
+    if (result.doc) {
+        /* Workers are already busy with other documents while any are
+         * waiting, so rows are only split for the tail of the queue */
+        result.doc->zip = &slot->zip;
+        result.doc->serial_rows = !batch->rows_may_split || index + 1 < batch->count;
+        if (batch->options.decode_budget) {
+            psd_document_set_decode_budget(result.doc, batch->options.decode_budget);
+        }
+
+        if (batch->options.jobs & PSD_BATCH_COMPOSITE) run_composite(batch, slot, &result);
+        if (batch->options.jobs & PSD_BATCH_THUMBNAIL) run_thumbnail(batch, slot, &result);
+    }
+
+    batch->options.callback(batch->options.user_data, &result);
+
+    psd_document_free(result.doc);
+    if (stream && !item->stream) psd_stream_destroy(stream);
+}
+
+static psd_status_t push_item(psd_batch_t *batch, psd_stream_t *stream, char *path,
+                              void *item_data)
+{
+    if (batch->count == batch->capacity) {
+        size_t capacity = batch->capacity ? batch->capacity * 2 : PSD_BATCH_INITIAL_CAPACITY;
+        psd_batch_item_t *items = (psd_batch_item_t *)psd_alloc_realloc(
+            batch->allocator, batch->items, capacity * sizeof(*items));
+        if (!items) return PSD_ERR_OUT_OF_MEMORY;
+        batch->items = items;
+        batch->capacity = capacity;
+    }
+    batch->items[batch->count].stream = stream;
+    batch->items[batch->count].path = path;
+    batch->items[batch->count].item_data = item_data;
+    batch->count++;
+    return PSD_OK;
+}
+
+static void clear_items(psd_batch_t *batch)
+{
+    for (size_t i = 0; i < batch->count; i++) {
+        psd_alloc_free(batch->allocator, batch->items[i].path);
+    }
+    batch->count = 0;
+}
+
+PSD_API psd_status_t psd_batch_create(const psd_allocator_t *allocator,
+                                      const psd_batch_options_t *options,
+                                      psd_batch_t **out_batch)
+{
+    if (!options || !out_batch) return PSD_ERR_NULL_POINTER;
+    *out_batch = NULL;
+    if (!options->callback) return PSD_ERR_INVALID_ARGUMENT;
+
+    psd_batch_t *batch = (psd_batch_t *)psd_alloc_malloc(allocator, sizeof(*batch));
+    if (!batch) return PSD_ERR_OUT_OF_MEMORY;
+    memset(batch, 0, sizeof(*batch));
+    batch->allocator = allocator;
+    batch->options = *options;
+
+    *out_batch = batch;
+    return PSD_OK;
+}
+
+PSD_API void psd_batch_destroy(psd_batch_t *batch)
+{
+    if (!batch) return;
+    clear_items(batch);
+    psd_alloc_free(batch->allocator, batch->items);
+    psd_alloc_free(batch->allocator, batch);
+}
+
+PSD_API psd_status_t psd_batch_add_stream(psd_batch_t *batch, psd_stream_t *stream,
+                                          void *item_data)
+{
+    if (!batch || !stream) return PSD_ERR_NULL_POINTER;
+    return push_item(batch, stream, NULL, item_data);
+}
+
+PSD_API psd_status_t psd_batch_add_file(psd_batch_t *batch, const char *path, void *item_data)
+{
+    if (!batch || !path) return PSD_ERR_NULL_POINTER;
+
+    size_t length = strlen(path) + 1;
+    char *copy = (char *)psd_alloc_malloc(batch->allocator, length);
+    if (!copy) return PSD_ERR_OUT_OF_MEMORY;
+    memcpy(copy, path, length);
+
+    psd_status_t st = push_item(batch, NULL, copy, item_data);
+    if (st != PSD_OK) psd_alloc_free(batch->allocator, copy);
+    return st;
+}
+
+PSD_API psd_status_t psd_batch_run(psd_batch_t *batch, const psd_thread_pool_t *pool)
+{
+    if (!batch) return PSD_ERR_NULL_POINTER;
+    if (batch->count == 0) return PSD_OK;
+
+    size_t slot_count = batch->options.max_documents;
+    if (slot_count == 0) slot_count = psd_builtin_thread_count();
+    if (slot_count > batch->count) slot_count = batch->count;
+
+    batch->slots = (psd_batch_slot_t *)psd_alloc_malloc(batch->allocator,
+                                                        slot_count * sizeof(psd_batch_slot_t));
+    if (!batch->slots) return PSD_ERR_OUT_OF_MEMORY;
+    memset(batch->slots, 0, slot_count * sizeof(psd_batch_slot_t));
+    for (size_t i = 0; i < slot_count; i++) {
+        psd_zip_pool_init(&batch->slots[i].zip, batch->allocator);
+    }
+    batch->rows_may_split = (pool == NULL);
+
+    psd_parallel_for_slots(pool, slot_count, batch->count, process_item, batch);
+
+    for (size_t i = 0; i < slot_count; i++) {
+        psd_zip_pool_destroy(&batch->slots[i].zip);
+        psd_alloc_free(batch->allocator, batch->slots[i].rgba);
+        psd_alloc_free(batch->allocator, batch->slots[i].rgb);
+    }
+    psd_alloc_free(batch->allocator, batch->slots);
+    batch->slots = NULL;
+    clear_items(batch);
+    return PSD_OK;
+}
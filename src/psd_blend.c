@@ -0,0 +1,549 @@
+/**
+ * @file psd_blend.c
+ * @brief Per-row blend kernels for layer compositing
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_blend.h"
+
+#include <math.h>
+#include <stdbool.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PSD_BLEND_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define PSD_BLEND_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define PSD_BLEND_KEY(a, b, c, d) \
+    (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+psd_blend_mode_t psd_blend_mode_from_key(uint32_t key)
+{
+    static const struct {
+        uint32_t key;
+        psd_blend_mode_t mode;
+    } keys[] = {
+        { PSD_BLEND_KEY('p', 'a', 's', 's'), PSD_BLEND_PASS_THROUGH },
+        { PSD_BLEND_KEY('n', 'o', 'r', 'm'), PSD_BLEND_NORMAL },
+        { PSD_BLEND_KEY('d', 'i', 's', 's'), PSD_BLEND_NORMAL },
+        { PSD_BLEND_KEY('d', 'a', 'r', 'k'), PSD_BLEND_DARKEN },
+        { PSD_BLEND_KEY('m', 'u', 'l', ' '), PSD_BLEND_MULTIPLY },
+        { PSD_BLEND_KEY('i', 'd', 'i', 'v'), PSD_BLEND_COLOR_BURN },
+        { PSD_BLEND_KEY('l', 'b', 'r', 'n'), PSD_BLEND_LINEAR_BURN },
+        { PSD_BLEND_KEY('d', 'k', 'C', 'l'), PSD_BLEND_DARKER_COLOR },
+        { PSD_BLEND_KEY('l', 'i', 't', 'e'), PSD_BLEND_LIGHTEN },
+        { PSD_BLEND_KEY('s', 'c', 'r', 'n'), PSD_BLEND_SCREEN },
+        { PSD_BLEND_KEY('d', 'i', 'v', ' '), PSD_BLEND_COLOR_DODGE },
+        { PSD_BLEND_KEY('l', 'd', 'd', 'g'), PSD_BLEND_LINEAR_DODGE },
+        { PSD_BLEND_KEY('l', 'g', 'C', 'l'), PSD_BLEND_LIGHTER_COLOR },
+        { PSD_BLEND_KEY('o', 'v', 'e', 'r'), PSD_BLEND_OVERLAY },
+        { PSD_BLEND_KEY('s', 'L', 'i', 't'), PSD_BLEND_SOFT_LIGHT },
+        { PSD_BLEND_KEY('h', 'L', 'i', 't'), PSD_BLEND_HARD_LIGHT },
+        { PSD_BLEND_KEY('v', 'L', 'i', 't'), PSD_BLEND_VIVID_LIGHT },
+        { PSD_BLEND_KEY('l', 'L', 'i', 't'), PSD_BLEND_LINEAR_LIGHT },
+        { PSD_BLEND_KEY('p', 'L', 'i', 't'), PSD_BLEND_PIN_LIGHT },
+        { PSD_BLEND_KEY('h', 'M', 'i', 'x'), PSD_BLEND_HARD_MIX },
+        { PSD_BLEND_KEY('d', 'i', 'f', 'f'), PSD_BLEND_DIFFERENCE },
+        { PSD_BLEND_KEY('s', 'm', 'u', 'd'), PSD_BLEND_EXCLUSION },
+        { PSD_BLEND_KEY('f', 's', 'u', 'b'), PSD_BLEND_SUBTRACT },
+        { PSD_BLEND_KEY('f', 'd', 'i', 'v'), PSD_BLEND_DIVIDE },
+        { PSD_BLEND_KEY('h', 'u', 'e', ' '), PSD_BLEND_HUE },
+        { PSD_BLEND_KEY('s', 'a', 't', ' '), PSD_BLEND_SATURATION },
+        { PSD_BLEND_KEY('c', 'o', 'l', 'r'), PSD_BLEND_COLOR },
+        { PSD_BLEND_KEY('l', 'u', 'm', ' '), PSD_BLEND_LUMINOSITY },
+    };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        if (keys[i].key == key) {
+            return keys[i].mode;
+        }
+    }
+    return PSD_BLEND_NORMAL;
+}
+
+/* ----------------------------
+ * Integer kernels (normal, multiply, screen)
+ *
+ * x / 255 rounded to nearest, exact for 0 <= x <= 255 * 255. With
+ * premultiplied inputs the alpha lane follows the same formula as the color
+ * lanes, so every lane is treated alike.
+ * ---------------------------- */
+
+static inline unsigned div255(unsigned x)
+{
+    x += 128u;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline uint8_t clamp_u8(unsigned v)
+{
+    return (uint8_t)(v > 255u ? 255u : v);
+}
+
+static void normal_scalar(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    for (size_t i = 0; i < count * 4u; i += 4) {
+        unsigned inv = 255u - src[i + 3];
+        for (size_t k = 0; k < 4; k++) {
+            dst[i + k] = clamp_u8(src[i + k] + div255(dst[i + k] * inv));
+        }
+    }
+}
+
+static void multiply_scalar(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    for (size_t i = 0; i < count * 4u; i += 4) {
+        unsigned sinv = 255u - src[i + 3];
+        unsigned dinv = 255u - dst[i + 3];
+        for (size_t k = 0; k < 4; k++) {
+            unsigned s = src[i + k];
+            unsigned d = dst[i + k];
+            dst[i + k] = clamp_u8(div255(s * dinv + d * sinv + s * d));
+        }
+    }
+}
+
+static void screen_scalar(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    for (size_t i = 0; i < count * 4u; i++) {
+        unsigned s = src[i];
+        unsigned d = dst[i];
+        dst[i] = clamp_u8(s + d - div255(s * d));
+    }
+}
+
+#if defined(PSD_BLEND_SSE2)
+
+static inline __m128i div255_epu16(__m128i x)
+{
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/* Alpha of each of two widened pixels, in all four of its lanes */
+static inline __m128i alpha_epu16(__m128i px)
+{
+    px = _mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_shufflehi_epi16(px, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static inline __m128i normal_epu16(__m128i s, __m128i d)
+{
+    __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), alpha_epu16(s));
+    return _mm_add_epi16(s, div255_epu16(_mm_mullo_epi16(d, inv)));
+}
+
+static inline __m128i multiply_epu16(__m128i s, __m128i d)
+{
+    __m128i sinv = _mm_sub_epi16(_mm_set1_epi16(255), alpha_epu16(s));
+    __m128i dinv = _mm_sub_epi16(_mm_set1_epi16(255), alpha_epu16(d));
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(s, dinv), _mm_mullo_epi16(d, sinv));
+    return div255_epu16(_mm_add_epi16(sum, _mm_mullo_epi16(s, d)));
+}
+
+static inline __m128i screen_epu16(__m128i s, __m128i d)
+{
+    return _mm_sub_epi16(_mm_add_epi16(s, d), div255_epu16(_mm_mullo_epi16(s, d)));
+}
+
+#define PSD_BLEND_SSE2_ROW(NAME, OP)                                                  \
+static size_t NAME(uint8_t *dst, const uint8_t *src, size_t count)                    \
+{                                                                                     \
+    const __m128i zero = _mm_setzero_si128();                                         \
+    size_t i = 0;                                                                     \
+    for (; i + 4 <= count; i += 4) {                                                  \
+        __m128i s = _mm_loadu_si128((const __m128i *)(const void *)(src + i * 4));    \
+        __m128i d = _mm_loadu_si128((const __m128i *)(const void *)(dst + i * 4));    \
+        __m128i lo = OP(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));      \
+        __m128i hi = OP(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));      \
+        _mm_storeu_si128((__m128i *)(void *)(dst + i * 4), _mm_packus_epi16(lo, hi)); \
+    }                                                                                 \
+    return i;                                                                         \
+}
+
+PSD_BLEND_SSE2_ROW(normal_simd, normal_epu16)
+PSD_BLEND_SSE2_ROW(multiply_simd, multiply_epu16)
+PSD_BLEND_SSE2_ROW(screen_simd, screen_epu16)
+
+#elif defined(PSD_BLEND_NEON)
+
+static inline uint8x8_t div255_u16(uint16x8_t x)
+{
+    x = vaddq_u16(x, vdupq_n_u16(128));
+    return vqmovn_u16(vshrq_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8));
+}
+
+/* Alpha of each of four pixels, in all four of its bytes */
+static inline uint8x16_t alpha_u8(uint8x16_t px)
+{
+    uint32x4_t a = vshrq_n_u32(vreinterpretq_u32_u8(px), 24);
+    return vreinterpretq_u8_u32(vmulq_n_u32(a, 0x01010101u));
+}
+
+static inline uint8x16_t normal_u8(uint8x16_t s, uint8x16_t d)
+{
+    uint8x16_t inv = vmvnq_u8(alpha_u8(s));
+    uint8x8_t lo = div255_u16(vmull_u8(vget_low_u8(d), vget_low_u8(inv)));
+    uint8x8_t hi = div255_u16(vmull_u8(vget_high_u8(d), vget_high_u8(inv)));
+    return vqaddq_u8(s, vcombine_u8(lo, hi));
+}
+
+static inline uint8x16_t multiply_u8(uint8x16_t s, uint8x16_t d)
+{
+    uint8x16_t sinv = vmvnq_u8(alpha_u8(s));
+    uint8x16_t dinv = vmvnq_u8(alpha_u8(d));
+    uint16x8_t lo = vmull_u8(vget_low_u8(s), vget_low_u8(dinv));
+    lo = vmlal_u8(lo, vget_low_u8(d), vget_low_u8(sinv));
+    lo = vmlal_u8(lo, vget_low_u8(s), vget_low_u8(d));
+    uint16x8_t hi = vmull_u8(vget_high_u8(s), vget_high_u8(dinv));
+    hi = vmlal_u8(hi, vget_high_u8(d), vget_high_u8(sinv));
+    hi = vmlal_u8(hi, vget_high_u8(s), vget_high_u8(d));
+    return vcombine_u8(div255_u16(lo), div255_u16(hi));
+}
+
+static inline uint8x16_t screen_u8(uint8x16_t s, uint8x16_t d)
+{
+    uint8x8_t lo = div255_u16(vmull_u8(vget_low_u8(s), vget_low_u8(d)));
+    uint8x8_t hi = div255_u16(vmull_u8(vget_high_u8(s), vget_high_u8(d)));
+    return vqsubq_u8(vqaddq_u8(s, d), vcombine_u8(lo, hi));
+}
+
+#define PSD_BLEND_NEON_ROW(NAME, OP)                                   \
+static size_t NAME(uint8_t *dst, const uint8_t *src, size_t count)     \
+{                                                                      \
+    size_t i = 0;                                                      \
+    for (; i + 4 <= count; i += 4) {                                   \
+        vst1q_u8(dst + i * 4, OP(vld1q_u8(src + i * 4), vld1q_u8(dst + i * 4))); \
+    }                                                                  \
+    return i;                                                          \
+}
+
+PSD_BLEND_NEON_ROW(normal_simd, normal_u8)
+PSD_BLEND_NEON_ROW(multiply_simd, multiply_u8)
+PSD_BLEND_NEON_ROW(screen_simd, screen_u8)
+
+#else
+
+static size_t normal_simd(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    (void)dst; (void)src; (void)count;
+    return 0;
+}
+#define multiply_simd normal_simd
+#define screen_simd normal_simd
+
+#endif
+
+/* ----------------------------
+ * Generic modes: W3C compositing with a per-pixel blend function
+ * ---------------------------- */
+
+static float blend_channel(psd_blend_mode_t mode, float cb, float cs)
+{
+    switch (mode) {
+    case PSD_BLEND_DARKEN:
+        return cb < cs ? cb : cs;
+    case PSD_BLEND_MULTIPLY:
+        return cb * cs;
+    case PSD_BLEND_COLOR_BURN:
+        if (cb >= 1.0f) return 1.0f;
+        if (cs <= 0.0f) return 0.0f;
+        return 1.0f - fminf(1.0f, (1.0f - cb) / cs);
+    case PSD_BLEND_LINEAR_BURN:
+        return fmaxf(0.0f, cb + cs - 1.0f);
+    case PSD_BLEND_LIGHTEN:
+        return cb > cs ? cb : cs;
+    case PSD_BLEND_SCREEN:
+        return cb + cs - cb * cs;
+    case PSD_BLEND_COLOR_DODGE:
+        if (cb <= 0.0f) return 0.0f;
+        if (cs >= 1.0f) return 1.0f;
+        return fminf(1.0f, cb / (1.0f - cs));
+    case PSD_BLEND_LINEAR_DODGE:
+        return fminf(1.0f, cb + cs);
+    case PSD_BLEND_OVERLAY:
+        return blend_channel(PSD_BLEND_HARD_LIGHT, cs, cb);
+    case PSD_BLEND_SOFT_LIGHT:
+        if (cs <= 0.5f) return cb - (1.0f - 2.0f * cs) * cb * (1.0f - cb);
+        {
+            float d = (cb <= 0.25f) ? ((16.0f * cb - 12.0f) * cb + 4.0f) * cb : sqrtf(cb);
+            return cb + (2.0f * cs - 1.0f) * (d - cb);
+        }
+    case PSD_BLEND_HARD_LIGHT:
+        if (cs <= 0.5f) return cb * 2.0f * cs;
+        return blend_channel(PSD_BLEND_SCREEN, cb, 2.0f * cs - 1.0f);
+    case PSD_BLEND_VIVID_LIGHT:
+        if (cs <= 0.5f) return blend_channel(PSD_BLEND_COLOR_BURN, cb, 2.0f * cs);
+        return blend_channel(PSD_BLEND_COLOR_DODGE, cb, 2.0f * cs - 1.0f);
+    case PSD_BLEND_LINEAR_LIGHT:
+        return fminf(1.0f, fmaxf(0.0f, cb + 2.0f * cs - 1.0f));
+    case PSD_BLEND_PIN_LIGHT:
+        if (cs <= 0.5f) return fminf(cb, 2.0f * cs);
+        return fmaxf(cb, 2.0f * cs - 1.0f);
+    case PSD_BLEND_HARD_MIX:
+        return (cb + cs >= 1.0f) ? 1.0f : 0.0f;
+    case PSD_BLEND_DIFFERENCE:
+        return fabsf(cb - cs);
+    case PSD_BLEND_EXCLUSION:
+        return cb + cs - 2.0f * cb * cs;
+    case PSD_BLEND_SUBTRACT:
+        return fmaxf(0.0f, cb - cs);
+    case PSD_BLEND_DIVIDE:
+        if (cs <= 0.0f) return cb > 0.0f ? 1.0f : 0.0f;
+        return fminf(1.0f, cb / cs);
+    default:
+        return cs;
+    }
+}
+
+static float lum(const float c[3])
+{
+    return 0.3f * c[0] + 0.59f * c[1] + 0.11f * c[2];
+}
+
+static void clip_color(float c[3])
+{
+    float l = lum(c);
+    float n = fminf(c[0], fminf(c[1], c[2]));
+    float x = fmaxf(c[0], fmaxf(c[1], c[2]));
+    for (int k = 0; k < 3; k++) {
+        if (n < 0.0f && l - n > 0.0f) c[k] = l + (c[k] - l) * l / (l - n);
+        if (x > 1.0f && x - l > 0.0f) c[k] = l + (c[k] - l) * (1.0f - l) / (x - l);
+    }
+}
+
+static void set_lum(float c[3], float l)
+{
+    float d = l - lum(c);
+    for (int k = 0; k < 3; k++) c[k] += d;
+    clip_color(c);
+}
+
+static float sat(const float c[3])
+{
+    return fmaxf(c[0], fmaxf(c[1], c[2])) - fminf(c[0], fminf(c[1], c[2]));
+}
+
+static void set_sat(float c[3], float s)
+{
+    int lo = 0, mid = 1, hi = 2, t;
+    if (c[lo] > c[mid]) { t = lo; lo = mid; mid = t; }
+    if (c[mid] > c[hi]) { t = mid; mid = hi; hi = t; }
+    if (c[lo] > c[mid]) { t = lo; lo = mid; mid = t; }
+    if (c[hi] > c[lo]) {
+        c[mid] = (c[mid] - c[lo]) * s / (c[hi] - c[lo]);
+        c[hi] = s;
+    } else {
+        c[mid] = 0.0f;
+        c[hi] = 0.0f;
+    }
+    c[lo] = 0.0f;
+}
+
+static void blend_nonseparable(psd_blend_mode_t mode, const float cb[3], const float cs[3],
+                               float out[3])
+{
+    for (int k = 0; k < 3; k++) out[k] = cs[k];
+    switch (mode) {
+    case PSD_BLEND_HUE:
+        set_sat(out, sat(cb));
+        set_lum(out, lum(cb));
+        break;
+    case PSD_BLEND_SATURATION:
+        for (int k = 0; k < 3; k++) out[k] = cb[k];
+        set_sat(out, sat(cs));
+        set_lum(out, lum(cb));
+        break;
+    case PSD_BLEND_COLOR:
+        set_lum(out, lum(cb));
+        break;
+    case PSD_BLEND_LUMINOSITY:
+        for (int k = 0; k < 3; k++) out[k] = cb[k];
+        set_lum(out, lum(cs));
+        break;
+    case PSD_BLEND_DARKER_COLOR:
+        if (lum(cb) < lum(cs)) for (int k = 0; k < 3; k++) out[k] = cb[k];
+        break;
+    case PSD_BLEND_LIGHTER_COLOR:
+        if (lum(cb) > lum(cs)) for (int k = 0; k < 3; k++) out[k] = cb[k];
+        break;
+    default:
+        break;
+    }
+}
+
+static bool mode_is_nonseparable(psd_blend_mode_t mode)
+{
+    return mode == PSD_BLEND_HUE || mode == PSD_BLEND_SATURATION || mode == PSD_BLEND_COLOR ||
+           mode == PSD_BLEND_LUMINOSITY || mode == PSD_BLEND_DARKER_COLOR ||
+           mode == PSD_BLEND_LIGHTER_COLOR;
+}
+
+static void generic_row(psd_blend_mode_t mode, uint8_t *dst, const uint8_t *src, size_t count)
+{
+    const bool nonseparable = mode_is_nonseparable(mode);
+    for (size_t i = 0; i < count * 4u; i += 4) {
+        const uint8_t *s = src + i;
+        uint8_t *d = dst + i;
+        if (s[3] == 0) continue;
+        if (d[3] == 0) {
+            for (size_t k = 0; k < 4; k++) d[k] = s[k];
+            continue;
+        }
+
+        float sa = (float)s[3] / 255.0f;
+        float da = (float)d[3] / 255.0f;
+        float cs[3], cb[3], b[3];
+        for (int k = 0; k < 3; k++) {
+            cs[k] = fminf(1.0f, (float)s[k] / (float)s[3]);
+            cb[k] = fminf(1.0f, (float)d[k] / (float)d[3]);
+        }
+        if (nonseparable) {
+            blend_nonseparable(mode, cb, cs, b);
+        } else {
+            for (int k = 0; k < 3; k++) b[k] = blend_channel(mode, cb[k], cs[k]);
+        }
+
+        unsigned alpha = (unsigned)s[3] + d[3] - div255((unsigned)s[3] * d[3]);
+        for (int k = 0; k < 3; k++) {
+            float r = (float)s[k] * (1.0f - da) + (float)d[k] * (1.0f - sa) +
+                      255.0f * sa * da * fminf(1.0f, fmaxf(0.0f, b[k]));
+            unsigned v = (unsigned)(r + 0.5f);
+            d[k] = (uint8_t)(v > alpha ? alpha : v);
+        }
+        d[3] = (uint8_t)alpha;
+    }
+}
+
+void psd_blend_row(psd_blend_mode_t mode, uint8_t *dst, const uint8_t *src, size_t count)
+{
+    size_t done = 0;
+    switch (mode) {
+    case PSD_BLEND_PASS_THROUGH:
+    case PSD_BLEND_NORMAL:
+        done = normal_simd(dst, src, count);
+        normal_scalar(dst + done * 4u, src + done * 4u, count - done);
+        break;
+    case PSD_BLEND_MULTIPLY:
+        done = multiply_simd(dst, src, count);
+        multiply_scalar(dst + done * 4u, src + done * 4u, count - done);
+        break;
+    case PSD_BLEND_SCREEN:
+        done = screen_simd(dst, src, count);
+        screen_scalar(dst + done * 4u, src + done * 4u, count - done);
+        break;
+    default:
+        generic_row(mode, dst, src, count);
+        break;
+    }
+}
+
+void psd_blend_row_atop(psd_blend_mode_t mode, uint8_t *dst, const uint8_t *src,
+                        size_t count, uint8_t *alpha)
+{
+    for (size_t i = 0; i < count; i++) alpha[i] = dst[i * 4u + 3];
+    psd_blend_row(mode, dst, src, count);
+
+    /* Source-atop drops the S * (1 - Da) term and keeps Da */
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *d = dst + i * 4u;
+        const uint8_t *s = src + i * 4u;
+        unsigned da = alpha[i];
+        for (size_t k = 0; k < 3; k++) {
+            unsigned drop = div255((unsigned)s[k] * (255u - da));
+            unsigned v = d[k] > drop ? d[k] - drop : 0u;
+            d[k] = (uint8_t)(v > da ? da : v);
+        }
+        d[3] = (uint8_t)da;
+    }
+}
+
+void psd_blend_premultiply_row(uint8_t *dst, const uint8_t *src, size_t count, uint8_t opacity)
+{
+    size_t i = 0;
+
+#if defined(PSD_BLEND_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i op = _mm_set1_epi16((short)opacity);
+    const __m128i alpha_255 = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    const __m128i alpha_mask = _mm_cmpeq_epi16(alpha_255, _mm_set1_epi16(255));
+    for (; i + 4 <= count; i += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i *)(const void *)(src + i * 4));
+        __m128i lo = _mm_unpacklo_epi8(px, zero);
+        __m128i hi = _mm_unpackhi_epi8(px, zero);
+        /* Effective alpha, then colors (and 255 in the alpha lane) times it */
+        __m128i ea_lo = div255_epu16(_mm_mullo_epi16(alpha_epu16(lo), op));
+        __m128i ea_hi = div255_epu16(_mm_mullo_epi16(alpha_epu16(hi), op));
+        lo = _mm_or_si128(_mm_andnot_si128(alpha_mask, lo), alpha_255);
+        hi = _mm_or_si128(_mm_andnot_si128(alpha_mask, hi), alpha_255);
+        lo = div255_epu16(_mm_mullo_epi16(lo, ea_lo));
+        hi = div255_epu16(_mm_mullo_epi16(hi, ea_hi));
+        _mm_storeu_si128((__m128i *)(void *)(dst + i * 4), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(PSD_BLEND_NEON)
+    const uint8x8_t op = vdup_n_u8(opacity);
+    const uint8x16_t alpha_mask = vreinterpretq_u8_u32(vdupq_n_u32(0xFF000000u));
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t px = vld1q_u8(src + i * 4);
+        uint8x16_t a = alpha_u8(px);
+        uint8x16_t ea = vcombine_u8(div255_u16(vmull_u8(vget_low_u8(a), op)),
+                                    div255_u16(vmull_u8(vget_high_u8(a), op)));
+        uint8x16_t c = vcombine_u8(div255_u16(vmull_u8(vget_low_u8(px), vget_low_u8(ea))),
+                                   div255_u16(vmull_u8(vget_high_u8(px), vget_high_u8(ea))));
+        vst1q_u8(dst + i * 4, vbslq_u8(alpha_mask, ea, c));
+    }
+#endif
+
+    for (; i < count; i++) {
+        const uint8_t *s = src + i * 4u;
+        uint8_t *d = dst + i * 4u;
+        unsigned ea = div255((unsigned)s[3] * opacity);
+        d[0] = (uint8_t)div255(s[0] * ea);
+        d[1] = (uint8_t)div255(s[1] * ea);
+        d[2] = (uint8_t)div255(s[2] * ea);
+        d[3] = (uint8_t)ea;
+    }
+}
+
+void psd_blend_scale_row(uint8_t *row, size_t count, uint8_t opacity)
+{
+    if (opacity == 255) return;
+    for (size_t i = 0; i < count * 4u; i++) {
+        row[i] = (uint8_t)div255((unsigned)row[i] * opacity);
+    }
+}
+
+void psd_blend_lerp_row(uint8_t *dst, const uint8_t *src, size_t count, uint8_t t)
+{
+    unsigned keep = 255u - t;
+    for (size_t i = 0; i < count * 4u; i++) {
+        dst[i] = (uint8_t)div255((unsigned)dst[i] * keep + (unsigned)src[i] * t);
+    }
+}
+
+void psd_blend_unpremultiply_row(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    for (size_t i = 0; i < count * 4u; i += 4) {
+        unsigned a = src[i + 3];
+        if (a == 0) {
+            dst[i] = dst[i + 1] = dst[i + 2] = dst[i + 3] = 0;
+            continue;
+        }
+        for (size_t k = 0; k < 3; k++) {
+            unsigned v = ((unsigned)src[i + k] * 255u + a / 2u) / a;
+            dst[i + k] = clamp_u8(v);
+        }
+        dst[i + 3] = (uint8_t)a;
+    }
+}
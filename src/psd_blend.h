@@ -0,0 +1,108 @@
+/**
+ * @file psd_blend.h
+ * @brief Per-row blend kernels for layer compositing
+ *
+ * Rows are premultiplied RGBA8. Normal, multiply and screen, the modes most
+ * documents use, have SSE2 (x86-64) and NEON (AArch64) kernels with integer
+ * math that the portable fallback reproduces exactly. The other Photoshop
+ * modes go through the W3C compositing formula one pixel at a time.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_BLEND_H
+#define PSD_BLEND_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../include/openpsd/psd_export.h"
+
+/**
+ * @brief Blend modes of layer records
+ */
+typedef enum {
+    PSD_BLEND_PASS_THROUGH,   /**< "pass" (groups only; blends as normal) */
+    PSD_BLEND_NORMAL,         /**< "norm", also "diss" */
+    PSD_BLEND_DARKEN,         /**< "dark" */
+    PSD_BLEND_MULTIPLY,       /**< "mul " */
+    PSD_BLEND_COLOR_BURN,     /**< "idiv" */
+    PSD_BLEND_LINEAR_BURN,    /**< "lbrn" */
+    PSD_BLEND_DARKER_COLOR,   /**< "dkCl" */
+    PSD_BLEND_LIGHTEN,        /**< "lite" */
+    PSD_BLEND_SCREEN,         /**< "scrn" */
+    PSD_BLEND_COLOR_DODGE,    /**< "div " */
+    PSD_BLEND_LINEAR_DODGE,   /**< "lddg" */
+    PSD_BLEND_LIGHTER_COLOR,  /**< "lgCl" */
+    PSD_BLEND_OVERLAY,        /**< "over" */
+    PSD_BLEND_SOFT_LIGHT,     /**< "sLit" */
+    PSD_BLEND_HARD_LIGHT,     /**< "hLit" */
+    PSD_BLEND_VIVID_LIGHT,    /**< "vLit" */
+    PSD_BLEND_LINEAR_LIGHT,   /**< "lLit" */
+    PSD_BLEND_PIN_LIGHT,      /**< "pLit" */
+    PSD_BLEND_HARD_MIX,       /**< "hMix" */
+    PSD_BLEND_DIFFERENCE,     /**< "diff" */
+    PSD_BLEND_EXCLUSION,      /**< "smud" */
+    PSD_BLEND_SUBTRACT,       /**< "fsub" */
+    PSD_BLEND_DIVIDE,         /**< "fdiv" */
+    PSD_BLEND_HUE,            /**< "hue " */
+    PSD_BLEND_SATURATION,     /**< "sat " */
+    PSD_BLEND_COLOR,          /**< "colr" */
+    PSD_BLEND_LUMINOSITY      /**< "lum " */
+} psd_blend_mode_t;
+
+/**
+ * @brief Map a layer record blend key to a mode (unknown keys blend as normal)
+ */
+PSD_INTERNAL psd_blend_mode_t psd_blend_mode_from_key(uint32_t key);
+
+/**
+ * @brief Blend count source pixels onto dst in place
+ *
+ * Both rows are premultiplied RGBA8. The result alpha is always
+ * Sa + Da - Sa * Da.
+ */
+PSD_INTERNAL void psd_blend_row(psd_blend_mode_t mode, uint8_t *dst, const uint8_t *src,
+                                size_t count);
+
+/**
+ * @brief Blend a clipped layer's row onto its clipping base
+ *
+ * As psd_blend_row(), but source-atop: dst keeps its alpha and source
+ * pixels only show where dst is opaque.
+ *
+ * @param alpha Scratch space for count bytes
+ */
+PSD_INTERNAL void psd_blend_row_atop(psd_blend_mode_t mode, uint8_t *dst, const uint8_t *src,
+                                     size_t count, uint8_t *alpha);
+
+/**
+ * @brief Convert straight RGBA8 to premultiplied RGBA8, scaling alpha by opacity
+ */
+PSD_INTERNAL void psd_blend_premultiply_row(uint8_t *dst, const uint8_t *src, size_t count,
+                                            uint8_t opacity);
+
+/**
+ * @brief Scale every channel of a premultiplied row by opacity in place
+ */
+PSD_INTERNAL void psd_blend_scale_row(uint8_t *row, size_t count, uint8_t opacity);
+
+/**
+ * @brief Move dst toward src by t / 255 in place (premultiplied rows)
+ */
+PSD_INTERNAL void psd_blend_lerp_row(uint8_t *dst, const uint8_t *src, size_t count,
+                                     uint8_t t);
+
+/**
+ * @brief Convert premultiplied RGBA8 back to straight RGBA8
+ */
+PSD_INTERNAL void psd_blend_unpremultiply_row(uint8_t *dst, const uint8_t *src, size_t count);
+
+#endif /* PSD_BLEND_H */
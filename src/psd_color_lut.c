@@ -0,0 +1,400 @@
+/**
+ * @file psd_color_lut.c
+ * @brief Table-driven sRGB encoding and Lab conversion
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_color_lut.h"
+#include "psd_once.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+static psd_srgb_encoder_t g_srgb_encoder;
+static psd_once_t g_srgb_encoder_once = PSD_ONCE_INIT;
+static psd_lab_tables_t g_lab_tables;
+static psd_once_t g_lab_tables_once = PSD_ONCE_INIT;
+
+static inline float clamp01f(float v)
+{
+    if (v < 0.0f) return 0.0f;
+    if (v > 1.0f) return 1.0f;
+    return v;
+}
+
+static inline float srgb_compand(float v)
+{
+    v = clamp01f(v);
+    if (v <= 0.0031308f) return 12.92f * v;
+    return 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+}
+
+float psd_srgb_compand(float linear)
+{
+    return clamp01f(srgb_compand(linear));
+}
+
+uint8_t psd_srgb_encode_exact(float linear)
+{
+    float v = clamp01f(srgb_compand(linear));
+    int iv = (int)lroundf(v * 255.0f);
+    if (iv < 0) iv = 0;
+    if (iv > 255) iv = 255;
+    return (uint8_t)iv;
+}
+
+static float float_from_bits(uint32_t bits)
+{
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static uint32_t bits_from_float(float v)
+{
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+/* Smallest float in [0, 1] that encodes to at least target. Non-negative
+ * floats order like their bit patterns, so bisect on the bits. */
+static float find_step(unsigned target)
+{
+    uint32_t lo = bits_from_float(0.0f); /* encodes below target */
+    uint32_t hi = bits_from_float(1.0f); /* encodes to 255 >= target */
+    while (hi - lo > 1u) {
+        uint32_t mid = lo + (hi - lo) / 2u;
+        if (psd_srgb_encode_exact(float_from_bits(mid)) >= target) {
+            hi = mid;
+        } else {
+            lo = mid;
+        }
+    }
+    return float_from_bits(hi);
+}
+
+static void build_srgb_encoder(psd_srgb_encoder_t *encoder)
+{
+    for (unsigned k = 0; k < 255u; k++) {
+        encoder->steps[k] = find_step(k + 1u);
+    }
+    for (unsigned i = 0; i < PSD_SRGB_ENCODE_BINS; i++) {
+        encoder->bins[i] = psd_srgb_encode_exact((float)i / (float)PSD_SRGB_ENCODE_BINS);
+    }
+}
+
+const psd_srgb_encoder_t *psd_srgb_encoder(void)
+{
+    if (psd_once_done(&g_srgb_encoder_once)) {
+        return &g_srgb_encoder;
+    }
+    if (!psd_once_claim(&g_srgb_encoder_once)) {
+        return NULL; /* another thread is building it */
+    }
+    build_srgb_encoder(&g_srgb_encoder);
+    psd_once_publish(&g_srgb_encoder_once);
+    return &g_srgb_encoder;
+}
+
+void psd_lab_to_linear_srgb(float L, float a, float b, float *out_linear)
+{
+    /* Convert CIE Lab (D50) -> XYZ (D50) */
+    const float fy = (L + 16.0f) / 116.0f;
+    const float fx = fy + (a / 500.0f);
+    const float fz = fy - (b / 200.0f);
+
+    const float eps = 216.0f / 24389.0f;  /* 0.008856... */
+    const float kappa = 24389.0f / 27.0f; /* 903.3... */
+
+    float fx3 = fx * fx * fx;
+    float fy3 = fy * fy * fy;
+    float fz3 = fz * fz * fz;
+
+    float xr = (fx3 > eps) ? fx3 : ((116.0f * fx - 16.0f) / kappa);
+    float yr = (L > (kappa * eps)) ? fy3 : (L / kappa);
+    float zr = (fz3 > eps) ? fz3 : ((116.0f * fz - 16.0f) / kappa);
+
+    /* D50 reference white (ICC) */
+    float X = xr * 0.96422f;
+    float Y = yr * 1.0f;
+    float Z = zr * 0.82521f;
+
+    /* Bradford adaptation D50 -> D65 */
+    /* B and B^-1 matrices */
+    const float Bm[3][3] = {
+        { 0.8951f,  0.2664f, -0.1614f },
+        { -0.7502f, 1.7135f,  0.0367f },
+        { 0.0389f, -0.0685f,  1.0296f }
+    };
+    const float Bi[3][3] = {
+        { 0.9869929f, -0.1470543f, 0.1599627f },
+        { 0.4323053f,  0.5183603f, 0.0492912f },
+        { -0.0085287f, 0.0400428f, 0.9684867f }
+    };
+
+    /* Whitepoints in XYZ */
+    const float D50[3] = { 0.96422f, 1.0f, 0.82521f };
+    const float D65[3] = { 0.95047f, 1.0f, 1.08883f };
+
+    /* LMS for source/target whites */
+    float LMS50[3] = {
+        Bm[0][0]*D50[0] + Bm[0][1]*D50[1] + Bm[0][2]*D50[2],
+        Bm[1][0]*D50[0] + Bm[1][1]*D50[1] + Bm[1][2]*D50[2],
+        Bm[2][0]*D50[0] + Bm[2][1]*D50[1] + Bm[2][2]*D50[2]
+    };
+    float LMS65[3] = {
+        Bm[0][0]*D65[0] + Bm[0][1]*D65[1] + Bm[0][2]*D65[2],
+        Bm[1][0]*D65[0] + Bm[1][1]*D65[1] + Bm[1][2]*D65[2],
+        Bm[2][0]*D65[0] + Bm[2][1]*D65[1] + Bm[2][2]*D65[2]
+    };
+
+    float lms[3] = {
+        Bm[0][0]*X + Bm[0][1]*Y + Bm[0][2]*Z,
+        Bm[1][0]*X + Bm[1][1]*Y + Bm[1][2]*Z,
+        Bm[2][0]*X + Bm[2][1]*Y + Bm[2][2]*Z
+    };
+
+    /* scale LMS */
+    if (LMS50[0] != 0.0f) lms[0] *= (LMS65[0] / LMS50[0]);
+    if (LMS50[1] != 0.0f) lms[1] *= (LMS65[1] / LMS50[1]);
+    if (LMS50[2] != 0.0f) lms[2] *= (LMS65[2] / LMS50[2]);
+
+    /* back to XYZ (D65) */
+    float Xd = Bi[0][0]*lms[0] + Bi[0][1]*lms[1] + Bi[0][2]*lms[2];
+    float Yd = Bi[1][0]*lms[0] + Bi[1][1]*lms[1] + Bi[1][2]*lms[2];
+    float Zd = Bi[2][0]*lms[0] + Bi[2][1]*lms[1] + Bi[2][2]*lms[2];
+
+    /* XYZ (D65) -> linear sRGB */
+    float rl =  3.2406f*Xd + -1.5372f*Yd + -0.4986f*Zd;
+    float gl = -0.9689f*Xd +  1.8758f*Yd +  0.0415f*Zd;
+    float bl =  0.0557f*Xd + -0.2040f*Yd +  1.0570f*Zd;
+
+    out_linear[0] = rl;
+    out_linear[1] = gl;
+    out_linear[2] = bl;
+}
+
+/* Lab f(t) inverse; the branch point 6/29 is where t^3 reaches eps */
+static double lab_finv_exact(double t)
+{
+    const double eps = 216.0 / 24389.0;
+    const double kappa = 24389.0 / 27.0;
+    const double t3 = t * t * t;
+    return (t3 > eps) ? t3 : ((116.0 * t - 16.0) / kappa);
+}
+
+/* Fold the D50 white, Bradford D50 -> D65 and XYZ -> sRGB into one matrix,
+ * with the same constants as psd_lab_to_linear_srgb() */
+static void build_lab_matrix(float out[3][3])
+{
+    const double Bm[3][3] = {
+        { 0.8951,  0.2664, -0.1614 },
+        { -0.7502, 1.7135,  0.0367 },
+        { 0.0389, -0.0685,  1.0296 }
+    };
+    const double Bi[3][3] = {
+        { 0.9869929, -0.1470543, 0.1599627 },
+        { 0.4323053,  0.5183603, 0.0492912 },
+        { -0.0085287, 0.0400428, 0.9684867 }
+    };
+    const double rgb[3][3] = {
+        { 3.2406, -1.5372, -0.4986 },
+        { -0.9689, 1.8758,  0.0415 },
+        { 0.0557, -0.2040,  1.0570 }
+    };
+    const double D50[3] = { 0.96422, 1.0, 0.82521 };
+    const double D65[3] = { 0.95047, 1.0, 1.08883 };
+
+    /* adapt = Bi * diag(LMS65 / LMS50) * Bm */
+    double scale[3];
+    for (int i = 0; i < 3; i++) {
+        double s50 = Bm[i][0] * D50[0] + Bm[i][1] * D50[1] + Bm[i][2] * D50[2];
+        double s65 = Bm[i][0] * D65[0] + Bm[i][1] * D65[1] + Bm[i][2] * D65[2];
+        scale[i] = s65 / s50;
+    }
+    double adapt[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            double v = 0.0;
+            for (int k = 0; k < 3; k++) v += Bi[i][k] * scale[k] * Bm[k][j];
+            adapt[i][j] = v;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            double v = 0.0;
+            for (int k = 0; k < 3; k++) v += rgb[i][k] * adapt[k][j];
+            out[i][j] = (float)(v * D50[j]);
+        }
+    }
+}
+
+static void build_lab_tables(psd_lab_tables_t *tables, const psd_srgb_encoder_t *srgb)
+{
+    const unsigned n = PSD_LAB_GRID_NODES;
+    for (unsigned i = 0; i < n; i++) {
+        for (unsigned j = 0; j < n; j++) {
+            for (unsigned k = 0; k < n; k++) {
+                /* Same scaling as the 8-bit reference path */
+                float L = ((float)(i * 8u) * 100.0f) / 255.0f;
+                float a = (float)((int)(j * 8u) - 128);
+                float b = (float)((int)(k * 8u) - 128);
+                psd_lab_to_linear_srgb(L, a, b, tables->grid[(i * n + j) * n + k]);
+            }
+        }
+    }
+    const double span = (double)PSD_LAB_FINV_MAX - (double)PSD_LAB_FINV_MIN;
+    for (unsigned i = 0; i <= PSD_LAB_FINV_SIZE; i++) {
+        double t = (double)PSD_LAB_FINV_MIN + span * (double)i / (double)PSD_LAB_FINV_SIZE;
+        tables->finv[i] = (float)lab_finv_exact(t);
+    }
+    build_lab_matrix(tables->matrix);
+    tables->srgb = srgb;
+}
+
+const psd_lab_tables_t *psd_lab_tables(void)
+{
+    if (psd_once_done(&g_lab_tables_once)) {
+        return &g_lab_tables;
+    }
+    const psd_srgb_encoder_t *srgb = psd_srgb_encoder();
+    if (!srgb || !psd_once_claim(&g_lab_tables_once)) {
+        return NULL; /* another thread is building one of them */
+    }
+    build_lab_tables(&g_lab_tables, srgb);
+    psd_once_publish(&g_lab_tables_once);
+    return &g_lab_tables;
+}
+
+/* Tetrahedral interpolation in the cube holding 8-bit (L, a, b). Ordering
+ * the fractions picks one of the six tetrahedra sharing the cube diagonal;
+ * four nodes are read instead of trilinear's eight. */
+static inline void lab_grid_lookup(const psd_lab_tables_t *tables,
+                                   unsigned L, unsigned a, unsigned b, float *out)
+{
+    const size_t sb = 3u;
+    const size_t sa = sb * PSD_LAB_GRID_NODES;
+    const size_t sl = sa * PSD_LAB_GRID_NODES;
+    const float *c0 = tables->grid[((size_t)(L >> 3) * PSD_LAB_GRID_NODES + (a >> 3))
+                                   * PSD_LAB_GRID_NODES + (b >> 3)];
+    const unsigned fl = L & 7u, fa = a & 7u, fb = b & 7u;
+
+    /* Path from c0 to the opposite corner, largest fraction first */
+    size_t o1, o2;
+    unsigned w1, w2, w3;
+    if (fl >= fa) {
+        if (fa >= fb) {
+            o1 = sl; o2 = sl + sa; w1 = fl; w2 = fa; w3 = fb;
+        } else if (fl >= fb) {
+            o1 = sl; o2 = sl + sb; w1 = fl; w2 = fb; w3 = fa;
+        } else {
+            o1 = sb; o2 = sl + sb; w1 = fb; w2 = fl; w3 = fa;
+        }
+    } else {
+        if (fl >= fb) {
+            o1 = sa; o2 = sl + sa; w1 = fa; w2 = fl; w3 = fb;
+        } else if (fa >= fb) {
+            o1 = sa; o2 = sa + sb; w1 = fa; w2 = fb; w3 = fl;
+        } else {
+            o1 = sb; o2 = sa + sb; w1 = fb; w2 = fa; w3 = fl;
+        }
+    }
+    const float *c1 = c0 + o1;
+    const float *c2 = c0 + o2;
+    const float *c3 = c0 + sl + sa + sb;
+    const float k0 = (float)(8u - w1) * 0.125f;
+    const float k1 = (float)(w1 - w2) * 0.125f;
+    const float k2 = (float)(w2 - w3) * 0.125f;
+    const float k3 = (float)w3 * 0.125f;
+    for (int c = 0; c < 3; c++) {
+        out[c] = k0 * c0[c] + k1 * c1[c] + k2 * c2[c] + k3 * c3[c];
+    }
+}
+
+static inline float lab_finv(const psd_lab_tables_t *tables, float t)
+{
+    const float scale = (float)PSD_LAB_FINV_SIZE / (PSD_LAB_FINV_MAX - PSD_LAB_FINV_MIN);
+    float pos = (t - PSD_LAB_FINV_MIN) * scale;
+    if (!(pos > 0.0f)) return tables->finv[0];
+    if (pos >= (float)PSD_LAB_FINV_SIZE) return tables->finv[PSD_LAB_FINV_SIZE];
+    size_t i = (size_t)pos;
+    float frac = pos - (float)i;
+    return tables->finv[i] + frac * (tables->finv[i + 1] - tables->finv[i]);
+}
+
+void psd_lab_row_to_rgba8(const psd_lab_tables_t *tables, uint16_t depth_bits,
+                          const uint8_t *const *rows, uint32_t x0,
+                          uint32_t width, uint8_t *out_rgba)
+{
+    const psd_srgb_encoder_t *srgb = tables->srgb;
+    float linear[3];
+
+    if (depth_bits == 8) {
+        const uint8_t *pl = rows[0] + x0, *pa = rows[1] + x0, *pb = rows[2] + x0;
+        const uint8_t *alpha = rows[3] ? rows[3] + x0 : NULL;
+        for (uint32_t i = 0; i < width; i++) {
+            uint8_t *out = out_rgba + (size_t)i * 4u;
+            lab_grid_lookup(tables, pl[i], pa[i], pb[i], linear);
+            out[0] = psd_srgb_encode(srgb, linear[0]);
+            out[1] = psd_srgb_encode(srgb, linear[1]);
+            out[2] = psd_srgb_encode(srgb, linear[2]);
+            out[3] = alpha ? alpha[i] : 255;
+        }
+        return;
+    }
+
+    const float (*m)[3] = tables->matrix;
+    for (uint32_t i = 0; i < width; i++) {
+        const size_t x = ((size_t)x0 + i) * 2u;
+        uint8_t *out = out_rgba + (size_t)i * 4u;
+        const int Lv = (rows[0][x] << 8) | rows[0][x + 1];
+        const int av = (rows[1][x] << 8) | rows[1][x + 1];
+        const int bv = (rows[2][x] << 8) | rows[2][x + 1];
+
+        /* Same scaling as the 16-bit reference path */
+        const float L = ((float)Lv * 100.0f) / 65535.0f;
+        const float fy = (L + 16.0f) / 116.0f;
+        const float fx = fy + ((float)(av - 32768) / 256.0f) / 500.0f;
+        const float fz = fy - ((float)(bv - 32768) / 256.0f) / 200.0f;
+        const float xr = lab_finv(tables, fx);
+        const float yr = lab_finv(tables, fy);
+        const float zr = lab_finv(tables, fz);
+
+        for (int c = 0; c < 3; c++) {
+            linear[c] = m[c][0] * xr + m[c][1] * yr + m[c][2] * zr;
+        }
+        out[0] = psd_srgb_encode(srgb, linear[0]);
+        out[1] = psd_srgb_encode(srgb, linear[1]);
+        out[2] = psd_srgb_encode(srgb, linear[2]);
+        out[3] = rows[3] ? rows[3][x] : 255;
+    }
+}
+
+void psd_palette_build(const uint8_t *color_mode_data, uint64_t length,
+                       int32_t transparent_index, uint32_t out_palette[256])
+{
+    const bool table = color_mode_data && length >= 768u;
+    for (unsigned i = 0; i < 256u; i++) {
+        uint8_t px[4] = { (uint8_t)i, (uint8_t)i, (uint8_t)i, 255 };
+        if (table) {
+            px[0] = color_mode_data[i];
+            px[1] = color_mode_data[256u + i];
+            px[2] = color_mode_data[512u + i];
+        }
+        if ((int32_t)i == transparent_index) {
+            px[3] = 0;
+        }
+        memcpy(&out_palette[i], px, sizeof(px));
+    }
+}
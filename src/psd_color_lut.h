@@ -0,0 +1,153 @@
+/**
+ * @file psd_color_lut.h
+ * @brief Table-driven sRGB encoding and Lab conversion
+ *
+ * Converting linear sRGB to 8-bit output costs a powf() per channel. The
+ * encoder replaces it with a table of the 255 linear values at which the
+ * rounded 8-bit output steps up, indexed through a coarse bin table, so it
+ * returns exactly what the reference math returns. The table is built once
+ * per process on first use.
+ *
+ * Lab pixels skip the per-pixel Lab math too. 8-bit Lab reads linear sRGB
+ * from a 33x33x33 grid with tetrahedral interpolation; 16-bit Lab inverts
+ * f(t) through a table and applies one folded matrix. Both then go through
+ * the encoder. The result is approximate (see psd_lab_row_to_rgba8()), so
+ * PSD_RENDER_EXACT_COLOR bypasses the tables.
+ *
+ * Indexed documents get a packed RGBA palette, built once per document, so
+ * each pixel is a single 4-byte lookup.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_COLOR_LUT_H
+#define PSD_COLOR_LUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../include/openpsd/psd_export.h"
+
+/** Number of equal-width bins over linear [0, 1) */
+#define PSD_SRGB_ENCODE_BINS 4096
+
+/**
+ * @brief Linear-to-sRGB8 encoding table
+ */
+typedef struct {
+    float steps[255];                    /**< steps[k]: smallest linear value encoding to k + 1 */
+    uint8_t bins[PSD_SRGB_ENCODE_BINS];  /**< Encoded value at the start of each bin */
+} psd_srgb_encoder_t;
+
+/**
+ * @brief Clamp to [0, 1] and apply the sRGB transfer curve, at full precision
+ */
+PSD_INTERNAL float psd_srgb_compand(float linear);
+
+/**
+ * @brief Reference encoding: clamp, sRGB compand, round to 8 bits
+ */
+PSD_INTERNAL uint8_t psd_srgb_encode_exact(float linear);
+
+/**
+ * @brief Get the shared encoder, building it on first use
+ *
+ * Thread-safe. Never blocks: while another thread is building the table
+ * this returns NULL and the caller should use psd_srgb_encode_exact().
+ */
+PSD_INTERNAL const psd_srgb_encoder_t *psd_srgb_encoder(void);
+
+/**
+ * @brief Table encoding, identical to psd_srgb_encode_exact()
+ */
+static inline uint8_t psd_srgb_encode(const psd_srgb_encoder_t *encoder, float linear)
+{
+    if (!(linear > 0.0f)) return 0;
+    if (linear >= 1.0f) return 255;
+
+    /* Scaling by a power of two is exact, so the bin never overshoots */
+    unsigned k = encoder->bins[(size_t)(linear * (float)PSD_SRGB_ENCODE_BINS)];
+    while (k < 255u && linear >= encoder->steps[k]) k++;
+    return (uint8_t)k;
+}
+
+/** Grid nodes per 8-bit Lab axis: one every 8 code values, plus 256 */
+#define PSD_LAB_GRID_NODES 33
+
+/** Intervals of the f(t) inverse table */
+#define PSD_LAB_FINV_SIZE 4096
+
+/** Range of f(t) covered by the inverse table; 16-bit Lab stays inside it */
+#define PSD_LAB_FINV_MIN (-0.625f)
+#define PSD_LAB_FINV_MAX 1.875f
+
+/**
+ * @brief Shared Lab-to-sRGB8 tables
+ */
+typedef struct {
+    /** Unclamped linear sRGB at 8-bit (L, a, b) = 8 * (i, j, k), node (i, j, k) */
+    float grid[PSD_LAB_GRID_NODES * PSD_LAB_GRID_NODES * PSD_LAB_GRID_NODES][3];
+    /** Inverse of the Lab f(t) at PSD_LAB_FINV_SIZE + 1 evenly spaced points */
+    float finv[PSD_LAB_FINV_SIZE + 1];
+    /** D50-relative XYZ to linear sRGB: white point, Bradford and sRGB primaries */
+    float matrix[3][3];
+    /** Encoder the rows finish with */
+    const psd_srgb_encoder_t *srgb;
+} psd_lab_tables_t;
+
+/**
+ * @brief Reference conversion of one CIE Lab (D50) color to linear sRGB (D65)
+ *
+ * Output is unclamped; out-of-gamut colors fall outside [0, 1].
+ */
+PSD_INTERNAL void psd_lab_to_linear_srgb(float L, float a, float b, float *out_linear);
+
+/**
+ * @brief Get the shared Lab tables, building them on first use
+ *
+ * Thread-safe. Never blocks: while another thread is building the tables
+ * (or the encoder) this returns NULL and the caller should use the
+ * reference conversion.
+ */
+PSD_INTERNAL const psd_lab_tables_t *psd_lab_tables(void);
+
+/**
+ * @brief Convert pixels [x0, x0 + width) of an 8- or 16-bit Lab row to RGBA8
+ *
+ * Against psd_lab_to_linear_srgb() plus psd_srgb_encode_exact(), 8-bit
+ * output is exact for over 90% of channels and within 1 level for over
+ * 99%; the rest, at most 10 levels off, are near-zero channels of strongly
+ * out-of-gamut colors. 16-bit output is within 1 level.
+ *
+ * @param rows Planes L, a, b and optional alpha (rows[3] may be NULL),
+ *             each pointing at x = 0 of the row
+ */
+PSD_INTERNAL void psd_lab_row_to_rgba8(const psd_lab_tables_t *tables, uint16_t depth_bits,
+                                       const uint8_t *const *rows, uint32_t x0,
+                                       uint32_t width, uint8_t *out_rgba);
+
+/** Resource ID of the indexed Transparency Index (2 bytes) */
+#define PSD_RESOURCE_TRANSPARENCY_INDEX 1047
+
+/**
+ * @brief Build the packed RGBA palette of an indexed document
+ *
+ * Entries hold bytes R, G, B, A in memory order. Without a 768-byte color
+ * table the index is used as a gray level.
+ *
+ * @param color_mode_data Color mode data (256 reds, 256 greens, 256 blues)
+ * @param length Length of color_mode_data
+ * @param transparent_index Entry that gets alpha 0, or -1 for none
+ * @param out_palette Receives 256 entries
+ */
+PSD_INTERNAL void psd_palette_build(const uint8_t *color_mode_data, uint64_t length,
+                                    int32_t transparent_index, uint32_t out_palette[256]);
+
+#endif /* PSD_COLOR_LUT_H */
@@ -19,6 +19,7 @@
 #ifndef PSD_COMPOSITE_H
 #define PSD_COMPOSITE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 #include "../include/openpsd/psd_types.h"
@@ -26,16 +27,27 @@
 /**
  * @brief Composite image data
  *
- * Stores the final composite image as planar channel data.
+ * Parsing only keeps the section payload (compressed_data); the planar image
+ * is decoded into data on first access.
+ *
  * If depth is 8 bits and channels is 3 (RGB), data is organized as:
  *  - First height*width bytes: all red channel pixels
  *  - Next height*width bytes: all green channel pixels
  *  - Next height*width bytes: all blue channel pixels
+ *
+ * For RLE, compressed_data starts with the byte counts table (one count of
+ * rle_count_bytes per scanline, channel-major) followed by the PackBits rows.
  */
 typedef struct {
-    uint8_t *data;              /**< Raw image data (planar layout) */
+    uint8_t *data;              /**< Decoded image data (planar layout), NULL until decoded */
     uint64_t data_length;       /**< Total length of data */
     psd_compression_t compression;  /**< Compression type */
+    uint8_t *compressed_data;   /**< Section payload after the compression field */
+    uint64_t compressed_length; /**< Length of compressed_data */
+    bool compressed_borrowed;   /**< compressed_data points into a file mapping */
+    uint64_t file_offset;       /**< Stream offset of the payload */
+    uint8_t rle_count_bytes;    /**< RLE byte count width (2 or 4), 0 otherwise */
+    bool decode_attempted;      /**< Decode ran (data may still be NULL if unsupported) */
 } psd_composite_image_t;
 
 #endif /* PSD_COMPOSITE_H */
@@ -0,0 +1,357 @@
+/**
+ * @file psd_composite_cache.c
+ * @brief Tiled cache of layer composites for incremental recomposition
+ *
+ * The canvas is split into square tiles. Each tile keeps its finished
+ * composite plus snapshots of the canvas at "stops": the start and end of
+ * every top-level group, and every PSD_COMPOSITE_STOP_UNITS top-level units
+ * in long runs of ungrouped layers. Invalidating a layer only touches the
+ * tiles under its bounds, and those recompose from the last stop below it
+ * instead of from the bottom of the stack.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "psd_alloc.h"
+#include "psd_blend.h"
+#include "psd_context.h"
+#include "psd_flatten.h"
+
+#include <string.h>
+
+#define PSD_COMPOSITE_DEFAULT_TILE 256u
+#define PSD_COMPOSITE_STOP_UNITS 16
+
+typedef struct {
+    uint8_t *final;           /* Premultiplied composite of every layer */
+    bool final_valid;
+    uint8_t **snaps;          /* stop_count entries; snaps[k]: canvas below stops[k] */
+    uint32_t valid;           /* snaps[1, valid) are current; snaps[0] is empty */
+} psd_composite_tile_t;
+
+struct psd_composite_cache {
+    psd_document_t *doc;
+    uint32_t tile_size;
+    uint32_t cols;
+    uint32_t rows;
+    uint64_t max_bytes;       /* Snapshot budget, 0 = unlimited */
+    uint64_t bytes;           /* Snapshot bytes held */
+    int32_t *stops;           /* Layer index each snapshot sits below; stops[0] = 0 */
+    uint32_t stop_count;
+    psd_composite_tile_t *tiles;
+    uint8_t **snap_slots;     /* Backing array of every tile's snaps */
+    psd_flatten_t flatten;
+};
+
+/* Snapshot points: top-level group boundaries, and regular steps between */
+static psd_status_t cache_find_stops(psd_composite_cache_t *cache)
+{
+    psd_document_t *doc = cache->doc;
+    const int32_t count = doc->layers.layer_count;
+    cache->stops = (int32_t *)psd_alloc_malloc(doc->allocator,
+                                               ((size_t)count + 1u) * sizeof(int32_t));
+    if (!cache->stops) return PSD_ERR_OUT_OF_MEMORY;
+
+    uint32_t n = 0;
+    cache->stops[n++] = 0;
+    int32_t units = 0;
+    int32_t i = 0;
+    while (i < count) {
+        int32_t end = psd_flatten_unit_end(&cache->flatten, i);
+        bool group = doc->layers.layers[i].features.is_group_end && end > i + 1;
+        if ((group || units >= PSD_COMPOSITE_STOP_UNITS) && cache->stops[n - 1] != i) {
+            cache->stops[n++] = i;
+            units = 0;
+        }
+        units++;
+        if (group && end < count) {
+            cache->stops[n++] = end;
+            units = 0;
+        }
+        i = end;
+    }
+    cache->stop_count = n;
+    return PSD_OK;
+}
+
+static void cache_tile_rect(const psd_composite_cache_t *cache, uint32_t col, uint32_t row,
+                            psd_rect_t *rect)
+{
+    rect->top = (int32_t)(row * cache->tile_size);
+    rect->left = (int32_t)(col * cache->tile_size);
+    rect->bottom = (int32_t)(row == cache->rows - 1 ? cache->doc->height
+                                                    : (row + 1) * cache->tile_size);
+    rect->right = (int32_t)(col == cache->cols - 1 ? cache->doc->width
+                                                   : (col + 1) * cache->tile_size);
+}
+
+/**
+ * @brief Create a composite cache for a document
+ */
+PSD_API psd_status_t psd_composite_cache_create(
+    psd_document_t *doc,
+    uint32_t tile_size,
+    uint64_t max_bytes,
+    psd_composite_cache_t **out_cache)
+{
+    if (!doc || !out_cache) return PSD_ERR_NULL_POINTER;
+    *out_cache = NULL;
+    if (doc->depth == 32) return PSD_ERR_UNSUPPORTED_FEATURE;
+    if (tile_size == 0) tile_size = PSD_COMPOSITE_DEFAULT_TILE;
+
+    psd_composite_cache_t *cache = (psd_composite_cache_t *)psd_alloc_malloc(
+        doc->allocator, sizeof(*cache));
+    if (!cache) return PSD_ERR_OUT_OF_MEMORY;
+    memset(cache, 0, sizeof(*cache));
+    cache->doc = doc;
+    cache->tile_size = tile_size;
+    cache->max_bytes = max_bytes;
+    cache->cols = (doc->width + tile_size - 1u) / tile_size;
+    cache->rows = (doc->height + tile_size - 1u) / tile_size;
+
+    uint32_t tile_w = doc->width < tile_size ? doc->width : tile_size;
+    uint32_t tile_h = doc->height < tile_size ? doc->height : tile_size;
+    psd_status_t st = psd_flatten_init(&cache->flatten, doc, tile_w, tile_h);
+    if (st == PSD_OK) st = cache_find_stops(cache);
+
+    const size_t tile_count = (size_t)cache->cols * cache->rows;
+    if (st == PSD_OK && tile_count > 0) {
+        cache->tiles = (psd_composite_tile_t *)psd_alloc_malloc(
+            doc->allocator, tile_count * sizeof(psd_composite_tile_t));
+        cache->snap_slots = (uint8_t **)psd_alloc_malloc(
+            doc->allocator, tile_count * cache->stop_count * sizeof(uint8_t *));
+        if (!cache->tiles || !cache->snap_slots) {
+            st = PSD_ERR_OUT_OF_MEMORY;
+        } else {
+            memset(cache->snap_slots, 0, tile_count * cache->stop_count * sizeof(uint8_t *));
+            for (size_t t = 0; t < tile_count; t++) {
+                cache->tiles[t].final = NULL;
+                cache->tiles[t].final_valid = false;
+                cache->tiles[t].snaps = cache->snap_slots + t * cache->stop_count;
+                cache->tiles[t].valid = 1;
+            }
+        }
+    }
+
+    if (st != PSD_OK) {
+        psd_composite_cache_destroy(cache);
+        return st;
+    }
+    *out_cache = cache;
+    return PSD_OK;
+}
+
+/**
+ * @brief Free a composite cache
+ */
+PSD_API void psd_composite_cache_destroy(psd_composite_cache_t *cache)
+{
+    if (!cache) return;
+    const psd_allocator_t *allocator = cache->doc->allocator;
+    if (cache->tiles) {
+        const size_t tile_count = (size_t)cache->cols * cache->rows;
+        for (size_t t = 0; t < tile_count; t++) {
+            psd_alloc_free(allocator, cache->tiles[t].final);
+            for (uint32_t k = 0; k < cache->stop_count; k++) {
+                psd_alloc_free(allocator, cache->tiles[t].snaps[k]);
+            }
+        }
+    }
+    psd_alloc_free(allocator, cache->snap_slots);
+    psd_alloc_free(allocator, cache->tiles);
+    psd_alloc_free(allocator, cache->stops);
+    psd_flatten_release(&cache->flatten);
+    psd_alloc_free(allocator, cache);
+}
+
+/* Keep the canvas as snapshot k of the tile, budget permitting */
+static bool cache_store_snap(psd_composite_cache_t *cache, psd_composite_tile_t *tile,
+                             uint32_t k, size_t plane)
+{
+    if (!tile->snaps[k]) {
+        if (cache->max_bytes && cache->bytes + plane > cache->max_bytes) return false;
+        tile->snaps[k] = (uint8_t *)psd_alloc_malloc(cache->doc->allocator, plane);
+        if (!tile->snaps[k]) return false;
+        cache->bytes += plane;
+    }
+    memcpy(tile->snaps[k], cache->flatten.levels[0], plane);
+    return true;
+}
+
+/* Recompose a tile from its last current snapshot */
+static psd_status_t cache_update_tile(psd_composite_cache_t *cache, uint32_t col, uint32_t row)
+{
+    psd_composite_tile_t *tile = &cache->tiles[(size_t)row * cache->cols + col];
+    psd_stats_tile(cache->doc->stats, tile->final_valid);
+    if (tile->final_valid) return PSD_OK;
+
+    psd_rect_t rect;
+    cache_tile_rect(cache, col, row, &rect);
+    psd_flatten_t *f = &cache->flatten;
+    psd_flatten_set_region(f, &rect);
+    const size_t plane = f->stride * f->height;
+
+    if (!tile->final) {
+        tile->final = (uint8_t *)psd_alloc_malloc(cache->doc->allocator, plane);
+        if (!tile->final) return PSD_ERR_OUT_OF_MEMORY;
+    }
+
+    uint32_t k = tile->valid - 1u;
+    if (k == 0) {
+        memset(f->levels[0], 0, plane);
+    } else {
+        memcpy(f->levels[0], tile->snaps[k], plane);
+    }
+
+    /* Snapshots stay current only as an unbroken run from the bottom */
+    bool chain = true;
+    for (uint32_t s = k + 1u; s < cache->stop_count; s++) {
+        psd_status_t st = psd_flatten_layers(f, cache->stops[s - 1u], cache->stops[s]);
+        if (st != PSD_OK) return st;
+        if (chain && cache_store_snap(cache, tile, s, plane)) {
+            tile->valid = s + 1u;
+        } else {
+            chain = false;
+        }
+    }
+    psd_status_t st = psd_flatten_layers(f, cache->stops[cache->stop_count - 1u],
+                                         cache->doc->layers.layer_count);
+    if (st != PSD_OK) return st;
+
+    memcpy(tile->final, f->levels[0], plane);
+    tile->final_valid = true;
+    return PSD_OK;
+}
+
+/**
+ * @brief Render a region of the layer composite through the cache
+ */
+PSD_API psd_status_t psd_composite_cache_render(
+    psd_composite_cache_t *cache,
+    const psd_rect_t *rect,
+    uint8_t *out_rgba,
+    size_t out_stride)
+{
+    if (!cache || !out_rgba) return PSD_ERR_NULL_POINTER;
+
+    const psd_document_t *doc = cache->doc;
+    psd_rect_t region = { 0, 0, (int32_t)doc->height, (int32_t)doc->width };
+    if (rect) {
+        if (rect->top < 0 || rect->left < 0 ||
+            rect->bottom < rect->top || rect->right < rect->left ||
+            (uint32_t)rect->bottom > doc->height || (uint32_t)rect->right > doc->width) {
+            return PSD_ERR_OUT_OF_RANGE;
+        }
+        region = *rect;
+    }
+    if (out_stride < (size_t)(region.right - region.left) * 4u) return PSD_ERR_INVALID_ARGUMENT;
+    if (region.right == region.left || region.bottom == region.top) return PSD_OK;
+
+    const uint32_t size = cache->tile_size;
+    for (uint32_t row = (uint32_t)region.top / size; row * size < (uint32_t)region.bottom; row++) {
+        for (uint32_t col = (uint32_t)region.left / size; col * size < (uint32_t)region.right;
+             col++) {
+            psd_status_t st = cache_update_tile(cache, col, row);
+            if (st != PSD_OK) return st;
+
+            psd_rect_t tile_rect;
+            cache_tile_rect(cache, col, row, &tile_rect);
+            const psd_composite_tile_t *tile = &cache->tiles[(size_t)row * cache->cols + col];
+            const size_t tile_stride = (size_t)(tile_rect.right - tile_rect.left) * 4u;
+
+            int32_t x0 = tile_rect.left > region.left ? tile_rect.left : region.left;
+            int32_t x1 = tile_rect.right < region.right ? tile_rect.right : region.right;
+            int32_t y0 = tile_rect.top > region.top ? tile_rect.top : region.top;
+            int32_t y1 = tile_rect.bottom < region.bottom ? tile_rect.bottom : region.bottom;
+            for (int32_t y = y0; y < y1; y++) {
+                psd_blend_unpremultiply_row(
+                    out_rgba + (size_t)(y - region.top) * out_stride +
+                        (size_t)(x0 - region.left) * 4u,
+                    tile->final + (size_t)(y - tile_rect.top) * tile_stride +
+                        (size_t)(x0 - tile_rect.left) * 4u,
+                    (size_t)(x1 - x0));
+            }
+        }
+    }
+    return PSD_OK;
+}
+
+/* Mark tiles under a document rect stale from snapshot stop onward */
+static void cache_invalidate(psd_composite_cache_t *cache, const psd_rect_t *rect, uint32_t stop)
+{
+    int32_t top = rect->top > 0 ? rect->top : 0;
+    int32_t left = rect->left > 0 ? rect->left : 0;
+    int32_t bottom = rect->bottom < (int32_t)cache->doc->height ? rect->bottom
+                                                                : (int32_t)cache->doc->height;
+    int32_t right = rect->right < (int32_t)cache->doc->width ? rect->right
+                                                             : (int32_t)cache->doc->width;
+    if (top >= bottom || left >= right) return;
+
+    const uint32_t size = cache->tile_size;
+    for (uint32_t row = (uint32_t)top / size; row * size < (uint32_t)bottom; row++) {
+        for (uint32_t col = (uint32_t)left / size; col * size < (uint32_t)right; col++) {
+            psd_composite_tile_t *tile = &cache->tiles[(size_t)row * cache->cols + col];
+            tile->final_valid = false;
+            if (tile->valid > stop + 1u) tile->valid = stop + 1u;
+        }
+    }
+}
+
+/**
+ * @brief Drop cached pixels a layer change affects
+ */
+PSD_API psd_status_t psd_composite_cache_invalidate_layer(
+    psd_composite_cache_t *cache,
+    int32_t layer_index)
+{
+    if (!cache) return PSD_ERR_NULL_POINTER;
+    const psd_document_t *doc = cache->doc;
+    if (layer_index < 0 || layer_index >= doc->layers.layer_count) return PSD_ERR_OUT_OF_RANGE;
+
+    /* A group's records have no pixels; it covers its members' bounds */
+    int32_t first = layer_index;
+    int32_t last = layer_index;
+    const psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    int32_t other = cache->flatten.match[layer_index];
+    if (other >= 0 && (layer->features.is_group_start || layer->features.is_group_end)) {
+        first = other < layer_index ? other : layer_index;
+        last = other < layer_index ? layer_index : other;
+    }
+
+    psd_rect_t rect = { INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN };
+    for (int32_t i = first; i <= last; i++) {
+        const psd_layer_bounds_t *b = &doc->layers.layers[i].bounds;
+        if (b->top >= b->bottom || b->left >= b->right) continue;
+        if (b->top < rect.top) rect.top = b->top;
+        if (b->left < rect.left) rect.left = b->left;
+        if (b->bottom > rect.bottom) rect.bottom = b->bottom;
+        if (b->right > rect.right) rect.right = b->right;
+    }
+
+    uint32_t stop = 0;
+    while (stop + 1u < cache->stop_count && cache->stops[stop + 1u] <= first) stop++;
+    cache_invalidate(cache, &rect, stop);
+    return PSD_OK;
+}
+
+/**
+ * @brief Drop every cached pixel under a rect
+ */
+PSD_API psd_status_t psd_composite_cache_invalidate_rect(
+    psd_composite_cache_t *cache,
+    const psd_rect_t *rect)
+{
+    if (!cache) return PSD_ERR_NULL_POINTER;
+    psd_rect_t all = { 0, 0, (int32_t)cache->doc->height, (int32_t)cache->doc->width };
+    cache_invalidate(cache, rect ? rect : &all, 0);
+    return PSD_OK;
+}
@@ -20,8 +20,11 @@
 #include "../include/openpsd/psd_stream.h"
 #include "psd_context.h"
 #include "psd_alloc.h"
+#include "psd_color_lut.h"
 #include "psd_composite.h"
 #include "psd_descriptor.h"
+#include "psd_embedded_files.h"
+#include "psd_tagged_blocks.h"
 #include "psd_endian.h"
 #include "psd_header.h"
 #include "psd_layer.h"
@@ -32,8 +35,11 @@
 #include "psd_resources.h"
 #include "psd_unicode.h"
 #include "psd_rle.h"
+#include "psd_stream_internal.h"
+#include "psd_threads.h"
 #include "psd_zip.h"
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <stdio.h>
@@ -42,77 +48,26 @@
 static psd_status_t psd_parse_composite_image(psd_stream_t *stream,
                                               psd_document_t *doc);
 
-static psd_status_t psd_try_decode_composite_rle(
-    psd_stream_t *stream,
-    int64_t counts_pos,
-    uint32_t num_scanlines,
-    uint64_t bytes_per_scanline,
-    uint8_t *dst,
-    uint64_t expected_uncompressed_size,
-    const psd_allocator_t *alloc,
-    uint32_t count_bytes)
-{
-    psd_status_t st;
-    uint64_t compressed_size64 = 0;
-
-    if (psd_stream_seek(stream, counts_pos) < 0) {
-        return PSD_ERR_STREAM_INVALID;
+/**
+ * @brief Free an array of resource blocks
+ *
+ * Block data borrowed from a file mapping is left alone.
+ */
+static void psd_free_resource_blocks(const psd_allocator_t *allocator,
+                                     psd_resource_block_t *blocks,
+                                     size_t count) {
+    if (!blocks) {
+        return;
     }
-
-    if (count_bytes == 2) {
-        for (uint32_t i = 0; i < num_scanlines; i++) {
-            uint16_t v16 = 0;
-            st = psd_stream_read_be16(stream, &v16);
-            if (st != PSD_OK) return st;
-            compressed_size64 += (uint64_t)v16;
+    for (size_t i = 0; i < count; i++) {
+        if (blocks[i].name) {
+            psd_alloc_free(allocator, blocks[i].name);
         }
-    } else if (count_bytes == 4) {
-        for (uint32_t i = 0; i < num_scanlines; i++) {
-            uint32_t v32 = 0;
-            st = psd_stream_read_be32(stream, &v32);
-            if (st != PSD_OK) return st;
-            compressed_size64 += (uint64_t)v32;
+        if (blocks[i].data && !blocks[i].data_borrowed) {
+            psd_alloc_free(allocator, blocks[i].data);
         }
-    } else {
-        return PSD_ERR_INVALID_ARGUMENT;
-    }
-
-    size_t compressed_size = 0;
-    if (psd_u64_to_size(compressed_size64, &compressed_size) != 0) {
-        return PSD_ERR_OUT_OF_RANGE;
-    }
-
-    uint8_t *compressed_data = (uint8_t *)psd_alloc_malloc(alloc, compressed_size);
-    if (!compressed_data) {
-        return PSD_ERR_OUT_OF_MEMORY;
-    }
-
-    int64_t read_bytes = psd_stream_read(stream, compressed_data, compressed_size);
-    if (read_bytes < 0 || (size_t)read_bytes != compressed_size) {
-        psd_alloc_free(alloc, compressed_data);
-        return PSD_ERR_STREAM_EOF;
-    }
-
-    size_t scanline_w = 0;
-    if (psd_u64_to_size(bytes_per_scanline, &scanline_w) != 0) {
-        psd_alloc_free(alloc, compressed_data);
-        return PSD_ERR_OUT_OF_RANGE;
     }
-
-    size_t out_len = 0;
-    st = psd_rle_decode(
-        compressed_data,
-        compressed_size,
-        (size_t)num_scanlines,
-        scanline_w,
-        dst,
-        &out_len);
-
-    psd_alloc_free(alloc, compressed_data);
-
-    if (st != PSD_OK) return st;
-    if ((uint64_t)out_len != expected_uncompressed_size) return PSD_ERR_CORRUPT_DATA;
-    return PSD_OK;
+    psd_alloc_free(allocator, blocks);
 }
 
 /**
@@ -128,8 +83,7 @@ static psd_status_t psd_try_decode_composite_rle(
  * @param doc Document to populate with header data
  * @return PSD_OK on success, negative error code on failure
  */
-static psd_status_t psd_parse_header(psd_stream_t *stream,
-                                     psd_document_t *doc) {
+psd_status_t psd_parse_header(psd_stream_t *stream, psd_document_t *doc) {
     psd_status_t status;
     uint32_t signature;
     uint16_t version;
@@ -236,8 +190,7 @@ static psd_status_t psd_parse_header(psd_stream_t *stream,
  * @param doc Document to populate with color mode data
  * @return PSD_OK on success, negative error code on failure
  */
-static psd_status_t psd_parse_color_mode_data(psd_stream_t *stream,
-                                              psd_document_t *doc) {
+psd_status_t psd_parse_color_mode_data(psd_stream_t *stream, psd_document_t *doc) {
     psd_status_t status;
     uint64_t data_length;
 
@@ -305,8 +258,7 @@ static psd_status_t psd_parse_color_mode_data(psd_stream_t *stream,
  * @param doc Document to populate with resources
  * @return PSD_OK on success, negative error code on failure
  */
-static psd_status_t psd_parse_resources(psd_stream_t *stream,
-                                        psd_document_t *doc) {
+psd_status_t psd_parse_resources(psd_stream_t *stream, psd_document_t *doc) {
     psd_status_t status;
     uint64_t section_length;
 
@@ -340,7 +292,7 @@ static psd_status_t psd_parse_resources(psd_stream_t *stream,
     size_t block_count = 0;
 
     psd_resource_block_t *blocks = (psd_resource_block_t *)psd_alloc_malloc(
-        doc->allocator, block_capacity * sizeof(psd_resource_block_t));
+        &doc->meta.allocator, block_capacity * sizeof(psd_resource_block_t));
     if (!blocks) {
         return PSD_ERR_OUT_OF_MEMORY;
     }
@@ -385,7 +337,7 @@ static psd_status_t psd_parse_resources(psd_stream_t *stream,
         size_t name_length = pascal_length;
 
         if (pascal_length > 0) {
-            name = (uint8_t *)psd_alloc_malloc(doc->allocator, pascal_length);
+            name = (uint8_t *)psd_alloc_malloc(&doc->meta.allocator, pascal_length);
             if (!name) {
                 status = PSD_ERR_OUT_OF_MEMORY;
                 goto error;
@@ -393,7 +345,7 @@ static psd_status_t psd_parse_resources(psd_stream_t *stream,
 
             status = psd_stream_read_exact(stream, name, pascal_length);
             if (status != PSD_OK) {
-                psd_alloc_free(doc->allocator, name);
+                psd_alloc_free(&doc->meta.allocator, name);
                 goto error;
             }
         }
@@ -402,7 +354,7 @@ static psd_status_t psd_parse_resources(psd_stream_t *stream,
         if (((1u + (uint32_t)pascal_length) & 1u) != 0u) {
             status = psd_stream_skip(stream, 1);
             if (status != PSD_OK) {
-                psd_alloc_free(doc->allocator, name);
+                psd_alloc_free(&doc->meta.allocator, name);
                 goto error;
             }
         }
@@ -411,33 +363,38 @@ static psd_status_t psd_parse_resources(psd_stream_t *stream,
         uint32_t data_length32 = 0;
         status = psd_stream_read_be32(stream, &data_length32);
         if (status != PSD_OK) {
-            psd_alloc_free(doc->allocator, name);
+            psd_alloc_free(&doc->meta.allocator, name);
             goto error;
         }
         data_length = (uint64_t)data_length32;
 
-        /* Allocate data buffer */
+        /* Borrow the data from a file mapping, or allocate and copy it */
         uint8_t *data = NULL;
+        bool data_borrowed = false;
         if (data_length > 0) {
             size_t data_size;
             if (psd_u64_to_size(data_length, &data_size) != 0) {
-                psd_alloc_free(doc->allocator, name);
+                psd_alloc_free(&doc->meta.allocator, name);
                 status = PSD_ERR_OUT_OF_RANGE;
                 goto error;
             }
 
-            data = (uint8_t *)psd_alloc_malloc(doc->allocator, data_size);
-            if (!data) {
-                psd_alloc_free(doc->allocator, name);
-                status = PSD_ERR_OUT_OF_MEMORY;
-                goto error;
-            }
+            data = (uint8_t *)psd_stream_borrow(stream, data_size);
+            data_borrowed = (data != NULL);
+            if (!data_borrowed) {
+                data = (uint8_t *)psd_alloc_malloc(&doc->meta.allocator, data_size);
+                if (!data) {
+                    psd_alloc_free(&doc->meta.allocator, name);
+                    status = PSD_ERR_OUT_OF_MEMORY;
+                    goto error;
+                }
 
-            status = psd_stream_read_exact(stream, data, data_size);
-            if (status != PSD_OK) {
-                psd_alloc_free(doc->allocator, name);
-                psd_alloc_free(doc->allocator, data);
-                goto error;
+                status = psd_stream_read_exact(stream, data, data_size);
+                if (status != PSD_OK) {
+                    psd_alloc_free(&doc->meta.allocator, name);
+                    psd_alloc_free(&doc->meta.allocator, data);
+                    goto error;
+                }
             }
         }
 
@@ -445,8 +402,10 @@ static psd_status_t psd_parse_resources(psd_stream_t *stream,
         if (data_length % 2 != 0) {
             status = psd_stream_skip(stream, 1);
             if (status != PSD_OK) {
-                psd_alloc_free(doc->allocator, name);
-                psd_alloc_free(doc->allocator, data);
+                psd_alloc_free(&doc->meta.allocator, name);
+                if (!data_borrowed) {
+                    psd_alloc_free(&doc->meta.allocator, data);
+                }
                 goto error;
             }
         }
@@ -456,11 +415,13 @@ static psd_status_t psd_parse_resources(psd_stream_t *stream,
             block_capacity *= 2;
             psd_resource_block_t *new_blocks =
                 (psd_resource_block_t *)psd_alloc_realloc(
-                    doc->allocator, blocks,
+                    &doc->meta.allocator, blocks,
                     block_capacity * sizeof(psd_resource_block_t));
             if (!new_blocks) {
-                psd_alloc_free(doc->allocator, name);
-                psd_alloc_free(doc->allocator, data);
+                psd_alloc_free(&doc->meta.allocator, name);
+                if (!data_borrowed) {
+                    psd_alloc_free(&doc->meta.allocator, data);
+                }
                 status = PSD_ERR_OUT_OF_MEMORY;
                 goto error;
             }
@@ -472,6 +433,7 @@ static psd_status_t psd_parse_resources(psd_stream_t *stream,
         blocks[block_count].name = name;
         blocks[block_count].name_length = name_length;
         blocks[block_count].data = data;
+        blocks[block_count].data_borrowed = data_borrowed;
         blocks[block_count].data_length = data_length;
         block_count++;
     }
@@ -500,15 +462,666 @@ static psd_status_t psd_parse_resources(psd_stream_t *stream,
 
 error:
     /* Free all allocated blocks on error */
-    for (size_t i = 0; i < block_count; i++) {
-        psd_alloc_free(doc->allocator, blocks[i].name);
-        psd_alloc_free(doc->allocator, blocks[i].data);
-    }
-    psd_alloc_free(doc->allocator, blocks);
+    psd_free_resource_blocks(&doc->meta.allocator, blocks, block_count);
+
+    return status;
+}
 
+/**
+ * @brief Read a length field of a known width (4 or 8 bytes)
+ */
+static psd_status_t psd_read_length_width(psd_stream_t *stream, uint8_t width,
+                                          uint64_t *value) {
+    if (width == 8) {
+        return psd_stream_read_be64(stream, value);
+    }
+    uint32_t value32 = 0;
+    psd_status_t status = psd_stream_read_be32(stream, &value32);
+    *value = value32;
     return status;
 }
 
+/**
+ * @brief Set a layer record to its defaults before it is read
+ */
+void psd_layer_record_init(psd_layer_record_t *layer) {
+    layer->bounds.top = 0;
+    layer->bounds.left = 0;
+    layer->bounds.bottom = 0;
+    layer->bounds.right = 0;
+    layer->channels = NULL;
+    layer->channel_count = 0;
+    layer->blend_sig = 0;
+    layer->blend_key = 0;
+    layer->opacity = 255;
+    layer->clipping = 0;
+    layer->flags = 0;
+    layer->name = NULL;
+    layer->name_length = 0;
+    layer->additional_data = NULL;
+    layer->additional_length = 0;
+    layer->blocks = NULL;
+    layer->block_count = 0;
+    layer->content = NULL;
+    psd_once_reset(&layer->content_once);
+    layer->pixel_hash = 0;
+    psd_once_reset(&layer->pixel_hash_once);
+    /* Initialize features to all false */
+    memset(&layer->features, 0, sizeof(psd_layer_features_t));
+}
+
+/**
+ * @brief Parse one layer record of the Layer Info subsection
+ *
+ * Reads the bounds, channel descriptors, blend mode, flags and extra data of
+ * doc->layers.layers[i] and indexes its tagged blocks. Channel image data is
+ * not part of the record.
+ *
+ * @param stream Stream positioned at the record
+ * @param doc Document whose layer array holds the record
+ * @param i Index of the record
+ * @param index Saved layout of this stream, or NULL
+ * @param index_channel Next channel of the saved layout (ignored without one)
+ * @param layer_info_end Stream offset where the Layer Info subsection ends
+ * @param section_end Stream offset where the Layer and Mask section ends
+ * @param out_last Set when the record runs into the channel image data and
+ *        no further records should be read; the stream is then at section_end
+ * @return PSD_OK on success, negative error code on failure
+ */
+psd_status_t psd_parse_layer_record(psd_stream_t *stream, psd_document_t *doc, int32_t i,
+                                    const psd_layout_index_t *index,
+                                    uint64_t *index_channel, int64_t layer_info_end,
+                                    int64_t section_end, bool *out_last) {
+    psd_status_t status;
+    psd_layer_record_t *layer = &doc->layers.layers[i];
+
+    /* Read bounding box */
+    status = psd_stream_read_be_i32(stream, &layer->bounds.top);
+    if (status != PSD_OK) {
+        return status;
+    }
+    status = psd_stream_read_be_i32(stream, &layer->bounds.left);
+    if (status != PSD_OK)
+        return status;
+    status = psd_stream_read_be_i32(stream, &layer->bounds.bottom);
+    if (status != PSD_OK)
+        return status;
+    status = psd_stream_read_be_i32(stream, &layer->bounds.right);
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    /* Validate bounds are reasonable */
+    /* Check for obviously invalid bounds that suggest file corruption or
+     * misalignment */
+    bool bounds_invalid = false;
+
+    /* Check if bounds are unreasonably large (likely corruption) */
+    if (layer->bounds.top > 1000000 || layer->bounds.left > 1000000 ||
+        layer->bounds.bottom > 1000000 || layer->bounds.right > 1000000 ||
+        layer->bounds.top < -1000000 || layer->bounds.left < -1000000 ||
+        layer->bounds.bottom < -1000000 || layer->bounds.right < -1000000) {
+        bounds_invalid = true;
+    }
+
+    /* Check if bounds make logical sense (bottom >= top, right >= left) */
+    if (!bounds_invalid) {
+        if (layer->bounds.bottom < layer->bounds.top ||
+            layer->bounds.right < layer->bounds.left) {
+            bounds_invalid = true;
+        }
+    }
+
+    /* Check for the specific suspicious pattern: right=height, top=huge,
+     * left=0, bottom=0 */
+    /* This pattern indicates we're reading image dimensions instead of
+     * layer bounds */
+    /* However, a valid full-image layer can have top=0, left=0,
+     * bottom=height, right=width */
+    /* So we only flag as invalid if top is unreasonably large (misalignment
+     * indicator) */
+    if (!bounds_invalid && i == 0 &&
+        layer->bounds.right == (int32_t)doc->height &&
+        layer->bounds.top > 1000000 && layer->bounds.left == 0 &&
+        layer->bounds.bottom == 0) {
+        bounds_invalid = true;
+    }
+
+    /* A full-image layer with top=0, left=0, bottom=height, right=width is
+     * valid */
+    /* Don't flag it as invalid just because right matches height */
+    if (!bounds_invalid && layer->bounds.top == 0 &&
+        layer->bounds.left == 0 &&
+        layer->bounds.bottom == (int32_t)doc->height &&
+        layer->bounds.right == (int32_t)doc->width) {
+        /* This is a valid full-image layer - bounds are correct */
+        bounds_invalid = false;
+    }
+
+    if (bounds_invalid) {
+        /* Don't reset bounds to 0 - keep the original values even if they
+         * look invalid */
+        /* This helps with debugging and allows the caller to see what was
+         * actually in the file */
+        /* The bounds might be invalid due to unsupported layer types (text,
+         * smart objects, etc.) */
+    }
+
+    /* Read number of channels */
+    uint16_t channel_count;
+
+    status = psd_stream_read_be16(stream, &channel_count);
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    /* Validate channel count - if invalid, treat as empty layer */
+    if (channel_count > 56) {
+        /* Invalid channel count suggests misalignment - treat as empty
+         * layer */
+        channel_count = 0;
+    }
+
+    /* Allocate channels */
+    layer->channel_count = channel_count;
+    if (channel_count > 0) {
+        layer->channels = (psd_layer_channel_data_t *)psd_alloc_malloc(
+            &doc->meta.allocator,
+            channel_count * sizeof(psd_layer_channel_data_t));
+        if (!layer->channels) {
+            status = PSD_ERR_OUT_OF_MEMORY;
+            return status;
+        }
+        memset(layer->channels, 0,
+               channel_count * sizeof(psd_layer_channel_data_t));
+
+        /* Read channel descriptors (ID + length only - pixel data is stored
+         * separately) */
+        for (uint16_t j = 0; j < channel_count; j++) {
+            int16_t id;
+            uint64_t length;
+
+            /* Read signed channel ID*/
+            uint16_t tmp;
+            status = psd_stream_read_be16(stream, &tmp);
+            if (status != PSD_OK) {
+                return status;
+            }
+            id = (int16_t)tmp;
+
+            /* Read channel data length */
+            int64_t chan_len_pos = psd_stream_tell(stream);
+            if (chan_len_pos < 0) {
+                status = (psd_status_t)chan_len_pos;
+                return status;
+            }
+
+            if (index) {
+                if (*index_channel >= index->channel_count) {
+                    status = PSD_ERR_INVALID_ARGUMENT;
+                    return status;
+                }
+                status = psd_read_length_width(
+                    stream, psd_layout_index_channel(index, (*index_channel)++, NULL),
+                    &length);
+            } else {
+                status = psd_stream_read_length(stream, doc->is_psb, &length);
+            }
+            if (status != PSD_OK) {
+                return status;
+            }
+
+            /* PSB typically uses 8-byte channel lengths, but some files may
+             * still store 4-byte lengths. If the parsed length is implausible
+             * within the Layer Info subsection bounds, fall back to 4 bytes. */
+            if (doc->is_psb && !index) {
+                int64_t after_len_pos = psd_stream_tell(stream);
+                if (after_len_pos < 0) {
+                    status = (psd_status_t)after_len_pos;
+                    return status;
+                }
+                int64_t remaining_in_layer_info = layer_info_end - after_len_pos;
+                if (remaining_in_layer_info > 0 &&
+                    length > (uint64_t)remaining_in_layer_info) {
+                    if (psd_stream_seek(stream, chan_len_pos) < 0) {
+                        status = PSD_ERR_STREAM_INVALID;
+                        return status;
+                    }
+                    uint32_t len32 = 0;
+                    status = psd_stream_read_be32(stream, &len32);
+                    if (status != PSD_OK) {
+                        return status;
+                    }
+                    length = (uint64_t)len32;
+                }
+            }
+
+            if (!doc->is_psb && length > 0xFFFFFFFFu) {
+                status = PSD_ERR_CORRUPT_DATA;
+                return status;
+            }
+
+            int64_t chan_len_end = psd_stream_tell(stream);
+            if (chan_len_end < 0) {
+                status = (psd_status_t)chan_len_end;
+                return status;
+            }
+            layer->channels[j].length_bytes = (uint8_t)(chan_len_end - chan_len_pos);
+
+            /* Initialize channel structure */
+            /* NOTE: Channel image data (compression type + pixel data) is
+               stored AFTER all layer records, not as part of each layer
+               record. We only store the channel info here. */
+            layer->channels[j].channel_id = id;
+            layer->channels[j].compressed_length = length;
+            psd_once_reset(&layer->channels[j].decoded);
+            layer->channels[j].decoded_data = NULL;
+            layer->channels[j].decoded_length = 0;
+            layer->channels[j].compression = 0;
+            layer->channels[j].compressed_data = NULL;
+            layer->channels[j].compressed_borrowed = false;
+            psd_once_reset(&layer->channels[j].loaded);
+            layer->channels[j].file_offset = 0;
+        }
+    }
+
+    /* Read blend mode signature */
+    status = psd_stream_read_be32(stream, &layer->blend_sig);
+    if (status != PSD_OK)
+        return status;
+
+    /* Read blend mode key */
+    status = psd_stream_read_be32(stream, &layer->blend_key);
+    if (status != PSD_OK)
+        return status;
+
+    /* Validate blend signature - should be "8BIM" or "8B64" */
+    if (layer->blend_sig != 0x3842494D && layer->blend_sig != 0x38423634) {
+        /* If bounds were also invalid, this confirms misalignment - treat
+         * as empty layer */
+        if (bounds_invalid) {
+            /* Reset blend mode to safe defaults */
+            layer->blend_sig = 0x3842494D; /* "8BIM" */
+            layer->blend_key = 0x6E6F726D; /* "norm" */
+        }
+    }
+
+    /* Read opacity (1 byte) */
+    uint8_t byte_val;
+    status = psd_stream_read_exact(stream, &byte_val, 1);
+    if (status != PSD_OK)
+        return status;
+    layer->opacity = byte_val;
+
+    /* Read clipping (1 byte) */
+    status = psd_stream_read_exact(stream, &byte_val, 1);
+    if (status != PSD_OK)
+        return status;
+    layer->clipping = byte_val;
+
+    /* Read flags (1 byte) */
+    status = psd_stream_read_exact(stream, &byte_val, 1);
+    if (status != PSD_OK)
+        return status;
+    layer->flags = byte_val;
+
+    /* Read filler byte (must be 0) */
+    uint8_t filler_byte;
+    status = psd_stream_read_exact(stream, &filler_byte, 1);
+    if (status != PSD_OK)
+        return status;
+
+    /* Read extra layer information length (4 bytes) */
+    /* According to Adobe spec: this is the total length of:
+       1. Layer mask data (4 bytes length + variable data)
+       2. Layer blending ranges (4 bytes length + variable data)
+       3. Layer name (Pascal string, padded to multiple of 4)
+       4. Additional layer information blocks (tagged blocks) */
+    uint32_t extra_length;
+    uint8_t extra_len_bytes[4];
+    status = psd_stream_read_exact(stream, extra_len_bytes, 4);
+    if (status != PSD_OK) {
+        return status;
+    }
+    extra_length = ((uint32_t)extra_len_bytes[0] << 24) |
+                   ((uint32_t)extra_len_bytes[1] << 16) |
+                   ((uint32_t)extra_len_bytes[2] << 8) |
+                   ((uint32_t)extra_len_bytes[3]);
+
+    /* Check if this is an unsupported layer type based on extra_length */
+    /* Unreasonably large extra_length indicates we're misaligned or reading
+     * channel image data instead of layer extra data. Normal layer extra
+     * data
+     * is typically < 100KB. Anything > 1MB is almost certainly wrong. */
+    if (extra_length >
+        1000000) { /* > 1MB is definitely wrong - likely misalignment */
+        /* Mark as empty and skip trying to read extra data */
+        layer->channel_count = 0;
+        if (layer->channels) {
+            psd_alloc_free(&doc->meta.allocator, layer->channels);
+            layer->channels = NULL;
+        }
+        layer->bounds.top = 0;
+        layer->bounds.left = 0;
+        layer->bounds.bottom = 0;
+        layer->bounds.right = 0;
+
+        /* CRITICAL: Even though we're not parsing the extra data, we MUST
+         * skip it in the stream, or we'll be misaligned for the next layer.
+         * However, if skipping would take us past section_end, we've likely
+         * already read into the channel image data section, so we should
+         * stop here. */
+        int64_t current_pos = psd_stream_tell(stream);
+        if (current_pos < 0) {
+            status = (psd_status_t)current_pos;
+            return status;
+        }
+        if (current_pos + (int64_t)extra_length > section_end) {
+            /* We've likely read into channel image data - stop parsing
+             * layers and seek to section_end */
+            status = psd_stream_seek(stream, section_end);
+            if (status < 0) {
+                return status;
+            }
+            /* Leave the remaining layers unparsed */
+            *out_last = true;
+            return PSD_OK;
+        }
+
+        status = psd_stream_skip(stream, extra_length);
+        if (status != PSD_OK) {
+            return status;
+        }
+        /* Don't try to parse extra data */
+        extra_length = 0;
+    }
+
+    /* Store additional layer info (but don't parse it yet) */
+    /* According to spec, extra data contains:
+       1. Layer mask data (4 bytes length + variable data)
+       2. Layer blending ranges (4 bytes length + variable data)
+       3. Layer name (Pascal string, padded to multiple of 4)
+       4. Additional layer information blocks (tagged blocks)
+       The extra_length field specifies the total length of all these fields
+     */
+
+    /* Read extra data ONLY if length is reasonable */
+    /* Skip if unreasonably large (indicates unsupported or corrupted layer)
+     */
+    /* Most normal layers have < 10MB of extra data; anything larger is
+     * likely unsupported */
+
+    /* IMPORTANT: Even if extra_length is 0, we may still need to detect
+       group
+       markers that come from the layer name (legacy Photoshop format) */
+
+    if (extra_length > 0 && extra_length <= 10000000) {
+        layer->additional_data =
+            (uint8_t *)psd_alloc_malloc(&doc->meta.allocator, extra_length);
+        if (!layer->additional_data) {
+            status = PSD_ERR_OUT_OF_MEMORY;
+            return status;
+        }
+
+        layer->additional_length = extra_length;
+
+        status = psd_stream_read_exact(stream, layer->additional_data,
+                                       extra_length);
+        if (status != PSD_OK) {
+            return status;
+        }
+
+        /* Parse additional layer information blocks to detect layer type */
+        /* The extra data contains: layer mask data, blending ranges, layer
+         * name, and additional layer info blocks */
+        /* We'll look for keys that identify unsupported layer types */
+        if (layer->additional_data && layer->additional_length > 0) {
+            /* Scan for unsupported layer type keys */
+            uint8_t *data = layer->additional_data;
+            uint64_t remaining = layer->additional_length;
+            uint8_t *data_end = data + remaining;
+
+            /* Skip layer mask data (starts with 4-byte length) */
+            if (remaining >= 4) {
+                uint32_t mask_len =
+                    ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+                    ((uint32_t)data[2] << 8) | ((uint32_t)data[3]);
+                data += 4;
+                remaining -= 4;
+
+                /* Validate mask_len is reasonable */
+                if (mask_len > 0 && mask_len <= remaining &&
+                    data + mask_len <= data_end) {
+                    data += mask_len;
+                    remaining -= mask_len;
+                } else if (mask_len > remaining) {
+                    /* Invalid mask length - abort parsing this layer's
+                     * extra data */
+                    goto skip_extra_parsing;
+                }
+            }
+
+            /* Skip layer blending ranges (starts with 4-byte length) */
+            if (remaining >= 4) {
+                uint32_t blend_len =
+                    ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+                    ((uint32_t)data[2] << 8) | ((uint32_t)data[3]);
+                data += 4;
+                remaining -= 4;
+
+                /* Validate blend_len is reasonable */
+                if (blend_len > 0 && blend_len <= remaining &&
+                    data + blend_len <= data_end) {
+                    data += blend_len;
+                    remaining -= blend_len;
+                } else if (blend_len > remaining) {
+                    /* Invalid blend length - abort parsing this layer's
+                     * extra data */
+                    goto skip_extra_parsing;
+                }
+            }
+
+            /* Extract layer name (Pascal string, padded to multiple of 4)
+             */
+            if (remaining >= 1) {
+                uint8_t name_len = data[0];
+                uint32_t name_total = 1 + name_len;
+
+                /* Pad to multiple of 4 */
+                if (name_total % 4u != 0u) {
+                    name_total += 4u - (name_total % 4u);
+                }
+
+                if (name_total <= remaining && data + name_total <= data_end) {
+                    if (layer->name == NULL && name_len > 0) {
+
+                        const uint8_t *raw_name = &data[1];
+
+                        /* Convert legacy MacRoman → UTF-8 */
+                        size_t utf8_len = 0;
+                        uint8_t *utf8 = psd_macroman_to_utf8(
+                            &doc->meta.allocator,
+                            raw_name,
+                            name_len,
+                            &utf8_len);
+
+                        if (utf8) {
+                            layer->name = utf8;            /* UTF-8, NUL-terminated */
+                            layer->name_length = utf8_len; /* bytes excluding NUL */
+                        }
+                    }
+                    data += name_total;
+                    remaining -= name_total;
+                } else {
+                    /* Can't read name - abort extra data parsing */
+                    goto skip_extra_parsing;
+                }
+            }
+
+            /* Index the tagged blocks once; descriptors inside them are
+             * parsed only when requested */
+            status = psd_tagged_blocks_index(
+                doc, layer, (uint64_t)(data - layer->additional_data));
+            if (status != PSD_OK) {
+                return status;
+            }
+
+            /* Detect features from the block keys */
+            for (uint32_t b = 0; b < layer->block_count; b++) {
+                const psd_tagged_block_t *block = &layer->blocks[b];
+                const uint8_t *payload =
+                    psd_tagged_block_payload(layer, block);
+                uint64_t block_len = block->length;
+                const uint8_t key[4] = {
+                    (uint8_t)(block->key >> 24), (uint8_t)(block->key >> 16),
+                    (uint8_t)(block->key >> 8), (uint8_t)block->key};
+
+                /* Detect features based on Additional Layer Information
+                 * keys */
+                if (key[0] == 'T' && key[1] == 'y' && key[2] == 'S' &&
+                    key[3] == 'h') {
+                    /* TySh = Text layer */
+                    layer->features.has_text = true;
+                } else if ((key[0] == 'S' && key[1] == 'o' &&
+                            key[2] == 'L' && key[3] == 'd') ||
+                           (key[0] == 'S' && key[1] == 'o' &&
+                            key[2] == 'L' && key[3] == 'E')) {
+                    /* SoLd/SoLE = Smart Object */
+                    layer->features.has_smart_object = true;
+                } else if (key[0] == 'l' && key[1] == 'f' &&
+                           key[2] == 'x' && key[3] == '2') {
+                    /* lfx2 = Layer effects */
+                    layer->features.has_effects = true;
+                } else if (key[0] == 'v' && key[1] == 'm' &&
+                           key[2] == 's' && key[3] == 'k') {
+                    /* vmsk = Vector mask */
+                    layer->features.has_vector_mask = true;
+                } else if (key[0] == 'v' && key[1] == 'm' &&
+                           key[2] == 'n' && key[3] == 's') {
+                    /* vmns = Vector mask (alternate form) */
+                    layer->features.has_vector_mask = true;
+                } else if (key[0] == 'a' && key[1] == 'd' &&
+                           key[2] == 'j') {
+                    /* adj* = Adjustment layer */
+                    layer->features.has_adjustment = true;
+                } else if (
+                    /* Common adjustment layer keys (non-exhaustive) */
+                    (key[0] == 'b' && key[1] == 'r' && key[2] == 'i' && key[3] == 't') || /* Brightness/Contrast */
+                    (key[0] == 'b' && key[1] == 'r' && key[2] == 't' && key[3] == 'C') || /* Brightness/Contrast (alt) */
+                    (key[0] == 'l' && key[1] == 'e' && key[2] == 'v' && key[3] == 'l') || /* Levels */
+                    (key[0] == 'c' && key[1] == 'u' && key[2] == 'r' && key[3] == 'v') || /* Curves */
+                    (key[0] == 'h' && key[1] == 'u' && key[2] == 'e' && key[3] == ' ') || /* Hue/Saturation */
+                    (key[0] == 'h' && key[1] == 'u' && key[2] == 'e' && key[3] == '2') || /* Hue/Saturation (v2) */
+                    (key[0] == 'b' && key[1] == 'l' && key[2] == 'n' && key[3] == 'c') || /* Color Balance */
+                    (key[0] == 'v' && key[1] == 'i' && key[2] == 'b' && key[3] == 'A') || /* Vibrance */
+                    (key[0] == 'e' && key[1] == 'x' && key[2] == 'p' && key[3] == 'A') || /* Exposure */
+                    (key[0] == 'm' && key[1] == 'i' && key[2] == 'x' && key[3] == 'r') || /* Channel Mixer */
+                    (key[0] == 's' && key[1] == 'e' && key[2] == 'l' && key[3] == 'c') || /* Selective Color */
+                    (key[0] == 't' && key[1] == 'h' && key[2] == 'r' && key[3] == 's') || /* Threshold */
+                    (key[0] == 'p' && key[1] == 'o' && key[2] == 's' && key[3] == 't') || /* Posterize */
+                    (key[0] == 'p' && key[1] == 'h' && key[2] == 'f' && key[3] == 'l') || /* Photo Filter */
+                    (key[0] == 'g' && key[1] == 'r' && key[2] == 'd' && key[3] == 'm') || /* Gradient Map */
+                    (key[0] == 'c' && key[1] == 'l' && key[2] == 'r' && key[3] == 'L')    /* Color Lookup */
+                ) {
+                    layer->features.has_adjustment = true;
+                } else if (key[0] == '3' && key[1] == 'd' &&
+                           key[2] == 'L') {
+                    /* 3dL* = 3D layer */
+                    layer->features.has_3d = true;
+                } else if (key[0] == 'l' && key[1] == 's' &&
+                           key[2] == 'c' && key[3] == 't') {
+                    /* lsct = Layer Section divider - group/folder marker */
+                    if (block_len >= 4) {
+                        /* Section type is FIRST field of lsct data */
+                        uint32_t section_type = ((uint32_t)payload[0] << 24) |
+                                                ((uint32_t)payload[1] << 16) |
+                                                ((uint32_t)payload[2] << 8) |
+                                                ((uint32_t)payload[3]);
+
+                        switch (section_type) {
+                        case 1: /* Open folder */
+                        case 2: /* Closed folder */
+                            layer->features.is_group_start = true;
+                            break;
+                        case 3: /* Bounding section divider (group end) */
+                            layer->features.is_group_end = true;
+                            break;
+
+                        default: /* Unknown section type */
+                            break;
+                        }
+                    }
+                } else if ((key[0] == 'S' && key[1] == 'o' &&
+                            key[2] == 'C' && key[3] == 'o') ||
+                           (key[0] == 'G' && key[1] == 'd' &&
+                            key[2] == 'F' && key[3] == 'l') ||
+                           (key[0] == 'P' && key[1] == 't' &&
+                            key[2] == 'F' && key[3] == 'l')) {
+                    /* SoCo/GdFl/PtFl = Fill layer (Solid Color, Gradient,
+                     * Pattern) */
+                    layer->features.has_fill = true;
+                } else if (key[0] == 'v' && key[1] == 't' &&
+                           key[2] == 'r' && key[3] == 'k') {
+                    /* vtrk = Video layer */
+                    layer->features.has_video = true;
+                } else if (key[0] == 'l' && key[1] == 'u' &&
+                           key[2] == 'n' && key[3] == 'i') {
+                    /* 'luni' = Unicode layer name */
+
+                    if (block_len >= 4) {
+                        uint32_t char_count =
+                            ((uint32_t)payload[0] << 24) |
+                            ((uint32_t)payload[1] << 16) |
+                            ((uint32_t)payload[2] << 8) |
+                            (uint32_t)payload[3];
+
+                        size_t utf16_bytes = (size_t)char_count * 2;
+                        if (4 + utf16_bytes <= block_len) {
+
+                            size_t utf8_len = 0;
+                            uint8_t *utf8 = psd_utf16be_to_utf8(
+                                &doc->meta.allocator,
+                                payload + 4,
+                                utf16_bytes,
+                                &utf8_len);
+
+                            if (utf8) {
+                                /* Override legacy name */
+                                if (layer->name) {
+                                    psd_alloc_free(&doc->meta.allocator, layer->name);
+                                }
+                                layer->name = utf8;
+                                layer->name_length = utf8_len;
+                            }
+                        }
+                    }
+                }
+            }
+        skip_extra_parsing
+            :; /* Label for early exit from additional data parsing */
+        }
+    } else if (extra_length > 10000000) {
+        /* Don't try to read unreasonably large extra data - skip it */
+        /* This layer will be treated as empty/unsupported */
+    }
+
+    /* Check if we've gone past the section boundary - this indicates
+     * misalignment */
+    int64_t current_pos = psd_stream_tell(stream);
+    if (current_pos < 0) {
+        status = (psd_status_t)current_pos;
+        return status;
+    }
+    if (current_pos > layer_info_end) {
+        /* We've read past the end of the layer section - severe
+         * misalignment */
+        status = PSD_ERR_CORRUPT_DATA;
+        return status;
+    }
+
+    return PSD_OK;
+}
+
 /**
  * @brief Parse Layer and Mask Information section
  *
@@ -519,13 +1132,20 @@ error:
  *
  * Handles transparency layers (negative layer count) correctly.
  *
+ * With a saved layout index the length widths come from the index instead of
+ * being probed, and channel payload offsets are taken from it instead of
+ * walking the channel image data.
+ *
  * @param stream Stream to read from
  * @param doc Document to populate with layer information
+ * @param index Saved layout of this stream, or NULL
  * @return PSD_OK on success, negative error code on failure
  */
-static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *doc) {
+static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *doc,
+                                         const psd_layout_index_t *index) {
     psd_status_t status;
     uint64_t section_length;
+    uint64_t index_channel = 0;
 
     /* Initialize layers */
     doc->layers.layers = NULL;
@@ -542,14 +1162,29 @@ static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *d
     if (section_len_pos < 0) {
         return (psd_status_t)section_len_pos;
     }
+    if (index && section_len_pos != index->layout.section_start) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
 
-    status = psd_stream_read_length(stream, doc->is_psb, &section_length);
+    if (index) {
+        status = psd_read_length_width(stream, index->layout.section_length_bytes,
+                                       &section_length);
+    } else {
+        status = psd_stream_read_length(stream, doc->is_psb, &section_length);
+    }
     if (status != PSD_OK) {
         return status;
     }
 
     /* If section is empty, we're done */
     if (section_length == 0) {
+        doc->layout.section_start = section_len_pos;
+        doc->layout.channel_data_start = psd_stream_tell(stream);
+        doc->layout.section_length_bytes =
+            (uint8_t)(doc->layout.channel_data_start - section_len_pos);
+        doc->layout.info_length_bytes = doc->layout.section_length_bytes;
+        doc->layout.lengths_exclude_compression = false;
+        doc->layout.recorded = doc->layout.channel_data_start >= 0;
         return PSD_OK;
     }
 
@@ -562,7 +1197,7 @@ static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *d
     }
 
     int64_t section_end = section_start + (int64_t)section_length;
-    if (doc->is_psb) {
+    if (doc->is_psb && !index) {
         int64_t probe = psd_stream_seek(stream, section_end);
         if (probe < 0) {
             /* Fall back to 4-byte section length */
@@ -600,7 +1235,12 @@ static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *d
     }
 
     uint64_t layer_info_length64 = 0;
-    status = psd_stream_read_length(stream, doc->is_psb, &layer_info_length64);
+    if (index) {
+        status = psd_read_length_width(stream, index->layout.info_length_bytes,
+                                       &layer_info_length64);
+    } else {
+        status = psd_stream_read_length(stream, doc->is_psb, &layer_info_length64);
+    }
     if (status != PSD_OK) {
         return status;
     }
@@ -614,7 +1254,7 @@ static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *d
     /* Basic sanity: layer info must fit within the overall section.
      * If not, try a 4-byte length fallback (seen in some PSB writers). */
     if (layer_info_end > section_end) {
-        if (doc->is_psb) {
+        if (doc->is_psb && !index) {
             if (psd_stream_seek(stream, layer_info_len_pos) < 0) {
                 return PSD_ERR_STREAM_INVALID;
             }
@@ -655,659 +1295,84 @@ static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *d
     /* Allocate layer array */
     if (layer_count > 0) {
         doc->layers.layers = (psd_layer_record_t *)psd_alloc_malloc(
-            doc->allocator, layer_count * sizeof(psd_layer_record_t));
+            &doc->meta.allocator, layer_count * sizeof(psd_layer_record_t));
         if (!doc->layers.layers) {
             return PSD_ERR_OUT_OF_MEMORY;
         }
 
         /* Initialize all layers to zero */
         for (int32_t i = 0; i < layer_count; i++) {
-            doc->layers.layers[i].bounds.top = 0;
-            doc->layers.layers[i].bounds.left = 0;
-            doc->layers.layers[i].bounds.bottom = 0;
-            doc->layers.layers[i].bounds.right = 0;
-            doc->layers.layers[i].channels = NULL;
-            doc->layers.layers[i].channel_count = 0;
-            doc->layers.layers[i].blend_sig = 0;
-            doc->layers.layers[i].blend_key = 0;
-            doc->layers.layers[i].opacity = 255;
-            doc->layers.layers[i].clipping = 0;
-            doc->layers.layers[i].flags = 0;
-            doc->layers.layers[i].name = NULL;
-            doc->layers.layers[i].name_length = 0;
-            doc->layers.layers[i].additional_data = NULL;
-            doc->layers.layers[i].additional_length = 0;
-            doc->layers.layers[i].descriptor = NULL;
-            /* Initialize features to all false */
-            memset(&doc->layers.layers[i].features, 0,
-                   sizeof(psd_layer_features_t));
+            psd_layer_record_init(&doc->layers.layers[i]);
         }
     }
 
     /* Parse layer records */
     for (int32_t i = 0; i < layer_count; i++) {
-        psd_layer_record_t *layer = &doc->layers.layers[i];
-
-        /* Read bounding box */
-        status = psd_stream_read_be_i32(stream, &layer->bounds.top);
+        bool last = false;
+        status = psd_parse_layer_record(stream, doc, i, index, &index_channel,
+                                        layer_info_end, section_end, &last);
         if (status != PSD_OK) {
             goto error;
         }
-        status = psd_stream_read_be_i32(stream, &layer->bounds.left);
-        if (status != PSD_OK)
-            goto error;
-        status = psd_stream_read_be_i32(stream, &layer->bounds.bottom);
-        if (status != PSD_OK)
-            goto error;
-        status = psd_stream_read_be_i32(stream, &layer->bounds.right);
-        if (status != PSD_OK) {
-            goto error;
+        if (last) {
+            /* Mark remaining layers as not parsed */
+            layer_count = i + 1;
+            break;
         }
+    }
 
-        /* Validate bounds are reasonable */
-        /* Check for obviously invalid bounds that suggest file corruption or
-         * misalignment */
-        bool bounds_invalid = false;
+    doc->layers.layer_count = layer_count;
 
-        /* Check if bounds are unreasonably large (likely corruption) */
-        if (layer->bounds.top > 1000000 || layer->bounds.left > 1000000 ||
-            layer->bounds.bottom > 1000000 || layer->bounds.right > 1000000 ||
-            layer->bounds.top < -1000000 || layer->bounds.left < -1000000 ||
-            layer->bounds.bottom < -1000000 || layer->bounds.right < -1000000) {
-            bounds_invalid = true;
-        }
+    /* Channel image data section (compression type + pixel data for all layers)
+     */
+    /* This is stored AFTER all layer records, not as part of each layer record
+     */
+    /* Structure: For each layer, for each channel:
+     *   - 2 bytes: compression type (0=RAW, 1=RLE, 2=ZIP, 3=ZIP+prediction)
+     *   - Variable: pixel data (length was stored in channel descriptor)
+     */
 
-        /* Check if bounds make logical sense (bottom >= top, right >= left) */
-        if (!bounds_invalid) {
-            if (layer->bounds.bottom < layer->bounds.top ||
-                layer->bounds.right < layer->bounds.left) {
-                bounds_invalid = true;
-            }
-        }
+    int64_t channel_data_start = psd_stream_tell(stream);
+    if (channel_data_start < 0) {
+        status = (psd_status_t)channel_data_start;
+        goto error;
+    }
 
-        /* Check for the specific suspicious pattern: right=height, top=huge,
-         * left=0, bottom=0 */
-        /* This pattern indicates we're reading image dimensions instead of
-         * layer bounds */
-        /* However, a valid full-image layer can have top=0, left=0,
-         * bottom=height, right=width */
-        /* So we only flag as invalid if top is unreasonably large (misalignment
-         * indicator) */
-        if (!bounds_invalid && i == 0 &&
-            layer->bounds.right == (int32_t)doc->height &&
-            layer->bounds.top > 1000000 && layer->bounds.left == 0 &&
-            layer->bounds.bottom == 0) {
-            bounds_invalid = true;
-        }
+    doc->layout.section_start = section_len_pos;
+    doc->layout.channel_data_start = channel_data_start;
+    doc->layout.section_length_bytes = (uint8_t)(section_start - section_len_pos);
+    doc->layout.info_length_bytes = (uint8_t)(layer_info_start - layer_info_len_pos);
 
-        /* A full-image layer with top=0, left=0, bottom=height, right=width is
-         * valid */
-        /* Don't flag it as invalid just because right matches height */
-        if (!bounds_invalid && layer->bounds.top == 0 &&
-            layer->bounds.left == 0 &&
-            layer->bounds.bottom == (int32_t)doc->height &&
-            layer->bounds.right == (int32_t)doc->width) {
-            /* This is a valid full-image layer - bounds are correct */
-            bounds_invalid = false;
+    if (index) {
+        /* The records must have come out exactly as when the index was saved */
+        if (channel_data_start != index->layout.channel_data_start ||
+            (uint32_t)layer_count != index->layer_count ||
+            index_channel != index->channel_count) {
+            status = PSD_ERR_INVALID_ARGUMENT;
+            goto error;
         }
 
-        if (bounds_invalid) {
-            /* Don't reset bounds to 0 - keep the original values even if they
-             * look invalid */
-            /* This helps with debugging and allows the caller to see what was
-             * actually in the file */
-            /* The bounds might be invalid due to unsupported layer types (text,
-             * smart objects, etc.) */
+        uint64_t n = 0;
+        for (int32_t i = 0; i < layer_count; i++) {
+            psd_layer_record_t *layer = &doc->layers.layers[i];
+            for (uint16_t ch = 0; ch < layer->channel_count; ch++) {
+                psd_layout_index_channel(index, n++, &layer->channels[ch]);
+                if ((int64_t)(layer->channels[ch].file_offset +
+                              layer->channels[ch].compressed_length) > layer_info_end) {
+                    status = PSD_ERR_INVALID_ARGUMENT;
+                    goto error;
+                }
+            }
         }
+        doc->layout.lengths_exclude_compression = index->layout.lengths_exclude_compression;
+        doc->layout.recorded = true;
 
-        /* Read number of channels */
-        uint16_t channel_count;
-
-        status = psd_stream_read_be16(stream, &channel_count);
-        if (status != PSD_OK) {
+        if (psd_stream_seek(stream, layer_info_end) < 0) {
+            status = PSD_ERR_STREAM_EOF;
             goto error;
         }
-
-        /* Validate channel count - if invalid, treat as empty layer */
-        if (channel_count > 56) {
-            /* Invalid channel count suggests misalignment - treat as empty
-             * layer */
-            channel_count = 0;
-        }
-
-        /* Allocate channels */
-        layer->channel_count = channel_count;
-        if (channel_count > 0) {
-            layer->channels = (psd_layer_channel_data_t *)psd_alloc_malloc(
-                doc->allocator,
-                channel_count * sizeof(psd_layer_channel_data_t));
-            if (!layer->channels) {
-                status = PSD_ERR_OUT_OF_MEMORY;
-                goto error;
-            }
-
-            /* Read channel descriptors (ID + length only - pixel data is stored
-             * separately) */
-            for (uint16_t j = 0; j < channel_count; j++) {
-                int16_t id;
-                uint64_t length;
-
-                /* Read signed channel ID*/
-                uint16_t tmp;
-                status = psd_stream_read_be16(stream, &tmp);
-                if (status != PSD_OK) {
-                    goto error;
-                }
-                id = (int16_t)tmp;
-
-                /* Read channel data length */
-                int64_t chan_len_pos = psd_stream_tell(stream);
-                if (chan_len_pos < 0) {
-                    status = (psd_status_t)chan_len_pos;
-                    goto error;
-                }
-
-                status = psd_stream_read_length(stream, doc->is_psb, &length);
-                if (status != PSD_OK) {
-                    goto error;
-                }
-
-                /* PSB typically uses 8-byte channel lengths, but some files may
-                 * still store 4-byte lengths. If the parsed length is implausible
-                 * within the Layer Info subsection bounds, fall back to 4 bytes. */
-                if (doc->is_psb) {
-                    int64_t after_len_pos = psd_stream_tell(stream);
-                    if (after_len_pos < 0) {
-                        status = (psd_status_t)after_len_pos;
-                        goto error;
-                    }
-                    int64_t remaining_in_layer_info = layer_info_end - after_len_pos;
-                    if (remaining_in_layer_info > 0 &&
-                        length > (uint64_t)remaining_in_layer_info) {
-                        if (psd_stream_seek(stream, chan_len_pos) < 0) {
-                            status = PSD_ERR_STREAM_INVALID;
-                            goto error;
-                        }
-                        uint32_t len32 = 0;
-                        status = psd_stream_read_be32(stream, &len32);
-                        if (status != PSD_OK) {
-                            goto error;
-                        }
-                        length = (uint64_t)len32;
-                    }
-                }
-
-                if (!doc->is_psb && length > 0xFFFFFFFFu) {
-                    status = PSD_ERR_CORRUPT_DATA;
-                    goto error;
-                }
-
-                /* Initialize channel structure */
-                /* NOTE: Channel image data (compression type + pixel data) is
-                   stored AFTER all layer records, not as part of each layer
-                   record. We only store the channel info here. */
-                layer->channels[j].channel_id = id;
-                layer->channels[j].compressed_length = length;
-                layer->channels[j].is_decoded = false;
-                layer->channels[j].decoded_data = NULL;
-                layer->channels[j].decoded_length = 0;
-                layer->channels[j].compression = 0;
-                layer->channels[j].compressed_data = NULL;
-            }
-        }
-
-        /* Read blend mode signature */
-        status = psd_stream_read_be32(stream, &layer->blend_sig);
-        if (status != PSD_OK)
-            goto error;
-
-        /* Read blend mode key */
-        status = psd_stream_read_be32(stream, &layer->blend_key);
-        if (status != PSD_OK)
-            goto error;
-
-        /* Validate blend signature - should be "8BIM" or "8B64" */
-        if (layer->blend_sig != 0x3842494D && layer->blend_sig != 0x38423634) {
-            /* If bounds were also invalid, this confirms misalignment - treat
-             * as empty layer */
-            if (bounds_invalid) {
-                /* Reset blend mode to safe defaults */
-                layer->blend_sig = 0x3842494D; /* "8BIM" */
-                layer->blend_key = 0x6E6F726D; /* "norm" */
-            }
-        }
-
-        /* Read opacity (1 byte) */
-        uint8_t byte_val;
-        status = psd_stream_read_exact(stream, &byte_val, 1);
-        if (status != PSD_OK)
-            goto error;
-        layer->opacity = byte_val;
-
-        /* Read clipping (1 byte) */
-        status = psd_stream_read_exact(stream, &byte_val, 1);
-        if (status != PSD_OK)
-            goto error;
-        layer->clipping = byte_val;
-
-        /* Read flags (1 byte) */
-        status = psd_stream_read_exact(stream, &byte_val, 1);
-        if (status != PSD_OK)
-            goto error;
-        layer->flags = byte_val;
-
-        /* Read filler byte (must be 0) */
-        uint8_t filler_byte;
-        status = psd_stream_read_exact(stream, &filler_byte, 1);
-        if (status != PSD_OK)
-            goto error;
-
-        /* Read extra layer information length (4 bytes) */
-        /* According to Adobe spec: this is the total length of:
-           1. Layer mask data (4 bytes length + variable data)
-           2. Layer blending ranges (4 bytes length + variable data)
-           3. Layer name (Pascal string, padded to multiple of 4)
-           4. Additional layer information blocks (tagged blocks) */
-        uint32_t extra_length;
-        uint8_t extra_len_bytes[4];
-        status = psd_stream_read_exact(stream, extra_len_bytes, 4);
-        if (status != PSD_OK) {
-            goto error;
-        }
-        extra_length = ((uint32_t)extra_len_bytes[0] << 24) |
-                       ((uint32_t)extra_len_bytes[1] << 16) |
-                       ((uint32_t)extra_len_bytes[2] << 8) |
-                       ((uint32_t)extra_len_bytes[3]);
-
-        /* Check if this is an unsupported layer type based on extra_length */
-        /* Unreasonably large extra_length indicates we're misaligned or reading
-         * channel image data instead of layer extra data. Normal layer extra
-         * data
-         * is typically < 100KB. Anything > 1MB is almost certainly wrong. */
-        if (extra_length >
-            1000000) { /* > 1MB is definitely wrong - likely misalignment */
-            /* Mark as empty and skip trying to read extra data */
-            layer->channel_count = 0;
-            if (layer->channels) {
-                psd_alloc_free(doc->allocator, layer->channels);
-                layer->channels = NULL;
-            }
-            layer->bounds.top = 0;
-            layer->bounds.left = 0;
-            layer->bounds.bottom = 0;
-            layer->bounds.right = 0;
-
-            /* CRITICAL: Even though we're not parsing the extra data, we MUST
-             * skip it in the stream, or we'll be misaligned for the next layer.
-             * However, if skipping would take us past section_end, we've likely
-             * already read into the channel image data section, so we should
-             * stop here. */
-            int64_t current_pos = psd_stream_tell(stream);
-            if (current_pos < 0) {
-                status = (psd_status_t)current_pos;
-                goto error;
-            }
-            if (current_pos + (int64_t)extra_length > section_end) {
-                /* We've likely read into channel image data - stop parsing
-                 * layers and seek to section_end */
-                status = psd_stream_seek(stream, section_end);
-                if (status < 0) {
-                    goto error;
-                }
-                /* Mark remaining layers as not parsed */
-                layer_count = i + 1;
-                break; /* Exit the layer parsing loop */
-            }
-
-            status = psd_stream_skip(stream, extra_length);
-            if (status != PSD_OK) {
-                goto error;
-            }
-            /* Don't try to parse extra data */
-            extra_length = 0;
-        }
-
-        /* Store additional layer info (but don't parse it yet) */
-        /* According to spec, extra data contains:
-           1. Layer mask data (4 bytes length + variable data)
-           2. Layer blending ranges (4 bytes length + variable data)
-           3. Layer name (Pascal string, padded to multiple of 4)
-           4. Additional layer information blocks (tagged blocks)
-           The extra_length field specifies the total length of all these fields
-         */
-
-        /* Read extra data ONLY if length is reasonable */
-        /* Skip if unreasonably large (indicates unsupported or corrupted layer)
-         */
-        /* Most normal layers have < 10MB of extra data; anything larger is
-         * likely unsupported */
-
-        /* IMPORTANT: Even if extra_length is 0, we may still need to detect
-           group
-           markers that come from the layer name (legacy Photoshop format) */
-
-        if (extra_length > 0 && extra_length <= 10000000) {
-            layer->additional_data =
-                (uint8_t *)psd_alloc_malloc(doc->allocator, extra_length);
-            if (!layer->additional_data) {
-                status = PSD_ERR_OUT_OF_MEMORY;
-                goto error;
-            }
-
-            layer->additional_length = extra_length;
-
-            status = psd_stream_read_exact(stream, layer->additional_data,
-                                           extra_length);
-            if (status != PSD_OK) {
-                goto error;
-            }
-
-            /* Parse additional layer information blocks to detect layer type */
-            /* The extra data contains: layer mask data, blending ranges, layer
-             * name, and additional layer info blocks */
-            /* We'll look for keys that identify unsupported layer types */
-            if (layer->additional_data && layer->additional_length > 0) {
-                /* Scan for unsupported layer type keys */
-                uint8_t *data = layer->additional_data;
-                uint64_t remaining = layer->additional_length;
-                uint8_t *data_end = data + remaining;
-
-                /* Skip layer mask data (starts with 4-byte length) */
-                if (remaining >= 4) {
-                    uint32_t mask_len =
-                        ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
-                        ((uint32_t)data[2] << 8) | ((uint32_t)data[3]);
-                    data += 4;
-                    remaining -= 4;
-
-                    /* Validate mask_len is reasonable */
-                    if (mask_len > 0 && mask_len <= remaining &&
-                        data + mask_len <= data_end) {
-                        data += mask_len;
-                        remaining -= mask_len;
-                    } else if (mask_len > remaining) {
-                        /* Invalid mask length - abort parsing this layer's
-                         * extra data */
-                        goto skip_extra_parsing;
-                    }
-                }
-
-                /* Skip layer blending ranges (starts with 4-byte length) */
-                if (remaining >= 4) {
-                    uint32_t blend_len =
-                        ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
-                        ((uint32_t)data[2] << 8) | ((uint32_t)data[3]);
-                    data += 4;
-                    remaining -= 4;
-
-                    /* Validate blend_len is reasonable */
-                    if (blend_len > 0 && blend_len <= remaining &&
-                        data + blend_len <= data_end) {
-                        data += blend_len;
-                        remaining -= blend_len;
-                    } else if (blend_len > remaining) {
-                        /* Invalid blend length - abort parsing this layer's
-                         * extra data */
-                        goto skip_extra_parsing;
-                    }
-                }
-
-                /* Extract layer name (Pascal string, padded to multiple of 4)
-                 */
-                if (remaining >= 1) {
-                    uint8_t name_len = data[0];
-                    uint32_t name_total = 1 + name_len;
-
-                    /* Pad to multiple of 4 */
-                    if (name_total % 4u != 0u) {
-                        name_total += 4u - (name_total % 4u);
-                    }
-
-                    if (name_total <= remaining && data + name_total <= data_end) {
-                        if (layer->name == NULL && name_len > 0) {
-
-                            const uint8_t *raw_name = &data[1];
-
-                            /* Convert legacy MacRoman → UTF-8 */
-                            size_t utf8_len = 0;
-                            uint8_t *utf8 = psd_macroman_to_utf8(
-                                doc->allocator,
-                                raw_name,
-                                name_len,
-                                &utf8_len);
-
-                            if (utf8) {
-                                layer->name = utf8;            /* UTF-8, NUL-terminated */
-                                layer->name_length = utf8_len; /* bytes excluding NUL */
-                            }
-                        }
-                        data += name_total;
-                        remaining -= name_total;
-                    } else {
-                        /* Can't read name - abort extra data parsing */
-                        goto skip_extra_parsing;
-                    }
-                }
-
-                /* Scan additional layer info blocks to detect features */
-                while (remaining >=
-                       12) { /* Minimum: signature (4) + key (4) + length (4) */
-                    /* Ensure we don't read past the end */
-                    if (data + 12 > data_end) {
-                        break;
-                    }
-
-                    /* Signature at data[0-3], but we only care about the key */
-                    uint32_t sig =
-                        ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
-                        ((uint32_t)data[2] << 8) | ((uint32_t)data[3]);
-
-                    /* Check for valid signature */
-                    if (sig != 0x3842494D &&
-                        sig != 0x38423634) { /* "8BIM" or "8B64" */
-                        /* Not a valid block signature - stop parsing */
-                        break;
-                    }
-
-                    uint8_t key[4] = {data[4], data[5], data[6], data[7]};
-                    uint32_t block_len =
-                        ((uint32_t)data[8] << 24) | ((uint32_t)data[9] << 16) |
-                        ((uint32_t)data[10] << 8) | ((uint32_t)data[11]);
-
-                    /* Validate block_len doesn't exceed remaining data */
-                    if (block_len > remaining - 12) {
-                        /* Block claims to be larger than remaining data */
-                        break;
-                    }
-
-                    /* Detect features based on Additional Layer Information
-                     * keys */
-                    if (key[0] == 'T' && key[1] == 'y' && key[2] == 'S' &&
-                        key[3] == 'h') {
-                        /* TySh = Text layer */
-                        layer->features.has_text = true;
-                    } else if ((key[0] == 'S' && key[1] == 'o' &&
-                                key[2] == 'L' && key[3] == 'd') ||
-                               (key[0] == 'S' && key[1] == 'o' &&
-                                key[2] == 'L' && key[3] == 'E')) {
-                        /* SoLd/SoLE = Smart Object */
-                        layer->features.has_smart_object = true;
-                    } else if (key[0] == 'l' && key[1] == 'f' &&
-                               key[2] == 'x' && key[3] == '2') {
-                        /* lfx2 = Layer effects */
-                        layer->features.has_effects = true;
-                    } else if (key[0] == 'v' && key[1] == 'm' &&
-                               key[2] == 's' && key[3] == 'k') {
-                        /* vmsk = Vector mask */
-                        layer->features.has_vector_mask = true;
-                    } else if (key[0] == 'v' && key[1] == 'm' &&
-                               key[2] == 'n' && key[3] == 's') {
-                        /* vmns = Vector mask (alternate form) */
-                        layer->features.has_vector_mask = true;
-                    } else if (key[0] == 'a' && key[1] == 'd' &&
-                               key[2] == 'j') {
-                        /* adj* = Adjustment layer */
-                        layer->features.has_adjustment = true;
-                    } else if (
-                        /* Common adjustment layer keys (non-exhaustive) */
-                        (key[0] == 'b' && key[1] == 'r' && key[2] == 'i' && key[3] == 't') || /* Brightness/Contrast */
-                        (key[0] == 'b' && key[1] == 'r' && key[2] == 't' && key[3] == 'C') || /* Brightness/Contrast (alt) */
-                        (key[0] == 'l' && key[1] == 'e' && key[2] == 'v' && key[3] == 'l') || /* Levels */
-                        (key[0] == 'c' && key[1] == 'u' && key[2] == 'r' && key[3] == 'v') || /* Curves */
-                        (key[0] == 'h' && key[1] == 'u' && key[2] == 'e' && key[3] == ' ') || /* Hue/Saturation */
-                        (key[0] == 'h' && key[1] == 'u' && key[2] == 'e' && key[3] == '2') || /* Hue/Saturation (v2) */
-                        (key[0] == 'b' && key[1] == 'l' && key[2] == 'n' && key[3] == 'c') || /* Color Balance */
-                        (key[0] == 'v' && key[1] == 'i' && key[2] == 'b' && key[3] == 'A') || /* Vibrance */
-                        (key[0] == 'e' && key[1] == 'x' && key[2] == 'p' && key[3] == 'A') || /* Exposure */
-                        (key[0] == 'm' && key[1] == 'i' && key[2] == 'x' && key[3] == 'r') || /* Channel Mixer */
-                        (key[0] == 's' && key[1] == 'e' && key[2] == 'l' && key[3] == 'c') || /* Selective Color */
-                        (key[0] == 't' && key[1] == 'h' && key[2] == 'r' && key[3] == 's') || /* Threshold */
-                        (key[0] == 'p' && key[1] == 'o' && key[2] == 's' && key[3] == 't') || /* Posterize */
-                        (key[0] == 'p' && key[1] == 'h' && key[2] == 'f' && key[3] == 'l') || /* Photo Filter */
-                        (key[0] == 'g' && key[1] == 'r' && key[2] == 'd' && key[3] == 'm') || /* Gradient Map */
-                        (key[0] == 'c' && key[1] == 'l' && key[2] == 'r' && key[3] == 'L')    /* Color Lookup */
-                    ) {
-                        layer->features.has_adjustment = true;
-                    } else if (key[0] == '3' && key[1] == 'd' &&
-                               key[2] == 'L') {
-                        /* 3dL* = 3D layer */
-                        layer->features.has_3d = true;
-                    } else if (key[0] == 'l' && key[1] == 's' &&
-                               key[2] == 'c' && key[3] == 't') {
-                        /* lsct = Layer Section divider - group/folder marker */
-                        if (block_len >= 4 &&
-                            remaining >= 12 + block_len &&
-                            data + 12 + block_len <= data_end) {
-
-                            uint8_t *payload = data + 12;
-                            /* Section type is FIRST field of lsct data */
-                            uint32_t section_type = ((uint32_t)payload[0] << 24) |
-                                                    ((uint32_t)payload[1] << 16) |
-                                                    ((uint32_t)payload[2] << 8) |
-                                                    ((uint32_t)payload[3]);
-
-                            switch (section_type) {
-                            case 1: /* Open folder */
-                            case 2: /* Closed folder */
-                                layer->features.is_group_start = true;
-                                break;
-                            case 3: /* Bounding section divider (group end) */
-                                layer->features.is_group_end = true;
-                                break;
-
-                            default: /* Unknown section type */
-                                break;
-                            }
-                        }
-                    } else if ((key[0] == 'S' && key[1] == 'o' &&
-                                key[2] == 'C' && key[3] == 'o') ||
-                               (key[0] == 'G' && key[1] == 'd' &&
-                                key[2] == 'F' && key[3] == 'l') ||
-                               (key[0] == 'P' && key[1] == 't' &&
-                                key[2] == 'F' && key[3] == 'l')) {
-                        /* SoCo/GdFl/PtFl = Fill layer (Solid Color, Gradient,
-                         * Pattern) */
-                        layer->features.has_fill = true;
-                    } else if (key[0] == 'v' && key[1] == 't' &&
-                               key[2] == 'r' && key[3] == 'k') {
-                        /* vtrk = Video layer */
-                        layer->features.has_video = true;
-                    } else if (key[0] == 'l' && key[1] == 'u' &&
-                               key[2] == 'n' && key[3] == 'i') {
-                        /* 'luni' = Unicode layer name */
-
-                        if (block_len >= 4) {
-                            const uint8_t *payload = data + 12;
-
-                            uint32_t char_count =
-                                ((uint32_t)payload[0] << 24) |
-                                ((uint32_t)payload[1] << 16) |
-                                ((uint32_t)payload[2] << 8) |
-                                (uint32_t)payload[3];
-
-                            size_t utf16_bytes = (size_t)char_count * 2;
-                            if (4 + utf16_bytes <= block_len) {
-
-                                size_t utf8_len = 0;
-                                uint8_t *utf8 = psd_utf16be_to_utf8(
-                                    doc->allocator,
-                                    payload + 4,
-                                    utf16_bytes,
-                                    &utf8_len);
-
-                                if (utf8) {
-                                    /* Override legacy name */
-                                    if (layer->name) {
-                                        psd_alloc_free(doc->allocator, layer->name);
-                                    }
-                                    layer->name = utf8;
-                                    layer->name_length = utf8_len;
-                                }
-                            }
-                        }
-                    }
-
-                    /* Move to next block
-                     * Adobe spec: signature(4) + key(4) + length(4) +
-                     * data(length)
-                     * Data length is padded to EVEN boundary (not 4-byte) */
-
-                    /* Data length MUST be even (padded with 0 if odd) */
-                    uint32_t padded_len = block_len;
-                    if (block_len % 2 != 0) {
-                        padded_len++;
-                    }
-
-                    uint32_t block_total = 12 + padded_len;
-
-                    /* Ensure we don't go past the end */
-                    if (block_total <= remaining &&
-                        data + block_total <= data_end) {
-                        data += block_total;
-                        remaining -= block_total;
-                    } else {
-                        /* Can't advance safely */
-                        break;
-                    }
-                }
-            skip_extra_parsing
-                :; /* Label for early exit from additional data parsing */
-            }
-        } else if (extra_length > 10000000) {
-            /* Don't try to read unreasonably large extra data - skip it */
-            /* This layer will be treated as empty/unsupported */
-        }
-
-        /* Check if we've gone past the section boundary - this indicates
-         * misalignment */
-        int64_t current_pos = psd_stream_tell(stream);
-        if (current_pos < 0) {
-            status = (psd_status_t)current_pos;
-            goto error;
-        }
-        if (current_pos > layer_info_end) {
-            /* We've read past the end of the layer section - severe
-             * misalignment */
-            status = PSD_ERR_CORRUPT_DATA;
-            goto error;
-        }
-    }
-
-    doc->layers.layer_count = layer_count;
-
-    /* Channel image data section (compression type + pixel data for all layers)
-     */
-    /* This is stored AFTER all layer records, not as part of each layer record
-     */
-    /* Structure: For each layer, for each channel:
-     *   - 2 bytes: compression type (0=RAW, 1=RLE, 2=ZIP, 3=ZIP+prediction)
-     *   - Variable: pixel data (length was stored in channel descriptor)
-     */
-
-    int64_t channel_data_start = psd_stream_tell(stream);
-    if (channel_data_start < 0) {
-        return (psd_status_t)channel_data_start;
-    }
+        goto global_mask;
+    }
 
     /* Determine whether per-channel lengths include the 2-byte compression field.
      *
@@ -1334,8 +1399,10 @@ static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *d
     const uint64_t rem_u64 = (uint64_t)remaining_channel_bytes;
     const bool lengths_exclude_compression =
         (sum_channel_lengths + 2u * total_channels == rem_u64);
+    doc->layout.lengths_exclude_compression = lengths_exclude_compression;
 
     /* Parse channel image data for each layer */
+    uint64_t channel_read_start = psd_stats_phase_begin(doc->stats, PSD_PHASE_CHANNEL_READ);
     for (int32_t i = 0; i < layer_count; i++) {
         psd_layer_record_t *layer = &doc->layers.layers[i];
 
@@ -1375,6 +1442,31 @@ static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *d
                 channel->compressed_length = data_length;
             }
 
+            int64_t payload_pos = psd_stream_tell(stream);
+            if (payload_pos < 0) {
+                status = (psd_status_t)payload_pos;
+                goto error;
+            }
+            channel->file_offset = (uint64_t)payload_pos;
+
+            /* Memory-mapped streams hand out a view of the payload instead of
+             * a copy; the document retains the mapping once parsing succeeds. */
+            channel->compressed_data =
+                (uint8_t *)psd_stream_borrow(stream, data_length);
+            if (channel->compressed_data) {
+                channel->compressed_borrowed = true;
+                continue;
+            }
+
+            /* Metadata-only parse: leave the payload in the stream */
+            if (doc->parse_flags & PSD_PARSE_SKIP_LAYER_PIXELS) {
+                if (psd_stream_seek(stream, payload_pos + (int64_t)data_length) < 0) {
+                    status = PSD_ERR_STREAM_EOF;
+                    goto error;
+                }
+                continue;
+            }
+
             /* Allocate buffer for compressed data */
             channel->compressed_data = (uint8_t *)psd_alloc_malloc(doc->allocator, data_length);
             if (!channel->compressed_data) {
@@ -1391,13 +1483,17 @@ static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *d
         }
     }
 
+    psd_stats_phase_end(doc->stats, PSD_PHASE_CHANNEL_READ, channel_read_start);
+
     /* Validate layer info end */
     if (psd_stream_tell(stream) != layer_info_end) {
         psd_stream_seek(stream, layer_info_end);
     }
+    doc->layout.recorded = true;
 
     /* ---- Global Layer Mask Info ---- */
     uint32_t global_mask_length;
+global_mask:
     status = psd_stream_read_be32(stream, &global_mask_length);
     if (status != PSD_OK) {
         goto error;
@@ -1429,7 +1525,12 @@ static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *d
     }
 
     if (final_pos < section_end) {
-        /* Skip any remaining (often additional layer info) bytes */
+        /* Note the files embedded for smart objects, then skip the rest of
+         * the additional layer info */
+        status = psd_embedded_files_scan(stream, doc, section_end);
+        if (status != PSD_OK) {
+            return status;
+        }
         int64_t seek_result = psd_stream_seek(stream, section_end);
         if (seek_result < 0) {
             return (psd_status_t)seek_result;
@@ -1442,46 +1543,126 @@ static psd_status_t psd_parse_layer_info(psd_stream_t *stream, psd_document_t *d
     return PSD_OK;
 
 error:
-    /* Free allocated layers on error */
+    /* Free channel payloads read so far; the records themselves live in the
+     * metadata arena */
     if (doc->layers.layers) {
         for (int32_t i = 0; i < layer_count; i++) {
-            if (doc->layers.layers[i].channels) {
-                psd_alloc_free(doc->allocator, doc->layers.layers[i].channels);
-            }
-            if (doc->layers.layers[i].additional_data) {
-                psd_alloc_free(doc->allocator,
-                               doc->layers.layers[i].additional_data);
+            psd_layer_record_t *layer = &doc->layers.layers[i];
+            for (size_t j = 0; layer->channels && j < layer->channel_count; j++) {
+                if (layer->channels[j].compressed_data &&
+                    !layer->channels[j].compressed_borrowed) {
+                    psd_alloc_free(doc->allocator, layer->channels[j].compressed_data);
+                }
             }
         }
-        psd_alloc_free(doc->allocator, doc->layers.layers);
         doc->layers.layers = NULL;
     }
     return status;
 }
 
+/**
+ * @brief Free the pixel payloads of every layer channel
+ *
+ * Drops the layer array too: records live in the metadata arena and go with it.
+ */
+static void psd_free_layer_pixels(psd_document_t *doc) {
+    if (!doc->layers.layers) {
+        return;
+    }
+    for (int32_t i = 0; i < doc->layers.layer_count; i++) {
+        psd_layer_record_t *layer = &doc->layers.layers[i];
+        for (size_t j = 0; layer->channels && j < layer->channel_count; j++) {
+            psd_layer_channel_data_t *channel = &layer->channels[j];
+
+            /* Free compressed data unless it is borrowed from a mapping */
+            if (channel->compressed_data && !channel->compressed_borrowed) {
+                psd_alloc_free(doc->allocator, channel->compressed_data);
+            }
+
+            /* Free decoded data if it was allocated separately */
+            if (channel->decoded_data &&
+                channel->decoded_data != channel->compressed_data) {
+                psd_alloc_free(doc->allocator, channel->decoded_data);
+            }
+        }
+    }
+    doc->layers.layers = NULL;
+    doc->layers.layer_count = 0;
+}
+
+/**
+ * @brief Whether a composite parse failure should fail the whole document
+ *
+ * The composite is optional: a truncated section, an unusable stream, or an
+ * unsupported compression just leave the document without one.
+ */
+static bool psd_composite_error_is_fatal(psd_status_t status) {
+    return status != PSD_ERR_STREAM_EOF && status != PSD_ERR_STREAM_INVALID &&
+           status != PSD_ERR_UNSUPPORTED_COMPRESSION;
+}
+
+/**
+ * @brief Skip the Image Resources section, remembering where it starts
+ *
+ * Used with PSD_PARSE_SKIP_RESOURCES; psd_document_load_resources() parses the
+ * section later from the recorded offset.
+ */
+static psd_status_t psd_skip_resources(psd_stream_t *stream,
+                                       psd_document_t *doc) {
+    int64_t start = psd_stream_tell(stream);
+    if (start < 0) {
+        return (psd_status_t)start;
+    }
+
+    uint32_t section_length = 0;
+    psd_status_t status = psd_stream_read_be32(stream, &section_length);
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    if (psd_stream_seek(stream, start + 4 + (int64_t)section_length) < 0) {
+        return PSD_ERR_STREAM_EOF;
+    }
+
+    doc->resources_offset = start;
+    return PSD_OK;
+}
+
+/**
+ * @brief Tie a parsed document to what it still needs from the stream
+ */
+static psd_document_t *psd_parse_finish(psd_stream_t *stream, psd_document_t *doc) {
+    /* Borrowed payloads point into the stream's file mapping (if any); keep
+     * it alive for the lifetime of the document. */
+    doc->mapping = psd_stream_mapping_retain(psd_stream_get_mapping(stream));
+    doc->mapping_origin = psd_stream_mapping_origin(stream);
+
+    /* Skipped sections are loaded on demand from the caller's stream */
+    if (doc->parse_flags & (PSD_PARSE_SKIP_LAYER_PIXELS | PSD_PARSE_SKIP_COMPOSITE |
+                            PSD_PARSE_SKIP_RESOURCES)) {
+        doc->stream = stream;
+    }
+
+    return doc;
+}
+
 /**
  * @brief Parse a PSD file
  */
 PSD_API psd_document_t *psd_parse_ex(psd_stream_t *stream,
                                      const psd_allocator_t *allocator,
                                      psd_status_t *out_status) {
-    if (out_status) {
-        *out_status = PSD_OK;
-    }
-    if (!stream) {
-        if (out_status) {
-            *out_status = PSD_ERR_NULL_POINTER;
-        }
-        return NULL;
-    }
+    return psd_parse_with_options(stream, allocator, NULL, out_status);
+}
 
-    /* Allocate document structure */
+/**
+ * @brief Allocate an empty document, ready for the section parsers
+ */
+psd_document_t *psd_document_new(const psd_allocator_t *allocator, uint32_t flags,
+                                 psd_stats_state_t *stats) {
     psd_document_t *doc =
         (psd_document_t *)psd_alloc_malloc(allocator, sizeof(*doc));
     if (!doc) {
-        if (out_status) {
-            *out_status = PSD_ERR_OUT_OF_MEMORY;
-        }
         return NULL;
     }
 
@@ -1499,14 +1680,69 @@ PSD_API psd_document_t *psd_parse_ex(psd_stream_t *stream,
     doc->layers.layers = NULL;
     doc->layers.layer_count = 0;
     doc->layers.has_transparency_layer = false;
+    memset(&doc->layout, 0, sizeof(doc->layout));
+    doc->layer_names.slots = NULL;
+    doc->layer_names.mask = 0;
     doc->composite.data = NULL;
     doc->composite.data_length = 0;
     doc->composite.compression = PSD_COMPRESSION_RAW;
+    doc->composite.compressed_data = NULL;
+    doc->composite.compressed_length = 0;
+    doc->composite.compressed_borrowed = false;
+    doc->composite.file_offset = 0;
+    doc->composite.rle_count_bytes = 0;
+    doc->composite.decode_attempted = false;
     doc->text_layers.items = NULL;
     doc->text_layers.count = 0;
+    doc->text_layers.capacity = 0;
+    doc->text_layers.by_layer = NULL;
+    doc->text_layers.by_layer_count = 0;
+    doc->mapping = NULL;
+    doc->mapping_origin = 0;
+    doc->embedded_files = NULL;
+    doc->embedded_file_count = 0;
+    doc->owned_stream = NULL;
+    doc->parse_flags = flags;
+    doc->stream = NULL;
+    doc->resources_offset = -1;
+    doc->composite_offset = -1;
+    psd_once_reset(&doc->load_lock);
+    psd_once_reset(&doc->resources_loaded);
+    psd_once_reset(&doc->composite_loaded);
+    psd_once_reset(&doc->composite_decoded);
+    doc->render_flags = 0;
+    psd_once_reset(&doc->palette_once);
+    psd_zip_pool_init(&doc->zip_pool, allocator);
+    doc->zip = &doc->zip_pool;
+    doc->serial_rows = false;
+    psd_arena_init(&doc->meta, allocator);
+    psd_decode_cache_init(&doc->decode_cache);
+    doc->stats = stats;
+    return doc;
+}
+
+/**
+ * @brief Parse the sections of a PSD file, optionally guided by a saved layout index
+ */
+static psd_document_t *psd_parse_sections(psd_stream_t *stream,
+                                          const psd_allocator_t *allocator,
+                                          uint32_t flags,
+                                          const psd_layout_index_t *index,
+                                          psd_stats_state_t *stats,
+                                          psd_status_t *out_status) {
+    /* Allocate document structure */
+    psd_document_t *doc = psd_document_new(allocator, flags, stats);
+    if (!doc) {
+        if (out_status) {
+            *out_status = PSD_ERR_OUT_OF_MEMORY;
+        }
+        return NULL;
+    }
 
     /* Parse header */
+    uint64_t phase_start = psd_stats_phase_begin(stats, PSD_PHASE_HEADER);
     psd_status_t status = psd_parse_header(stream, doc);
+    psd_stats_phase_end(stats, PSD_PHASE_HEADER, phase_start);
     if (status != PSD_OK) {
         psd_alloc_free(allocator, doc);
         if (out_status) {
@@ -1516,7 +1752,9 @@ PSD_API psd_document_t *psd_parse_ex(psd_stream_t *stream,
     }
 
     /* Parse color mode data section */
+    phase_start = psd_stats_phase_begin(stats, PSD_PHASE_COLOR_MODE_DATA);
     status = psd_parse_color_mode_data(stream, doc);
+    psd_stats_phase_end(stats, PSD_PHASE_COLOR_MODE_DATA, phase_start);
     if (status != PSD_OK) {
         psd_alloc_free(allocator, doc);
         if (out_status) {
@@ -1526,12 +1764,19 @@ PSD_API psd_document_t *psd_parse_ex(psd_stream_t *stream,
     }
 
     /* Parse image resources section */
-    status = psd_parse_resources(stream, doc);
+    phase_start = psd_stats_phase_begin(stats, PSD_PHASE_RESOURCES);
+    if (doc->parse_flags & PSD_PARSE_SKIP_RESOURCES) {
+        status = psd_skip_resources(stream, doc);
+    } else {
+        status = psd_parse_resources(stream, doc);
+    }
+    psd_stats_phase_end(stats, PSD_PHASE_RESOURCES, phase_start);
     if (status != PSD_OK) {
         /* Free color data on error */
         if (doc->color_data.data) {
             psd_alloc_free(allocator, doc->color_data.data);
         }
+        psd_arena_destroy(&doc->meta);
         psd_alloc_free(allocator, doc);
         if (out_status) {
             *out_status = status;
@@ -1539,24 +1784,21 @@ PSD_API psd_document_t *psd_parse_ex(psd_stream_t *stream,
         return NULL;
     }
 
+    /* Thumbnail and metadata scans need nothing past the resources */
+    if (doc->parse_flags & PSD_PARSE_STOP_AFTER_RESOURCES) {
+        return psd_parse_finish(stream, doc);
+    }
+
     /* Parse layer and mask information section */
-    status = psd_parse_layer_info(stream, doc);
+    phase_start = psd_stats_phase_begin(stats, PSD_PHASE_LAYER_INFO);
+    status = psd_parse_layer_info(stream, doc, index);
+    psd_stats_phase_end(stats, PSD_PHASE_LAYER_INFO, phase_start);
     if (status != PSD_OK) {
         /* Free all previously allocated data on error */
         if (doc->color_data.data) {
             psd_alloc_free(allocator, doc->color_data.data);
         }
-        if (doc->resources.blocks) {
-            for (size_t i = 0; i < doc->resources.count; i++) {
-                if (doc->resources.blocks[i].name) {
-                    psd_alloc_free(allocator, doc->resources.blocks[i].name);
-                }
-                if (doc->resources.blocks[i].data) {
-                    psd_alloc_free(allocator, doc->resources.blocks[i].data);
-                }
-            }
-            psd_alloc_free(allocator, doc->resources.blocks);
-        }
+        psd_arena_destroy(&doc->meta);
         psd_alloc_free(allocator, doc);
         if (out_status) {
             *out_status = status;
@@ -1564,37 +1806,38 @@ PSD_API psd_document_t *psd_parse_ex(psd_stream_t *stream,
         return NULL;
     }
 
+    /* Name lookups; without the index they scan the records */
+    (void)psd_layer_names_build(doc);
+
     /* Parse text layers from additional layer info blocks */
+    phase_start = psd_stats_phase_begin(stats, PSD_PHASE_TEXT_LAYERS);
     psd_status_t text_status = psd_parse_text_layers(doc);
+    psd_stats_phase_end(stats, PSD_PHASE_TEXT_LAYERS, phase_start);
     if (text_status != PSD_OK) {
         /* Log text parsing failure but continue parsing */
         /* Text parsing failure should not prevent PSD loading */
     }
 
     /* Parse composite image data section */
-    status = psd_parse_composite_image(stream, doc);
+    phase_start = psd_stats_phase_begin(stats, PSD_PHASE_COMPOSITE_READ);
+    if (doc->parse_flags & PSD_PARSE_SKIP_COMPOSITE) {
+        int64_t composite_pos = psd_stream_tell(stream);
+        doc->composite_offset = composite_pos;
+        status = (composite_pos < 0) ? PSD_ERR_STREAM_INVALID : PSD_OK;
+    } else {
+        status = psd_parse_composite_image(stream, doc);
+    }
+    psd_stats_phase_end(stats, PSD_PHASE_COMPOSITE_READ, phase_start);
     if (status != PSD_OK) {
         /* If we hit EOF, stream error, or unsupported compression, composite
          * data is optional - don't fail */
-        if (status != PSD_ERR_STREAM_EOF && status != PSD_ERR_STREAM_INVALID &&
-            status != PSD_ERR_UNSUPPORTED_COMPRESSION) {
+        if (psd_composite_error_is_fatal(status)) {
             /* Real error - free and return */
             if (doc->color_data.data) {
                 psd_alloc_free(allocator, doc->color_data.data);
             }
-            if (doc->resources.blocks) {
-                for (size_t i = 0; i < doc->resources.count; i++) {
-                    if (doc->resources.blocks[i].name) {
-                        psd_alloc_free(allocator,
-                                       doc->resources.blocks[i].name);
-                    }
-                    if (doc->resources.blocks[i].data) {
-                        psd_alloc_free(allocator,
-                                       doc->resources.blocks[i].data);
-                    }
-                }
-                psd_alloc_free(allocator, doc->resources.blocks);
-            }
+            psd_free_layer_pixels(doc);
+            psd_arena_destroy(&doc->meta);
             psd_alloc_free(allocator, doc);
             if (out_status) {
                 *out_status = status;
@@ -1604,110 +1847,751 @@ PSD_API psd_document_t *psd_parse_ex(psd_stream_t *stream,
         /* Otherwise, composite data is missing/optional - continue */
     }
 
-    return doc;
+    return psd_parse_finish(stream, doc);
 }
 
-PSD_API psd_document_t *psd_parse(psd_stream_t *stream,
-                                  const psd_allocator_t *allocator) {
-    return psd_parse_ex(stream, allocator, NULL);
+/**
+ * @brief Trace hooks of parse options
+ *
+ * The trace field came after flags; callers that predate it may leave it
+ * uninitialized, so it is only looked at when they asked for stats.
+ */
+static const psd_trace_hooks_t *psd_parse_trace_hooks(const psd_parse_options_t *options) {
+    if (!options || !(options->flags & PSD_PARSE_COLLECT_STATS)) {
+        return NULL;
+    }
+    return options->trace;
 }
 
 /**
- * @brief Free a document
+ * @brief Parse a PSD file, optionally guided by a saved layout index
+ *
+ * With stats requested the document allocates through a counting allocator
+ * and the stream counts its callbacks until the document stops reading it.
  */
-PSD_API psd_status_t psd_document_free(psd_document_t *doc) {
-    if (!doc) {
-        return PSD_OK;
+static psd_document_t *psd_parse_document(psd_stream_t *stream,
+                                          const psd_allocator_t *allocator,
+                                          uint32_t flags,
+                                          const psd_trace_hooks_t *trace,
+                                          const psd_layout_index_t *index,
+                                          psd_status_t *out_status) {
+    if (out_status) {
+        *out_status = PSD_OK;
     }
-
-    const psd_allocator_t *allocator = doc->allocator;
-
-    /* Free color mode data if present */
-    if (doc->color_data.data) {
-        psd_alloc_free(allocator, doc->color_data.data);
-        doc->color_data.data = NULL;
-        doc->color_data.length = 0;
+    if (!stream) {
+        if (out_status) {
+            *out_status = PSD_ERR_NULL_POINTER;
+        }
+        return NULL;
     }
 
-    /* Free resource blocks */
-    if (doc->resources.blocks) {
-        for (size_t i = 0; i < doc->resources.count; i++) {
-            if (doc->resources.blocks[i].name) {
-                psd_alloc_free(allocator, doc->resources.blocks[i].name);
-            }
-            if (doc->resources.blocks[i].data) {
-                psd_alloc_free(allocator, doc->resources.blocks[i].data);
+    psd_stats_state_t *stats = NULL;
+    if (flags & PSD_PARSE_COLLECT_STATS) {
+        stats = psd_stats_create(allocator, trace);
+        if (!stats) {
+            if (out_status) {
+                *out_status = PSD_ERR_OUT_OF_MEMORY;
             }
+            return NULL;
         }
-        psd_alloc_free(allocator, doc->resources.blocks);
-        doc->resources.blocks = NULL;
-        doc->resources.count = 0;
+        allocator = &stats->allocator;
     }
 
-    /* Free layer information */
-    if (doc->layers.layers) {
-        for (int32_t i = 0; i < doc->layers.layer_count; i++) {
-            /* Free channel data (both compressed and decoded) */
-            if (doc->layers.layers[i].channels) {
-                for (size_t j = 0; j < doc->layers.layers[i].channel_count;
-                     j++) {
-                    psd_layer_channel_data_t *channel =
-                        &doc->layers.layers[i].channels[j];
-
-                    /* Free compressed data if separate from decoded */
-                    if (channel->compressed_data) {
-                        psd_alloc_free(allocator, channel->compressed_data);
-                    }
+    psd_stats_state_t *previous = psd_stream_set_stats(stream, stats);
+    psd_document_t *doc = psd_parse_sections(stream, allocator, flags, index, stats, out_status);
+    if (!doc || !doc->stream) {
+        /* Nothing is left to load; stop counting the caller's stream */
+        psd_stream_set_stats(stream, previous);
+    }
+    if (!doc) {
+        psd_stats_destroy(stats);
+    }
+    return doc;
+}
 
-                    /* Free decoded data if it was allocated separately */
-                    if (channel->decoded_data &&
-                        channel->decoded_data != channel->compressed_data) {
-                        psd_alloc_free(allocator, channel->decoded_data);
-                    }
-                }
-                psd_alloc_free(allocator, doc->layers.layers[i].channels);
-            }
+/**
+ * @brief Parse a PSD file with options
+ */
+PSD_API psd_document_t *psd_parse_with_options(psd_stream_t *stream,
+                                               const psd_allocator_t *allocator,
+                                               const psd_parse_options_t *options,
+                                               psd_status_t *out_status) {
+    return psd_parse_document(stream, allocator, options ? options->flags : 0u,
+                              psd_parse_trace_hooks(options), NULL, out_status);
+}
+
+/**
+ * @brief Parse a PSD file using a layout saved by psd_document_save_index()
+ */
+PSD_API psd_document_t *psd_parse_with_index(psd_stream_t *stream,
+                                             const psd_allocator_t *allocator,
+                                             const psd_parse_options_t *options,
+                                             const uint8_t *index_data,
+                                             size_t index_size,
+                                             uint64_t source_tag,
+                                             psd_status_t *out_status) {
+    if (!stream || !index_data) {
+        if (out_status) {
+            *out_status = PSD_ERR_NULL_POINTER;
+        }
+        return NULL;
+    }
+
+    psd_layout_index_t index;
+    psd_status_t status = psd_layout_index_decode(index_data, index_size, &index);
+
+    /* A stale index is refused rather than trusted: the caller's tag and the
+     * bytes every offset depends on must match what was saved */
+    uint64_t records_hash = 0;
+    if (status == PSD_OK && index.source_tag != source_tag) {
+        status = PSD_ERR_INVALID_ARGUMENT;
+    }
+    if (status == PSD_OK) {
+        status = psd_layout_index_hash(stream, &index.layout, &records_hash);
+        if (status == PSD_ERR_STREAM_EOF ||
+            (status == PSD_OK && records_hash != index.records_hash)) {
+            status = PSD_ERR_INVALID_ARGUMENT;
+        }
+    }
+    if (status != PSD_OK) {
+        if (out_status) {
+            *out_status = status;
+        }
+        return NULL;
+    }
+
+    /* Channel payloads are only located, never read, on this path */
+    uint32_t flags = (options ? options->flags : 0u) | PSD_PARSE_SKIP_LAYER_PIXELS;
+    return psd_parse_document(stream, allocator, flags, psd_parse_trace_hooks(options), &index,
+                              out_status);
+}
+
+PSD_API psd_document_t *psd_parse(psd_stream_t *stream,
+                                  const psd_allocator_t *allocator) {
+    return psd_parse_ex(stream, allocator, NULL);
+}
+
+/* Read one deferred payload; called with load_lock held */
+static psd_status_t psd_document_read_channel(psd_document_t *doc,
+                                              psd_layer_channel_data_t *channel) {
+    /* Already resident, empty, or nothing was deferred */
+    if (channel->compressed_data || channel->compressed_length == 0 ||
+        !doc->stream) {
+        return PSD_OK;
+    }
+
+    size_t size = 0;
+    if (psd_u64_to_size(channel->compressed_length, &size) != 0) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    uint8_t *data = (uint8_t *)psd_alloc_malloc(doc->allocator, size);
+    if (!data) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+
+    /* Positional, so loads don't disturb the stream (or need a seek) */
+    uint64_t phase_start = psd_stats_phase_begin(doc->stats, PSD_PHASE_CHANNEL_READ);
+    int64_t read_bytes = psd_stream_read_at(doc->stream, channel->file_offset, data, size);
+    psd_stats_phase_end(doc->stats, PSD_PHASE_CHANNEL_READ, phase_start);
+    if (read_bytes != (int64_t)size) {
+        psd_alloc_free(doc->allocator, data);
+        return (read_bytes < 0) ? (psd_status_t)read_bytes : PSD_ERR_STREAM_EOF;
+    }
+
+    channel->compressed_data = data;
+    channel->compressed_borrowed = false;
+    return PSD_OK;
+}
+
+/**
+ * @brief Load a layer channel payload skipped during parsing
+ */
+psd_status_t psd_document_load_channel(psd_document_t *doc,
+                                       psd_layer_channel_data_t *channel) {
+    if (!doc || !channel) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (psd_once_done(&channel->loaded)) {
+        return PSD_OK;
+    }
+
+    /* Every deferred load shares the source stream */
+    psd_lock_acquire(&doc->load_lock);
+    psd_status_t status = PSD_OK;
+    if (!psd_once_done(&channel->loaded)) {
+        status = psd_document_read_channel(doc, channel);
+        if (status == PSD_OK) {
+            psd_once_publish(&channel->loaded);
+        }
+    }
+    psd_once_reset(&doc->load_lock);
+    return status;
+}
+
+static int psd_range_compare(const void *a, const void *b) {
+    uint64_t oa = ((const psd_stream_range_t *)a)->offset;
+    uint64_t ob = ((const psd_stream_range_t *)b)->offset;
+    return (oa > ob) - (oa < ob);
+}
 
-            if (doc->layers.layers[i].name) {
-                psd_alloc_free(allocator, doc->layers.layers[i].name);
+/* Body of psd_document_prefetch_layers(); called with load_lock held */
+static psd_status_t psd_document_prefetch_ranges(psd_document_t *doc,
+                                                 const int32_t *layer_indices,
+                                                 size_t count) {
+    size_t range_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        const psd_layer_record_t *layer =
+            &doc->layers.layers[layer_indices ? layer_indices[i] : (int32_t)i];
+        for (size_t c = 0; c < layer->channel_count; c++) {
+            const psd_layer_channel_data_t *channel = &layer->channels[c];
+            if (!channel->compressed_data && channel->compressed_length > 0) {
+                range_count++;
             }
-            if (doc->layers.layers[i].additional_data) {
-                psd_alloc_free(allocator,
-                               doc->layers.layers[i].additional_data);
+        }
+    }
+    if (range_count == 0) {
+        return PSD_OK;
+    }
+
+    psd_stream_range_t *ranges = (psd_stream_range_t *)psd_alloc_malloc(
+        doc->allocator, range_count * sizeof(*ranges));
+    if (!ranges) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    range_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        const psd_layer_record_t *layer =
+            &doc->layers.layers[layer_indices ? layer_indices[i] : (int32_t)i];
+        for (size_t c = 0; c < layer->channel_count; c++) {
+            const psd_layer_channel_data_t *channel = &layer->channels[c];
+            if (!channel->compressed_data && channel->compressed_length > 0) {
+                ranges[range_count].offset = channel->file_offset;
+                ranges[range_count].length = channel->compressed_length;
+                range_count++;
             }
-            /* Free descriptor if present */
-            if (doc->layers.layers[i].descriptor) {
-                psd_descriptor_free(doc->layers.layers[i].descriptor,
-                                    allocator);
+        }
+    }
+
+    /* Payloads of neighbouring channels are only split by the 2-byte
+     * compression field; close gaps that small so runs of layers become one
+     * range */
+    qsort(ranges, range_count, sizeof(*ranges), psd_range_compare);
+    size_t merged = 0;
+    for (size_t i = 1; i < range_count; i++) {
+        psd_stream_range_t *last = &ranges[merged];
+        uint64_t last_end = last->offset + last->length;
+        if (ranges[i].offset <= last_end + 2u) {
+            uint64_t end = ranges[i].offset + ranges[i].length;
+            if (end > last_end) {
+                last->length = end - last->offset;
             }
+        } else {
+            ranges[++merged] = ranges[i];
         }
-        psd_alloc_free(allocator, doc->layers.layers);
-        doc->layers.layers = NULL;
-        doc->layers.layer_count = 0;
     }
 
-    /* Free composite image data */
-    if (doc->composite.data) {
+    psd_status_t status = psd_stream_prefetch(doc->stream, ranges, merged + 1);
+    psd_alloc_free(doc->allocator, ranges);
+    return status;
+}
+
+/**
+ * @brief Announce the payloads of some layers that still have to be read
+ */
+PSD_API psd_status_t psd_document_prefetch_layers(psd_document_t *doc,
+                                                  const int32_t *layer_indices,
+                                                  size_t count) {
+    if (!doc || (!layer_indices && count > 0)) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (!layer_indices) {
+        count = (size_t)doc->layers.layer_count;
+    }
+    for (size_t i = 0; layer_indices && i < count; i++) {
+        if (layer_indices[i] < 0 || layer_indices[i] >= doc->layers.layer_count) {
+            return PSD_ERR_OUT_OF_RANGE;
+        }
+    }
+    if (!psd_stream_has_prefetch(doc->stream)) {
+        return PSD_OK;
+    }
+
+    /* Channels are checked and the stream told under the load lock */
+    psd_lock_acquire(&doc->load_lock);
+    psd_status_t status = psd_document_prefetch_ranges(doc, layer_indices, count);
+    psd_once_reset(&doc->load_lock);
+    return status;
+}
+
+/* Parse deferred resources; called with load_lock held */
+static psd_status_t psd_document_read_resources(psd_document_t *doc) {
+    if (doc->resources_offset < 0) {
+        return PSD_OK;
+    }
+    if (!doc->stream) {
+        return PSD_ERR_STREAM_INVALID;
+    }
+
+    if (psd_stream_seek(doc->stream, doc->resources_offset) < 0) {
+        return PSD_ERR_STREAM_SEEK;
+    }
+
+    uint64_t phase_start = psd_stats_phase_begin(doc->stats, PSD_PHASE_RESOURCES);
+    psd_status_t status = psd_parse_resources(doc->stream, doc);
+    psd_stats_phase_end(doc->stats, PSD_PHASE_RESOURCES, phase_start);
+    if (status == PSD_OK) {
+        doc->resources_offset = -1;
+    }
+    return status;
+}
+
+/**
+ * @brief Parse an Image Resources section skipped during parsing
+ */
+psd_status_t psd_document_load_resources(psd_document_t *doc) {
+    if (!doc) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (psd_once_done(&doc->resources_loaded)) {
+        return PSD_OK;
+    }
+
+    psd_lock_acquire(&doc->load_lock);
+    psd_status_t status = PSD_OK;
+    if (!psd_once_done(&doc->resources_loaded)) {
+        status = psd_document_read_resources(doc);
+        if (status == PSD_OK) {
+            psd_once_publish(&doc->resources_loaded);
+        }
+    }
+    psd_once_reset(&doc->load_lock);
+    return status;
+}
+
+/* Read the deferred composite section; called with load_lock held */
+static psd_status_t psd_document_read_composite(psd_document_t *doc) {
+    if (doc->composite_offset < 0) {
+        return PSD_OK;
+    }
+    if (!doc->stream) {
+        return PSD_ERR_STREAM_INVALID;
+    }
+
+    if (psd_stream_seek(doc->stream, doc->composite_offset) < 0) {
+        return PSD_ERR_STREAM_SEEK;
+    }
+
+    /* Only attempted once; a missing composite is not an error */
+    doc->composite_offset = -1;
+    uint64_t phase_start = psd_stats_phase_begin(doc->stats, PSD_PHASE_COMPOSITE_READ);
+    psd_status_t status = psd_parse_composite_image(doc->stream, doc);
+    psd_stats_phase_end(doc->stats, PSD_PHASE_COMPOSITE_READ, phase_start);
+    return psd_composite_error_is_fatal(status) ? status : PSD_OK;
+}
+
+/**
+ * @brief Read a composite image data section skipped during parsing
+ */
+psd_status_t psd_document_load_composite(psd_document_t *doc) {
+    if (!doc) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (psd_once_done(&doc->composite_loaded)) {
+        return PSD_OK;
+    }
+
+    psd_lock_acquire(&doc->load_lock);
+    psd_status_t status = PSD_OK;
+    if (!psd_once_done(&doc->composite_loaded)) {
+        status = psd_document_read_composite(doc);
+        if (status == PSD_OK) {
+            psd_once_publish(&doc->composite_loaded);
+        }
+    }
+    psd_once_reset(&doc->load_lock);
+    return status;
+}
+
+/**
+ * @brief Free a document
+ */
+PSD_API psd_status_t psd_document_free(psd_document_t *doc) {
+    if (!doc) {
+        return PSD_OK;
+    }
+
+    const psd_allocator_t *allocator = doc->allocator;
+
+    /* Free color mode data if present */
+    if (doc->color_data.data) {
+        psd_alloc_free(allocator, doc->color_data.data);
+        doc->color_data.data = NULL;
+        doc->color_data.length = 0;
+    }
+
+    /* Resource blocks live in the metadata arena */
+    doc->resources.blocks = NULL;
+    doc->resources.count = 0;
+
+    /* Free layer pixel data; records, names, channel arrays and descriptors
+     * live in the metadata arena */
+    psd_free_layer_pixels(doc);
+    doc->layer_names.slots = NULL;
+    doc->layer_names.mask = 0;
+
+    /* Free composite image data (RAW decodes in place, so data may alias
+     * the payload) */
+    if (doc->composite.data &&
+        doc->composite.data != doc->composite.compressed_data) {
         psd_alloc_free(allocator, doc->composite.data);
-        doc->composite.data = NULL;
-        doc->composite.data_length = 0;
     }
+    if (doc->composite.compressed_data && !doc->composite.compressed_borrowed) {
+        psd_alloc_free(allocator, doc->composite.compressed_data);
+    }
+    doc->composite.data = NULL;
+    doc->composite.data_length = 0;
+    doc->composite.compressed_data = NULL;
+    doc->composite.compressed_length = 0;
+
+    /* Text layer items and their descriptors live in the metadata arena */
+    doc->text_layers.items = NULL;
+    doc->text_layers.count = 0;
+    doc->text_layers.capacity = 0;
+    doc->text_layers.by_layer = NULL;
+    doc->text_layers.by_layer_count = 0;
+
+    psd_zip_pool_destroy(&doc->zip_pool);
+    psd_arena_destroy(&doc->meta);
 
-    /* Free text layers derived database */
-    psd_free_text_layers(doc);
+    /* Drop the file mapping only after every borrowed payload is gone */
+    psd_stream_mapping_release(doc->mapping);
+    doc->mapping = NULL;
+
+    /* The counters outlive every allocation made through them */
+    psd_stats_state_t *stats = doc->stats;
+    if (stats && psd_stream_get_stats(doc->stream) == stats) {
+        psd_stream_set_stats(doc->stream, NULL);
+    }
+    psd_stream_destroy(doc->owned_stream);
 
     /* Free document structure */
     psd_alloc_free(allocator, doc);
+    psd_stats_destroy(stats);
+
+    return PSD_OK;
+}
+
+/* Initial read size for section payloads whose length is not known up front */
+#define PSD_COMPOSITE_READ_CHUNK ((size_t)64 * 1024)
+
+/**
+ * @brief Compute the planar composite geometry from the header
+ *
+ * For depth 8/16/32:
+ *   plane bytes = width * height * (depth/8)
+ * For depth 1 (bitmap):
+ *   each scanline is packed bits -> row bytes = (width + 7) / 8
+ *   plane bytes = row_bytes * height
+ */
+void psd_composite_geometry(const psd_document_t *doc,
+                            uint64_t *bytes_per_sample,
+                            uint64_t *bytes_per_scanline,
+                            uint64_t *uncompressed_size) {
+    uint64_t sample = (doc->depth == 1) ? 1u : (uint64_t)(doc->depth / 8u);
+    uint64_t scanline = (doc->depth == 1) ? (((uint64_t)doc->width + 7u) / 8u)
+                                          : ((uint64_t)doc->width * sample);
+    *bytes_per_sample = sample;
+    *bytes_per_scanline = scanline;
+    *uncompressed_size = (uint64_t)doc->channels * (uint64_t)doc->height * scanline;
+}
+
+/**
+ * @brief Keep up to max_length bytes of the composite payload
+ *
+ * Borrows from the file mapping when there is one. Otherwise the payload is
+ * read in growing chunks, so a truncated file never costs a full-size
+ * allocation.
+ *
+ * @param exact Require exactly max_length bytes (RAW); otherwise take what is
+ *              left, which must be at least one byte (ZIP runs to end of file)
+ */
+static psd_status_t psd_read_composite_payload(psd_stream_t *stream,
+                                               psd_document_t *doc,
+                                               uint64_t max_length,
+                                               bool exact) {
+    const psd_allocator_t *alloc = doc->allocator;
+    size_t limit = 0;
+    if (psd_u64_to_size(max_length, &limit) != 0) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    uint64_t borrowed_length = 0;
+    const uint8_t *borrowed =
+        psd_stream_borrow_available(stream, max_length, &borrowed_length);
+    if (borrowed) {
+        if ((exact && borrowed_length != max_length) || borrowed_length == 0) {
+            return PSD_ERR_STREAM_EOF;
+        }
+        doc->composite.compressed_data = (uint8_t *)borrowed;
+        doc->composite.compressed_length = borrowed_length;
+        doc->composite.compressed_borrowed = true;
+        return PSD_OK;
+    }
 
+    uint8_t *buffer = NULL;
+    size_t capacity = 0;
+    size_t used = 0;
+    while (used < limit) {
+        if (used == capacity) {
+            size_t grow = (capacity < PSD_COMPOSITE_READ_CHUNK) ? PSD_COMPOSITE_READ_CHUNK
+                                                                : capacity;
+            size_t new_capacity = (limit - capacity < grow) ? limit : capacity + grow;
+            uint8_t *grown = (uint8_t *)psd_alloc_realloc(alloc, buffer, new_capacity);
+            if (!grown) {
+                psd_alloc_free(alloc, buffer);
+                return PSD_ERR_OUT_OF_MEMORY;
+            }
+            buffer = grown;
+            capacity = new_capacity;
+        }
+
+        int64_t n = psd_stream_read(stream, buffer + used, capacity - used);
+        if (n < 0) {
+            psd_alloc_free(alloc, buffer);
+            return (psd_status_t)n;
+        }
+        if (n == 0) {
+            break;
+        }
+        used += (size_t)n;
+    }
+
+    if ((exact && used != limit) || (!exact && used == 0)) {
+        psd_alloc_free(alloc, buffer);
+        return PSD_ERR_STREAM_EOF;
+    }
+
+    doc->composite.compressed_data = buffer;
+    doc->composite.compressed_length = (uint64_t)used;
+    doc->composite.compressed_borrowed = false;
+    return PSD_OK;
+}
+
+/**
+ * @brief Check an RLE byte counts table of the given width
+ *
+ * A table read with the wrong width (2-byte counts in a PSB or vice versa)
+ * yields zero-length or impossibly long rows, so each count is checked
+ * against the worst case PackBits size of a scanline.
+ *
+ * @return true if the table fits in the available bytes and every count is
+ *         plausible; *out_size receives the size of table plus rows
+ */
+static bool psd_composite_rle_table_fits(const uint8_t *data,
+                                         uint64_t available,
+                                         uint32_t num_scanlines,
+                                         uint64_t bytes_per_scanline,
+                                         uint32_t count_bytes,
+                                         uint64_t *out_size) {
+    uint64_t table_size = (uint64_t)num_scanlines * count_bytes;
+    uint64_t max_row = bytes_per_scanline * 2u + 2u;
+    if (table_size > available) {
+        return false;
+    }
+
+    uint64_t total = table_size;
+    for (uint32_t i = 0; i < num_scanlines; i++) {
+        const uint8_t *p = data + (size_t)i * count_bytes;
+        uint64_t v = (count_bytes == 2)
+                         ? (uint64_t)psd_read_be16(p)
+                         : (uint64_t)psd_read_be32(p);
+        if ((bytes_per_scanline > 0 && v == 0) || v > max_row) {
+            return false;
+        }
+        total += v;
+    }
+    *out_size = total;
+    return true;
+}
+
+/**
+ * @brief Read an RLE composite: byte counts table plus rows, in one pass
+ *
+ * One bulk read covers the table at either count width. Both widths are
+ * checked on those bytes and the one that fits is kept; when both do and the
+ * read hit the end of the file, the width whose rows end exactly there wins,
+ * as for layer channels. Only the remaining row data is read afterwards, so no
+ * byte of the section is read twice.
+ */
+static psd_status_t psd_read_composite_rle(psd_stream_t *stream,
+                                           psd_document_t *doc,
+                                           int64_t counts_pos,
+                                           uint32_t num_scanlines,
+                                           uint64_t bytes_per_scanline) {
+    const psd_allocator_t *alloc = doc->allocator;
+    psd_composite_image_t *composite = &doc->composite;
+
+    size_t probe = 0;
+    if (psd_u64_to_size((uint64_t)num_scanlines * 4u, &probe) != 0) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    /* Leaves compressed_data with up to probe bytes (borrowed when mapped) */
+    psd_status_t status = psd_read_composite_payload(stream, doc, probe, false);
+    if (status == PSD_ERR_STREAM_EOF) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    const uint8_t *head = composite->compressed_data;
+    uint64_t have = composite->compressed_length;
+    bool at_eof = have < (uint64_t)probe;
+
+    /* PSD commonly uses 2-byte counts; PSB commonly uses 4-byte counts. */
+    uint32_t preferred = doc->is_psb ? 4u : 2u;
+    uint32_t other = 6u - preferred;
+    uint64_t size_preferred = 0;
+    uint64_t size_other = 0;
+    bool fits_preferred = psd_composite_rle_table_fits(head, have, num_scanlines,
+                                                       bytes_per_scanline, preferred,
+                                                       &size_preferred);
+    bool fits_other = psd_composite_rle_table_fits(head, have, num_scanlines,
+                                                   bytes_per_scanline, other,
+                                                   &size_other);
+    if (at_eof) {
+        /* Everything there is has been read: rows must end inside it */
+        fits_preferred = fits_preferred && size_preferred <= have;
+        fits_other = fits_other && size_other <= have;
+        if (fits_preferred && fits_other && size_other == have && size_preferred != have) {
+            fits_preferred = false;
+        }
+    }
+
+    uint32_t count_bytes = preferred;
+    uint64_t payload_size = size_preferred;
+    if (!fits_preferred) {
+        if (!fits_other) {
+            if (!composite->compressed_borrowed) {
+                psd_alloc_free(alloc, composite->compressed_data);
+            }
+            composite->compressed_data = NULL;
+            composite->compressed_length = 0;
+            composite->compressed_borrowed = false;
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        count_bytes = other;
+        payload_size = size_other;
+    }
+
+    size_t payload = 0;
+    if (psd_u64_to_size(payload_size, &payload) != 0) {
+        status = PSD_ERR_OUT_OF_RANGE;
+    } else if (composite->compressed_borrowed) {
+        /* Mapped: widen the view to counts + rows, still without copying */
+        const uint8_t *borrowed = NULL;
+        if (psd_stream_seek(stream, counts_pos) < 0) {
+            status = PSD_ERR_STREAM_INVALID;
+        } else if (!(borrowed = psd_stream_borrow(stream, payload_size))) {
+            status = PSD_ERR_CORRUPT_DATA;
+        } else {
+            composite->compressed_data = (uint8_t *)borrowed;
+        }
+    } else {
+        uint8_t *buffer = (uint8_t *)psd_alloc_realloc(alloc, composite->compressed_data,
+                                                       payload);
+        if (!buffer) {
+            status = PSD_ERR_OUT_OF_MEMORY;
+        } else {
+            composite->compressed_data = buffer;
+            if (payload_size > have) {
+                status = psd_stream_read_exact(stream, buffer + (size_t)have,
+                                               payload - (size_t)have);
+                if (status == PSD_ERR_STREAM_EOF) {
+                    status = PSD_ERR_CORRUPT_DATA;
+                }
+            } else if (payload_size < have &&
+                       psd_stream_seek(stream, counts_pos + (int64_t)payload_size) < 0) {
+                /* The probe read past the rows; leave the stream after them */
+                status = PSD_ERR_STREAM_INVALID;
+            }
+        }
+    }
+
+    if (status != PSD_OK) {
+        if (!composite->compressed_borrowed) {
+            psd_alloc_free(alloc, composite->compressed_data);
+        }
+        composite->compressed_data = NULL;
+        composite->compressed_length = 0;
+        composite->compressed_borrowed = false;
+        return status;
+    }
+
+    composite->compressed_length = payload_size;
+    composite->rle_count_bytes = (uint8_t)count_bytes;
+    return PSD_OK;
+}
+
+/**
+ * @brief Inflate a ZIP composite while reading it
+ *
+ * Without a mapping to borrow from, keeping the compressed payload would
+ * mean guessing its size (it runs to the end of the file) and holding it next
+ * to the decoded planes. Instead the data is inflated straight into the planes
+ * through a PSD_ZIP_STREAM_WINDOW input buffer, and the composite is left
+ * decoded. Data that does not inflate leaves the composite absent, as a failed
+ * decode on first access does.
+ */
+static psd_status_t psd_inflate_composite(psd_stream_t *stream,
+                                          psd_document_t *doc,
+                                          uint64_t uncompressed_size,
+                                          uint64_t bytes_per_scanline,
+                                          uint64_t bytes_per_sample) {
+    const psd_allocator_t *alloc = doc->allocator;
+    psd_composite_image_t *composite = &doc->composite;
+
+    size_t size = 0;
+    size_t scanline_w = 0;
+    if (psd_u64_to_size(uncompressed_size, &size) != 0 ||
+        psd_u64_to_size(bytes_per_scanline, &scanline_w) != 0) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    uint8_t *decoded = (uint8_t *)psd_alloc_malloc(alloc, size);
+    if (!decoded) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+
+    psd_status_t status;
+    if (composite->compression == PSD_COMPRESSION_ZIP) {
+        status = psd_zip_inflate_stream(stream, decoded, size, alloc, NULL);
+    } else {
+        /* Composite data is planar, so prediction is applied per-channel scanlines. */
+        status = psd_zip_inflate_stream_with_prediction(
+            stream, decoded, size, scanline_w, (size_t)bytes_per_sample, alloc, NULL);
+    }
+
+    if (status != PSD_OK) {
+        psd_alloc_free(alloc, decoded);
+        composite->decode_attempted = true;
+        return (status == PSD_ERR_CORRUPT_DATA) ? PSD_OK : status;
+    }
+
+    composite->data = decoded;
+    composite->data_length = uncompressed_size;
+    composite->decode_attempted = true;
     return PSD_OK;
 }
 
 /**
  * @brief Parse Composite Image Data section
  *
- * Reads the composite image, which is the final flattened rendering.
- * Supports RAW, RLE, ZIP, and ZIP with prediction compression.
- * For now, ZIP formats return unsupported error.
+ * Keeps the section payload (and, for RLE, the byte counts table) without
+ * decoding it; psd_document_decode_composite() produces the planar image on
+ * first access. Supports RAW, RLE, ZIP, and ZIP with prediction compression.
  *
  * @param stream Stream to read from
  * @param doc Document to populate
@@ -1717,8 +2601,6 @@ static psd_status_t psd_parse_composite_image(psd_stream_t *stream,
                                               psd_document_t *doc) {
     psd_status_t status;
     uint16_t compression;
-    const psd_allocator_t *alloc = doc->allocator;
-    int64_t counts_pos = 0;
 
     /* According to PSD spec, Image Data section format is:
      * 2 bytes: Compression method (0=raw, 1=RLE, 2=ZIP, 3=ZIP+prediction)
@@ -1735,8 +2617,6 @@ static psd_status_t psd_parse_composite_image(psd_stream_t *stream,
     status = psd_stream_read_be16(stream, &compression);
     if (status != PSD_OK) {
         /* End of file or read error - no composite image */
-        doc->composite.data = NULL;
-        doc->composite.data_length = 0;
         doc->composite.compression = PSD_COMPRESSION_RAW;
         return PSD_OK;
     }
@@ -1747,161 +2627,163 @@ static psd_status_t psd_parse_composite_image(psd_stream_t *stream,
 
     doc->composite.compression = (psd_compression_t)compression;
 
-    /* Calculate expected uncompressed size for planar composite data.
-     *
-     * For depth 8/16/32:
-     *   plane bytes = width * height * (depth/8)
-     * For depth 1 (bitmap):
-     *   each scanline is packed bits -> row bytes = (width + 7) / 8
-     *   plane bytes = row_bytes * height
-     */
-    uint64_t bytes_per_sample = (doc->depth == 1) ? 1u : (uint64_t)(doc->depth / 8u);
-    uint64_t bytes_per_scanline =
-        (doc->depth == 1) ? (((uint64_t)doc->width + 7u) / 8u)
-                          : ((uint64_t)doc->width * bytes_per_sample);
-    uint64_t uncompressed_size =
-        (uint64_t)doc->channels * (uint64_t)doc->height * bytes_per_scanline;
-
-    /* Allocate buffer for image data */
-    doc->composite.data = (uint8_t *)psd_alloc_malloc(alloc, uncompressed_size);
-    if (!doc->composite.data) {
-        return PSD_ERR_OUT_OF_MEMORY;
+    uint64_t bytes_per_sample = 0;
+    uint64_t bytes_per_scanline = 0;
+    uint64_t uncompressed_size = 0;
+    psd_composite_geometry(doc, &bytes_per_sample, &bytes_per_scanline,
+                           &uncompressed_size);
+
+    int64_t payload_pos = psd_stream_tell(stream);
+    if (payload_pos < 0) {
+        return PSD_ERR_STREAM_INVALID;
+    }
+    doc->composite.file_offset = (uint64_t)payload_pos;
+
+    switch (compression) {
+    case PSD_COMPRESSION_RAW:
+        return psd_read_composite_payload(stream, doc, uncompressed_size, true);
+
+    case PSD_COMPRESSION_RLE:
+        return psd_read_composite_rle(stream, doc, payload_pos,
+                                      doc->height * doc->channels,
+                                      bytes_per_scanline);
+
+    case PSD_COMPRESSION_ZIP:
+    case PSD_COMPRESSION_ZIP_PRED:
+        if (psd_stream_get_mapping(stream)) {
+            /* The zlib stream runs to the end of the file; borrow it all and
+             * inflate from the mapping on first access */
+            return psd_read_composite_payload(stream, doc, uncompressed_size * 2,
+                                              false);
+        }
+        return psd_inflate_composite(stream, doc, uncompressed_size,
+                                     bytes_per_scanline, bytes_per_sample);
+
+    default:
+        return PSD_ERR_UNSUPPORTED_COMPRESSION;
+    }
+}
+
+/**
+ * @brief Decode the composite payload kept by psd_parse_composite_image()
+ *
+ * Compression this build cannot decode leaves data NULL without failing, as a
+ * missing composite did when it was decoded during parsing.
+ */
+static psd_status_t psd_decode_composite_planes(psd_document_t *doc) {
+    psd_composite_image_t *composite = &doc->composite;
+    const psd_allocator_t *alloc = doc->allocator;
+
+    if (!composite->compressed_data) {
+        composite->decode_attempted = true;
+        return PSD_OK;
+    }
+
+    uint64_t bytes_per_sample = 0;
+    uint64_t bytes_per_scanline = 0;
+    uint64_t uncompressed_size = 0;
+    psd_composite_geometry(doc, &bytes_per_sample, &bytes_per_scanline,
+                           &uncompressed_size);
+
+    size_t size = 0;
+    size_t scanline_w = 0;
+    if (psd_u64_to_size(uncompressed_size, &size) != 0 ||
+        psd_u64_to_size(bytes_per_scanline, &scanline_w) != 0) {
+        return PSD_ERR_OUT_OF_RANGE;
     }
 
-    doc->composite.data_length = uncompressed_size;
+    /* RAW: the payload already is the planar image */
+    if (composite->compression == PSD_COMPRESSION_RAW) {
+        composite->data = composite->compressed_data;
+        composite->data_length = uncompressed_size;
+        composite->decode_attempted = true;
+        return PSD_OK;
+    }
 
-    /* Handle different compression types */
-    switch (compression) {
-    case PSD_COMPRESSION_RAW: {
-        /* RAW: data is uncompressed */
-        int64_t read_bytes =
-            psd_stream_read(stream, doc->composite.data, uncompressed_size);
-        if ((uint64_t)read_bytes != uncompressed_size) {
-            psd_alloc_free(alloc, doc->composite.data);
-            doc->composite.data = NULL;
-            return PSD_ERR_STREAM_EOF;
-        }
-        break;
+    uint8_t *decoded = (uint8_t *)psd_alloc_malloc(alloc, size);
+    if (!decoded) {
+        return PSD_ERR_OUT_OF_MEMORY;
     }
 
+    psd_status_t status = PSD_OK;
+    switch (composite->compression) {
     case PSD_COMPRESSION_RLE: {
-        /* RLE: PackBits compression per scanline */
-        uint32_t num_scanlines = doc->height * doc->channels;
-        counts_pos = psd_stream_tell(stream);
-        if (counts_pos < 0) {
-            psd_alloc_free(alloc, doc->composite.data);
-            doc->composite.data = NULL;
-            return PSD_ERR_STREAM_INVALID;
-        }
-
-        /* PSD commonly uses 2-byte counts; PSB commonly uses 4-byte counts. */
-        psd_status_t st2 = PSD_ERR_CORRUPT_DATA;
-        psd_status_t st4 = PSD_ERR_CORRUPT_DATA;
-        if (doc->is_psb) {
-            st4 = psd_try_decode_composite_rle(
-                stream, counts_pos, num_scanlines, bytes_per_scanline,
-                doc->composite.data, uncompressed_size, alloc, 4);
-            if (st4 != PSD_OK) {
-                st2 = psd_try_decode_composite_rle(
-                    stream, counts_pos, num_scanlines, bytes_per_scanline,
-                    doc->composite.data, uncompressed_size, alloc, 2);
-            }
-            status = (st4 == PSD_OK) ? PSD_OK : st2;
-        } else {
-            st2 = psd_try_decode_composite_rle(
-                stream, counts_pos, num_scanlines, bytes_per_scanline,
-                doc->composite.data, uncompressed_size, alloc, 2);
-            if (st2 != PSD_OK) {
-                st4 = psd_try_decode_composite_rle(
-                    stream, counts_pos, num_scanlines, bytes_per_scanline,
-                    doc->composite.data, uncompressed_size, alloc, 4);
-            }
-            status = (st2 == PSD_OK) ? PSD_OK : st4;
-        }
-
-        if (status != PSD_OK) {
-            psd_alloc_free(alloc, doc->composite.data);
-            doc->composite.data = NULL;
-            return PSD_ERR_CORRUPT_DATA;
+        /* All planes' rows form one run: counts table, then PackBits rows */
+        uint64_t num_scanlines = (uint64_t)doc->height * doc->channels;
+        uint64_t table_size = num_scanlines * composite->rle_count_bytes;
+        psd_rle_rows_t rows;
+        rows.counts = composite->compressed_data;
+        rows.count_bytes = composite->rle_count_bytes;
+        rows.rle = composite->compressed_data + (size_t)table_size;
+        rows.rle_length = composite->compressed_length - table_size;
+        rows.rows = num_scanlines;
+        rows.row_bytes = scanline_w;
+        rows.dst = decoded;
+        rows.dst_stride = scanline_w;
+        rows.decode_row = psd_rle_decode_row;
+
+        status = psd_rle_decode_rows(&rows, !doc->serial_rows, alloc);
+        if (status != PSD_OK && status != PSD_ERR_OUT_OF_MEMORY) {
+            status = PSD_ERR_CORRUPT_DATA;
         }
-
         break;
     }
 
-    case PSD_COMPRESSION_ZIP: {
-        /* ZIP compression - allocate buffer for compressed data */
-        uint8_t *compressed_data =
-            (uint8_t *)psd_alloc_malloc(alloc, uncompressed_size * 2);
-        if (!compressed_data) {
-            psd_alloc_free(alloc, doc->composite.data);
-            doc->composite.data = NULL;
-            return PSD_ERR_OUT_OF_MEMORY;
-        }
-
-        int64_t read_bytes =
-            psd_stream_read(stream, compressed_data, uncompressed_size * 2);
-        if (read_bytes <= 0) {
-            psd_alloc_free(alloc, compressed_data);
-            psd_alloc_free(alloc, doc->composite.data);
-            doc->composite.data = NULL;
-            return PSD_ERR_STREAM_EOF;
-        }
+    case PSD_COMPRESSION_ZIP:
+        status = psd_zip_decompress(composite->compressed_data,
+                                    (size_t)composite->compressed_length,
+                                    decoded, size, alloc, doc->zip);
+        break;
 
-        psd_status_t zip_status =
-            psd_zip_decompress(compressed_data, (size_t)read_bytes,
-                               doc->composite.data, uncompressed_size, alloc);
-        psd_alloc_free(alloc, compressed_data);
+    case PSD_COMPRESSION_ZIP_PRED:
+        /* Composite data is planar, so prediction is applied per-channel scanlines. */
+        status = psd_zip_decompress_with_prediction(
+            composite->compressed_data, (size_t)composite->compressed_length,
+            decoded, size, scanline_w, (size_t)bytes_per_sample, alloc,
+            doc->zip);
+        break;
 
-        if (zip_status != PSD_OK) {
-            psd_alloc_free(alloc, doc->composite.data);
-            doc->composite.data = NULL;
-            return zip_status;
-        }
+    default:
+        status = PSD_ERR_UNSUPPORTED_COMPRESSION;
         break;
     }
 
-    case PSD_COMPRESSION_ZIP_PRED: {
-        uint8_t *compressed_data =
-            (uint8_t *)psd_alloc_malloc(alloc, uncompressed_size * 2);
-        if (!compressed_data) {
-            psd_alloc_free(alloc, doc->composite.data);
-            doc->composite.data = NULL;
-            return PSD_ERR_OUT_OF_MEMORY;
-        }
-
-        int64_t read_bytes =
-            psd_stream_read(stream, compressed_data, uncompressed_size * 2);
-        if (read_bytes <= 0) {
-            psd_alloc_free(alloc, compressed_data);
-            psd_alloc_free(alloc, doc->composite.data);
-            doc->composite.data = NULL;
-            return PSD_ERR_STREAM_EOF;
+    if (status != PSD_OK) {
+        psd_alloc_free(alloc, decoded);
+        if (psd_composite_error_is_fatal(status)) {
+            return status;
         }
+        composite->decode_attempted = true;
+        return PSD_OK;
+    }
 
-        /* Composite data is planar, so prediction is applied per-channel scanlines. */
-        uint64_t bytes_per_pixel = (doc->depth == 1) ? 1u : bytes_per_sample;
-        uint64_t scanline_width = bytes_per_scanline;
-        psd_status_t zip_status = psd_zip_decompress_with_prediction(
-            compressed_data, (size_t)read_bytes, doc->composite.data,
-            uncompressed_size, (size_t)scanline_width, (size_t)bytes_per_pixel, alloc);
-
-        psd_alloc_free(alloc, compressed_data);
+    composite->data = decoded;
+    composite->data_length = uncompressed_size;
+    composite->decode_attempted = true;
+    return PSD_OK;
+}
 
-        if (zip_status != PSD_OK) {
-            psd_alloc_free(alloc, doc->composite.data);
-            doc->composite.data = NULL;
-            return zip_status;
-        }
-        break;
+/**
+ * @brief Decode the composite payload once, timed as PSD_PHASE_COMPOSITE_DECODE
+ */
+psd_status_t psd_document_decode_composite(psd_document_t *doc) {
+    /* Threads arriving while another decodes wait for its planes */
+    if (!psd_once_enter(&doc->composite_decoded)) {
+        return PSD_OK;
     }
 
-    default:
-        psd_alloc_free(alloc, doc->composite.data);
-        doc->composite.data = NULL;
-        return PSD_ERR_UNSUPPORTED_COMPRESSION;
+    psd_status_t status = PSD_OK;
+    if (!doc->composite.decode_attempted) {
+        uint64_t phase_start = psd_stats_phase_begin(doc->stats, PSD_PHASE_COMPOSITE_DECODE);
+        status = psd_decode_composite_planes(doc);
+        psd_stats_phase_end(doc->stats, PSD_PHASE_COMPOSITE_DECODE, phase_start);
     }
-
-    return PSD_OK;
+    if (doc->composite.decode_attempted) {
+        psd_once_publish(&doc->composite_decoded);
+    } else {
+        psd_once_reset(&doc->composite_decoded);
+    }
+    return status;
 }
 
 /**
@@ -2005,6 +2887,12 @@ PSD_API psd_status_t psd_document_get_resource_count(const psd_document_t *doc,
         return PSD_ERR_NULL_POINTER;
     }
 
+    /* A deferred resources section is parsed on first access (logically const) */
+    psd_status_t status = psd_document_load_resources((psd_document_t *)doc);
+    if (status != PSD_OK) {
+        return status;
+    }
+
     *count = doc->resources.count;
     return PSD_OK;
 }
@@ -2020,6 +2908,12 @@ PSD_API psd_status_t psd_document_get_resource(const psd_document_t *doc,
         return PSD_ERR_NULL_POINTER;
     }
 
+    /* A deferred resources section is parsed on first access (logically const) */
+    psd_status_t status = psd_document_load_resources((psd_document_t *)doc);
+    if (status != PSD_OK) {
+        return status;
+    }
+
     if (index >= doc->resources.count) {
         return PSD_ERR_OUT_OF_RANGE;
     }
@@ -2046,6 +2940,12 @@ PSD_API psd_status_t psd_document_find_resource(const psd_document_t *doc,
         return PSD_ERR_NULL_POINTER;
     }
 
+    /* A deferred resources section is parsed on first access (logically const) */
+    psd_status_t status = psd_document_load_resources((psd_document_t *)doc);
+    if (status != PSD_OK) {
+        return status;
+    }
+
     for (size_t i = 0; i < doc->resources.count; i++) {
         if (doc->resources.blocks[i].id == id) {
             *index = i;
@@ -2056,6 +2956,34 @@ PSD_API psd_status_t psd_document_find_resource(const psd_document_t *doc,
     return PSD_ERR_INVALID_ARGUMENT; /* Not found */
 }
 
+static void psd_document_build_palette(const psd_document_t *doc, uint32_t out_palette[256]) {
+    int32_t transparent = -1;
+    size_t index = 0;
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    uint16_t id = 0;
+    if (psd_document_find_resource(doc, PSD_RESOURCE_TRANSPARENCY_INDEX, &index) == PSD_OK &&
+        psd_document_get_resource(doc, index, &id, &data, &length) == PSD_OK &&
+        data && length >= 2) {
+        transparent = (int32_t)psd_read_be16(data);
+    }
+    psd_palette_build(doc->color_data.data, doc->color_data.length, transparent, out_palette);
+}
+
+const uint32_t *psd_document_palette(const psd_document_t *doc, uint32_t scratch[256]) {
+    psd_document_t *mut = (psd_document_t *)doc;
+    if (psd_once_done(&mut->palette_once)) {
+        return doc->palette;
+    }
+    if (!psd_once_claim(&mut->palette_once)) {
+        psd_document_build_palette(doc, scratch); /* another thread is building it */
+        return scratch;
+    }
+    psd_document_build_palette(doc, mut->palette);
+    psd_once_publish(&mut->palette_once);
+    return doc->palette;
+}
+
 /**
  * @brief Get number of layers
  */
@@ -2158,6 +3086,27 @@ psd_document_get_layer_properties(const psd_document_t *doc, int32_t index,
     return PSD_OK;
 }
 
+/**
+ * @brief Set layer opacity and flags
+ */
+PSD_API psd_status_t
+psd_document_set_layer_properties(psd_document_t *doc, int32_t index,
+                                  uint8_t opacity, uint8_t flags) {
+    if (!doc) {
+        return PSD_ERR_NULL_POINTER;
+    }
+
+    if (index < 0 || index >= doc->layers.layer_count) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    psd_layer_record_t *layer = &doc->layers.layers[index];
+    layer->opacity = opacity;
+    layer->flags = flags;
+
+    return PSD_OK;
+}
+
 /**
  * @brief Get layer channel count
  */
@@ -2205,6 +3154,24 @@ PSD_API psd_status_t psd_document_get_layer_name(const psd_document_t *doc,
     return PSD_ERR_INVALID_ARGUMENT;
 }
 
+/**
+ * @brief Find a layer by name
+ */
+PSD_API psd_status_t psd_document_find_layer_by_name(const psd_document_t *doc,
+                                                     const char *name,
+                                                     int32_t *layer_index) {
+    if (!doc || !name || !layer_index) {
+        return PSD_ERR_NULL_POINTER;
+    }
+
+    int32_t found = psd_layer_names_find(doc, (const uint8_t *)name, strlen(name));
+    if (found < 0) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    *layer_index = found;
+    return PSD_OK;
+}
+
 /**
  * @brief Get layer features
  *
@@ -2330,81 +3297,10 @@ PSD_API psd_bool_t psd_document_is_background_layer(const psd_document_t *doc,
         }
     }
 
-    /* Criterion 5: Check for vector mask (vmsk/vmns keys) in additional layer
-       info blocks Structure of additional_data:
-       - Layer mask data (4-byte length + data)
-       - Layer blending ranges (4-byte length + data)
-       - Layer name (Pascal string, padded to 4)
-       - Additional layer info blocks (tagged blocks with 4-byte key + 4-byte
-       length + data)
-    */
-    if (layer->additional_data && layer->additional_length > 0) {
-        uint8_t *data = layer->additional_data;
-        uint64_t remaining = layer->additional_length;
-
-        /* Skip layer mask data */
-        if (remaining >= 4) {
-            uint32_t mask_len = ((uint32_t)data[0] << 24) |
-                                ((uint32_t)data[1] << 16) |
-                                ((uint32_t)data[2] << 8) | ((uint32_t)data[3]);
-            data += 4;
-            remaining -= 4;
-            if (mask_len > 0 && mask_len <= remaining) {
-                data += mask_len;
-                remaining -= mask_len;
-            }
-        }
-
-        /* Skip layer blending ranges */
-        if (remaining >= 4) {
-            uint32_t blend_len = ((uint32_t)data[0] << 24) |
-                                 ((uint32_t)data[1] << 16) |
-                                 ((uint32_t)data[2] << 8) | ((uint32_t)data[3]);
-            data += 4;
-            remaining -= 4;
-            if (blend_len > 0 && blend_len <= remaining) {
-                data += blend_len;
-                remaining -= blend_len;
-            }
-        }
-
-        /* Skip layer name (Pascal string, padded to 4) */
-        if (remaining >= 1) {
-            uint8_t name_len = data[0];
-            uint32_t name_total = 1 + name_len;
-            if (name_total % 4 != 0) {
-                name_total += 4 - (name_total % 4);
-            }
-            if (name_total <= remaining) {
-                data += name_total;
-                remaining -= name_total;
-            }
-        }
-
-        /* Now scan additional layer info blocks for vector mask (vmsk/vmns) */
-        while (remaining >= 8) { /* 4-byte key + 4-byte length minimum */
-            uint8_t *key = data;
-            uint32_t block_len = ((uint32_t)data[4] << 24) |
-                                 ((uint32_t)data[5] << 16) |
-                                 ((uint32_t)data[6] << 8) | ((uint32_t)data[7]);
-
-            /* Check for vector mask keys (vmsk = vector mask, vmns = vector
-             * mask setting2) */
-            if ((key[0] == 'v' && key[1] == 'm' && key[2] == 's' &&
-                 key[3] == 'k') ||
-                (key[0] == 'v' && key[1] == 'm' && key[2] == 'n' &&
-                 key[3] == 's')) {
-                return 0; /* Has vector mask, not a true background */
-            }
-
-            /* Move to next block */
-            uint64_t block_total = 8 + block_len;
-            if (block_total > remaining) {
-                break;
-            }
-            data += block_total;
-            remaining -= block_total;
-        }
+    /* Criterion 5: Check for a vector mask (vmsk/vmns tagged block) */
+    if (psd_tagged_blocks_find(layer, 0x766D736Bu) != NULL ||  /* vmsk */
+        psd_tagged_blocks_find(layer, 0x766D6E73u) != NULL) {  /* vmns */
+        return 0; /* Has vector mask, not a true background */
     }
 
     /* Criterion 6: Channel count must equal base_channel_count
@@ -2429,6 +3325,17 @@ PSD_API psd_status_t psd_document_get_composite_image(const psd_document_t *doc,
         return PSD_ERR_NULL_POINTER;
     }
 
+    /* A deferred composite is read, and the payload decoded, on first
+     * access (logically const) */
+    psd_status_t status = psd_document_load_composite((psd_document_t *)doc);
+    if (status != PSD_OK) {
+        return status;
+    }
+    status = psd_document_decode_composite((psd_document_t *)doc);
+    if (status != PSD_OK) {
+        return status;
+    }
+
     if (data) {
         *data = doc->composite.data;
     }
@@ -2442,6 +3349,41 @@ PSD_API psd_status_t psd_document_get_composite_image(const psd_document_t *doc,
     return PSD_OK;
 }
 
+/* User masks (-2, -3) are always 8-bit */
+static uint16_t psd_layer_channel_depth(const psd_document_t *doc,
+                                        const psd_layer_channel_data_t *channel) {
+    if (channel->channel_id == -2 || channel->channel_id == -3) {
+        return 8;
+    }
+    return doc->depth;
+}
+
+/**
+ * @brief Decode a channel using its layer's geometry
+ *
+ * Empty layers and channels that are already decoded are left alone. ZIP
+ * channels stay compressed when ZIP support is not compiled in.
+ */
+static psd_status_t psd_layer_channel_decode_in_layer(const psd_document_t *doc,
+                                                      const psd_layer_record_t *layer,
+                                                      psd_layer_channel_data_t *channel,
+                                                      bool parallel_rows) {
+    uint32_t layer_width = (uint32_t)(layer->bounds.right - layer->bounds.left);
+    uint32_t layer_height = (uint32_t)(layer->bounds.bottom - layer->bounds.top);
+    if (layer_width == 0 || layer_height == 0) {
+        return PSD_OK;
+    }
+
+    /* Decode all formats (RAW, RLE, ZIP, ZIP+prediction) */
+    psd_status_t status = psd_layer_channel_decode(
+        channel, layer_width, layer_height, psd_layer_channel_depth(doc, channel), doc->allocator,
+        doc->zip, parallel_rows && !doc->serial_rows, doc->stats);
+    if (status == PSD_ERR_UNSUPPORTED_COMPRESSION) {
+        return PSD_OK;
+    }
+    return status;
+}
+
 /**
  * @brief Get layer channel data with lazy decoding
  */
@@ -2474,6 +3416,12 @@ PSD_API psd_status_t psd_document_get_layer_channel_data(
 
     psd_layer_channel_data_t *channel = &layer->channels[channel_index];
 
+    /* Bring in a payload skipped by PSD_PARSE_SKIP_LAYER_PIXELS */
+    psd_status_t load_status = psd_document_load_channel(doc, channel);
+    if (load_status != PSD_OK) {
+        return load_status;
+    }
+
     /* Calculate layer dimensions from bounds */
     uint32_t layer_width = (uint32_t)(layer->bounds.right - layer->bounds.left);
     uint32_t layer_height = (uint32_t)(layer->bounds.bottom - layer->bounds.top);
@@ -2481,6 +3429,7 @@ PSD_API psd_status_t psd_document_get_layer_channel_data(
     /* Ensure dimensions are valid (non-zero) */
     if (layer_width == 0 || layer_height == 0) {
         /* Empty layer - no data to decode */
+        psd_decode_cache_touch(doc, layer_index, channel);
         if (data) {
             *data = NULL;
         }
@@ -2491,24 +3440,10 @@ PSD_API psd_status_t psd_document_get_layer_channel_data(
     }
 
     /* Lazy decode the channel if not already decoded */
-    if (!channel->is_decoded) {
-
-        uint16_t channel_depth;
-        if (channel->channel_id == -2) {
-            channel_depth = 8;
-        } else if (channel->channel_id == -3) {
-            channel_depth = 8;
-        } else {
-            channel_depth = doc->depth;
-        }
-
-        /* Decode all formats (RAW, RLE, ZIP, ZIP+prediction) */
-        psd_status_t status = psd_layer_channel_decode(
-            channel, layer_width, layer_height, channel_depth, doc->allocator);
-
-        if (status != PSD_OK && status != PSD_ERR_UNSUPPORTED_COMPRESSION) {
-            return status;
-        }
+    psd_status_t decode_status = psd_layer_channel_decode_in_layer(doc, layer, channel, true);
+    psd_decode_cache_touch(doc, layer_index, channel);
+    if (decode_status != PSD_OK) {
+        return decode_status;
     }
 
     /* Return information to caller */
@@ -2550,6 +3485,191 @@ PSD_API psd_status_t psd_document_get_layer_channel_data(
     return PSD_OK;
 }
 
+/**
+ * @brief Decode a layer channel into caller memory
+ */
+PSD_API psd_status_t psd_document_decode_layer_channel_into(
+    psd_document_t *doc, int32_t layer_index, size_t channel_index,
+    uint8_t *dst, size_t dst_stride) {
+    if (!doc || !dst) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (layer_index < 0 || layer_index >= doc->layers.layer_count) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    if (channel_index >= layer->channel_count) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+    psd_layer_channel_data_t *channel = &layer->channels[channel_index];
+
+    uint32_t layer_width = (uint32_t)(layer->bounds.right - layer->bounds.left);
+    uint32_t layer_height = (uint32_t)(layer->bounds.bottom - layer->bounds.top);
+    if (layer_width == 0 || layer_height == 0) {
+        return PSD_OK;
+    }
+    uint16_t depth = psd_layer_channel_depth(doc, channel);
+
+    /* A plane decoded earlier is only copied */
+    if (psd_once_done(&channel->decoded)) {
+        size_t row_bytes = (depth == 1) ? ((size_t)layer_width + 7u) / 8u
+                                        : (size_t)layer_width * (depth / 8u);
+        if (dst_stride < row_bytes) {
+            return PSD_ERR_INVALID_ARGUMENT;
+        }
+        if (channel->decoded_length < (uint64_t)row_bytes * layer_height) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        for (uint32_t y = 0; y < layer_height; y++) {
+            memcpy(dst + (size_t)y * dst_stride,
+                   channel->decoded_data + (size_t)y * row_bytes, row_bytes);
+        }
+        psd_stats_decode_hit(doc->stats);
+        psd_decode_cache_touch(doc, layer_index, channel);
+        return PSD_OK;
+    }
+
+    /* Bring in a payload skipped by PSD_PARSE_SKIP_LAYER_PIXELS */
+    psd_status_t status = psd_document_load_channel(doc, channel);
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    status = psd_layer_channel_decode_into(channel, layer_width, layer_height, depth,
+                                           dst, dst_stride, doc->allocator,
+                                           doc->zip, !doc->serial_rows, doc->stats);
+    psd_decode_cache_touch(doc, layer_index, channel);
+    return status;
+}
+
+/* One channel decode of psd_document_decode_all_layers() */
+typedef struct {
+    const psd_layer_record_t *layer;
+    psd_layer_channel_data_t *channel;
+    int32_t layer_index;
+    psd_status_t status;
+} psd_decode_job_t;
+
+typedef struct {
+    const psd_document_t *doc;
+    psd_decode_job_t *jobs;
+    bool parallel_rows;
+} psd_decode_batch_t;
+
+static void psd_decode_job_run(void *task_data, size_t index) {
+    psd_decode_batch_t *batch = (psd_decode_batch_t *)task_data;
+    psd_decode_job_t *job = &batch->jobs[index];
+    job->status = psd_layer_channel_decode_in_layer(batch->doc, job->layer, job->channel,
+                                                    batch->parallel_rows);
+}
+
+/* Largest payloads first, so the long jobs don't end up last */
+static int psd_decode_job_compare(const void *a, const void *b) {
+    uint64_t la = ((const psd_decode_job_t *)a)->channel->compressed_length;
+    uint64_t lb = ((const psd_decode_job_t *)b)->channel->compressed_length;
+    return (la < lb) - (la > lb);
+}
+
+/**
+ * @brief Decode every layer channel, spread over worker threads
+ */
+PSD_API psd_status_t psd_document_decode_all_layers(psd_document_t *doc,
+                                                    const psd_thread_pool_t *pool) {
+    if (!doc) {
+        return PSD_ERR_NULL_POINTER;
+    }
+
+    /* Deferred payloads come from the shared source stream, so they are
+     * loaded here, in order, before any decode job starts */
+    (void)psd_document_prefetch_layers(doc, NULL, 0);
+    size_t job_count = 0;
+    for (int32_t i = 0; i < doc->layers.layer_count; i++) {
+        psd_layer_record_t *layer = &doc->layers.layers[i];
+        for (size_t c = 0; c < layer->channel_count; c++) {
+            psd_layer_channel_data_t *channel = &layer->channels[c];
+            psd_status_t status = psd_document_load_channel(doc, channel);
+            if (status != PSD_OK) {
+                return status;
+            }
+            if (!psd_once_done(&channel->decoded) && channel->compressed_data) {
+                job_count++;
+            }
+        }
+    }
+    if (job_count == 0) {
+        return PSD_OK;
+    }
+
+    psd_decode_job_t *jobs = (psd_decode_job_t *)psd_alloc_malloc(
+        doc->allocator, job_count * sizeof(*jobs));
+    if (!jobs) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+
+    /* Every job owns a distinct channel, so jobs never share decode state.
+     * Other threads may finish some of the counted channels meanwhile. */
+    size_t n = 0;
+    for (int32_t i = 0; i < doc->layers.layer_count; i++) {
+        psd_layer_record_t *layer = &doc->layers.layers[i];
+        for (size_t c = 0; c < layer->channel_count && n < job_count; c++) {
+            psd_layer_channel_data_t *channel = &layer->channels[c];
+            if (!psd_once_done(&channel->decoded) && channel->compressed_data) {
+                jobs[n].layer = layer;
+                jobs[n].channel = channel;
+                jobs[n].layer_index = i;
+                jobs[n].status = PSD_OK;
+                n++;
+            }
+        }
+    }
+    job_count = n;
+    qsort(jobs, job_count, sizeof(*jobs), psd_decode_job_compare);
+
+    /* With fewer channels than workers, big channels also split their rows.
+     * A caller pool decides its own parallelism, so rows stay serial. */
+    bool parallel_rows = !pool && job_count < psd_builtin_thread_count();
+    psd_decode_batch_t batch = { doc, jobs, parallel_rows };
+    psd_parallel_for(pool, job_count, psd_decode_job_run, &batch);
+
+    /* Charge the new planes to the decode budget */
+    psd_status_t result = PSD_OK;
+    for (size_t i = 0; i < job_count; i++) {
+        psd_decode_cache_touch(doc, jobs[i].layer_index, jobs[i].channel);
+    }
+    for (size_t i = 0; i < job_count && result == PSD_OK; i++) {
+        result = jobs[i].status;
+    }
+    psd_alloc_free(doc->allocator, jobs);
+    return result;
+}
+
+/**
+ * @brief Locate the descriptor bytes of a block, parsing it on first use
+ *
+ * @return PSD_OK with NULL and 0 when the key carries no descriptor
+ */
+static psd_status_t psd_layer_block_descriptor_bytes(psd_document_t *doc,
+                                                     const psd_layer_record_t *layer,
+                                                     psd_tagged_block_t *block,
+                                                     const uint8_t **out_data,
+                                                     uint64_t *out_length) {
+    *out_data = NULL;
+    *out_length = 0;
+
+    const psd_descriptor_flat_t *flat = NULL;
+    psd_status_t status = psd_tagged_block_descriptor(doc, layer, block, &flat);
+    if (status == PSD_ERR_UNSUPPORTED_FEATURE) {
+        return PSD_OK;
+    }
+    if (status != PSD_OK) {
+        return status;
+    }
+    *out_data = flat->data + flat->nodes[0].offset;
+    *out_length = flat->nodes[0].length;
+    return PSD_OK;
+}
+
 /**
  * @brief Get layer descriptor data
  */
@@ -2565,21 +3685,73 @@ PSD_API psd_status_t psd_document_get_layer_descriptor(
     }
 
     const psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    const uint8_t *found = NULL;
+    uint64_t found_length = 0;
+
+    /* Effects first, then whichever block carries a descriptor; blocks
+     * whose descriptor does not parse are passed over */
+    psd_tagged_block_t *effects = psd_tagged_blocks_find(layer, 0x6C667832u); /* lfx2 */
+    if (effects) {
+        (void)psd_layer_block_descriptor_bytes((psd_document_t *)doc, layer, effects,
+                                               &found, &found_length);
+    }
+    for (uint32_t i = 0; !found && i < layer->block_count; i++) {
+        (void)psd_layer_block_descriptor_bytes((psd_document_t *)doc, layer,
+                                               &layer->blocks[i], &found, &found_length);
+    }
 
     if (descriptor_data) {
-        /* Return raw descriptor data if present */
-        if (layer->descriptor) {
-            /* For now, we don't expose the parsed descriptor structure,
-             * only the raw additional data which may contain it */
-            *descriptor_data = NULL;
-        } else {
-            *descriptor_data = NULL;
-        }
+        *descriptor_data = found;
     }
 
     if (descriptor_length) {
-        *descriptor_length = 0;
+        *descriptor_length = found_length;
     }
 
     return PSD_OK;
 }
+
+/**
+ * @brief Get a layer's tagged block by key
+ */
+PSD_API psd_status_t psd_document_get_layer_tagged_block(
+    const psd_document_t *doc, int32_t layer_index, uint32_t key,
+    const uint8_t **data, uint64_t *length,
+    const uint8_t **descriptor_data, uint64_t *descriptor_length) {
+    if (!doc) {
+        return PSD_ERR_NULL_POINTER;
+    }
+
+    if (layer_index < 0 || layer_index >= doc->layers.layer_count) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    const psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    psd_tagged_block_t *block = psd_tagged_blocks_find(layer, key);
+    if (!block) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    if (data) {
+        *data = psd_tagged_block_payload(layer, block);
+    }
+    if (length) {
+        *length = block->length;
+    }
+
+    /* Only a caller asking for the descriptor pays for parsing it */
+    if (!descriptor_data && !descriptor_length) {
+        return PSD_OK;
+    }
+    const uint8_t *found = NULL;
+    uint64_t found_length = 0;
+    psd_status_t status = psd_layer_block_descriptor_bytes((psd_document_t *)doc, layer, block,
+                                                           &found, &found_length);
+    if (descriptor_data) {
+        *descriptor_data = found;
+    }
+    if (descriptor_length) {
+        *descriptor_length = found_length;
+    }
+    return status;
+}
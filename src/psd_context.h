@@ -22,12 +22,22 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "psd_alloc.h"
+#include "psd_arena.h"
 #include "psd_composite.h"
+#include "psd_decode_cache.h"
 #include "psd_descriptor.h"
 #include "psd_header.h"
 #include "psd_layer.h"
+#include "psd_layer_names.h"
 #include "psd_text_layer.h"
 #include "psd_resources.h"
+#include "psd_stats.h"
+#include "psd_layer_channel.h"
+#include "psd_layout_index.h"
+#include "psd_once.h"
+#include "psd_stream_internal.h"
+#include "psd_zip.h"
+#include "../include/openpsd/psd.h"
 #include "../include/openpsd/psd_types.h"
 
 /**
@@ -46,9 +56,141 @@ struct psd_document {
     psd_color_mode_data_t color_data; /**< Color mode data (palette, etc.) */
     psd_resources_t resources;        /**< Image resources section */
     psd_layer_info_t layers;          /**< Layer and mask information */
+    psd_layer_names_t layer_names;    /**< Layer name -> index (psd_document_find_layer_by_name) */
+    psd_layer_layout_t layout;        /**< Where the layer section was found (psd_document_save_index) */
     psd_composite_image_t composite;  /**< Composite image data */
 
     psd_text_layer_info_t text_layers; /**< Text layer information */
+
+    psd_stream_mapping_t *mapping;    /**< File mapping borrowed payloads point into (NULL if none) */
+    uint64_t mapping_origin;          /**< Mapping offset of stream position 0 (sub-stream views) */
+    psd_embedded_file_t *embedded_files; /**< Files of the linked layer blocks (metadata arena) */
+    uint32_t embedded_file_count;     /**< Number of embedded_files */
+    psd_stream_t *owned_stream;       /**< Stream freed with the document (psd_document_open_embedded) */
+
+    /* Deferred loading (psd_parse_with_options skip flags) */
+    uint32_t parse_flags;             /**< psd_parse_flags_t used for this document */
+    psd_stream_t *stream;             /**< Source stream for deferred loads (not owned, NULL if none) */
+    int64_t resources_offset;         /**< Offset of the unparsed resources section, -1 once loaded */
+    int64_t composite_offset;         /**< Offset of the unread image data section, -1 once loaded */
+    psd_once_t load_lock;             /**< Held while a deferred load uses stream */
+    psd_once_t resources_loaded;      /**< Published once resources_offset is settled */
+    psd_once_t composite_loaded;      /**< Published once composite_offset is settled */
+    psd_once_t composite_decoded;     /**< Published once the composite decode ran */
+
+    uint32_t render_flags;            /**< psd_render_flags_t for render calls */
+    psd_once_t palette_once;          /**< Claimed while palette is built (psd_document_palette) */
+    uint32_t palette[256];            /**< Indexed color table as packed RGBA, with resource 1047 */
+
+    psd_zip_pool_t zip_pool;          /**< Inflate states reused across ZIP channels */
+    psd_zip_pool_t *zip;              /**< Pool decodes use: zip_pool, or one shared by a psd_batch_t */
+    bool serial_rows;                 /**< Never split one channel's rows across threads */
+    psd_decode_cache_t decode_cache;  /**< LRU and budget of decoded layer pixels */
+    psd_stats_state_t *stats;         /**< Counters (PSD_PARSE_COLLECT_STATS), NULL when off */
+
+    /* Layer records, names, channel arrays, resource blocks, text layer items
+     * and descriptors; pixel payloads use the allocator directly */
+    psd_arena_t meta;                 /**< Metadata arena, freed in one go with the document */
 };
 
+/**
+ * @brief Allocate an empty document, ready for the section parsers
+ *
+ * @param allocator Allocator for the document and its payloads
+ * @param flags psd_parse_flags_t recorded in the document
+ * @param stats Counters the document takes ownership of, or NULL
+ * @return New document (free with psd_document_free()), or NULL if out of memory
+ */
+PSD_INTERNAL psd_document_t *psd_document_new(const psd_allocator_t *allocator, uint32_t flags,
+                                              psd_stats_state_t *stats);
+
+/**
+ * @brief Parse the File Header section (26 bytes)
+ */
+PSD_INTERNAL psd_status_t psd_parse_header(psd_stream_t *stream, psd_document_t *doc);
+
+/**
+ * @brief Parse the Color Mode Data section, length field included
+ */
+PSD_INTERNAL psd_status_t psd_parse_color_mode_data(psd_stream_t *stream, psd_document_t *doc);
+
+/**
+ * @brief Parse the Image Resources section, length field included
+ */
+PSD_INTERNAL psd_status_t psd_parse_resources(psd_stream_t *stream, psd_document_t *doc);
+
+/**
+ * @brief Set a layer record to its defaults before it is read
+ */
+PSD_INTERNAL void psd_layer_record_init(psd_layer_record_t *layer);
+
+/**
+ * @brief Parse one record of the Layer Info subsection into doc->layers.layers[i]
+ *
+ * Offsets are in the coordinates of stream. See psd_context.c for the
+ * parameters.
+ */
+PSD_INTERNAL psd_status_t psd_parse_layer_record(psd_stream_t *stream, psd_document_t *doc,
+                                                 int32_t i, const psd_layout_index_t *index,
+                                                 uint64_t *index_channel,
+                                                 int64_t layer_info_end, int64_t section_end,
+                                                 bool *out_last);
+
+/**
+ * @brief Planar composite geometry from the header
+ *
+ * @param doc Document with a parsed header
+ * @param bytes_per_sample Receives bytes per sample (1 for bitmaps)
+ * @param bytes_per_scanline Receives bytes per row of one plane
+ * @param uncompressed_size Receives bytes of all planes
+ */
+PSD_INTERNAL void psd_composite_geometry(const psd_document_t *doc,
+                                         uint64_t *bytes_per_sample,
+                                         uint64_t *bytes_per_scanline,
+                                         uint64_t *uncompressed_size);
+
+/**
+ * @brief Make sure a layer channel's compressed payload is in memory
+ *
+ * Loads payloads skipped with PSD_PARSE_SKIP_LAYER_PIXELS from the source stream.
+ *
+ * @param doc Owning document
+ * @param channel Channel of one of the document's layers
+ * @return PSD_OK when compressed_data is available (or the channel is empty)
+ */
+PSD_INTERNAL psd_status_t psd_document_load_channel(psd_document_t *doc,
+                                                    psd_layer_channel_data_t *channel);
+
+/**
+ * @brief Make sure the image resources section has been parsed
+ */
+PSD_INTERNAL psd_status_t psd_document_load_resources(psd_document_t *doc);
+
+/**
+ * @brief Make sure the composite image data section has been read
+ */
+PSD_INTERNAL psd_status_t psd_document_load_composite(psd_document_t *doc);
+
+/**
+ * @brief Decode the composite payload into planar image data
+ *
+ * Runs once. Leaves composite.data NULL (and returns PSD_OK) when there is no
+ * composite or its compression cannot be decoded in this build.
+ */
+PSD_INTERNAL psd_status_t psd_document_decode_composite(psd_document_t *doc);
+
+/**
+ * @brief Packed RGBA palette of an indexed document
+ *
+ * Built from the color table and the Transparency Index resource on first
+ * use and kept on the document. While another thread is building it, the
+ * same palette is built into scratch instead.
+ *
+ * @param doc Document (logically const; resources may be loaded)
+ * @param scratch Fallback storage for 256 entries
+ * @return 256 entries (see psd_palette_build())
+ */
+PSD_INTERNAL const uint32_t *psd_document_palette(const psd_document_t *doc,
+                                                  uint32_t scratch[256]);
+
 #endif /* PSD_CONTEXT_H */
@@ -0,0 +1,199 @@
+/**
+ * @file psd_decode_cache.c
+ * @brief Byte budget for decoded layer pixels
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_decode_cache.h"
+#include "psd_context.h"
+#include "psd_threads.h"
+
+void psd_decode_cache_init(psd_decode_cache_t *cache)
+{
+    cache->budget = 0;
+    cache->bytes = 0;
+    cache->head = NULL;
+    cache->tail = NULL;
+    psd_once_reset(&cache->lock);
+}
+
+/* Whether the compressed payload can be read again from the source stream */
+static bool psd_decode_cache_payload_reloadable(const psd_document_t *doc,
+                                                const psd_layer_channel_data_t *channel)
+{
+    return doc->stream && channel->compressed_data && !channel->compressed_borrowed &&
+           channel->compressed_length > 0;
+}
+
+/* Bytes psd_decode_cache_release() would give back. Only published fields
+ * are read: another thread may be loading or decoding the channel. */
+static uint64_t psd_decode_cache_cost(const psd_document_t *doc,
+                                      psd_layer_channel_data_t *channel)
+{
+    uint64_t bytes = 0;
+    if (psd_once_done(&channel->decoded) && channel->decoded_data != channel->compressed_data) {
+        bytes += channel->decoded_length;
+    }
+    if (psd_once_done(&channel->loaded) && psd_decode_cache_payload_reloadable(doc, channel)) {
+        bytes += channel->compressed_length;
+    }
+    return bytes;
+}
+
+static void psd_decode_cache_unlink(psd_decode_cache_t *cache, psd_layer_channel_data_t *channel)
+{
+    if (channel->cache_bytes == 0) {
+        return;
+    }
+    if (channel->lru_prev) {
+        channel->lru_prev->lru_next = channel->lru_next;
+    } else {
+        cache->head = channel->lru_next;
+    }
+    if (channel->lru_next) {
+        channel->lru_next->lru_prev = channel->lru_prev;
+    } else {
+        cache->tail = channel->lru_prev;
+    }
+    cache->bytes -= channel->cache_bytes;
+    channel->lru_prev = NULL;
+    channel->lru_next = NULL;
+    channel->cache_bytes = 0;
+}
+
+/* Free what the channel holds; the caller has unlinked it */
+static void psd_decode_cache_free_channel(psd_document_t *doc,
+                                          psd_layer_channel_data_t *channel)
+{
+    if (channel->decoded_data && channel->decoded_data != channel->compressed_data) {
+        psd_alloc_free(doc->allocator, channel->decoded_data);
+    }
+    channel->decoded_data = NULL;
+    channel->decoded_length = 0;
+    psd_once_reset(&channel->decoded);
+
+    /* psd_document_load_channel() brings it back from file_offset */
+    if (psd_decode_cache_payload_reloadable(doc, channel)) {
+        psd_alloc_free(doc->allocator, channel->compressed_data);
+        channel->compressed_data = NULL;
+        psd_once_reset(&channel->loaded);
+    }
+}
+
+void psd_decode_cache_release(psd_document_t *doc, psd_layer_channel_data_t *channel)
+{
+    psd_lock_acquire(&doc->decode_cache.lock);
+    psd_decode_cache_unlink(&doc->decode_cache, channel);
+    psd_once_reset(&doc->decode_cache.lock);
+    psd_decode_cache_free_channel(doc, channel);
+}
+
+/* Evict with the cache lock held */
+static void psd_decode_cache_evict_locked(psd_document_t *doc, int32_t keep_layer)
+{
+    psd_decode_cache_t *cache = &doc->decode_cache;
+    if (cache->budget == 0) {
+        return;
+    }
+    psd_layer_channel_data_t *channel = cache->tail;
+    while (channel && cache->bytes > cache->budget) {
+        psd_layer_channel_data_t *newer = channel->lru_prev;
+        if (channel->cache_layer != keep_layer) {
+            psd_decode_cache_unlink(cache, channel);
+            psd_decode_cache_free_channel(doc, channel);
+        }
+        channel = newer;
+    }
+}
+
+void psd_decode_cache_evict(psd_document_t *doc, int32_t keep_layer)
+{
+    psd_lock_acquire(&doc->decode_cache.lock);
+    psd_decode_cache_evict_locked(doc, keep_layer);
+    psd_once_reset(&doc->decode_cache.lock);
+}
+
+void psd_decode_cache_touch(psd_document_t *doc,
+                            int32_t layer_index,
+                            psd_layer_channel_data_t *channel)
+{
+    psd_decode_cache_t *cache = &doc->decode_cache;
+    psd_lock_acquire(&cache->lock);
+    psd_decode_cache_unlink(cache, channel);
+
+    uint64_t cost = psd_decode_cache_cost(doc, channel);
+    if (cost > 0) {
+        channel->lru_prev = NULL;
+        channel->lru_next = cache->head;
+        if (cache->head) {
+            cache->head->lru_prev = channel;
+        } else {
+            cache->tail = channel;
+        }
+        cache->head = channel;
+        channel->cache_bytes = cost;
+        channel->cache_layer = layer_index;
+        cache->bytes += cost;
+    }
+
+    psd_decode_cache_evict_locked(doc, layer_index);
+    psd_once_reset(&cache->lock);
+}
+
+/**
+ * @brief Set the byte budget for decoded layer pixels
+ */
+PSD_API psd_status_t psd_document_set_decode_budget(psd_document_t *doc, uint64_t max_bytes)
+{
+    if (!doc) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    psd_lock_acquire(&doc->decode_cache.lock);
+    doc->decode_cache.budget = max_bytes;
+    psd_decode_cache_evict_locked(doc, -1);
+    psd_once_reset(&doc->decode_cache.lock);
+    return PSD_OK;
+}
+
+/**
+ * @brief Bytes of layer pixel memory the document currently holds for reuse
+ */
+PSD_API psd_status_t psd_document_get_decode_cache_usage(const psd_document_t *doc,
+                                                         uint64_t *bytes)
+{
+    if (!doc || !bytes) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    psd_decode_cache_t *cache = (psd_decode_cache_t *)&doc->decode_cache;
+    psd_lock_acquire(&cache->lock);
+    *bytes = cache->bytes;
+    psd_once_reset(&cache->lock);
+    return PSD_OK;
+}
+
+/**
+ * @brief Release the decoded pixels of one layer
+ */
+PSD_API psd_status_t psd_document_release_layer_pixels(psd_document_t *doc, int32_t layer_index)
+{
+    if (!doc) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (layer_index < 0 || layer_index >= doc->layers.layer_count) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+    psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    for (size_t i = 0; i < layer->channel_count; i++) {
+        psd_decode_cache_release(doc, &layer->channels[i]);
+    }
+    return PSD_OK;
+}
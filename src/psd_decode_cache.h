@@ -0,0 +1,85 @@
+/**
+ * @file psd_decode_cache.h
+ * @brief Byte budget for decoded layer pixels
+ *
+ * Channels that hold pixel memory the document could give back (a decoded
+ * plane, or a payload loaded from a deferred source stream) are kept on a
+ * least-recently-used list. With a budget set, the oldest channels are
+ * released whenever the list outgrows it and are decoded (or reloaded) again
+ * on their next use. Channels of the layer being accessed are never released
+ * by that access, so one render or channel query always sees all of its
+ * layer's planes.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_DECODE_CACHE_H
+#define PSD_DECODE_CACHE_H
+
+#include <stdint.h>
+#include "psd_layer_channel.h"
+#include "psd_once.h"
+#include "../include/openpsd/psd.h"
+#include "../include/openpsd/psd_export.h"
+
+/**
+ * @brief Per-document LRU of channels holding releasable pixel memory
+ *
+ * The list is locked so that concurrent reads of a shared document can
+ * record their uses. Eviction frees planes other readers may still hold,
+ * so a budget makes decodes exclusive again.
+ */
+typedef struct {
+    uint64_t budget;                  /**< Byte budget (0 = unlimited) */
+    uint64_t bytes;                   /**< Bytes held by the listed channels */
+    psd_layer_channel_data_t *head;   /**< Most recently used */
+    psd_layer_channel_data_t *tail;   /**< Least recently used */
+    psd_once_t lock;                  /**< Held while the list or bytes change */
+} psd_decode_cache_t;
+
+/**
+ * @brief Set up an empty cache without a budget
+ */
+PSD_INTERNAL void psd_decode_cache_init(psd_decode_cache_t *cache);
+
+/**
+ * @brief Record a use of a channel that was just loaded, decoded or read
+ *
+ * Moves the channel to the front of the list (or drops it from the list when
+ * it holds nothing releasable), then evicts down to the budget, sparing the
+ * channels of layer_index.
+ *
+ * @param doc Owning document
+ * @param layer_index Index of the channel's layer
+ * @param channel Channel of that layer
+ */
+PSD_INTERNAL void psd_decode_cache_touch(psd_document_t *doc,
+                                         int32_t layer_index,
+                                         psd_layer_channel_data_t *channel);
+
+/**
+ * @brief Release a channel's releasable pixel memory and unlist it
+ *
+ * Frees the decoded plane, and the compressed payload when it can be read
+ * again from the document's source stream.
+ */
+PSD_INTERNAL void psd_decode_cache_release(psd_document_t *doc,
+                                           psd_layer_channel_data_t *channel);
+
+/**
+ * @brief Evict least recently used channels until the budget holds
+ *
+ * @param doc Owning document
+ * @param keep_layer Layer whose channels stay (-1 for none)
+ */
+PSD_INTERNAL void psd_decode_cache_evict(psd_document_t *doc, int32_t keep_layer);
+
+#endif /* PSD_DECODE_CACHE_H */
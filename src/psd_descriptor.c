@@ -773,3 +773,509 @@ void psd_descriptor_free(
     
     psd_alloc_free(allocator, descriptor);
 }
+
+/* ------------------------------------------------------------------------ */
+/* Flat descriptors                                                          */
+/* ------------------------------------------------------------------------ */
+
+/* Nesting allowed for objects and lists (Photoshop rarely exceeds ten) */
+#define PSD_DESC_FLAT_MAX_DEPTH 64
+
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    size_t pos;
+    const psd_allocator_t *scratch;
+    psd_descriptor_node_t *nodes;
+    uint32_t count;
+    uint32_t capacity;
+} psd_flat_parser_t;
+
+static uint32_t psd_flat_hash(const uint8_t *key, size_t length)
+{
+    uint32_t hash = 0x811c9dc5u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= key[i];
+        hash *= 0x01000193u;
+    }
+    return hash;
+}
+
+static psd_status_t psd_flat_skip(psd_flat_parser_t *p, uint64_t bytes)
+{
+    if (bytes > p->length - p->pos) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+    p->pos += (size_t)bytes;
+    return PSD_OK;
+}
+
+static psd_status_t psd_flat_read32(psd_flat_parser_t *p, uint32_t *out_value)
+{
+    if (p->length - p->pos < 4) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+    *out_value = psd_read_be32(p->data + p->pos);
+    p->pos += 4;
+    return PSD_OK;
+}
+
+/* Unicode string: 4-byte character count + UTF-16BE */
+static psd_status_t psd_flat_skip_unicode(psd_flat_parser_t *p)
+{
+    uint32_t char_count = 0;
+    psd_status_t status = psd_flat_read32(p, &char_count);
+    return status == PSD_OK ? psd_flat_skip(p, (uint64_t)char_count * 2u) : status;
+}
+
+/*
+ * ClassID / key token: length 0 + OSType, or length + ASCII. Four-byte
+ * strings are stored as OSTypes so both spellings of a key compare equal.
+ */
+static psd_status_t psd_flat_read_id(psd_flat_parser_t *p, uint32_t *out_key,
+                                     uint32_t *out_offset, uint32_t *out_length)
+{
+    uint32_t length = 0;
+    psd_status_t status = psd_flat_read32(p, &length);
+    if (status != PSD_OK) {
+        return status;
+    }
+    if (length == 0) {
+        length = 4;
+    }
+    size_t offset = p->pos;
+    status = psd_flat_skip(p, length);
+    if (status != PSD_OK || !out_key) {
+        return status;
+    }
+    if (length == 4) {
+        *out_key = psd_read_be32(p->data + offset);
+        *out_offset = 0;
+        *out_length = 0;
+    } else {
+        *out_key = psd_flat_hash(p->data + offset, length);
+        *out_offset = (uint32_t)offset;
+        *out_length = length;
+    }
+    return PSD_OK;
+}
+
+/* Append a node as the next child of parent */
+static psd_status_t psd_flat_add(psd_flat_parser_t *p, uint32_t parent, uint32_t *out_index)
+{
+    if (p->count == p->capacity) {
+        uint32_t capacity = p->capacity * 2u;
+        if (capacity <= p->capacity) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        psd_descriptor_node_t *nodes = (psd_descriptor_node_t *)psd_alloc_realloc(
+            p->scratch, p->nodes, (size_t)capacity * sizeof(psd_descriptor_node_t));
+        if (!nodes) {
+            return PSD_ERR_OUT_OF_MEMORY;
+        }
+        p->nodes = nodes;
+        p->capacity = capacity;
+    }
+    uint32_t index = p->count++;
+    memset(&p->nodes[index], 0, sizeof(p->nodes[index]));
+    p->nodes[parent].child_count++;
+    *out_index = index;
+    return PSD_OK;
+}
+
+static psd_status_t psd_flat_value(psd_flat_parser_t *p, uint32_t node, uint32_t depth);
+
+/* Reference: count + (form OSType + form data)* */
+static psd_status_t psd_flat_reference(psd_flat_parser_t *p)
+{
+    uint32_t item_count = 0;
+    psd_status_t status = psd_flat_read32(p, &item_count);
+    for (uint32_t i = 0; status == PSD_OK && i < item_count; i++) {
+        uint32_t form = 0;
+        status = psd_flat_read32(p, &form);
+        if (status != PSD_OK) {
+            break;
+        }
+        switch (form) {
+            case 0x70726F70: /* 'prop': class + key */
+            case 0x456E6D72: /* 'Enmr': class + type + value (one more ID below) */
+                status = psd_flat_skip_unicode(p);
+                if (status == PSD_OK) status = psd_flat_read_id(p, NULL, NULL, NULL);
+                if (status == PSD_OK) status = psd_flat_read_id(p, NULL, NULL, NULL);
+                if (status == PSD_OK && form == 0x456E6D72) {
+                    status = psd_flat_read_id(p, NULL, NULL, NULL);
+                }
+                break;
+            case 0x436C7373: /* 'Clss': class */
+                status = psd_flat_skip_unicode(p);
+                if (status == PSD_OK) status = psd_flat_read_id(p, NULL, NULL, NULL);
+                break;
+            case 0x72656C65: /* 'rele': class + offset */
+                status = psd_flat_skip_unicode(p);
+                if (status == PSD_OK) status = psd_flat_read_id(p, NULL, NULL, NULL);
+                if (status == PSD_OK) status = psd_flat_skip(p, 4);
+                break;
+            case 0x49646E74: /* 'Idnt' */
+            case 0x696E6478: /* 'indx' */
+                status = psd_flat_skip(p, 4);
+                break;
+            case 0x6E616D65: /* 'name' */
+                status = psd_flat_skip_unicode(p);
+                break;
+            default:
+                return PSD_ERR_UNSUPPORTED_FEATURE;
+        }
+    }
+    return status;
+}
+
+/* Descriptor body: [Unicode name +] class ID + count + (key + type + value)* */
+static psd_status_t psd_flat_descriptor(psd_flat_parser_t *p, uint32_t node, uint32_t depth)
+{
+    if (depth >= PSD_DESC_FLAT_MAX_DEPTH) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+
+    /* Some writers leave out the name; same fallback as psd_parse_descriptor() */
+    size_t start = p->pos;
+    psd_status_t status = psd_flat_skip_unicode(p);
+    if (status == PSD_OK) {
+        status = psd_flat_read_id(p, NULL, NULL, NULL);
+    }
+    if (status != PSD_OK) {
+        p->pos = start;
+        status = psd_flat_read_id(p, NULL, NULL, NULL);
+    }
+
+    uint32_t count = 0;
+    if (status == PSD_OK) {
+        status = psd_flat_read32(p, &count);
+    }
+    /* Every member takes at least 9 bytes */
+    if (status == PSD_OK && count > (p->length - p->pos) / 9u) {
+        status = PSD_ERR_CORRUPT_DATA;
+    }
+
+    for (uint32_t i = 0; status == PSD_OK && i < count; i++) {
+        uint32_t child = 0;
+        uint32_t type_id = 0;
+        status = psd_flat_add(p, node, &child);
+        if (status == PSD_OK) {
+            psd_descriptor_node_t *n = &p->nodes[child];
+            status = psd_flat_read_id(p, &n->key, &n->key_offset, &n->key_length);
+        }
+        if (status == PSD_OK) status = psd_flat_read32(p, &type_id);
+        if (status == PSD_OK) {
+            p->nodes[child].type_id = type_id;
+            status = psd_flat_value(p, child, depth + 1);
+        }
+    }
+    return status;
+}
+
+static psd_status_t psd_flat_value(psd_flat_parser_t *p, uint32_t node, uint32_t depth)
+{
+    psd_status_t status = PSD_OK;
+    size_t start = p->pos;
+    uint32_t length = 0;
+
+    switch (p->nodes[node].type_id) {
+        case PSD_DESC_INTEGER:
+            status = psd_flat_skip(p, 4);
+            break;
+        case PSD_DESC_DOUBLE:
+        case PSD_DESC_LARGE_INTEGER:
+            status = psd_flat_skip(p, 8);
+            break;
+        case PSD_DESC_UNIT_FLOAT:
+        case PSD_DESC_UNIT_VALUE:
+            status = psd_flat_skip(p, 12);
+            break;
+        case PSD_DESC_BOOLEAN:
+            status = psd_flat_skip(p, 1);
+            break;
+        case PSD_DESC_STRING:
+            status = psd_flat_skip_unicode(p);
+            break;
+        case PSD_DESC_ENUMERATED:
+            status = psd_flat_read_id(p, NULL, NULL, NULL);
+            if (status == PSD_OK) status = psd_flat_read_id(p, NULL, NULL, NULL);
+            break;
+        case PSD_DESC_CLASS:
+        case PSD_DESC_GLOBAL_CLASS:
+            status = psd_flat_skip_unicode(p);
+            if (status == PSD_OK) status = psd_flat_read_id(p, NULL, NULL, NULL);
+            break;
+        case PSD_DESC_REFERENCE:
+        case PSD_DESC_OBJECT_REF:
+            status = psd_flat_reference(p);
+            break;
+        case PSD_DESC_DESCRIPTOR:
+        case PSD_DESC_OBJECT:
+        case PSD_DESC_GLOBAL_OBJECT:
+            status = psd_flat_descriptor(p, node, depth);
+            break;
+        case PSD_DESC_LIST: {
+            uint32_t count = 0;
+            if (depth >= PSD_DESC_FLAT_MAX_DEPTH) {
+                return PSD_ERR_CORRUPT_DATA;
+            }
+            status = psd_flat_read32(p, &count);
+            /* Every item takes at least 5 bytes */
+            if (status == PSD_OK && count > (p->length - p->pos) / 5u) {
+                status = PSD_ERR_CORRUPT_DATA;
+            }
+            for (uint32_t i = 0; status == PSD_OK && i < count; i++) {
+                uint32_t child = 0;
+                uint32_t type_id = 0;
+                status = psd_flat_add(p, node, &child);
+                if (status == PSD_OK) status = psd_flat_read32(p, &type_id);
+                if (status == PSD_OK) {
+                    p->nodes[child].type_id = type_id;
+                    status = psd_flat_value(p, child, depth + 1);
+                }
+            }
+            break;
+        }
+        case PSD_DESC_UNIT_FLOATS: {
+            uint32_t count = 0;
+            status = psd_flat_skip(p, 4);
+            if (status == PSD_OK) status = psd_flat_read32(p, &count);
+            if (status == PSD_OK) status = psd_flat_skip(p, (uint64_t)count * 8u);
+            break;
+        }
+        default:
+            /* 'tdta', 'raws', 'alis' and unknown types: length + bytes */
+            status = psd_flat_read32(p, &length);
+            if (status == PSD_OK) {
+                start = p->pos;
+                status = psd_flat_skip(p, length);
+            }
+            break;
+    }
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    psd_descriptor_node_t *n = &p->nodes[node];
+    n->offset = (uint32_t)start;
+    n->length = (uint32_t)(p->pos - start);
+    n->end = p->count;
+    return PSD_OK;
+}
+
+psd_status_t psd_descriptor_flat_parse(
+    const uint8_t *data,
+    size_t length,
+    const psd_allocator_t *allocator,
+    const psd_allocator_t *scratch,
+    size_t *out_consumed,
+    psd_descriptor_flat_t **out_flat)
+{
+    if (!data || !out_flat) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    *out_flat = NULL;
+    if (out_consumed) {
+        *out_consumed = 0;
+    }
+    /* Offsets are 32-bit */
+    if (length > UINT32_MAX) {
+        length = UINT32_MAX;
+    }
+
+    psd_flat_parser_t p;
+    memset(&p, 0, sizeof(p));
+    p.data = data;
+    p.length = length;
+    p.scratch = scratch;
+    p.capacity = 64;
+    p.nodes = (psd_descriptor_node_t *)psd_alloc_malloc(
+        scratch, (size_t)p.capacity * sizeof(psd_descriptor_node_t));
+    if (!p.nodes) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    memset(&p.nodes[0], 0, sizeof(p.nodes[0]));
+    p.nodes[0].type_id = PSD_DESC_DESCRIPTOR;
+    p.count = 1;
+
+    psd_status_t status = psd_flat_value(&p, 0, 0);
+
+    psd_descriptor_flat_t *flat = NULL;
+    if (status == PSD_OK) {
+        flat = (psd_descriptor_flat_t *)psd_alloc_malloc(allocator, sizeof(*flat));
+        psd_descriptor_node_t *nodes = (psd_descriptor_node_t *)psd_alloc_malloc(
+            allocator, (size_t)p.count * sizeof(psd_descriptor_node_t));
+        if (flat && nodes) {
+            memcpy(nodes, p.nodes, (size_t)p.count * sizeof(psd_descriptor_node_t));
+            flat->data = data;
+            flat->length = length;
+            flat->nodes = nodes;
+            flat->count = p.count;
+            if (out_consumed) {
+                *out_consumed = p.pos;
+            }
+        } else {
+            psd_alloc_free(allocator, nodes);
+            psd_alloc_free(allocator, flat);
+            flat = NULL;
+            status = PSD_ERR_OUT_OF_MEMORY;
+        }
+    }
+    psd_alloc_free(scratch, p.nodes);
+
+    *out_flat = flat;
+    return status;
+}
+
+void psd_descriptor_flat_free(
+    psd_descriptor_flat_t *flat,
+    const psd_allocator_t *allocator)
+{
+    if (!flat) {
+        return;
+    }
+    psd_alloc_free(allocator, flat->nodes);
+    psd_alloc_free(allocator, flat);
+}
+
+/* Key of a lookup, in the same form the parser stores */
+static void psd_flat_lookup_key(const char *key, size_t length,
+                                uint32_t *out_key, uint32_t *out_length)
+{
+    if (length == 4) {
+        *out_key = psd_read_be32((const uint8_t *)key);
+        *out_length = 0;
+    } else {
+        *out_key = psd_flat_hash((const uint8_t *)key, length);
+        *out_length = (uint32_t)length;
+    }
+}
+
+static bool psd_flat_key_matches(const psd_descriptor_flat_t *flat,
+                                 const psd_descriptor_node_t *n,
+                                 uint32_t key, uint32_t key_length, const char *text)
+{
+    return n->key == key && n->key_length == key_length &&
+           (key_length == 0 || memcmp(flat->data + n->key_offset, text, key_length) == 0);
+}
+
+uint32_t psd_descriptor_flat_find(
+    const psd_descriptor_flat_t *flat,
+    uint32_t node,
+    const char *path)
+{
+    if (!flat || !path || node >= flat->count) {
+        return 0;
+    }
+    while (*path) {
+        const char *end = strchr(path, '/');
+        size_t length = end ? (size_t)(end - path) : strlen(path);
+        uint32_t key = 0;
+        uint32_t key_length = 0;
+        psd_flat_lookup_key(path, length, &key, &key_length);
+
+        uint32_t found = 0;
+        for (uint32_t c = node + 1; c < flat->nodes[node].end; c = flat->nodes[c].end) {
+            if (psd_flat_key_matches(flat, &flat->nodes[c], key, key_length, path)) {
+                found = c;
+                break;
+            }
+        }
+        if (!found) {
+            return 0;
+        }
+        node = found;
+        path = end ? end + 1 : path + length;
+    }
+    return node;
+}
+
+uint32_t psd_descriptor_flat_find_any(
+    const psd_descriptor_flat_t *flat,
+    uint32_t node,
+    const char *key)
+{
+    if (!flat || !key || node >= flat->count) {
+        return 0;
+    }
+    uint32_t k = 0;
+    uint32_t key_length = 0;
+    psd_flat_lookup_key(key, strlen(key), &k, &key_length);
+
+    /* Descendants are contiguous: one linear pass */
+    for (uint32_t i = node + 1; i < flat->nodes[node].end; i++) {
+        if (psd_flat_key_matches(flat, &flat->nodes[i], k, key_length, key)) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+const uint8_t *psd_descriptor_flat_data(
+    const psd_descriptor_flat_t *flat,
+    uint32_t node,
+    size_t *out_length)
+{
+    if (out_length) {
+        *out_length = 0;
+    }
+    if (!flat || node >= flat->count) {
+        return NULL;
+    }
+    if (out_length) {
+        *out_length = flat->nodes[node].length;
+    }
+    return flat->data + flat->nodes[node].offset;
+}
+
+bool psd_descriptor_flat_number(
+    const psd_descriptor_flat_t *flat,
+    uint32_t node,
+    double *out_value)
+{
+    if (!flat || !out_value || node >= flat->count) {
+        return false;
+    }
+    const psd_descriptor_node_t *n = &flat->nodes[node];
+    const uint8_t *v = flat->data + n->offset;
+    uint64_t bits = 0;
+
+    switch (n->type_id) {
+        case PSD_DESC_INTEGER:
+            *out_value = (double)psd_read_be_i32(v);
+            return true;
+        case PSD_DESC_LARGE_INTEGER:
+            *out_value = (double)(int64_t)psd_read_be64(v);
+            return true;
+        case PSD_DESC_BOOLEAN:
+            *out_value = v[0] ? 1.0 : 0.0;
+            return true;
+        case PSD_DESC_UNIT_FLOAT:
+            v += 4;
+            /* fall through */
+        case PSD_DESC_DOUBLE:
+            bits = psd_read_be64(v);
+            memcpy(out_value, &bits, sizeof(*out_value));
+            return true;
+        default:
+            return false;
+    }
+}
+
+char *psd_descriptor_flat_text(
+    const psd_descriptor_flat_t *flat,
+    uint32_t node,
+    const psd_allocator_t *allocator,
+    size_t *out_length)
+{
+    if (out_length) {
+        *out_length = 0;
+    }
+    if (!flat || node >= flat->count || flat->nodes[node].type_id != PSD_DESC_STRING) {
+        return NULL;
+    }
+    const psd_descriptor_node_t *n = &flat->nodes[node];
+    return (char *)psd_utf16be_to_utf8(allocator, flat->data + n->offset + 4, n->length - 4,
+                                       out_length);
+}
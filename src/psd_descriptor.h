@@ -48,6 +48,14 @@ typedef enum {
     PSD_DESC_LIST = 0x566C4C73,         /**< 'VlLs' */
     PSD_DESC_CLASS = 0x74797065,        /**< 'type' */
     PSD_DESC_RAW_DATA = 0x72617773,     /**< 'raws' */
+    PSD_DESC_DESCRIPTOR = 0x4F626A63,   /**< 'Objc' (nested descriptor as Photoshop writes it) */
+    PSD_DESC_TEXT_DATA = 0x74647461,    /**< 'tdta' (length + bytes, e.g. EngineData) */
+    PSD_DESC_LARGE_INTEGER = 0x636F6D70,/**< 'comp' */
+    PSD_DESC_UNIT_FLOATS = 0x556E466C,  /**< 'UnFl' */
+    PSD_DESC_GLOBAL_OBJECT = 0x476C624F,/**< 'GlbO' */
+    PSD_DESC_GLOBAL_CLASS = 0x476C6243, /**< 'GlbC' */
+    PSD_DESC_OBJECT_REF = 0x6F626A20,   /**< 'obj ' (reference) */
+    PSD_DESC_ALIAS = 0x616C6973,        /**< 'alis' */
 } psd_descriptor_type_t;
 
 /* Forward declarations for recursive descriptor containers */
@@ -115,4 +123,123 @@ PSD_INTERNAL void psd_descriptor_free(
     psd_descriptor_t *descriptor,
     const psd_allocator_t *allocator);
 
+/* ------------------------------------------------------------------------ */
+/* Flat descriptors                                                          */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * @brief One key/value of a flat descriptor
+ *
+ * Nodes are stored in preorder, so the members of node i are the nodes in
+ * [i + 1, end) reached by hopping from each child to its own end. Values are
+ * byte ranges in the source buffer; nothing is copied while parsing.
+ */
+typedef struct {
+    uint32_t key;          /**< 4-char key as a big-endian OSType, or a hash of a longer key */
+    uint32_t key_length;   /**< 0 for 4-char keys, else the length of the key at key_offset */
+    uint32_t key_offset;   /**< Long key bytes in the source */
+    uint32_t type_id;      /**< Value type (psd_descriptor_type_t); PSD_DESC_DESCRIPTOR for the root */
+    uint32_t offset;       /**< Value bytes in the source (see psd_descriptor_flat_data) */
+    uint32_t length;
+    uint32_t end;          /**< One past the last descendant */
+    uint32_t child_count;  /**< Members of an object, items of a list */
+} psd_descriptor_node_t;
+
+/**
+ * @brief A descriptor parsed into one node array over its source bytes
+ */
+typedef struct {
+    const uint8_t *data;           /**< Source bytes (not owned, must outlive the tree) */
+    size_t length;
+    psd_descriptor_node_t *nodes;  /**< nodes[0] is the descriptor itself */
+    uint32_t count;
+} psd_descriptor_flat_t;
+
+/**
+ * @brief Parse a descriptor held in memory into a flat node array
+ *
+ * Two allocations per descriptor regardless of its size. Members of objects
+ * ('Objc', 'Obj ', 'GlbO') and lists ('VlLs') become child nodes; every other
+ * value is a byte range into data.
+ *
+ * @param data Buffer holding the descriptor at its first byte
+ * @param length Bytes available
+ * @param allocator Owner of the finished tree
+ * @param scratch Allocator for the node array while it grows
+ * @param out_consumed Receives the descriptor size in bytes (may be NULL)
+ * @param out_flat Receives the tree on success
+ * @return PSD_OK, PSD_ERR_CORRUPT_DATA for truncated or over-nested input,
+ *         PSD_ERR_UNSUPPORTED_FEATURE for unknown reference forms, or
+ *         PSD_ERR_OUT_OF_MEMORY
+ */
+PSD_INTERNAL psd_status_t psd_descriptor_flat_parse(
+    const uint8_t *data,
+    size_t length,
+    const psd_allocator_t *allocator,
+    const psd_allocator_t *scratch,
+    size_t *out_consumed,
+    psd_descriptor_flat_t **out_flat);
+
+/**
+ * @brief Free a tree returned by psd_descriptor_flat_parse()
+ */
+PSD_INTERNAL void psd_descriptor_flat_free(
+    psd_descriptor_flat_t *flat,
+    const psd_allocator_t *allocator);
+
+/**
+ * @brief Follow a '/'-separated chain of keys from a node
+ *
+ * Each step matches a member of the current object by key, e.g.
+ * "EngineData" or "warp/warpStyle".
+ *
+ * @return Node index, or 0 if any step is missing
+ */
+PSD_INTERNAL uint32_t psd_descriptor_flat_find(
+    const psd_descriptor_flat_t *flat,
+    uint32_t node,
+    const char *path);
+
+/**
+ * @brief First node anywhere below a node with this key (preorder)
+ *
+ * @return Node index, or 0 if no node has the key
+ */
+PSD_INTERNAL uint32_t psd_descriptor_flat_find_any(
+    const psd_descriptor_flat_t *flat,
+    uint32_t node,
+    const char *key);
+
+/**
+ * @brief Payload bytes of a raw value ('tdta', 'raws', 'alis', unknown types)
+ *
+ * For other plain values this is their encoded form (e.g. 8 bytes of 'doub').
+ */
+PSD_INTERNAL const uint8_t *psd_descriptor_flat_data(
+    const psd_descriptor_flat_t *flat,
+    uint32_t node,
+    size_t *out_length);
+
+/**
+ * @brief Numeric value of a 'long', 'comp', 'doub', 'UntF' or 'bool' node
+ *
+ * @return true if the node holds one of those types
+ */
+PSD_INTERNAL bool psd_descriptor_flat_number(
+    const psd_descriptor_flat_t *flat,
+    uint32_t node,
+    double *out_value);
+
+/**
+ * @brief Decode a 'TEXT' node to NUL-terminated UTF-8
+ *
+ * @return Allocated string (free with psd_alloc_free), or NULL if the node is
+ *         not text or memory ran out
+ */
+PSD_INTERNAL char *psd_descriptor_flat_text(
+    const psd_descriptor_flat_t *flat,
+    uint32_t node,
+    const psd_allocator_t *allocator,
+    size_t *out_length);
+
 #endif /* PSD_DESCRIPTOR_H */
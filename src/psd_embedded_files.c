@@ -0,0 +1,499 @@
+/**
+ * @file psd_embedded_files.c
+ * @brief Files embedded for smart object layers
+ *
+ * Format of a linked layer entry (Adobe spec, "Linked Layer"): 8-byte
+ * length, then type ('liFD' embedded, 'liFE' external, 'liFA' alias),
+ * version, Pascal unique ID, Unicode file name, file type, creator, 8-byte
+ * data length, a file-open descriptor flag with its optional descriptor,
+ * and for 'liFD' the file bytes. Entries are padded to 4 bytes.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_embedded_files.h"
+#include "psd_alloc.h"
+#include "psd_context.h"
+#include "psd_descriptor.h"
+#include "psd_endian.h"
+#include "psd_stream_internal.h"
+#include "psd_tagged_blocks.h"
+#include "psd_unicode.h"
+#include <string.h>
+
+#define PSD_TAG_SIG_8BIM 0x3842494Du /* "8BIM" */
+#define PSD_TAG_SIG_8B64 0x38423634u /* "8B64" */
+
+#define PSD_KEY_LNK2 0x6C6E6B32u /* lnk2 */
+#define PSD_KEY_LNK3 0x6C6E6B33u /* lnk3 */
+#define PSD_KEY_LNKD 0x6C6E6B44u /* lnkD */
+#define PSD_KEY_SOLD 0x536F4C64u /* SoLd */
+#define PSD_KEY_SOLE 0x536F4C45u /* SoLE */
+#define PSD_KEY_PLLD 0x506C4C64u /* PlLd */
+#define PSD_LINK_EMBEDDED 0x6C694644u /* liFD */
+
+/* First read of an entry header, and the most read for one: headers are a
+ * few hundred bytes plus a small file-open descriptor */
+#define PSD_ENTRY_HEAD_INITIAL ((size_t)4096)
+#define PSD_ENTRY_HEAD_MAX ((size_t)1024 * 1024)
+
+/**
+ * @brief Leading bytes of one entry, read on demand
+ */
+typedef struct {
+    uint8_t *data;
+    size_t length;      /**< Bytes read so far */
+    uint64_t limit;     /**< Bytes in the entry */
+} psd_entry_head_t;
+
+/**
+ * @brief Embedded files found so far (heap, copied to the arena at the end)
+ */
+typedef struct {
+    psd_embedded_file_t *items;
+    uint32_t count;
+    uint32_t capacity;
+} psd_embedded_list_t;
+
+/**
+ * @brief Make the first n bytes of the entry available
+ *
+ * Reads on in growing steps from where the last read stopped.
+ *
+ * @return PSD_OK, PSD_ERR_CORRUPT_DATA if the entry is shorter than n or the
+ *         header would exceed PSD_ENTRY_HEAD_MAX, a stream error, or
+ *         PSD_ERR_OUT_OF_MEMORY
+ */
+static psd_status_t psd_entry_head_need(psd_stream_t *stream, const psd_allocator_t *allocator,
+                                        psd_entry_head_t *head, size_t n)
+{
+    if (n <= head->length) {
+        return PSD_OK;
+    }
+    uint64_t cap = (head->limit < PSD_ENTRY_HEAD_MAX) ? head->limit : PSD_ENTRY_HEAD_MAX;
+    if ((uint64_t)n > cap) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+
+    size_t want = head->length ? head->length * 4 : PSD_ENTRY_HEAD_INITIAL;
+    if (want < n) {
+        want = n;
+    }
+    if ((uint64_t)want > cap) {
+        want = (size_t)cap;
+    }
+    uint8_t *grown = (uint8_t *)psd_alloc_realloc(allocator, head->data, want);
+    if (!grown) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    head->data = grown;
+
+    psd_status_t status = psd_stream_read_exact(stream, head->data + head->length,
+                                                want - head->length);
+    if (status != PSD_OK) {
+        return status;
+    }
+    head->length = want;
+    return PSD_OK;
+}
+
+/**
+ * @brief Append a file to the list
+ */
+static psd_status_t psd_embedded_list_push(const psd_allocator_t *allocator,
+                                           psd_embedded_list_t *list,
+                                           const psd_embedded_file_t *file)
+{
+    if (list->count == list->capacity) {
+        uint32_t capacity = list->capacity ? list->capacity * 2 : 4;
+        psd_embedded_file_t *items = (psd_embedded_file_t *)psd_alloc_realloc(
+            allocator, list->items, (size_t)capacity * sizeof(*items));
+        if (!items) {
+            return PSD_ERR_OUT_OF_MEMORY;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = *file;
+    return PSD_OK;
+}
+
+/**
+ * @brief Read the header of one linked layer entry and record it if embedded
+ *
+ * @param body Stream offset of the entry after its length field
+ * @param length Entry length
+ * @return PSD_OK (also for entries that are skipped), PSD_ERR_OUT_OF_MEMORY,
+ *         or another error that ends the scan
+ */
+static psd_status_t psd_embedded_entry(psd_stream_t *stream, psd_document_t *doc,
+                                       uint64_t body, uint64_t length,
+                                       psd_embedded_list_t *list)
+{
+    if (psd_stream_seek(stream, (int64_t)body) < 0) {
+        return PSD_ERR_STREAM_EOF;
+    }
+
+    psd_entry_head_t head = { NULL, 0, length };
+    psd_status_t status = psd_entry_head_need(stream, doc->allocator, &head, 9);
+    if (status != PSD_OK) {
+        goto done;
+    }
+    uint32_t type = psd_read_be32(head.data);
+    uint32_t version = psd_read_be32(head.data + 4);
+    if (type != PSD_LINK_EMBEDDED || version < 1 || version > 7) {
+        goto done; /* external and alias entries carry no file */
+    }
+
+    /* Unique ID, then the Unicode file name */
+    size_t id_length = head.data[8];
+    size_t p = 9 + id_length;
+    status = psd_entry_head_need(stream, doc->allocator, &head, p + 4);
+    if (status != PSD_OK) {
+        goto done;
+    }
+    uint32_t units = psd_read_be32(head.data + p);
+    if ((uint64_t)units * 2 > length) {
+        status = PSD_ERR_CORRUPT_DATA;
+        goto done;
+    }
+    size_t name_bytes = (size_t)units * 2;
+    status = psd_entry_head_need(stream, doc->allocator, &head, p + 4 + name_bytes + 17);
+    if (status != PSD_OK) {
+        goto done;
+    }
+
+    psd_embedded_file_t file;
+    const psd_allocator_t *meta = &doc->meta.allocator;
+    char *id = (char *)psd_alloc_malloc(meta, id_length + 1);
+    if (!id) {
+        status = PSD_ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+    memcpy(id, head.data + 9, id_length);
+    id[id_length] = '\0';
+    file.unique_id = id;
+
+    /* Names usually end in a NUL code unit */
+    const uint8_t *name = head.data + p + 4;
+    if (name_bytes >= 2 && name[name_bytes - 2] == 0 && name[name_bytes - 1] == 0) {
+        name_bytes -= 2;
+    }
+    file.name = (const char *)psd_utf16be_to_utf8(meta, name, name_bytes, NULL);
+    if (!file.name) {
+        status = PSD_ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+
+    p += 4 + (size_t)units * 2;
+    file.file_type = psd_read_be32(head.data + p);
+    file.length = psd_read_be64(head.data + p + 8);
+    bool has_open_descriptor = head.data[p + 16] != 0;
+    p += 17;
+
+    if (has_open_descriptor) {
+        /* Descriptor version, then a descriptor that has to be walked to
+         * find where it ends; read more whenever it looks truncated */
+        p += 4;
+        for (;;) {
+            status = psd_entry_head_need(stream, doc->allocator, &head, p + 1);
+            if (status != PSD_OK) {
+                goto done;
+            }
+            size_t consumed = 0;
+            psd_descriptor_flat_t *flat = NULL;
+            status = psd_descriptor_flat_parse(head.data + p, head.length - p, doc->allocator,
+                                               doc->allocator, &consumed, &flat);
+            psd_descriptor_flat_free(flat, doc->allocator);
+            if (status == PSD_OK) {
+                p += consumed;
+                break;
+            }
+            if (status != PSD_ERR_CORRUPT_DATA) {
+                goto done;
+            }
+            status = psd_entry_head_need(stream, doc->allocator, &head, head.length + 1);
+            if (status != PSD_OK) {
+                goto done;
+            }
+        }
+    }
+
+    if (file.length == 0 || file.length > length - p) {
+        status = PSD_ERR_CORRUPT_DATA;
+        goto done;
+    }
+    file.offset = body + p;
+    status = psd_embedded_list_push(doc->allocator, list, &file);
+
+done:
+    psd_alloc_free(doc->allocator, head.data);
+    /* A bad entry only costs itself; the next one starts at a known offset */
+    if (status == PSD_ERR_CORRUPT_DATA || status == PSD_ERR_UNSUPPORTED_FEATURE) {
+        return PSD_OK;
+    }
+    return status;
+}
+
+/**
+ * @brief Record the embedded entries of one linked layer block
+ */
+static psd_status_t psd_embedded_block(psd_stream_t *stream, psd_document_t *doc,
+                                       uint64_t start, uint64_t length,
+                                       psd_embedded_list_t *list)
+{
+    uint64_t pos = start;
+    uint64_t end = start + length;
+    while (end - pos >= 8) {
+        if (psd_stream_seek(stream, (int64_t)pos) < 0) {
+            return PSD_ERR_STREAM_EOF;
+        }
+        uint64_t entry_length = 0;
+        psd_status_t status = psd_stream_read_be64(stream, &entry_length);
+        if (status != PSD_OK) {
+            return status;
+        }
+        uint64_t body = pos + 8;
+        if (entry_length > end - body) {
+            return PSD_OK;
+        }
+        status = psd_embedded_entry(stream, doc, body, entry_length, list);
+        if (status != PSD_OK) {
+            return status;
+        }
+        uint64_t padded = (entry_length + 3u) & ~(uint64_t)3u;
+        if (padded > end - body) {
+            break;
+        }
+        pos = body + padded;
+    }
+    return PSD_OK;
+}
+
+/**
+ * @brief Record the embedded files of the global tagged blocks
+ */
+psd_status_t psd_embedded_files_scan(psd_stream_t *stream, psd_document_t *doc, int64_t end)
+{
+    int64_t start = psd_stream_tell(stream);
+    if (start < 0 || start >= end) {
+        return PSD_OK;
+    }
+
+    psd_embedded_list_t list = { NULL, 0, 0 };
+    psd_status_t status = PSD_OK;
+    uint64_t pos = (uint64_t)start;
+    while ((uint64_t)end - pos >= 12) {
+        uint8_t header[16];
+        if (psd_stream_seek(stream, (int64_t)pos) < 0 ||
+            psd_stream_read_exact(stream, header, 12) != PSD_OK) {
+            break;
+        }
+        uint32_t sig = psd_read_be32(header);
+        uint32_t key = psd_read_be32(header + 4);
+        if (sig != PSD_TAG_SIG_8BIM && sig != PSD_TAG_SIG_8B64) {
+            break;
+        }
+        uint64_t payload = pos + 12;
+        uint64_t block_length = psd_read_be32(header + 8);
+        if (doc->is_psb && psd_tagged_key_has_long_length(key)) {
+            if ((uint64_t)end - pos < 16 || psd_stream_read_exact(stream, header + 12, 4) != PSD_OK) {
+                break;
+            }
+            payload = pos + 16;
+            block_length = psd_read_be64(header + 8);
+        }
+        if (block_length > (uint64_t)end - payload) {
+            break;
+        }
+
+        if (key == PSD_KEY_LNK2 || key == PSD_KEY_LNK3 || key == PSD_KEY_LNKD) {
+            status = psd_embedded_block(stream, doc, payload, block_length, &list);
+            if (status == PSD_ERR_OUT_OF_MEMORY) {
+                break;
+            }
+            status = PSD_OK;
+        }
+
+        /* Global blocks are padded to 4 bytes */
+        uint64_t padded = (block_length + 3u) & ~(uint64_t)3u;
+        if (padded > (uint64_t)end - payload) {
+            break;
+        }
+        pos = payload + padded;
+    }
+
+    if (status == PSD_OK && list.count > 0) {
+        size_t bytes = (size_t)list.count * sizeof(*list.items);
+        doc->embedded_files = (psd_embedded_file_t *)psd_alloc_malloc(&doc->meta.allocator, bytes);
+        if (doc->embedded_files) {
+            memcpy(doc->embedded_files, list.items, bytes);
+            doc->embedded_file_count = list.count;
+        } else {
+            status = PSD_ERR_OUT_OF_MEMORY;
+        }
+    }
+    psd_alloc_free(doc->allocator, list.items);
+    return status;
+}
+
+/**
+ * @brief Unique ID a smart object layer refers to
+ *
+ * @return Allocated ID (free with psd_alloc_free(doc->allocator, ...)), or
+ *         NULL if the layer has none; *out_status is set for failures
+ */
+static char *psd_layer_placed_id(psd_document_t *doc, const psd_layer_record_t *layer,
+                                 psd_status_t *out_status)
+{
+    *out_status = PSD_OK;
+
+    /* SoLd/SoLE keep it as 'Idnt' in their descriptor */
+    psd_tagged_block_t *block = psd_tagged_blocks_find(layer, PSD_KEY_SOLD);
+    if (!block) {
+        block = psd_tagged_blocks_find(layer, PSD_KEY_SOLE);
+    }
+    if (block) {
+        const psd_descriptor_flat_t *flat = NULL;
+        if (psd_tagged_block_descriptor(doc, layer, block, &flat) == PSD_OK) {
+            uint32_t node = psd_descriptor_flat_find(flat, 0, "Idnt");
+            if (node != 0) {
+                char *id = psd_descriptor_flat_text(flat, node, doc->allocator, NULL);
+                if (!id) {
+                    *out_status = PSD_ERR_OUT_OF_MEMORY;
+                }
+                return id;
+            }
+        }
+    }
+
+    /* PlLd: 'plcL', version, then the ID as a Pascal string */
+    block = psd_tagged_blocks_find(layer, PSD_KEY_PLLD);
+    if (block && block->length >= 9) {
+        const uint8_t *payload = psd_tagged_block_payload(layer, block);
+        size_t id_length = payload[8];
+        if (id_length <= block->length - 9) {
+            char *id = (char *)psd_alloc_malloc(doc->allocator, id_length + 1);
+            if (!id) {
+                *out_status = PSD_ERR_OUT_OF_MEMORY;
+                return NULL;
+            }
+            memcpy(id, payload + 9, id_length);
+            id[id_length] = '\0';
+            return id;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Get the embedded file a smart object layer shows
+ */
+PSD_API psd_status_t psd_document_get_layer_embedded_file(const psd_document_t *doc,
+                                                          int32_t layer_index,
+                                                          psd_embedded_file_t *out_file)
+{
+    if (!doc || !out_file) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (layer_index < 0 || layer_index >= doc->layers.layer_count) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+    if (doc->embedded_file_count == 0) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    /* Logically const: the placed-layer descriptor is parsed once and cached */
+    psd_status_t status = PSD_OK;
+    char *id = psd_layer_placed_id((psd_document_t *)doc, &doc->layers.layers[layer_index],
+                                   &status);
+    if (!id) {
+        return (status != PSD_OK) ? status : PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    status = PSD_ERR_INVALID_ARGUMENT;
+    for (uint32_t i = 0; i < doc->embedded_file_count; i++) {
+        if (strcmp(doc->embedded_files[i].unique_id, id) == 0) {
+            *out_file = doc->embedded_files[i];
+            status = PSD_OK;
+            break;
+        }
+    }
+    psd_alloc_free(doc->allocator, id);
+    return status;
+}
+
+/**
+ * @brief Open a stream over the embedded file of a smart object layer
+ */
+PSD_API psd_stream_t *psd_document_open_embedded_stream(psd_document_t *doc,
+                                                        int32_t layer_index,
+                                                        psd_status_t *out_status)
+{
+    psd_embedded_file_t file;
+    psd_status_t status = psd_document_get_layer_embedded_file(doc, layer_index, &file);
+    psd_stream_t *stream = NULL;
+
+    if (status == PSD_OK) {
+        /* Prefer the mapping: the view then outlives the document */
+        psd_stream_t *source = doc->stream ? doc->stream : doc->owned_stream;
+        if (doc->mapping) {
+            stream = psd_stream_create_mapping_view(doc->allocator, doc->mapping,
+                                                    doc->mapping_origin + file.offset,
+                                                    file.length);
+        } else if (source) {
+            /* Deferred loads of doc read the same source under its lock */
+            stream = psd_stream_create_locked_substream(source, file.offset, file.length,
+                                                        &doc->load_lock);
+        } else {
+            status = PSD_ERR_STREAM_INVALID;
+        }
+        if (status == PSD_OK && !stream) {
+            status = PSD_ERR_OUT_OF_MEMORY;
+        }
+    }
+
+    if (out_status) {
+        *out_status = status;
+    }
+    return stream;
+}
+
+/**
+ * @brief Parse the PSD/PSB file embedded in a smart object layer
+ */
+PSD_API psd_document_t *psd_document_open_embedded(psd_document_t *doc,
+                                                   int32_t layer_index,
+                                                   const psd_parse_options_t *options,
+                                                   psd_status_t *out_status)
+{
+    psd_status_t status = PSD_OK;
+    psd_stream_t *stream = psd_document_open_embedded_stream(doc, layer_index, &status);
+    psd_document_t *nested = NULL;
+
+    if (stream) {
+        const psd_parse_options_t lazy = {
+            PSD_PARSE_SKIP_LAYER_PIXELS | PSD_PARSE_SKIP_COMPOSITE, NULL
+        };
+        nested = psd_parse_with_options(stream, doc->allocator, options ? options : &lazy,
+                                        &status);
+        if (nested) {
+            nested->owned_stream = stream;
+        } else {
+            psd_stream_destroy(stream);
+        }
+    }
+
+    if (out_status) {
+        *out_status = status;
+    }
+    return nested;
+}
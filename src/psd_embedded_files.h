@@ -0,0 +1,48 @@
+/**
+ * @file psd_embedded_files.h
+ * @brief Files embedded for smart object layers
+ *
+ * The linked layer blocks at the end of the layer and mask section ('lnk2',
+ * 'lnkD', 'lnk3') carry the files smart objects are placed from. Only the
+ * entry headers are read while parsing; each embedded file is recorded as a
+ * byte range of the source, so nested documents can be parsed through a
+ * sub-stream without copying them.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_EMBEDDED_FILES_H
+#define PSD_EMBEDDED_FILES_H
+
+#include <stdint.h>
+#include "../include/openpsd/psd.h"
+#include "../include/openpsd/psd_error.h"
+#include "../include/openpsd/psd_export.h"
+#include "../include/openpsd/psd_stream.h"
+
+/**
+ * @brief Record the embedded files of the global tagged blocks
+ *
+ * Walks the blocks from the current stream position up to end, seeking over
+ * payloads. Entries are kept in doc->embedded_files (metadata arena). Stops
+ * quietly at the first block or entry that does not parse, keeping what was
+ * found before it.
+ *
+ * @param stream Stream positioned at the first global tagged block
+ * @param doc Document being parsed
+ * @param end Stream offset where the layer and mask section ends
+ * @return PSD_OK, or PSD_ERR_OUT_OF_MEMORY
+ */
+PSD_INTERNAL psd_status_t psd_embedded_files_scan(psd_stream_t *stream,
+                                                  psd_document_t *doc,
+                                                  int64_t end);
+
+#endif /* PSD_EMBEDDED_FILES_H */
@@ -0,0 +1,429 @@
+/**
+ * @file psd_engine_data.c
+ * @brief One-pass EngineData tokenizer and tree lookups
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_engine_data.h"
+#include "psd_unicode.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Real EngineData nests about ten levels deep; anything far beyond is hostile */
+#define PSD_ENGINE_MAX_DEPTH 256
+
+/* Longest numeric token worth converting */
+#define PSD_ENGINE_NUMBER_MAX 64
+
+/* Open container while tokenizing */
+typedef struct {
+    uint32_t node;          /* Container node index */
+    uint32_t last;          /* Last child so far, 0 if none */
+    const char *key;        /* Pending member key (dicts), NULL if none */
+    uint32_t key_length;
+} engine_frame_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    size_t pos;
+    const psd_allocator_t *allocator;
+    const psd_allocator_t *scratch;
+    psd_engine_node_t *nodes;
+    uint32_t count;
+    uint32_t capacity;
+    uint8_t *unescaped;     /* Scratch for one string, sized to the whole input */
+} engine_parser_t;
+
+static bool engine_is_space(uint8_t c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\0';
+}
+
+static bool engine_is_delimiter(uint8_t c)
+{
+    return engine_is_space(c) || c == '(' || c == ')' || c == '<' || c == '>' ||
+           c == '[' || c == ']' || c == '{' || c == '}' || c == '/' || c == '%';
+}
+
+/* Free the decoded strings of the first count nodes */
+static void engine_free_strings(psd_engine_node_t *nodes, uint32_t count,
+                                const psd_allocator_t *allocator)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        if (nodes[i].type == PSD_ENGINE_STRING && nodes[i].string) {
+            psd_alloc_free(allocator, (void *)nodes[i].string);
+        }
+    }
+}
+
+/* Append a node to the open container, taking its pending key */
+static psd_status_t engine_add(engine_parser_t *p, engine_frame_t *frame,
+                               psd_engine_node_type_t type, uint32_t *out_index)
+{
+    if (p->count == UINT32_MAX) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+    if (p->count == p->capacity) {
+        uint32_t capacity = p->capacity ? p->capacity * 2u : 256u;
+        if (capacity < p->capacity) {
+            capacity = UINT32_MAX;
+        }
+        psd_engine_node_t *nodes = (psd_engine_node_t *)psd_alloc_realloc(
+            p->scratch, p->nodes, (size_t)capacity * sizeof(psd_engine_node_t));
+        if (!nodes) {
+            return PSD_ERR_OUT_OF_MEMORY;
+        }
+        p->nodes = nodes;
+        p->capacity = capacity;
+    }
+
+    uint32_t index = p->count++;
+    psd_engine_node_t *node = &p->nodes[index];
+    memset(node, 0, sizeof(*node));
+    node->type = type;
+    node->key = frame->key;
+    node->key_length = frame->key_length;
+    frame->key = NULL;
+    frame->key_length = 0;
+
+    if (frame->last) {
+        p->nodes[frame->last].next = index;
+    } else {
+        p->nodes[frame->node].first_child = index;
+    }
+    frame->last = index;
+    p->nodes[frame->node].child_count++;
+
+    *out_index = index;
+    return PSD_OK;
+}
+
+/* Read a (string) starting at '(' and decode it into allocator memory */
+static psd_status_t engine_read_string(engine_parser_t *p, psd_engine_node_t *node)
+{
+    size_t out = 0;
+    int depth = 1;
+    p->pos++;
+    while (p->pos < p->length) {
+        uint8_t c = p->data[p->pos++];
+        if (c == '\\') {
+            if (p->pos >= p->length) {
+                break;
+            }
+            p->unescaped[out++] = p->data[p->pos++];
+            continue;
+        }
+        if (c == '(') {
+            depth++;
+        } else if (c == ')' && --depth == 0) {
+            break;
+        }
+        p->unescaped[out++] = c;
+    }
+    if (depth != 0) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+
+    const uint8_t *bytes = p->unescaped;
+    uint8_t *text = NULL;
+    size_t text_length = 0;
+    if (out >= 2 && bytes[0] == 0xFE && bytes[1] == 0xFF) {
+        text = psd_utf16be_to_utf8(p->allocator, bytes + 2, out - 2, &text_length);
+    } else if (out >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE) {
+        /* Little-endian: swap in place (the BOM is no longer needed) */
+        uint8_t *units = p->unescaped + 2;
+        size_t unit_bytes = (out - 2) & ~(size_t)1;
+        for (size_t i = 0; i < unit_bytes; i += 2) {
+            uint8_t lo = units[i];
+            units[i] = units[i + 1];
+            units[i + 1] = lo;
+        }
+        text = psd_utf16be_to_utf8(p->allocator, units, unit_bytes, &text_length);
+    } else {
+        text = (uint8_t *)psd_alloc_malloc(p->allocator, out + 1);
+        if (text) {
+            memcpy(text, bytes, out);
+            text[out] = '\0';
+            text_length = out;
+        }
+    }
+    if (!text) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    if (text_length > UINT32_MAX) {
+        psd_alloc_free(p->allocator, text);
+        return PSD_ERR_CORRUPT_DATA;
+    }
+
+    node->string = (const char *)text;
+    node->string_length = (uint32_t)text_length;
+    return PSD_OK;
+}
+
+static psd_status_t engine_tokenize(engine_parser_t *p, engine_frame_t *stack)
+{
+    uint32_t depth = 0;
+    stack[0].node = 0;
+    stack[0].last = 0;
+    stack[0].key = NULL;
+    stack[0].key_length = 0;
+
+    while (p->pos < p->length) {
+        uint8_t c = p->data[p->pos];
+        engine_frame_t *frame = &stack[depth];
+        uint32_t index = 0;
+        psd_status_t status = PSD_OK;
+
+        if (engine_is_space(c)) {
+            p->pos++;
+            continue;
+        }
+
+        bool open_dict = c == '<' && p->pos + 1 < p->length && p->data[p->pos + 1] == '<';
+        bool close_dict = c == '>' && p->pos + 1 < p->length && p->data[p->pos + 1] == '>';
+
+        if (open_dict || c == '[') {
+            if (depth + 1 >= PSD_ENGINE_MAX_DEPTH) {
+                return PSD_ERR_CORRUPT_DATA;
+            }
+            status = engine_add(p, frame, open_dict ? PSD_ENGINE_DICT : PSD_ENGINE_ARRAY, &index);
+            if (status != PSD_OK) {
+                return status;
+            }
+            p->pos += open_dict ? 2 : 1;
+            depth++;
+            stack[depth].node = index;
+            stack[depth].last = 0;
+            stack[depth].key = NULL;
+            stack[depth].key_length = 0;
+        } else if (close_dict || c == ']') {
+            psd_engine_node_type_t expect = close_dict ? PSD_ENGINE_DICT : PSD_ENGINE_ARRAY;
+            if (depth == 0 || p->nodes[frame->node].type != expect) {
+                return PSD_ERR_CORRUPT_DATA;
+            }
+            p->pos += close_dict ? 2 : 1;
+            depth--;
+        } else if (c == '/') {
+            size_t start = ++p->pos;
+            while (p->pos < p->length && !engine_is_delimiter(p->data[p->pos])) {
+                p->pos++;
+            }
+            const char *name = (const char *)p->data + start;
+            uint32_t name_length = (uint32_t)(p->pos - start);
+
+            /* In a dict a name is a key unless one is already waiting for its value */
+            if (p->nodes[frame->node].type == PSD_ENGINE_DICT && !frame->key) {
+                frame->key = name;
+                frame->key_length = name_length;
+                continue;
+            }
+            status = engine_add(p, frame, PSD_ENGINE_NAME, &index);
+            if (status != PSD_OK) {
+                return status;
+            }
+            p->nodes[index].string = name;
+            p->nodes[index].string_length = name_length;
+        } else if (c == '(') {
+            status = engine_add(p, frame, PSD_ENGINE_STRING, &index);
+            if (status == PSD_OK) {
+                status = engine_read_string(p, &p->nodes[index]);
+            }
+            if (status != PSD_OK) {
+                return status;
+            }
+        } else if (engine_is_delimiter(c)) {
+            /* Stray ')', single '<' or '>', braces, comments: not produced by Photoshop */
+            p->pos++;
+        } else {
+            size_t start = p->pos;
+            while (p->pos < p->length && !engine_is_delimiter(p->data[p->pos])) {
+                p->pos++;
+            }
+            const char *word = (const char *)p->data + start;
+            size_t word_length = p->pos - start;
+
+            if (c == '-' || c == '+' || c == '.' || (c >= '0' && c <= '9')) {
+                char number[PSD_ENGINE_NUMBER_MAX];
+                size_t copy = word_length < sizeof(number) - 1 ? word_length : sizeof(number) - 1;
+                memcpy(number, word, copy);
+                number[copy] = '\0';
+                status = engine_add(p, frame, PSD_ENGINE_NUMBER, &index);
+                if (status != PSD_OK) {
+                    return status;
+                }
+                p->nodes[index].number = strtod(number, NULL);
+            } else {
+                bool is_true = word_length == 4 && memcmp(word, "true", 4) == 0;
+                bool is_false = word_length == 5 && memcmp(word, "false", 5) == 0;
+                status = engine_add(p, frame,
+                                    (is_true || is_false) ? PSD_ENGINE_BOOL : PSD_ENGINE_NULL,
+                                    &index);
+                if (status != PSD_OK) {
+                    return status;
+                }
+                p->nodes[index].number = is_true ? 1.0 : 0.0;
+            }
+        }
+    }
+
+    return depth == 0 ? PSD_OK : PSD_ERR_CORRUPT_DATA;
+}
+
+psd_status_t psd_engine_data_parse(const uint8_t *data,
+                                   size_t length,
+                                   const psd_allocator_t *allocator,
+                                   const psd_allocator_t *scratch,
+                                   psd_engine_data_t **out_tree)
+{
+    if (!data || !out_tree) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    *out_tree = NULL;
+
+    engine_parser_t p;
+    memset(&p, 0, sizeof(p));
+    p.data = data;
+    p.length = length;
+    p.allocator = allocator;
+    p.scratch = scratch;
+
+    engine_frame_t *stack = (engine_frame_t *)psd_alloc_malloc(
+        scratch, PSD_ENGINE_MAX_DEPTH * sizeof(engine_frame_t));
+    p.unescaped = (uint8_t *)psd_alloc_malloc(scratch, length ? length : 1);
+    p.nodes = (psd_engine_node_t *)psd_alloc_malloc(scratch, 256 * sizeof(psd_engine_node_t));
+    psd_status_t status = (stack && p.unescaped && p.nodes) ? PSD_OK : PSD_ERR_OUT_OF_MEMORY;
+
+    if (status == PSD_OK) {
+        /* Root array */
+        memset(&p.nodes[0], 0, sizeof(p.nodes[0]));
+        p.nodes[0].type = PSD_ENGINE_ARRAY;
+        p.count = 1;
+        p.capacity = 256;
+        status = engine_tokenize(&p, stack);
+    }
+
+    psd_engine_data_t *tree = NULL;
+    if (status == PSD_OK) {
+        tree = (psd_engine_data_t *)psd_alloc_malloc(allocator, sizeof(*tree));
+        psd_engine_node_t *nodes = (psd_engine_node_t *)psd_alloc_malloc(
+            allocator, (size_t)p.count * sizeof(psd_engine_node_t));
+        if (tree && nodes) {
+            memcpy(nodes, p.nodes, (size_t)p.count * sizeof(psd_engine_node_t));
+            tree->nodes = nodes;
+            tree->count = p.count;
+        } else {
+            psd_alloc_free(allocator, nodes);
+            psd_alloc_free(allocator, tree);
+            tree = NULL;
+            status = PSD_ERR_OUT_OF_MEMORY;
+        }
+    }
+    if (status != PSD_OK && p.nodes) {
+        engine_free_strings(p.nodes, p.count, allocator);
+    }
+
+    psd_alloc_free(scratch, p.nodes);
+    psd_alloc_free(scratch, p.unescaped);
+    psd_alloc_free(scratch, stack);
+
+    *out_tree = tree;
+    return status;
+}
+
+void psd_engine_data_free(psd_engine_data_t *tree, const psd_allocator_t *allocator)
+{
+    if (!tree) {
+        return;
+    }
+    engine_free_strings(tree->nodes, tree->count, allocator);
+    psd_alloc_free(allocator, tree->nodes);
+    psd_alloc_free(allocator, tree);
+}
+
+const psd_engine_node_t *psd_engine_data_get(const psd_engine_data_t *tree,
+                                             const psd_engine_node_t *dict,
+                                             const char *key)
+{
+    if (!tree || !dict || !key || dict->type != PSD_ENGINE_DICT) {
+        return NULL;
+    }
+    size_t key_length = strlen(key);
+    for (uint32_t i = dict->first_child; i != 0; i = tree->nodes[i].next) {
+        const psd_engine_node_t *member = &tree->nodes[i];
+        if (member->key && member->key_length == key_length &&
+            memcmp(member->key, key, key_length) == 0) {
+            return member;
+        }
+    }
+    return NULL;
+}
+
+const psd_engine_node_t *psd_engine_data_path(const psd_engine_data_t *tree,
+                                              const psd_engine_node_t *node,
+                                              const char *path)
+{
+    char key[64];
+    while (node && path && *path) {
+        const char *end = strchr(path, '/');
+        size_t length = end ? (size_t)(end - path) : strlen(path);
+        if (length >= sizeof(key)) {
+            return NULL;
+        }
+        memcpy(key, path, length);
+        key[length] = '\0';
+        node = psd_engine_data_get(tree, node, key);
+        path = end ? end + 1 : NULL;
+    }
+    return node;
+}
+
+const psd_engine_node_t *psd_engine_data_item(const psd_engine_data_t *tree,
+                                              const psd_engine_node_t *array,
+                                              uint32_t index)
+{
+    if (!tree || !array || array->type != PSD_ENGINE_ARRAY || index >= array->child_count) {
+        return NULL;
+    }
+    uint32_t i = array->first_child;
+    while (index-- > 0) {
+        i = tree->nodes[i].next;
+    }
+    return &tree->nodes[i];
+}
+
+const psd_engine_node_t *psd_engine_data_root(const psd_engine_data_t *tree)
+{
+    if (!tree || tree->count == 0) {
+        return NULL;
+    }
+    for (uint32_t i = tree->nodes[0].first_child; i != 0; i = tree->nodes[i].next) {
+        if (tree->nodes[i].type == PSD_ENGINE_DICT) {
+            return &tree->nodes[i];
+        }
+    }
+    return NULL;
+}
+
+bool psd_engine_data_number(const psd_engine_data_t *tree,
+                            const psd_engine_node_t *dict,
+                            const char *key,
+                            double *out_value)
+{
+    const psd_engine_node_t *member = psd_engine_data_get(tree, dict, key);
+    if (!member || (member->type != PSD_ENGINE_NUMBER && member->type != PSD_ENGINE_BOOL)) {
+        return false;
+    }
+    *out_value = member->number;
+    return true;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file psd_engine_data.h
+ * @brief Parsed tree of a text layer's EngineData
+ *
+ * EngineData is the PostScript-like dictionary that Photoshop embeds in a
+ * text layer's 'TySh' descriptor: << dicts >>, [ arrays ], /Names,
+ * (strings), numbers and booleans. It is tokenized once into a flat array of
+ * nodes linked by index, and every text accessor then walks that tree instead
+ * of rescanning the source bytes.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_ENGINE_DATA_H
+#define PSD_ENGINE_DATA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "psd_alloc.h"
+#include "../include/openpsd/psd_error.h"
+#include "../include/openpsd/psd_export.h"
+
+/**
+ * @brief EngineData value kinds
+ */
+typedef enum {
+    PSD_ENGINE_NULL = 0,   /**< Bare word other than true/false */
+    PSD_ENGINE_DICT,       /**< << /Key value ... >> */
+    PSD_ENGINE_ARRAY,      /**< [ value ... ] */
+    PSD_ENGINE_STRING,     /**< (string), decoded to UTF-8 */
+    PSD_ENGINE_NUMBER,     /**< Integer or real */
+    PSD_ENGINE_BOOL,       /**< true / false (number is 1 or 0) */
+    PSD_ENGINE_NAME        /**< /Name used as a value */
+} psd_engine_node_type_t;
+
+/**
+ * @brief One value in the tree
+ *
+ * Children of a dict or array are chained through next; index 0 is the
+ * synthetic root array holding the top-level values, so 0 also means "none"
+ * in first_child and next.
+ */
+typedef struct {
+    psd_engine_node_type_t type;
+    const char *key;          /**< Member key without the '/' (into the source), or NULL */
+    uint32_t key_length;
+    uint32_t first_child;     /**< First member or item, 0 if empty */
+    uint32_t next;            /**< Next sibling, 0 if last */
+    uint32_t child_count;
+    double number;            /**< NUMBER value; BOOL as 1 or 0 */
+    const char *string;       /**< STRING as NUL-terminated UTF-8 (owned), NAME into the source */
+    uint32_t string_length;
+} psd_engine_node_t;
+
+/**
+ * @brief Parsed EngineData
+ */
+typedef struct {
+    psd_engine_node_t *nodes;   /**< nodes[0] is the root array */
+    uint32_t count;
+} psd_engine_data_t;
+
+/**
+ * @brief Tokenize EngineData into a tree in one pass
+ *
+ * Keys and name values point into the source, which must outlive the tree.
+ * Strings are unescaped and decoded (UTF-16 with a byte order mark, otherwise
+ * bytes as-is) into allocator memory.
+ *
+ * @param data EngineData bytes
+ * @param length Length of the data in bytes
+ * @param allocator Owner of the finished tree
+ * @param scratch Allocator for temporary buffers while parsing
+ * @param out_tree Receives the tree on success
+ * @return PSD_OK, PSD_ERR_CORRUPT_DATA for unbalanced or over-nested input,
+ *         or PSD_ERR_OUT_OF_MEMORY
+ */
+PSD_INTERNAL psd_status_t psd_engine_data_parse(const uint8_t *data,
+                                                size_t length,
+                                                const psd_allocator_t *allocator,
+                                                const psd_allocator_t *scratch,
+                                                psd_engine_data_t **out_tree);
+
+/**
+ * @brief Free a tree returned by psd_engine_data_parse()
+ */
+PSD_INTERNAL void psd_engine_data_free(psd_engine_data_t *tree, const psd_allocator_t *allocator);
+
+/**
+ * @brief Member of a dict by key, or NULL
+ */
+PSD_INTERNAL const psd_engine_node_t *psd_engine_data_get(const psd_engine_data_t *tree,
+                                                          const psd_engine_node_t *dict,
+                                                          const char *key);
+
+/**
+ * @brief Walk a '/'-separated chain of dict keys ("EngineDict/StyleRun/RunArray")
+ *
+ * @return The node at the end of the path, or NULL if any step is missing
+ */
+PSD_INTERNAL const psd_engine_node_t *psd_engine_data_path(const psd_engine_data_t *tree,
+                                                           const psd_engine_node_t *node,
+                                                           const char *path);
+
+/**
+ * @brief Item of an array by position, or NULL
+ */
+PSD_INTERNAL const psd_engine_node_t *psd_engine_data_item(const psd_engine_data_t *tree,
+                                                           const psd_engine_node_t *array,
+                                                           uint32_t index);
+
+/**
+ * @brief First top-level dict, or NULL
+ */
+PSD_INTERNAL const psd_engine_node_t *psd_engine_data_root(const psd_engine_data_t *tree);
+
+/**
+ * @brief Read a numeric or boolean member of a dict
+ *
+ * @return true if the member exists and is a NUMBER or BOOL
+ */
+PSD_INTERNAL bool psd_engine_data_number(const psd_engine_data_t *tree,
+                                         const psd_engine_node_t *dict,
+                                         const char *key,
+                                         double *out_value);
+
+#endif /* PSD_ENGINE_DATA_H */
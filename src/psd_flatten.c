@@ -0,0 +1,396 @@
+/**
+ * @file psd_flatten.c
+ * @brief Layer compositing (RGBA8)
+ *
+ * Builds a flattened image from the layer records instead of the stored
+ * composite: layers are blended bottom-up with their blend mode, opacity,
+ * visibility, clipping and group nesting. Rows come from the region renders
+ * in psd_render.c, so only the layer rows under the requested rect are decoded
+ * and layers outside it are never touched.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "psd_alloc.h"
+#include "psd_blend.h"
+#include "psd_context.h"
+#include "psd_flatten.h"
+#include "psd_layer_content.h"
+#include "psd_stream_internal.h"
+
+#include <limits.h>
+#include <string.h>
+
+/* Layer record flags bit 1: Photoshop sets it on hidden layers */
+#define PSD_LAYER_FLAG_HIDDEN 0x02u
+
+/* Where the rendered rows of one layer go */
+typedef struct {
+    uint8_t *target;          /* Premultiplied RGBA8 buffer of the region */
+    size_t stride;            /* Bytes per target row */
+    uint32_t x_off;           /* First target column of the layer rows */
+    uint32_t y_off;           /* First target row of the layer rows */
+    psd_blend_mode_t mode;
+    uint8_t opacity;
+    bool atop;                /* Source-atop, for layers clipped to a base */
+    uint8_t *row;             /* Premultiplied scratch row */
+    uint8_t *alpha;           /* Scratch for psd_blend_row_atop() */
+} flatten_row_t;
+
+static psd_status_t flatten_row_cb(void *user_data, uint32_t y, const uint8_t *rgba,
+                                   uint32_t width)
+{
+    flatten_row_t *r = (flatten_row_t *)user_data;
+    uint8_t *dst = r->target + (size_t)(r->y_off + y) * r->stride + (size_t)r->x_off * 4u;
+
+    psd_blend_premultiply_row(r->row, rgba, width, r->opacity);
+    if (r->atop) {
+        psd_blend_row_atop(r->mode, dst, r->row, width, r->alpha);
+    } else {
+        psd_blend_row(r->mode, dst, r->row, width);
+    }
+    return PSD_OK;
+}
+
+static bool layer_hidden(const psd_layer_record_t *layer)
+{
+    return (layer->flags & PSD_LAYER_FLAG_HIDDEN) != 0;
+}
+
+static bool layer_is_section(const psd_layer_record_t *layer)
+{
+    return layer->features.is_group_start || layer->features.is_group_end;
+}
+
+/* Intersect a layer's bounds with the region; false when they miss */
+static bool layer_clip(const psd_flatten_t *f, const psd_layer_record_t *layer, psd_rect_t *out)
+{
+    const psd_layer_bounds_t *b = &layer->bounds;
+    out->top = b->top > f->region.top ? b->top : f->region.top;
+    out->left = b->left > f->region.left ? b->left : f->region.left;
+    out->bottom = b->bottom < f->region.bottom ? b->bottom : f->region.bottom;
+    out->right = b->right < f->region.right ? b->right : f->region.right;
+    return out->top < out->bottom && out->left < out->right;
+}
+
+/* Blend the part of a layer inside the region onto target. Transparent
+ * pixels leave the target unchanged in every mode, so only the layer's
+ * content bounds are rendered, minus its empty rows. */
+static psd_status_t flatten_layer(psd_flatten_t *f, int32_t index, uint8_t *target,
+                                  psd_blend_mode_t mode, uint8_t opacity, bool atop)
+{
+    const psd_layer_record_t *layer = &f->doc->layers.layers[index];
+    psd_rect_t hit;
+    if (layer->channel_count == 0 || !layer_clip(f, layer, &hit)) {
+        return PSD_OK;
+    }
+
+    /* Without content bounds (bad alpha data) the render reports the error */
+    const psd_layer_content_t *content = NULL;
+    if (psd_layer_content_get(f->doc, index, &content) == PSD_OK) {
+        const psd_layer_bounds_t *c = &content->bounds;
+        if (c->top > hit.top) hit.top = c->top;
+        if (c->left > hit.left) hit.left = c->left;
+        if (c->bottom < hit.bottom) hit.bottom = c->bottom;
+        if (c->right < hit.right) hit.right = c->right;
+        if (hit.top >= hit.bottom || hit.left >= hit.right) {
+            return PSD_OK;
+        }
+    }
+
+    psd_rect_t local = {
+        hit.top - layer->bounds.top, hit.left - layer->bounds.left,
+        hit.bottom - layer->bounds.top, hit.right - layer->bounds.left
+    };
+    flatten_row_t r = {
+        target, f->stride,
+        (uint32_t)(hit.left - f->region.left), (uint32_t)(hit.top - f->region.top),
+        mode, opacity, atop, f->row, f->alpha
+    };
+    return psd_render_layer_content_rows(f->doc, index, &local,
+                                         content ? content->empty_rows : NULL,
+                                         flatten_row_cb, &r);
+}
+
+/* Blend src onto dst over the part of the region a layer covers */
+static void flatten_merge(psd_flatten_t *f, uint8_t *dst, uint8_t *src, const psd_rect_t *hit,
+                          psd_blend_mode_t mode, uint8_t opacity)
+{
+    size_t x = (size_t)(hit->left - f->region.left) * 4u;
+    size_t count = (size_t)(hit->right - hit->left);
+    for (int32_t y = hit->top; y < hit->bottom; y++) {
+        size_t offset = (size_t)(y - f->region.top) * f->stride + x;
+        psd_blend_scale_row(src + offset, count, opacity);
+        psd_blend_row(mode, dst + offset, src + offset, count);
+    }
+}
+
+/* Match each divider (group end, which comes first bottom-up) with its
+ * folder record; unmatched section records get -1 */
+static psd_status_t flatten_match_groups(psd_document_t *doc, int32_t *match, int32_t *max_depth)
+{
+    const int32_t count = doc->layers.layer_count;
+    int32_t *stack = (int32_t *)psd_alloc_malloc(doc->allocator, (size_t)count * sizeof(int32_t));
+    if (!stack) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+
+    int32_t depth = 0;
+    *max_depth = 0;
+    for (int32_t i = 0; i < count; i++) {
+        const psd_layer_record_t *layer = &doc->layers.layers[i];
+        match[i] = -1;
+        if (layer->features.is_group_end) {
+            stack[depth++] = i;
+            if (depth > *max_depth) *max_depth = depth;
+        } else if (layer->features.is_group_start && depth > 0) {
+            int32_t open = stack[--depth];
+            match[open] = i;
+            match[i] = open;
+        }
+    }
+    /* Dividers never closed stay unmatched */
+    while (depth > 0) {
+        match[stack[--depth]] = -1;
+    }
+
+    psd_alloc_free(doc->allocator, stack);
+    return PSD_OK;
+}
+
+/* End of the clipping run a pixel layer starts (just past it when none) */
+static int32_t clip_run_end(const psd_flatten_t *f, int32_t i)
+{
+    const psd_layer_record_t *layers = f->doc->layers.layers;
+    const int32_t count = f->doc->layers.layer_count;
+    int32_t end = i + 1;
+    if (!layers[i].clipping) {
+        while (end < count && layers[end].clipping && !layer_is_section(&layers[end])) {
+            end++;
+        }
+    }
+    return end;
+}
+
+psd_status_t psd_flatten_init(psd_flatten_t *f, psd_document_t *doc,
+                              uint32_t max_width, uint32_t max_height)
+{
+    memset(f, 0, sizeof(*f));
+    f->doc = doc;
+
+    uint64_t plane64 = (uint64_t)max_width * 4u * max_height;
+    if (plane64 > (uint64_t)SIZE_MAX / 4u) return PSD_ERR_OUT_OF_RANGE;
+    const size_t plane = (size_t)plane64;
+
+    const int32_t count = doc->layers.layer_count;
+    int32_t max_depth = 0;
+    if (count > 0) {
+        f->match = (int32_t *)psd_alloc_malloc(doc->allocator,
+                                               (size_t)count * 2u * sizeof(int32_t));
+        if (!f->match) return PSD_ERR_OUT_OF_MEMORY;
+        f->wanted = f->match + count;
+        psd_status_t st = flatten_match_groups(doc, f->match, &max_depth);
+        if (st != PSD_OK) {
+            psd_flatten_release(f);
+            return st;
+        }
+    }
+
+    /* Level buffers, the clip buffer and two scratch rows */
+    const size_t level_count = (size_t)max_depth + 1u;
+    const uint64_t bytes = (uint64_t)plane * (level_count + 1u) + (uint64_t)max_width * 5u;
+    if (bytes > (uint64_t)SIZE_MAX) {
+        psd_flatten_release(f);
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+    f->levels = (uint8_t **)psd_alloc_malloc(doc->allocator, level_count * sizeof(uint8_t *));
+    f->block = (uint8_t *)psd_alloc_malloc(doc->allocator, bytes ? (size_t)bytes : 1u);
+    if (!f->levels || !f->block) {
+        psd_flatten_release(f);
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+
+    for (size_t l = 0; l < level_count; l++) {
+        f->levels[l] = f->block + plane * l;
+    }
+    f->clip = f->block + plane * level_count;
+    f->row = f->clip + plane;
+    f->alpha = f->row + (size_t)max_width * 4u;
+    return PSD_OK;
+}
+
+void psd_flatten_release(psd_flatten_t *f)
+{
+    if (!f->doc) return;
+    psd_alloc_free(f->doc->allocator, f->block);
+    psd_alloc_free(f->doc->allocator, f->levels);
+    psd_alloc_free(f->doc->allocator, f->match);
+    f->block = NULL;
+    f->levels = NULL;
+    f->match = NULL;
+    f->wanted = NULL;
+}
+
+void psd_flatten_set_region(psd_flatten_t *f, const psd_rect_t *region)
+{
+    f->region = *region;
+    f->width = (uint32_t)(region->right - region->left);
+    f->height = (uint32_t)(region->bottom - region->top);
+    f->stride = (size_t)f->width * 4u;
+}
+
+int32_t psd_flatten_unit_end(const psd_flatten_t *f, int32_t first)
+{
+    const psd_layer_record_t *layer = &f->doc->layers.layers[first];
+    if (layer->features.is_group_end) {
+        return f->match[first] >= 0 ? f->match[first] + 1 : first + 1;
+    }
+    if (layer->features.is_group_start) {
+        return first + 1;
+    }
+    return clip_run_end(f, first);
+}
+
+psd_status_t psd_flatten_layers(psd_flatten_t *f, int32_t first, int32_t end)
+{
+    const psd_layer_record_t *layers = f->doc->layers.layers;
+    const int32_t *match = f->match;
+    const size_t plane = f->stride * f->height;
+    int32_t level = 0;
+    psd_status_t st = PSD_OK;
+
+    /* One batched read hint for the deferred layers this region touches */
+    if (psd_stream_has_prefetch(f->doc->stream)) {
+        size_t wanted = 0;
+        for (int32_t j = first; j < end; j++) {
+            psd_rect_t hit;
+            if (!layer_hidden(&layers[j]) && !layer_is_section(&layers[j]) &&
+                layer_clip(f, &layers[j], &hit)) {
+                f->wanted[wanted++] = j;
+            }
+        }
+        (void)psd_document_prefetch_layers(f->doc, f->wanted, wanted);
+    }
+
+    int32_t i = first;
+    while (i < end && st == PSD_OK) {
+        const psd_layer_record_t *layer = &layers[i];
+        psd_blend_mode_t mode = psd_blend_mode_from_key(layer->blend_key);
+
+        if (layer->features.is_group_end) {
+            int32_t folder = match[i];
+            if (folder >= 0 && layer_hidden(&layers[folder])) {
+                i = folder + 1;
+                continue;
+            }
+            if (folder >= 0) {
+                /* Pass-through groups blend their layers straight onto what
+                 * is below, then fade toward it by the group opacity */
+                level++;
+                if (psd_blend_mode_from_key(layers[folder].blend_key) == PSD_BLEND_PASS_THROUGH) {
+                    memcpy(f->levels[level], f->levels[level - 1], plane);
+                } else {
+                    memset(f->levels[level], 0, plane);
+                }
+            }
+            i++;
+            continue;
+        }
+
+        if (layer->features.is_group_start) {
+            if (match[i] >= 0) {
+                uint8_t *group = f->levels[level--];
+                uint8_t *below = f->levels[level];
+                if (mode == PSD_BLEND_PASS_THROUGH) {
+                    psd_blend_lerp_row(below, group, plane / 4u, layer->opacity);
+                } else {
+                    psd_rect_t all = f->region;
+                    flatten_merge(f, below, group, &all, mode, layer->opacity);
+                }
+            }
+            i++;
+            continue;
+        }
+
+        /* Pixel layer and the layers clipped to it */
+        int32_t run_end = clip_run_end(f, i);
+        if (layer_hidden(layer)) {
+            i = run_end;
+            continue;
+        }
+
+        psd_rect_t hit;
+        if (run_end == i + 1) {
+            st = flatten_layer(f, i, f->levels[level], mode, layer->opacity, false);
+        } else if (layer_clip(f, layer, &hit)) {
+            /* Clipped layers show only where the base is: composite them
+             * atop the base at full strength, then apply the base's mode and
+             * opacity to the result */
+            memset(f->clip, 0, plane);
+            st = flatten_layer(f, i, f->clip, PSD_BLEND_NORMAL, 255, false);
+            for (int32_t j = i + 1; j < run_end && st == PSD_OK; j++) {
+                if (layer_hidden(&layers[j])) continue;
+                st = flatten_layer(f, j, f->clip, psd_blend_mode_from_key(layers[j].blend_key),
+                                   layers[j].opacity, true);
+            }
+            if (st == PSD_OK) {
+                flatten_merge(f, f->levels[level], f->clip, &hit, mode, layer->opacity);
+            }
+        }
+        i = run_end;
+    }
+    return st;
+}
+
+/**
+ * @brief Composite the document's layers into RGBA8
+ */
+PSD_API psd_status_t psd_document_flatten_rgba8(
+    psd_document_t *doc,
+    const psd_rect_t *rect,
+    uint8_t *out_rgba,
+    size_t out_stride)
+{
+    if (!doc || !out_rgba) return PSD_ERR_NULL_POINTER;
+
+    psd_rect_t region = { 0, 0, (int32_t)doc->height, (int32_t)doc->width };
+    if (rect) {
+        if (rect->top < 0 || rect->left < 0 ||
+            rect->bottom < rect->top || rect->right < rect->left ||
+            (uint32_t)rect->bottom > doc->height || (uint32_t)rect->right > doc->width) {
+            return PSD_ERR_OUT_OF_RANGE;
+        }
+        region = *rect;
+    }
+    uint32_t width = (uint32_t)(region.right - region.left);
+    uint32_t height = (uint32_t)(region.bottom - region.top);
+    if (out_stride < (size_t)width * 4u) return PSD_ERR_INVALID_ARGUMENT;
+    if (width == 0 || height == 0) return PSD_OK;
+    if (doc->depth == 32) return PSD_ERR_UNSUPPORTED_FEATURE;
+
+    psd_flatten_t f;
+    psd_status_t st = psd_flatten_init(&f, doc, width, height);
+    if (st != PSD_OK) return st;
+    psd_flatten_set_region(&f, &region);
+    memset(f.levels[0], 0, f.stride * f.height);
+
+    st = psd_flatten_layers(&f, 0, doc->layers.layer_count);
+    if (st == PSD_OK) {
+        for (uint32_t y = 0; y < height; y++) {
+            psd_blend_unpremultiply_row(out_rgba + (size_t)y * out_stride,
+                                        f.levels[0] + (size_t)y * f.stride, width);
+        }
+    }
+
+    psd_flatten_release(&f);
+    return st;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file psd_flatten.h
+ * @brief Layer compositing state shared by flattening and the composite cache
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_FLATTEN_H
+#define PSD_FLATTEN_H
+
+#include <openpsd/psd.h>
+#include "psd_context.h"
+
+/**
+ * @brief Compositor for regions of one document
+ *
+ * Buffers are sized once for the largest region; levels[0] is the canvas the
+ * layers are blended onto, premultiplied RGBA8 with width * 4 bytes per row.
+ */
+typedef struct {
+    psd_document_t *doc;
+    psd_rect_t region;        /**< Current region in document coordinates */
+    uint32_t width;           /**< Region width */
+    uint32_t height;          /**< Region height */
+    size_t stride;            /**< Bytes per row of every buffer */
+    int32_t *match;           /**< Divider <-> folder record of each group, or -1 */
+    int32_t *wanted;          /**< Scratch list of layers to prefetch */
+    uint8_t **levels;         /**< One buffer per open group, [0] is the canvas */
+    uint8_t *clip;            /**< Clipping base and the layers clipped to it */
+    uint8_t *row;             /**< Premultiplied scratch row */
+    uint8_t *alpha;           /**< Alpha scratch for clipped rows */
+    uint8_t *block;           /**< Backing memory of the buffers */
+} psd_flatten_t;
+
+/**
+ * @brief Set up a compositor for regions up to max_width x max_height
+ */
+PSD_INTERNAL psd_status_t psd_flatten_init(psd_flatten_t *f, psd_document_t *doc,
+                                           uint32_t max_width, uint32_t max_height);
+
+/**
+ * @brief Release the compositor's buffers
+ */
+PSD_INTERNAL void psd_flatten_release(psd_flatten_t *f);
+
+/**
+ * @brief Select the region later calls composite (within the init size)
+ */
+PSD_INTERNAL void psd_flatten_set_region(psd_flatten_t *f, const psd_rect_t *region);
+
+/**
+ * @brief Record index just past the top-level unit starting at first
+ *
+ * A unit is a whole group, a clipping base with the layers clipped to it, or
+ * a single layer. Units are the ranges psd_flatten_layers() can start and
+ * stop at.
+ */
+PSD_INTERNAL int32_t psd_flatten_unit_end(const psd_flatten_t *f, int32_t first);
+
+/**
+ * @brief Blend layer records [first, end) onto levels[0]
+ *
+ * first and end must be top-level unit boundaries.
+ */
+PSD_INTERNAL psd_status_t psd_flatten_layers(psd_flatten_t *f, int32_t first, int32_t end);
+
+#endif /* PSD_FLATTEN_H */
@@ -0,0 +1,182 @@
+/**
+ * @file psd_fused_rows.c
+ * @brief Row pipelines that decode and convert in one pass
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_fused_rows.h"
+
+#include <stddef.h>
+
+/* ----------------------------
+ * Lanes
+ *
+ * A lane is one byte of every output pixel: lane[4 * i] belongs to pixel i.
+ * Samples wider than a byte contribute their MSB (big-endian, so the first
+ * byte), which is what the row converters keep as well.
+ * ---------------------------- */
+
+static inline void lane_fill(uint8_t *lane, uint32_t width, uint8_t value)
+{
+    for (uint32_t i = 0; i < width; i++) {
+        lane[(size_t)i * 4u] = value;
+    }
+}
+
+static inline void lane_copy(uint8_t *lane, const uint8_t *from, uint32_t width)
+{
+    for (uint32_t i = 0; i < width; i++) {
+        lane[(size_t)i * 4u] = from[(size_t)i * 4u];
+    }
+}
+
+static inline void lane_from_plane(const uint8_t *row, uint32_t bps, uint32_t width,
+                                   uint8_t *lane)
+{
+    for (uint32_t i = 0; i < width; i++) {
+        lane[(size_t)i * 4u] = row[(size_t)i * bps];
+    }
+}
+
+/* PackBits straight into a lane. Bytes [first, end) of the decoded row are
+ * wanted, one per bps; the rest of the row is walked, not written. Checks
+ * are those of psd_rle_decode_scanline(), so a row fails here exactly when
+ * it fails to decode. */
+static inline psd_status_t lane_from_packbits(const uint8_t *src, size_t src_len,
+                                              size_t row_bytes, uint32_t bps,
+                                              uint32_t x0, uint32_t width, uint8_t *lane)
+{
+    const size_t first = (size_t)x0 * bps;
+    const size_t end = first + (size_t)width * bps;
+    size_t in = 0;
+    size_t pos = 0;
+    while (pos < row_bytes && in < src_len) {
+        const uint8_t header = src[in++];
+        if (header == 128) {
+            continue;
+        }
+
+        size_t n = 0;
+        const uint8_t *literal = NULL;
+        uint8_t value = 0;
+        if (header < 128) {
+            n = (size_t)header + 1u;
+            if (pos + n > row_bytes || in + n > src_len) {
+                return PSD_ERR_CORRUPT_DATA;
+            }
+            literal = src + in;
+            in += n;
+        } else {
+            n = 257u - (size_t)header;
+            if (in >= src_len || pos + n > row_bytes) {
+                return PSD_ERR_CORRUPT_DATA;
+            }
+            value = src[in++];
+        }
+
+        size_t lo = (pos > first) ? pos : first;
+        const size_t hi = (pos + n < end) ? pos + n : end;
+        lo = (lo + bps - 1u) / bps * bps;
+        if (lo < hi) {
+            uint8_t *dst = lane + (lo - first) / bps * 4u;
+            if (literal) {
+                for (size_t k = lo; k < hi; k += bps, dst += 4) {
+                    *dst = literal[k - pos];
+                }
+            } else {
+                for (size_t k = lo; k < hi; k += bps, dst += 4) {
+                    *dst = value;
+                }
+            }
+        }
+        pos += n;
+    }
+    return (pos == row_bytes) ? PSD_OK : PSD_ERR_CORRUPT_DATA;
+}
+
+/* One lane from whichever source the cursor has */
+#define PSD_DEFINE_FUSED_LANE(NAME, BPS)                                                \
+static psd_status_t NAME(psd_row_cursor_t *cursor, uint32_t y, uint32_t x0,             \
+                         uint32_t width, uint8_t *lane)                                 \
+{                                                                                       \
+    if (cursor->plane) {                                                                \
+        if (y >= cursor->height) return PSD_ERR_OUT_OF_RANGE;                           \
+        lane_from_plane(cursor->plane + (size_t)y * cursor->row_bytes + (size_t)x0 * BPS, \
+                        BPS, width, lane);                                              \
+        return PSD_OK;                                                                  \
+    }                                                                                   \
+    const uint8_t *src = NULL;                                                          \
+    size_t src_len = 0;                                                                 \
+    psd_status_t st = psd_row_cursor_rle_row(cursor, y, &src, &src_len);                \
+    if (st != PSD_OK) return st;                                                        \
+    return lane_from_packbits(src, src_len, cursor->row_bytes, BPS, x0, width, lane);   \
+}
+
+PSD_DEFINE_FUSED_LANE(fused_lane_16, 2u)
+
+/* ----------------------------
+ * Pipelines
+ *
+ * COLORS planes fill lanes 0..COLORS-1 and an alpha plane, when ALPHA, fills
+ * lane 3. Missing data follows render_row_to_rgba8(): the first color is 0,
+ * the others copy it, and alpha is opaque. One color plane is gray, copied
+ * to all three lanes.
+ * ---------------------------- */
+
+#define PSD_DEFINE_FUSED_ROW(NAME, LANE, COLORS, ALPHA)                                 \
+static psd_status_t NAME(psd_row_cursor_t *cursors, const bool *present, uint32_t y,    \
+                         uint32_t x0, uint32_t width, uint8_t *out)                     \
+{                                                                                       \
+    for (uint32_t i = 0; i < (COLORS) + (ALPHA); i++) {                                 \
+        uint8_t *lane = out + ((i < (COLORS)) ? i : 3u);                                \
+        if (!present[i]) {                                                              \
+            if (i == 0 || i >= (COLORS)) lane_fill(lane, width, (i == 0) ? 0u : 255u);  \
+            continue;                                                                   \
+        }                                                                               \
+        psd_status_t st = LANE(&cursors[i], y, x0, width, lane);                        \
+        if (st != PSD_OK) return st;                                                    \
+    }                                                                                   \
+    for (uint32_t i = 1; i < 3u; i++) {                                                 \
+        if (i >= (COLORS) || !present[i]) lane_copy(out + i, out, width);               \
+    }                                                                                   \
+    if (!(ALPHA)) lane_fill(out + 3, width, 255u);                                      \
+    return PSD_OK;                                                                      \
+}
+
+PSD_DEFINE_FUSED_ROW(fused_gray_16, fused_lane_16, 1u, 0u)
+PSD_DEFINE_FUSED_ROW(fused_graya_16, fused_lane_16, 1u, 1u)
+PSD_DEFINE_FUSED_ROW(fused_rgb_16, fused_lane_16, 3u, 0u)
+PSD_DEFINE_FUSED_ROW(fused_rgba_16, fused_lane_16, 3u, 1u)
+
+PSD_INTERNAL psd_fused_rgba8_row_fn psd_select_fused_rgba8_row(psd_color_mode_t mode,
+                                                               uint16_t depth_bits,
+                                                               uint32_t plane_count)
+{
+    /* 8-bit rows are faster through an L1 scratch row and the vector
+     * interleave kernels than written byte by byte into the lanes */
+    if (depth_bits != 16) {
+        return NULL;
+    }
+    switch (mode) {
+    case PSD_COLOR_RGB:
+        if (plane_count == 3) return fused_rgb_16;
+        if (plane_count == 4) return fused_rgba_16;
+        return NULL;
+    case PSD_COLOR_GRAYSCALE:
+    case PSD_COLOR_DUOTONE:
+        if (plane_count == 1) return fused_gray_16;
+        if (plane_count == 2) return fused_graya_16;
+        return NULL;
+    default:
+        return NULL;
+    }
+}
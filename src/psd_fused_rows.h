@@ -0,0 +1,66 @@
+/**
+ * @file psd_fused_rows.h
+ * @brief Row pipelines that decode and convert in one pass
+ *
+ * Each plane's row goes straight from its source, a RAW plane or the row's
+ * PackBits data, into its byte lane of the interleaved RGBA8 output, so no
+ * decoded row or plane is stored anywhere, and only the MSB of each sample
+ * is touched. Specializations are generated per sample width and color
+ * layout; the compression is picked per plane and row, since the channels
+ * of one layer need not share it.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_FUSED_ROWS_H
+#define PSD_FUSED_ROWS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../include/openpsd/psd.h"
+#include "../include/openpsd/psd_export.h"
+#include "psd_rows.h"
+
+/**
+ * @brief Decode and convert pixels [x0, x0 + width) of row y
+ *
+ * @param cursors One cursor per plane, in render order
+ * @param present Whether each plane has data; absent planes get the
+ *        defaults of the row converters (color 0 or a copy of the first
+ *        plane, alpha 255)
+ * @param y Row index
+ * @param x0 First column
+ * @param width Number of pixels
+ * @param out_rgba Receives width RGBA8 pixels
+ * @return PSD_OK, or the error of a cursor
+ */
+typedef psd_status_t (*psd_fused_rgba8_row_fn)(psd_row_cursor_t *cursors,
+                                               const bool *present,
+                                               uint32_t y,
+                                               uint32_t x0,
+                                               uint32_t width,
+                                               uint8_t *out_rgba);
+
+/**
+ * @brief Pick the fused pipeline for a plane layout
+ *
+ * @param mode Color mode
+ * @param depth_bits Bits per sample
+ * @param plane_count Number of planes (color planes, then alpha)
+ * @return The pipeline, or NULL when the layout has none (16-bit RGB and
+ *         grayscale are covered; 8-bit rows already convert from one
+ *         scratch row with the vector kernels)
+ */
+PSD_INTERNAL psd_fused_rgba8_row_fn psd_select_fused_rgba8_row(psd_color_mode_t mode,
+                                                               uint16_t depth_bits,
+                                                               uint32_t plane_count);
+
+#endif /* PSD_FUSED_ROWS_H */
@@ -0,0 +1,256 @@
+/**
+ * @file psd_hash.c
+ * @brief Fast non-cryptographic 64-bit hashing
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_hash.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PSD_HASH_SSE2 1
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)) && \
+    !(defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+/* Lanes are loaded as little-endian words, like the portable path reads them */
+#define PSD_HASH_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define PSD_HASH_PRIME32_1 0x9E3779B1u
+#define PSD_HASH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define PSD_HASH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PSD_HASH_PRIME64_3 0x165667B19E3779F9ULL
+#define PSD_HASH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PSD_HASH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define PSD_HASH_STRIPE 64u          /* Bytes per accumulate step */
+#define PSD_HASH_BLOCK_STRIPES 16u   /* Stripes between scrambles */
+#define PSD_HASH_LAST_KEY 13u        /* Key offset of the final stripe */
+#define PSD_HASH_SCRAMBLE_KEY 16u    /* Key offset of the scramble */
+
+/* Stripe s mixes with key[s..s+7]; sliding through the table gives every
+ * stripe of a block its own key. Words 16..23 also scramble. */
+static const uint64_t psd_hash_key[24] = {
+    0x19267B11E6B7BE97ULL, 0xB93EA4A2E2FF564DULL, 0x8C0832907F486981ULL,
+    0xD9BD62EFF92DFE4CULL, 0x6C6AEBF888200CA7ULL, 0x0C68329EDF7E5590ULL,
+    0x55EFB8AB3100C4F1ULL, 0xEEC642701C88A627ULL, 0xA08D4FCC527640A2ULL,
+    0x427C7C21E6C4ADC4ULL, 0x110DF981E40AF3D2ULL, 0x881900CCFA0E7B88ULL,
+    0x69434DF063C04C36ULL, 0x714034190337F9D7ULL, 0xEA29B3566BEE9A2AULL,
+    0xE8B00EBEA1D13BCCULL, 0x1D65ABC336E0134DULL, 0x3A4163EC6591141FULL,
+    0x355FFBF80E8CACAFULL, 0x38B00C2A3C4E3D8AULL, 0xDA3BBADEDF605DC0ULL,
+    0x484D2E565973BFFBULL, 0x98097D734AE5723EULL, 0xDB047F75AFA22851ULL,
+};
+
+static inline uint64_t psd_hash_read64(const uint8_t *p)
+{
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) |
+           ((uint64_t)p[3] << 24) | ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+           ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static inline uint64_t psd_hash_rotl(uint64_t x, unsigned r)
+{
+    return (x << r) | (x >> (64u - r));
+}
+
+static inline uint64_t psd_hash_avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+/* Low and high halves of the 128-bit product, folded together */
+static inline uint64_t psd_hash_mul_fold(uint64_t a, uint64_t b)
+{
+    const uint64_t lo_lo = (a & 0xFFFFFFFFu) * (b & 0xFFFFFFFFu);
+    const uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFFu);
+    const uint64_t lo_hi = (a & 0xFFFFFFFFu) * (b >> 32);
+    const uint64_t hi_hi = (a >> 32) * (b >> 32);
+    const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFu) + lo_hi;
+    const uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    const uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFFu);
+    return lower ^ upper;
+}
+
+/* ----------------------------
+ * Stripe accumulation
+ *
+ * Per lane: acc[i] += d[i ^ 1] + lo32(d[i] ^ k[i]) * hi32(d[i] ^ k[i]).
+ * Adding the neighbouring word keeps the input when the product is zero.
+ * ---------------------------- */
+
+#if defined(PSD_HASH_SSE2)
+
+static void psd_hash_stripes(uint64_t acc[8], const uint8_t *p, size_t stripes,
+                             const uint64_t *key)
+{
+    __m128i a[4];
+    for (int j = 0; j < 4; j++) {
+        a[j] = _mm_loadu_si128((const __m128i *)(const void *)(acc + 2 * j));
+    }
+    for (size_t s = 0; s < stripes; s++) {
+        const uint8_t *stripe = p + s * PSD_HASH_STRIPE;
+        for (int j = 0; j < 4; j++) {
+            const __m128i d = _mm_loadu_si128((const __m128i *)(const void *)(stripe + 16 * j));
+            const __m128i k = _mm_loadu_si128((const __m128i *)(const void *)(key + s + 2 * j));
+            const __m128i dk = _mm_xor_si128(d, k);
+            const __m128i product = _mm_mul_epu32(dk, _mm_shuffle_epi32(dk, _MM_SHUFFLE(2, 3, 0, 1)));
+            const __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+            a[j] = _mm_add_epi64(a[j], _mm_add_epi64(product, swapped));
+        }
+    }
+    for (int j = 0; j < 4; j++) {
+        _mm_storeu_si128((__m128i *)(void *)(acc + 2 * j), a[j]);
+    }
+}
+
+static void psd_hash_scramble(uint64_t acc[8], const uint64_t *key)
+{
+    const __m128i prime = _mm_set1_epi32((int)PSD_HASH_PRIME32_1);
+    for (int j = 0; j < 4; j++) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(const void *)(acc + 2 * j));
+        const __m128i k = _mm_loadu_si128((const __m128i *)(const void *)(key + 2 * j));
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, k);
+        const __m128i lo = _mm_mul_epu32(a, prime);
+        const __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+        a = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+        _mm_storeu_si128((__m128i *)(void *)(acc + 2 * j), a);
+    }
+}
+
+#elif defined(PSD_HASH_NEON)
+
+static void psd_hash_stripes(uint64_t acc[8], const uint8_t *p, size_t stripes,
+                             const uint64_t *key)
+{
+    uint64x2_t a[4];
+    for (int j = 0; j < 4; j++) {
+        a[j] = vld1q_u64(acc + 2 * j);
+    }
+    for (size_t s = 0; s < stripes; s++) {
+        const uint8_t *stripe = p + s * PSD_HASH_STRIPE;
+        for (int j = 0; j < 4; j++) {
+            const uint64x2_t d = vreinterpretq_u64_u8(vld1q_u8(stripe + 16 * j));
+            const uint64x2_t dk = veorq_u64(d, vld1q_u64(key + s + 2 * j));
+            const uint64x2_t product = vmull_u32(vmovn_u64(dk), vshrn_n_u64(dk, 32));
+            const uint64x2_t swapped = vextq_u64(d, d, 1);
+            a[j] = vaddq_u64(a[j], vaddq_u64(product, swapped));
+        }
+    }
+    for (int j = 0; j < 4; j++) {
+        vst1q_u64(acc + 2 * j, a[j]);
+    }
+}
+
+static void psd_hash_scramble(uint64_t acc[8], const uint64_t *key)
+{
+    const uint32x2_t prime = vdup_n_u32(PSD_HASH_PRIME32_1);
+    for (int j = 0; j < 4; j++) {
+        uint64x2_t a = vld1q_u64(acc + 2 * j);
+        a = veorq_u64(a, vshrq_n_u64(a, 47));
+        a = veorq_u64(a, vld1q_u64(key + 2 * j));
+        const uint64x2_t lo = vmull_u32(vmovn_u64(a), prime);
+        const uint64x2_t hi = vmull_u32(vshrn_n_u64(a, 32), prime);
+        vst1q_u64(acc + 2 * j, vaddq_u64(lo, vshlq_n_u64(hi, 32)));
+    }
+}
+
+#else
+
+static void psd_hash_stripes(uint64_t acc[8], const uint8_t *p, size_t stripes,
+                             const uint64_t *key)
+{
+    for (size_t s = 0; s < stripes; s++) {
+        const uint8_t *stripe = p + s * PSD_HASH_STRIPE;
+        for (unsigned i = 0; i < 8u; i++) {
+            const uint64_t d = psd_hash_read64(stripe + 8u * i);
+            const uint64_t dk = d ^ key[s + i];
+            acc[i ^ 1u] += d;
+            acc[i] += (dk & 0xFFFFFFFFu) * (dk >> 32);
+        }
+    }
+}
+
+static void psd_hash_scramble(uint64_t acc[8], const uint64_t *key)
+{
+    for (unsigned i = 0; i < 8u; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= key[i];
+        acc[i] = a * PSD_HASH_PRIME32_1;
+    }
+}
+
+#endif
+
+/* ----------------------------
+ * Entry point
+ * ---------------------------- */
+
+/* Up to one stripe: word-at-a-time rounds, zero-padded tail */
+static uint64_t psd_hash_short(const uint8_t *p, size_t length, uint64_t seed)
+{
+    uint64_t h = seed + (uint64_t)length * PSD_HASH_PRIME64_1 + PSD_HASH_PRIME64_5;
+    size_t i = 0;
+    unsigned word = 0;
+    for (; i + 8u <= length; i += 8u, word++) {
+        uint64_t k = psd_hash_read64(p + i) ^ psd_hash_key[word];
+        k = psd_hash_rotl(k * PSD_HASH_PRIME64_2, 31) * PSD_HASH_PRIME64_1;
+        h = psd_hash_rotl(h ^ k, 27) * PSD_HASH_PRIME64_1 + PSD_HASH_PRIME64_4;
+    }
+    if (i < length) {
+        uint64_t tail = 0;
+        for (unsigned b = 0; i + b < length; b++) {
+            tail |= (uint64_t)p[i + b] << (8u * b);
+        }
+        uint64_t k = tail ^ psd_hash_key[word];
+        k = psd_hash_rotl(k * PSD_HASH_PRIME64_2, 31) * PSD_HASH_PRIME64_1;
+        h = psd_hash_rotl(h ^ k, 27) * PSD_HASH_PRIME64_1 + PSD_HASH_PRIME64_4;
+    }
+    return psd_hash_avalanche(h);
+}
+
+PSD_INTERNAL uint64_t psd_hash64(const void *data, size_t length, uint64_t seed)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    if (length <= PSD_HASH_STRIPE) {
+        return psd_hash_short(p, length, seed);
+    }
+
+    uint64_t acc[8] = {
+        PSD_HASH_PRIME32_1, PSD_HASH_PRIME64_1, PSD_HASH_PRIME64_2, PSD_HASH_PRIME64_3,
+        PSD_HASH_PRIME64_4, PSD_HASH_PRIME64_5, PSD_HASH_PRIME64_1 ^ seed, PSD_HASH_PRIME64_2 + seed,
+    };
+
+    /* The final stripe always comes from the end, overlapping the ones
+     * before it, so every length ends in one full stripe */
+    const size_t stripes = (length - 1u) / PSD_HASH_STRIPE;
+    const size_t blocks = stripes / PSD_HASH_BLOCK_STRIPES;
+    const size_t block_bytes = (size_t)PSD_HASH_BLOCK_STRIPES * PSD_HASH_STRIPE;
+    for (size_t b = 0; b < blocks; b++) {
+        psd_hash_stripes(acc, p + b * block_bytes, PSD_HASH_BLOCK_STRIPES, psd_hash_key);
+        psd_hash_scramble(acc, psd_hash_key + PSD_HASH_SCRAMBLE_KEY);
+    }
+    psd_hash_stripes(acc, p + blocks * block_bytes, stripes % PSD_HASH_BLOCK_STRIPES,
+                     psd_hash_key);
+    psd_hash_stripes(acc, p + length - PSD_HASH_STRIPE, 1, psd_hash_key + PSD_HASH_LAST_KEY);
+
+    uint64_t h = seed + (uint64_t)length * PSD_HASH_PRIME64_1;
+    for (unsigned i = 0; i < 4u; i++) {
+        h += psd_hash_mul_fold(acc[2u * i] ^ psd_hash_key[2u * i + 1u],
+                               acc[2u * i + 1u] ^ psd_hash_key[2u * i + 2u]);
+    }
+    return psd_hash_avalanche(h);
+}
@@ -0,0 +1,39 @@
+/**
+ * @file psd_hash.h
+ * @brief Fast non-cryptographic 64-bit hashing
+ *
+ * An XXH3-style hash: 64-byte stripes feed eight 64-bit accumulators with a
+ * 32x32->64 multiply per lane, so long inputs run close to memory speed with
+ * SSE2 or NEON. The constants are OpenPSD's own and the output does not
+ * match XXH3. Vector and portable paths give identical values on every
+ * platform, so hashes can be stored and compared across machines.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_HASH_H
+#define PSD_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/openpsd/psd_export.h"
+
+/**
+ * @brief Hash a byte range
+ *
+ * @param data Bytes to hash (can be NULL when length is 0)
+ * @param length Number of bytes
+ * @param seed Starting value; chaining hashes through the seed combines them
+ * @return 64-bit hash, stable across platforms and releases
+ */
+PSD_INTERNAL uint64_t psd_hash64(const void *data, size_t length, uint64_t seed);
+
+#endif /* PSD_HASH_H */
@@ -22,6 +22,7 @@
 #include <stdbool.h>
 #include "psd_layer_channel.h"
 #include "psd_descriptor.h"
+#include "psd_once.h"
 #include "../include/openpsd/psd_types.h"
 
 /**
@@ -36,6 +37,31 @@ typedef struct {
     int32_t right;    /**< Right coordinate */
 } psd_layer_bounds_t;
 
+/**
+ * @brief One additional layer information block of a layer
+ *
+ * Indexed during the layer record pass; the payload stays in the layer's
+ * additional_data and any descriptor inside it is parsed on first request.
+ */
+typedef struct {
+    uint32_t key;                       /**< Block key, e.g. 'lfx2' */
+    uint64_t offset;                    /**< Payload offset into additional_data */
+    uint64_t length;                    /**< Payload length without padding */
+    psd_descriptor_flat_t *descriptor;  /**< Parsed descriptor, NULL until requested */
+    psd_once_t descriptor_once;         /**< Published once a parse ran (bad data is not retried) */
+} psd_tagged_block_t;
+
+/**
+ * @brief Visible extent of a layer, from its transparency channel
+ *
+ * Computed on first request (psd_layer_content.c) and kept with the record.
+ */
+typedef struct {
+    psd_layer_bounds_t bounds;  /**< Tight box of pixels with alpha > 0, document coordinates (all 0 if none) */
+    uint8_t *empty_rows;        /**< Bit y (LSB first) set when layer row y is fully transparent, NULL if none is */
+    uint32_t empty_row_count;   /**< Number of bits set in empty_rows */
+} psd_layer_content_t;
+
 /**
  * @brief A single layer record
  *
@@ -55,8 +81,13 @@ typedef struct {
     size_t name_length;                  /**< Length of name in bytes */
     uint8_t *additional_data;            /**< Raw additional layer info blocks */
     uint64_t additional_length;          /**< Length of additional info */
-    psd_descriptor_t *descriptor;        /**< Layer descriptor (effects, text, etc.) - may be NULL */
+    psd_tagged_block_t *blocks;          /**< Index of the tagged blocks in additional_data */
+    uint32_t block_count;                /**< Number of indexed blocks */
     psd_layer_features_t features;       /**< Layer features detected from additional info */
+    psd_layer_content_t *content;        /**< Content bounds (metadata arena), NULL until computed */
+    psd_once_t content_once;             /**< Published once content is set */
+    uint64_t pixel_hash;                 /**< Hash of the channel payloads (psd_layer_fingerprint.c) */
+    psd_once_t pixel_hash_once;          /**< Published once pixel_hash is set */
 } psd_layer_record_t;
 
 /**
@@ -22,23 +22,36 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "psd_once.h"
 
 /**
  * @brief Layer channel data with lazy decoding support
  *
  * Stores channel pixel data which can be in raw, RLE, or ZIP format.
- * Decoding is deferred until explicitly requested.
+ * Decoding is deferred until explicitly requested. The deferred payload load
+ * and the decode each happen once per channel even when several threads ask
+ * for it; readers check the flags before touching the fields they guard.
  */
-typedef struct {
+typedef struct psd_layer_channel_data {
     int16_t channel_id;           /**< Channel ID (-1=transparency, 0=R, 1=G, etc.) */
     uint8_t compression;          /**< Compression type: 0=RAW, 1=RLE, 2=ZIP, 3=ZIP+pred */
     uint64_t compressed_length;   /**< Length of compressed data */
-    uint8_t *compressed_data;     /**< Compressed/raw pixel data (owned by allocator) */
+    uint64_t file_offset;         /**< Stream offset of the payload (after the compression field) */
+    uint8_t length_bytes;         /**< Width of the length field in the layer record (4 or 8) */
+    uint8_t *compressed_data;     /**< Compressed/raw pixel data (owned by allocator unless borrowed) */
+    bool compressed_borrowed;     /**< compressed_data points into a file mapping and must not be freed */
+    psd_once_t loaded;            /**< Published once compressed_data is settled (psd_document_load_channel) */
     
     /* Decoded data (lazy) */
     uint8_t *decoded_data;        /**< Decoded pixel data (NULL until decoded, owned by allocator) */
     uint64_t decoded_length;      /**< Length of decoded data */
-    bool is_decoded;              /**< Whether data has been decoded */
+    psd_once_t decoded;           /**< Published once decoded_data is set, claimed while decoding */
+
+    /* Decode cache bookkeeping (psd_decode_cache.c) */
+    struct psd_layer_channel_data *lru_prev; /**< More recently used cached channel */
+    struct psd_layer_channel_data *lru_next; /**< Less recently used cached channel */
+    uint64_t cache_bytes;         /**< Bytes charged to the cache budget (0 = not cached) */
+    int32_t cache_layer;          /**< Owning layer index while cached */
 } psd_layer_channel_data_t;
 
 #endif /* PSD_LAYER_CHANNEL_H */
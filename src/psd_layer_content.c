@@ -0,0 +1,161 @@
+/**
+ * @file psd_layer_content.c
+ * @brief Content bounds and empty rows of layers
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_layer_content.h"
+#include "psd_alloc.h"
+#include "psd_context.h"
+#include "psd_rows.h"
+#include "psd_threads.h"
+#include <string.h>
+
+/* Find the transparency channel's cursor; false when the layer has none
+ * with usable data, which renders as opaque */
+static psd_status_t psd_layer_alpha_cursor(psd_document_t *doc, int32_t layer_index,
+                                           psd_row_cursor_t *cursor, bool *out_found)
+{
+    const psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    *out_found = false;
+    for (size_t i = 0; i < layer->channel_count; i++) {
+        if (layer->channels[i].channel_id != -1) {
+            continue;
+        }
+        psd_status_t status = psd_document_layer_row_cursor(doc, layer_index, i, cursor, NULL);
+        if (status == PSD_ERR_INVALID_ARGUMENT) {
+            return PSD_OK;
+        }
+        if (status != PSD_OK) {
+            return status;
+        }
+        *out_found = true;
+        return PSD_OK;
+    }
+    return PSD_OK;
+}
+
+static psd_status_t psd_layer_content_scan(psd_document_t *doc, int32_t layer_index,
+                                           psd_layer_content_t *content)
+{
+    const psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    memset(content, 0, sizeof(*content));
+    if (layer->bounds.right <= layer->bounds.left || layer->bounds.bottom <= layer->bounds.top) {
+        return PSD_OK;
+    }
+    const uint32_t height = (uint32_t)(layer->bounds.bottom - layer->bounds.top);
+
+    psd_row_cursor_t cursor;
+    bool found = false;
+    psd_status_t status = psd_layer_alpha_cursor(doc, layer_index, &cursor, &found);
+    if (status != PSD_OK) {
+        return status;
+    }
+    if (!found || doc->depth < 8) {
+        content->bounds = layer->bounds;
+        return PSD_OK;
+    }
+
+    uint8_t *empty = (uint8_t *)psd_alloc_malloc(&doc->meta.allocator,
+                                                 ((size_t)height + 7u) / 8u);
+    if (!empty) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    memset(empty, 0, ((size_t)height + 7u) / 8u);
+
+    const uint32_t sample_bytes = doc->depth / 8u;
+    uint32_t top = height, bottom = 0, left = UINT32_MAX, right = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        uint32_t first = 0, end = 0;
+        status = psd_row_cursor_extent(&cursor, y, sample_bytes, &first, &end);
+        if (status != PSD_OK) {
+            return status;
+        }
+        if (first == end) {
+            empty[y >> 3] |= (uint8_t)(1u << (y & 7u));
+            content->empty_row_count++;
+            continue;
+        }
+        if (y < top) top = y;
+        bottom = y + 1u;
+        if (first < left) left = first;
+        if (end > right) right = end;
+    }
+
+    content->empty_rows = content->empty_row_count ? empty : NULL;
+    if (top < bottom) {
+        content->bounds.top = layer->bounds.top + (int32_t)top;
+        content->bounds.left = layer->bounds.left + (int32_t)left;
+        content->bounds.bottom = layer->bounds.top + (int32_t)bottom;
+        content->bounds.right = layer->bounds.left + (int32_t)right;
+    }
+    return PSD_OK;
+}
+
+PSD_INTERNAL psd_status_t psd_layer_content_get(psd_document_t *doc,
+                                                int32_t layer_index,
+                                                const psd_layer_content_t **out_content)
+{
+    if (!doc || !out_content) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (layer_index < 0 || layer_index >= doc->layers.layer_count) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    /* Scanned once; threads asking meanwhile wait, a failure is retried */
+    psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    if (psd_once_enter(&layer->content_once)) {
+        psd_layer_content_t content;
+        psd_status_t status = psd_layer_content_scan(doc, layer_index, &content);
+        psd_layer_content_t *stored = NULL;
+        if (status == PSD_OK) {
+            stored = (psd_layer_content_t *)psd_alloc_malloc(&doc->meta.allocator,
+                                                             sizeof(psd_layer_content_t));
+            status = stored ? PSD_OK : PSD_ERR_OUT_OF_MEMORY;
+        }
+        if (status != PSD_OK) {
+            psd_once_reset(&layer->content_once);
+            return status;
+        }
+        *stored = content;
+        layer->content = stored;
+        psd_once_publish(&layer->content_once);
+    }
+    *out_content = layer->content;
+    return PSD_OK;
+}
+
+PSD_API psd_status_t psd_document_get_layer_content_bounds(psd_document_t *doc,
+                                                           int32_t layer_index,
+                                                           psd_rect_t *out_bounds,
+                                                           uint32_t *out_empty_rows)
+{
+    if (!doc || !out_bounds) {
+        return PSD_ERR_NULL_POINTER;
+    }
+
+    const psd_layer_content_t *content = NULL;
+    psd_status_t status = psd_layer_content_get(doc, layer_index, &content);
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    out_bounds->top = content->bounds.top;
+    out_bounds->left = content->bounds.left;
+    out_bounds->bottom = content->bounds.bottom;
+    out_bounds->right = content->bounds.right;
+    if (out_empty_rows) {
+        *out_empty_rows = content->empty_row_count;
+    }
+    return PSD_OK;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file psd_layer_content.h
+ * @brief Content bounds and empty rows of layers
+ *
+ * Layers often carry generous bounds around mostly transparent pixels. The
+ * transparency channel is scanned once per layer for the tight box of
+ * visible pixels and the rows with none; RLE channels are read in the
+ * compressed domain and only ZIP channels are decoded. The compositor uses
+ * the result to skip work that cannot change the canvas.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_LAYER_CONTENT_H
+#define PSD_LAYER_CONTENT_H
+
+#include <stdint.h>
+#include "psd_layer.h"
+#include "../include/openpsd/psd.h"
+#include "../include/openpsd/psd_export.h"
+
+/**
+ * @brief Get a layer's content bounds, computing them on first use
+ *
+ * A layer without a usable transparency channel is opaque: its content is
+ * its whole bounds and no row is empty.
+ *
+ * @param doc Document (channel payloads are loaded if they were deferred)
+ * @param layer_index Layer index (0-based)
+ * @param out_content Receives the cached result
+ * @return PSD_OK, PSD_ERR_OUT_OF_RANGE for a bad index, or the error from
+ *         reading the transparency channel
+ */
+PSD_INTERNAL psd_status_t psd_layer_content_get(psd_document_t *doc,
+                                                int32_t layer_index,
+                                                const psd_layer_content_t **out_content);
+
+/**
+ * @brief psd_document_render_layer_rgba8_scanlines() without the empty rows
+ *
+ * Rows whose bit is set in empty_rows are neither decoded nor handed to the
+ * callback. Implemented in psd_render.c.
+ *
+ * @param doc Document
+ * @param layer_index Layer index (0-based)
+ * @param rect Region in layer coordinates
+ * @param empty_rows Layer row bitmap (psd_layer_content_t), or NULL
+ * @param callback Receives each remaining row (y relative to rect->top)
+ * @param user_data Passed to callback
+ */
+PSD_INTERNAL psd_status_t psd_render_layer_content_rows(psd_document_t *doc,
+                                                        int32_t layer_index,
+                                                        const psd_rect_t *rect,
+                                                        const uint8_t *empty_rows,
+                                                        psd_render_scanline_fn callback,
+                                                        void *user_data);
+
+#endif /* PSD_LAYER_CONTENT_H */
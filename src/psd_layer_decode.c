@@ -17,10 +17,10 @@
 #include "psd_rle.h"
 #include "psd_zip.h"
 #include "psd_alloc.h"
+#include "psd_threads.h"
+#include <stdint.h>
 #include <string.h>
 
-#include <stdio.h>
-
 /**
  * @brief Decode a single PackBits-encoded row
  *
@@ -97,219 +97,275 @@ static psd_status_t parse_rle_row_counts(
     return PSD_OK;
 }
 
- /**
- * @brief Decode a layer channel's pixel data
+/**
+ * @brief Work out the byte counts table layout of an RLE layer channel
  *
- * Supports RAW and RLE decompression. ZIP formats are preserved as-is
- * since ZIP support is not yet implemented.
+ * RLE layer channels store per-row byte counts followed by PackBits data.
+ * PSD usually uses 2-byte counts; PSB commonly uses 4-byte counts.
+ * We auto-detect based on plausibility AND prefer the interpretation that
+ * exactly consumes the payload (counts + RLE bytes == compressed_len).
  */
-psd_status_t psd_layer_channel_decode(
-        psd_layer_channel_data_t *channel,
-        uint32_t width,
+psd_status_t psd_layer_channel_rle_layout(
+        const psd_layer_channel_data_t *channel,
         uint32_t height,
-        uint16_t depth,
-        const psd_allocator_t *allocator) {
-    if (!channel) {
+        uint32_t *out_count_bytes,
+        uint64_t *out_counts_size,
+        uint64_t *out_total_rle_bytes) {
+    if (!channel || !out_count_bytes || !out_counts_size || !out_total_rle_bytes) {
         return PSD_ERR_INVALID_ARGUMENT;
     }
+    if (!channel->compressed_data) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
 
-    /* Already decoded? */
-    if (channel->is_decoded && channel->decoded_data) {
-        return PSD_OK;
+    uint64_t counts_size2 = 0, total2 = 0;
+    uint64_t counts_size4 = 0, total4 = 0;
+    psd_status_t st2 = parse_rle_row_counts(
+        channel->compressed_data, channel->compressed_length,
+        height, 2, &counts_size2, &total2);
+    psd_status_t st4 = parse_rle_row_counts(
+        channel->compressed_data, channel->compressed_length,
+        height, 4, &counts_size4, &total4);
+
+    if (st2 == PSD_OK && st4 == PSD_OK) {
+        uint64_t end2 = counts_size2 + total2;
+        uint64_t end4 = counts_size4 + total4;
+        if (end4 == channel->compressed_length && end2 != channel->compressed_length) {
+            *out_count_bytes = 4; *out_counts_size = counts_size4; *out_total_rle_bytes = total4;
+        } else if (end2 == channel->compressed_length && end4 != channel->compressed_length) {
+            *out_count_bytes = 2; *out_counts_size = counts_size2; *out_total_rle_bytes = total2;
+        } else {
+            /* Both (or neither) consume exactly; prefer 2-byte for compatibility. */
+            *out_count_bytes = 2; *out_counts_size = counts_size2; *out_total_rle_bytes = total2;
+        }
+    } else if (st2 == PSD_OK) {
+        *out_count_bytes = 2; *out_counts_size = counts_size2; *out_total_rle_bytes = total2;
+    } else if (st4 == PSD_OK) {
+        *out_count_bytes = 4; *out_counts_size = counts_size4; *out_total_rle_bytes = total4;
+    } else {
+        return PSD_ERR_CORRUPT_DATA;
     }
 
-    /* Calculate expected decoded size */
-    uint64_t bytes_per_sample = (depth >= 8) ? (uint64_t)(depth / 8) : 1;
-    uint64_t scanline_width = 0;
-    uint64_t expected_decoded_size = 0;
+    return PSD_OK;
+}
 
+/**
+ * @brief Row length and plane size of a width x height channel at depth
+ */
+static psd_status_t psd_layer_channel_plane_size(uint32_t width,
+                                                 uint32_t height,
+                                                 uint16_t depth,
+                                                 uint64_t *out_scanline,
+                                                 uint64_t *out_size) {
+    uint64_t scanline_width = 0;
     if (depth == 1) {
         /* Bitmap channels are packed 1-bit per pixel per row */
         scanline_width = ((uint64_t)width + 7u) / 8u;
-        expected_decoded_size = scanline_width * (uint64_t)height;
     } else {
+        uint64_t bytes_per_sample = (uint64_t)(depth / 8);
         if (bytes_per_sample == 0) {
             return PSD_ERR_UNSUPPORTED_FEATURE;
         }
         scanline_width = (uint64_t)width * bytes_per_sample;
-        expected_decoded_size = scanline_width * (uint64_t)height;
     }
+    *out_scanline = scanline_width;
+    *out_size = scanline_width * (uint64_t)height;
+    return PSD_OK;
+}
+
+/**
+ * @brief Decode a layer channel into caller memory (untimed)
+ */
+static psd_status_t psd_layer_channel_decode_plane(
+        const psd_layer_channel_data_t *channel,
+        uint32_t width,
+        uint32_t height,
+        uint16_t depth,
+        uint8_t *dst,
+        size_t dst_stride,
+        const psd_allocator_t *allocator,
+        psd_zip_pool_t *zip_pool,
+        bool parallel_rows) {
+
+    uint64_t scanline_width = 0;
+    uint64_t expected_decoded_size = 0;
+    psd_status_t size_st = psd_layer_channel_plane_size(width, height, depth, &scanline_width,
+                                                        &expected_decoded_size);
+    if (size_st != PSD_OK) {
+        return size_st;
+    }
+    if (dst_stride < scanline_width) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    if (expected_decoded_size > SIZE_MAX) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+    if (!channel->compressed_data) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+    size_t row_bytes = (size_t)scanline_width;
 
     /* Handle different compression types */
     switch (channel->compression) {
         case 0: { /* RAW - uncompressed */
+            /* RAW channel data may contain padding beyond the expected pixel
+             * payload; only the pixel bytes are copied */
             if (channel->compressed_length < expected_decoded_size) {
                 return PSD_ERR_CORRUPT_DATA;
             }
-
-            /* RAW channel data may contain padding beyond the expected pixel payload.
-             * Allocate an owned decoded buffer of exactly expected_decoded_size and
-             * copy only the pixel bytes we expect. */
-            uint8_t *decoded = (uint8_t *)psd_alloc_malloc(allocator, expected_decoded_size);
-            if (!decoded) {
-                return PSD_ERR_OUT_OF_MEMORY;
+            if (dst_stride == row_bytes) {
+                memcpy(dst, channel->compressed_data, (size_t)expected_decoded_size);
+                return PSD_OK;
+            }
+            for (uint32_t y = 0; y < height; y++) {
+                memcpy(dst + (size_t)y * dst_stride,
+                       channel->compressed_data + (size_t)y * row_bytes, row_bytes);
             }
-            memcpy(decoded, channel->compressed_data, (size_t)expected_decoded_size);
-
-            /* Data is already raw, just mark as decoded */
-            channel->decoded_data = decoded;
-            channel->decoded_length = expected_decoded_size;
-            channel->is_decoded = true;
-
             return PSD_OK;
         }
 
         case 1: { /* RLE - PackBits compression */
-            /* RLE layer channels store per-row byte counts followed by PackBits data.
-             * PSD usually uses 2-byte counts; PSB commonly uses 4-byte counts.
-             * We auto-detect based on plausibility AND prefer the interpretation that
-             * exactly consumes the payload (counts + RLE bytes == compressed_len). */
             uint64_t counts_size = 0;
             uint64_t total_rle_bytes = 0;
             uint32_t row_count_bytes = 2;
-
-            uint64_t counts_size2 = 0, total2 = 0;
-            uint64_t counts_size4 = 0, total4 = 0;
-            psd_status_t st2 = parse_rle_row_counts(
-                channel->compressed_data, channel->compressed_length,
-                height, 2, &counts_size2, &total2);
-            psd_status_t st4 = parse_rle_row_counts(
-                channel->compressed_data, channel->compressed_length,
-                height, 4, &counts_size4, &total4);
-
-            if (st2 == PSD_OK && st4 == PSD_OK) {
-                uint64_t end2 = counts_size2 + total2;
-                uint64_t end4 = counts_size4 + total4;
-                if (end4 == channel->compressed_length && end2 != channel->compressed_length) {
-                    row_count_bytes = 4; counts_size = counts_size4; total_rle_bytes = total4;
-                } else if (end2 == channel->compressed_length && end4 != channel->compressed_length) {
-                    row_count_bytes = 2; counts_size = counts_size2; total_rle_bytes = total2;
-                } else {
-                    /* Both (or neither) consume exactly; prefer 2-byte for compatibility. */
-                    row_count_bytes = 2; counts_size = counts_size2; total_rle_bytes = total2;
-                }
-            } else if (st2 == PSD_OK) {
-                row_count_bytes = 2; counts_size = counts_size2; total_rle_bytes = total2;
-            } else if (st4 == PSD_OK) {
-                row_count_bytes = 4; counts_size = counts_size4; total_rle_bytes = total4;
-            } else {
-                return PSD_ERR_CORRUPT_DATA;
+            psd_status_t layout_st = psd_layer_channel_rle_layout(
+                channel, height, &row_count_bytes, &counts_size, &total_rle_bytes);
+            if (layout_st != PSD_OK) {
+                return layout_st;
             }
 
-            /* Allocate buffer for decoded data */
-            uint8_t *decoded = (uint8_t *)psd_alloc_malloc(allocator, expected_decoded_size);
-            if (!decoded) {
-                return PSD_ERR_OUT_OF_MEMORY;
-            }
+            /* PackBits rows through the byte counts table; large channels
+             * are split into row ranges decoded on worker threads */
+            psd_rle_rows_t rows;
+            rows.counts = channel->compressed_data;
+            rows.count_bytes = row_count_bytes;
+            rows.rle = channel->compressed_data + counts_size;
+            rows.rle_length = total_rle_bytes;
+            rows.rows = height;
+            rows.row_bytes = row_bytes;
+            rows.dst = dst;
+            rows.dst_stride = dst_stride;
+            rows.decode_row = psd_packbits_decode_row;
+
+            return psd_rle_decode_rows(&rows, parallel_rows, allocator);
+        }
 
-            /* Row-by-row PackBits decode using the byte counts table */
-            const uint8_t *counts = channel->compressed_data;
-            const uint8_t *rle = channel->compressed_data + counts_size;
-            uint64_t rle_off = 0;
+        case 2:   /* ZIP - zlib compression */
+        case 3:   /* ZIP with prediction */
+            return psd_zip_decompress_rows(
+                channel->compressed_data, channel->compressed_length, dst, height,
+                row_bytes, dst_stride,
+                (channel->compression == 3) ? (size_t)((depth == 1) ? 1 : (depth / 8)) : 0,
+                allocator, zip_pool);
 
-            for (uint32_t y = 0; y < height; y++) {
-                uint64_t row_len = 0;
-                const uint8_t *p = counts + (uint64_t)y * row_count_bytes;
-                row_len = (row_count_bytes == 2) ? (uint64_t)read_be_u16(p) : (uint64_t)read_be_u32(p);
-                if (rle_off + row_len > total_rle_bytes) {
-                    psd_alloc_free(allocator, decoded);
-                    return PSD_ERR_CORRUPT_DATA;
-                }
-                uint8_t *dst_row = decoded + (uint64_t)y * scanline_width;
-                psd_status_t row_st = psd_packbits_decode_row(
-                    rle + rle_off,
-                    (size_t)row_len,
-                    dst_row,
-                    (size_t)scanline_width);
-                if (row_st != PSD_OK) {
-                    psd_alloc_free(allocator, decoded);
-                    return row_st;
-                }
-                rle_off += row_len;
-            }
+        default:
+            return PSD_ERR_UNSUPPORTED_COMPRESSION;
+    }
+}
 
-            channel->decoded_data = decoded;
-            channel->decoded_length = expected_decoded_size;
-            channel->is_decoded = true;
+/**
+ * @brief Decode a layer channel into caller memory
+ */
+psd_status_t psd_layer_channel_decode_into(
+        const psd_layer_channel_data_t *channel,
+        uint32_t width,
+        uint32_t height,
+        uint16_t depth,
+        uint8_t *dst,
+        size_t dst_stride,
+        const psd_allocator_t *allocator,
+        psd_zip_pool_t *zip_pool,
+        bool parallel_rows,
+        psd_stats_state_t *stats) {
+    if (!channel || !dst) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
 
-            return PSD_OK;
+    uint64_t start = psd_stats_phase_begin(stats, PSD_PHASE_LAYER_DECODE);
+    psd_status_t status = psd_layer_channel_decode_plane(
+        channel, width, height, depth, dst, dst_stride, allocator, zip_pool, parallel_rows);
+
+    if (stats) {
+        uint64_t scanline_width = 0;
+        uint64_t plane_size = 0;
+        psd_trace_channel_t trace;
+        memset(&trace, 0, sizeof(trace));
+        trace.channel_id = channel->channel_id;
+        trace.compression = channel->compression;
+        trace.compressed_bytes = channel->compressed_length;
+        if (psd_layer_channel_plane_size(width, height, depth, &scanline_width,
+                                         &plane_size) == PSD_OK) {
+            trace.decoded_bytes = plane_size;
         }
+        trace.status = status;
+        psd_stats_channel(stats, start, &trace);
+    }
+    return status;
+}
 
-        case 2: { /* ZIP - zlib compression */
-            printf("Attempting to decode ZIP channel data\n");
-            /* Allocate buffer for decoded data */
-            uint8_t *decoded = (uint8_t *)psd_alloc_malloc(allocator, expected_decoded_size);
-            if (!decoded) {
-                return PSD_ERR_OUT_OF_MEMORY;
-            }
-
-            /* Decompress ZIP data */
-            psd_status_t status = psd_zip_decompress(
-                channel->compressed_data,
-                channel->compressed_length,
-                decoded,
-                expected_decoded_size,
-                allocator);
-
-            if (status != PSD_OK) {
-                psd_alloc_free(allocator, decoded);
-                /* If ZIP not supported, leave data compressed */
-                if (status == PSD_ERR_UNSUPPORTED_COMPRESSION) {
-                    channel->decoded_data = NULL;
-                    channel->decoded_length = 0;
-                    channel->is_decoded = false;
-                    return PSD_OK;
-                }
-                return status;
-            }
-
-            channel->decoded_data = decoded;
-            channel->decoded_length = expected_decoded_size;
-            channel->is_decoded = true;
+/**
+ * @brief Decode a layer channel's pixel data
+ *
+ * Decodes into a new plane of exactly width x height samples. ZIP channels
+ * are left compressed when ZIP support is not compiled in. A thread that
+ * finds the channel being decoded waits for that plane.
+ */
+psd_status_t psd_layer_channel_decode(
+        psd_layer_channel_data_t *channel,
+        uint32_t width,
+        uint32_t height,
+        uint16_t depth,
+        const psd_allocator_t *allocator,
+        psd_zip_pool_t *zip_pool,
+        bool parallel_rows,
+        psd_stats_state_t *stats) {
+    if (!channel) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
 
-            printf("Successfully decoded ZIP channel data\n");
-            return PSD_OK;
-        }
+    /* Already decoded? */
+    if (!psd_once_enter(&channel->decoded)) {
+        psd_stats_decode_hit(stats);
+        return PSD_OK;
+    }
 
-        case 3: { /* ZIP with prediction */
-            printf("Attempting to decode ZIP with prediction channel data\n");
-            /* Allocate buffer for decoded data */
-            uint8_t *decoded = (uint8_t *)psd_alloc_malloc(allocator, expected_decoded_size);
-            if (!decoded) {
-                return PSD_ERR_OUT_OF_MEMORY;
-            }
+    /* Calculate expected decoded size */
+    uint64_t scanline_width = 0;
+    uint64_t expected_decoded_size = 0;
+    psd_status_t status = psd_layer_channel_plane_size(width, height, depth, &scanline_width,
+                                                       &expected_decoded_size);
+    if (status == PSD_OK && channel->compression > 3) {
+        status = PSD_ERR_UNSUPPORTED_COMPRESSION;
+    }
+    if (status != PSD_OK) {
+        psd_once_reset(&channel->decoded);
+        return status;
+    }
 
-            /* Decompress with prediction reversal */
-            psd_status_t status = psd_zip_decompress_with_prediction(
-                channel->compressed_data,
-                channel->compressed_length,
-                decoded,
-                expected_decoded_size,
-                (size_t)scanline_width,
-                (size_t)((depth == 1) ? 1 : (depth / 8)),
-                allocator);
-
-            if (status != PSD_OK) {
-                psd_alloc_free(allocator, decoded);
-                /* If ZIP not supported, leave data compressed */
-                if (status == PSD_ERR_UNSUPPORTED_COMPRESSION) {
-                    channel->decoded_data = NULL;
-                    channel->decoded_length = 0;
-                    channel->is_decoded = false;
-                    return PSD_OK;
-                }
-                return status;
-            }
+    bool zip = channel->compression >= 2;
 
-            channel->decoded_data = decoded;
-            channel->decoded_length = expected_decoded_size;
-            channel->is_decoded = true;
+    /* Allocate buffer for decoded data */
+    uint8_t *decoded = (uint8_t *)psd_alloc_malloc(allocator, expected_decoded_size);
+    if (!decoded) {
+        psd_once_reset(&channel->decoded);
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
 
-            printf("Successfully decoded ZIP with prediction channel data\n");
+    status = psd_layer_channel_decode_into(
+        channel, width, height, depth, decoded, (size_t)scanline_width,
+        allocator, zip_pool, parallel_rows, stats);
+    if (status != PSD_OK) {
+        psd_alloc_free(allocator, decoded);
+        psd_once_reset(&channel->decoded);
+        /* If ZIP not supported, leave data compressed */
+        if (zip && status == PSD_ERR_UNSUPPORTED_COMPRESSION) {
             return PSD_OK;
         }
-
-        default:
-            return PSD_ERR_UNSUPPORTED_COMPRESSION;
+        return status;
     }
+
+    channel->decoded_data = decoded;
+    channel->decoded_length = expected_decoded_size;
+    psd_once_publish(&channel->decoded);
+    return PSD_OK;
 }
@@ -19,6 +19,8 @@
 #define PSD_LAYER_DECODE_H
 
 #include "psd_layer_channel.h"
+#include "psd_stats.h"
+#include "psd_zip.h"
 #include "../include/openpsd/psd_types.h"
 #include "../include/openpsd/psd_error.h"
 #include "../include/openpsd/psd_export.h"
@@ -26,14 +28,18 @@
 /**
  * @brief Decode a layer channel's pixel data
  *
- * Decompresses the channel data if needed. Handles RAW and RLE formats.
- * ZIP-compressed data is left as-is if ZIP support is not enabled.
+ * Decompresses the channel data into a new plane if needed, with
+ * psd_layer_channel_decode_into(). ZIP-compressed data is left as-is if ZIP
+ * support is not enabled.
  *
  * @param channel Channel to decode (will be modified in-place)
  * @param width Layer width in pixels
  * @param height Layer height in pixels
  * @param depth Bit depth (8, 16, or 32)
  * @param allocator Memory allocator
+ * @param zip_pool Inflate states to reuse for ZIP channels, or NULL
+ * @param parallel_rows Let large RLE channels decode on worker threads
+ * @param stats Counters to record the decode (or the decode cache hit) in, or NULL
  * @return PSD_OK on success, error code on failure
  */
 PSD_INTERNAL psd_status_t psd_layer_channel_decode(
@@ -41,7 +47,63 @@ PSD_INTERNAL psd_status_t psd_layer_channel_decode(
     uint32_t width,
     uint32_t height,
     uint16_t depth,
-    const psd_allocator_t *allocator
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *zip_pool,
+    bool parallel_rows,
+    psd_stats_state_t *stats
+);
+
+/**
+ * @brief Decode a layer channel's pixel data into caller memory
+ *
+ * Row y of the plane is written at dst + y * dst_stride; bytes between rows
+ * are left alone. The channel itself is not modified and no plane buffer is
+ * allocated (ZIP inflate states come from zip_pool, RLE row ranges and
+ * 32-bit prediction use small work tables).
+ *
+ * @param channel Channel with its payload loaded
+ * @param width Layer width in pixels
+ * @param height Layer height in pixels
+ * @param depth Bit depth (1, 8, 16, or 32)
+ * @param dst Output, at least (height - 1) * dst_stride + row bytes long
+ * @param dst_stride Bytes between output rows (at least the row bytes)
+ * @param allocator Memory allocator for work tables
+ * @param zip_pool Inflate states to reuse for ZIP channels, or NULL
+ * @param parallel_rows Let large RLE channels decode on worker threads
+ * @param stats Counters to record the decode in, or NULL
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT if dst_stride is
+ *         shorter than a row, PSD_ERR_UNSUPPORTED_COMPRESSION for ZIP without
+ *         ZIP support, or another error code
+ */
+PSD_INTERNAL psd_status_t psd_layer_channel_decode_into(
+    const psd_layer_channel_data_t *channel,
+    uint32_t width,
+    uint32_t height,
+    uint16_t depth,
+    uint8_t *dst,
+    size_t dst_stride,
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *zip_pool,
+    bool parallel_rows,
+    psd_stats_state_t *stats
+);
+
+/**
+ * @brief Work out the byte counts table layout of an RLE layer channel
+ *
+ * @param channel RLE channel with its payload loaded
+ * @param height Layer height in pixels (number of counts)
+ * @param out_count_bytes Receives the count width (2 or 4)
+ * @param out_counts_size Receives the size of the counts table in bytes
+ * @param out_total_rle_bytes Receives the sum of all row counts
+ * @return PSD_OK on success, PSD_ERR_CORRUPT_DATA if no width fits the payload
+ */
+PSD_INTERNAL psd_status_t psd_layer_channel_rle_layout(
+    const psd_layer_channel_data_t *channel,
+    uint32_t height,
+    uint32_t *out_count_bytes,
+    uint64_t *out_counts_size,
+    uint64_t *out_total_rle_bytes
 );
 
 #endif /* PSD_LAYER_DECODE_H */
@@ -0,0 +1,193 @@
+/**
+ * @file psd_layer_fingerprint.c
+ * @brief Layer fingerprints hashed from compressed channel payloads
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_alloc.h"
+#include "psd_context.h"
+#include "psd_hash.h"
+#include "psd_threads.h"
+
+static void psd_put_be16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static void psd_put_be32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+static void psd_put_be64(uint8_t *p, uint64_t value)
+{
+    psd_put_be32(p, (uint32_t)(value >> 32));
+    psd_put_be32(p + 4, (uint32_t)value);
+}
+
+/* Chain (id, compression, length, payload hash) of each channel in record
+ * order; fields are serialized big-endian so the value is the same on
+ * every host */
+static psd_status_t psd_layer_pixel_hash_compute(psd_document_t *doc,
+                                                 psd_layer_record_t *layer,
+                                                 uint64_t *out_hash)
+{
+    uint64_t hash = (uint64_t)layer->channel_count;
+    for (size_t c = 0; c < layer->channel_count; c++) {
+        psd_layer_channel_data_t *channel = &layer->channels[c];
+        psd_status_t status = psd_document_load_channel(doc, channel);
+        if (status != PSD_OK) {
+            return status;
+        }
+        const uint64_t length = channel->compressed_data ? channel->compressed_length : 0;
+        uint8_t entry[20];
+        psd_put_be16(entry, (uint16_t)channel->channel_id);
+        psd_put_be16(entry + 2, channel->compression);
+        psd_put_be64(entry + 4, length);
+        psd_put_be64(entry + 12, psd_hash64(channel->compressed_data, (size_t)length, 0));
+        hash = psd_hash64(entry, sizeof(entry), hash);
+    }
+    *out_hash = hash;
+    return PSD_OK;
+}
+
+static psd_status_t psd_layer_pixel_hash(psd_document_t *doc, int32_t layer_index,
+                                         uint64_t *out_hash)
+{
+    /* Hashed once; threads asking meanwhile wait, a failure is retried */
+    psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    if (psd_once_enter(&layer->pixel_hash_once)) {
+        uint64_t hash = 0;
+        psd_status_t status = psd_layer_pixel_hash_compute(doc, layer, &hash);
+        if (status != PSD_OK) {
+            psd_once_reset(&layer->pixel_hash_once);
+            return status;
+        }
+        layer->pixel_hash = hash;
+        psd_once_publish(&layer->pixel_hash_once);
+    }
+    *out_hash = layer->pixel_hash;
+    return PSD_OK;
+}
+
+/* Record fields are folded in on every call; they can change after parsing */
+static uint64_t psd_layer_fingerprint_finish(const psd_layer_record_t *layer,
+                                             uint64_t pixel_hash)
+{
+    uint8_t fields[23];
+    psd_put_be32(fields, (uint32_t)layer->bounds.top);
+    psd_put_be32(fields + 4, (uint32_t)layer->bounds.left);
+    psd_put_be32(fields + 8, (uint32_t)layer->bounds.bottom);
+    psd_put_be32(fields + 12, (uint32_t)layer->bounds.right);
+    psd_put_be32(fields + 16, layer->blend_key);
+    fields[20] = layer->opacity;
+    fields[21] = layer->clipping;
+    fields[22] = layer->flags;
+    return psd_hash64(fields, sizeof(fields), pixel_hash);
+}
+
+PSD_API psd_status_t psd_document_get_layer_fingerprint(psd_document_t *doc,
+                                                        int32_t layer_index,
+                                                        uint64_t *out_fingerprint)
+{
+    if (!doc || !out_fingerprint) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (layer_index < 0 || layer_index >= doc->layers.layer_count) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    uint64_t pixel_hash = 0;
+    psd_status_t status = psd_layer_pixel_hash(doc, layer_index, &pixel_hash);
+    if (status != PSD_OK) {
+        return status;
+    }
+    *out_fingerprint = psd_layer_fingerprint_finish(&doc->layers.layers[layer_index], pixel_hash);
+    return PSD_OK;
+}
+
+/* One layer of psd_document_get_layer_fingerprints() */
+typedef struct {
+    psd_document_t *doc;
+    uint64_t *out;
+    psd_status_t *status;
+} psd_fingerprint_batch_t;
+
+static void psd_fingerprint_job_run(void *task_data, size_t index)
+{
+    psd_fingerprint_batch_t *batch = (psd_fingerprint_batch_t *)task_data;
+    batch->status[index] = psd_document_get_layer_fingerprint(batch->doc, (int32_t)index,
+                                                              &batch->out[index]);
+}
+
+PSD_API psd_status_t psd_document_get_layer_fingerprints(psd_document_t *doc,
+                                                         const psd_thread_pool_t *pool,
+                                                         uint64_t *out_fingerprints,
+                                                         size_t capacity)
+{
+    if (!doc) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    const size_t count = doc->layers.layer_count > 0 ? (size_t)doc->layers.layer_count : 0;
+    if (count == 0) {
+        return PSD_OK;
+    }
+    if (!out_fingerprints) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (capacity < count) {
+        return PSD_ERR_BUFFER_TOO_SMALL;
+    }
+
+    psd_status_t *status = (psd_status_t *)psd_alloc_malloc(doc->allocator,
+                                                            count * sizeof(*status));
+    int32_t *pending = (int32_t *)psd_alloc_malloc(doc->allocator, count * sizeof(*pending));
+    if (!status || !pending) {
+        psd_alloc_free(doc->allocator, status);
+        psd_alloc_free(doc->allocator, pending);
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+
+    /* Deferred payloads come from the shared source stream, so the layers
+     * not hashed yet are read here, in order, before the tasks start */
+    size_t pending_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!psd_once_done(&doc->layers.layers[i].pixel_hash_once)) {
+            pending[pending_count++] = (int32_t)i;
+        }
+    }
+    psd_status_t result = PSD_OK;
+    if (pending_count > 0) {
+        (void)psd_document_prefetch_layers(doc, pending, pending_count);
+    }
+    for (size_t i = 0; i < pending_count && result == PSD_OK; i++) {
+        psd_layer_record_t *layer = &doc->layers.layers[pending[i]];
+        for (size_t c = 0; c < layer->channel_count && result == PSD_OK; c++) {
+            result = psd_document_load_channel(doc, &layer->channels[c]);
+        }
+    }
+    psd_alloc_free(doc->allocator, pending);
+
+    if (result == PSD_OK) {
+        psd_fingerprint_batch_t batch = { doc, out_fingerprints, status };
+        psd_parallel_for(pool, count, psd_fingerprint_job_run, &batch);
+        for (size_t i = 0; i < count && result == PSD_OK; i++) {
+            result = status[i];
+        }
+    }
+    psd_alloc_free(doc->allocator, status);
+    return result;
+}
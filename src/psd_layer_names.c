@@ -0,0 +1,106 @@
+/**
+ * @file psd_layer_names.c
+ * @brief Hash index from layer names to layer indices
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_layer_names.h"
+#include "psd_alloc.h"
+#include "psd_context.h"
+
+#include <string.h>
+
+#define PSD_FNV_OFFSET 0xcbf29ce484222325ull
+#define PSD_FNV_PRIME 0x100000001b3ull
+
+static uint64_t fnv1a(const uint8_t *data, size_t length)
+{
+    uint64_t hash = PSD_FNV_OFFSET;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= PSD_FNV_PRIME;
+    }
+    return hash;
+}
+
+static bool name_equals(const psd_layer_record_t *layer, const uint8_t *name, size_t length)
+{
+    return layer->name && layer->name_length == length &&
+           (length == 0 || memcmp(layer->name, name, length) == 0);
+}
+
+psd_status_t psd_layer_names_build(psd_document_t *doc)
+{
+    psd_layer_names_t *names = &doc->layer_names;
+    names->slots = NULL;
+    names->mask = 0;
+    if (doc->layers.layer_count <= 0) {
+        return PSD_OK;
+    }
+
+    /* At most half full, so probes stay short */
+    uint32_t slot_count = 16;
+    while (slot_count < (uint32_t)doc->layers.layer_count * 2u) {
+        slot_count *= 2;
+    }
+
+    uint32_t *slots = (uint32_t *)psd_alloc_malloc(&doc->meta.allocator,
+                                                   (size_t)slot_count * sizeof(uint32_t));
+    if (!slots) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    memset(slots, 0, (size_t)slot_count * sizeof(uint32_t));
+
+    /* Inserted in layer order: with linear probing a duplicate name always
+     * lands after the earlier layer, so lookups find the lowest index */
+    uint32_t mask = slot_count - 1;
+    for (int32_t i = 0; i < doc->layers.layer_count; i++) {
+        const psd_layer_record_t *layer = &doc->layers.layers[i];
+        if (!layer->name) {
+            continue;
+        }
+        uint32_t slot = (uint32_t)fnv1a(layer->name, layer->name_length) & mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = (uint32_t)i + 1u;
+    }
+
+    names->slots = slots;
+    names->mask = mask;
+    return PSD_OK;
+}
+
+int32_t psd_layer_names_find(const psd_document_t *doc, const uint8_t *name, size_t length)
+{
+    const psd_layer_names_t *names = &doc->layer_names;
+
+    /* Not indexed (out of memory while parsing): scan the records */
+    if (!names->slots) {
+        for (int32_t i = 0; i < doc->layers.layer_count; i++) {
+            if (name_equals(&doc->layers.layers[i], name, length)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    uint32_t slot = (uint32_t)fnv1a(name, length) & names->mask;
+    while (names->slots[slot] != 0) {
+        int32_t index = (int32_t)(names->slots[slot] - 1u);
+        if (name_equals(&doc->layers.layers[index], name, length)) {
+            return index;
+        }
+        slot = (slot + 1) & names->mask;
+    }
+    return -1;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file psd_layer_names.h
+ * @brief Hash index from layer names to layer indices
+ *
+ * Built once the layer records are parsed, so psd_document_find_layer_by_name()
+ * costs one hash and a short probe instead of a walk over every layer. The
+ * table uses open addressing with linear probing and is never modified after
+ * it is built, which keeps lookups on a shared document free of locks.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_LAYER_NAMES_H
+#define PSD_LAYER_NAMES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/openpsd/psd.h"
+#include "../include/openpsd/psd_export.h"
+
+/**
+ * @brief Name index of one document
+ */
+typedef struct {
+    uint32_t *slots;   /**< Layer index + 1 per slot, 0 = empty (metadata arena) */
+    uint32_t mask;     /**< Slot count - 1; slots is NULL when the index was not built */
+} psd_layer_names_t;
+
+/**
+ * @brief Index the names of every parsed layer
+ *
+ * @param doc Document whose layer records are parsed; the index goes in doc->layer_names
+ * @return PSD_OK, or PSD_ERR_OUT_OF_MEMORY (lookups then fall back to a scan)
+ */
+PSD_INTERNAL psd_status_t psd_layer_names_build(psd_document_t *doc);
+
+/**
+ * @brief Find the lowest layer index with exactly this name
+ *
+ * @param doc Document to search
+ * @param name UTF-8 name bytes
+ * @param length Name length in bytes
+ * @return Layer index, or -1 if no layer has that name
+ */
+PSD_INTERNAL int32_t psd_layer_names_find(const psd_document_t *doc,
+                                          const uint8_t *name,
+                                          size_t length);
+
+#endif /* PSD_LAYER_NAMES_H */
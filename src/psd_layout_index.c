@@ -0,0 +1,226 @@
+/**
+ * @file psd_layout_index.c
+ * @brief Saved layer section layout for re-opening documents without a scan
+ *
+ * The index stores what a full parse learns about the layer section that the
+ * records themselves do not say: which length widths a PSB writer used and
+ * where each channel payload starts. psd_parse_with_index() reads the records
+ * with that knowledge and skips the walk over the channel image data.
+ *
+ * Format (big-endian):
+ *   0  "OPXI", u16 version, u16 flags (bit 0 PSB, bit 1 lengths exclude
+ *      the compression field), u8 section length width, u8 layer info
+ *      length width, u16 reserved, u32 layer count
+ *   16 u64 source tag, u64 records hash, u64 section start,
+ *      u64 channel data start, u64 channel count
+ *   56 channel entries: u64 payload offset, u64 payload length,
+ *      u8 compression, u8 record length width
+ *   .. u64 FNV-1a checksum of everything before it
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_layout_index.h"
+#include "psd_context.h"
+#include "psd_endian.h"
+
+#include <string.h>
+
+#define PSD_INDEX_VERSION 1u
+#define PSD_INDEX_HEADER_SIZE 56u
+#define PSD_INDEX_ENTRY_SIZE 18u
+#define PSD_INDEX_CHECKSUM_SIZE 8u
+#define PSD_INDEX_FLAG_PSB 0x1u
+#define PSD_INDEX_FLAG_LENGTHS_EXCLUDE 0x2u
+
+/* The file header is the 26 bytes before the color mode data */
+#define PSD_FILE_HEADER_SIZE 26u
+
+#define PSD_FNV_OFFSET 0xcbf29ce484222325ull
+#define PSD_FNV_PRIME 0x100000001b3ull
+
+static uint64_t fnv1a(uint64_t hash, const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= PSD_FNV_PRIME;
+    }
+    return hash;
+}
+
+static psd_status_t hash_range(psd_stream_t *stream, uint64_t offset, uint64_t length,
+                               uint64_t *hash)
+{
+    uint8_t chunk[4096];
+    while (length > 0) {
+        size_t want = length < sizeof(chunk) ? (size_t)length : sizeof(chunk);
+        int64_t got = psd_stream_read_at(stream, offset, chunk, want);
+        if (got < 0) return (psd_status_t)got;
+        if ((size_t)got != want) return PSD_ERR_STREAM_EOF;
+        *hash = fnv1a(*hash, chunk, want);
+        offset += want;
+        length -= want;
+    }
+    return PSD_OK;
+}
+
+static bool valid_width(uint8_t width)
+{
+    return width == 4 || width == 8;
+}
+
+PSD_INTERNAL psd_status_t psd_layout_index_hash(psd_stream_t *stream,
+                                                const psd_layer_layout_t *layout,
+                                                uint64_t *out_hash)
+{
+    if (layout->section_start < (int64_t)PSD_FILE_HEADER_SIZE ||
+        layout->channel_data_start < layout->section_start) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    uint64_t hash = PSD_FNV_OFFSET;
+    psd_status_t st = hash_range(stream, 0, PSD_FILE_HEADER_SIZE, &hash);
+    if (st != PSD_OK) return st;
+    st = hash_range(stream, (uint64_t)layout->section_start,
+                    (uint64_t)(layout->channel_data_start - layout->section_start), &hash);
+    if (st != PSD_OK) return st;
+
+    *out_hash = hash;
+    return PSD_OK;
+}
+
+PSD_INTERNAL psd_status_t psd_layout_index_decode(const uint8_t *data, size_t size,
+                                                  psd_layout_index_t *index)
+{
+    if (size < PSD_INDEX_HEADER_SIZE + PSD_INDEX_CHECKSUM_SIZE ||
+        memcmp(data, "OPXI", 4) != 0 || psd_read_be16(data + 4) != PSD_INDEX_VERSION) {
+        return PSD_ERR_INVALID_FORMAT;
+    }
+
+    uint64_t channel_count = psd_read_be64(data + 48);
+    if (channel_count > (size - PSD_INDEX_HEADER_SIZE - PSD_INDEX_CHECKSUM_SIZE) /
+                            PSD_INDEX_ENTRY_SIZE) {
+        return PSD_ERR_INVALID_FORMAT;
+    }
+    size_t body = PSD_INDEX_HEADER_SIZE + (size_t)channel_count * PSD_INDEX_ENTRY_SIZE;
+    if (size != body + PSD_INDEX_CHECKSUM_SIZE ||
+        psd_read_be64(data + body) != fnv1a(PSD_FNV_OFFSET, data, body)) {
+        return PSD_ERR_INVALID_FORMAT;
+    }
+
+    uint16_t flags = psd_read_be16(data + 6);
+    memset(index, 0, sizeof(*index));
+    index->is_psb = (flags & PSD_INDEX_FLAG_PSB) != 0;
+    index->layout.recorded = true;
+    index->layout.lengths_exclude_compression = (flags & PSD_INDEX_FLAG_LENGTHS_EXCLUDE) != 0;
+    index->layout.section_length_bytes = data[8];
+    index->layout.info_length_bytes = data[9];
+    index->layer_count = psd_read_be32(data + 12);
+    index->source_tag = psd_read_be64(data + 16);
+    index->records_hash = psd_read_be64(data + 24);
+    uint64_t section_start = psd_read_be64(data + 32);
+    uint64_t channel_data_start = psd_read_be64(data + 40);
+    index->channel_count = channel_count;
+    index->channels = data + PSD_INDEX_HEADER_SIZE;
+
+    if (!valid_width(index->layout.section_length_bytes) ||
+        !valid_width(index->layout.info_length_bytes) || index->layer_count > 0x7FFFu ||
+        section_start > (uint64_t)INT64_MAX || channel_data_start > (uint64_t)INT64_MAX ||
+        channel_data_start < section_start) {
+        return PSD_ERR_INVALID_FORMAT;
+    }
+    index->layout.section_start = (int64_t)section_start;
+    index->layout.channel_data_start = (int64_t)channel_data_start;
+
+    for (uint64_t n = 0; n < channel_count; n++) {
+        const uint8_t *entry = index->channels + n * PSD_INDEX_ENTRY_SIZE;
+        if (entry[16] > 3 || !valid_width(entry[17]) ||
+            psd_read_be64(entry) > (uint64_t)INT64_MAX ||
+            psd_read_be64(entry + 8) > (uint64_t)INT64_MAX - psd_read_be64(entry)) {
+            return PSD_ERR_INVALID_FORMAT;
+        }
+    }
+    return PSD_OK;
+}
+
+PSD_INTERNAL uint8_t psd_layout_index_channel(const psd_layout_index_t *index, uint64_t n,
+                                              psd_layer_channel_data_t *channel)
+{
+    const uint8_t *entry = index->channels + n * PSD_INDEX_ENTRY_SIZE;
+    if (channel) {
+        channel->file_offset = psd_read_be64(entry);
+        channel->compressed_length = psd_read_be64(entry + 8);
+        channel->compression = entry[16];
+    }
+    return entry[17];
+}
+
+/**
+ * @brief Save the document's layer section layout
+ */
+PSD_API psd_status_t psd_document_save_index(const psd_document_t *doc,
+                                             psd_stream_t *stream,
+                                             uint64_t source_tag,
+                                             uint8_t *out_index,
+                                             size_t out_index_size,
+                                             size_t *out_required_size)
+{
+    if (!doc || !stream) return PSD_ERR_NULL_POINTER;
+    if (!doc->layout.recorded) return PSD_ERR_INVALID_ARGUMENT;
+
+    uint64_t channel_count = 0;
+    for (int32_t i = 0; i < doc->layers.layer_count; i++) {
+        channel_count += doc->layers.layers[i].channel_count;
+    }
+    uint64_t required64 = PSD_INDEX_HEADER_SIZE + channel_count * PSD_INDEX_ENTRY_SIZE +
+                          PSD_INDEX_CHECKSUM_SIZE;
+    if (required64 > (uint64_t)SIZE_MAX) return PSD_ERR_OUT_OF_RANGE;
+    if (out_required_size) *out_required_size = (size_t)required64;
+    if (!out_index || out_index_size < (size_t)required64) return PSD_ERR_BUFFER_TOO_SMALL;
+
+    uint64_t records_hash = 0;
+    psd_status_t st = psd_layout_index_hash(stream, &doc->layout, &records_hash);
+    if (st != PSD_OK) return st;
+
+    uint16_t flags = 0;
+    if (doc->is_psb) flags |= PSD_INDEX_FLAG_PSB;
+    if (doc->layout.lengths_exclude_compression) flags |= PSD_INDEX_FLAG_LENGTHS_EXCLUDE;
+
+    memcpy(out_index, "OPXI", 4);
+    psd_write_be16(out_index + 4, PSD_INDEX_VERSION);
+    psd_write_be16(out_index + 6, flags);
+    out_index[8] = doc->layout.section_length_bytes;
+    out_index[9] = doc->layout.info_length_bytes;
+    psd_write_be16(out_index + 10, 0);
+    psd_write_be32(out_index + 12, (uint32_t)doc->layers.layer_count);
+    psd_write_be64(out_index + 16, source_tag);
+    psd_write_be64(out_index + 24, records_hash);
+    psd_write_be64(out_index + 32, (uint64_t)doc->layout.section_start);
+    psd_write_be64(out_index + 40, (uint64_t)doc->layout.channel_data_start);
+    psd_write_be64(out_index + 48, channel_count);
+
+    uint8_t *entry = out_index + PSD_INDEX_HEADER_SIZE;
+    for (int32_t i = 0; i < doc->layers.layer_count; i++) {
+        const psd_layer_record_t *layer = &doc->layers.layers[i];
+        for (size_t c = 0; c < layer->channel_count; c++) {
+            const psd_layer_channel_data_t *channel = &layer->channels[c];
+            psd_write_be64(entry, channel->file_offset);
+            psd_write_be64(entry + 8, channel->compressed_length);
+            entry[16] = channel->compression;
+            entry[17] = channel->length_bytes;
+            entry += PSD_INDEX_ENTRY_SIZE;
+        }
+    }
+
+    size_t body = (size_t)(entry - out_index);
+    psd_write_be64(entry, fnv1a(PSD_FNV_OFFSET, out_index, body));
+    return PSD_OK;
+}
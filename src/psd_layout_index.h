@@ -0,0 +1,83 @@
+/**
+ * @file psd_layout_index.h
+ * @brief Saved layer section layout for re-opening documents without a scan
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_LAYOUT_INDEX_H
+#define PSD_LAYOUT_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <openpsd/psd.h>
+#include "psd_layer_channel.h"
+
+/**
+ * @brief Where the parse found the layer section and how it was laid out
+ *
+ * Recorded by every parse that reaches the layer section so the layout can be
+ * saved with psd_document_save_index().
+ */
+typedef struct {
+    bool recorded;                    /**< The layer section was fully parsed */
+    int64_t section_start;            /**< Offset of the section length field */
+    int64_t channel_data_start;       /**< Offset of the channel image data (end of the records) */
+    uint8_t section_length_bytes;     /**< Width of the section length (4 or 8) */
+    uint8_t info_length_bytes;        /**< Width of the layer info length (4 or 8) */
+    bool lengths_exclude_compression; /**< Channel lengths omit the 2-byte compression field */
+} psd_layer_layout_t;
+
+/**
+ * @brief Decoded view of a saved index (points into the caller's bytes)
+ */
+typedef struct {
+    psd_layer_layout_t layout;  /**< Layer section layout */
+    bool is_psb;                /**< Index was saved from a PSB document */
+    uint32_t layer_count;       /**< Number of layer records */
+    uint64_t channel_count;     /**< Number of channel entries */
+    uint64_t source_tag;        /**< Caller's tag for the source file */
+    uint64_t records_hash;      /**< Hash of the header and layer records */
+    const uint8_t *channels;    /**< Packed channel entries */
+} psd_layout_index_t;
+
+/**
+ * @brief Validate and decode a saved index
+ *
+ * @return PSD_OK, or PSD_ERR_INVALID_FORMAT if the bytes are not an intact index
+ */
+PSD_INTERNAL psd_status_t psd_layout_index_decode(const uint8_t *data, size_t size,
+                                                  psd_layout_index_t *index);
+
+/**
+ * @brief Apply one saved channel entry
+ *
+ * Sets the channel's compression, payload offset and payload length.
+ *
+ * @param index Decoded index
+ * @param n Entry number, in layer then channel order
+ * @param channel Channel to fill in (may be NULL to only query the width)
+ * @return Width of the channel's length field in the layer record (4 or 8)
+ */
+PSD_INTERNAL uint8_t psd_layout_index_channel(const psd_layout_index_t *index, uint64_t n,
+                                              psd_layer_channel_data_t *channel);
+
+/**
+ * @brief Hash the bytes a layout depends on
+ *
+ * Covers the file header and the layer section up to the channel image data.
+ * If these bytes are unchanged, so are every record and channel offset.
+ */
+PSD_INTERNAL psd_status_t psd_layout_index_hash(psd_stream_t *stream,
+                                                const psd_layer_layout_t *layout,
+                                                uint64_t *out_hash);
+
+#endif /* PSD_LAYOUT_INDEX_H */
@@ -0,0 +1,190 @@
+/**
+ * @file psd_once.h
+ * @brief Lock-free one-time initialization flag
+ *
+ * Guards process-wide tables that are built on first use. A caller that finds
+ * the flag idle claims it and builds; callers that arrive while a build is in
+ * progress do not wait and take their slow path instead. Once published, the
+ * guarded data is read-only.
+ *
+ * psd_once_reset() returns a flag to idle, so claim/reset also serves as a
+ * non-blocking try-lock around reusable objects.
+ *
+ * psd_refcount_t is a reference count shared by the owners of one object;
+ * the owner that drops the last reference frees it.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_ONCE_H
+#define PSD_ONCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PSD_ONCE_IDLE 0
+#define PSD_ONCE_BUSY 1
+#define PSD_ONCE_DONE 2
+
+#if defined(_MSC_VER) && !defined(__clang__)
+
+#include <intrin.h>
+
+typedef struct {
+    volatile long state;
+} psd_once_t;
+
+static inline bool psd_once_done(psd_once_t *once)
+{
+    return _InterlockedCompareExchange(&once->state, PSD_ONCE_DONE, PSD_ONCE_DONE) == PSD_ONCE_DONE;
+}
+
+static inline bool psd_once_claim(psd_once_t *once)
+{
+    return _InterlockedCompareExchange(&once->state, PSD_ONCE_BUSY, PSD_ONCE_IDLE) == PSD_ONCE_IDLE;
+}
+
+static inline void psd_once_publish(psd_once_t *once)
+{
+    (void)_InterlockedExchange(&once->state, PSD_ONCE_DONE);
+}
+
+static inline void psd_once_reset(psd_once_t *once)
+{
+    (void)_InterlockedExchange(&once->state, PSD_ONCE_IDLE);
+}
+
+typedef struct {
+    volatile long count;
+} psd_refcount_t;
+
+static inline void psd_refcount_init(psd_refcount_t *ref)
+{
+    (void)_InterlockedExchange(&ref->count, 1);
+}
+
+static inline void psd_refcount_retain(psd_refcount_t *ref)
+{
+    (void)_InterlockedIncrement(&ref->count);
+}
+
+/* True when the last reference was dropped */
+static inline bool psd_refcount_release(psd_refcount_t *ref)
+{
+    return _InterlockedDecrement(&ref->count) == 0;
+}
+
+#elif !defined(__STDC_NO_ATOMICS__)
+
+#include <stdatomic.h>
+
+typedef struct {
+    atomic_int state;
+} psd_once_t;
+
+static inline bool psd_once_done(psd_once_t *once)
+{
+    return atomic_load_explicit(&once->state, memory_order_acquire) == PSD_ONCE_DONE;
+}
+
+static inline bool psd_once_claim(psd_once_t *once)
+{
+    int expected = PSD_ONCE_IDLE;
+    return atomic_compare_exchange_strong_explicit(&once->state, &expected, PSD_ONCE_BUSY,
+                                                   memory_order_acquire,
+                                                   memory_order_relaxed);
+}
+
+static inline void psd_once_publish(psd_once_t *once)
+{
+    atomic_store_explicit(&once->state, PSD_ONCE_DONE, memory_order_release);
+}
+
+static inline void psd_once_reset(psd_once_t *once)
+{
+    atomic_store_explicit(&once->state, PSD_ONCE_IDLE, memory_order_release);
+}
+
+typedef struct {
+    atomic_size_t count;
+} psd_refcount_t;
+
+static inline void psd_refcount_init(psd_refcount_t *ref)
+{
+    atomic_init(&ref->count, 1);
+}
+
+static inline void psd_refcount_retain(psd_refcount_t *ref)
+{
+    atomic_fetch_add_explicit(&ref->count, 1, memory_order_relaxed);
+}
+
+/* True when the last reference was dropped; acq_rel so the owner that frees
+ * sees every other owner's accesses as finished */
+static inline bool psd_refcount_release(psd_refcount_t *ref)
+{
+    return atomic_fetch_sub_explicit(&ref->count, 1, memory_order_acq_rel) == 1;
+}
+
+#else
+
+/* No atomics: correct for single-threaded use only */
+typedef struct {
+    int state;
+} psd_once_t;
+
+static inline bool psd_once_done(psd_once_t *once)
+{
+    return once->state == PSD_ONCE_DONE;
+}
+
+static inline bool psd_once_claim(psd_once_t *once)
+{
+    if (once->state != PSD_ONCE_IDLE) return false;
+    once->state = PSD_ONCE_BUSY;
+    return true;
+}
+
+static inline void psd_once_publish(psd_once_t *once)
+{
+    once->state = PSD_ONCE_DONE;
+}
+
+static inline void psd_once_reset(psd_once_t *once)
+{
+    once->state = PSD_ONCE_IDLE;
+}
+
+typedef struct {
+    size_t count;
+} psd_refcount_t;
+
+static inline void psd_refcount_init(psd_refcount_t *ref)
+{
+    ref->count = 1;
+}
+
+static inline void psd_refcount_retain(psd_refcount_t *ref)
+{
+    ref->count++;
+}
+
+static inline bool psd_refcount_release(psd_refcount_t *ref)
+{
+    return --ref->count == 0;
+}
+
+#endif
+
+/** Static initializer for psd_once_t */
+#define PSD_ONCE_INIT { PSD_ONCE_IDLE }
+
+#endif /* PSD_ONCE_H */
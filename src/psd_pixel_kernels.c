@@ -0,0 +1,759 @@
+/**
+ * @file psd_pixel_kernels.c
+ * @brief Specialized planar-to-RGBA8 row conversion kernels
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_pixel_kernels.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PSD_KERNELS_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define PSD_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* ----------------------------
+ * Portable kernels
+ *
+ * BPS is bytes per sample; 16-bit samples are big-endian, so the MSB comes
+ * first and is the 8-bit value.
+ * ---------------------------- */
+
+static inline uint8_t cmyk_to_u8(uint8_t ch, uint8_t k)
+{
+    unsigned sum = (unsigned)ch + (unsigned)k;
+    return (uint8_t)(255u - (sum > 255u ? 255u : sum));
+}
+
+#define PSD_DEFINE_SCALAR_KERNELS(SUFFIX, BPS)                                        \
+static void rgb_row_##SUFFIX(const uint8_t *const *rows, size_t x0, size_t count,     \
+                             uint8_t *out)                                            \
+{                                                                                     \
+    const uint8_t *r = rows[0] + x0 * (BPS);                                          \
+    const uint8_t *g = rows[1] + x0 * (BPS);                                          \
+    const uint8_t *b = rows[2] + x0 * (BPS);                                          \
+    for (size_t i = 0; i < count; i++) {                                              \
+        out[i * 4 + 0] = r[i * (BPS)];                                                \
+        out[i * 4 + 1] = g[i * (BPS)];                                                \
+        out[i * 4 + 2] = b[i * (BPS)];                                                \
+        out[i * 4 + 3] = 255;                                                         \
+    }                                                                                 \
+}                                                                                     \
+static void rgba_row_##SUFFIX(const uint8_t *const *rows, size_t x0, size_t count,    \
+                              uint8_t *out)                                           \
+{                                                                                     \
+    const uint8_t *r = rows[0] + x0 * (BPS);                                          \
+    const uint8_t *g = rows[1] + x0 * (BPS);                                          \
+    const uint8_t *b = rows[2] + x0 * (BPS);                                          \
+    const uint8_t *a = rows[3] + x0 * (BPS);                                          \
+    for (size_t i = 0; i < count; i++) {                                              \
+        out[i * 4 + 0] = r[i * (BPS)];                                                \
+        out[i * 4 + 1] = g[i * (BPS)];                                                \
+        out[i * 4 + 2] = b[i * (BPS)];                                                \
+        out[i * 4 + 3] = a[i * (BPS)];                                                \
+    }                                                                                 \
+}                                                                                     \
+static void gray_row_##SUFFIX(const uint8_t *const *rows, size_t x0, size_t count,    \
+                              uint8_t *out)                                           \
+{                                                                                     \
+    const uint8_t *v = rows[0] + x0 * (BPS);                                          \
+    for (size_t i = 0; i < count; i++) {                                              \
+        out[i * 4 + 0] = v[i * (BPS)];                                                \
+        out[i * 4 + 1] = v[i * (BPS)];                                                \
+        out[i * 4 + 2] = v[i * (BPS)];                                                \
+        out[i * 4 + 3] = 255;                                                         \
+    }                                                                                 \
+}                                                                                     \
+static void graya_row_##SUFFIX(const uint8_t *const *rows, size_t x0, size_t count,   \
+                               uint8_t *out)                                          \
+{                                                                                     \
+    const uint8_t *v = rows[0] + x0 * (BPS);                                          \
+    const uint8_t *a = rows[1] + x0 * (BPS);                                          \
+    for (size_t i = 0; i < count; i++) {                                              \
+        out[i * 4 + 0] = v[i * (BPS)];                                                \
+        out[i * 4 + 1] = v[i * (BPS)];                                                \
+        out[i * 4 + 2] = v[i * (BPS)];                                                \
+        out[i * 4 + 3] = a[i * (BPS)];                                                \
+    }                                                                                 \
+}                                                                                     \
+static void cmyk_row_##SUFFIX(const uint8_t *const *rows, size_t x0, size_t count,    \
+                              uint8_t *out)                                           \
+{                                                                                     \
+    const uint8_t *c = rows[0] + x0 * (BPS);                                          \
+    const uint8_t *m = rows[1] + x0 * (BPS);                                          \
+    const uint8_t *y = rows[2] + x0 * (BPS);                                          \
+    const uint8_t *k = rows[3] + x0 * (BPS);                                          \
+    for (size_t i = 0; i < count; i++) {                                              \
+        out[i * 4 + 0] = cmyk_to_u8(c[i * (BPS)], k[i * (BPS)]);                      \
+        out[i * 4 + 1] = cmyk_to_u8(m[i * (BPS)], k[i * (BPS)]);                      \
+        out[i * 4 + 2] = cmyk_to_u8(y[i * (BPS)], k[i * (BPS)]);                      \
+        out[i * 4 + 3] = 255;                                                         \
+    }                                                                                 \
+}                                                                                     \
+static void cmyka_row_##SUFFIX(const uint8_t *const *rows, size_t x0, size_t count,   \
+                               uint8_t *out)                                          \
+{                                                                                     \
+    const uint8_t *c = rows[0] + x0 * (BPS);                                          \
+    const uint8_t *m = rows[1] + x0 * (BPS);                                          \
+    const uint8_t *y = rows[2] + x0 * (BPS);                                          \
+    const uint8_t *k = rows[3] + x0 * (BPS);                                          \
+    const uint8_t *a = rows[4] + x0 * (BPS);                                          \
+    for (size_t i = 0; i < count; i++) {                                              \
+        out[i * 4 + 0] = cmyk_to_u8(c[i * (BPS)], k[i * (BPS)]);                      \
+        out[i * 4 + 1] = cmyk_to_u8(m[i * (BPS)], k[i * (BPS)]);                      \
+        out[i * 4 + 2] = cmyk_to_u8(y[i * (BPS)], k[i * (BPS)]);                      \
+        out[i * 4 + 3] = a[i * (BPS)];                                                \
+    }                                                                                 \
+}
+
+PSD_DEFINE_SCALAR_KERNELS(scalar8, 1)
+PSD_DEFINE_SCALAR_KERNELS(scalar16, 2)
+
+/* ----------------------------
+ * Vector kernels (8-bit, 16 pixels per step)
+ * ---------------------------- */
+
+#if defined(PSD_KERNELS_SSE2)
+
+/* Interleave 16 pixels of four planes into 64 bytes of RGBA */
+static inline void store_rgba16(uint8_t *out, __m128i r, __m128i g, __m128i b, __m128i a)
+{
+    __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+    __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+    __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+    __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+    _mm_storeu_si128((__m128i *)(void *)(out + 0), _mm_unpacklo_epi16(rg_lo, ba_lo));
+    _mm_storeu_si128((__m128i *)(void *)(out + 16), _mm_unpackhi_epi16(rg_lo, ba_lo));
+    _mm_storeu_si128((__m128i *)(void *)(out + 32), _mm_unpacklo_epi16(rg_hi, ba_hi));
+    _mm_storeu_si128((__m128i *)(void *)(out + 48), _mm_unpackhi_epi16(rg_hi, ba_hi));
+}
+
+#define PSD_VLOAD(p) _mm_loadu_si128((const __m128i *)(const void *)(p))
+#define PSD_VSPLAT_FF() _mm_set1_epi8((char)0xFF)
+/* 255 - min(255, c + k) == ~saturating_add(c, k) */
+#define PSD_VCMYK(c, k) _mm_xor_si128(_mm_adds_epu8((c), (k)), PSD_VSPLAT_FF())
+#define PSD_HAVE_VECTOR 1
+
+#elif defined(PSD_KERNELS_NEON)
+
+static inline void store_rgba16(uint8_t *out, uint8x16_t r, uint8x16_t g, uint8x16_t b, uint8x16_t a)
+{
+    uint8x16x4_t px;
+    px.val[0] = r;
+    px.val[1] = g;
+    px.val[2] = b;
+    px.val[3] = a;
+    vst4q_u8(out, px);
+}
+
+#define PSD_VLOAD(p) vld1q_u8(p)
+#define PSD_VSPLAT_FF() vdupq_n_u8(0xFF)
+#define PSD_VCMYK(c, k) vmvnq_u8(vqaddq_u8((c), (k)))
+#define PSD_HAVE_VECTOR 1
+
+#endif
+
+#if defined(PSD_HAVE_VECTOR)
+
+static void rgb_row_vec8(const uint8_t *const *rows, size_t x0, size_t count, uint8_t *out)
+{
+    const uint8_t *r = rows[0] + x0, *g = rows[1] + x0, *b = rows[2] + x0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        store_rgba16(out + i * 4, PSD_VLOAD(r + i), PSD_VLOAD(g + i), PSD_VLOAD(b + i),
+                     PSD_VSPLAT_FF());
+    }
+    rgb_row_scalar8(rows, x0 + i, count - i, out + i * 4);
+}
+
+static void rgba_row_vec8(const uint8_t *const *rows, size_t x0, size_t count, uint8_t *out)
+{
+    const uint8_t *r = rows[0] + x0, *g = rows[1] + x0, *b = rows[2] + x0, *a = rows[3] + x0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        store_rgba16(out + i * 4, PSD_VLOAD(r + i), PSD_VLOAD(g + i), PSD_VLOAD(b + i),
+                     PSD_VLOAD(a + i));
+    }
+    rgba_row_scalar8(rows, x0 + i, count - i, out + i * 4);
+}
+
+static void gray_row_vec8(const uint8_t *const *rows, size_t x0, size_t count, uint8_t *out)
+{
+    const uint8_t *v = rows[0] + x0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        store_rgba16(out + i * 4, PSD_VLOAD(v + i), PSD_VLOAD(v + i), PSD_VLOAD(v + i),
+                     PSD_VSPLAT_FF());
+    }
+    gray_row_scalar8(rows, x0 + i, count - i, out + i * 4);
+}
+
+static void graya_row_vec8(const uint8_t *const *rows, size_t x0, size_t count, uint8_t *out)
+{
+    const uint8_t *v = rows[0] + x0, *a = rows[1] + x0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        store_rgba16(out + i * 4, PSD_VLOAD(v + i), PSD_VLOAD(v + i), PSD_VLOAD(v + i),
+                     PSD_VLOAD(a + i));
+    }
+    graya_row_scalar8(rows, x0 + i, count - i, out + i * 4);
+}
+
+static void cmyk_row_vec8(const uint8_t *const *rows, size_t x0, size_t count, uint8_t *out)
+{
+    const uint8_t *c = rows[0] + x0, *m = rows[1] + x0, *y = rows[2] + x0, *k = rows[3] + x0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        store_rgba16(out + i * 4,
+                     PSD_VCMYK(PSD_VLOAD(c + i), PSD_VLOAD(k + i)),
+                     PSD_VCMYK(PSD_VLOAD(m + i), PSD_VLOAD(k + i)),
+                     PSD_VCMYK(PSD_VLOAD(y + i), PSD_VLOAD(k + i)),
+                     PSD_VSPLAT_FF());
+    }
+    cmyk_row_scalar8(rows, x0 + i, count - i, out + i * 4);
+}
+
+static void cmyka_row_vec8(const uint8_t *const *rows, size_t x0, size_t count, uint8_t *out)
+{
+    const uint8_t *c = rows[0] + x0, *m = rows[1] + x0, *y = rows[2] + x0, *k = rows[3] + x0;
+    const uint8_t *a = rows[4] + x0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        store_rgba16(out + i * 4,
+                     PSD_VCMYK(PSD_VLOAD(c + i), PSD_VLOAD(k + i)),
+                     PSD_VCMYK(PSD_VLOAD(m + i), PSD_VLOAD(k + i)),
+                     PSD_VCMYK(PSD_VLOAD(y + i), PSD_VLOAD(k + i)),
+                     PSD_VLOAD(a + i));
+    }
+    cmyka_row_scalar8(rows, x0 + i, count - i, out + i * 4);
+}
+
+#define PSD_KERNEL8(name) name##_row_vec8
+#else
+#define PSD_KERNEL8(name) name##_row_scalar8
+#endif
+
+/* ----------------------------
+ * Bitmap and indexed kernels
+ *
+ * A 1-bit source byte holds 8 pixels, most significant bit first; each of
+ * the 256 byte values maps to its 32 RGBA bytes (set bit = white, opaque).
+ * ---------------------------- */
+
+#define PSD_BIT_PX(set) (set) ? 255 : 0, (set) ? 255 : 0, (set) ? 255 : 0, 255
+#define PSD_BYTE_PX(n)                                                                \
+    { PSD_BIT_PX((n) & 0x80), PSD_BIT_PX((n) & 0x40), PSD_BIT_PX((n) & 0x20),         \
+      PSD_BIT_PX((n) & 0x10), PSD_BIT_PX((n) & 0x08), PSD_BIT_PX((n) & 0x04),         \
+      PSD_BIT_PX((n) & 0x02), PSD_BIT_PX((n) & 0x01) }
+#define PSD_BYTES4(n) PSD_BYTE_PX(n), PSD_BYTE_PX((n) + 1), PSD_BYTE_PX((n) + 2), PSD_BYTE_PX((n) + 3)
+#define PSD_BYTES16(n) PSD_BYTES4(n), PSD_BYTES4((n) + 4), PSD_BYTES4((n) + 8), PSD_BYTES4((n) + 12)
+#define PSD_BYTES64(n) PSD_BYTES16(n), PSD_BYTES16((n) + 16), PSD_BYTES16((n) + 32), PSD_BYTES16((n) + 48)
+
+static const uint8_t k_bitmap_rgba[256][32] = {
+    PSD_BYTES64(0), PSD_BYTES64(64), PSD_BYTES64(128), PSD_BYTES64(192)
+};
+
+#undef PSD_BYTES64
+#undef PSD_BYTES16
+#undef PSD_BYTES4
+#undef PSD_BYTE_PX
+#undef PSD_BIT_PX
+
+static void bitmap_row(const uint8_t *const *rows, size_t x0, size_t count, uint8_t *out)
+{
+    const uint8_t *bits = rows[0];
+    size_t x = x0;
+    const size_t end = x0 + count;
+
+    /* Up to the next byte boundary, then whole bytes, then the tail */
+    for (; x < end && (x & 7u); x++, out += 4) {
+        memcpy(out, k_bitmap_rgba[bits[x >> 3]] + (x & 7u) * 4u, 4);
+    }
+    for (; x + 8 <= end; x += 8, out += 32) {
+        memcpy(out, k_bitmap_rgba[bits[x >> 3]], 32);
+    }
+    if (x < end) {
+        memcpy(out, k_bitmap_rgba[bits[x >> 3]], (end - x) * 4u);
+    }
+}
+
+void psd_indexed_row_to_rgba8(const uint8_t *index_row, const uint8_t *alpha_row,
+                              const uint32_t *palette, size_t x0, size_t count,
+                              uint8_t *out)
+{
+    const uint8_t *idx = index_row + x0;
+    size_t i = 0;
+    if (!alpha_row) {
+        for (; i + 4 <= count; i += 4) {
+            uint32_t px[4] = { palette[idx[i]], palette[idx[i + 1]],
+                               palette[idx[i + 2]], palette[idx[i + 3]] };
+            memcpy(out + i * 4u, px, sizeof(px));
+        }
+        for (; i < count; i++) {
+            memcpy(out + i * 4u, &palette[idx[i]], 4);
+        }
+        return;
+    }
+
+    /* The transparent index has palette alpha 0, every other entry 255 */
+    const uint8_t *a = alpha_row + x0;
+    for (; i < count; i++) {
+        uint8_t *px = out + i * 4u;
+        memcpy(px, &palette[idx[i]], 4);
+        px[3] = (uint8_t)(px[3] & a[i]);
+    }
+}
+
+/* ----------------------------
+ * Selection
+ * ---------------------------- */
+
+psd_rgba8_row_fn psd_select_rgba8_row_kernel(psd_color_mode_t mode,
+                                             uint16_t depth_bits,
+                                             uint32_t plane_count,
+                                             uint32_t present_mask)
+{
+    if (depth_bits == 1) {
+        return (plane_count >= 1 && (present_mask & 0x1u)) ? bitmap_row : NULL;
+    }
+    if (depth_bits != 8 && depth_bits != 16) {
+        return NULL;
+    }
+    const int wide = (depth_bits == 16);
+
+    /* The kernels need every base plane; the generic converter fills
+     * in missing ones */
+    switch (mode) {
+    case PSD_COLOR_RGB: {
+        if (plane_count < 3 || (present_mask & 0x7u) != 0x7u) return NULL;
+        int alpha = plane_count > 3 && (present_mask & 0x8u);
+        if (alpha) return wide ? rgba_row_scalar16 : PSD_KERNEL8(rgba);
+        return wide ? rgb_row_scalar16 : PSD_KERNEL8(rgb);
+    }
+    case PSD_COLOR_GRAYSCALE:
+    case PSD_COLOR_DUOTONE: {
+        if (plane_count < 1 || !(present_mask & 0x1u)) return NULL;
+        int alpha = plane_count > 1 && (present_mask & 0x2u);
+        if (alpha) return wide ? graya_row_scalar16 : PSD_KERNEL8(graya);
+        return wide ? gray_row_scalar16 : PSD_KERNEL8(gray);
+    }
+    case PSD_COLOR_CMYK: {
+        if (plane_count < 4 || (present_mask & 0xFu) != 0xFu) return NULL;
+        int alpha = plane_count > 4 && (present_mask & 0x10u);
+        if (alpha) return wide ? cmyka_row_scalar16 : PSD_KERNEL8(cmyka);
+        return wide ? cmyk_row_scalar16 : PSD_KERNEL8(cmyk);
+    }
+    default:
+        return NULL;
+    }
+}
+
+/* ----------------------------
+ * Finish kernels
+ *
+ * Output byte j of a pixel is input channel Ij of (R, G, B, A). Premultiplied
+ * channels are round(c * a / 255), computed exactly as
+ * (t + (t >> 8)) >> 8 with t = c * a + 128.
+ * ---------------------------- */
+
+static inline uint8_t premultiply_u8(uint8_t c, uint8_t a)
+{
+    unsigned t = (unsigned)c * (unsigned)a + 128u;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+}
+
+#define PSD_DEFINE_FINISH_SCALAR(NAME, I0, I1, I2, I3, PREMUL)                        \
+static void NAME##_scalar(uint8_t *px, size_t count)                                  \
+{                                                                                     \
+    for (size_t i = 0; i < count; i++, px += 4) {                                     \
+        uint8_t v[4] = { px[0], px[1], px[2], px[3] };                                \
+        if (PREMUL) {                                                                 \
+            v[0] = premultiply_u8(v[0], v[3]);                                        \
+            v[1] = premultiply_u8(v[1], v[3]);                                        \
+            v[2] = premultiply_u8(v[2], v[3]);                                        \
+        }                                                                             \
+        px[0] = v[I0];                                                                \
+        px[1] = v[I1];                                                                \
+        px[2] = v[I2];                                                                \
+        px[3] = v[I3];                                                                \
+    }                                                                                 \
+}
+
+#if defined(PSD_KERNELS_SSE2)
+
+/* Four pixels per step, widened to 16 bits: the alpha multiplier is the
+ * pixel's alpha with 255 in the alpha lane, and the swizzle is a word
+ * shuffle within each pixel */
+#define PSD_DEFINE_FINISH(NAME, I0, I1, I2, I3, PREMUL)                               \
+PSD_DEFINE_FINISH_SCALAR(NAME, I0, I1, I2, I3, PREMUL)                                \
+static void NAME##_vec(uint8_t *px, size_t count)                                     \
+{                                                                                     \
+    const __m128i zero = _mm_setzero_si128();                                         \
+    const __m128i alpha_lane = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);               \
+    const __m128i alpha_one = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);              \
+    const __m128i bias = _mm_set1_epi16(128);                                         \
+    size_t i = 0;                                                                     \
+    for (; i + 4 <= count; i += 4) {                                                  \
+        __m128i *p = (__m128i *)(void *)(px + i * 4);                                 \
+        __m128i v = _mm_loadu_si128(p);                                               \
+        __m128i lo = _mm_unpacklo_epi8(v, zero);                                      \
+        __m128i hi = _mm_unpackhi_epi8(v, zero);                                      \
+        if (PREMUL) {                                                                 \
+            __m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);   \
+            __m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);   \
+            alo = _mm_or_si128(_mm_andnot_si128(alpha_lane, alo), alpha_one);         \
+            ahi = _mm_or_si128(_mm_andnot_si128(alpha_lane, ahi), alpha_one);         \
+            lo = _mm_add_epi16(_mm_mullo_epi16(lo, alo), bias);                       \
+            hi = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), bias);                       \
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);         \
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);         \
+        }                                                                             \
+        lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(I3, I2, I1, I0)), \
+                                 _MM_SHUFFLE(I3, I2, I1, I0));                        \
+        hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(I3, I2, I1, I0)), \
+                                 _MM_SHUFFLE(I3, I2, I1, I0));                        \
+        _mm_storeu_si128(p, _mm_packus_epi16(lo, hi));                                \
+    }                                                                                 \
+    NAME##_scalar(px + i * 4, count - i);                                             \
+}
+
+#elif defined(PSD_KERNELS_NEON)
+
+/* Sixteen pixels per step, deinterleaved by vld4q */
+static inline uint8x16_t premultiply_vec(uint8x16_t c, uint8x16_t a)
+{
+    uint16x8_t lo = vmull_u8(vget_low_u8(c), vget_low_u8(a));
+    uint16x8_t hi = vmull_u8(vget_high_u8(c), vget_high_u8(a));
+    return vcombine_u8(vrshrn_n_u16(vrsraq_n_u16(lo, lo, 8), 8),
+                       vrshrn_n_u16(vrsraq_n_u16(hi, hi, 8), 8));
+}
+
+#define PSD_DEFINE_FINISH(NAME, I0, I1, I2, I3, PREMUL)                               \
+PSD_DEFINE_FINISH_SCALAR(NAME, I0, I1, I2, I3, PREMUL)                                \
+static void NAME##_vec(uint8_t *px, size_t count)                                     \
+{                                                                                     \
+    size_t i = 0;                                                                     \
+    for (; i + 16 <= count; i += 16) {                                                \
+        uint8x16x4_t in = vld4q_u8(px + i * 4);                                       \
+        if (PREMUL) {                                                                 \
+            in.val[0] = premultiply_vec(in.val[0], in.val[3]);                        \
+            in.val[1] = premultiply_vec(in.val[1], in.val[3]);                        \
+            in.val[2] = premultiply_vec(in.val[2], in.val[3]);                        \
+        }                                                                             \
+        uint8x16x4_t out;                                                             \
+        out.val[0] = in.val[I0];                                                      \
+        out.val[1] = in.val[I1];                                                      \
+        out.val[2] = in.val[I2];                                                      \
+        out.val[3] = in.val[I3];                                                      \
+        vst4q_u8(px + i * 4, out);                                                    \
+    }                                                                                 \
+    NAME##_scalar(px + i * 4, count - i);                                             \
+}
+
+#else
+
+#define PSD_DEFINE_FINISH(NAME, I0, I1, I2, I3, PREMUL)                               \
+PSD_DEFINE_FINISH_SCALAR(NAME, I0, I1, I2, I3, PREMUL)
+
+#endif
+
+PSD_DEFINE_FINISH(rgba_premul, 0, 1, 2, 3, 1)
+PSD_DEFINE_FINISH(bgra, 2, 1, 0, 3, 0)
+PSD_DEFINE_FINISH(bgra_premul, 2, 1, 0, 3, 1)
+PSD_DEFINE_FINISH(argb, 3, 0, 1, 2, 0)
+PSD_DEFINE_FINISH(argb_premul, 3, 0, 1, 2, 1)
+
+#if defined(PSD_HAVE_VECTOR)
+#define PSD_FINISH(name) name##_vec
+#else
+#define PSD_FINISH(name) name##_scalar
+#endif
+
+psd_rgba8_finish_fn psd_select_rgba8_finish_kernel(psd_pixel_format_t format,
+                                                   bool premultiplied)
+{
+    if (format == PSD_PIXEL_FORMAT_ARGB32) {
+        /* 0xAARRGGBB in memory order: B, G, R, A on little-endian hosts */
+        const uint16_t probe = 1;
+        uint8_t first = 0;
+        memcpy(&first, &probe, 1);
+        format = first ? PSD_PIXEL_FORMAT_BGRA8 : PSD_PIXEL_FORMAT_ARGB32;
+    }
+
+    switch (format) {
+    case PSD_PIXEL_FORMAT_BGRA8:
+        return premultiplied ? PSD_FINISH(bgra_premul) : PSD_FINISH(bgra);
+    case PSD_PIXEL_FORMAT_ARGB32:
+        return premultiplied ? PSD_FINISH(argb_premul) : PSD_FINISH(argb);
+    case PSD_PIXEL_FORMAT_RGBA8:
+    default:
+        return premultiplied ? PSD_FINISH(rgba_premul) : NULL;
+    }
+}
+
+/* ----------------------------
+ * Wide plane conversion
+ * ---------------------------- */
+
+static inline uint16_t be16_at(const uint8_t *p)
+{
+    return (uint16_t)(((unsigned)p[0] << 8) | (unsigned)p[1]);
+}
+
+static inline float be_float_at(const uint8_t *p)
+{
+    uint32_t bits = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                    ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/* Clamp to [0, 1] (NaN to 0), scale and round half up */
+static inline uint16_t unit_float_to_u16(float f)
+{
+    f = (f > 0.0f) ? ((f < 1.0f) ? f : 1.0f) : 0.0f;
+    return (uint16_t)(f * 65535.0f + 0.5f);
+}
+
+static void bits_to_u16(const uint8_t *row, size_t x0, size_t count, uint16_t *out)
+{
+    for (size_t i = 0; i < count; i++) {
+        size_t x = x0 + i;
+        out[i] = ((row[x / 8u] >> (7u - (x & 7u))) & 1u) ? 65535u : 0u;
+    }
+}
+
+static void u8_to_u16_scalar(const uint8_t *src, size_t count, uint16_t *out)
+{
+    for (size_t i = 0; i < count; i++) out[i] = (uint16_t)(src[i] * 257u);
+}
+
+static void be16_to_u16_scalar(const uint8_t *src, size_t count, uint16_t *out)
+{
+    for (size_t i = 0; i < count; i++) out[i] = be16_at(src + i * 2);
+}
+
+static void bef32_to_u16_scalar(const uint8_t *src, size_t count, uint16_t *out)
+{
+    for (size_t i = 0; i < count; i++) out[i] = unit_float_to_u16(be_float_at(src + i * 4));
+}
+
+static void u8_to_f32_scalar(const uint8_t *src, size_t count, float *out)
+{
+    for (size_t i = 0; i < count; i++) out[i] = (float)src[i] / 255.0f;
+}
+
+static void be16_to_f32_scalar(const uint8_t *src, size_t count, float *out)
+{
+    for (size_t i = 0; i < count; i++) out[i] = (float)be16_at(src + i * 2) / 65535.0f;
+}
+
+static void bef32_to_f32_scalar(const uint8_t *src, size_t count, float *out)
+{
+    for (size_t i = 0; i < count; i++) out[i] = be_float_at(src + i * 4);
+}
+
+#if defined(PSD_KERNELS_SSE2)
+
+static inline __m128i bswap16_vec(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m128i bswap32_vec(__m128i v)
+{
+    v = bswap16_vec(v);
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+}
+
+static inline __m128i clamp_to_u16x4(__m128 f)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    /* max with a NaN operand returns the second operand, so NaN becomes 0 */
+    f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), one);
+    f = _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(65535.0f)), _mm_set1_ps(0.5f));
+    /* Bias into signed range for the saturating 32-to-16 pack */
+    return _mm_sub_epi32(_mm_cvttps_epi32(f), _mm_set1_epi32(32768));
+}
+
+static void u8_to_u16(const uint8_t *src, size_t count, uint16_t *out)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(const void *)(src + i));
+        /* v | v << 8 == v * 257 */
+        _mm_storeu_si128((__m128i *)(void *)(out + i), _mm_unpacklo_epi8(v, v));
+        _mm_storeu_si128((__m128i *)(void *)(out + i + 8), _mm_unpackhi_epi8(v, v));
+    }
+    u8_to_u16_scalar(src + i, count - i, out + i);
+}
+
+static void be16_to_u16(const uint8_t *src, size_t count, uint16_t *out)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(const void *)(src + i * 2));
+        _mm_storeu_si128((__m128i *)(void *)(out + i), bswap16_vec(v));
+    }
+    be16_to_u16_scalar(src + i * 2, count - i, out + i);
+}
+
+static void bef32_to_u16(const uint8_t *src, size_t count, uint16_t *out)
+{
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = bswap32_vec(_mm_loadu_si128((const __m128i *)(const void *)(src + i * 4)));
+        __m128i b = bswap32_vec(_mm_loadu_si128((const __m128i *)(const void *)(src + i * 4 + 16)));
+        __m128i packed = _mm_packs_epi32(clamp_to_u16x4(_mm_castsi128_ps(a)),
+                                         clamp_to_u16x4(_mm_castsi128_ps(b)));
+        _mm_storeu_si128((__m128i *)(void *)(out + i), _mm_xor_si128(packed, bias));
+    }
+    bef32_to_u16_scalar(src + i * 4, count - i, out + i);
+}
+
+/* Four 16-bit lanes widened to floats and divided by scale */
+static inline void store_u16x8_as_f32(float *out, __m128i v, __m128 scale)
+{
+    const __m128i zero = _mm_setzero_si128();
+    _mm_storeu_ps(out, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), scale));
+    _mm_storeu_ps(out + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), scale));
+}
+
+static void u8_to_f32(const uint8_t *src, size_t count, float *out)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(255.0f);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(const void *)(src + i));
+        store_u16x8_as_f32(out + i, _mm_unpacklo_epi8(v, zero), scale);
+        store_u16x8_as_f32(out + i + 8, _mm_unpackhi_epi8(v, zero), scale);
+    }
+    u8_to_f32_scalar(src + i, count - i, out + i);
+}
+
+static void be16_to_f32(const uint8_t *src, size_t count, float *out)
+{
+    const __m128 scale = _mm_set1_ps(65535.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(const void *)(src + i * 2));
+        store_u16x8_as_f32(out + i, bswap16_vec(v), scale);
+    }
+    be16_to_f32_scalar(src + i * 2, count - i, out + i);
+}
+
+static void bef32_to_f32(const uint8_t *src, size_t count, float *out)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(const void *)(src + i * 4));
+        _mm_storeu_ps(out + i, _mm_castsi128_ps(bswap32_vec(v)));
+    }
+    bef32_to_f32_scalar(src + i * 4, count - i, out + i);
+}
+
+#elif defined(PSD_KERNELS_NEON)
+
+/* Byte swaps and widening only; the float conversions stay scalar so they
+ * build on 32-bit NEON as well */
+static void u8_to_u16(const uint8_t *src, size_t count, uint16_t *out)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        uint8x16x2_t z = vzipq_u8(v, v);
+        vst1q_u16(out + i, vreinterpretq_u16_u8(z.val[0]));
+        vst1q_u16(out + i + 8, vreinterpretq_u16_u8(z.val[1]));
+    }
+    u8_to_u16_scalar(src + i, count - i, out + i);
+}
+
+static void be16_to_u16(const uint8_t *src, size_t count, uint16_t *out)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u16(out + i, vreinterpretq_u16_u8(vrev16q_u8(vld1q_u8(src + i * 2))));
+    }
+    be16_to_u16_scalar(src + i * 2, count - i, out + i);
+}
+
+static void bef32_to_f32(const uint8_t *src, size_t count, float *out)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(out + i, vreinterpretq_f32_u8(vrev32q_u8(vld1q_u8(src + i * 4))));
+    }
+    bef32_to_f32_scalar(src + i * 4, count - i, out + i);
+}
+
+#define bef32_to_u16 bef32_to_u16_scalar
+#define u8_to_f32 u8_to_f32_scalar
+#define be16_to_f32 be16_to_f32_scalar
+
+#else
+
+#define u8_to_u16 u8_to_u16_scalar
+#define be16_to_u16 be16_to_u16_scalar
+#define bef32_to_u16 bef32_to_u16_scalar
+#define u8_to_f32 u8_to_f32_scalar
+#define be16_to_f32 be16_to_f32_scalar
+#define bef32_to_f32 bef32_to_f32_scalar
+
+#endif
+
+void psd_plane_row_to_u16(const uint8_t *row, uint16_t depth_bits,
+                          size_t x0, size_t count, uint16_t *out)
+{
+    switch (depth_bits) {
+    case 1:
+        bits_to_u16(row, x0, count, out);
+        break;
+    case 16:
+        be16_to_u16(row + x0 * 2, count, out);
+        break;
+    case 32:
+        bef32_to_u16(row + x0 * 4, count, out);
+        break;
+    default:
+        u8_to_u16(row + x0, count, out);
+        break;
+    }
+}
+
+void psd_plane_row_to_f32(const uint8_t *row, uint16_t depth_bits,
+                          size_t x0, size_t count, float *out)
+{
+    switch (depth_bits) {
+    case 1:
+        for (size_t i = 0; i < count; i++) {
+            size_t x = x0 + i;
+            out[i] = ((row[x / 8u] >> (7u - (x & 7u))) & 1u) ? 1.0f : 0.0f;
+        }
+        break;
+    case 16:
+        be16_to_f32(row + x0 * 2, count, out);
+        break;
+    case 32:
+        bef32_to_f32(row + x0 * 4, count, out);
+        break;
+    default:
+        u8_to_f32(row + x0, count, out);
+        break;
+    }
+}
@@ -0,0 +1,121 @@
+/**
+ * @file psd_pixel_kernels.h
+ * @brief Specialized planar-to-RGBA8 row conversion kernels
+ *
+ * The generic converter in psd_render.c handles every color mode, depth and
+ * missing-plane combination one pixel at a time. The common combinations get
+ * a dedicated row kernel instead, picked once per render call. 8-bit kernels
+ * use SSE2 on x86-64 and NEON on AArch64 (both part of the baseline ISA, so
+ * no runtime check is needed) with a portable C fallback. 1-bit rows expand
+ * a whole source byte (8 pixels) per table lookup, and indexed rows gather
+ * from a packed RGBA palette built once per document.
+ *
+ * Wide renders (RGBA16, float) convert each plane row to host-order samples
+ * first: byte swaps and integer/float conversions run 8 or 16 samples per
+ * step.
+ *
+ * Render targets other than straight RGBA8 get a finish kernel as well: it
+ * swizzles and premultiplies each row in place right after conversion, while
+ * the row is still in L1, so no second pass over the image is needed.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_PIXEL_KERNELS_H
+#define PSD_PIXEL_KERNELS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "../include/openpsd/psd.h"
+#include "../include/openpsd/psd_export.h"
+
+/**
+ * @brief Row kernel: convert pixels [x0, x0 + count) of one scanline
+ *
+ * @param rows Row start (x = 0) of each plane, in render plane order
+ * @param x0 First pixel to convert
+ * @param count Number of pixels
+ * @param out Interleaved RGBA8 output (count * 4 bytes)
+ */
+typedef void (*psd_rgba8_row_fn)(const uint8_t *const *rows, size_t x0,
+                                 size_t count, uint8_t *out);
+
+/**
+ * @brief Pick the row kernel for a plane layout
+ *
+ * @param mode Document color mode
+ * @param depth_bits Bits per sample
+ * @param plane_count Number of planes in render order (base channels, then alpha)
+ * @param present_mask Bit i set when plane i has data
+ * @return Kernel, or NULL when the generic converter must be used
+ */
+PSD_INTERNAL psd_rgba8_row_fn psd_select_rgba8_row_kernel(psd_color_mode_t mode,
+                                                          uint16_t depth_bits,
+                                                          uint32_t plane_count,
+                                                          uint32_t present_mask);
+
+/**
+ * @brief Convert pixels [x0, x0 + count) of an 8-bit indexed row
+ *
+ * @param index_row Row start (x = 0) of the index plane
+ * @param alpha_row Row start of the alpha plane, or NULL
+ * @param palette 256 packed entries, bytes R, G, B, A in memory order; A is
+ *        0 for the transparent index and 255 otherwise
+ * @param x0 First pixel to convert
+ * @param count Number of pixels
+ * @param out Interleaved RGBA8 output (count * 4 bytes)
+ */
+PSD_INTERNAL void psd_indexed_row_to_rgba8(const uint8_t *index_row, const uint8_t *alpha_row,
+                                           const uint32_t *palette, size_t x0, size_t count,
+                                           uint8_t *out);
+
+/**
+ * @brief Finish kernel: rewrite count RGBA8 pixels in place in a target layout
+ */
+typedef void (*psd_rgba8_finish_fn)(uint8_t *pixels, size_t count);
+
+/**
+ * @brief Pick the finish kernel for a render target
+ *
+ * @param format Target pixel format (ARGB32 resolves to the host byte order)
+ * @param premultiplied Scale color by alpha
+ * @return Kernel, or NULL for straight RGBA8, which needs no finishing
+ */
+PSD_INTERNAL psd_rgba8_finish_fn psd_select_rgba8_finish_kernel(psd_pixel_format_t format,
+                                                                bool premultiplied);
+
+/**
+ * @brief Convert samples [x0, x0 + count) of one plane row to native uint16
+ *
+ * 1-bit: set bits become 65535. 8-bit: v * 257. 16-bit: big-endian to host
+ * order. 32-bit: IEEE float clamped to [0, 1] and scaled to 65535, rounded
+ * (NaN becomes 0).
+ *
+ * @param row Row start (x = 0) of the plane
+ * @param depth_bits 1, 8, 16 or 32
+ * @param x0 First sample
+ * @param count Number of samples
+ * @param out count native samples
+ */
+PSD_INTERNAL void psd_plane_row_to_u16(const uint8_t *row, uint16_t depth_bits,
+                                       size_t x0, size_t count, uint16_t *out);
+
+/**
+ * @brief Convert samples [x0, x0 + count) of one plane row to float
+ *
+ * 1-bit: set bits become 1.0. 8- and 16-bit: normalized to [0, 1] (v / 255,
+ * v / 65535). 32-bit: big-endian IEEE float to host order, unchanged.
+ */
+PSD_INTERNAL void psd_plane_row_to_f32(const uint8_t *row, uint16_t depth_bits,
+                                       size_t x0, size_t count, float *out);
+
+#endif /* PSD_PIXEL_KERNELS_H */
@@ -0,0 +1,909 @@
+/**
+ * @file psd_push_parser.c
+ * @brief Push parser: parse a file from bytes handed over in chunks
+ *
+ * The parser reads the file in units: the header, a whole color mode data or
+ * image resources section, one layer record, one layer channel, one RAW or
+ * RLE composite row. A unit's bytes are gathered into one buffer and handed
+ * to the section parsers of psd_context.c through a buffer stream, so the
+ * push and pull parsers read every field the same way. Bytes nobody needs
+ * (the global layer mask info, padding) are dropped as they arrive, and ZIP
+ * composite data goes through an incremental inflater without being kept.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_context.h"
+#include "psd_decode_cache.h"
+#include "psd_endian.h"
+#include "psd_layer_names.h"
+#include "psd_rle.h"
+#include "psd_text_layer_parse.h"
+#include "psd_zip.h"
+#include <string.h>
+
+#define PSD_PUSH_HEADER_SIZE 26u
+#define PSD_PUSH_RECORD_HEAD 18u  /* bounds + channel count */
+#define PSD_PUSH_RECORD_TAIL 16u  /* blend sig, key, opacity..filler, extra length */
+
+/**
+ * @brief Where the parser is in the file
+ */
+typedef enum {
+    PSD_PUSH_HEADER,               /* unit: 26 bytes */
+    PSD_PUSH_COLOR_MODE,           /* unit: length, then the whole section */
+    PSD_PUSH_RESOURCES,            /* unit: length, then the whole section */
+    PSD_PUSH_LAYER_SECTION,        /* unit: Layer and Mask section length */
+    PSD_PUSH_LAYER_INFO,           /* unit: Layer Info subsection length */
+    PSD_PUSH_LAYER_COUNT,          /* unit: 2 bytes */
+    PSD_PUSH_LAYER_RECORD,         /* unit: head, descriptors and tail, then extra data */
+    PSD_PUSH_CHANNEL_COMPRESSION,  /* unit: 2 bytes */
+    PSD_PUSH_CHANNEL_DATA,         /* unit: channel payload */
+    PSD_PUSH_COMPOSITE_COMPRESSION, /* unit: 2 bytes */
+    PSD_PUSH_COMPOSITE_RAW,        /* unit: one row */
+    PSD_PUSH_COMPOSITE_RLE_COUNTS, /* unit: byte counts table */
+    PSD_PUSH_COMPOSITE_RLE_ROW,    /* unit: PackBits data of one row */
+    PSD_PUSH_COMPOSITE_ZIP_HEAD,   /* unit: 2 bytes telling zlib from raw DEFLATE */
+    PSD_PUSH_SKIP,                 /* bytes dropped up to skip_to, then the composite */
+    PSD_PUSH_COMPOSITE_ZIP,        /* bytes go to the inflater */
+    PSD_PUSH_COMPOSITE_ZIP_WHOLE,  /* bytes kept for psd_parser_finish() */
+    PSD_PUSH_DONE,                 /* bytes ignored */
+} psd_push_state_t;
+
+struct psd_parser {
+    const psd_allocator_t *allocator;
+    psd_parser_callbacks_t callbacks;
+    psd_document_t *doc;
+    psd_status_t status;          /**< First error, returned from then on */
+    bool finished;                /**< psd_parser_finish() was called */
+
+    psd_push_state_t state;
+    uint64_t offset;              /**< File offset of the next byte */
+
+    /* Unit being gathered */
+    uint8_t *unit;
+    size_t used;
+    size_t need;
+    size_t capacity;
+    uint64_t unit_offset;         /**< File offset of unit[0] */
+    uint32_t unit_step;           /**< How far the unit's size is known */
+
+    uint64_t skip_to;             /**< End of PSD_PUSH_SKIP */
+
+    /* Layer and mask section */
+    uint8_t length_bytes;         /**< Section and channel length width: 4, or 8 in PSB files */
+    uint64_t section_end;
+    uint64_t layer_info_end;
+    int32_t layer_count;
+    int32_t layer;                /**< Record, or layer of the channel being read */
+    size_t channel;
+    bool lengths_exclude_compression;
+
+    /* Composite */
+    size_t row_bytes;
+    size_t bytes_per_sample;
+    uint64_t rows;                /**< channels * height */
+    uint64_t row;                 /**< Rows reported so far */
+    uint8_t *row_buffer;          /**< Row being decoded (RLE, ZIP) */
+    size_t row_fill;
+    uint8_t *scratch;             /**< One row, for 32-bit prediction */
+    uint8_t *counts;              /**< RLE byte counts table */
+    uint32_t count_bytes;
+    psd_zip_inflater_t *inflater;
+};
+
+/* ----------------------------
+ * Units
+ * ---------------------------- */
+
+static psd_status_t psd_push_reserve(psd_parser_t *parser, size_t size)
+{
+    if (size <= parser->capacity) {
+        return PSD_OK;
+    }
+    size_t capacity = (parser->capacity > SIZE_MAX / 2) ? SIZE_MAX : parser->capacity * 2;
+    if (capacity < size) {
+        capacity = size;
+    }
+    uint8_t *unit = (uint8_t *)psd_alloc_realloc(parser->allocator, parser->unit, capacity);
+    if (!unit) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    parser->unit = unit;
+    parser->capacity = capacity;
+    return PSD_OK;
+}
+
+/**
+ * @brief Start gathering a unit of need bytes at the current offset
+ */
+static psd_status_t psd_push_begin(psd_parser_t *parser, psd_push_state_t state, uint64_t need)
+{
+    size_t size = 0;
+    if (psd_u64_to_size(need, &size) != 0) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+    parser->state = state;
+    parser->used = 0;
+    parser->need = size;
+    parser->unit_offset = parser->offset;
+    parser->unit_step = 0;
+    return psd_push_reserve(parser, size);
+}
+
+/**
+ * @brief Let the unit being gathered grow to need bytes
+ */
+static psd_status_t psd_push_extend(psd_parser_t *parser, uint64_t need)
+{
+    size_t size = 0;
+    if (psd_u64_to_size(need, &size) != 0) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+    parser->need = size;
+    parser->unit_step++;
+    return psd_push_reserve(parser, size);
+}
+
+static bool psd_push_state_is_unit(psd_push_state_t state)
+{
+    return state < PSD_PUSH_SKIP;
+}
+
+static uint64_t psd_push_read_length(const uint8_t *data, uint8_t width)
+{
+    return (width == 8) ? psd_read_be64(data) : (uint64_t)psd_read_be32(data);
+}
+
+/**
+ * @brief Run a section parser over the unit
+ *
+ * @return The parser's status, or PSD_ERR_CORRUPT_DATA if it did not read
+ *         exactly the unit
+ */
+static psd_status_t psd_push_parse_unit(psd_parser_t *parser,
+                                        psd_status_t (*parse)(psd_stream_t *, psd_document_t *))
+{
+    psd_stream_t *stream = psd_stream_create_buffer(parser->allocator, parser->unit, parser->used);
+    if (!stream) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    psd_status_t status = parse(stream, parser->doc);
+    if (status == PSD_OK && psd_stream_tell(stream) != (int64_t)parser->used) {
+        status = PSD_ERR_CORRUPT_DATA;
+    }
+    psd_stream_destroy(stream);
+    return status;
+}
+
+/* ----------------------------
+ * Layer and mask section
+ * ---------------------------- */
+
+static psd_status_t psd_push_begin_composite(psd_parser_t *parser)
+{
+    return psd_push_begin(parser, PSD_PUSH_COMPOSITE_COMPRESSION, 2);
+}
+
+/**
+ * @brief Drop the bytes up to offset target, then read the composite
+ */
+static psd_status_t psd_push_skip_to_composite(psd_parser_t *parser, uint64_t target)
+{
+    if (target < parser->offset) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+    if (target == parser->offset) {
+        return psd_push_begin_composite(parser);
+    }
+    parser->skip_to = target;
+    parser->state = PSD_PUSH_SKIP;
+    return PSD_OK;
+}
+
+/**
+ * @brief Move to the next channel with a payload, or past the section
+ */
+static psd_status_t psd_push_next_channel(psd_parser_t *parser)
+{
+    psd_document_t *doc = parser->doc;
+    while (parser->layer < parser->layer_count &&
+           parser->channel >= doc->layers.layers[parser->layer].channel_count) {
+        parser->layer++;
+        parser->channel = 0;
+    }
+    if (parser->layer < parser->layer_count) {
+        return psd_push_begin(parser, PSD_PUSH_CHANNEL_COMPRESSION, 2);
+    }
+
+    /* Global layer mask info and anything else up to the end of the section */
+    if (parser->offset > parser->layer_info_end) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+    return psd_push_skip_to_composite(parser, parser->section_end);
+}
+
+/**
+ * @brief Every record is in: build the lookups and start on the channel data
+ */
+static psd_status_t psd_push_records_done(psd_parser_t *parser)
+{
+    psd_document_t *doc = parser->doc;
+    (void)psd_layer_names_build(doc);
+    (void)psd_parse_text_layers(doc);
+
+    /* As psd_parse() does: channel lengths either include the 2-byte
+     * compression field (the specification) or fill the subsection without it */
+    uint64_t sum = 0;
+    uint64_t total_channels = 0;
+    for (int32_t i = 0; i < parser->layer_count; i++) {
+        const psd_layer_record_t *layer = &doc->layers.layers[i];
+        total_channels += layer->channel_count;
+        for (size_t ch = 0; ch < layer->channel_count; ch++) {
+            sum += layer->channels[ch].compressed_length;
+        }
+    }
+    parser->lengths_exclude_compression =
+        sum + 2u * total_channels == parser->layer_info_end - parser->offset;
+
+    parser->layer = 0;
+    parser->channel = 0;
+    return psd_push_next_channel(parser);
+}
+
+/**
+ * @brief Gather a layer record in three steps, then parse it
+ *
+ * Step 0 holds the bounds and channel count, which give the size up to the
+ * extra data length; step 1 reads that length; step 2 is the whole record.
+ */
+static psd_status_t psd_push_layer_record(psd_parser_t *parser)
+{
+    psd_document_t *doc = parser->doc;
+    const uint8_t *unit = parser->unit;
+
+    if (parser->unit_step == 0) {
+        uint32_t count = psd_read_be16(unit + 16);
+        if (count > 56) {
+            /* Read as an empty layer, like psd_parse() */
+            count = 0;
+        }
+        return psd_push_extend(parser, PSD_PUSH_RECORD_HEAD +
+                                           (uint64_t)count * (2u + parser->length_bytes) +
+                                           PSD_PUSH_RECORD_TAIL);
+    }
+    if (parser->unit_step == 1) {
+        uint64_t need = (uint64_t)parser->need + psd_read_be32(unit + parser->need - 4);
+        if (parser->unit_offset + need > parser->layer_info_end) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        return psd_push_extend(parser, need);
+    }
+
+    psd_stream_t *stream = psd_stream_create_buffer(parser->allocator, parser->unit, parser->used);
+    if (!stream) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    uint64_t index_channel = 0;
+    bool last = false;
+    psd_status_t status = psd_parse_layer_record(
+        stream, doc, parser->layer, NULL, &index_channel,
+        (int64_t)(parser->layer_info_end - parser->unit_offset),
+        (int64_t)(parser->section_end - parser->unit_offset), &last);
+    if (status == PSD_OK && (last || psd_stream_tell(stream) != (int64_t)parser->used)) {
+        /* A 4-byte channel length in a PSB file, or a record the pull parser
+         * gives up on */
+        status = PSD_ERR_CORRUPT_DATA;
+    }
+    psd_stream_destroy(stream);
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    doc->layers.layer_count = parser->layer + 1;
+    if (parser->callbacks.layer_record) {
+        status = parser->callbacks.layer_record(parser->callbacks.user_data, doc, parser->layer);
+        if (status != PSD_OK) {
+            return status;
+        }
+    }
+
+    if (++parser->layer < parser->layer_count) {
+        return psd_push_begin(parser, PSD_PUSH_LAYER_RECORD, PSD_PUSH_RECORD_HEAD);
+    }
+    return psd_push_records_done(parser);
+}
+
+static psd_status_t psd_push_layer_count(psd_parser_t *parser)
+{
+    psd_document_t *doc = parser->doc;
+    int32_t count = (int16_t)psd_read_be16(parser->unit);
+    if (count < 0) {
+        doc->layers.has_transparency_layer = true;
+        count = -count;
+    }
+
+    if (count > 0) {
+        doc->layers.layers = (psd_layer_record_t *)psd_alloc_malloc(
+            &doc->meta.allocator, (size_t)count * sizeof(psd_layer_record_t));
+        if (!doc->layers.layers) {
+            return PSD_ERR_OUT_OF_MEMORY;
+        }
+        for (int32_t i = 0; i < count; i++) {
+            psd_layer_record_init(&doc->layers.layers[i]);
+        }
+    }
+    parser->layer_count = count;
+    parser->layer = 0;
+
+    if (count == 0) {
+        return psd_push_records_done(parser);
+    }
+    return psd_push_begin(parser, PSD_PUSH_LAYER_RECORD, PSD_PUSH_RECORD_HEAD);
+}
+
+/**
+ * @brief Hand one channel payload to the callback, then drop it
+ */
+static psd_status_t psd_push_channel_data(psd_parser_t *parser)
+{
+    psd_document_t *doc = parser->doc;
+    psd_layer_channel_data_t *channel =
+        &doc->layers.layers[parser->layer].channels[parser->channel];
+
+    psd_status_t status = PSD_OK;
+    if (parser->callbacks.layer_channel) {
+        /* Borrowed, so nothing but this function frees it */
+        channel->compressed_data = (parser->used > 0) ? parser->unit : NULL;
+        channel->compressed_borrowed = true;
+        status = parser->callbacks.layer_channel(parser->callbacks.user_data, doc,
+                                                 parser->layer, parser->channel);
+        psd_decode_cache_release(doc, channel);
+        channel->compressed_data = NULL;
+        channel->compressed_borrowed = false;
+    }
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    parser->channel++;
+    return psd_push_next_channel(parser);
+}
+
+static psd_status_t psd_push_channel_compression(psd_parser_t *parser)
+{
+    psd_layer_channel_data_t *channel =
+        &parser->doc->layers.layers[parser->layer].channels[parser->channel];
+
+    uint16_t compression = psd_read_be16(parser->unit);
+    if (compression > 3) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+
+    uint64_t length = channel->compressed_length;
+    if (!parser->lengths_exclude_compression) {
+        if (length < 2) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        length -= 2;
+    }
+    if (parser->offset + length > parser->layer_info_end) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+
+    channel->compression = (uint8_t)compression;
+    channel->compressed_length = length;
+    channel->file_offset = parser->offset;
+    return psd_push_begin(parser, PSD_PUSH_CHANNEL_DATA, length);
+}
+
+/* ----------------------------
+ * Composite
+ * ---------------------------- */
+
+/**
+ * @brief Report a decoded row and move on to the next one
+ */
+static psd_status_t psd_push_emit_row(psd_parser_t *parser, const uint8_t *row)
+{
+    psd_document_t *doc = parser->doc;
+    psd_status_t status = PSD_OK;
+    if (parser->callbacks.composite_row) {
+        status = parser->callbacks.composite_row(
+            parser->callbacks.user_data, doc, (uint16_t)(parser->row / doc->height),
+            (uint32_t)(parser->row % doc->height), row, parser->row_bytes);
+    }
+    parser->row++;
+    if (parser->row == parser->rows) {
+        parser->state = PSD_PUSH_DONE;
+    }
+    return status;
+}
+
+static psd_status_t psd_push_next_rle_row(psd_parser_t *parser)
+{
+    if (parser->row == parser->rows) {
+        return PSD_OK;
+    }
+    const uint8_t *entry = parser->counts + (size_t)parser->row * parser->count_bytes;
+    uint32_t count = (parser->count_bytes == 4) ? psd_read_be32(entry) : psd_read_be16(entry);
+    return psd_push_begin(parser, PSD_PUSH_COMPOSITE_RLE_ROW, count);
+}
+
+static psd_status_t psd_push_alloc_rows(psd_parser_t *parser)
+{
+    parser->row_buffer = (uint8_t *)psd_alloc_malloc(parser->allocator, parser->row_bytes);
+    if (!parser->row_buffer) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    if (parser->doc->composite.compression == PSD_COMPRESSION_ZIP_PRED &&
+        parser->bytes_per_sample == 4) {
+        parser->scratch = (uint8_t *)psd_alloc_malloc(parser->allocator, parser->row_bytes);
+        if (!parser->scratch) {
+            return PSD_ERR_OUT_OF_MEMORY;
+        }
+    }
+    return PSD_OK;
+}
+
+static psd_status_t psd_push_composite_compression(psd_parser_t *parser)
+{
+    psd_document_t *doc = parser->doc;
+    uint16_t compression = psd_read_be16(parser->unit);
+
+    uint64_t bytes_per_sample = 0;
+    uint64_t row_bytes = 0;
+    uint64_t size = 0;
+    psd_composite_geometry(doc, &bytes_per_sample, &row_bytes, &size);
+    if (psd_u64_to_size(row_bytes, &parser->row_bytes) != 0) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+    parser->bytes_per_sample = (size_t)bytes_per_sample;
+    parser->rows = (uint64_t)doc->channels * doc->height;
+    parser->row = 0;
+    doc->composite.compression = (psd_compression_t)compression;
+
+    switch (compression) {
+    case PSD_COMPRESSION_RAW:
+        return psd_push_begin(parser, PSD_PUSH_COMPOSITE_RAW, parser->row_bytes);
+
+    case PSD_COMPRESSION_RLE:
+        parser->count_bytes = doc->is_psb ? 4u : 2u;
+        return psd_push_begin(parser, PSD_PUSH_COMPOSITE_RLE_COUNTS,
+                              parser->rows * parser->count_bytes);
+
+    case PSD_COMPRESSION_ZIP:
+    case PSD_COMPRESSION_ZIP_PRED:
+        return psd_push_begin(parser, PSD_PUSH_COMPOSITE_ZIP_HEAD, 2);
+
+    default:
+        /* Unknown compression: no composite, as with psd_parse() */
+        doc->composite.compression = PSD_COMPRESSION_RAW;
+        parser->state = PSD_PUSH_DONE;
+        return PSD_OK;
+    }
+}
+
+/**
+ * @brief Inflate the next bytes, reporting every row they complete
+ */
+static psd_status_t psd_push_inflate(psd_parser_t *parser, const uint8_t *in, size_t length,
+                                     size_t *out_used)
+{
+    size_t used = 0;
+    while (parser->state == PSD_PUSH_COMPOSITE_ZIP) {
+        size_t in_used = 0;
+        size_t produced = 0;
+        psd_status_t status = psd_zip_inflater_run(
+            parser->inflater, in + used, length - used, &in_used,
+            parser->row_buffer + parser->row_fill, parser->row_bytes - parser->row_fill,
+            &produced);
+        if (status != PSD_OK) {
+            return status;
+        }
+        used += in_used;
+        parser->row_fill += produced;
+
+        if (parser->row_fill == parser->row_bytes) {
+            if (parser->doc->composite.compression == PSD_COMPRESSION_ZIP_PRED) {
+                status = psd_zip_unpredict_row(parser->row_buffer, parser->row_bytes,
+                                               parser->bytes_per_sample, parser->scratch);
+                if (status != PSD_OK) {
+                    return status;
+                }
+            }
+            parser->row_fill = 0;
+            status = psd_push_emit_row(parser, parser->row_buffer);
+            if (status != PSD_OK) {
+                return status;
+            }
+        } else if (psd_zip_inflater_done(parser->inflater)) {
+            /* The data ended before the planes did */
+            return PSD_ERR_CORRUPT_DATA;
+        } else if (used == length) {
+            break;
+        } else if (in_used == 0 && produced == 0) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+    }
+    *out_used = used;
+    return PSD_OK;
+}
+
+static psd_status_t psd_push_zip_head(psd_parser_t *parser)
+{
+    psd_status_t status = psd_zip_inflater_create(parser->allocator, parser->unit,
+                                                  parser->used, &parser->inflater);
+    if (status == PSD_ERR_UNSUPPORTED_FEATURE) {
+        /* Whole-buffer backend: keep the payload for psd_parser_finish() */
+        parser->state = PSD_PUSH_COMPOSITE_ZIP_WHOLE;
+        return PSD_OK;
+    }
+    if (status == PSD_ERR_UNSUPPORTED_COMPRESSION) {
+        parser->state = PSD_PUSH_DONE;
+        return PSD_OK;
+    }
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    status = psd_push_alloc_rows(parser);
+    if (status != PSD_OK) {
+        return status;
+    }
+    parser->row_fill = 0;
+    parser->state = PSD_PUSH_COMPOSITE_ZIP;
+    size_t used = 0;
+    return psd_push_inflate(parser, parser->unit, parser->used, &used);
+}
+
+/**
+ * @brief Inflate a kept ZIP payload in one go and report its rows
+ */
+static psd_status_t psd_push_zip_whole(psd_parser_t *parser)
+{
+    psd_document_t *doc = parser->doc;
+    uint64_t size64 = parser->rows * parser->row_bytes;
+    size_t size = 0;
+    if (psd_u64_to_size(size64, &size) != 0) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+    uint8_t *planes = (uint8_t *)psd_alloc_malloc(parser->allocator, size);
+    if (!planes) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+
+    psd_status_t status;
+    if (doc->composite.compression == PSD_COMPRESSION_ZIP) {
+        status = psd_zip_decompress(parser->unit, parser->used, planes, size,
+                                    parser->allocator, doc->zip);
+    } else {
+        status = psd_zip_decompress_with_prediction(parser->unit, parser->used, planes, size,
+                                                    parser->row_bytes, parser->bytes_per_sample,
+                                                    parser->allocator, doc->zip);
+    }
+    while (status == PSD_OK && parser->row < parser->rows) {
+        status = psd_push_emit_row(parser, planes + (size_t)parser->row * parser->row_bytes);
+    }
+    psd_alloc_free(parser->allocator, planes);
+    parser->state = PSD_PUSH_DONE;
+    return (status == PSD_ERR_UNSUPPORTED_COMPRESSION) ? PSD_OK : status;
+}
+
+/* ----------------------------
+ * Driver
+ * ---------------------------- */
+
+/**
+ * @brief Act on a complete unit (or on the part of it whose size was asked for)
+ */
+static psd_status_t psd_push_unit(psd_parser_t *parser)
+{
+    psd_document_t *doc = parser->doc;
+    const uint8_t *unit = parser->unit;
+    psd_status_t status = PSD_OK;
+
+    switch (parser->state) {
+    case PSD_PUSH_HEADER:
+        status = psd_push_parse_unit(parser, psd_parse_header);
+        if (status != PSD_OK) {
+            return status;
+        }
+        parser->length_bytes = doc->is_psb ? 8u : 4u;
+        if (parser->callbacks.header) {
+            status = parser->callbacks.header(parser->callbacks.user_data, doc);
+            if (status != PSD_OK) {
+                return status;
+            }
+        }
+        return psd_push_begin(parser, PSD_PUSH_COLOR_MODE, 4);
+
+    case PSD_PUSH_COLOR_MODE:
+    case PSD_PUSH_RESOURCES:
+        /* First the 4-byte length, then the whole section */
+        if (parser->unit_step == 0 && psd_read_be32(unit) > 0) {
+            return psd_push_extend(parser, 4u + (uint64_t)psd_read_be32(unit));
+        }
+        if (parser->state == PSD_PUSH_COLOR_MODE) {
+            status = psd_push_parse_unit(parser, psd_parse_color_mode_data);
+            return (status == PSD_OK) ? psd_push_begin(parser, PSD_PUSH_RESOURCES, 4) : status;
+        }
+        status = psd_push_parse_unit(parser, psd_parse_resources);
+        if (status == PSD_OK && parser->callbacks.resources) {
+            status = parser->callbacks.resources(parser->callbacks.user_data, doc);
+        }
+        if (status != PSD_OK) {
+            return status;
+        }
+        return psd_push_begin(parser, PSD_PUSH_LAYER_SECTION, parser->length_bytes);
+
+    case PSD_PUSH_LAYER_SECTION: {
+        uint64_t length = psd_push_read_length(unit, parser->length_bytes);
+        if (length == 0) {
+            return psd_push_begin_composite(parser);
+        }
+        parser->section_end = parser->offset + length;
+        return psd_push_begin(parser, PSD_PUSH_LAYER_INFO, parser->length_bytes);
+    }
+
+    case PSD_PUSH_LAYER_INFO: {
+        uint64_t length = psd_push_read_length(unit, parser->length_bytes);
+        parser->layer_info_end = parser->offset + length;
+        if (parser->layer_info_end > parser->section_end) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        if (length == 0) {
+            return psd_push_skip_to_composite(parser, parser->section_end);
+        }
+        return psd_push_begin(parser, PSD_PUSH_LAYER_COUNT, 2);
+    }
+
+    case PSD_PUSH_LAYER_COUNT:
+        return psd_push_layer_count(parser);
+
+    case PSD_PUSH_LAYER_RECORD:
+        return psd_push_layer_record(parser);
+
+    case PSD_PUSH_CHANNEL_COMPRESSION:
+        return psd_push_channel_compression(parser);
+
+    case PSD_PUSH_CHANNEL_DATA:
+        return psd_push_channel_data(parser);
+
+    case PSD_PUSH_COMPOSITE_COMPRESSION:
+        return psd_push_composite_compression(parser);
+
+    case PSD_PUSH_COMPOSITE_RAW:
+        status = psd_push_emit_row(parser, unit);
+        if (status != PSD_OK || parser->state == PSD_PUSH_DONE) {
+            return status;
+        }
+        return psd_push_begin(parser, PSD_PUSH_COMPOSITE_RAW, parser->row_bytes);
+
+    case PSD_PUSH_COMPOSITE_RLE_COUNTS:
+        /* The table stays for the rows; the unit buffer is handed over */
+        parser->counts = parser->unit;
+        parser->unit = NULL;
+        parser->capacity = 0;
+        status = psd_push_alloc_rows(parser);
+        return (status == PSD_OK) ? psd_push_next_rle_row(parser) : status;
+
+    case PSD_PUSH_COMPOSITE_RLE_ROW:
+        if (psd_rle_decode_row(unit, parser->used, parser->row_buffer, parser->row_bytes) !=
+            PSD_OK) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        status = psd_push_emit_row(parser, parser->row_buffer);
+        return (status == PSD_OK) ? psd_push_next_rle_row(parser) : status;
+
+    case PSD_PUSH_COMPOSITE_ZIP_HEAD:
+        return psd_push_zip_head(parser);
+
+    default:
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+}
+
+/**
+ * @brief Take the next input bytes in the current state
+ *
+ * @return Number of bytes taken (at least one unless length is 0), or an
+ *         error through status
+ */
+static size_t psd_push_take(psd_parser_t *parser, const uint8_t *bytes, size_t length,
+                            psd_status_t *status)
+{
+    size_t take = 0;
+    *status = PSD_OK;
+
+    switch (parser->state) {
+    case PSD_PUSH_SKIP:
+        take = (parser->skip_to - parser->offset < length)
+                   ? (size_t)(parser->skip_to - parser->offset)
+                   : length;
+        parser->offset += take;
+        if (parser->offset == parser->skip_to) {
+            *status = psd_push_begin_composite(parser);
+        }
+        return take;
+
+    case PSD_PUSH_COMPOSITE_ZIP:
+        *status = psd_push_inflate(parser, bytes, length, &take);
+        parser->offset += take;
+        return take;
+
+    case PSD_PUSH_COMPOSITE_ZIP_WHOLE:
+        if (length > SIZE_MAX - parser->used) {
+            *status = PSD_ERR_OUT_OF_RANGE;
+            return 0;
+        }
+        *status = psd_push_reserve(parser, parser->used + length);
+        if (*status != PSD_OK) {
+            return 0;
+        }
+        memcpy(parser->unit + parser->used, bytes, length);
+        parser->used += length;
+        parser->offset += length;
+        return length;
+
+    case PSD_PUSH_DONE:
+        parser->offset += length;
+        return length;
+
+    default:
+        take = parser->need - parser->used;
+        if (take > length) {
+            take = length;
+        }
+        memcpy(parser->unit + parser->used, bytes, take);
+        parser->used += take;
+        parser->offset += take;
+        return take;
+    }
+}
+
+/**
+ * @brief Create a push parser
+ */
+PSD_API psd_status_t psd_parser_create(const psd_allocator_t *allocator,
+                                       const psd_parser_callbacks_t *callbacks,
+                                       psd_parser_t **out_parser)
+{
+    if (!out_parser) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    *out_parser = NULL;
+
+    psd_parser_t *parser = (psd_parser_t *)psd_alloc_malloc(allocator, sizeof(*parser));
+    if (!parser) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    memset(parser, 0, sizeof(*parser));
+    parser->allocator = allocator;
+    if (callbacks) {
+        parser->callbacks = *callbacks;
+    }
+
+    /* Nothing is deferred: the document never has a stream to load from */
+    parser->doc = psd_document_new(allocator, 0, NULL);
+    psd_status_t status = parser->doc ? psd_push_begin(parser, PSD_PUSH_HEADER,
+                                                       PSD_PUSH_HEADER_SIZE)
+                                      : PSD_ERR_OUT_OF_MEMORY;
+    if (status != PSD_OK) {
+        psd_parser_destroy(parser);
+        return status;
+    }
+
+    *out_parser = parser;
+    return PSD_OK;
+}
+
+/**
+ * @brief Destroy a push parser and its document
+ */
+PSD_API void psd_parser_destroy(psd_parser_t *parser)
+{
+    if (!parser) {
+        return;
+    }
+    const psd_allocator_t *allocator = parser->allocator;
+    psd_zip_inflater_destroy(parser->inflater);
+    psd_alloc_free(allocator, parser->unit);
+    psd_alloc_free(allocator, parser->counts);
+    psd_alloc_free(allocator, parser->row_buffer);
+    psd_alloc_free(allocator, parser->scratch);
+    psd_document_free(parser->doc);
+    psd_alloc_free(allocator, parser);
+}
+
+/**
+ * @brief Hand the next bytes of the file to the parser
+ */
+PSD_API psd_status_t psd_parser_feed(psd_parser_t *parser, const void *bytes, size_t length)
+{
+    if (!parser || (!bytes && length > 0)) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (parser->status != PSD_OK) {
+        return parser->status;
+    }
+    if (parser->finished) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    const uint8_t *next = (const uint8_t *)bytes;
+    psd_status_t status = PSD_OK;
+    while (status == PSD_OK) {
+        /* Units can complete without input (empty channels, RLE rows) */
+        if (psd_push_state_is_unit(parser->state) && parser->used == parser->need) {
+            status = psd_push_unit(parser);
+            continue;
+        }
+        if (length == 0) {
+            break;
+        }
+        size_t take = psd_push_take(parser, next, length, &status);
+        next += take;
+        length -= take;
+    }
+
+    parser->status = status;
+    return status;
+}
+
+/**
+ * @brief Signal the end of the file
+ */
+PSD_API psd_status_t psd_parser_finish(psd_parser_t *parser)
+{
+    if (!parser) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (parser->status != PSD_OK) {
+        return parser->status;
+    }
+    if (parser->finished) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    parser->finished = true;
+
+    psd_status_t status;
+    switch (parser->state) {
+    case PSD_PUSH_DONE:
+        status = PSD_OK;
+        break;
+    case PSD_PUSH_COMPOSITE_COMPRESSION:
+        /* A file may end before the optional composite */
+        status = (parser->used == 0) ? PSD_OK : PSD_ERR_STREAM_EOF;
+        break;
+    case PSD_PUSH_COMPOSITE_ZIP_WHOLE:
+        status = psd_push_zip_whole(parser);
+        break;
+    default:
+        status = PSD_ERR_STREAM_EOF;
+        break;
+    }
+
+    parser->status = status;
+    return status;
+}
+
+/**
+ * @brief Document a push parser fills in
+ */
+PSD_API psd_status_t psd_parser_get_document(const psd_parser_t *parser, psd_document_t **out_doc)
+{
+    if (!parser || !out_doc) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    *out_doc = (parser->state == PSD_PUSH_HEADER) ? NULL : parser->doc;
+    return PSD_OK;
+}
@@ -3,7 +3,8 @@
  * @brief Color mode aware rendering helpers (RGBA8)
  *
  * Converts decoded planar PSD pixel data (composite or layer channels) into
- * interleaved RGBA8 for display.
+ * interleaved RGBA8 for display. Region and scanline renders pull rows through
+ * row cursors, so only the requested rows are ever decoded.
  *
  * Part of the OpenPSD library.
  * 
@@ -17,6 +18,14 @@
  */
 
 #include <openpsd/psd.h>
+#include "psd_alloc.h"
+#include "psd_color_lut.h"
+#include "psd_context.h"
+#include "psd_decode_cache.h"
+#include "psd_fused_rows.h"
+#include "psd_layer_content.h"
+#include "psd_pixel_kernels.h"
+#include "psd_rows.h"
 
 #include <math.h>
 #include <stddef.h>
@@ -49,106 +58,172 @@ static inline uint8_t sample_to_u8(const uint8_t *p, uint16_t depth_bits)
     return p[0];
 }
 
-static inline float clamp01f(float v)
+/* Reference conversion: full Lab math and powf() companding */
+static void lab_d50_to_srgb_u8(float L, float a, float b, uint8_t *out_rgb)
 {
-    if (v < 0.0f) return 0.0f;
-    if (v > 1.0f) return 1.0f;
-    return v;
+    float linear[3];
+    psd_lab_to_linear_srgb(L, a, b, linear);
+    out_rgb[0] = psd_srgb_encode_exact(linear[0]);
+    out_rgb[1] = psd_srgb_encode_exact(linear[1]);
+    out_rgb[2] = psd_srgb_encode_exact(linear[2]);
 }
 
-static inline uint8_t float_to_u8(float v)
+static inline bool depth_supported(uint16_t depth_bits)
 {
-    v = clamp01f(v);
-    int iv = (int)lroundf(v * 255.0f);
-    if (iv < 0) iv = 0;
-    if (iv > 255) iv = 255;
-    return (uint8_t)iv;
+    return depth_bits == 1 || depth_bits == 8 || depth_bits == 16;
 }
 
-static inline float srgb_compand(float v)
+/* Bytes between two rows of an unpadded plane */
+static inline uint64_t plane_row_stride(uint16_t depth_bits, uint32_t width)
 {
-    v = clamp01f(v);
-    if (v <= 0.0031308f) return 12.92f * v;
-    return 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+    return (depth_bits == 1) ? (((uint64_t)width + 7u) / 8u)
+                             : (uint64_t)width * bytes_per_sample(depth_bits);
 }
 
-static void lab_d50_to_srgb_u8(float L, float a, float b, uint8_t *out_rgb)
+/* Convert pixels [x0, x0 + width) of one scanline. rows[i] points at the
+ * start (x = 0) of plane i's row, or is NULL when the plane is absent.
+ * palette is the document's packed RGBA table (indexed mode only). */
+static psd_status_t render_row_to_rgba8(
+    psd_color_mode_t mode,
+    uint16_t depth_bits,
+    uint32_t x0,
+    uint32_t width,
+    const uint8_t **rows,
+    uint32_t plane_count,
+    const uint32_t *palette,
+    const psd_lab_tables_t *lab,
+    uint8_t *out_rgba)
+{
+    const uint32_t bps = bytes_per_sample(depth_bits);
+
+    if (mode == PSD_COLOR_INDEXED && depth_bits == 8 && rows[0] && palette) {
+        psd_indexed_row_to_rgba8(rows[0], (plane_count > 1) ? rows[1] : NULL, palette,
+                                 x0, width, out_rgba);
+        return PSD_OK;
+    }
+    if (mode == PSD_COLOR_LAB && lab && (depth_bits == 8 || depth_bits == 16) &&
+        plane_count >= 3 && rows[0] && rows[1] && rows[2]) {
+        const uint8_t *lab_rows[4] = { rows[0], rows[1], rows[2],
+                                       (plane_count > 3) ? rows[3] : NULL };
+        psd_lab_row_to_rgba8(lab, depth_bits, lab_rows, x0, width, out_rgba);
+        return PSD_OK;
+    }
+
+    for (uint32_t i = 0; i < width; i++) {
+        uint32_t x = x0 + i;
+        uint8_t r = 0, g = 0, b = 0, a = 255;
+
+        if (depth_bits == 1) {
+            /* bitmap */
+            if (!rows[0]) return PSD_ERR_CORRUPT_DATA;
+            uint8_t bit = (uint8_t)(7u - (x & 7u));
+            uint8_t v = ((rows[0][x / 8u] >> bit) & 1u) ? 255 : 0;
+            r = g = b = v;
+            a = 255;
+        } else {
+            uint64_t idx = (uint64_t)x;
+            const uint8_t *p0 = rows[0] ? (rows[0] + idx * bps) : NULL;
+            const uint8_t *p1 = (plane_count > 1 && rows[1]) ? (rows[1] + idx * bps) : NULL;
+            const uint8_t *p2 = (plane_count > 2 && rows[2]) ? (rows[2] + idx * bps) : NULL;
+            const uint8_t *p3 = (plane_count > 3 && rows[3]) ? (rows[3] + idx * bps) : NULL;
+            const uint8_t *p4 = (plane_count > 4 && rows[4]) ? (rows[4] + idx * bps) : NULL;
+
+            switch (mode) {
+            case PSD_COLOR_RGB:
+                r = p0 ? sample_to_u8(p0, depth_bits) : 0;
+                g = p1 ? sample_to_u8(p1, depth_bits) : r;
+                b = p2 ? sample_to_u8(p2, depth_bits) : r;
+                a = p3 ? sample_to_u8(p3, depth_bits) : 255;
+                break;
+            case PSD_COLOR_GRAYSCALE:
+            case PSD_COLOR_DUOTONE:
+                r = p0 ? sample_to_u8(p0, depth_bits) : 0;
+                g = r;
+                b = r;
+                a = p1 ? sample_to_u8(p1, depth_bits) : 255;
+                break;
+            case PSD_COLOR_INDEXED: {
+                uint8_t idx8 = p0 ? sample_to_u8(p0, depth_bits) : 0;
+                uint8_t entry[4] = { idx8, idx8, idx8, 255 };
+                if (palette) memcpy(entry, &palette[idx8], sizeof(entry));
+                r = entry[0];
+                g = entry[1];
+                b = entry[2];
+                a = (uint8_t)(entry[3] & (p1 ? sample_to_u8(p1, depth_bits) : 255));
+                break;
+            }
+            case PSD_COLOR_CMYK: {
+                uint8_t c = p0 ? sample_to_u8(p0, depth_bits) : 0;
+                uint8_t m = p1 ? sample_to_u8(p1, depth_bits) : 0;
+                uint8_t yy = p2 ? sample_to_u8(p2, depth_bits) : 0;
+                uint8_t k = p3 ? sample_to_u8(p3, depth_bits) : 0;
+                uint16_t rk = (uint16_t)c + (uint16_t)k;
+                uint16_t gk = (uint16_t)m + (uint16_t)k;
+                uint16_t bk = (uint16_t)yy + (uint16_t)k;
+                r = (uint8_t)(255u - (rk > 255u ? 255u : rk));
+                g = (uint8_t)(255u - (gk > 255u ? 255u : gk));
+                b = (uint8_t)(255u - (bk > 255u ? 255u : bk));
+                a = p4 ? sample_to_u8(p4, depth_bits) : 255;
+                break;
+            }
+            case PSD_COLOR_LAB: {
+                if (!p0 || !p1 || !p2) {
+                    return PSD_ERR_CORRUPT_DATA;
+                }
+                float L = 0.0f, aa = 0.0f, bb = 0.0f;
+                if (depth_bits == 8) {
+                    uint8_t Lv = p0[0];
+                    uint8_t av = p1[0];
+                    uint8_t bv = p2[0];
+                    L = ((float)Lv * 100.0f) / 255.0f;
+                    aa = (float)((int)av - 128);
+                    bb = (float)((int)bv - 128);
+                } else {
+                    uint16_t Lv = read_be_u16(p0);
+                    uint16_t av = read_be_u16(p1);
+                    uint16_t bv = read_be_u16(p2);
+                    L = ((float)Lv * 100.0f) / 65535.0f;
+                    aa = ((float)((int)av - 32768)) / 256.0f;
+                    bb = ((float)((int)bv - 32768)) / 256.0f;
+                }
+                uint8_t rgb[3];
+                lab_d50_to_srgb_u8(L, aa, bb, rgb);
+                r = rgb[0];
+                g = rgb[1];
+                b = rgb[2];
+                a = p3 ? sample_to_u8(p3, depth_bits) : 255;
+                break;
+            }
+            default:
+                return PSD_ERR_UNSUPPORTED_COLOR_MODE;
+            }
+        }
+
+        out_rgba[(size_t)i * 4u + 0] = r;
+        out_rgba[(size_t)i * 4u + 1] = g;
+        out_rgba[(size_t)i * 4u + 2] = b;
+        out_rgba[(size_t)i * 4u + 3] = a;
+    }
+
+    return PSD_OK;
+}
+
+/* Bit i set when plane i has data */
+static uint32_t present_mask(const uint8_t *const *planes, uint32_t plane_count)
+{
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < plane_count && i < 5; i++) {
+        if (planes[i]) mask |= 1u << i;
+    }
+    return mask;
+}
+
+/* Lab tables, unless the caller asked for exact math (or another thread
+ * is still building them) */
+static const psd_lab_tables_t *color_tables(psd_color_mode_t mode, uint32_t render_flags)
 {
-    /* Convert CIE Lab (D50) -> XYZ (D50) */
-    const float fy = (L + 16.0f) / 116.0f;
-    const float fx = fy + (a / 500.0f);
-    const float fz = fy - (b / 200.0f);
-
-    const float eps = 216.0f / 24389.0f;  /* 0.008856... */
-    const float kappa = 24389.0f / 27.0f; /* 903.3... */
-
-    float fx3 = fx * fx * fx;
-    float fy3 = fy * fy * fy;
-    float fz3 = fz * fz * fz;
-
-    float xr = (fx3 > eps) ? fx3 : ((116.0f * fx - 16.0f) / kappa);
-    float yr = (L > (kappa * eps)) ? fy3 : (L / kappa);
-    float zr = (fz3 > eps) ? fz3 : ((116.0f * fz - 16.0f) / kappa);
-
-    /* D50 reference white (ICC) */
-    float X = xr * 0.96422f;
-    float Y = yr * 1.0f;
-    float Z = zr * 0.82521f;
-
-    /* Bradford adaptation D50 -> D65 */
-    /* B and B^-1 matrices */
-    const float Bm[3][3] = {
-        { 0.8951f,  0.2664f, -0.1614f },
-        { -0.7502f, 1.7135f,  0.0367f },
-        { 0.0389f, -0.0685f,  1.0296f }
-    };
-    const float Bi[3][3] = {
-        { 0.9869929f, -0.1470543f, 0.1599627f },
-        { 0.4323053f,  0.5183603f, 0.0492912f },
-        { -0.0085287f, 0.0400428f, 0.9684867f }
-    };
-
-    /* Whitepoints in XYZ */
-    const float D50[3] = { 0.96422f, 1.0f, 0.82521f };
-    const float D65[3] = { 0.95047f, 1.0f, 1.08883f };
-
-    /* LMS for source/target whites */
-    float LMS50[3] = {
-        Bm[0][0]*D50[0] + Bm[0][1]*D50[1] + Bm[0][2]*D50[2],
-        Bm[1][0]*D50[0] + Bm[1][1]*D50[1] + Bm[1][2]*D50[2],
-        Bm[2][0]*D50[0] + Bm[2][1]*D50[1] + Bm[2][2]*D50[2]
-    };
-    float LMS65[3] = {
-        Bm[0][0]*D65[0] + Bm[0][1]*D65[1] + Bm[0][2]*D65[2],
-        Bm[1][0]*D65[0] + Bm[1][1]*D65[1] + Bm[1][2]*D65[2],
-        Bm[2][0]*D65[0] + Bm[2][1]*D65[1] + Bm[2][2]*D65[2]
-    };
-
-    float lms[3] = {
-        Bm[0][0]*X + Bm[0][1]*Y + Bm[0][2]*Z,
-        Bm[1][0]*X + Bm[1][1]*Y + Bm[1][2]*Z,
-        Bm[2][0]*X + Bm[2][1]*Y + Bm[2][2]*Z
-    };
-
-    /* scale LMS */
-    if (LMS50[0] != 0.0f) lms[0] *= (LMS65[0] / LMS50[0]);
-    if (LMS50[1] != 0.0f) lms[1] *= (LMS65[1] / LMS50[1]);
-    if (LMS50[2] != 0.0f) lms[2] *= (LMS65[2] / LMS50[2]);
-
-    /* back to XYZ (D65) */
-    float Xd = Bi[0][0]*lms[0] + Bi[0][1]*lms[1] + Bi[0][2]*lms[2];
-    float Yd = Bi[1][0]*lms[0] + Bi[1][1]*lms[1] + Bi[1][2]*lms[2];
-    float Zd = Bi[2][0]*lms[0] + Bi[2][1]*lms[1] + Bi[2][2]*lms[2];
-
-    /* XYZ (D65) -> linear sRGB */
-    float rl =  3.2406f*Xd + -1.5372f*Yd + -0.4986f*Zd;
-    float gl = -0.9689f*Xd +  1.8758f*Yd +  0.0415f*Zd;
-    float bl =  0.0557f*Xd + -0.2040f*Yd +  1.0570f*Zd;
-
-    /* compand */
-    out_rgb[0] = float_to_u8(srgb_compand(rl));
-    out_rgb[1] = float_to_u8(srgb_compand(gl));
-    out_rgb[2] = float_to_u8(srgb_compand(bl));
+    if (mode != PSD_COLOR_LAB || (render_flags & PSD_RENDER_EXACT_COLOR)) return NULL;
+    return psd_lab_tables();
 }
 
 static psd_status_t render_planar_to_rgba8(
@@ -159,8 +234,8 @@ static psd_status_t render_planar_to_rgba8(
     const uint8_t **planes,
     uint32_t plane_count,
     uint64_t plane_bytes,
-    const uint8_t *color_mode_data,
-    uint64_t color_mode_data_len,
+    const uint32_t *palette,
+    uint32_t render_flags,
     uint8_t *out_rgba,
     size_t out_rgba_size,
     size_t *out_required_size)
@@ -176,115 +251,688 @@ static psd_status_t render_planar_to_rgba8(
         return PSD_OK;
     }
 
-    if (!(depth_bits == 1 || depth_bits == 8 || depth_bits == 16)) {
+    if (!depth_supported(depth_bits)) {
         return PSD_ERR_UNSUPPORTED_FEATURE;
     }
 
-    const uint32_t bps = bytes_per_sample(depth_bits);
-    const uint64_t row_bytes = (depth_bits == 1) ? (((uint64_t)width + 7u) / 8u) : 0;
+    const uint64_t row_stride = plane_row_stride(depth_bits, width);
+    const psd_rgba8_row_fn kernel = psd_select_rgba8_row_kernel(
+        mode, depth_bits, plane_count, present_mask(planes, plane_count));
+    const psd_lab_tables_t *lab = kernel ? NULL : color_tables(mode, render_flags);
 
     for (uint32_t y = 0; y < height; y++) {
-        for (uint32_t x = 0; x < width; x++) {
-            uint8_t r = 0, g = 0, b = 0, a = 255;
-
-            if (depth_bits == 1) {
-                /* bitmap */
-                if (!planes[0]) return PSD_ERR_CORRUPT_DATA;
-                uint64_t off = (uint64_t)y * row_bytes + (uint64_t)(x / 8u);
-                uint8_t bit = (uint8_t)(7u - (x & 7u));
-                uint8_t v = ((planes[0][off] >> bit) & 1u) ? 255 : 0;
-                r = g = b = v;
-                a = 255;
+        const uint8_t *rows[5] = { NULL, NULL, NULL, NULL, NULL };
+        uint8_t *dst = out_rgba + (size_t)y * (size_t)width * 4u;
+        for (uint32_t i = 0; i < plane_count && i < 5; i++) {
+            rows[i] = planes[i] ? planes[i] + (uint64_t)y * row_stride : NULL;
+        }
+        if (kernel) {
+            kernel(rows, 0, width, dst);
+            continue;
+        }
+        psd_status_t st = render_row_to_rgba8(
+            mode, depth_bits, 0, width, rows, plane_count, palette, lab, dst);
+        if (st != PSD_OK) return st;
+    }
+
+    (void)plane_bytes;
+    return PSD_OK;
+}
+
+/* Order layer channel slots (0..3 = color channel ids, 4 = alpha) the way
+ * render_row_to_rgba8 expects: base channels, then alpha as next plane when
+ * present. */
+static psd_status_t layer_plane_order(
+    psd_color_mode_t mode,
+    bool has_alpha,
+    uint32_t order[5],
+    uint32_t *plane_count)
+{
+    uint32_t base = 0;
+    switch (mode) {
+    case PSD_COLOR_RGB:
+    case PSD_COLOR_LAB:
+        base = 3;
+        break;
+    case PSD_COLOR_GRAYSCALE:
+    case PSD_COLOR_DUOTONE:
+    case PSD_COLOR_INDEXED:
+        base = 1;
+        break;
+    case PSD_COLOR_CMYK:
+        base = 4;
+        break;
+    default:
+        return PSD_ERR_UNSUPPORTED_COLOR_MODE;
+    }
+
+    for (uint32_t i = 0; i < base; i++) order[i] = i;
+    if (has_alpha) order[base] = 4;
+    *plane_count = base + (has_alpha ? 1u : 0u);
+    return PSD_OK;
+}
+
+/* ----------------------------
+ * Region rendering
+ * ---------------------------- */
+
+/* Planes of a composite or layer, read one row at a time */
+typedef struct {
+    psd_color_mode_t mode;
+    uint16_t depth_bits;
+    uint32_t width;
+    uint32_t height;
+    const uint32_t *palette;      /**< Packed RGBA table, indexed mode only */
+    uint32_t palette_scratch[256];
+    psd_row_cursor_t cursors[5];
+    bool present[5];
+    uint32_t plane_count;
+    uint32_t render_flags;
+    const uint8_t *skip_rows;     /**< Rows (bit y, LSB first) not to render, or NULL */
+} render_source_t;
+
+/* Resolve an optional rect against a width x height image */
+static psd_status_t resolve_rect(
+    const psd_rect_t *rect,
+    uint32_t width,
+    uint32_t height,
+    psd_rect_t *out)
+{
+    if (!rect) {
+        out->top = 0;
+        out->left = 0;
+        out->bottom = (int32_t)height;
+        out->right = (int32_t)width;
+        return PSD_OK;
+    }
+    if (rect->top < 0 || rect->left < 0 ||
+        rect->bottom < rect->top || rect->right < rect->left ||
+        (uint32_t)rect->bottom > height || (uint32_t)rect->right > width) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+    *out = *rect;
+    return PSD_OK;
+}
+
+/* Check that a region placed at the target's offset fits, and find where its
+ * first row starts */
+static psd_status_t resolve_target(
+    const psd_render_target_t *target,
+    const psd_rect_t *region,
+    uint8_t **out_first_row,
+    size_t *out_stride,
+    psd_rgba8_finish_fn *out_finish)
+{
+    if (target->format != PSD_PIXEL_FORMAT_RGBA8 &&
+        target->format != PSD_PIXEL_FORMAT_BGRA8 &&
+        target->format != PSD_PIXEL_FORMAT_ARGB32) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    uint64_t width = (uint64_t)(region->right - region->left);
+    uint64_t height = (uint64_t)(region->bottom - region->top);
+    uint64_t row_end = ((uint64_t)target->x + width) * 4u;
+    uint64_t stride = target->stride ? (uint64_t)target->stride : row_end;
+    if (stride < row_end) return PSD_ERR_INVALID_ARGUMENT;
+
+    *out_first_row = target->pixels;
+    if (width > 0 && height > 0) {
+        /* Bytes up to the end of the region's last row */
+        uint64_t rows = (uint64_t)target->y + height - 1u;
+        if (rows > (UINT64_MAX - row_end) / stride) return PSD_ERR_OUT_OF_RANGE;
+        if (rows * stride + row_end > (uint64_t)target->size) return PSD_ERR_BUFFER_TOO_SMALL;
+        *out_first_row += (size_t)((uint64_t)target->y * stride) + (size_t)target->x * 4u;
+    }
+    *out_stride = (size_t)stride;
+    *out_finish = psd_select_rgba8_finish_kernel(target->format, target->premultiplied);
+    return PSD_OK;
+}
+
+/* Convert the rows of region into out (stride bytes apart), or hand each row
+ * to callback when out is NULL. finish, when set, rewrites each converted row
+ * in place into the target layout. */
+static psd_status_t render_source_region(
+    const psd_allocator_t *allocator,
+    render_source_t *src,
+    const psd_rect_t *region,
+    uint8_t *out,
+    size_t out_stride,
+    psd_rgba8_finish_fn finish,
+    psd_render_scanline_fn callback,
+    void *user_data)
+{
+    uint32_t x0 = (uint32_t)region->left;
+    uint32_t width = (uint32_t)(region->right - region->left);
+    uint32_t height = (uint32_t)(region->bottom - region->top);
+    if (width == 0 || height == 0) return PSD_OK;
+
+    if (!depth_supported(src->depth_bits)) return PSD_ERR_UNSUPPORTED_FEATURE;
+
+    /* Rows are decoded straight into the output where a fused pipeline
+     * covers the layout */
+    const psd_fused_rgba8_row_fn fused =
+        psd_select_fused_rgba8_row(src->mode, src->depth_bits, src->plane_count);
+
+    /* One scratch row per RLE plane, plus the output row for callbacks */
+    uint64_t row_bytes64 = fused ? 0u : plane_row_stride(src->depth_bits, src->width);
+    uint64_t scratch64 = row_bytes64 * src->plane_count + (callback ? (uint64_t)width * 4u : 0u);
+    if (scratch64 > (uint64_t)SIZE_MAX) return PSD_ERR_OUT_OF_RANGE;
+
+    uint8_t *scratch = NULL;
+    if (scratch64 > 0) {
+        scratch = (uint8_t *)psd_alloc_malloc(allocator, (size_t)scratch64);
+        if (!scratch) return PSD_ERR_OUT_OF_MEMORY;
+    }
+    uint8_t *line = callback ? scratch + (size_t)row_bytes64 * src->plane_count : NULL;
+
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < src->plane_count; i++) {
+        if (src->present[i]) mask |= 1u << i;
+    }
+    const psd_rgba8_row_fn kernel = psd_select_rgba8_row_kernel(
+        src->mode, src->depth_bits, src->plane_count, mask);
+    const psd_lab_tables_t *lab = kernel ? NULL : color_tables(src->mode, src->render_flags);
+
+    psd_status_t st = PSD_OK;
+    for (uint32_t j = 0; j < height && st == PSD_OK; j++) {
+        uint32_t y = (uint32_t)region->top + j;
+        if (src->skip_rows && ((src->skip_rows[y >> 3] >> (y & 7u)) & 1u)) continue;
+        uint8_t *dst = callback ? line : out + (size_t)j * out_stride;
+        if (fused) {
+            st = fused(src->cursors, src->present, y, x0, width, dst);
+        } else {
+            const uint8_t *rows[5] = { NULL, NULL, NULL, NULL, NULL };
+            for (uint32_t i = 0; i < src->plane_count && st == PSD_OK; i++) {
+                if (!src->present[i]) continue;
+                st = psd_row_cursor_read(&src->cursors[i], y,
+                                         scratch + (size_t)row_bytes64 * i, &rows[i]);
+            }
+            if (st != PSD_OK) break;
+
+            if (kernel) {
+                kernel(rows, x0, width, dst);
             } else {
-                uint64_t idx = (uint64_t)y * (uint64_t)width + (uint64_t)x;
-                const uint8_t *p0 = planes[0] ? (planes[0] + idx * bps) : NULL;
-                const uint8_t *p1 = (plane_count > 1 && planes[1]) ? (planes[1] + idx * bps) : NULL;
-                const uint8_t *p2 = (plane_count > 2 && planes[2]) ? (planes[2] + idx * bps) : NULL;
-                const uint8_t *p3 = (plane_count > 3 && planes[3]) ? (planes[3] + idx * bps) : NULL;
-                const uint8_t *p4 = (plane_count > 4 && planes[4]) ? (planes[4] + idx * bps) : NULL;
-
-                switch (mode) {
-                case PSD_COLOR_RGB:
-                    r = p0 ? sample_to_u8(p0, depth_bits) : 0;
-                    g = p1 ? sample_to_u8(p1, depth_bits) : r;
-                    b = p2 ? sample_to_u8(p2, depth_bits) : r;
-                    a = p3 ? sample_to_u8(p3, depth_bits) : 255;
-                    break;
-                case PSD_COLOR_GRAYSCALE:
-                case PSD_COLOR_DUOTONE:
-                    r = p0 ? sample_to_u8(p0, depth_bits) : 0;
-                    g = r;
-                    b = r;
-                    a = p1 ? sample_to_u8(p1, depth_bits) : 255;
-                    break;
-                case PSD_COLOR_INDEXED: {
-                    uint8_t idx8 = p0 ? sample_to_u8(p0, depth_bits) : 0;
-                    if (color_mode_data && color_mode_data_len >= 768) {
-                        r = color_mode_data[idx8];
-                        g = color_mode_data[256 + idx8];
-                        b = color_mode_data[512 + idx8];
-                    } else {
-                        r = g = b = idx8;
-                    }
-                    a = p1 ? sample_to_u8(p1, depth_bits) : 255;
-                    break;
-                }
-                case PSD_COLOR_CMYK: {
-                    uint8_t c = p0 ? sample_to_u8(p0, depth_bits) : 0;
-                    uint8_t m = p1 ? sample_to_u8(p1, depth_bits) : 0;
-                    uint8_t yy = p2 ? sample_to_u8(p2, depth_bits) : 0;
-                    uint8_t k = p3 ? sample_to_u8(p3, depth_bits) : 0;
-                    uint16_t rk = (uint16_t)c + (uint16_t)k;
-                    uint16_t gk = (uint16_t)m + (uint16_t)k;
-                    uint16_t bk = (uint16_t)yy + (uint16_t)k;
-                    r = (uint8_t)(255u - (rk > 255u ? 255u : rk));
-                    g = (uint8_t)(255u - (gk > 255u ? 255u : gk));
-                    b = (uint8_t)(255u - (bk > 255u ? 255u : bk));
-                    a = p4 ? sample_to_u8(p4, depth_bits) : 255;
-                    break;
-                }
-                case PSD_COLOR_LAB: {
-                    if (!p0 || !p1 || !p2) {
-                        return PSD_ERR_CORRUPT_DATA;
-                    }
-                    float L = 0.0f, aa = 0.0f, bb = 0.0f;
-                    if (depth_bits == 8) {
-                        uint8_t Lv = p0[0];
-                        uint8_t av = p1[0];
-                        uint8_t bv = p2[0];
-                        L = ((float)Lv * 100.0f) / 255.0f;
-                        aa = (float)((int)av - 128);
-                        bb = (float)((int)bv - 128);
+                st = render_row_to_rgba8(src->mode, src->depth_bits, x0, width,
+                                         rows, src->plane_count,
+                                         src->palette, lab, dst);
+            }
+        }
+        if (st == PSD_OK && finish) {
+            finish(dst, width);
+        }
+        if (st == PSD_OK && callback) {
+            st = callback(user_data, j, line, width);
+        }
+    }
+
+    psd_alloc_free(allocator, scratch);
+    return st;
+}
+
+/* ----------------------------
+ * Scaled rendering
+ * ---------------------------- */
+
+/* Copy the sample at column x of each block of 2^level columns (x = block
+ * start + offset, clamped) into a packed row, so the row converters can run
+ * on output pixels only */
+static void gather_row(const uint8_t *row, uint16_t depth_bits, uint32_t width,
+                       uint32_t level, uint32_t offset, uint32_t out_width, uint8_t *out)
+{
+    if (depth_bits == 1) {
+        memset(out, 0, ((size_t)out_width + 7u) / 8u);
+    }
+    const uint32_t bps = bytes_per_sample(depth_bits);
+    for (uint32_t ox = 0; ox < out_width; ox++) {
+        uint64_t sx64 = ((uint64_t)ox << level) + offset;
+        uint32_t sx = (sx64 < width) ? (uint32_t)sx64 : width - 1u;
+        if (depth_bits == 1) {
+            if ((row[sx / 8u] >> (7u - (sx & 7u))) & 1u) {
+                out[ox / 8u] |= (uint8_t)(0x80u >> (ox & 7u));
+            }
+        } else {
+            memcpy(out + (size_t)ox * bps, row + (size_t)sx * bps, bps);
+        }
+    }
+}
+
+/* Downsample src by 2^level into out (out_stride bytes apart). The default
+ * averages each block in alpha-weighted RGBA; PSD_RENDER_FAST_SCALE converts
+ * only the block centers, skipping the rest of each row and all other rows. */
+static psd_status_t render_source_scaled(
+    const psd_allocator_t *allocator,
+    render_source_t *src,
+    uint32_t level,
+    uint8_t *out,
+    size_t out_stride)
+{
+    const uint64_t block = (uint64_t)1 << level;
+    const uint32_t out_width = (uint32_t)(((uint64_t)src->width + block - 1u) >> level);
+    const uint32_t out_height = (uint32_t)(((uint64_t)src->height + block - 1u) >> level);
+    if (out_width == 0 || out_height == 0) return PSD_OK;
+
+    if (!depth_supported(src->depth_bits)) return PSD_ERR_UNSUPPORTED_FEATURE;
+
+    const bool sample = (src->render_flags & PSD_RENDER_FAST_SCALE) != 0;
+    const uint64_t row_bytes64 = plane_row_stride(src->depth_bits, src->width);
+    const uint64_t gather_bytes64 = plane_row_stride(src->depth_bits, out_width);
+
+    /* Sampling: one decode row and one gathered row per plane. Averaging:
+     * per-output-pixel sums, decode rows and one full-width RGBA row. */
+    uint64_t sums64 = sample ? 0u : (uint64_t)out_width * 4u * sizeof(uint64_t);
+    uint64_t bytes64 = sums64 + row_bytes64 * src->plane_count +
+                       (sample ? gather_bytes64 * src->plane_count : (uint64_t)src->width * 4u);
+    if (bytes64 > (uint64_t)SIZE_MAX) return PSD_ERR_OUT_OF_RANGE;
+
+    uint8_t *scratch = (uint8_t *)psd_alloc_malloc(allocator, (size_t)bytes64);
+    if (!scratch) return PSD_ERR_OUT_OF_MEMORY;
+    uint64_t *sums = sample ? NULL : (uint64_t *)(void *)scratch;
+    uint8_t *decode = scratch + (size_t)sums64;
+    uint8_t *extra = decode + (size_t)row_bytes64 * src->plane_count;
+
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < src->plane_count; i++) {
+        if (src->present[i]) mask |= 1u << i;
+    }
+    const psd_rgba8_row_fn kernel = psd_select_rgba8_row_kernel(
+        src->mode, src->depth_bits, src->plane_count, mask);
+    const psd_lab_tables_t *lab = kernel ? NULL : color_tables(src->mode, src->render_flags);
+    const uint32_t center = (uint32_t)(block / 2u);
+
+    psd_status_t st = PSD_OK;
+    for (uint32_t oy = 0; oy < out_height && st == PSD_OK; oy++) {
+        uint8_t *dst = out + (size_t)oy * out_stride;
+        const uint64_t y0 = (uint64_t)oy << level;
+        const uint32_t y_end = (y0 + block < src->height) ? (uint32_t)(y0 + block) : src->height;
+
+        if (sample) {
+            uint32_t y = (y0 + center < src->height) ? (uint32_t)(y0 + center) : src->height - 1u;
+            const uint8_t *rows[5] = { NULL, NULL, NULL, NULL, NULL };
+            for (uint32_t i = 0; i < src->plane_count && st == PSD_OK; i++) {
+                if (!src->present[i]) continue;
+                const uint8_t *row = NULL;
+                st = psd_row_cursor_read(&src->cursors[i], y,
+                                         decode + (size_t)row_bytes64 * i, &row);
+                if (st != PSD_OK) break;
+                uint8_t *packed = extra + (size_t)gather_bytes64 * i;
+                gather_row(row, src->depth_bits, src->width, level, center, out_width, packed);
+                rows[i] = packed;
+            }
+            if (st != PSD_OK) break;
+            if (kernel) {
+                kernel(rows, 0, out_width, dst);
+            } else {
+                st = render_row_to_rgba8(src->mode, src->depth_bits, 0, out_width,
+                                         rows, src->plane_count,
+                                         src->palette, lab, dst);
+            }
+            continue;
+        }
+
+        memset(sums, 0, (size_t)sums64);
+        for (uint32_t y = (uint32_t)y0; y < y_end && st == PSD_OK; y++) {
+            const uint8_t *rows[5] = { NULL, NULL, NULL, NULL, NULL };
+            for (uint32_t i = 0; i < src->plane_count && st == PSD_OK; i++) {
+                if (!src->present[i]) continue;
+                st = psd_row_cursor_read(&src->cursors[i], y,
+                                         decode + (size_t)row_bytes64 * i, &rows[i]);
+            }
+            if (st != PSD_OK) break;
+            if (kernel) {
+                kernel(rows, 0, src->width, extra);
+            } else {
+                st = render_row_to_rgba8(src->mode, src->depth_bits, 0, src->width,
+                                         rows, src->plane_count,
+                                         src->palette, lab, extra);
+                if (st != PSD_OK) break;
+            }
+            for (uint32_t x = 0; x < src->width; x++) {
+                const uint8_t *px = extra + (size_t)x * 4u;
+                uint64_t *sum = sums + (size_t)(x >> level) * 4u;
+                sum[0] += (uint64_t)px[0] * px[3];
+                sum[1] += (uint64_t)px[1] * px[3];
+                sum[2] += (uint64_t)px[2] * px[3];
+                sum[3] += px[3];
+            }
+        }
+        if (st != PSD_OK) break;
+
+        /* Averaged in premultiplied form so transparent pixels don't bleed */
+        for (uint32_t ox = 0; ox < out_width; ox++) {
+            const uint64_t x0 = (uint64_t)ox << level;
+            const uint64_t cols = (x0 + block < src->width) ? block : src->width - x0;
+            const uint64_t count = cols * (y_end - y0);
+            const uint64_t *sum = sums + (size_t)ox * 4u;
+            uint8_t *px = dst + (size_t)ox * 4u;
+            for (uint32_t c = 0; c < 3; c++) {
+                px[c] = sum[3] ? (uint8_t)((sum[c] + sum[3] / 2u) / sum[3]) : 0u;
+            }
+            px[3] = (uint8_t)((sum[3] + count / 2u) / count);
+        }
+    }
+
+    psd_alloc_free(allocator, scratch);
+    return st;
+}
+
+/* ----------------------------
+ * Wide rendering (RGBA16, float)
+ * ---------------------------- */
+
+/* Missing color planes fall back as in render_row_to_rgba8; CMYK is the same
+ * naive inversion at full precision */
+#define PSD_DEFINE_INTERLEAVE(NAME, T, MAX)                                          \
+static void NAME(psd_color_mode_t mode, const T *const *p, size_t count, T *out)      \
+{                                                                                     \
+    for (size_t i = 0; i < count; i++, out += 4) {                                    \
+        T r = 0, g = 0, b = 0, a = (MAX);                                             \
+        if (mode == PSD_COLOR_CMYK) {                                                 \
+            T k = p[3] ? p[3][i] : 0;                                                 \
+            T c = p[0] ? p[0][i] : 0, m = p[1] ? p[1][i] : 0, y = p[2] ? p[2][i] : 0; \
+            r = (T)((c + k >= (MAX)) ? 0 : (MAX) - (c + k));                          \
+            g = (T)((m + k >= (MAX)) ? 0 : (MAX) - (m + k));                          \
+            b = (T)((y + k >= (MAX)) ? 0 : (MAX) - (y + k));                          \
+            if (p[4]) a = p[4][i];                                                    \
+        } else if (mode == PSD_COLOR_RGB) {                                           \
+            r = p[0] ? p[0][i] : 0;                                                   \
+            g = p[1] ? p[1][i] : r;                                                   \
+            b = p[2] ? p[2][i] : r;                                                   \
+            if (p[3]) a = p[3][i];                                                    \
+        } else {                                                                      \
+            r = g = b = p[0] ? p[0][i] : 0;                                           \
+            if (p[1]) a = p[1][i];                                                    \
+        }                                                                             \
+        out[0] = r;                                                                   \
+        out[1] = g;                                                                   \
+        out[2] = b;                                                                   \
+        out[3] = a;                                                                   \
+    }                                                                                 \
+}
+
+PSD_DEFINE_INTERLEAVE(interleave_u16, uint16_t, 65535u)
+PSD_DEFINE_INTERLEAVE(interleave_f32, float, 1.0f)
+
+/* Lab samples normalized to [0, 1] back to L, a, b, then to sRGB */
+static void lab_row_wide(uint16_t depth_bits, const float *const *p, size_t count,
+                         bool to_float, uint8_t *out)
+{
+    const float scale = (depth_bits == 8) ? 255.0f : 65535.0f;
+    const float neutral = (depth_bits == 8) ? 128.0f : 32768.0f;
+    const float unit = (depth_bits == 8) ? 1.0f : 256.0f;
+    for (size_t i = 0; i < count; i++) {
+        float linear[3];
+        psd_lab_to_linear_srgb(p[0][i] * 100.0f,
+                               (p[1][i] * scale - neutral) / unit,
+                               (p[2][i] * scale - neutral) / unit, linear);
+        float px[4] = { psd_srgb_compand(linear[0]), psd_srgb_compand(linear[1]),
+                        psd_srgb_compand(linear[2]), p[3] ? p[3][i] : 1.0f };
+        if (to_float) {
+            memcpy(out + i * 16u, px, sizeof(px));
+        } else {
+            uint16_t wide[4];
+            for (int c = 0; c < 4; c++) {
+                float v = (px[c] > 0.0f) ? ((px[c] < 1.0f) ? px[c] : 1.0f) : 0.0f;
+                wide[c] = (uint16_t)(v * 65535.0f + 0.5f);
+            }
+            memcpy(out + i * 8u, wide, sizeof(wide));
+        }
+    }
+}
+
+/* Convert every row of src into out (out_stride bytes apart) as four native
+ * uint16 or float samples per pixel. Each plane row is first converted to
+ * host-order samples, then interleaved; nothing passes through 8 bits. */
+static psd_status_t render_source_wide(
+    const psd_allocator_t *allocator,
+    render_source_t *src,
+    bool to_float,
+    uint8_t *out,
+    size_t out_stride)
+{
+    const uint32_t width = src->width;
+    if (width == 0 || src->height == 0) return PSD_OK;
+
+    const uint16_t depth = src->depth_bits;
+    if (depth != 1 && depth != 8 && depth != 16 && depth != 32) return PSD_ERR_UNSUPPORTED_FEATURE;
+    switch (src->mode) {
+    case PSD_COLOR_RGB:
+    case PSD_COLOR_GRAYSCALE:
+    case PSD_COLOR_DUOTONE:
+    case PSD_COLOR_CMYK:
+        break;
+    case PSD_COLOR_INDEXED:
+        if (depth != 8) return PSD_ERR_UNSUPPORTED_FEATURE;
+        break;
+    case PSD_COLOR_LAB:
+        if (depth != 8 && depth != 16) return PSD_ERR_UNSUPPORTED_FEATURE;
+        if (src->plane_count < 3 || !src->present[0] || !src->present[1] || !src->present[2]) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        break;
+    default:
+        return PSD_ERR_UNSUPPORTED_COLOR_MODE;
+    }
+
+    /* One decode row per plane, then five converted rows (floats are the
+     * larger sample, so u16 rows fit the same slots), kept sample-aligned */
+    const uint64_t row_bytes64 = plane_row_stride(depth, width);
+    const uint64_t conv_bytes64 = (uint64_t)width * sizeof(float);
+    const uint64_t decode64 = (row_bytes64 * src->plane_count + 15u) & ~(uint64_t)15u;
+    uint64_t scratch64 = decode64 + conv_bytes64 * 5u;
+    if (scratch64 > (uint64_t)SIZE_MAX) return PSD_ERR_OUT_OF_RANGE;
+    uint8_t *scratch = (uint8_t *)psd_alloc_malloc(allocator, (size_t)scratch64);
+    if (!scratch) return PSD_ERR_OUT_OF_MEMORY;
+    uint8_t *conv = scratch + (size_t)decode64;
+    const size_t conv_bytes = (size_t)conv_bytes64;
+
+    const bool as_float = to_float || src->mode == PSD_COLOR_LAB;
+    const bool indexed = src->mode == PSD_COLOR_INDEXED;
+    const uint32_t *palette = src->palette;
+
+    psd_status_t st = PSD_OK;
+    for (uint32_t y = 0; y < src->height && st == PSD_OK; y++) {
+        const uint8_t *rows[5] = { NULL, NULL, NULL, NULL, NULL };
+        for (uint32_t i = 0; i < src->plane_count && st == PSD_OK; i++) {
+            if (!src->present[i]) continue;
+            st = psd_row_cursor_read(&src->cursors[i], y,
+                                     scratch + (size_t)row_bytes64 * i, &rows[i]);
+        }
+        if (st != PSD_OK) break;
+
+        /* Converted planes in interleave order; indexed rows become RGB
+         * planes from the palette, with alpha moved to slot 3 and cleared
+         * below for the transparent index */
+        void *planes[5] = { NULL, NULL, NULL, NULL, NULL };
+        uint32_t first = 0;
+        if (indexed) {
+            for (uint32_t c = 0; c < 3; c++) planes[c] = conv + conv_bytes * c;
+            for (uint32_t x = 0; x < width; x++) {
+                uint8_t index = rows[0] ? rows[0][x] : 0;
+                uint8_t entry[4] = { index, index, index, 255 };
+                if (palette) memcpy(entry, &palette[index], sizeof(entry));
+                for (uint32_t c = 0; c < 3; c++) {
+                    uint8_t v = entry[c];
+                    if (to_float) {
+                        ((float *)planes[c])[x] = (float)v / 255.0f;
                     } else {
-                        uint16_t Lv = read_be_u16(p0);
-                        uint16_t av = read_be_u16(p1);
-                        uint16_t bv = read_be_u16(p2);
-                        L = ((float)Lv * 100.0f) / 65535.0f;
-                        aa = ((float)((int)av - 32768)) / 256.0f;
-                        bb = ((float)((int)bv - 32768)) / 256.0f;
+                        ((uint16_t *)planes[c])[x] = (uint16_t)(v * 257u);
                     }
-                    uint8_t rgb[3];
-                    lab_d50_to_srgb_u8(L, aa, bb, rgb);
-                    r = rgb[0];
-                    g = rgb[1];
-                    b = rgb[2];
-                    a = p3 ? sample_to_u8(p3, depth_bits) : 255;
-                    break;
-                }
-                default:
-                    return PSD_ERR_UNSUPPORTED_COLOR_MODE;
                 }
             }
+            first = 1;
+        }
+        for (uint32_t i = first; i < src->plane_count; i++) {
+            if (!rows[i]) continue;
+            uint32_t slot = indexed ? 3u : i;
+            planes[slot] = conv + conv_bytes * slot;
+            if (as_float) {
+                psd_plane_row_to_f32(rows[i], depth, 0, width, (float *)planes[slot]);
+            } else {
+                psd_plane_row_to_u16(rows[i], depth, 0, width, (uint16_t *)planes[slot]);
+            }
+        }
+        psd_color_mode_t mode = indexed ? PSD_COLOR_RGB : src->mode;
 
-            size_t out_off = ((size_t)y * (size_t)width + (size_t)x) * 4u;
-            out_rgba[out_off + 0] = r;
-            out_rgba[out_off + 1] = g;
-            out_rgba[out_off + 2] = b;
-            out_rgba[out_off + 3] = a;
+        uint8_t *dst = out + (size_t)y * out_stride;
+        if (mode == PSD_COLOR_LAB) {
+            lab_row_wide(depth, (const float *const *)planes, width, to_float, dst);
+        } else if (to_float) {
+            interleave_f32(mode, (const float *const *)planes, width, (float *)(void *)dst);
+        } else {
+            interleave_u16(mode, (const uint16_t *const *)planes, width,
+                           (uint16_t *)(void *)dst);
+        }
+        for (uint32_t x = 0; indexed && palette && x < width; x++) {
+            uint8_t entry[4];
+            memcpy(entry, &palette[rows[0] ? rows[0][x] : 0], sizeof(entry));
+            if (entry[3] != 0) continue;
+            if (to_float) {
+                ((float *)(void *)dst)[x * 4u + 3u] = 0.0f;
+            } else {
+                ((uint16_t *)(void *)dst)[x * 4u + 3u] = 0;
+            }
         }
     }
 
-    (void)plane_bytes;
+    psd_alloc_free(allocator, scratch);
+    return st;
+}
+
+/* Check the output buffer of a wide render, then fill it */
+static psd_status_t render_wide(
+    const psd_allocator_t *allocator,
+    render_source_t *src,
+    bool to_float,
+    void *out,
+    size_t out_size,
+    size_t *out_required_size)
+{
+    const uint64_t pixel_bytes = to_float ? 4u * sizeof(float) : 4u * sizeof(uint16_t);
+    uint64_t required64 = (uint64_t)src->width * (uint64_t)src->height * pixel_bytes;
+    if (required64 > (uint64_t)SIZE_MAX) return PSD_ERR_OUT_OF_RANGE;
+    if (out_required_size) *out_required_size = (size_t)required64;
+    if (!out || out_size < (size_t)required64) return PSD_ERR_BUFFER_TOO_SMALL;
+
+    return render_source_wide(allocator, src, to_float, (uint8_t *)out,
+                              (size_t)((uint64_t)src->width * pixel_bytes));
+}
+
+static psd_status_t composite_source(psd_document_t *doc, render_source_t *src)
+{
+    uint16_t channels = doc->channels;
+    if (channels == 0) return PSD_ERR_CORRUPT_DATA;
+
+    memset(src, 0, sizeof(*src));
+    src->mode = doc->color_mode;
+    src->depth_bits = doc->depth;
+    src->width = doc->width;
+    src->height = doc->height;
+    if (src->mode == PSD_COLOR_INDEXED) src->palette = psd_document_palette(doc, src->palette_scratch);
+    src->render_flags = doc->render_flags;
+    src->plane_count = (channels > 5) ? 5u : channels;
+    for (uint32_t i = 0; i < src->plane_count; i++) src->present[i] = true;
+
+    return psd_document_composite_row_cursors(doc, src->cursors, src->plane_count);
+}
+
+static psd_status_t layer_source(psd_document_t *doc, int32_t layer_index,
+                                 render_source_t *src)
+{
+    int32_t top = 0, left = 0, bottom = 0, right = 0;
+    psd_status_t st = psd_document_get_layer_bounds(doc, layer_index, &top, &left, &bottom, &right);
+    if (st != PSD_OK) return st;
+
+    memset(src, 0, sizeof(*src));
+    src->mode = doc->color_mode;
+    src->depth_bits = doc->depth;
+    src->width = (right > left) ? (uint32_t)(right - left) : 0;
+    src->height = (bottom > top) ? (uint32_t)(bottom - top) : 0;
+    if (src->mode == PSD_COLOR_INDEXED) src->palette = psd_document_palette(doc, src->palette_scratch);
+    src->render_flags = doc->render_flags;
+    if (src->width == 0 || src->height == 0) return PSD_OK;
+
+    size_t channel_count = 0;
+    st = psd_document_get_layer_channel_count(doc, layer_index, &channel_count);
+    if (st != PSD_OK) return st;
+
+    /* Find plane cursors by channel id; channels without usable data are
+     * treated as absent, as in psd_document_render_layer_rgba8(). */
+    psd_row_cursor_t slots[5];
+    bool have[5] = { false, false, false, false, false };
+    for (size_t i = 0; i < channel_count; i++) {
+        psd_row_cursor_t cursor;
+        int16_t channel_id = 0;
+        if (psd_document_layer_row_cursor(doc, layer_index, i, &cursor, &channel_id) != PSD_OK) {
+            continue;
+        }
+        int slot = (channel_id >= 0 && channel_id < 4) ? channel_id
+                 : (channel_id == -1) ? 4 : -1;
+        if (slot < 0) continue;
+        slots[slot] = cursor;
+        have[slot] = true;
+    }
+
+    uint32_t order[5] = { 0, 0, 0, 0, 0 };
+    st = layer_plane_order(src->mode, have[4], order, &src->plane_count);
+    if (st != PSD_OK) return st;
+    for (uint32_t i = 0; i < src->plane_count; i++) {
+        if (have[order[i]]) {
+            src->cursors[i] = slots[order[i]];
+            src->present[i] = true;
+        }
+    }
+    return PSD_OK;
+}
+
+/* Which channels of a layer held pixel memory before a render, so that a
+ * PSD_RENDER_NO_CACHE render can give back what it brought in. Channels
+ * past the 64th are left alone. */
+typedef struct {
+    bool active;
+    uint64_t loaded;   /**< Bit c: channel c's payload was in memory */
+    uint64_t decoded;  /**< Bit c: channel c had a decoded plane */
+} layer_residency_t;
+
+static void layer_residency_begin(const psd_document_t *doc, int32_t layer_index,
+                                  layer_residency_t *before)
+{
+    memset(before, 0, sizeof(*before));
+    if (!(doc->render_flags & PSD_RENDER_NO_CACHE) ||
+        layer_index < 0 || layer_index >= doc->layers.layer_count) {
+        return;
+    }
+    const psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    before->active = true;
+    for (size_t c = 0; c < layer->channel_count && c < 64u; c++) {
+        if (psd_once_done(&layer->channels[c].loaded)) before->loaded |= 1ull << c;
+        if (psd_once_done(&layer->channels[c].decoded)) before->decoded |= 1ull << c;
+    }
+}
+
+static void layer_residency_end(psd_document_t *doc, int32_t layer_index,
+                                const layer_residency_t *before)
+{
+    if (!before->active) return;
+    psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    for (size_t c = 0; c < layer->channel_count && c < 64u; c++) {
+        psd_layer_channel_data_t *channel = &layer->channels[c];
+        bool loaded = psd_once_done(&channel->loaded) && !((before->loaded >> c) & 1u);
+        bool decoded = psd_once_done(&channel->decoded) && !((before->decoded >> c) & 1u);
+        if (loaded || decoded) psd_decode_cache_release(doc, channel);
+    }
+}
+
+PSD_API psd_status_t psd_document_set_render_flags(psd_document_t *doc, uint32_t flags)
+{
+    if (!doc) return PSD_ERR_NULL_POINTER;
+    doc->render_flags = flags;
+    return PSD_OK;
+}
+
+PSD_API psd_status_t psd_document_get_render_flags(const psd_document_t *doc, uint32_t *flags)
+{
+    if (!doc || !flags) return PSD_ERR_NULL_POINTER;
+    *flags = doc->render_flags;
     return PSD_OK;
 }
 
@@ -353,9 +1001,9 @@ PSD_API psd_status_t psd_document_render_composite_rgba8_ex(
     if (channels == 0 || plane_bytes == 0) return PSD_ERR_CORRUPT_DATA;
     if (composite_len < (uint64_t)channels * plane_bytes) return PSD_ERR_CORRUPT_DATA;
 
-    const uint8_t *cm_data = NULL;
-    uint64_t cm_len = 0;
-    psd_document_get_color_mode_data(doc, &cm_data, &cm_len);
+    uint32_t palette_scratch[256];
+    const uint32_t *palette = (mode == PSD_COLOR_INDEXED)
+                                  ? psd_document_palette(doc, palette_scratch) : NULL;
 
     const uint8_t *planes[5] = { NULL, NULL, NULL, NULL, NULL };
     uint32_t plane_count = channels;
@@ -367,10 +1015,80 @@ PSD_API psd_status_t psd_document_render_composite_rgba8_ex(
     return render_planar_to_rgba8(
         mode, depth_bits, width, height,
         planes, plane_count, plane_bytes,
-        cm_data, cm_len,
+        palette, doc->render_flags,
         out_rgba, out_rgba_size, out_required_size);
 }
 
+PSD_API psd_status_t psd_document_render_composite_rgba8_rect(
+    const psd_document_t *doc,
+    const psd_rect_t *rect,
+    uint8_t *out_rgba,
+    size_t out_stride)
+{
+    if (!doc || !out_rgba) return PSD_ERR_NULL_POINTER;
+
+    psd_rect_t region;
+    psd_status_t st = resolve_rect(rect, doc->width, doc->height, &region);
+    if (st != PSD_OK) return st;
+    if (out_stride < (size_t)(region.right - region.left) * 4u) return PSD_ERR_INVALID_ARGUMENT;
+
+    /* Row cursors may load the deferred composite (logically const) */
+    render_source_t src;
+    st = composite_source((psd_document_t *)doc, &src);
+    if (st != PSD_OK) return st;
+
+    return render_source_region(doc->allocator, &src, &region, out_rgba, out_stride, NULL, NULL, NULL);
+}
+
+PSD_API psd_status_t psd_document_render_composite_rgba8_scanlines(
+    const psd_document_t *doc,
+    const psd_rect_t *rect,
+    psd_render_scanline_fn callback,
+    void *user_data)
+{
+    if (!doc || !callback) return PSD_ERR_NULL_POINTER;
+
+    psd_rect_t region;
+    psd_status_t st = resolve_rect(rect, doc->width, doc->height, &region);
+    if (st != PSD_OK) return st;
+
+    render_source_t src;
+    st = composite_source((psd_document_t *)doc, &src);
+    if (st != PSD_OK) return st;
+
+    return render_source_region(doc->allocator, &src, &region, NULL, 0, NULL, callback, user_data);
+}
+
+PSD_API psd_status_t psd_document_render_composite_rgba8_scaled(
+    const psd_document_t *doc,
+    uint32_t level,
+    uint8_t *out_rgba,
+    size_t out_rgba_size,
+    size_t *out_required_size,
+    uint32_t *out_width,
+    uint32_t *out_height)
+{
+    if (!doc) return PSD_ERR_NULL_POINTER;
+    if (level >= 32) return PSD_ERR_INVALID_ARGUMENT;
+
+    const uint64_t block = (uint64_t)1 << level;
+    const uint64_t width = ((uint64_t)doc->width + block - 1u) >> level;
+    const uint64_t height = ((uint64_t)doc->height + block - 1u) >> level;
+    if (out_width) *out_width = (uint32_t)width;
+    if (out_height) *out_height = (uint32_t)height;
+
+    uint64_t required64 = width * height * 4u;
+    if (required64 > (uint64_t)SIZE_MAX) return PSD_ERR_OUT_OF_RANGE;
+    if (out_required_size) *out_required_size = (size_t)required64;
+    if (!out_rgba || out_rgba_size < (size_t)required64) return PSD_ERR_BUFFER_TOO_SMALL;
+
+    render_source_t src;
+    psd_status_t st = composite_source((psd_document_t *)doc, &src);
+    if (st != PSD_OK) return st;
+
+    return render_source_scaled(doc->allocator, &src, level, out_rgba, (size_t)width * 4u);
+}
+
 PSD_API psd_status_t psd_document_render_layer_rgba8(
     psd_document_t *doc,
     int32_t layer_index,
@@ -392,6 +1110,12 @@ PSD_API psd_status_t psd_document_render_layer_rgba8(
     if (!out_rgba || out_rgba_size < (size_t)required64) return PSD_ERR_BUFFER_TOO_SMALL;
     if (width == 0 || height == 0) return PSD_OK;
 
+    /* One-shot renders go row by row instead of through decoded planes */
+    if (doc->render_flags & PSD_RENDER_NO_CACHE) {
+        return psd_document_render_layer_rgba8_rect(doc, layer_index, NULL, out_rgba,
+                                                    (size_t)width * 4u);
+    }
+
     psd_color_mode_t mode = PSD_COLOR_RGB;
     st = psd_document_get_color_mode(doc, &mode);
     if (st != PSD_OK) return st;
@@ -400,9 +1124,9 @@ PSD_API psd_status_t psd_document_render_layer_rgba8(
     st = psd_document_get_depth(doc, &depth_bits);
     if (st != PSD_OK) return st;
 
-    const uint8_t *cm_data = NULL;
-    uint64_t cm_len = 0;
-    psd_document_get_color_mode_data(doc, &cm_data, &cm_len);
+    uint32_t palette_scratch[256];
+    const uint32_t *palette = (mode == PSD_COLOR_INDEXED)
+                                  ? psd_document_palette(doc, palette_scratch) : NULL;
 
     size_t channel_count = 0;
     st = psd_document_get_layer_channel_count(doc, layer_index, &channel_count);
@@ -430,42 +1154,13 @@ PSD_API psd_status_t psd_document_render_layer_rgba8(
         }
     }
 
-    /* Build plane order expected by render_planar_to_rgba8:
-     * p0.. base channels, then alpha as next plane when present.
-     */
+    /* Build plane order expected by render_planar_to_rgba8 */
     const uint8_t *ordered[5] = { NULL, NULL, NULL, NULL, NULL };
-    switch (mode) {
-    case PSD_COLOR_RGB:
-        ordered[0] = planes[0];
-        ordered[1] = planes[1];
-        ordered[2] = planes[2];
-        if (planes[4]) ordered[3] = planes[4];
-        plane_count = planes[4] ? 4 : 3;
-        break;
-    case PSD_COLOR_GRAYSCALE:
-    case PSD_COLOR_DUOTONE:
-    case PSD_COLOR_INDEXED:
-        ordered[0] = planes[0];
-        if (planes[4]) ordered[1] = planes[4];
-        plane_count = planes[4] ? 2 : 1;
-        break;
-    case PSD_COLOR_CMYK:
-        ordered[0] = planes[0];
-        ordered[1] = planes[1];
-        ordered[2] = planes[2];
-        ordered[3] = planes[3];
-        if (planes[4]) ordered[4] = planes[4];
-        plane_count = planes[4] ? 5 : 4;
-        break;
-    case PSD_COLOR_LAB:
-        ordered[0] = planes[0];
-        ordered[1] = planes[1];
-        ordered[2] = planes[2];
-        if (planes[4]) ordered[3] = planes[4];
-        plane_count = planes[4] ? 4 : 3;
-        break;
-    default:
-        return PSD_ERR_UNSUPPORTED_COLOR_MODE;
+    uint32_t order[5] = { 0, 0, 0, 0, 0 };
+    st = layer_plane_order(mode, planes[4] != NULL, order, &plane_count);
+    if (st != PSD_OK) return st;
+    for (uint32_t i = 0; i < plane_count; i++) {
+        ordered[i] = planes[order[i]];
     }
 
     uint32_t bps = bytes_per_sample(depth_bits);
@@ -481,7 +1176,211 @@ PSD_API psd_status_t psd_document_render_layer_rgba8(
     return render_planar_to_rgba8(
         mode, depth_bits, width, height,
         ordered, plane_count, plane_bytes,
-        cm_data, cm_len,
+        palette, doc->render_flags,
         out_rgba, out_rgba_size, out_required_size);
 }
 
+PSD_API psd_status_t psd_document_render_layer_rgba8_rect(
+    psd_document_t *doc,
+    int32_t layer_index,
+    const psd_rect_t *rect,
+    uint8_t *out_rgba,
+    size_t out_stride)
+{
+    if (!doc || !out_rgba) return PSD_ERR_NULL_POINTER;
+
+    layer_residency_t before;
+    layer_residency_begin(doc, layer_index, &before);
+
+    render_source_t src;
+    psd_rect_t region;
+    psd_status_t st = layer_source(doc, layer_index, &src);
+    if (st == PSD_OK) st = resolve_rect(rect, src.width, src.height, &region);
+    if (st == PSD_OK && out_stride < (size_t)(region.right - region.left) * 4u) {
+        st = PSD_ERR_INVALID_ARGUMENT;
+    }
+    if (st == PSD_OK) {
+        st = render_source_region(doc->allocator, &src, &region, out_rgba, out_stride,
+                                  NULL, NULL, NULL);
+    }
+
+    layer_residency_end(doc, layer_index, &before);
+    return st;
+}
+
+PSD_API psd_status_t psd_document_render_layer_rgba8_scanlines(
+    psd_document_t *doc,
+    int32_t layer_index,
+    const psd_rect_t *rect,
+    psd_render_scanline_fn callback,
+    void *user_data)
+{
+    if (!doc || !callback) return PSD_ERR_NULL_POINTER;
+
+    layer_residency_t before;
+    layer_residency_begin(doc, layer_index, &before);
+
+    render_source_t src;
+    psd_rect_t region;
+    psd_status_t st = layer_source(doc, layer_index, &src);
+    if (st == PSD_OK) st = resolve_rect(rect, src.width, src.height, &region);
+    if (st == PSD_OK) {
+        st = render_source_region(doc->allocator, &src, &region, NULL, 0, NULL,
+                                  callback, user_data);
+    }
+
+    layer_residency_end(doc, layer_index, &before);
+    return st;
+}
+
+psd_status_t psd_render_layer_content_rows(
+    psd_document_t *doc,
+    int32_t layer_index,
+    const psd_rect_t *rect,
+    const uint8_t *empty_rows,
+    psd_render_scanline_fn callback,
+    void *user_data)
+{
+    if (!doc || !callback) return PSD_ERR_NULL_POINTER;
+
+    render_source_t src;
+    psd_status_t st = layer_source(doc, layer_index, &src);
+    if (st != PSD_OK) return st;
+    src.skip_rows = empty_rows;
+
+    psd_rect_t region;
+    st = resolve_rect(rect, src.width, src.height, &region);
+    if (st != PSD_OK) return st;
+
+    return render_source_region(doc->allocator, &src, &region, NULL, 0, NULL, callback, user_data);
+}
+
+PSD_API psd_status_t psd_document_render_composite_to_target(
+    const psd_document_t *doc,
+    const psd_rect_t *rect,
+    const psd_render_target_t *target)
+{
+    if (!doc || !target || !target->pixels) return PSD_ERR_NULL_POINTER;
+
+    psd_rect_t region;
+    psd_status_t st = resolve_rect(rect, doc->width, doc->height, &region);
+    if (st != PSD_OK) return st;
+
+    uint8_t *out = NULL;
+    size_t stride = 0;
+    psd_rgba8_finish_fn finish = NULL;
+    st = resolve_target(target, &region, &out, &stride, &finish);
+    if (st != PSD_OK) return st;
+
+    render_source_t src;
+    st = composite_source((psd_document_t *)doc, &src);
+    if (st != PSD_OK) return st;
+
+    return render_source_region(doc->allocator, &src, &region, out, stride, finish, NULL, NULL);
+}
+
+PSD_API psd_status_t psd_document_render_layer_to_target(
+    psd_document_t *doc,
+    int32_t layer_index,
+    const psd_rect_t *rect,
+    const psd_render_target_t *target)
+{
+    if (!doc || !target || !target->pixels) return PSD_ERR_NULL_POINTER;
+
+    layer_residency_t before;
+    layer_residency_begin(doc, layer_index, &before);
+
+    render_source_t src;
+    psd_rect_t region;
+    uint8_t *out = NULL;
+    size_t stride = 0;
+    psd_rgba8_finish_fn finish = NULL;
+    psd_status_t st = layer_source(doc, layer_index, &src);
+    if (st == PSD_OK) st = resolve_rect(rect, src.width, src.height, &region);
+    if (st == PSD_OK) st = resolve_target(target, &region, &out, &stride, &finish);
+    if (st == PSD_OK) {
+        st = render_source_region(doc->allocator, &src, &region, out, stride, finish,
+                                  NULL, NULL);
+    }
+
+    layer_residency_end(doc, layer_index, &before);
+    return st;
+}
+
+/* Size the composite from the header so a size query needs no pixel data */
+static psd_status_t render_composite_wide(
+    const psd_document_t *doc,
+    bool to_float,
+    void *out,
+    size_t out_size,
+    size_t *out_required_size)
+{
+    if (!doc) return PSD_ERR_NULL_POINTER;
+
+    const uint64_t pixel_bytes = to_float ? 4u * sizeof(float) : 4u * sizeof(uint16_t);
+    uint64_t required64 = (uint64_t)doc->width * (uint64_t)doc->height * pixel_bytes;
+    if (required64 > (uint64_t)SIZE_MAX) return PSD_ERR_OUT_OF_RANGE;
+    if (out_required_size) *out_required_size = (size_t)required64;
+    if (!out || out_size < (size_t)required64) return PSD_ERR_BUFFER_TOO_SMALL;
+
+    render_source_t src;
+    psd_status_t st = composite_source((psd_document_t *)doc, &src);
+    if (st != PSD_OK) return st;
+
+    return render_wide(doc->allocator, &src, to_float, out, out_size, NULL);
+}
+
+static psd_status_t render_layer_wide(
+    psd_document_t *doc,
+    int32_t layer_index,
+    bool to_float,
+    void *out,
+    size_t out_size,
+    size_t *out_required_size)
+{
+    if (!doc) return PSD_ERR_NULL_POINTER;
+
+    render_source_t src;
+    psd_status_t st = layer_source(doc, layer_index, &src);
+    if (st != PSD_OK) return st;
+
+    return render_wide(doc->allocator, &src, to_float, out, out_size, out_required_size);
+}
+
+PSD_API psd_status_t psd_document_render_composite_rgba16(
+    const psd_document_t *doc,
+    uint16_t *out_rgba,
+    size_t out_size,
+    size_t *out_required_size)
+{
+    return render_composite_wide(doc, false, out_rgba, out_size, out_required_size);
+}
+
+PSD_API psd_status_t psd_document_render_composite_rgbaf32(
+    const psd_document_t *doc,
+    float *out_rgba,
+    size_t out_size,
+    size_t *out_required_size)
+{
+    return render_composite_wide(doc, true, out_rgba, out_size, out_required_size);
+}
+
+PSD_API psd_status_t psd_document_render_layer_rgba16(
+    psd_document_t *doc,
+    int32_t layer_index,
+    uint16_t *out_rgba,
+    size_t out_size,
+    size_t *out_required_size)
+{
+    return render_layer_wide(doc, layer_index, false, out_rgba, out_size, out_required_size);
+}
+
+PSD_API psd_status_t psd_document_render_layer_rgbaf32(
+    psd_document_t *doc,
+    int32_t layer_index,
+    float *out_rgba,
+    size_t out_size,
+    size_t *out_required_size)
+{
+    return render_layer_wide(doc, layer_index, true, out_rgba, out_size, out_required_size);
+}
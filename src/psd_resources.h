@@ -51,6 +51,7 @@ typedef struct {
     uint8_t *name;            /**< Pascal string name (NULL for empty name) */
     size_t name_length;       /**< Length of name string */
     uint8_t *data;            /**< Raw resource data */
+    bool data_borrowed;       /**< data points into a file mapping and must not be freed */
     uint64_t data_length;     /**< Length of resource data */
 } psd_resource_block_t;
 
@@ -1,6 +1,6 @@
 /**
  * @file psd_rle.c
- * @brief PSD RLE decompression implementation
+ * @brief PSD RLE compression and decompression implementation
  * 
  * Part of the OpenPSD library.
  * 
@@ -14,8 +14,17 @@
  */
 
 #include "psd_rle.h"
+#include "psd_alloc.h"
+#include "psd_endian.h"
+#include "psd_threads.h"
 #include <string.h>
 
+/* Outputs smaller than this decode on the calling thread */
+#define PSD_RLE_PARALLEL_MIN_BYTES ((uint64_t)4 << 20)
+
+/* Target decoded bytes per chunk */
+#define PSD_RLE_CHUNK_BYTES ((uint64_t)1 << 20)
+
 /**
  * @brief Decompress a single RLE-encoded scanline
  *
@@ -178,3 +187,152 @@ psd_status_t psd_rle_decode(
     *out_len = total_decompressed;
     return PSD_OK;
 }
+
+psd_status_t psd_rle_decode_row(const uint8_t *src, size_t src_len,
+                                uint8_t *dst, size_t dst_len)
+{
+    size_t out_len = 0;
+    return psd_rle_decode_scanline(src, src_len, dst_len, dst, &out_len);
+}
+
+/* Rows [first_row, end_row) starting at rle_offset */
+typedef struct {
+    uint64_t first_row;
+    uint64_t end_row;
+    uint64_t rle_offset;
+    psd_status_t status;
+} psd_rle_chunk_t;
+
+typedef struct {
+    const psd_rle_rows_t *rows;
+    psd_rle_chunk_t *chunks;
+} psd_rle_batch_t;
+
+static uint64_t psd_rle_row_count(const psd_rle_rows_t *rows, uint64_t row)
+{
+    const uint8_t *p = rows->counts + row * rows->count_bytes;
+    return (rows->count_bytes == 2) ? (uint64_t)psd_read_be16(p)
+                                    : (uint64_t)psd_read_be32(p);
+}
+
+static psd_status_t psd_rle_decode_chunk(const psd_rle_rows_t *rows, const psd_rle_chunk_t *chunk)
+{
+    uint64_t offset = chunk->rle_offset;
+    for (uint64_t y = chunk->first_row; y < chunk->end_row; y++) {
+        uint64_t length = psd_rle_row_count(rows, y);
+        psd_status_t status = rows->decode_row(rows->rle + offset, (size_t)length,
+                                               rows->dst + (size_t)y * rows->dst_stride,
+                                               rows->row_bytes);
+        if (status != PSD_OK) {
+            return status;
+        }
+        offset += length;
+    }
+    return PSD_OK;
+}
+
+static void psd_rle_chunk_task(void *task_data, size_t index)
+{
+    psd_rle_batch_t *batch = (psd_rle_batch_t *)task_data;
+    batch->chunks[index].status = psd_rle_decode_chunk(batch->rows, &batch->chunks[index]);
+}
+
+psd_status_t psd_rle_decode_rows(const psd_rle_rows_t *rows,
+                                 bool parallel,
+                                 const psd_allocator_t *allocator)
+{
+    if (!rows || !rows->decode_row || rows->dst_stride < rows->row_bytes ||
+        (rows->rows > 0 && (!rows->counts || !rows->dst))) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    if (rows->rows == 0 || rows->row_bytes == 0) {
+        return PSD_OK;
+    }
+
+    uint64_t output = rows->rows * (uint64_t)rows->row_bytes;
+    size_t workers = parallel ? psd_builtin_thread_count() : 1;
+
+    uint64_t chunk_rows = rows->rows;
+    if (workers > 1 && output >= PSD_RLE_PARALLEL_MIN_BYTES) {
+        chunk_rows = PSD_RLE_CHUNK_BYTES / rows->row_bytes;
+        if (chunk_rows == 0) chunk_rows = 1;
+    }
+    uint64_t chunk_count = (rows->rows + chunk_rows - 1) / chunk_rows;
+
+    psd_rle_chunk_t single;
+    psd_rle_chunk_t *chunks = &single;
+    if (chunk_count > 1) {
+        if (chunk_count > SIZE_MAX / sizeof(*chunks)) {
+            return PSD_ERR_OUT_OF_RANGE;
+        }
+        chunks = (psd_rle_chunk_t *)psd_alloc_malloc(allocator,
+                                                     (size_t)chunk_count * sizeof(*chunks));
+        if (!chunks) {
+            return PSD_ERR_OUT_OF_MEMORY;
+        }
+    }
+
+    /* Prefix sum of the counts gives every chunk's start; it also proves the
+     * counts stay inside the data, so chunks never need to check that */
+    uint64_t offset = 0;
+    for (uint64_t c = 0; c < chunk_count; c++) {
+        chunks[c].first_row = c * chunk_rows;
+        chunks[c].end_row = (c + 1 == chunk_count) ? rows->rows : (c + 1) * chunk_rows;
+        chunks[c].rle_offset = offset;
+        chunks[c].status = PSD_OK;
+        for (uint64_t y = chunks[c].first_row; y < chunks[c].end_row; y++) {
+            offset += psd_rle_row_count(rows, y);
+        }
+        if (offset > rows->rle_length) {
+            if (chunks != &single) psd_alloc_free(allocator, chunks);
+            return PSD_ERR_CORRUPT_DATA;
+        }
+    }
+
+    psd_status_t status = PSD_OK;
+    if (chunk_count == 1) {
+        status = psd_rle_decode_chunk(rows, &single);
+    } else {
+        psd_rle_batch_t batch = { rows, chunks };
+        psd_parallel_for(NULL, (size_t)chunk_count, psd_rle_chunk_task, &batch);
+        for (uint64_t c = 0; c < chunk_count && status == PSD_OK; c++) {
+            status = chunks[c].status;
+        }
+        psd_alloc_free(allocator, chunks);
+    }
+    return status;
+}
+
+size_t psd_rle_encode_row(const uint8_t *src, size_t src_len, uint8_t *dst)
+{
+    size_t si = 0;
+    size_t di = 0;
+
+    while (si < src_len) {
+        size_t run = 1;
+        while (si + run < src_len && run < 128 && src[si + run] == src[si]) {
+            run++;
+        }
+        if (run >= 2) {
+            dst[di++] = (uint8_t)(257 - run);
+            dst[di++] = src[si];
+            si += run;
+            continue;
+        }
+
+        /* Literal packet, ended early by a run worth its own packet */
+        size_t literal = 1;
+        while (si + literal < src_len && literal < 128) {
+            if (si + literal + 2 < src_len && src[si + literal] == src[si + literal + 1] &&
+                src[si + literal] == src[si + literal + 2]) {
+                break;
+            }
+            literal++;
+        }
+        dst[di++] = (uint8_t)(literal - 1);
+        memcpy(dst + di, src + si, literal);
+        di += literal;
+        si += literal;
+    }
+    return di;
+}
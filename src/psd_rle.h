@@ -1,8 +1,9 @@
 /**
  * @file psd_rle.h
- * @brief PSD RLE (Run-Length Encoding) decompression
+ * @brief PSD RLE (Run-Length Encoding) compression and decompression
  *
- * Implements PackBits-style RLE decompression as used in PSD files.
+ * Implements PackBits-style RLE decompression as used in PSD files, and the
+ * row encoder used by the writer.
  * Each scanline is encoded independently.
  * 
  * Part of the OpenPSD library.
@@ -21,6 +22,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include "../include/openpsd/psd_types.h"
 #include "../include/openpsd/psd_error.h"
 #include "../include/openpsd/psd_export.h"
@@ -68,4 +70,75 @@ PSD_INTERNAL psd_status_t psd_rle_decode(
     uint8_t *decompressed,
     size_t *out_len);
 
+/**
+ * @brief Decode one PackBits row of exactly dst_len bytes
+ */
+typedef psd_status_t (*psd_rle_row_decoder_fn)(const uint8_t *src, size_t src_len,
+                                               uint8_t *dst, size_t dst_len);
+
+/**
+ * @brief psd_rle_decode_scanline() as a psd_rle_row_decoder_fn
+ *
+ * Trailing input after the row is filled is ignored.
+ */
+PSD_INTERNAL psd_status_t psd_rle_decode_row(const uint8_t *src, size_t src_len,
+                                             uint8_t *dst, size_t dst_len);
+
+/**
+ * @brief Rows addressed through a byte counts table
+ *
+ * Row i has counts[i] bytes of PackBits data, stored right after row i - 1,
+ * and decodes to dst + i * row_bytes.
+ */
+typedef struct {
+    const uint8_t *counts;            /**< Byte counts table (rows counts) */
+    uint32_t count_bytes;             /**< Width of each count (2 or 4) */
+    const uint8_t *rle;               /**< PackBits data of row 0 */
+    uint64_t rle_length;              /**< Bytes of PackBits data available */
+    uint64_t rows;                    /**< Number of rows */
+    size_t row_bytes;                 /**< Decoded bytes per row */
+    uint8_t *dst;                     /**< Output, row y at dst + y * dst_stride */
+    size_t dst_stride;                /**< Bytes between output rows (>= row_bytes) */
+    psd_rle_row_decoder_fn decode_row; /**< Row decoder */
+} psd_rle_rows_t;
+
+/**
+ * @brief Decode a run of RLE rows, in parallel when the output is large
+ *
+ * A prefix sum over the counts table gives the start of every chunk of
+ * rows. The chunks are then decoded independently, straight into dst, on
+ * the built-in workers. Small outputs, or parallel == false, decode on the
+ * calling thread.
+ *
+ * @param rows Rows to decode
+ * @param parallel Allow worker threads
+ * @param allocator Allocator for the chunk table
+ * @return PSD_OK on success, PSD_ERR_CORRUPT_DATA when the counts overrun the
+ *         data, or the status of the first row that failed to decode
+ */
+PSD_INTERNAL psd_status_t psd_rle_decode_rows(const psd_rle_rows_t *rows,
+                                              bool parallel,
+                                              const psd_allocator_t *allocator);
+
+/**
+ * @brief Largest PackBits encoding of a row of n bytes
+ *
+ * One header byte per 128 literal bytes on top of the data itself.
+ */
+#define PSD_RLE_ENCODE_BOUND(n) ((n) + ((n) + 127u) / 128u)
+
+/**
+ * @brief PackBits-encode one row (internal)
+ *
+ * Runs of three or more equal bytes (two at the start of a packet) become
+ * repeat packets; everything else goes into literal packets of up to 128
+ * bytes. The output decodes with psd_rle_decode_scanline().
+ *
+ * @param src Row data
+ * @param src_len Row length in bytes
+ * @param dst Output, at least PSD_RLE_ENCODE_BOUND(src_len) bytes
+ * @return Encoded length in bytes
+ */
+PSD_INTERNAL size_t psd_rle_encode_row(const uint8_t *src, size_t src_len, uint8_t *dst);
+
 #endif /* PSD_RLE_H */
@@ -0,0 +1,441 @@
+/**
+ * @file psd_rows.c
+ * @brief Random row access to planar pixel data
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_rows.h"
+#include "psd_context.h"
+#include "psd_endian.h"
+#include "psd_layer_decode.h"
+#include "psd_rle.h"
+
+#include <string.h>
+
+static uint64_t psd_rle_count_at(const uint8_t *counts, uint32_t count_bytes,
+                                 uint64_t row) {
+    const uint8_t *p = counts + row * count_bytes;
+    return (count_bytes == 2) ? (uint64_t)psd_read_be16(p)
+                              : (uint64_t)psd_read_be32(p);
+}
+
+/* Bytes per decoded row of a plane */
+static size_t psd_plane_row_bytes(uint32_t width, uint16_t depth) {
+    if (depth == 1) {
+        return ((size_t)width + 7u) / 8u;
+    }
+    return (size_t)width * (size_t)(depth / 8u);
+}
+
+void psd_row_cursor_init_plane(psd_row_cursor_t *cursor,
+                               const uint8_t *plane,
+                               size_t row_bytes,
+                               uint32_t height) {
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->plane = plane;
+    cursor->row_bytes = row_bytes;
+    cursor->height = height;
+}
+
+void psd_row_cursor_init_rle(psd_row_cursor_t *cursor,
+                             const uint8_t *counts,
+                             uint32_t count_bytes,
+                             const uint8_t *rle,
+                             uint64_t rle_length,
+                             size_t row_bytes,
+                             uint32_t height) {
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->counts = counts;
+    cursor->count_bytes = count_bytes;
+    cursor->rle_start = rle;
+    cursor->rle_end = rle + rle_length;
+    cursor->rle = rle;
+    cursor->row = 0;
+    cursor->row_bytes = row_bytes;
+    cursor->height = height;
+}
+
+uint64_t psd_rle_counts_sum(const uint8_t *counts, uint32_t count_bytes,
+                            uint64_t rows) {
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < rows; i++) {
+        total += psd_rle_count_at(counts, count_bytes, i);
+    }
+    return total;
+}
+
+/* Point an RLE cursor at row y and get that row's PackBits length */
+static psd_status_t psd_row_cursor_seek(psd_row_cursor_t *cursor, uint32_t y,
+                                        uint64_t *out_length) {
+    /* Rows are only reachable by walking the counts table */
+    if (y < cursor->row) {
+        cursor->rle = cursor->rle_start;
+        cursor->row = 0;
+    }
+    while (cursor->row < y) {
+        uint64_t skip = psd_rle_count_at(cursor->counts, cursor->count_bytes,
+                                         cursor->row);
+        if (skip > (uint64_t)(cursor->rle_end - cursor->rle)) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        cursor->rle += skip;
+        cursor->row++;
+    }
+
+    uint64_t length = psd_rle_count_at(cursor->counts, cursor->count_bytes, y);
+    if (length > (uint64_t)(cursor->rle_end - cursor->rle)) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+    *out_length = length;
+    return PSD_OK;
+}
+
+psd_status_t psd_row_cursor_rle_row(psd_row_cursor_t *cursor,
+                                    uint32_t y,
+                                    const uint8_t **out_data,
+                                    size_t *out_length) {
+    if (!cursor || !out_data || !out_length) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (cursor->plane) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    if (y >= cursor->height) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    uint64_t length = 0;
+    psd_status_t status = psd_row_cursor_seek(cursor, y, &length);
+    if (status != PSD_OK) {
+        return status;
+    }
+    *out_data = cursor->rle;
+    *out_length = (size_t)length;
+    cursor->rle += length;
+    cursor->row++;
+    return PSD_OK;
+}
+
+psd_status_t psd_row_cursor_read(psd_row_cursor_t *cursor,
+                                 uint32_t y,
+                                 uint8_t *scratch,
+                                 const uint8_t **out_row) {
+    if (!cursor || !out_row) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (y >= cursor->height) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    if (cursor->plane) {
+        *out_row = cursor->plane + (size_t)y * cursor->row_bytes;
+        return PSD_OK;
+    }
+
+    if (!scratch) {
+        return PSD_ERR_NULL_POINTER;
+    }
+
+    uint64_t length = 0;
+    psd_status_t status = psd_row_cursor_seek(cursor, y, &length);
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    size_t out_len = 0;
+    status = psd_rle_decode_scanline(cursor->rle, (size_t)length,
+                                                  cursor->row_bytes, scratch,
+                                                  &out_len);
+    if (status != PSD_OK) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+
+    cursor->rle += length;
+    cursor->row++;
+    *out_row = scratch;
+    return PSD_OK;
+}
+
+/* Widen the nonzero byte range [*first, *end) by the nonzero bytes of src */
+static void psd_nonzero_span(const uint8_t *src, size_t pos, size_t count,
+                             size_t *first, size_t *end) {
+    size_t i = 0;
+    while (i < count && src[i] == 0) {
+        i++;
+    }
+    if (i == count) {
+        return;
+    }
+    size_t j = count;
+    while (src[j - 1] == 0) {
+        j--;
+    }
+    if (pos + i < *first) {
+        *first = pos + i;
+    }
+    if (pos + j > *end) {
+        *end = pos + j;
+    }
+}
+
+psd_status_t psd_row_cursor_extent(psd_row_cursor_t *cursor,
+                                   uint32_t y,
+                                   uint32_t sample_bytes,
+                                   uint32_t *out_first,
+                                   uint32_t *out_end) {
+    if (!cursor || !out_first || !out_end) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (y >= cursor->height) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+    if (sample_bytes == 0) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    const size_t n = cursor->row_bytes;
+    size_t first = n;
+    size_t end = 0;
+
+    if (cursor->plane) {
+        psd_nonzero_span(cursor->plane + (size_t)y * n, 0, n, &first, &end);
+    } else {
+        uint64_t length = 0;
+        psd_status_t status = psd_row_cursor_seek(cursor, y, &length);
+        if (status != PSD_OK) {
+            return status;
+        }
+
+        /* Walk the PackBits runs without writing them out: a repeat run
+         * settles its whole span from one byte */
+        const uint8_t *p = cursor->rle;
+        const uint8_t *stop = p + length;
+        size_t pos = 0;
+        while (p < stop && pos < n) {
+            int8_t header = (int8_t)*p++;
+            if (header >= 0) {
+                size_t run = (size_t)header + 1u;
+                if (run > (size_t)(stop - p)) {
+                    return PSD_ERR_CORRUPT_DATA;
+                }
+                psd_nonzero_span(p, pos, run < n - pos ? run : n - pos, &first, &end);
+                p += run;
+                pos += run;
+            } else if (header != -128) {
+                size_t run = (size_t)(1 - (int)header);
+                if (p >= stop) {
+                    return PSD_ERR_CORRUPT_DATA;
+                }
+                if (*p++ != 0) {
+                    if (pos < first) {
+                        first = pos;
+                    }
+                    end = pos + (run < n - pos ? run : n - pos);
+                }
+                pos += run;
+            }
+        }
+        cursor->rle += length;
+        cursor->row++;
+    }
+
+    if (first >= end) {
+        *out_first = *out_end = 0;
+    } else {
+        *out_first = (uint32_t)(first / sample_bytes);
+        *out_end = (uint32_t)((end + sample_bytes - 1u) / sample_bytes);
+    }
+    return PSD_OK;
+}
+
+psd_status_t psd_document_composite_row_cursors(psd_document_t *doc,
+                                                psd_row_cursor_t *cursors,
+                                                uint32_t count) {
+    if (!doc || !cursors) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (count > doc->channels) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    psd_status_t status = psd_document_load_composite(doc);
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    psd_composite_image_t *composite = &doc->composite;
+    size_t row_bytes = psd_plane_row_bytes(doc->width, doc->depth);
+    uint64_t plane_bytes = (uint64_t)row_bytes * doc->height;
+
+    /* Decoded planes only count once published; another thread may still
+     * be writing them */
+    const uint8_t *decoded = psd_once_done(&doc->composite_decoded) ? composite->data : NULL;
+
+    /* No random row access into a zlib stream: decode everything */
+    if (!decoded && (composite->compression == PSD_COMPRESSION_ZIP ||
+                     composite->compression == PSD_COMPRESSION_ZIP_PRED)) {
+        status = psd_document_decode_composite(doc);
+        if (status != PSD_OK) {
+            return status;
+        }
+        decoded = composite->data;
+        if (!decoded && composite->compressed_data) {
+            return PSD_ERR_UNSUPPORTED_COMPRESSION;
+        }
+    }
+
+    const uint8_t *planar = decoded;
+    if (!planar && composite->compression == PSD_COMPRESSION_RAW) {
+        planar = composite->compressed_data;
+    }
+
+    if (planar) {
+        uint64_t available = decoded ? composite->data_length
+                                     : composite->compressed_length;
+        if (available < plane_bytes * count) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        for (uint32_t c = 0; c < count; c++) {
+            psd_row_cursor_init_plane(&cursors[c], planar + (size_t)(plane_bytes * c),
+                                      row_bytes, doc->height);
+        }
+        return PSD_OK;
+    }
+
+    if (composite->compression != PSD_COMPRESSION_RLE || !composite->compressed_data) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    /* Layout: counts for every row of every plane, then all PackBits rows */
+    uint32_t count_bytes = composite->rle_count_bytes;
+    uint64_t table_size = (uint64_t)doc->channels * doc->height * count_bytes;
+    const uint8_t *rows = composite->compressed_data + table_size;
+    uint64_t rows_length = composite->compressed_length - table_size;
+    uint64_t offset = 0;
+
+    for (uint32_t c = 0; c < count; c++) {
+        const uint8_t *counts = composite->compressed_data +
+                                (size_t)((uint64_t)c * doc->height * count_bytes);
+        uint64_t plane_rle = psd_rle_counts_sum(counts, count_bytes, doc->height);
+        if (offset + plane_rle > rows_length) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        psd_row_cursor_init_rle(&cursors[c], counts, count_bytes, rows + offset,
+                                plane_rle, row_bytes, doc->height);
+        offset += plane_rle;
+    }
+    return PSD_OK;
+}
+
+static psd_status_t layer_channel_row_cursor(psd_document_t *doc,
+                                             psd_layer_record_t *layer,
+                                             psd_layer_channel_data_t *channel,
+                                             psd_row_cursor_t *cursor,
+                                             int16_t *channel_id) {
+    if (channel_id) {
+        *channel_id = channel->channel_id;
+    }
+
+    psd_status_t status = psd_document_load_channel(doc, channel);
+    if (status != PSD_OK) {
+        return status;
+    }
+
+    if (layer->bounds.right <= layer->bounds.left ||
+        layer->bounds.bottom <= layer->bounds.top) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    uint32_t width = (uint32_t)(layer->bounds.right - layer->bounds.left);
+    uint32_t height = (uint32_t)(layer->bounds.bottom - layer->bounds.top);
+
+    /* User masks (-2, -3) are always 8-bit */
+    uint16_t depth = (channel->channel_id == -2 || channel->channel_id == -3)
+                         ? 8 : doc->depth;
+    size_t row_bytes = psd_plane_row_bytes(width, depth);
+    uint64_t plane_bytes = (uint64_t)row_bytes * height;
+
+    if (psd_once_done(&channel->decoded)) {
+        if (channel->decoded_length < plane_bytes) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        psd_stats_decode_hit(doc->stats);
+        psd_row_cursor_init_plane(cursor, channel->decoded_data, row_bytes, height);
+        return PSD_OK;
+    }
+
+    if (!channel->compressed_data) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    switch (channel->compression) {
+    case PSD_COMPRESSION_RAW:
+        if (channel->compressed_length < plane_bytes) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        psd_row_cursor_init_plane(cursor, channel->compressed_data, row_bytes, height);
+        return PSD_OK;
+
+    case PSD_COMPRESSION_RLE: {
+        uint32_t count_bytes = 2;
+        uint64_t counts_size = 0;
+        uint64_t total_rle_bytes = 0;
+        status = psd_layer_channel_rle_layout(channel, height, &count_bytes,
+                                              &counts_size, &total_rle_bytes);
+        if (status != PSD_OK) {
+            return status;
+        }
+        psd_row_cursor_init_rle(cursor, channel->compressed_data, count_bytes,
+                                channel->compressed_data + counts_size,
+                                total_rle_bytes, row_bytes, height);
+        return PSD_OK;
+    }
+
+    default:
+        /* ZIP: no random row access, decode the whole channel */
+        status = psd_layer_channel_decode(channel, width, height, depth,
+                                          doc->allocator, doc->zip, !doc->serial_rows,
+                                          doc->stats);
+        if (status != PSD_OK) {
+            return status;
+        }
+        if (!channel->decoded_data) {
+            return PSD_ERR_UNSUPPORTED_COMPRESSION;
+        }
+        psd_row_cursor_init_plane(cursor, channel->decoded_data, row_bytes, height);
+        return PSD_OK;
+    }
+}
+
+psd_status_t psd_document_layer_row_cursor(psd_document_t *doc,
+                                           int32_t layer_index,
+                                           size_t channel_index,
+                                           psd_row_cursor_t *cursor,
+                                           int16_t *channel_id) {
+    if (!doc || !cursor) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (layer_index < 0 || layer_index >= doc->layers.layer_count) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    psd_layer_record_t *layer = &doc->layers.layers[layer_index];
+    if (channel_index >= layer->channel_count) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    /* Loaded payloads and ZIP planes count against the decode budget; the
+     * cursor's own layer is never evicted for it */
+    psd_layer_channel_data_t *channel = &layer->channels[channel_index];
+    psd_status_t status = layer_channel_row_cursor(doc, layer, channel, cursor, channel_id);
+    psd_decode_cache_touch(doc, layer_index, channel);
+    return status;
+}
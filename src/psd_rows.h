@@ -0,0 +1,181 @@
+/**
+ * @file psd_rows.h
+ * @brief Random row access to planar pixel data
+ *
+ * A row cursor hands out single scanlines of a composite plane or layer
+ * channel. RAW and already decoded planes are addressed in place; RLE planes
+ * are decoded one row at a time using the byte counts table, so rendering a
+ * region never needs the whole plane in memory.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_ROWS_H
+#define PSD_ROWS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../include/openpsd/psd.h"
+#include "../include/openpsd/psd_export.h"
+
+/**
+ * @brief Cursor over the scanlines of one plane
+ *
+ * Reading rows in increasing order costs one row decode each; going
+ * backwards rescans the counts table from the top.
+ */
+typedef struct {
+    const uint8_t *plane;       /**< Uncompressed plane, NULL for RLE */
+    const uint8_t *counts;      /**< RLE byte counts table (one count per row) */
+    const uint8_t *rle_start;   /**< PackBits data of row 0 */
+    const uint8_t *rle_end;     /**< End of the plane's PackBits data */
+    const uint8_t *rle;         /**< PackBits data of row `row` */
+    uint32_t count_bytes;       /**< Width of each count (2 or 4) */
+    uint32_t row;               /**< Row that rle points at */
+    uint32_t height;            /**< Number of rows */
+    size_t row_bytes;           /**< Decoded bytes per row */
+} psd_row_cursor_t;
+
+/**
+ * @brief Set up a cursor over an uncompressed plane
+ *
+ * @param cursor Cursor to initialize
+ * @param plane Plane data (height * row_bytes bytes)
+ * @param row_bytes Bytes per row
+ * @param height Number of rows
+ */
+PSD_INTERNAL void psd_row_cursor_init_plane(psd_row_cursor_t *cursor,
+                                            const uint8_t *plane,
+                                            size_t row_bytes,
+                                            uint32_t height);
+
+/**
+ * @brief Set up a cursor over an RLE plane
+ *
+ * @param cursor Cursor to initialize
+ * @param counts Byte counts table (height counts of count_bytes each)
+ * @param count_bytes Count width (2 or 4)
+ * @param rle PackBits data of row 0
+ * @param rle_length Bytes of PackBits data available from rle on
+ * @param row_bytes Decoded bytes per row
+ * @param height Number of rows
+ */
+PSD_INTERNAL void psd_row_cursor_init_rle(psd_row_cursor_t *cursor,
+                                          const uint8_t *counts,
+                                          uint32_t count_bytes,
+                                          const uint8_t *rle,
+                                          uint64_t rle_length,
+                                          size_t row_bytes,
+                                          uint32_t height);
+
+/**
+ * @brief Get one row
+ *
+ * @param cursor Cursor to read from
+ * @param y Row index
+ * @param scratch Buffer of at least row_bytes bytes for decoded RLE rows
+ * @param out_row Receives the row (points into the plane or at scratch)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE for a bad row,
+ *         PSD_ERR_CORRUPT_DATA for malformed RLE data
+ */
+PSD_INTERNAL psd_status_t psd_row_cursor_read(psd_row_cursor_t *cursor,
+                                              uint32_t y,
+                                              uint8_t *scratch,
+                                              const uint8_t **out_row);
+
+/**
+ * @brief Get the PackBits data of one row of an RLE cursor
+ *
+ * For decoders that write rows somewhere other than a plain scanline. Moves
+ * the cursor the same way psd_row_cursor_read() does.
+ *
+ * @param cursor RLE cursor (plane is NULL)
+ * @param y Row index
+ * @param out_data Receives the row's PackBits bytes
+ * @param out_length Receives their count
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT for a plane cursor,
+ *         PSD_ERR_OUT_OF_RANGE for a bad row, PSD_ERR_CORRUPT_DATA when the
+ *         counts overrun the data
+ */
+PSD_INTERNAL psd_status_t psd_row_cursor_rle_row(psd_row_cursor_t *cursor,
+                                                 uint32_t y,
+                                                 const uint8_t **out_data,
+                                                 size_t *out_length);
+
+/**
+ * @brief Find the columns of one row that hold nonzero samples
+ *
+ * RLE rows are read in the compressed domain: repeat runs are judged by
+ * their single byte and literal runs are scanned in place, so nothing is
+ * decoded. Moves the cursor the same way psd_row_cursor_read() does.
+ *
+ * @param cursor Cursor to read from
+ * @param y Row index
+ * @param sample_bytes Bytes per sample (1, 2 or 4)
+ * @param out_first Receives the first column with a nonzero sample
+ * @param out_end Receives one past the last such column (both 0 for an
+ *        all-zero row)
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_RANGE for a bad row,
+ *         PSD_ERR_CORRUPT_DATA for malformed RLE data
+ */
+PSD_INTERNAL psd_status_t psd_row_cursor_extent(psd_row_cursor_t *cursor,
+                                                uint32_t y,
+                                                uint32_t sample_bytes,
+                                                uint32_t *out_first,
+                                                uint32_t *out_end);
+
+/**
+ * @brief Sum of the byte counts of rows [0, rows)
+ *
+ * @param counts Byte counts table
+ * @param count_bytes Count width (2 or 4)
+ * @param rows Number of counts to add up
+ */
+PSD_INTERNAL uint64_t psd_rle_counts_sum(const uint8_t *counts,
+                                         uint32_t count_bytes,
+                                         uint64_t rows);
+
+/**
+ * @brief Set up row cursors over the composite image planes
+ *
+ * Does not decode RLE composites. ZIP composites have no random row access
+ * and are decoded in full.
+ *
+ * @param doc Document (the composite is loaded if it was deferred)
+ * @param cursors Receives one cursor per plane
+ * @param count Number of planes wanted (at most the document channel count)
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT if the document has no
+ *         composite, or another error code
+ */
+PSD_INTERNAL psd_status_t psd_document_composite_row_cursors(psd_document_t *doc,
+                                                             psd_row_cursor_t *cursors,
+                                                             uint32_t count);
+
+/**
+ * @brief Set up a row cursor over a layer channel
+ *
+ * RAW and RLE channels are not decoded; ZIP channels are decoded in full.
+ *
+ * @param doc Document (the channel payload is loaded if it was deferred)
+ * @param layer_index Layer index (0-based)
+ * @param channel_index Channel index within the layer (0-based)
+ * @param cursor Receives the cursor
+ * @param channel_id Receives the channel id (can be NULL)
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT if the channel has no
+ *         data, or another error code
+ */
+PSD_INTERNAL psd_status_t psd_document_layer_row_cursor(psd_document_t *doc,
+                                                        int32_t layer_index,
+                                                        size_t channel_index,
+                                                        psd_row_cursor_t *cursor,
+                                                        int16_t *channel_id);
+
+#endif /* PSD_ROWS_H */
@@ -0,0 +1,242 @@
+/**
+ * @file psd_stats.c
+ * @brief Opt-in counters and trace hooks for parsing and decoding
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* clock_gettime under strict C17 */
+#endif
+
+#include "psd_stats.h"
+#include "psd_alloc.h"
+#include "psd_context.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* Allocations carry their size in front, keeping the caller's alignment */
+#define PSD_STATS_HEADER sizeof(max_align_t)
+
+static uint64_t psd_stats_now(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static void psd_stats_lock(psd_stats_state_t *state)
+{
+    while (!psd_once_claim(&state->lock)) {
+        /* Held for a few additions */
+    }
+}
+
+static void psd_stats_unlock(psd_stats_state_t *state)
+{
+    psd_once_reset(&state->lock);
+}
+
+/* Account for size bytes coming (grow) or going (!grow) */
+static void psd_stats_account(psd_stats_state_t *state, size_t size, bool grow, bool call)
+{
+    psd_stats_t *s = &state->stats;
+    psd_stats_lock(state);
+    if (grow) {
+        s->allocations += call ? 1u : 0u;
+        s->bytes_in_use += size;
+        if (s->bytes_in_use > s->peak_bytes) s->peak_bytes = s->bytes_in_use;
+    } else {
+        s->frees += call ? 1u : 0u;
+        s->bytes_in_use -= (size <= s->bytes_in_use) ? size : s->bytes_in_use;
+    }
+    psd_stats_unlock(state);
+}
+
+static void *psd_stats_malloc(size_t size, void *user_data)
+{
+    psd_stats_state_t *state = (psd_stats_state_t *)user_data;
+    if (size > SIZE_MAX - PSD_STATS_HEADER) return NULL;
+    uint8_t *block = (uint8_t *)psd_alloc_malloc(state->base, size + PSD_STATS_HEADER);
+    if (!block) return NULL;
+    memcpy(block, &size, sizeof(size));
+    psd_stats_account(state, size, true, true);
+    return block + PSD_STATS_HEADER;
+}
+
+static void psd_stats_free(void *ptr, void *user_data)
+{
+    psd_stats_state_t *state = (psd_stats_state_t *)user_data;
+    if (!ptr) return;
+    uint8_t *block = (uint8_t *)ptr - PSD_STATS_HEADER;
+    size_t size = 0;
+    memcpy(&size, block, sizeof(size));
+    psd_stats_account(state, size, false, true);
+    psd_alloc_free(state->base, block);
+}
+
+static void *psd_stats_realloc(void *ptr, size_t size, void *user_data)
+{
+    psd_stats_state_t *state = (psd_stats_state_t *)user_data;
+    if (!ptr) return psd_stats_malloc(size, user_data);
+    if (size > SIZE_MAX - PSD_STATS_HEADER) return NULL;
+
+    uint8_t *block = (uint8_t *)ptr - PSD_STATS_HEADER;
+    size_t old_size = 0;
+    memcpy(&old_size, block, sizeof(old_size));
+    block = (uint8_t *)psd_alloc_realloc(state->base, block, size + PSD_STATS_HEADER);
+    if (!block) return NULL;
+    memcpy(block, &size, sizeof(size));
+    psd_stats_account(state, old_size, false, false);
+    psd_stats_account(state, size, true, true);
+    return block + PSD_STATS_HEADER;
+}
+
+psd_stats_state_t *psd_stats_create(const psd_allocator_t *base,
+                                    const psd_trace_hooks_t *hooks)
+{
+    psd_stats_state_t *state =
+        (psd_stats_state_t *)psd_alloc_malloc(base, sizeof(psd_stats_state_t));
+    if (!state) return NULL;
+    memset(state, 0, sizeof(*state));
+    state->allocator.malloc = psd_stats_malloc;
+    state->allocator.realloc = psd_stats_realloc;
+    state->allocator.free = psd_stats_free;
+    state->allocator.user_data = state;
+    state->base = base;
+    if (hooks) state->hooks = *hooks;
+    psd_once_reset(&state->lock);
+    return state;
+}
+
+void psd_stats_destroy(psd_stats_state_t *state)
+{
+    if (!state) return;
+    psd_alloc_free(state->base, state);
+}
+
+uint64_t psd_stats_phase_begin(psd_stats_state_t *state, psd_phase_t phase)
+{
+    if (!state) return 0;
+    if (state->hooks.phase_begin) state->hooks.phase_begin(state->hooks.user_data, phase);
+    return psd_stats_now();
+}
+
+void psd_stats_phase_end(psd_stats_state_t *state, psd_phase_t phase, uint64_t start)
+{
+    if (!state) return;
+    uint64_t elapsed = psd_stats_now() - start;
+    psd_stats_lock(state);
+    state->stats.phase_ns[phase] += elapsed;
+    state->stats.phase_count[phase]++;
+    psd_stats_unlock(state);
+    if (state->hooks.phase_end) state->hooks.phase_end(state->hooks.user_data, phase, elapsed);
+}
+
+void psd_stats_stream(psd_stats_state_t *state, uint64_t bytes, uint64_t reads, uint64_t seeks)
+{
+    if (!state) return;
+    psd_stats_lock(state);
+    state->stats.bytes_read += bytes;
+    state->stats.stream_reads += reads;
+    state->stats.stream_seeks += seeks;
+    psd_stats_unlock(state);
+}
+
+void psd_stats_channel(psd_stats_state_t *state, uint64_t start, const psd_trace_channel_t *channel)
+{
+    if (!state) return;
+    psd_trace_channel_t timed = *channel;
+    timed.elapsed_ns = psd_stats_now() - start;
+
+    psd_stats_lock(state);
+    state->stats.phase_ns[PSD_PHASE_LAYER_DECODE] += timed.elapsed_ns;
+    state->stats.phase_count[PSD_PHASE_LAYER_DECODE]++;
+    state->stats.decode_cache_misses++;
+    if (timed.status == PSD_OK && timed.compression < 4) {
+        state->stats.channels_decoded[timed.compression]++;
+        state->stats.channel_bytes_decoded += timed.decoded_bytes;
+    }
+    psd_stats_unlock(state);
+
+    if (state->hooks.phase_end) {
+        state->hooks.phase_end(state->hooks.user_data, PSD_PHASE_LAYER_DECODE, timed.elapsed_ns);
+    }
+    if (state->hooks.channel_decoded) {
+        state->hooks.channel_decoded(state->hooks.user_data, &timed);
+    }
+}
+
+void psd_stats_decode_hit(psd_stats_state_t *state)
+{
+    if (!state) return;
+    psd_stats_lock(state);
+    state->stats.decode_cache_hits++;
+    psd_stats_unlock(state);
+}
+
+void psd_stats_tile(psd_stats_state_t *state, bool hit)
+{
+    if (!state) return;
+    psd_stats_lock(state);
+    if (hit) {
+        state->stats.tile_cache_hits++;
+    } else {
+        state->stats.tile_cache_misses++;
+    }
+    psd_stats_unlock(state);
+}
+
+/**
+ * @brief Get a document's counters
+ */
+PSD_API psd_status_t psd_document_get_stats(const psd_document_t *doc, psd_stats_t *out_stats)
+{
+    if (!doc || !out_stats) return PSD_ERR_NULL_POINTER;
+    if (!doc->stats) return PSD_ERR_NOT_INITIALIZED;
+
+    psd_stats_lock(doc->stats);
+    *out_stats = doc->stats->stats;
+    psd_stats_unlock(doc->stats);
+    return PSD_OK;
+}
+
+/**
+ * @brief Zero a document's counters
+ */
+PSD_API psd_status_t psd_document_reset_stats(psd_document_t *doc)
+{
+    if (!doc) return PSD_ERR_NULL_POINTER;
+    if (!doc->stats) return PSD_ERR_NOT_INITIALIZED;
+
+    psd_stats_lock(doc->stats);
+    uint64_t in_use = doc->stats->stats.bytes_in_use;
+    memset(&doc->stats->stats, 0, sizeof(doc->stats->stats));
+    doc->stats->stats.bytes_in_use = in_use;
+    doc->stats->stats.peak_bytes = in_use;
+    psd_stats_unlock(doc->stats);
+    return PSD_OK;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file psd_stats.h
+ * @brief Opt-in counters and trace hooks for parsing and decoding
+ *
+ * A document parsed with PSD_PARSE_COLLECT_STATS (or trace hooks) owns a
+ * psd_stats_state_t. Its allocator wraps the caller's allocator to count
+ * every allocation, and it is attached to the source stream while the
+ * document reads from it. Every recording function accepts NULL and does
+ * nothing then, so instrumented code paths cost one branch when stats are
+ * off.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_STATS_H
+#define PSD_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "psd_once.h"
+#include "../include/openpsd/psd.h"
+#include "../include/openpsd/psd_export.h"
+
+/**
+ * @brief Counters and hooks of one document
+ */
+typedef struct psd_stats_state {
+    psd_allocator_t allocator;        /**< Counting allocator handed to the document */
+    const psd_allocator_t *base;      /**< Caller's allocator (NULL = default) */
+    psd_trace_hooks_t hooks;          /**< Zeroed when no hooks were given */
+    psd_once_t lock;                  /**< Guards stats; decodes record from worker threads */
+    psd_stats_t stats;
+} psd_stats_state_t;
+
+/**
+ * @brief Create counters whose memory comes from base
+ *
+ * @param base Caller's allocator (NULL for default)
+ * @param hooks Trace callbacks to copy, or NULL
+ * @return New state, NULL when out of memory
+ */
+PSD_INTERNAL psd_stats_state_t *psd_stats_create(const psd_allocator_t *base,
+                                                 const psd_trace_hooks_t *hooks);
+
+/**
+ * @brief Free counters (safe if NULL)
+ *
+ * Everything allocated through the state's allocator must be freed first.
+ */
+PSD_INTERNAL void psd_stats_destroy(psd_stats_state_t *state);
+
+/**
+ * @brief Start timing a phase
+ *
+ * @return Start time to pass to psd_stats_phase_end() (0 when state is NULL)
+ */
+PSD_INTERNAL uint64_t psd_stats_phase_begin(psd_stats_state_t *state, psd_phase_t phase);
+
+/**
+ * @brief Finish timing a phase started at start
+ */
+PSD_INTERNAL void psd_stats_phase_end(psd_stats_state_t *state, psd_phase_t phase,
+                                      uint64_t start);
+
+/**
+ * @brief Record stream callback calls
+ *
+ * @param state Counters (safe if NULL)
+ * @param bytes Bytes the calls produced
+ * @param reads Read callbacks made
+ * @param seeks Seek callbacks made
+ */
+PSD_INTERNAL void psd_stats_stream(psd_stats_state_t *state, uint64_t bytes,
+                                   uint64_t reads, uint64_t seeks);
+
+/**
+ * @brief Record a channel decode timed from start (a decode cache miss)
+ *
+ * Ends the PSD_PHASE_LAYER_DECODE phase begun at start; elapsed_ns is filled
+ * in here.
+ */
+PSD_INTERNAL void psd_stats_channel(psd_stats_state_t *state, uint64_t start,
+                                    const psd_trace_channel_t *channel);
+
+/**
+ * @brief Record a channel request served by a plane decoded earlier
+ */
+PSD_INTERNAL void psd_stats_decode_hit(psd_stats_state_t *state);
+
+/**
+ * @brief Record a composite cache tile lookup
+ */
+PSD_INTERNAL void psd_stats_tile(psd_stats_state_t *state, bool hit);
+
+#endif /* PSD_STATS_H */
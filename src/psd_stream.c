@@ -15,21 +15,52 @@
  * in the Software without restriction.
  */
 
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* open/fstat/mmap under strict C17 */
+#endif
+
 #include "../include/openpsd/psd_stream.h"
 #include "../include/openpsd/psd_types.h"
 #include "psd_alloc.h"
 #include "psd_endian.h"
+#include "psd_once.h"
+#include "psd_stats.h"
+#include "psd_stream_internal.h"
+#include "psd_threads.h"
 #include <string.h>
 #include <stdint.h>
 #include <limits.h>
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** Read-ahead window size for custom streams */
+#define PSD_STREAM_DEFAULT_READ_BUFFER ((size_t)64 * 1024)
+
 /**
  * @brief Stream context
+ *
+ * Custom streams read through a window: the callbacks are positioned at
+ * window_start + window_length while the caller's position is
+ * window_start + window_pos. Reads of at least window_capacity bytes bypass it.
  */
 struct psd_stream {
     psd_stream_vtable_t vtable;     /**< Virtual method table */
     void *user_data;                /**< User-defined context */
     const psd_allocator_t *allocator; /**< Allocator used for this stream */
+    uint8_t *window;                /**< Read-ahead bytes (allocated on first read) */
+    size_t window_capacity;         /**< Window size, 0 = unbuffered */
+    size_t window_length;           /**< Valid bytes in the window */
+    size_t window_pos;              /**< Next byte to hand out */
+    int64_t window_start;           /**< Stream offset of window[0] */
+    psd_stats_state_t *stats;       /**< Counts callback calls (NULL = off) */
 };
 
 /**
@@ -129,6 +160,35 @@ static int64_t psd_buffer_stream_tell(
     return (int64_t)buf_stream->position;
 }
 
+/**
+ * @brief Buffer stream positional read callback
+ */
+static int64_t psd_buffer_stream_read_at(
+    psd_stream_t *stream,
+    uint64_t offset,
+    void *buffer,
+    size_t count,
+    void *user_data
+)
+{
+    (void)stream; /* Unused */
+    const psd_buffer_stream_t *buf_stream = (const psd_buffer_stream_t *)user_data;
+
+    if (!buf_stream || !buffer) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (offset > buf_stream->length) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    size_t remaining = buf_stream->length - (size_t)offset;
+    size_t to_read = (count < remaining) ? count : remaining;
+    if (to_read > 0) {
+        memcpy(buffer, buf_stream->buffer + offset, to_read);
+    }
+    return (int64_t)to_read;
+}
+
 /**
  * @brief Buffer stream close callback
  */
@@ -137,9 +197,9 @@ static psd_status_t psd_buffer_stream_close(
     void *user_data
 )
 {
-    (void)stream;
-    (void)user_data;
-    return PSD_OK; /* Nothing to clean up */
+    /* The buffer itself belongs to the caller; only the cursor is ours */
+    psd_alloc_free(stream->allocator, user_data);
+    return PSD_OK;
 }
 
 /**
@@ -151,6 +211,7 @@ static const psd_stream_vtable_t psd_buffer_vtable = {
     .seek = psd_buffer_stream_seek,
     .tell = psd_buffer_stream_tell,
     .close = psd_buffer_stream_close,
+    .read_at = psd_buffer_stream_read_at,
 };
 
 /**
@@ -187,7 +248,8 @@ PSD_API psd_stream_t* psd_stream_create_buffer(
     buf_ctx->length = length;
     buf_ctx->position = 0;
 
-    /* Initialize stream */
+    /* Initialize stream; memory needs no read-ahead */
+    memset(stream, 0, sizeof(*stream));
     stream->vtable = psd_buffer_vtable;
     stream->user_data = buf_ctx;
     stream->allocator = allocator;
@@ -195,6 +257,306 @@ PSD_API psd_stream_t* psd_stream_create_buffer(
     return stream;
 }
 
+/**
+ * @brief Read-only file mapping shared by a stream and the documents parsed from it
+ *
+ * Reference counted so that a document whose payloads borrow from the mapping
+ * stays valid after the stream that produced it has been destroyed. Nested
+ * documents and their views share it too and may be opened and freed on any
+ * thread, so the count is atomic.
+ */
+struct psd_stream_mapping {
+    const uint8_t *base;              /**< Start of the mapped file */
+    size_t length;                    /**< Mapped length (file size) */
+    psd_refcount_t refcount;          /**< Stream, view and document references */
+    const psd_allocator_t *allocator; /**< Allocator that owns this struct */
+#if defined(_WIN32)
+    HANDLE file;                      /**< File handle */
+    HANDLE map;                       /**< File mapping object */
+#endif
+};
+
+/**
+ * @brief Context for memory-mapped file streams
+ *
+ * The view member must come first so the buffer stream callbacks can be reused.
+ */
+typedef struct {
+    psd_buffer_stream_t view;         /**< Read cursor over the mapping */
+    psd_stream_mapping_t *mapping;    /**< Owned mapping reference */
+} psd_mmap_stream_t;
+
+/**
+ * @brief Map a file read-only into memory
+ */
+static psd_stream_mapping_t *psd_mapping_open(
+    const psd_allocator_t *allocator,
+    const char *path
+)
+{
+    psd_stream_mapping_t *mapping = (psd_stream_mapping_t *)psd_alloc_malloc(
+        allocator,
+        sizeof(*mapping)
+    );
+    if (!mapping) {
+        return NULL;
+    }
+    mapping->base = NULL;
+    mapping->length = 0;
+    psd_refcount_init(&mapping->refcount);
+    mapping->allocator = allocator;
+
+#if defined(_WIN32)
+    mapping->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapping->file == INVALID_HANDLE_VALUE) {
+        psd_alloc_free(allocator, mapping);
+        return NULL;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mapping->file, &size) || size.QuadPart <= 0 ||
+        (unsigned long long)size.QuadPart > (unsigned long long)SIZE_MAX) {
+        CloseHandle(mapping->file);
+        psd_alloc_free(allocator, mapping);
+        return NULL;
+    }
+
+    mapping->map = CreateFileMappingA(mapping->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping->map) {
+        CloseHandle(mapping->file);
+        psd_alloc_free(allocator, mapping);
+        return NULL;
+    }
+
+    mapping->base = (const uint8_t *)MapViewOfFile(mapping->map, FILE_MAP_READ, 0, 0, 0);
+    if (!mapping->base) {
+        CloseHandle(mapping->map);
+        CloseHandle(mapping->file);
+        psd_alloc_free(allocator, mapping);
+        return NULL;
+    }
+    mapping->length = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        psd_alloc_free(allocator, mapping);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 ||
+        (unsigned long long)st.st_size > (unsigned long long)SIZE_MAX) {
+        close(fd);
+        psd_alloc_free(allocator, mapping);
+        return NULL;
+    }
+
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* The mapping keeps its own reference to the file */
+    close(fd);
+    if (base == MAP_FAILED) {
+        psd_alloc_free(allocator, mapping);
+        return NULL;
+    }
+    mapping->base = (const uint8_t *)base;
+    mapping->length = (size_t)st.st_size;
+#endif
+
+    return mapping;
+}
+
+/**
+ * @brief Add a reference to a mapping
+ */
+psd_stream_mapping_t *psd_stream_mapping_retain(psd_stream_mapping_t *mapping)
+{
+    if (mapping) {
+        psd_refcount_retain(&mapping->refcount);
+    }
+    return mapping;
+}
+
+/**
+ * @brief Drop a reference to a mapping, unmapping the file on the last one
+ */
+void psd_stream_mapping_release(psd_stream_mapping_t *mapping)
+{
+    if (!mapping || !psd_refcount_release(&mapping->refcount)) {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile((LPCVOID)mapping->base);
+    CloseHandle(mapping->map);
+    CloseHandle(mapping->file);
+#else
+    munmap((void *)mapping->base, mapping->length);
+#endif
+    psd_alloc_free(mapping->allocator, mapping);
+}
+
+/**
+ * @brief Memory-mapped stream close callback
+ */
+static psd_status_t psd_mmap_stream_close(
+    psd_stream_t *stream,
+    void *user_data
+)
+{
+    psd_mmap_stream_t *ctx = (psd_mmap_stream_t *)user_data;
+    if (ctx) {
+        psd_stream_mapping_release(ctx->mapping);
+        psd_alloc_free(stream->allocator, ctx);
+    }
+    return PSD_OK;
+}
+
+/**
+ * @brief Virtual table for memory-mapped file streams
+ */
+static const psd_stream_vtable_t psd_mmap_vtable = {
+    .read = psd_buffer_stream_read,
+    .write = psd_buffer_stream_write,
+    .seek = psd_buffer_stream_seek,
+    .tell = psd_buffer_stream_tell,
+    .close = psd_mmap_stream_close,
+    .read_at = psd_buffer_stream_read_at,
+};
+
+/**
+ * @brief Create a mapped stream over part of a mapping
+ *
+ * Takes over one reference to mapping, which is released on failure.
+ */
+static psd_stream_t *psd_mmap_stream_create(
+    const psd_allocator_t *allocator,
+    psd_stream_mapping_t *mapping,
+    size_t offset,
+    size_t length
+)
+{
+    psd_stream_t *stream = (psd_stream_t *)psd_alloc_malloc(allocator, sizeof(*stream));
+    psd_mmap_stream_t *ctx = (psd_mmap_stream_t *)psd_alloc_malloc(
+        allocator,
+        sizeof(*ctx)
+    );
+    if (!stream || !ctx) {
+        psd_alloc_free(allocator, ctx);
+        psd_alloc_free(allocator, stream);
+        psd_stream_mapping_release(mapping);
+        return NULL;
+    }
+
+    ctx->mapping = mapping;
+    ctx->view.buffer = mapping->base + offset;
+    ctx->view.length = length;
+    ctx->view.position = 0;
+
+    memset(stream, 0, sizeof(*stream));
+    stream->vtable = psd_mmap_vtable;
+    stream->user_data = ctx;
+    stream->allocator = allocator;
+
+    return stream;
+}
+
+/**
+ * @brief Create a stream over a memory-mapped file
+ */
+PSD_API psd_stream_t* psd_stream_create_file_mmap(
+    const psd_allocator_t *allocator,
+    const char *path
+)
+{
+    if (!path) {
+        return NULL;
+    }
+
+    psd_stream_mapping_t *mapping = psd_mapping_open(allocator, path);
+    if (!mapping) {
+        return NULL;
+    }
+    return psd_mmap_stream_create(allocator, mapping, 0, mapping->length);
+}
+
+/**
+ * @brief Create a mapped stream over a range of a mapping
+ */
+psd_stream_t *psd_stream_create_mapping_view(const psd_allocator_t *allocator,
+                                             psd_stream_mapping_t *mapping,
+                                             uint64_t offset,
+                                             uint64_t length)
+{
+    if (!mapping || length == 0 || offset > mapping->length ||
+        length > mapping->length - offset) {
+        return NULL;
+    }
+    return psd_mmap_stream_create(allocator, psd_stream_mapping_retain(mapping),
+                                  (size_t)offset, (size_t)length);
+}
+
+/**
+ * @brief Where position 0 of a mapped stream lies in its mapping
+ */
+uint64_t psd_stream_mapping_origin(psd_stream_t *stream)
+{
+    psd_stream_mapping_t *mapping = psd_stream_get_mapping(stream);
+    if (!mapping) {
+        return 0;
+    }
+    const psd_mmap_stream_t *ctx = (const psd_mmap_stream_t *)stream->user_data;
+    return (uint64_t)(ctx->view.buffer - mapping->base);
+}
+
+/**
+ * @brief Get the file mapping behind a stream
+ */
+psd_stream_mapping_t *psd_stream_get_mapping(psd_stream_t *stream)
+{
+    if (!stream || stream->vtable.close != psd_mmap_stream_close) {
+        return NULL;
+    }
+    return ((psd_mmap_stream_t *)stream->user_data)->mapping;
+}
+
+/**
+ * @brief Borrow bytes at the current position without copying
+ */
+const uint8_t *psd_stream_borrow(psd_stream_t *stream, uint64_t count)
+{
+    if (!psd_stream_get_mapping(stream)) {
+        return NULL;
+    }
+
+    psd_buffer_stream_t *view = &((psd_mmap_stream_t *)stream->user_data)->view;
+    if (count > (uint64_t)(view->length - view->position)) {
+        return NULL;
+    }
+
+    const uint8_t *ptr = view->buffer + view->position;
+    view->position += (size_t)count;
+    psd_stats_stream(stream->stats, count, 0, 0);
+    return ptr;
+}
+
+/**
+ * @brief Borrow the bytes left before the end of the mapping, up to a limit
+ */
+const uint8_t *psd_stream_borrow_available(psd_stream_t *stream,
+                                           uint64_t max_count,
+                                           uint64_t *out_count)
+{
+    if (!out_count || !psd_stream_get_mapping(stream)) {
+        return NULL;
+    }
+
+    psd_buffer_stream_t *view = &((psd_mmap_stream_t *)stream->user_data)->view;
+    uint64_t remaining = (uint64_t)(view->length - view->position);
+    *out_count = (max_count < remaining) ? max_count : remaining;
+    return psd_stream_borrow(stream, *out_count);
+}
+
 /**
  * @brief Create a custom stream
  */
@@ -213,13 +575,339 @@ PSD_API psd_stream_t* psd_stream_create_custom(
         return NULL;
     }
 
+    memset(stream, 0, sizeof(*stream));
     stream->vtable = *vtable;
     stream->user_data = user_data;
     stream->allocator = allocator;
 
+    /* Buffer only streams whose position is known */
+    stream->window_start = vtable->tell(stream, user_data);
+    if (stream->window_start >= 0) {
+        stream->window_capacity = PSD_STREAM_DEFAULT_READ_BUFFER;
+    }
+
+    return stream;
+}
+
+/**
+ * @brief Context for sub-streams of streams that are not in memory
+ *
+ * Reads go through psd_stream_read_at() of the parent, shifted by origin,
+ * holding lock when one is set.
+ */
+typedef struct {
+    psd_stream_t *parent;   /**< Stream holding the bytes (not owned) */
+    uint64_t origin;        /**< Parent offset of position 0 */
+    uint64_t length;        /**< Bytes in the range */
+    uint64_t position;      /**< Current read position */
+    psd_once_t *lock;       /**< Guards the parent's reads (not owned, may be NULL) */
+} psd_substream_t;
+
+/**
+ * @brief Sub-stream positional read callback
+ */
+static int64_t psd_substream_read_at(
+    psd_stream_t *stream,
+    uint64_t offset,
+    void *buffer,
+    size_t count,
+    void *user_data
+)
+{
+    (void)stream; /* Unused */
+    const psd_substream_t *sub = (const psd_substream_t *)user_data;
+
+    if (!sub || !buffer) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (offset > sub->length) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    uint64_t remaining = sub->length - offset;
+    size_t to_read = ((uint64_t)count < remaining) ? count : (size_t)remaining;
+    if (to_read == 0) {
+        return 0;
+    }
+    if (!sub->lock) {
+        return psd_stream_read_at(sub->parent, sub->origin + offset, buffer, to_read);
+    }
+    psd_lock_acquire(sub->lock);
+    int64_t result = psd_stream_read_at(sub->parent, sub->origin + offset, buffer, to_read);
+    psd_once_reset(sub->lock);
+    return result;
+}
+
+/**
+ * @brief Sub-stream read callback
+ */
+static int64_t psd_substream_read(
+    psd_stream_t *stream,
+    void *buffer,
+    size_t count,
+    void *user_data
+)
+{
+    psd_substream_t *sub = (psd_substream_t *)user_data;
+    int64_t result = psd_substream_read_at(stream, sub ? sub->position : 0, buffer, count,
+                                           user_data);
+    if (result > 0) {
+        sub->position += (uint64_t)result;
+    }
+    return result;
+}
+
+/**
+ * @brief Sub-stream seek callback
+ */
+static int64_t psd_substream_seek(
+    psd_stream_t *stream,
+    int64_t offset,
+    void *user_data
+)
+{
+    (void)stream; /* Unused */
+    psd_substream_t *sub = (psd_substream_t *)user_data;
+
+    if (!sub) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (offset < 0 || (uint64_t)offset > sub->length) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    sub->position = (uint64_t)offset;
+    return offset;
+}
+
+/**
+ * @brief Sub-stream tell callback
+ */
+static int64_t psd_substream_tell(
+    psd_stream_t *stream,
+    void *user_data
+)
+{
+    (void)stream; /* Unused */
+    const psd_substream_t *sub = (const psd_substream_t *)user_data;
+    return sub ? (int64_t)sub->position : PSD_ERR_NULL_POINTER;
+}
+
+/**
+ * @brief Sub-stream prefetch callback: forward the ranges, shifted and clipped
+ */
+static psd_status_t psd_substream_prefetch(
+    psd_stream_t *stream,
+    const psd_stream_range_t *ranges,
+    size_t count,
+    void *user_data
+)
+{
+    const psd_substream_t *sub = (const psd_substream_t *)user_data;
+    if (!psd_stream_has_prefetch(sub->parent)) {
+        return PSD_OK;
+    }
+
+    psd_stream_range_t *shifted = (psd_stream_range_t *)psd_alloc_malloc(
+        stream->allocator, count * sizeof(*shifted));
+    if (!shifted) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (ranges[i].offset >= sub->length) {
+            continue;
+        }
+        uint64_t remaining = sub->length - ranges[i].offset;
+        shifted[n].offset = sub->origin + ranges[i].offset;
+        shifted[n].length = (ranges[i].length < remaining) ? ranges[i].length : remaining;
+        n++;
+    }
+    if (sub->lock) {
+        psd_lock_acquire(sub->lock);
+    }
+    psd_status_t status = psd_stream_prefetch(sub->parent, shifted, n);
+    if (sub->lock) {
+        psd_once_reset(sub->lock);
+    }
+    psd_alloc_free(stream->allocator, shifted);
+    return status;
+}
+
+/**
+ * @brief Sub-stream close callback
+ */
+static psd_status_t psd_substream_close(
+    psd_stream_t *stream,
+    void *user_data
+)
+{
+    /* The parent belongs to the caller */
+    psd_alloc_free(stream->allocator, user_data);
+    return PSD_OK;
+}
+
+/**
+ * @brief Virtual table for sub-streams
+ */
+static const psd_stream_vtable_t psd_substream_vtable = {
+    .read = psd_substream_read,
+    .write = psd_buffer_stream_write,
+    .seek = psd_substream_seek,
+    .tell = psd_substream_tell,
+    .close = psd_substream_close,
+    .read_at = psd_substream_read_at,
+    .prefetch = psd_substream_prefetch,
+};
+
+/**
+ * @brief Create a stream over a byte range of another stream
+ */
+PSD_API psd_stream_t* psd_stream_create_substream(
+    psd_stream_t *parent,
+    uint64_t offset,
+    uint64_t length
+)
+{
+    return psd_stream_create_locked_substream(parent, offset, length, NULL);
+}
+
+/**
+ * @brief Create a sub-stream whose reads of the parent hold a lock
+ */
+psd_stream_t *psd_stream_create_locked_substream(
+    psd_stream_t *parent,
+    uint64_t offset,
+    uint64_t length,
+    psd_once_t *lock
+)
+{
+    if (!parent || length == 0) {
+        return NULL;
+    }
+    const psd_allocator_t *allocator = parent->allocator;
+
+    /* Memory parents: a view of the same bytes */
+    if (parent->vtable.read == psd_buffer_stream_read) {
+        const psd_buffer_stream_t *view = (const psd_buffer_stream_t *)parent->user_data;
+        if (offset > view->length || length > view->length - offset) {
+            return NULL;
+        }
+        psd_stream_mapping_t *mapping = psd_stream_get_mapping(parent);
+        if (mapping) {
+            return psd_stream_create_mapping_view(
+                allocator, mapping, psd_stream_mapping_origin(parent) + offset, length);
+        }
+        return psd_stream_create_buffer(allocator, view->buffer + offset, (size_t)length);
+    }
+
+    /* A range of a range is a range of the outermost stream, read under
+     * the outer range's lock */
+    if (parent->vtable.close == psd_substream_close) {
+        const psd_substream_t *outer = (const psd_substream_t *)parent->user_data;
+        if (offset > outer->length || length > outer->length - offset) {
+            return NULL;
+        }
+        offset += outer->origin;
+        parent = outer->parent;
+        lock = outer->lock;
+    } else if (offset > (uint64_t)INT64_MAX || length > (uint64_t)INT64_MAX - offset) {
+        return NULL;
+    }
+
+    psd_stream_t *stream = (psd_stream_t *)psd_alloc_malloc(allocator, sizeof(*stream));
+    psd_substream_t *sub = (psd_substream_t *)psd_alloc_malloc(allocator, sizeof(*sub));
+    if (!stream || !sub) {
+        psd_alloc_free(allocator, sub);
+        psd_alloc_free(allocator, stream);
+        return NULL;
+    }
+
+    sub->parent = parent;
+    sub->origin = offset;
+    sub->length = length;
+    sub->position = 0;
+    sub->lock = lock;
+
+    /* Read ahead like custom streams: each refill is one positional read */
+    memset(stream, 0, sizeof(*stream));
+    stream->vtable = psd_substream_vtable;
+    stream->user_data = sub;
+    stream->allocator = allocator;
+    stream->window_capacity = PSD_STREAM_DEFAULT_READ_BUFFER;
+
     return stream;
 }
 
+/**
+ * @brief Call the read callback, counting it when stats are attached
+ */
+static int64_t psd_stream_call_read(psd_stream_t *stream, void *buffer, size_t count)
+{
+    int64_t result = stream->vtable.read(stream, buffer, count, stream->user_data);
+    psd_stats_stream(stream->stats, result > 0 ? (uint64_t)result : 0, 1, 0);
+    return result;
+}
+
+/**
+ * @brief Call the seek callback, counting it when stats are attached
+ */
+static int64_t psd_stream_call_seek(psd_stream_t *stream, int64_t offset)
+{
+    psd_stats_stream(stream->stats, 0, 0, 1);
+    return stream->vtable.seek(stream, offset, stream->user_data);
+}
+
+/**
+ * @brief Move the callbacks back to the caller's position and empty the window
+ */
+static psd_status_t psd_stream_drop_window(psd_stream_t *stream)
+{
+    if (stream->window_pos != stream->window_length) {
+        int64_t position = stream->window_start + (int64_t)stream->window_pos;
+        int64_t result = psd_stream_call_seek(stream, position);
+        if (result < 0) {
+            return (psd_status_t)result;
+        }
+    }
+    stream->window_start += (int64_t)stream->window_pos;
+    stream->window_length = 0;
+    stream->window_pos = 0;
+    return PSD_OK;
+}
+
+/**
+ * @brief Set the read-ahead buffer size of a stream
+ */
+PSD_API psd_status_t psd_stream_set_read_buffer(psd_stream_t *stream, size_t size)
+{
+    if (!stream) {
+        return PSD_ERR_NULL_POINTER;
+    }
+
+    /* Buffer and mapped streams already read from memory */
+    if (stream->vtable.read == psd_buffer_stream_read) {
+        return PSD_OK;
+    }
+
+    if (stream->window_capacity > 0) {
+        psd_status_t status = psd_stream_drop_window(stream);
+        if (status != PSD_OK) {
+            return status;
+        }
+    } else if (size > 0) {
+        stream->window_start = stream->vtable.tell(stream, stream->user_data);
+        if (stream->window_start < 0) {
+            return (psd_status_t)stream->window_start;
+        }
+    }
+
+    psd_alloc_free(stream->allocator, stream->window);
+    stream->window = NULL;
+    stream->window_capacity = size;
+    return PSD_OK;
+}
+
 /**
  * @brief Destroy a stream
  */
@@ -238,6 +926,7 @@ PSD_API psd_status_t psd_stream_destroy(psd_stream_t *stream)
     }
 
     /* Free the stream structure */
+    psd_alloc_free(allocator, stream->window);
     psd_alloc_free(allocator, stream);
 
     return result;
@@ -256,7 +945,50 @@ PSD_API int64_t psd_stream_read(
         return PSD_ERR_NULL_POINTER;
     }
 
-    return stream->vtable.read(stream, buffer, count, stream->user_data);
+    if (stream->window_capacity == 0) {
+        return psd_stream_call_read(stream, buffer, count);
+    }
+
+    /* Whatever the window already holds */
+    size_t available = stream->window_length - stream->window_pos;
+    size_t from_window = (count < available) ? count : available;
+    if (from_window > 0) {
+        memcpy(buffer, stream->window + stream->window_pos, from_window);
+        stream->window_pos += from_window;
+    }
+    if (from_window == count) {
+        return (int64_t)count;
+    }
+
+    /* The window is used up; callbacks sit at the caller's position */
+    uint8_t *rest = (uint8_t *)buffer + from_window;
+    size_t wanted = count - from_window;
+    stream->window_start += (int64_t)stream->window_length;
+    stream->window_length = 0;
+    stream->window_pos = 0;
+
+    if (!stream->window && wanted < stream->window_capacity) {
+        stream->window = (uint8_t *)psd_alloc_malloc(stream->allocator, stream->window_capacity);
+    }
+    if (!stream->window || wanted >= stream->window_capacity) {
+        /* Large reads go straight to the callbacks */
+        int64_t result = psd_stream_call_read(stream, rest, wanted);
+        if (result < 0) {
+            return from_window > 0 ? (int64_t)from_window : result;
+        }
+        stream->window_start += result;
+        return (int64_t)from_window + result;
+    }
+
+    int64_t result = psd_stream_call_read(stream, stream->window, stream->window_capacity);
+    if (result < 0) {
+        return from_window > 0 ? (int64_t)from_window : result;
+    }
+    stream->window_length = (size_t)result;
+    size_t from_refill = (wanted < stream->window_length) ? wanted : stream->window_length;
+    memcpy(rest, stream->window, from_refill);
+    stream->window_pos = from_refill;
+    return (int64_t)(from_window + from_refill);
 }
 
 /**
@@ -272,7 +1004,19 @@ PSD_API int64_t psd_stream_write(
         return PSD_ERR_NULL_POINTER;
     }
 
-    return stream->vtable.write(stream, buffer, count, stream->user_data);
+    if (stream->window_capacity == 0) {
+        return stream->vtable.write(stream, buffer, count, stream->user_data);
+    }
+
+    psd_status_t status = psd_stream_drop_window(stream);
+    if (status != PSD_OK) {
+        return status;
+    }
+    int64_t result = stream->vtable.write(stream, buffer, count, stream->user_data);
+    if (result > 0) {
+        stream->window_start += result;
+    }
+    return result;
 }
 
 /**
@@ -284,7 +1028,24 @@ PSD_API int64_t psd_stream_seek(psd_stream_t *stream, int64_t offset)
         return PSD_ERR_NULL_POINTER;
     }
 
-    return stream->vtable.seek(stream, offset, stream->user_data);
+    if (stream->window_capacity == 0) {
+        return psd_stream_call_seek(stream, offset);
+    }
+
+    /* Seeks that land inside the window stay there */
+    if (offset >= stream->window_start &&
+        offset - stream->window_start <= (int64_t)stream->window_length) {
+        stream->window_pos = (size_t)(offset - stream->window_start);
+        return offset;
+    }
+
+    int64_t result = psd_stream_call_seek(stream, offset);
+    if (result >= 0) {
+        stream->window_start = result;
+        stream->window_length = 0;
+        stream->window_pos = 0;
+    }
+    return result;
 }
 
 /**
@@ -296,9 +1057,107 @@ PSD_API int64_t psd_stream_tell(psd_stream_t *stream)
         return PSD_ERR_NULL_POINTER;
     }
 
+    if (stream->window_capacity > 0) {
+        return stream->window_start + (int64_t)stream->window_pos;
+    }
     return stream->vtable.tell(stream, stream->user_data);
 }
 
+/**
+ * @brief Read at an absolute offset
+ */
+PSD_API int64_t psd_stream_read_at(
+    psd_stream_t *stream,
+    uint64_t offset,
+    void *buffer,
+    size_t count
+)
+{
+    if (!stream || !buffer) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (offset > (uint64_t)INT64_MAX) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    if (stream->vtable.read_at) {
+        int64_t result = stream->vtable.read_at(stream, offset, buffer, count, stream->user_data);
+        psd_stats_stream(stream->stats, result > 0 ? (uint64_t)result : 0, 1, 0);
+        return result;
+    }
+
+    int64_t saved = psd_stream_tell(stream);
+    if (saved < 0) {
+        return saved;
+    }
+    int64_t result = psd_stream_seek(stream, (int64_t)offset);
+    if (result < 0) {
+        return result;
+    }
+
+    size_t read_total = 0;
+    while (read_total < count) {
+        result = psd_stream_read(stream, (uint8_t *)buffer + read_total, count - read_total);
+        if (result <= 0) {
+            break;
+        }
+        read_total += (size_t)result;
+    }
+
+    int64_t restored = psd_stream_seek(stream, saved);
+    if (result < 0 && read_total == 0) {
+        return result;
+    }
+    return (restored < 0) ? restored : (int64_t)read_total;
+}
+
+/**
+ * @brief Announce ranges about to be read
+ */
+PSD_API psd_status_t psd_stream_prefetch(
+    psd_stream_t *stream,
+    const psd_stream_range_t *ranges,
+    size_t count
+)
+{
+    if (!stream || (!ranges && count > 0)) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (!stream->vtable.prefetch || count == 0) {
+        return PSD_OK;
+    }
+    return stream->vtable.prefetch(stream, ranges, count, stream->user_data);
+}
+
+/**
+ * @brief Whether the stream does anything with prefetch hints
+ */
+bool psd_stream_has_prefetch(const psd_stream_t *stream)
+{
+    return stream && stream->vtable.prefetch;
+}
+
+/**
+ * @brief Attach counters to a stream
+ */
+psd_stats_state_t *psd_stream_set_stats(psd_stream_t *stream, psd_stats_state_t *stats)
+{
+    if (!stream) {
+        return NULL;
+    }
+    psd_stats_state_t *previous = stream->stats;
+    stream->stats = stats;
+    return previous;
+}
+
+/**
+ * @brief Counters attached to a stream
+ */
+psd_stats_state_t *psd_stream_get_stats(const psd_stream_t *stream)
+{
+    return stream ? stream->stats : NULL;
+}
+
 /**
  * @brief Read exactly count bytes
  */
@@ -397,6 +1256,12 @@ PSD_API psd_status_t psd_stream_skip(psd_stream_t *stream, size_t count)
         return PSD_OK;
     }
 
+    /* Short skips within the read-ahead window cost nothing */
+    if (count <= stream->window_length - stream->window_pos) {
+        stream->window_pos += count;
+        return PSD_OK;
+    }
+
     /* Use a fixed-size buffer to skip data */
     #define SKIP_BUFFER_SIZE 4096
     uint8_t buffer[SKIP_BUFFER_SIZE];
@@ -0,0 +1,156 @@
+/**
+ * @file psd_stream_internal.h
+ * @brief Internal stream helpers used by the parser
+ *
+ * Exposes the zero-copy view of memory-mapped streams to the parser so large
+ * payloads (channel data, resource blocks) can point straight into the file
+ * mapping instead of being copied.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_STREAM_INTERNAL_H
+#define PSD_STREAM_INTERNAL_H
+
+#include "../include/openpsd/psd_stream.h"
+#include "../include/openpsd/psd_export.h"
+#include "psd_once.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Opaque, reference-counted read-only file mapping
+ */
+typedef struct psd_stream_mapping psd_stream_mapping_t;
+
+/**
+ * @brief Get the file mapping backing a stream
+ *
+ * @param stream Stream to query
+ * @return Mapping for streams created by psd_stream_create_file_mmap, NULL otherwise
+ */
+PSD_INTERNAL psd_stream_mapping_t *psd_stream_get_mapping(psd_stream_t *stream);
+
+/**
+ * @brief Create a mapped stream over a range of a mapping
+ *
+ * The stream holds its own reference to the mapping.
+ *
+ * @param allocator Allocator for the stream
+ * @param mapping Mapping holding the bytes
+ * @param offset Start of the range in the mapping
+ * @param length Size of the range (non-zero)
+ * @return New stream, or NULL if the range does not fit or memory runs out
+ */
+PSD_INTERNAL psd_stream_t *psd_stream_create_mapping_view(const psd_allocator_t *allocator,
+                                                          psd_stream_mapping_t *mapping,
+                                                          uint64_t offset,
+                                                          uint64_t length);
+
+/**
+ * @brief Create a sub-stream whose reads of the parent hold a lock
+ *
+ * Same as psd_stream_create_substream(), but every read and prefetch of an
+ * unmapped parent takes lock, so the parent can be shared with other users
+ * of the lock. A range of such a stream takes the same lock.
+ *
+ * @param parent Stream holding the bytes
+ * @param offset Start of the range in parent
+ * @param length Size of the range (non-zero)
+ * @param lock Lock taken around parent reads (NULL for none); must outlive
+ *        the stream
+ * @return New stream, or NULL if the range does not fit or memory runs out
+ */
+PSD_INTERNAL psd_stream_t *psd_stream_create_locked_substream(psd_stream_t *parent,
+                                                              uint64_t offset,
+                                                              uint64_t length,
+                                                              psd_once_t *lock);
+
+/**
+ * @brief Mapping offset of position 0 of a mapped stream
+ *
+ * 0 for streams over a whole file, and for streams that are not mapped.
+ */
+PSD_INTERNAL uint64_t psd_stream_mapping_origin(psd_stream_t *stream);
+
+/**
+ * @brief Add a reference to a mapping
+ *
+ * @param mapping Mapping to retain (safe if NULL)
+ * @return The same mapping, for convenience
+ */
+PSD_INTERNAL psd_stream_mapping_t *psd_stream_mapping_retain(psd_stream_mapping_t *mapping);
+
+/**
+ * @brief Drop a reference to a mapping
+ *
+ * The file is unmapped when the last reference is released.
+ *
+ * @param mapping Mapping to release (safe if NULL)
+ */
+PSD_INTERNAL void psd_stream_mapping_release(psd_stream_mapping_t *mapping);
+
+/**
+ * @brief Borrow count bytes at the current position without copying
+ *
+ * On success the stream position advances by count, exactly as if the bytes
+ * had been read. The returned pointer stays valid for as long as a reference
+ * to the stream's mapping is held.
+ *
+ * @param stream Stream to borrow from
+ * @param count Number of bytes to borrow
+ * @return Pointer into the mapping, or NULL if the stream is not mapped or
+ *         fewer than count bytes remain (the position is then unchanged)
+ */
+PSD_INTERNAL const uint8_t *psd_stream_borrow(psd_stream_t *stream, uint64_t count);
+
+/**
+ * @brief Borrow up to max_count bytes at the current position without copying
+ *
+ * Like psd_stream_borrow(), but takes whatever is left when fewer than
+ * max_count bytes remain. Used for sections that run to the end of the file.
+ *
+ * @param stream Stream to borrow from
+ * @param max_count Maximum number of bytes to borrow
+ * @param out_count Receives the number of bytes borrowed
+ * @return Pointer into the mapping, or NULL if the stream is not mapped
+ */
+PSD_INTERNAL const uint8_t *psd_stream_borrow_available(psd_stream_t *stream,
+                                                        uint64_t max_count,
+                                                        uint64_t *out_count);
+
+/**
+ * @brief Whether a stream has a prefetch callback
+ *
+ * Lets callers skip collecting ranges that nobody would look at.
+ *
+ * @param stream Stream to query (safe if NULL)
+ */
+PSD_INTERNAL bool psd_stream_has_prefetch(const psd_stream_t *stream);
+
+/**
+ * @brief Count a stream's callback calls into a document's stats
+ *
+ * Calls made while stats are attached are recorded with psd_stats_stream().
+ *
+ * @param stream Stream to instrument (safe if NULL)
+ * @param stats Counters, or NULL to stop counting
+ * @return The counters attached before
+ */
+PSD_INTERNAL struct psd_stats_state *psd_stream_set_stats(psd_stream_t *stream,
+                                                          struct psd_stats_state *stats);
+
+/**
+ * @brief Counters currently attached to a stream (NULL if none)
+ */
+PSD_INTERNAL struct psd_stats_state *psd_stream_get_stats(const psd_stream_t *stream);
+
+#endif /* PSD_STREAM_INTERNAL_H */
@@ -0,0 +1,221 @@
+/**
+ * @file psd_tagged_blocks.c
+ * @brief Index of a layer's additional layer information blocks
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_tagged_blocks.h"
+#include "psd_context.h"
+#include "psd_endian.h"
+#include "psd_threads.h"
+#include <string.h>
+
+#define PSD_TAG_SIG_8BIM 0x3842494Du /* "8BIM" */
+#define PSD_TAG_SIG_8B64 0x38423634u /* "8B64" */
+
+/* Keys whose length field is 8 bytes in PSB files (Adobe spec, "Additional
+ * Layer Information") */
+bool psd_tagged_key_has_long_length(uint32_t key)
+{
+    switch (key) {
+        case 0x4C4D736Bu: /* LMsk */
+        case 0x4C723136u: /* Lr16 */
+        case 0x4C723332u: /* Lr32 */
+        case 0x4C617972u: /* Layr */
+        case 0x4D743136u: /* Mt16 */
+        case 0x4D743332u: /* Mt32 */
+        case 0x4D74726Eu: /* Mtrn */
+        case 0x416C7068u: /* Alph */
+        case 0x464D736Bu: /* FMsk */
+        case 0x6C6E6B32u: /* lnk2 */
+        case 0x46456964u: /* FEid */
+        case 0x46586964u: /* FXid */
+        case 0x50785344u: /* PxSD */
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Read the block header at pos
+ *
+ * @return Offset of the next block, or 0 if no complete block starts at pos
+ */
+static uint64_t psd_tagged_block_at(const uint8_t *data, uint64_t length, uint64_t pos,
+                                    bool is_psb, psd_tagged_block_t *out_block)
+{
+    if (pos > length || length - pos < 12) {
+        return 0;
+    }
+    const uint8_t *p = data + pos;
+    uint32_t sig = psd_read_be32(p);
+    if (sig != PSD_TAG_SIG_8BIM && sig != PSD_TAG_SIG_8B64) {
+        return 0;
+    }
+    uint32_t key = psd_read_be32(p + 4);
+    uint64_t header = 12;
+    uint64_t block_len = psd_read_be32(p + 8);
+    if (is_psb && psd_tagged_key_has_long_length(key)) {
+        if (length - pos < 16) {
+            return 0;
+        }
+        header = 16;
+        block_len = psd_read_be64(p + 8);
+    }
+    if (block_len > length - pos - header) {
+        return 0;
+    }
+
+    out_block->key = key;
+    out_block->offset = pos + header;
+    out_block->length = block_len;
+    out_block->descriptor = NULL;
+    psd_once_reset(&out_block->descriptor_once);
+
+    /* Payloads are padded to an even length; the pad byte may be missing on
+     * the last block */
+    uint64_t next = pos + header + block_len + (block_len & 1u);
+    return next < length ? next : length;
+}
+
+PSD_INTERNAL psd_status_t psd_tagged_blocks_index(psd_document_t *doc,
+                                                  psd_layer_record_t *layer,
+                                                  uint64_t start)
+{
+    if (!doc || !layer) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    layer->blocks = NULL;
+    layer->block_count = 0;
+    if (!layer->additional_data) {
+        return PSD_OK;
+    }
+
+    const uint8_t *data = layer->additional_data;
+    uint64_t length = layer->additional_length;
+    bool is_psb = doc->is_psb;
+
+    psd_tagged_block_t block;
+    uint32_t count = 0;
+    for (uint64_t pos = start;
+         count < UINT32_MAX && (pos = psd_tagged_block_at(data, length, pos, is_psb, &block)) != 0;) {
+        count++;
+    }
+    if (count == 0) {
+        return PSD_OK;
+    }
+
+    psd_tagged_block_t *blocks = (psd_tagged_block_t *)psd_alloc_malloc(
+        &doc->meta.allocator, (size_t)count * sizeof(psd_tagged_block_t));
+    if (!blocks) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    uint64_t pos = start;
+    for (uint32_t i = 0; i < count; i++) {
+        pos = psd_tagged_block_at(data, length, pos, is_psb, &blocks[i]);
+    }
+
+    layer->blocks = blocks;
+    layer->block_count = count;
+    return PSD_OK;
+}
+
+PSD_INTERNAL psd_tagged_block_t *psd_tagged_blocks_find(const psd_layer_record_t *layer,
+                                                        uint32_t key)
+{
+    if (!layer) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < layer->block_count; i++) {
+        if (layer->blocks[i].key == key) {
+            return &layer->blocks[i];
+        }
+    }
+    return NULL;
+}
+
+PSD_INTERNAL const uint8_t *psd_tagged_block_payload(const psd_layer_record_t *layer,
+                                                     const psd_tagged_block_t *block)
+{
+    return layer->additional_data + block->offset;
+}
+
+/**
+ * @brief Offset of the descriptor inside a block's payload, 0 if it has none
+ *
+ * Each offset lands just past the uint32 descriptor version (16).
+ */
+static uint64_t psd_tagged_descriptor_offset(uint32_t key)
+{
+    switch (key) {
+        case 0x536F436Fu: /* SoCo: solid color fill */
+        case 0x4764466Cu: /* GdFl: gradient fill */
+        case 0x5074466Cu: /* PtFl: pattern fill */
+        case 0x7673746Bu: /* vstk: vector stroke */
+        case 0x61727462u: /* artb: artboard */
+        case 0x61727464u: /* artd: artboard */
+        case 0x61626464u: /* abdd: artboard */
+        case 0x43674564u: /* CgEd: content generator */
+        case 0x70746873u: /* pths: path list */
+        case 0x616E4658u: /* anFX: animation effects */
+            return 4;
+        case 0x6C667832u: /* lfx2: object-based effects (version + descriptor version) */
+        case 0x6C6D6678u: /* lmfx: multiple effects */
+        case 0x76736367u: /* vscg: vector stroke content (key + descriptor version) */
+        case 0x766F676Bu: /* vogk: vector origination */
+            return 8;
+        case 0x536F4C64u: /* SoLd: smart object ('soLD', version, descriptor version) */
+        case 0x536F4C45u: /* SoLE */
+            return 12;
+        case 0x54795368u: /* TySh: text descriptor after the transform */
+            return 56;
+        default:
+            return 0;
+    }
+}
+
+PSD_INTERNAL psd_status_t psd_tagged_block_descriptor(psd_document_t *doc,
+                                                      const psd_layer_record_t *layer,
+                                                      psd_tagged_block_t *block,
+                                                      const psd_descriptor_flat_t **out_flat)
+{
+    if (!doc || !layer || !block || !out_flat) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    *out_flat = NULL;
+
+    uint64_t offset = psd_tagged_descriptor_offset(block->key);
+    if (offset == 0) {
+        return PSD_ERR_UNSUPPORTED_FEATURE;
+    }
+    /* One parse per block; callers arriving during it wait for the result */
+    if (!psd_once_enter(&block->descriptor_once)) {
+        *out_flat = block->descriptor;
+        return block->descriptor ? PSD_OK : PSD_ERR_CORRUPT_DATA;
+    }
+
+    psd_status_t status = PSD_ERR_CORRUPT_DATA;
+    const uint8_t *payload = psd_tagged_block_payload(layer, block);
+    if (block->length >= offset && block->length - offset <= SIZE_MAX &&
+        psd_read_be32(payload + offset - 4) == 16u) {
+        status = psd_descriptor_flat_parse(payload + offset, (size_t)(block->length - offset),
+                                           &doc->meta.allocator, doc->allocator, NULL,
+                                           &block->descriptor);
+    }
+    psd_once_publish(&block->descriptor_once);
+    if (status != PSD_OK) {
+        return status;
+    }
+    *out_flat = block->descriptor;
+    return PSD_OK;
+}
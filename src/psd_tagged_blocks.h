@@ -0,0 +1,83 @@
+/**
+ * @file psd_tagged_blocks.h
+ * @brief Index of a layer's additional layer information blocks
+ *
+ * The layer record pass walks each layer's tagged blocks once and records a
+ * (key, offset, length) entry for every block; payloads stay in the layer's
+ * additional_data. Descriptors inside a block are parsed only the first time
+ * a caller asks for them, so parse cost follows what is actually read.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_TAGGED_BLOCKS_H
+#define PSD_TAGGED_BLOCKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "psd_layer.h"
+#include "../include/openpsd/psd.h"
+#include "../include/openpsd/psd_error.h"
+#include "../include/openpsd/psd_export.h"
+
+/**
+ * @brief Whether a key's length field is 8 bytes wide in PSB files
+ */
+PSD_INTERNAL bool psd_tagged_key_has_long_length(uint32_t key);
+
+/**
+ * @brief Index the tagged blocks that start at an offset of additional_data
+ *
+ * Walks the blocks once to count them and once to fill an exactly sized
+ * table in the metadata arena. Stops quietly at the first bad signature or a
+ * length that runs past the data, keeping the blocks before it.
+ *
+ * @param doc Document owning the metadata arena
+ * @param layer Layer whose additional_data is indexed
+ * @param start Offset of the first block (after mask, blending ranges and name)
+ * @return PSD_OK or PSD_ERR_OUT_OF_MEMORY
+ */
+PSD_INTERNAL psd_status_t psd_tagged_blocks_index(psd_document_t *doc,
+                                                  psd_layer_record_t *layer,
+                                                  uint64_t start);
+
+/**
+ * @brief First block of a layer with the given key, or NULL
+ */
+PSD_INTERNAL psd_tagged_block_t *psd_tagged_blocks_find(const psd_layer_record_t *layer,
+                                                        uint32_t key);
+
+/**
+ * @brief Payload bytes of a block
+ */
+PSD_INTERNAL const uint8_t *psd_tagged_block_payload(const psd_layer_record_t *layer,
+                                                     const psd_tagged_block_t *block);
+
+/**
+ * @brief Parse the descriptor carried by a block, once
+ *
+ * Knows where keys such as 'lfx2', 'SoCo' or 'SoLd' keep their descriptor
+ * behind the block's version fields. The tree is cached on the entry and
+ * points into the layer's additional_data.
+ *
+ * @param doc Document owning the layer
+ * @param layer Layer owning the block
+ * @param block Block to parse
+ * @param out_flat Receives the cached tree
+ * @return PSD_OK, PSD_ERR_UNSUPPORTED_FEATURE if the key carries no
+ *         descriptor, or the error from the descriptor parser
+ */
+PSD_INTERNAL psd_status_t psd_tagged_block_descriptor(psd_document_t *doc,
+                                                      const psd_layer_record_t *layer,
+                                                      psd_tagged_block_t *block,
+                                                      const psd_descriptor_flat_t **out_flat);
+
+#endif /* PSD_TAGGED_BLOCKS_H */
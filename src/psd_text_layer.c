@@ -19,14 +19,15 @@
 #include "psd_text_layer.h"
 #include "psd_context.h"
 #include "psd_descriptor.h"
+#include "psd_engine_data.h"
 #include "psd_alloc.h"
 #include "psd_endian.h"
+#include "psd_threads.h"
 #include "psd_unicode.h"
 #include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
 
 /* Enable noisy debug for text descriptor parsing by defining PSD_TEXT_LAYER_DEBUG */
 #ifdef OPENPSD_TEXT_LAYER_DEBUG
@@ -40,44 +41,24 @@
  *
  * Parses descriptors only once, on first access. Subsequent calls return cached result.
  * This keeps initial PSD parsing fast while enabling descriptor access on demand.
+ * The flat descriptors index raw_tysh in place, so no value is copied.
  *
  * @param doc Document allocator and context
  * @param item Text layer to parse descriptors for (modified in-place)
  * @return PSD_OK on success, error code on failure
  */
-static psd_status_t psd_text_layer_ensure_descriptors_parsed(
+static psd_status_t psd_text_layer_parse_descriptors(
     psd_document_t *doc,
     psd_text_layer_t *item)
 {
-    if (!doc || !item) {
-        return PSD_ERR_NULL_POINTER;
-    }
-
-    /* Already parsed? Return success */
-    if (item->text_data != NULL) {
-        return PSD_OK;
-    }
-
     /* No raw data available? Can't parse */
-    if (!item->raw_tysh || item->raw_tysh_len == 0) {
+    if (!item->raw_tysh || item->raw_tysh_len == 0 || item->raw_tysh_len > SIZE_MAX) {
         return PSD_ERR_CORRUPT_DATA;
     }
 
     PSD_TL_DEBUG("DEBUG: Lazy-parsing descriptors for layer %u\n", item->layer_index);
 
-    /* Create stream over raw TySh payload */
-    psd_stream_t *stream = psd_stream_create_buffer(doc->allocator, item->raw_tysh,
-                                                    (size_t)item->raw_tysh_len);
-    if (!stream) {
-        PSD_TL_DEBUG("  Failed to create stream\n");
-        return PSD_ERR_OUT_OF_MEMORY;
-    }
-
-    psd_status_t status = PSD_OK;
-    uint16_t u16 = 0;
-    uint32_t u32 = 0;
-
-    /* Re-read TySh fields sequentially (no seeking-by-length):
+    /* TySh layout:
        1) uint16 tysh_version
        2) 6 x double transform (48 bytes)
        3) uint16 text_version
@@ -87,282 +68,59 @@ static psd_status_t psd_text_layer_ensure_descriptors_parsed(
        7) uint32 warp_desc_version
        8) warp_data descriptor (ActionDescriptor)
      */
-    status = psd_stream_read_be16(stream, &u16);
-    if (status != PSD_OK) goto cleanup;
-    item->tysh_version = u16;
-
-    /* Skip 6 doubles */
-    status = psd_stream_skip(stream, 48);
-    if (status != PSD_OK) goto cleanup;
-
-    status = psd_stream_read_be16(stream, &u16);
-    if (status != PSD_OK) goto cleanup;
-    item->text_version = u16;
-
-    status = psd_stream_read_be32(stream, &u32);
-    if (status != PSD_OK) goto cleanup;
-    item->text_desc_version = u32;
-
-    /* Parse text_data descriptor */
-    PSD_TL_DEBUG("  Parsing text_data descriptor...\n");
-    status = psd_parse_descriptor(stream, doc->allocator, doc->is_psb, &item->text_data);
-    if (status != PSD_OK) {
-        PSD_TL_DEBUG("  Failed to parse text_data: status=%d\n", status);
-        goto cleanup;
-    }
-
-    PSD_TL_DEBUG("  text_data parsed: class_id=%s, properties=%zu\n",
-            item->text_data && item->text_data->class_id ? item->text_data->class_id : "(empty)",
-            item->text_data ? item->text_data->property_count : 0);
-
-    /* Warp descriptor: some files may omit it.
-       If we can't read the warp header due to EOF, that's not fatal for text. */
-    status = psd_stream_read_be16(stream, &u16);
-    if (status != PSD_OK) {
-        PSD_TL_DEBUG("  No warp header (status=%d), returning text_data only\n", status);
-        status = PSD_OK;
-        goto cleanup_ok;
-    }
-    item->warp_version = u16;
-
-    status = psd_stream_read_be32(stream, &u32);
-    if (status != PSD_OK) {
-        PSD_TL_DEBUG("  No warp desc version (status=%d), returning text_data only\n", status);
-        status = PSD_OK;
-        goto cleanup_ok;
+    const uint8_t *data = item->raw_tysh;
+    size_t length = (size_t)item->raw_tysh_len;
+    if (length < 56) {
+        return PSD_ERR_CORRUPT_DATA;
     }
-    item->warp_desc_version = u32;
+    item->tysh_version = psd_read_be16(data);
+    item->text_version = psd_read_be16(data + 50);
+    item->text_desc_version = psd_read_be32(data + 52);
 
-    PSD_TL_DEBUG("  Parsing warp_data descriptor...\n");
-    status = psd_parse_descriptor(stream, doc->allocator, doc->is_psb, &item->warp_data);
+    size_t consumed = 0;
+    psd_status_t status = psd_descriptor_flat_parse(data + 56, length - 56, &doc->meta.allocator,
+                                                    doc->allocator, &consumed, &item->text_data);
     if (status != PSD_OK) {
-        /* warp is optional */
-        PSD_TL_DEBUG("  Failed to parse warp_data: status=%d (non-fatal)\n", status);
-        status = PSD_OK;
+        PSD_TL_DEBUG("  Failed to parse text_data: status=%d\n", status);
+        return status;
     }
-
-    PSD_TL_DEBUG("  Descriptors parsed OK\n");
-
-cleanup:
-    if (status != PSD_OK) {
-        if (item->text_data) {
-            psd_descriptor_free(item->text_data, doc->allocator);
-            item->text_data = NULL;
-        }
-        if (item->warp_data) {
-            psd_descriptor_free(item->warp_data, doc->allocator);
+    PSD_TL_DEBUG("  text_data parsed: %u nodes\n", item->text_data->count);
+
+    /* Warp descriptor: some files may omit it, and it is optional for text */
+    size_t warp_at = 56 + consumed;
+    if (length - warp_at >= 6) {
+        item->warp_version = psd_read_be16(data + warp_at);
+        item->warp_desc_version = psd_read_be32(data + warp_at + 2);
+        if (psd_descriptor_flat_parse(data + warp_at + 6, length - warp_at - 6,
+                                      &doc->meta.allocator, doc->allocator, NULL,
+                                      &item->warp_data) != PSD_OK) {
+            PSD_TL_DEBUG("  Failed to parse warp_data (non-fatal)\n");
             item->warp_data = NULL;
         }
     }
-    psd_stream_destroy(stream);
-    return status;
 
-cleanup_ok:
-    psd_stream_destroy(stream);
-    return status;
+    return PSD_OK;
 }
 
-static psd_status_t psd_descriptor_find_string_recursive(
-    const psd_descriptor_t *desc,
-    const char *key,
-    const char **out_str)
+/* Parse the descriptors once; threads that arrive meanwhile wait for them.
+ * A failed parse is retried by the next caller. */
+static psd_status_t psd_text_layer_ensure_descriptors_parsed(
+    psd_document_t *doc,
+    psd_text_layer_t *item)
 {
-    if (!desc || !key || !out_str) {
-        return PSD_ERR_INVALID_ARGUMENT;
-    }
-
-    for (size_t i = 0; i < desc->property_count; i++) {
-        const psd_descriptor_property_t *prop = &desc->properties[i];
-        if (prop->key && strcmp(prop->key, key) == 0) {
-            if (prop->value.type_id == PSD_DESC_STRING && prop->value.raw_data) {
-                *out_str = (const char *)prop->value.raw_data;
-                return PSD_OK;
-            }
-            /* key exists but not a string */
-            return PSD_ERR_INVALID_STRUCTURE;
-        }
-
-        /* recurse into objects/lists */
-        if (prop->value.object) {
-            psd_status_t st = psd_descriptor_find_string_recursive(prop->value.object, key, out_str);
-            if (st == PSD_OK) return PSD_OK;
-        }
-        if (prop->value.list) {
-            for (size_t j = 0; j < prop->value.list->item_count; j++) {
-                const psd_descriptor_value_t *v = &prop->value.list->items[j];
-                if (v->object) {
-                    psd_status_t st = psd_descriptor_find_string_recursive(v->object, key, out_str);
-                    if (st == PSD_OK) return PSD_OK;
-                }
-            }
-        }
+    if (!doc || !item) {
+        return PSD_ERR_NULL_POINTER;
     }
-
-    return PSD_ERR_INVALID_STRUCTURE; /* not found */
-}
-
-static psd_status_t psd_descriptor_find_raw_recursive(
-    const psd_descriptor_t *desc,
-    const char *key,
-    const uint8_t **out_data,
-    uint64_t *out_len,
-    uint32_t *out_type)
-{
-    if (!desc || !key || !out_data || !out_len) {
-        return PSD_ERR_INVALID_ARGUMENT;
-    }
-
-    for (size_t i = 0; i < desc->property_count; i++) {
-        const psd_descriptor_property_t *prop = &desc->properties[i];
-        if (prop->key && strcmp(prop->key, key) == 0) {
-            if (prop->value.raw_data && prop->value.data_length > 0) {
-                *out_data = (const uint8_t *)prop->value.raw_data;
-                *out_len = prop->value.data_length;
-                if (out_type) *out_type = prop->value.type_id;
-                return PSD_OK;
-            }
-            return PSD_ERR_INVALID_STRUCTURE;
-        }
-        if (prop->value.object) {
-            psd_status_t st = psd_descriptor_find_raw_recursive(prop->value.object, key, out_data, out_len, out_type);
-            if (st == PSD_OK) return PSD_OK;
-        }
-        if (prop->value.list) {
-            for (size_t j = 0; j < prop->value.list->item_count; j++) {
-                const psd_descriptor_value_t *v = &prop->value.list->items[j];
-                if (v->object) {
-                    psd_status_t st = psd_descriptor_find_raw_recursive(v->object, key, out_data, out_len, out_type);
-                    if (st == PSD_OK) return PSD_OK;
-                }
-            }
-        }
+    if (!psd_once_enter(&item->parsed)) {
+        return PSD_OK;
     }
-    return PSD_ERR_INVALID_STRUCTURE;
-}
-
-/* The public API no longer exposes font lists / debug tooling.
-   Keep EngineData decoding + minimal default-style extraction only. */
-
-/* Convert EngineData blob to UTF-8 readable text by decoding UTF-16 BOM strings in (...) */
-static psd_status_t psd_engine_data_to_utf8_text(
-    const psd_allocator_t *alloc,
-    const uint8_t *data,
-    size_t len,
-    char *out,
-    size_t out_sz)
-{
-    if (!data || len == 0 || !out || out_sz == 0) {
-        return PSD_ERR_INVALID_ARGUMENT;
-    }
-
-    size_t o = 0;
-    out[0] = '\0';
-    psd_status_t result = PSD_OK;
-
-    for (size_t i = 0; i < len; i++) {
-        uint8_t c = data[i];
-
-        /* decode BOM-prefixed UTF-16 strings inside parentheses */
-        if (c == '(') {
-            /* find closing ')' respecting backslash escapes */
-            size_t j = i + 1;
-            bool esc = false;
-            while (j < len) {
-                uint8_t cj = data[j];
-                if (!esc && cj == ')') break;
-                if (!esc && cj == '\\') { esc = true; j++; continue; }
-                esc = false;
-                j++;
-            }
-            if (j >= len) {
-                /* unmatched '(' - just copy and stop */
-                if (o + 1 >= out_sz) { result = PSD_ERR_BUFFER_TOO_SMALL; break; }
-                out[o++] = '(';
-                out[o] = '\0';
-                result = PSD_ERR_INVALID_FORMAT;
-                break;
-            }
-
-            size_t inner_len = (j > i + 1) ? (j - (i + 1)) : 0;
-            const uint8_t *inner = data + i + 1;
-
-            /* write '(' */
-            if (o + 1 >= out_sz) { result = PSD_ERR_BUFFER_TOO_SMALL; break; }
-            out[o++] = '(';
-
-            if (inner_len >= 2 && inner[0] == 0xFE && inner[1] == 0xFF) {
-                /* UTF-16BE content */
-                size_t utf8_len = 0;
-                uint8_t *utf8 = psd_utf16be_to_utf8(alloc, inner + 2, inner_len - 2, &utf8_len);
-                if (utf8) {
-                    size_t to_copy = utf8_len;
-                    if (o + to_copy + 2 >= out_sz) {
-                        to_copy = (out_sz > o + 2) ? (out_sz - o - 2) : 0;
-                        result = PSD_ERR_BUFFER_TOO_SMALL;
-                    }
-                    if (to_copy > 0) {
-                        memcpy(out + o, utf8, to_copy);
-                        o += to_copy;
-                    }
-                    psd_alloc_free(alloc, utf8);
-                }
-            } else if (inner_len >= 2 && inner[0] == 0xFF && inner[1] == 0xFE) {
-                /* UTF-16LE content: swap to BE then decode */
-                uint8_t *sw = (uint8_t *)psd_alloc_malloc(alloc, inner_len - 2);
-                if (sw) {
-                    size_t n = (inner_len - 2) & ~1u;
-                    for (size_t k = 0; k < n; k += 2) {
-                        sw[k] = inner[2 + k + 1];
-                        sw[k + 1] = inner[2 + k];
-                    }
-                    size_t utf8_len = 0;
-                    uint8_t *utf8 = psd_utf16be_to_utf8(alloc, sw, inner_len - 2, &utf8_len);
-                    psd_alloc_free(alloc, sw);
-                    if (utf8) {
-                        size_t to_copy = utf8_len;
-                        if (o + to_copy + 2 >= out_sz) {
-                            to_copy = (out_sz > o + 2) ? (out_sz - o - 2) : 0;
-                            result = PSD_ERR_BUFFER_TOO_SMALL;
-                        }
-                        if (to_copy > 0) {
-                            memcpy(out + o, utf8, to_copy);
-                            o += to_copy;
-                        }
-                        psd_alloc_free(alloc, utf8);
-                    }
-                }
-            } else {
-                /* treat as UTF-8/ASCII bytes */
-                size_t to_copy = inner_len;
-                if (o + to_copy + 2 >= out_sz) {
-                    to_copy = (out_sz > o + 2) ? (out_sz - o - 2) : 0;
-                    result = PSD_ERR_BUFFER_TOO_SMALL;
-                }
-                if (to_copy > 0) {
-                    memcpy(out + o, inner, to_copy);
-                    o += to_copy;
-                }
-            }
-
-            /* write ')' */
-            if (o + 1 >= out_sz) { result = PSD_ERR_BUFFER_TOO_SMALL; break; }
-            out[o++] = ')';
-            out[o] = '\0';
-
-            i = j; /* continue after ')' */
-            continue;
-        }
-
-        /* default byte copy */
-        if (o + 1 >= out_sz) {
-            result = PSD_ERR_BUFFER_TOO_SMALL;
-            break;
-        }
-        out[o++] = (char)c;
-        out[o] = '\0';
+    psd_status_t status = psd_text_layer_parse_descriptors(doc, item);
+    if (status == PSD_OK) {
+        psd_once_publish(&item->parsed);
+    } else {
+        psd_once_reset(&item->parsed);
     }
-
-    return result;
+    return status;
 }
 
 static psd_text_layer_t *psd_find_text_layer_mut(psd_document_t *doc, uint32_t layer_index)
@@ -370,6 +128,13 @@ static psd_text_layer_t *psd_find_text_layer_mut(psd_document_t *doc, uint32_t l
     if (!doc || !doc->text_layers.items || doc->text_layers.count == 0) {
         return NULL;
     }
+    if (doc->text_layers.by_layer) {
+        if (layer_index >= doc->text_layers.by_layer_count) {
+            return NULL;
+        }
+        uint32_t slot = doc->text_layers.by_layer[layer_index];
+        return slot ? &doc->text_layers.items[slot - 1u] : NULL;
+    }
     for (size_t i = 0; i < doc->text_layers.count; i++) {
         if (doc->text_layers.items[i].layer_index == layer_index) {
             return &doc->text_layers.items[i];
@@ -394,17 +159,54 @@ static psd_status_t psd_text_layer_get_engine_data_raw(
     psd_status_t st = psd_text_layer_ensure_descriptors_parsed(doc, text_layer);
     if (st != PSD_OK) return st;
 
-    const uint8_t *raw = NULL;
-    uint64_t raw_len = 0;
-    uint32_t raw_type = 0;
-    st = psd_descriptor_find_raw_recursive(text_layer->text_data, "EngineData", &raw, &raw_len, &raw_type);
-    if (st != PSD_OK) return st;
+    uint32_t node = psd_descriptor_flat_find_any(text_layer->text_data, 0, "EngineData");
+    if (!node) return PSD_ERR_INVALID_STRUCTURE;
+
+    size_t raw_len = 0;
+    const uint8_t *raw = psd_descriptor_flat_data(text_layer->text_data, node, &raw_len);
+    if (raw_len == 0) return PSD_ERR_INVALID_STRUCTURE;
 
     if (data) *data = raw;
     if (length) *length = raw_len;
     return PSD_OK;
 }
 
+/**
+ * @brief Tokenize a text layer's EngineData once and cache the tree
+ *
+ * @param doc Document owning the text layer
+ * @param layer_index Layer index (0-based)
+ * @param out_tree Receives the cached tree
+ * @return PSD_OK, or the error from the descriptor or tokenizer
+ */
+static psd_status_t psd_text_layer_ensure_engine_data(
+    psd_document_t *doc,
+    uint32_t layer_index,
+    const psd_engine_data_t **out_tree)
+{
+    psd_text_layer_t *text_layer = psd_find_text_layer_mut(doc, layer_index);
+    if (!text_layer) return PSD_ERR_CORRUPT_DATA;
+
+    if (psd_once_enter(&text_layer->engine_parsed)) {
+        const uint8_t *raw = NULL;
+        uint64_t raw_len = 0;
+        psd_status_t st = psd_text_layer_get_engine_data_raw(doc, layer_index, &raw, &raw_len);
+        if (st == PSD_OK && raw_len > SIZE_MAX) st = PSD_ERR_CORRUPT_DATA;
+        if (st == PSD_OK) {
+            st = psd_engine_data_parse(raw, (size_t)raw_len, &doc->meta.allocator,
+                                       doc->allocator, &text_layer->engine);
+        }
+        if (st != PSD_OK) {
+            psd_once_reset(&text_layer->engine_parsed);
+            return st;
+        }
+        psd_once_publish(&text_layer->engine_parsed);
+    }
+
+    *out_tree = text_layer->engine;
+    return PSD_OK;
+}
+
 /**
  * @brief Get text layer information by index
  *
@@ -456,125 +258,36 @@ psd_status_t psd_text_layer_get_text(
     }
 
     const char *s = NULL;
-    status = psd_descriptor_find_string_recursive(text_layer->text_data, "Txt ", &s);
-    if (status != PSD_OK || !s) {
-        return status; /* not found is a clean non-parse error */
+    char *decoded = NULL;
+    uint32_t node = psd_descriptor_flat_find_any(text_layer->text_data, 0, "Txt ");
+    if (node && text_layer->text_data->nodes[node].type_id == PSD_DESC_STRING) {
+        decoded = psd_descriptor_flat_text(text_layer->text_data, node, doc->allocator, NULL);
+        if (!decoded) {
+            return PSD_ERR_OUT_OF_MEMORY;
+        }
+        s = decoded;
+    } else {
+        /* Some writers leave out "Txt "; the editor copy in EngineData has it too */
+        const psd_engine_data_t *tree = NULL;
+        if (psd_text_layer_ensure_engine_data(doc, layer_index, &tree) != PSD_OK) {
+            return PSD_ERR_INVALID_STRUCTURE;
+        }
+        const psd_engine_node_t *text = psd_engine_data_path(
+            tree, psd_engine_data_root(tree), "EngineDict/Editor/Text");
+        if (!text || text->type != PSD_ENGINE_STRING) {
+            return PSD_ERR_INVALID_STRUCTURE;
+        }
+        s = text->string;
     }
 
     size_t slen = strlen(s);
     size_t copy_len = (slen < (buffer_size - 1)) ? slen : (buffer_size - 1);
     memcpy(buffer, s, copy_len);
     buffer[copy_len] = '\0';
+    psd_alloc_free(doc->allocator, decoded);
     return PSD_OK;
 }
 
-static const char *psd_find_token(const char *s, const char *token)
-{
-    if (!s || !token) return NULL;
-    return strstr(s, token);
-}
-
-static const char *psd_skip_ws(const char *p)
-{
-    while (p && *p && isspace((unsigned char)*p)) p++;
-    return p;
-}
-
-static bool psd_parse_int_after(const char *s, const char *token, int *out_val)
-{
-    const char *p = psd_find_token(s, token);
-    if (!p) return false;
-    p += strlen(token);
-    p = psd_skip_ws(p);
-    if (!p || !*p) return false;
-    char *endp = NULL;
-    long v = strtol(p, &endp, 10);
-    if (endp == p) return false;
-    *out_val = (int)v;
-    return true;
-}
-
-static bool psd_parse_double_after(const char *s, const char *token, double *out_val)
-{
-    const char *p = psd_find_token(s, token);
-    if (!p) return false;
-    p += strlen(token);
-    p = psd_skip_ws(p);
-    if (!p || !*p) return false;
-    char *endp = NULL;
-    double v = strtod(p, &endp);
-    if (endp == p) return false;
-    *out_val = v;
-    return true;
-}
-
-static bool psd_parse_rgb_after_fillcolor(const char *s, uint8_t out_rgba[4])
-{
-    const char *p = psd_find_token(s, "/FillColor");
-    if (!p) return false;
-
-    /* Prefer "Values [ ... ]" if present nearby */
-    const char *v = strstr(p, "Values");
-    if (v) p = v;
-
-    const char *br = strchr(p, '[');
-    if (!br) return false;
-    br++;
-
-    br = psd_skip_ws(br);
-    char *endp = NULL;
-    double r = strtod(br, &endp);
-    if (endp == br) return false;
-    br = psd_skip_ws(endp);
-    double g = strtod(br, &endp);
-    if (endp == br) return false;
-    br = psd_skip_ws(endp);
-    double b = strtod(br, &endp);
-    if (endp == br) return false;
-
-    /* EngineData typically uses 0..1 floats for RGB */
-    if (r < 0) { r = 0; }
-    if (r > 1) { r = 1; }
-    if (g < 0) { g = 0; }
-    if (g > 1) { g = 1; }
-    if (b < 0) { b = 0; }
-    if (b > 1) { b = 1; }
-
-    out_rgba[0] = (uint8_t)(r * 255.0 + 0.5);
-    out_rgba[1] = (uint8_t)(g * 255.0 + 0.5);
-    out_rgba[2] = (uint8_t)(b * 255.0 + 0.5);
-    out_rgba[3] = 255;
-    return true;
-}
-
-static size_t psd_extract_fontset_names(const char *s, char names[][PSD_TEXT_FONT_NAME_MAX], size_t max_names)
-{
-    if (!s || !names || max_names == 0) return 0;
-
-    const char *p = psd_find_token(s, "/FontSet");
-    if (!p) return 0;
-    p = strchr(p, '[');
-    if (!p) return 0;
-    p++;
-
-    size_t count = 0;
-    while (*p && count < max_names) {
-        const char *n = psd_find_token(p, "/Name");
-        if (!n) break;
-        const char *lp = strchr(n, '(');
-        const char *rp = lp ? strchr(lp + 1, ')') : NULL;
-        if (!lp || !rp) { p = n + 5; continue; }
-        size_t len = (size_t)(rp - (lp + 1));
-        if (len >= PSD_TEXT_FONT_NAME_MAX) len = PSD_TEXT_FONT_NAME_MAX - 1;
-        memcpy(names[count], lp + 1, len);
-        names[count][len] = '\0';
-        count++;
-        p = rp + 1;
-    }
-
-    return count;
-}
-
 psd_status_t psd_text_layer_get_matrix_bounds(
     psd_document_t *doc,
     uint32_t layer_index,
@@ -605,6 +318,219 @@ psd_status_t psd_text_layer_get_matrix_bounds(
     return PSD_OK;
 }
 
+
+/* Shared resources every run falls back to */
+typedef struct {
+    const psd_engine_data_t *tree;
+    const psd_engine_node_t *engine_dict;       /* EngineDict */
+    const psd_engine_node_t *font_set;          /* ResourceDict/FontSet */
+    const psd_engine_node_t *normal_style;      /* StyleSheetData of TheNormalStyleSheet */
+    const psd_engine_node_t *normal_paragraph;  /* Properties of TheNormalParagraphSheet */
+} psd_text_engine_resources_t;
+
+/* Item of a sheet set selected by the index stored under index_key */
+static const psd_engine_node_t *psd_text_normal_sheet(const psd_engine_data_t *tree,
+                                                      const psd_engine_node_t *resources,
+                                                      const char *set_key,
+                                                      const char *index_key,
+                                                      const char *data_key)
+{
+    double index = 0.0;
+    (void)psd_engine_data_number(tree, resources, index_key, &index);
+    if (index < 0.0 || index >= (double)UINT32_MAX) {
+        index = 0.0;
+    }
+    const psd_engine_node_t *sheet = psd_engine_data_item(
+        tree, psd_engine_data_get(tree, resources, set_key), (uint32_t)index);
+    return psd_engine_data_get(tree, sheet, data_key);
+}
+
+static psd_status_t psd_text_engine_resources(psd_document_t *doc,
+                                              uint32_t layer_index,
+                                              psd_text_engine_resources_t *res)
+{
+    memset(res, 0, sizeof(*res));
+    psd_status_t st = psd_text_layer_ensure_engine_data(doc, layer_index, &res->tree);
+    if (st != PSD_OK) return st;
+
+    const psd_engine_node_t *root = psd_engine_data_root(res->tree);
+    res->engine_dict = psd_engine_data_get(res->tree, root, "EngineDict");
+    if (!res->engine_dict) return PSD_ERR_INVALID_STRUCTURE;
+
+    /* ResourceDict is the layer's own copy; DocumentResources is the fallback */
+    const psd_engine_node_t *resources = psd_engine_data_get(res->tree, root, "ResourceDict");
+    if (!resources) {
+        resources = psd_engine_data_get(res->tree, root, "DocumentResources");
+    }
+    res->font_set = psd_engine_data_get(res->tree, resources, "FontSet");
+    res->normal_style = psd_text_normal_sheet(res->tree, resources, "StyleSheetSet",
+                                              "TheNormalStyleSheet", "StyleSheetData");
+    res->normal_paragraph = psd_text_normal_sheet(res->tree, resources, "ParagraphSheetSet",
+                                                  "TheNormalParagraphSheet", "Properties");
+    return PSD_OK;
+}
+
+/* Member from the run's own sheet, else from the normal sheet */
+static const psd_engine_node_t *psd_text_sheet_get(const psd_engine_data_t *tree,
+                                                   const psd_engine_node_t *sheet,
+                                                   const psd_engine_node_t *normal,
+                                                   const char *key)
+{
+    const psd_engine_node_t *member = psd_engine_data_get(tree, sheet, key);
+    return member ? member : psd_engine_data_get(tree, normal, key);
+}
+
+static bool psd_text_sheet_number(const psd_engine_data_t *tree,
+                                  const psd_engine_node_t *sheet,
+                                  const psd_engine_node_t *normal,
+                                  const char *key,
+                                  double *out_value)
+{
+    return psd_engine_data_number(tree, sheet, key, out_value) ||
+           psd_engine_data_number(tree, normal, key, out_value);
+}
+
+static uint8_t psd_text_unit_to_byte(double v)
+{
+    if (v < 0.0) v = 0.0;
+    if (v > 1.0) v = 1.0;
+    return (uint8_t)(v * 255.0 + 0.5);
+}
+
+static psd_text_justification_t psd_text_justification(double value)
+{
+    /* 3..6 are the justify-all variants (last line left/center/right/full) */
+    switch ((int)value) {
+        case 1: return PSD_TEXT_JUSTIFY_RIGHT;
+        case 2: return PSD_TEXT_JUSTIFY_CENTER;
+        case 3:
+        case 4:
+        case 5:
+        case 6: return PSD_TEXT_JUSTIFY_FULL;
+        default: return PSD_TEXT_JUSTIFY_LEFT;
+    }
+}
+
+/* Paragraph properties of a paragraph run (NULL if the run has none) */
+static const psd_engine_node_t *psd_text_paragraph_properties(
+    const psd_text_engine_resources_t *res, uint32_t run)
+{
+    const psd_engine_node_t *item = psd_engine_data_item(
+        res->tree, psd_engine_data_path(res->tree, res->engine_dict, "ParagraphRun/RunArray"), run);
+    return psd_engine_data_path(res->tree, item, "ParagraphSheet/Properties");
+}
+
+/* Style sheet data of a style run (NULL if the run has none) */
+static const psd_engine_node_t *psd_text_style_sheet(
+    const psd_text_engine_resources_t *res, uint32_t run)
+{
+    const psd_engine_node_t *item = psd_engine_data_item(
+        res->tree, psd_engine_data_path(res->tree, res->engine_dict, "StyleRun/RunArray"), run);
+    return psd_engine_data_path(res->tree, item, "StyleSheet/StyleSheetData");
+}
+
+/* Resolve one style sheet (over the normal sheet) and paragraph into a style */
+static void psd_text_resolve_style(const psd_text_engine_resources_t *res,
+                                   const psd_engine_node_t *sheet,
+                                   const psd_engine_node_t *paragraph,
+                                   psd_text_style_t *style)
+{
+    const psd_engine_data_t *tree = res->tree;
+    const psd_engine_node_t *normal = res->normal_style;
+
+    memset(style, 0, sizeof(*style));
+    style->color_rgba[3] = 255;
+    style->justification = PSD_TEXT_JUSTIFY_LEFT;
+
+    /* Font: index into the FontSet */
+    double font = 0.0;
+    (void)psd_text_sheet_number(tree, sheet, normal, "Font", &font);
+    if (font < 0.0 || font >= (double)UINT32_MAX) {
+        font = 0.0;
+    }
+    const psd_engine_node_t *face = psd_engine_data_item(tree, res->font_set, (uint32_t)font);
+    if (!face) {
+        face = psd_engine_data_item(tree, res->font_set, 0);
+    }
+    const psd_engine_node_t *name = psd_engine_data_get(tree, face, "Name");
+    if (name && name->type == PSD_ENGINE_STRING) {
+        size_t len = name->string_length;
+        if (len >= sizeof(style->font_name)) {
+            /* Truncate on a UTF-8 character boundary */
+            len = sizeof(style->font_name) - 1;
+            while (len > 0 && ((uint8_t)name->string[len] & 0xC0) == 0x80) {
+                len--;
+            }
+        }
+        memcpy(style->font_name, name->string, len);
+        style->font_name[len] = '\0';
+    }
+
+    (void)psd_text_sheet_number(tree, sheet, normal, "FontSize", &style->size);
+    (void)psd_text_sheet_number(tree, sheet, normal, "Tracking", &style->tracking);
+
+    /* Leading: explicit unless AutoLeading, which scales the size by the
+       paragraph's AutoLeading factor */
+    double auto_leading = 0.0;
+    double factor = 0.0;
+    bool has_leading = psd_text_sheet_number(tree, sheet, normal, "Leading", &style->leading);
+    (void)psd_text_sheet_number(tree, sheet, normal, "AutoLeading", &auto_leading);
+    bool has_factor = psd_text_sheet_number(tree, paragraph, res->normal_paragraph,
+                                            "AutoLeading", &factor) && factor > 0.0;
+    if ((auto_leading != 0.0 || !has_leading) && has_factor && style->size > 0.0) {
+        style->leading = style->size * factor;
+    }
+
+    /* FillColor Values are [A R G B] in 0..1; some writers omit alpha */
+    const psd_engine_node_t *values = psd_engine_data_get(
+        tree, psd_text_sheet_get(tree, sheet, normal, "FillColor"), "Values");
+    if (values && values->type == PSD_ENGINE_ARRAY &&
+        (values->child_count == 3 || values->child_count == 4)) {
+        uint32_t first = values->child_count - 3;
+        for (uint32_t c = 0; c < 3; c++) {
+            const psd_engine_node_t *v = psd_engine_data_item(tree, values, first + c);
+            style->color_rgba[c] = psd_text_unit_to_byte(v->number);
+        }
+        if (first == 1) {
+            style->color_rgba[3] = psd_text_unit_to_byte(psd_engine_data_item(tree, values, 0)->number);
+        }
+    }
+
+    double justification = 0.0;
+    if (psd_text_sheet_number(tree, paragraph, res->normal_paragraph, "Justification",
+                              &justification)) {
+        style->justification = psd_text_justification(justification);
+    }
+}
+
+/* Length of a run from RunLengthArray (0 if missing) */
+static uint32_t psd_text_run_length(const psd_engine_data_t *tree,
+                                    const psd_engine_node_t *lengths,
+                                    uint32_t run)
+{
+    const psd_engine_node_t *v = psd_engine_data_item(tree, lengths, run);
+    if (!v || v->type != PSD_ENGINE_NUMBER || v->number < 0.0 || v->number >= (double)UINT32_MAX) {
+        return 0;
+    }
+    return (uint32_t)v->number;
+}
+
+/* Paragraph run covering a code unit offset (the last one past the end) */
+static uint32_t psd_text_paragraph_at(const psd_text_engine_resources_t *res, uint32_t offset)
+{
+    const psd_engine_node_t *lengths = psd_engine_data_path(
+        res->tree, res->engine_dict, "ParagraphRun/RunLengthArray");
+    uint32_t count = lengths ? lengths->child_count : 0;
+    uint64_t end = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        end += psd_text_run_length(res->tree, lengths, i);
+        if (offset < end) {
+            return i;
+        }
+    }
+    return count ? count - 1 : 0;
+}
+
 psd_status_t psd_text_layer_get_default_style(
     psd_document_t *doc,
     uint32_t layer_index,
@@ -618,80 +544,107 @@ psd_status_t psd_text_layer_get_default_style(
     out_style->color_rgba[3] = 255;
     out_style->justification = PSD_TEXT_JUSTIFY_LEFT;
 
-    const uint8_t *engine = NULL;
-    uint64_t engine_len = 0;
-    psd_status_t st = psd_text_layer_get_engine_data_raw(doc, layer_index, &engine, &engine_len);
-    if (st != PSD_OK || !engine || engine_len == 0) {
-        return (st == PSD_OK) ? PSD_ERR_INVALID_STRUCTURE : st;
-    }
-
-    /* Convert EngineData to readable UTF-8 text (decoding BOM UTF-16 strings in parentheses) */
-    char engine_txt[8192] = {0};
-    psd_status_t st_txt = psd_engine_data_to_utf8_text(doc->allocator, engine, (size_t)engine_len, engine_txt, sizeof(engine_txt));
-    if (st_txt != PSD_OK && st_txt != PSD_ERR_BUFFER_TOO_SMALL) {
-        return st_txt;
+    psd_text_engine_resources_t res;
+    psd_status_t st = psd_text_engine_resources(doc, layer_index, &res);
+    if (st != PSD_OK) {
+        return st;
     }
 
-    /* Font name: try StyleSheet "Font <idx>" + FontSet names */
-    int font_idx = -1;
-    (void)psd_parse_int_after(engine_txt, "/Font", &font_idx);
+    psd_text_resolve_style(&res, psd_text_style_sheet(&res, 0),
+                           psd_text_paragraph_properties(&res, 0), out_style);
 
-    char font_names[64][PSD_TEXT_FONT_NAME_MAX];
-    memset(font_names, 0, sizeof(font_names));
-    size_t font_count = psd_extract_fontset_names(engine_txt, font_names, 64);
-    if (font_count > 0) {
-        size_t pick = 0;
-        if (font_idx >= 0 && (size_t)font_idx < font_count) {
-            pick = (size_t)font_idx;
-        }
-        strncpy(out_style->font_name, font_names[pick], sizeof(out_style->font_name) - 1);
-        out_style->font_name[sizeof(out_style->font_name) - 1] = '\0';
-    } else {
-        /* Fallback: first occurrence of any "(...)" after "/Name" */
-        const char *n = psd_find_token(engine_txt, "/Name");
-        const char *lp = n ? strchr(n, '(') : NULL;
-        const char *rp = lp ? strchr(lp + 1, ')') : NULL;
-        if (lp && rp && rp > lp + 1) {
-            size_t len = (size_t)(rp - (lp + 1));
-            if (len >= sizeof(out_style->font_name)) len = sizeof(out_style->font_name) - 1;
-            memcpy(out_style->font_name, lp + 1, len);
-            out_style->font_name[len] = '\0';
-        }
+    /* Require minimal fields for phase-1 rendering */
+    if (out_style->font_name[0] == '\0' || out_style->size <= 0.0) {
+        return PSD_ERR_INVALID_STRUCTURE;
     }
 
-    /* Size */
-    (void)psd_parse_double_after(engine_txt, "/FontSize", &out_style->size);
+    return PSD_OK;
+}
 
-    /* Tracking */
-    (void)psd_parse_double_after(engine_txt, "/Tracking", &out_style->tracking);
+psd_status_t psd_text_layer_get_style_runs(
+    psd_document_t *doc,
+    uint32_t layer_index,
+    psd_text_style_run_t *runs,
+    size_t capacity,
+    size_t *out_count)
+{
+    if (!doc || !out_count || (!runs && capacity > 0)) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    *out_count = 0;
 
-    /* Leading: if explicit Leading exists, use it; otherwise, try AutoLeading multiplier */
-    if (!psd_parse_double_after(engine_txt, "/Leading", &out_style->leading)) {
-        double auto_leading = 0;
-        if (psd_parse_double_after(engine_txt, "/AutoLeading", &auto_leading) && out_style->size > 0 && auto_leading > 0) {
-            out_style->leading = out_style->size * auto_leading;
-        }
+    psd_text_engine_resources_t res;
+    psd_status_t st = psd_text_engine_resources(doc, layer_index, &res);
+    if (st != PSD_OK) {
+        return st;
     }
 
-    /* Justification */
-    int just = 0;
-    if (psd_parse_int_after(engine_txt, "/Justification", &just)) {
-        switch (just) {
-            case 0: out_style->justification = PSD_TEXT_JUSTIFY_LEFT; break;
-            case 1: out_style->justification = PSD_TEXT_JUSTIFY_RIGHT; break;
-            case 2: out_style->justification = PSD_TEXT_JUSTIFY_CENTER; break;
-            case 3: out_style->justification = PSD_TEXT_JUSTIFY_FULL; break;
-            default: out_style->justification = PSD_TEXT_JUSTIFY_LEFT; break;
-        }
+    const psd_engine_node_t *array = psd_engine_data_path(res.tree, res.engine_dict,
+                                                          "StyleRun/RunArray");
+    const psd_engine_node_t *lengths = psd_engine_data_path(res.tree, res.engine_dict,
+                                                            "StyleRun/RunLengthArray");
+    uint32_t count = array ? array->child_count : 0;
+    *out_count = count;
+
+    uint32_t start = 0;
+    for (uint32_t i = 0; i < count && i < capacity; i++) {
+        uint32_t length = psd_text_run_length(res.tree, lengths, i);
+        runs[i].start = start;
+        runs[i].length = length;
+        psd_text_resolve_style(&res, psd_text_style_sheet(&res, i),
+                               psd_text_paragraph_properties(&res, psd_text_paragraph_at(&res, start)),
+                               &runs[i].style);
+        start += length;
     }
 
-    /* Color */
-    (void)psd_parse_rgb_after_fillcolor(engine_txt, out_style->color_rgba);
+    return (count > capacity) ? PSD_ERR_BUFFER_TOO_SMALL : PSD_OK;
+}
 
-    /* Require minimal fields for phase-1 rendering */
-    if (out_style->font_name[0] == '\0' || out_style->size <= 0.0) {
-        return PSD_ERR_INVALID_STRUCTURE;
+psd_status_t psd_text_layer_get_paragraph_runs(
+    psd_document_t *doc,
+    uint32_t layer_index,
+    psd_text_paragraph_run_t *runs,
+    size_t capacity,
+    size_t *out_count)
+{
+    if (!doc || !out_count || (!runs && capacity > 0)) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    *out_count = 0;
+
+    psd_text_engine_resources_t res;
+    psd_status_t st = psd_text_engine_resources(doc, layer_index, &res);
+    if (st != PSD_OK) {
+        return st;
+    }
+
+    const psd_engine_node_t *array = psd_engine_data_path(res.tree, res.engine_dict,
+                                                          "ParagraphRun/RunArray");
+    const psd_engine_node_t *lengths = psd_engine_data_path(res.tree, res.engine_dict,
+                                                            "ParagraphRun/RunLengthArray");
+    uint32_t count = array ? array->child_count : 0;
+    *out_count = count;
+
+    uint32_t start = 0;
+    for (uint32_t i = 0; i < count && i < capacity; i++) {
+        const psd_engine_node_t *props = psd_text_paragraph_properties(&res, i);
+        const psd_engine_node_t *normal = res.normal_paragraph;
+        psd_text_paragraph_run_t *run = &runs[i];
+        double justification = 0.0;
+
+        memset(run, 0, sizeof(*run));
+        run->start = start;
+        run->length = psd_text_run_length(res.tree, lengths, i);
+        if (psd_text_sheet_number(res.tree, props, normal, "Justification", &justification)) {
+            run->justification = psd_text_justification(justification);
+        }
+        (void)psd_text_sheet_number(res.tree, props, normal, "FirstLineIndent", &run->first_line_indent);
+        (void)psd_text_sheet_number(res.tree, props, normal, "StartIndent", &run->start_indent);
+        (void)psd_text_sheet_number(res.tree, props, normal, "EndIndent", &run->end_indent);
+        (void)psd_text_sheet_number(res.tree, props, normal, "SpaceBefore", &run->space_before);
+        (void)psd_text_sheet_number(res.tree, props, normal, "SpaceAfter", &run->space_after);
+        start += run->length;
     }
 
-    return PSD_OK;
+    return (count > capacity) ? PSD_ERR_BUFFER_TOO_SMALL : PSD_OK;
 }
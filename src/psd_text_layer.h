@@ -23,6 +23,8 @@
  #include <stdbool.h>
  #include "../include/openpsd/psd_export.h"
  #include "psd_descriptor.h"
+ #include "psd_engine_data.h"
+ #include "psd_once.h"
 
  #ifdef __cplusplus
  extern "C" {
@@ -68,9 +70,10 @@ typedef struct psd_text_layer {
     psd_text_transform_t transform;
     psd_text_rect_t      text_bounds; /* left/top/right/bottom doubles */
 
-     /* Parsed descriptors */
-    psd_descriptor_t *text_data;   /* "Text data" descriptor */
-    psd_descriptor_t *warp_data;   /* "Warp data" descriptor */
+     /* Parsed descriptors (flat, indexing raw_tysh in place) */
+    psd_descriptor_flat_t *text_data;   /* "Text data" descriptor */
+    psd_descriptor_flat_t *warp_data;   /* "Warp data" descriptor */
+    psd_once_t parsed;                  /* Published once the descriptors are set */
 
     /*
       Optional: raw payload snapshots for debugging/round-tripping.
@@ -88,14 +91,23 @@ typedef struct psd_text_layer {
     uint8_t  *raw_text_engine;
     uint64_t  raw_text_engine_len;
 
+    /* EngineData tree, parsed on first style/text query (NULL until then) */
+    psd_engine_data_t *engine;
+    psd_once_t engine_parsed;           /* Published once engine is set */
+
     /* Convenience flags */
     bool has_rendered_pixels; /* true if the layer has normal channels/bounds */
 } psd_text_layer_t;
 
-/* Container owned by the context */
+/* Container owned by the context (items live in the document's metadata arena) */
 typedef struct psd_text_layer_info {
     psd_text_layer_t *items;
     size_t count;
+    size_t capacity;
+    /* Layer index -> item index + 1 (0 = not a text layer); one entry per
+     * layer, NULL when not built */
+    uint32_t *by_layer;
+    size_t by_layer_count;
 } psd_text_layer_info_t;
 
 
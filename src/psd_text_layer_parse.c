@@ -20,6 +20,7 @@
 #include "psd_text_layer.h"
 #include "psd_descriptor.h"
 #include "psd_layer.h"
+#include "psd_tagged_blocks.h"
 #include "psd_context.h"
 #include "psd_alloc.h"
 #include "psd_endian.h"
@@ -111,7 +112,7 @@ static psd_status_t psd_parse_tysh_payload(
     psd_stream_read_be_double(stream, &out_item->text_bounds.bottom);
 
     /* Always store raw payload for on-demand parsing via public API */
-    out_item->raw_tysh = (uint8_t *)psd_alloc_malloc(doc->allocator, payload_len);
+    out_item->raw_tysh = (uint8_t *)psd_alloc_malloc(&doc->meta.allocator, payload_len);
     if (out_item->raw_tysh) {
         memcpy(out_item->raw_tysh, payload, (size_t)payload_len);
         out_item->raw_tysh_len = payload_len;
@@ -134,44 +135,55 @@ static psd_status_t psd_text_layers_add(
     const psd_text_layer_t *src)
 {
     psd_text_layer_info_t *info = &doc->text_layers;
-    const psd_allocator_t *allocator = doc->allocator;
-
-    size_t new_count = info->count + 1;
-    psd_text_layer_t *new_items;
-
-    if (info->items == NULL) {
-        new_items = (psd_text_layer_t *)psd_alloc_malloc(
-            allocator,
-            new_count * sizeof(psd_text_layer_t));
-    } else {
-        if (allocator && allocator->realloc) {
-            new_items = (psd_text_layer_t *)allocator->realloc(
-                info->items,
-                new_count * sizeof(psd_text_layer_t),
-                allocator->user_data);
-        } else {
-            new_items = (psd_text_layer_t *)psd_alloc_malloc(
-                allocator,
-                new_count * sizeof(psd_text_layer_t));
-            if (new_items) {
-                memcpy(new_items, info->items,
-                       info->count * sizeof(psd_text_layer_t));
-                psd_alloc_free(allocator, info->items);
-            }
-        }
-    }
 
-    if (!new_items) {
-        return PSD_ERR_OUT_OF_MEMORY;
+    /* Grow geometrically: the arena copies on every realloc that is not of
+     * its latest allocation */
+    if (info->count == info->capacity) {
+        size_t new_capacity = info->capacity ? info->capacity * 2 : 8;
+        psd_text_layer_t *new_items = (psd_text_layer_t *)psd_alloc_realloc(
+            &doc->meta.allocator, info->items, new_capacity * sizeof(psd_text_layer_t));
+        if (!new_items) {
+            return PSD_ERR_OUT_OF_MEMORY;
+        }
+        info->items = new_items;
+        info->capacity = new_capacity;
     }
 
-    memcpy(&new_items[info->count], src, sizeof(psd_text_layer_t));
-    info->items = new_items;
-    info->count = new_count;
+    memcpy(&info->items[info->count], src, sizeof(psd_text_layer_t));
+    info->count++;
 
     return PSD_OK;
 }
 
+/**
+ * @brief Build the layer index -> text record table
+ *
+ * A layer with both a TySh and a tySh block maps to its first record. Left
+ * NULL when out of memory; lookups then scan the records.
+ */
+static void psd_text_layers_index(psd_document_t *doc)
+{
+    psd_text_layer_info_t *info = &doc->text_layers;
+    size_t layer_count = (size_t)doc->layers.layer_count;
+    if (info->count == 0) {
+        return;
+    }
+
+    uint32_t *by_layer = (uint32_t *)psd_alloc_malloc(&doc->meta.allocator,
+                                                      layer_count * sizeof(uint32_t));
+    if (!by_layer) {
+        return;
+    }
+    memset(by_layer, 0, layer_count * sizeof(uint32_t));
+    for (size_t i = info->count; i-- > 0;) {
+        if (info->items[i].layer_index < layer_count) {
+            by_layer[info->items[i].layer_index] = (uint32_t)i + 1u;
+        }
+    }
+    info->by_layer = by_layer;
+    info->by_layer_count = layer_count;
+}
+
 /**
  * @brief Parse all text layers from additional layer info blocks
  */
@@ -187,84 +199,19 @@ PSD_INTERNAL psd_status_t psd_parse_text_layers(psd_document_t *doc)
         psd_layer_record_t *layer = &doc->layers.layers[i];
 
         /* Only process layers with text feature */
-        if (!layer->features.has_text || !layer->additional_data || layer->additional_length < 12) {
+        if (!layer->features.has_text) {
             continue;
         }
 
-        const uint8_t *data = layer->additional_data;
-        uint64_t remaining = layer->additional_length;
-
-        /* Skip layer mask data (4-byte length + data) */
-        if (remaining >= 4) {
-            uint32_t mask_len = ((uint32_t)data[0] << 24) |
-                                ((uint32_t)data[1] << 16) |
-                                ((uint32_t)data[2] << 8) | ((uint32_t)data[3]);
-            data += 4;
-            remaining -= 4;
-            if (mask_len > 0 && mask_len <= remaining) {
-                data += mask_len;
-                remaining -= mask_len;
-            }
-        }
-
-        /* Skip layer blending ranges (4-byte length + data) */
-        if (remaining >= 4) {
-            uint32_t blend_len = ((uint32_t)data[0] << 24) |
-                                 ((uint32_t)data[1] << 16) |
-                                 ((uint32_t)data[2] << 8) | ((uint32_t)data[3]);
-            data += 4;
-            remaining -= 4;
-            if (blend_len > 0 && blend_len <= remaining) {
-                data += blend_len;
-                remaining -= blend_len;
-            }
-        }
-
-        /* Skip layer name (Pascal string, padded to 4) */
-        if (remaining >= 1) {
-            uint8_t name_len = data[0];
-            uint32_t name_total = 1 + name_len;
-            if (name_total % 4 != 0) {
-                name_total += 4 - (name_total % 4);
-            }
-            if (name_total <= remaining) {
-                data += name_total;
-                remaining -= name_total;
-            }
-        }
-
-        /* Now scan additional layer info blocks */
-        while (remaining >= 8) {
-            const uint8_t *sig = data;
-            const uint8_t *key = data + 4;
-            uint32_t block_len = psd_read_be32(data + 8);
-
-            uint64_t block_total = 12 + block_len;
-            if (block_len > (remaining - 12)) {
-                break;
-            }
-
-            if (block_len & 1) {
-                block_total += 1;
-            }
-
-            if (block_total > remaining) {
-                break;
-            }
-
-            uint32_t sig_val = psd_read_be32(sig);
-            if (sig_val != 0x3842494D && sig_val != 0x3842364D) {
-                data += block_total;
-                remaining -= block_total;
-                continue;
-            }
-
-            uint32_t key_val = psd_read_be32(key);
-            const uint8_t *payload = data + 12;
+        for (uint32_t b = 0; b < layer->block_count; b++) {
+            uint32_t key_val = layer->blocks[b].key;
+            uint64_t block_len = layer->blocks[b].length;
+            const uint8_t *payload = psd_tagged_block_payload(layer, &layer->blocks[b]);
 
             /* Parse TySh (Photoshop 6+) */
             if (key_val == 0x54795368) {
                 psd_text_layer_t item;
+                memset(&item, 0, sizeof(item));
                 psd_status_t status = psd_parse_tysh_payload(
                     doc,
                     (uint32_t)i,
@@ -279,7 +226,7 @@ PSD_INTERNAL psd_status_t psd_parse_text_layers(psd_document_t *doc)
                     /* add with raw payload even on parse error */
                     item.layer_index = (uint32_t)i;
                     item.source = PSD_TEXT_SOURCE_TYSH;
-                    item.raw_tysh = (uint8_t *)psd_alloc_malloc(doc->allocator, block_len);
+                    item.raw_tysh = (uint8_t *)psd_alloc_malloc(&doc->meta.allocator, (size_t)block_len);
                     if (item.raw_tysh) {
                         memcpy(item.raw_tysh, payload, (size_t)block_len);
                         item.raw_tysh_len = block_len;
@@ -297,7 +244,7 @@ PSD_INTERNAL psd_status_t psd_parse_text_layers(psd_document_t *doc)
                 item.layer_index = (uint32_t)i;
                 item.source = PSD_TEXT_SOURCE_TYSH_LEGACY;
 
-                item.raw_tysh = (uint8_t *)psd_alloc_malloc(doc->allocator, block_len);
+                item.raw_tysh = (uint8_t *)psd_alloc_malloc(&doc->meta.allocator, (size_t)block_len);
                 if (item.raw_tysh) {
                     memcpy(item.raw_tysh, payload, (size_t)block_len);
                     item.raw_tysh_len = block_len;
@@ -309,12 +256,10 @@ PSD_INTERNAL psd_status_t psd_parse_text_layers(psd_document_t *doc)
 
                 psd_text_layers_add(doc, &item);
             }
-
-            data += block_total;
-            remaining -= block_total;
         }
     }
 
+    psd_text_layers_index(doc);
     return PSD_OK;
 }
 
@@ -327,7 +272,7 @@ PSD_INTERNAL void psd_free_text_layers(psd_document_t *doc)
         return;
     }
 
-    const psd_allocator_t *allocator = doc->allocator;
+    const psd_allocator_t *allocator = &doc->meta.allocator;
 
     for (size_t i = 0; i < doc->text_layers.count; i++) {
         psd_text_layer_t *item = &doc->text_layers.items[i];
@@ -342,16 +287,24 @@ PSD_INTERNAL void psd_free_text_layers(psd_document_t *doc)
         }
 
         if (item->text_data) {
-            psd_descriptor_free(item->text_data, allocator);
+            psd_descriptor_flat_free(item->text_data, allocator);
             item->text_data = NULL;
         }
         if (item->warp_data) {
-            psd_descriptor_free(item->warp_data, allocator);
+            psd_descriptor_flat_free(item->warp_data, allocator);
             item->warp_data = NULL;
         }
+        if (item->engine) {
+            psd_engine_data_free(item->engine, allocator);
+            item->engine = NULL;
+        }
     }
 
     psd_alloc_free(allocator, doc->text_layers.items);
+    psd_alloc_free(allocator, doc->text_layers.by_layer);
     doc->text_layers.items = NULL;
     doc->text_layers.count = 0;
+    doc->text_layers.capacity = 0;
+    doc->text_layers.by_layer = NULL;
+    doc->text_layers.by_layer_count = 0;
 }
@@ -0,0 +1,247 @@
+/**
+ * @file psd_threads.c
+ * @brief Fan-out of independent tasks over worker threads
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* pthreads/sysconf/sched_yield under strict C17 */
+#endif
+
+#include "psd_threads.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sched.h>
+#if defined(PSD_ENABLE_THREADS)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#endif
+
+/* Upper bound on built-in workers */
+#define PSD_MAX_THREADS 64
+
+static void run_serial(size_t count, psd_task_fn fn, void *task_data)
+{
+    for (size_t i = 0; i < count; i++) {
+        fn(task_data, i);
+    }
+}
+
+#if defined(PSD_ENABLE_THREADS)
+
+/* Tasks are handed out one index at a time so uneven tasks balance out */
+typedef struct {
+    psd_task_fn fn;
+    void *task_data;
+    size_t count;
+    size_t next;
+#if defined(_WIN32)
+    SRWLOCK lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} psd_task_queue_t;
+
+static size_t queue_claim(psd_task_queue_t *queue)
+{
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(&queue->lock);
+    size_t index = queue->next++;
+    ReleaseSRWLockExclusive(&queue->lock);
+#else
+    pthread_mutex_lock(&queue->lock);
+    size_t index = queue->next++;
+    pthread_mutex_unlock(&queue->lock);
+#endif
+    return index;
+}
+
+static void queue_drain(psd_task_queue_t *queue)
+{
+    for (;;) {
+        size_t index = queue_claim(queue);
+        if (index >= queue->count) return;
+        queue->fn(queue->task_data, index);
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI worker_main(LPVOID arg)
+{
+    queue_drain((psd_task_queue_t *)arg);
+    return 0;
+}
+#else
+static void *worker_main(void *arg)
+{
+    queue_drain((psd_task_queue_t *)arg);
+    return NULL;
+}
+#endif
+
+#endif /* PSD_ENABLE_THREADS */
+
+size_t psd_builtin_thread_count(void)
+{
+#if defined(PSD_ENABLE_THREADS)
+    long online = 1;
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    online = (long)info.dwNumberOfProcessors;
+#else
+    online = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (online < 1) return 1;
+    if (online > PSD_MAX_THREADS) return PSD_MAX_THREADS;
+    return (size_t)online;
+#else
+    return 1;
+#endif
+}
+
+void psd_parallel_for(const psd_thread_pool_t *pool,
+                      size_t count,
+                      psd_task_fn fn,
+                      void *task_data)
+{
+    if (count == 0 || !fn) return;
+
+    if (pool && pool->parallel_for) {
+        pool->parallel_for(pool->pool_data, count, fn, task_data);
+        return;
+    }
+
+    size_t workers = psd_builtin_thread_count();
+    if (workers > count) workers = count;
+    if (workers <= 1) {
+        run_serial(count, fn, task_data);
+        return;
+    }
+
+#if defined(PSD_ENABLE_THREADS)
+    psd_task_queue_t queue;
+    queue.fn = fn;
+    queue.task_data = task_data;
+    queue.count = count;
+    queue.next = 0;
+
+#if defined(_WIN32)
+    InitializeSRWLock(&queue.lock);
+    HANDLE threads[PSD_MAX_THREADS];
+#else
+    if (pthread_mutex_init(&queue.lock, NULL) != 0) {
+        run_serial(count, fn, task_data);
+        return;
+    }
+    pthread_t threads[PSD_MAX_THREADS];
+#endif
+
+    /* The calling thread is one of the workers. A failed thread start just
+     * leaves more work for the others. */
+    size_t started = 0;
+    for (size_t i = 1; i < workers; i++) {
+#if defined(_WIN32)
+        HANDLE handle = CreateThread(NULL, 0, worker_main, &queue, 0, NULL);
+        if (!handle) break;
+        threads[started++] = handle;
+#else
+        if (pthread_create(&threads[started], NULL, worker_main, &queue) != 0) break;
+        started++;
+#endif
+    }
+
+    queue_drain(&queue);
+
+    for (size_t i = 0; i < started; i++) {
+#if defined(_WIN32)
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+
+#if !defined(_WIN32)
+    pthread_mutex_destroy(&queue.lock);
+#endif
+#endif /* PSD_ENABLE_THREADS */
+}
+
+/* Tasks of psd_parallel_for_slots(); the lock only guards next */
+typedef struct {
+    psd_slot_task_fn fn;
+    void *task_data;
+    size_t count;
+    size_t next;
+    psd_once_t lock;
+} psd_slot_queue_t;
+
+static void slot_worker(void *task_data, size_t slot)
+{
+    psd_slot_queue_t *queue = (psd_slot_queue_t *)task_data;
+    for (;;) {
+        while (!psd_once_claim(&queue->lock)) {
+            /* Held for one increment */
+        }
+        size_t index = queue->next++;
+        psd_once_reset(&queue->lock);
+
+        if (index >= queue->count) return;
+        queue->fn(queue->task_data, slot, index);
+    }
+}
+
+void psd_parallel_for_slots(const psd_thread_pool_t *pool,
+                            size_t slots,
+                            size_t count,
+                            psd_slot_task_fn fn,
+                            void *task_data)
+{
+    if (count == 0 || !fn) return;
+    if (slots == 0) slots = 1;
+    if (slots > count) slots = count;
+
+    psd_slot_queue_t queue = { fn, task_data, count, 0, PSD_ONCE_INIT };
+    psd_parallel_for(pool, slots, slot_worker, &queue);
+}
+
+/* Callers' own threads share documents too, so this works without
+ * PSD_ENABLE_THREADS */
+void psd_thread_yield(void)
+{
+#if defined(_WIN32)
+    (void)SwitchToThread();
+#else
+    (void)sched_yield();
+#endif
+}
+
+bool psd_once_enter(psd_once_t *once)
+{
+    for (;;) {
+        if (psd_once_done(once)) return false;
+        if (psd_once_claim(once)) return true;
+        psd_thread_yield();
+    }
+}
+
+void psd_lock_acquire(psd_once_t *lock)
+{
+    while (!psd_once_claim(lock)) {
+        psd_thread_yield();
+    }
+}
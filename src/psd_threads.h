@@ -0,0 +1,103 @@
+/**
+ * @file psd_threads.h
+ * @brief Fan-out of independent tasks over worker threads
+ *
+ * Tasks run on the caller's psd_thread_pool_t when one is given. Otherwise a
+ * built-in set of workers is started for the call (one per online CPU, when
+ * the library is built with PSD_ENABLE_THREADS) and joined before returning.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_THREADS_H
+#define PSD_THREADS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "psd_once.h"
+#include "../include/openpsd/psd.h"
+#include "../include/openpsd/psd_export.h"
+
+/**
+ * @brief Run fn(task_data, i) for every i in [0, count)
+ *
+ * Returns once every task has finished. Tasks may run concurrently and in
+ * any order; the calling thread takes part in the work.
+ *
+ * @param pool Caller-supplied pool, or NULL for the built-in workers
+ * @param count Number of tasks
+ * @param fn Task function
+ * @param task_data Context passed to every task
+ */
+PSD_INTERNAL void psd_parallel_for(const psd_thread_pool_t *pool,
+                                   size_t count,
+                                   psd_task_fn fn,
+                                   void *task_data);
+
+/**
+ * @brief Task callback of psd_parallel_for_slots()
+ *
+ * @param task_data Context passed to psd_parallel_for_slots()
+ * @param slot Worker slot in [0, slots), used by one task at a time
+ * @param index Task index in [0, count)
+ */
+typedef void (*psd_slot_task_fn)(void *task_data, size_t slot, size_t index);
+
+/**
+ * @brief Run fn for every i in [0, count) with at most slots tasks at once
+ *
+ * Each of up to slots workers takes tasks in index order until none are
+ * left, so per-slot state can be reused without locking and the number of
+ * tasks in flight stays bounded whatever the pool's size.
+ *
+ * @param pool Caller-supplied pool, or NULL for the built-in workers
+ * @param slots Maximum number of concurrent tasks (at least 1)
+ * @param count Number of tasks
+ * @param fn Task function
+ * @param task_data Context passed to every task
+ */
+PSD_INTERNAL void psd_parallel_for_slots(const psd_thread_pool_t *pool,
+                                         size_t slots,
+                                         size_t count,
+                                         psd_slot_task_fn fn,
+                                         void *task_data);
+
+/**
+ * @brief Number of workers the built-in pool would use (1 without threads)
+ */
+PSD_INTERNAL size_t psd_builtin_thread_count(void);
+
+/**
+ * @brief Give up the rest of the calling thread's time slice
+ */
+PSD_INTERNAL void psd_thread_yield(void);
+
+/**
+ * @brief Start a one-time initialization, waiting out one in progress
+ *
+ * Returns false once the guarded data has been published. Returns true when
+ * the caller claimed the flag: it must then build the data and call
+ * psd_once_publish(), or psd_once_reset() on failure so that the next caller
+ * retries. Callers that find the flag busy yield until it settles.
+ *
+ * @param once Flag guarding the data
+ * @return true if the caller must initialize
+ */
+PSD_INTERNAL bool psd_once_enter(psd_once_t *once);
+
+/**
+ * @brief Take a psd_once_t used as a lock, yielding while it is held
+ *
+ * Release it with psd_once_reset().
+ */
+PSD_INTERNAL void psd_lock_acquire(psd_once_t *lock);
+
+#endif /* PSD_THREADS_H */
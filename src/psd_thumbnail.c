@@ -0,0 +1,196 @@
+/**
+ * @file psd_thumbnail.c
+ * @brief Thumbnail image resources (1036, and 1033 from Photoshop 4.0)
+ *
+ * The thumbnail is a small JPEG (rarely raw RGB) stored in the image resources
+ * section, so with PSD_PARSE_STOP_AFTER_RESOURCES it can be read without
+ * touching layer or composite data. JPEG decoding uses libjpeg when the
+ * library is built with it.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+
+#include <string.h>
+
+#ifdef PSD_ENABLE_JPEG
+#include <setjmp.h>
+#include <stdio.h>
+#include <jpeglib.h>
+#endif
+
+#define PSD_RESOURCE_THUMBNAIL 1036u
+#define PSD_RESOURCE_THUMBNAIL_PS4 1033u
+#define PSD_THUMBNAIL_HEADER_SIZE 28u
+
+static uint32_t read_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t read_be16(const uint8_t *p)
+{
+    return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+/**
+ * @brief Get the thumbnail stored in the image resources
+ */
+PSD_API psd_status_t psd_document_get_thumbnail(const psd_document_t *doc,
+                                                psd_thumbnail_t *thumbnail)
+{
+    if (!doc || !thumbnail) return PSD_ERR_NULL_POINTER;
+
+    /* Newer files keep 1033 next to 1036 only for old readers */
+    uint16_t id = PSD_RESOURCE_THUMBNAIL;
+    size_t index = 0;
+    psd_status_t st = psd_document_find_resource(doc, id, &index);
+    if (st == PSD_ERR_INVALID_ARGUMENT) {
+        id = PSD_RESOURCE_THUMBNAIL_PS4;
+        st = psd_document_find_resource(doc, id, &index);
+    }
+    if (st != PSD_OK) return st;
+
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    st = psd_document_get_resource(doc, index, &id, &data, &length);
+    if (st != PSD_OK) return st;
+    if (!data || length < PSD_THUMBNAIL_HEADER_SIZE) return PSD_ERR_CORRUPT_DATA;
+
+    memset(thumbnail, 0, sizeof(*thumbnail));
+    thumbnail->resource_id = id;
+    thumbnail->format = read_be32(data);
+    thumbnail->width = read_be32(data + 4);
+    thumbnail->height = read_be32(data + 8);
+    thumbnail->width_bytes = read_be32(data + 12);
+    thumbnail->bits_per_pixel = read_be16(data + 24);
+    thumbnail->planes = read_be16(data + 26);
+    thumbnail->data = data + PSD_THUMBNAIL_HEADER_SIZE;
+    thumbnail->length = length - PSD_THUMBNAIL_HEADER_SIZE;
+
+    if (thumbnail->format == PSD_THUMBNAIL_RAW_RGB &&
+        (uint64_t)thumbnail->width_bytes * thumbnail->height > thumbnail->length) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+    return PSD_OK;
+}
+
+#ifdef PSD_ENABLE_JPEG
+
+typedef struct {
+    struct jpeg_error_mgr base;
+    jmp_buf jump;
+} psd_jpeg_error_t;
+
+static void psd_jpeg_error_exit(j_common_ptr cinfo)
+{
+    psd_jpeg_error_t *err = (psd_jpeg_error_t *)(void *)cinfo->err;
+    longjmp(err->jump, 1);
+}
+
+static void psd_jpeg_output_message(j_common_ptr cinfo)
+{
+    (void)cinfo;
+}
+
+static psd_status_t decode_jpeg(const psd_thumbnail_t *thumbnail, uint8_t *out_rgb)
+{
+    /* Touched after setjmp(), so not kept in registers */
+    struct jpeg_decompress_struct cinfo;
+    psd_jpeg_error_t err;
+    volatile psd_status_t st = PSD_OK;
+
+    cinfo.err = jpeg_std_error(&err.base);
+    err.base.error_exit = psd_jpeg_error_exit;
+    err.base.output_message = psd_jpeg_output_message;
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return PSD_ERR_CORRUPT_DATA;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char *)thumbnail->data, (unsigned long)thumbnail->length);
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        st = PSD_ERR_CORRUPT_DATA;
+    } else {
+        cinfo.out_color_space = JCS_RGB;
+        jpeg_start_decompress(&cinfo);
+        if (cinfo.output_width != thumbnail->width || cinfo.output_height != thumbnail->height ||
+            cinfo.output_components != 3) {
+            st = PSD_ERR_CORRUPT_DATA;
+            jpeg_abort_decompress(&cinfo);
+        } else {
+            while (cinfo.output_scanline < cinfo.output_height) {
+                JSAMPROW row = out_rgb + (size_t)cinfo.output_scanline * thumbnail->width * 3u;
+                jpeg_read_scanlines(&cinfo, &row, 1);
+            }
+            jpeg_finish_decompress(&cinfo);
+        }
+    }
+    jpeg_destroy_decompress(&cinfo);
+    return st;
+}
+
+#endif /* PSD_ENABLE_JPEG */
+
+/**
+ * @brief Decode the thumbnail to RGB8
+ */
+PSD_API psd_status_t psd_document_get_thumbnail_rgb8(
+    const psd_document_t *doc,
+    uint8_t *out_rgb,
+    size_t out_rgb_size,
+    size_t *out_required_size)
+{
+    if (!doc) return PSD_ERR_NULL_POINTER;
+
+    psd_thumbnail_t thumbnail;
+    psd_status_t st = psd_document_get_thumbnail(doc, &thumbnail);
+    if (st != PSD_OK) return st;
+
+    uint64_t required64 = (uint64_t)thumbnail.width * thumbnail.height * 3u;
+    if (required64 > (uint64_t)SIZE_MAX) return PSD_ERR_OUT_OF_RANGE;
+    if (out_required_size) *out_required_size = (size_t)required64;
+    if (!out_rgb || out_rgb_size < (size_t)required64) return PSD_ERR_BUFFER_TOO_SMALL;
+    if (required64 == 0) return PSD_OK;
+
+    if (thumbnail.format == PSD_THUMBNAIL_RAW_RGB) {
+        if (thumbnail.bits_per_pixel != 24 || thumbnail.planes != 1 ||
+            thumbnail.width_bytes < (uint64_t)thumbnail.width * 3u) {
+            return PSD_ERR_UNSUPPORTED_FEATURE;
+        }
+        for (uint32_t y = 0; y < thumbnail.height; y++) {
+            memcpy(out_rgb + (size_t)y * thumbnail.width * 3u,
+                   thumbnail.data + (size_t)y * thumbnail.width_bytes,
+                   (size_t)thumbnail.width * 3u);
+        }
+    } else if (thumbnail.format == PSD_THUMBNAIL_JPEG_RGB) {
+#ifdef PSD_ENABLE_JPEG
+        st = decode_jpeg(&thumbnail, out_rgb);
+        if (st != PSD_OK) return st;
+#else
+        return PSD_ERR_UNSUPPORTED_COMPRESSION;
+#endif
+    } else {
+        return PSD_ERR_UNSUPPORTED_COMPRESSION;
+    }
+
+    /* Photoshop 4.0 thumbnails are stored blue first */
+    if (thumbnail.resource_id == PSD_RESOURCE_THUMBNAIL_PS4) {
+        for (size_t i = 0; i < (size_t)required64; i += 3) {
+            uint8_t t = out_rgb[i];
+            out_rgb[i] = out_rgb[i + 2];
+            out_rgb[i + 2] = t;
+        }
+    }
+    return PSD_OK;
+}
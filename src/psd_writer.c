@@ -0,0 +1,867 @@
+/**
+ * @file psd_writer.c
+ * @brief PSD/PSB serialization with parallel channel compression
+ *
+ * The header, color mode data and image resources go out as soon as they
+ * are known. psd_writer_finish() then writes the layer records with zero
+ * channel lengths, compresses every layer channel as one task on the
+ * workers, and streams each channel out as soon as it and all channels
+ * before it are done: whichever task finds the next channel ready takes the
+ * flush lock and writes every ready channel in order. Once the composite
+ * follows, the records are written again over the first copy with the real
+ * lengths, which costs a single seek back.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "psd_alloc.h"
+#include "psd_endian.h"
+#include "psd_once.h"
+#include "psd_rle.h"
+#include "psd_threads.h"
+#include "psd_zip.h"
+
+#include <string.h>
+
+#define PSD_WRITER_MAX_CHANNELS 56u
+#define PSD_WRITER_MAX_LAYERS 32767u
+#define PSD_WRITER_MAX_PSD_SIDE 30000u
+#define PSD_WRITER_MAX_PSB_SIDE 300000u
+#define PSD_WRITER_INITIAL_LAYERS 16u
+
+typedef enum {
+    PSD_WRITER_COLOR_MODE,  /* Header written, color mode data next */
+    PSD_WRITER_RESOURCES,   /* Inside the image resources section */
+    PSD_WRITER_LAYERS,      /* Resources closed, layers being queued */
+    PSD_WRITER_FINISHED,
+} psd_writer_stage_t;
+
+struct psd_writer {
+    psd_stream_t *stream;
+    const psd_allocator_t *allocator;
+    psd_writer_options_t options;
+    psd_writer_stage_t stage;
+    int64_t resources_at;         /* Position of the resources length field */
+    psd_writer_layer_t *layers;
+    size_t layer_count;
+    size_t layer_capacity;
+};
+
+/* One plane to compress and write */
+typedef struct {
+    const uint8_t *data;
+    size_t stride;
+    size_t row_bytes;
+    uint32_t rows;
+    uint16_t compression;         /* Compression actually used */
+    uint8_t *payload;             /* Compressed data, NULL when raw or once written */
+    size_t payload_length;        /* Compressed length, kept after the payload is written */
+    size_t length_at;             /* Offset of the channel length field in the records */
+    psd_status_t status;
+    psd_once_t ready;             /* Published once payload and status are set */
+} psd_writer_plane_t;
+
+typedef struct {
+    psd_writer_t *writer;
+    psd_writer_plane_t *planes;
+    size_t count;
+    bool stream_out;              /* Write planes as they become ready */
+    size_t next;                  /* First plane not written yet (flush lock) */
+    psd_status_t status;          /* First failure while writing (flush lock) */
+    psd_once_t flush;
+} psd_writer_run_t;
+
+/* Growable buffer for the layer records */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    const psd_allocator_t *allocator;
+    bool failed;
+} psd_writer_buf_t;
+
+/* ----------------------------
+ * Output helpers
+ * ---------------------------- */
+
+static psd_status_t psd_writer_put(psd_stream_t *stream, const void *data, size_t length)
+{
+    if (length == 0) {
+        return PSD_OK;
+    }
+    int64_t n = psd_stream_write(stream, data, length);
+    if (n < 0) {
+        return (psd_status_t)n;
+    }
+    return (uint64_t)n == (uint64_t)length ? PSD_OK : PSD_ERR_STREAM_WRITE;
+}
+
+static void psd_buf_put(psd_writer_buf_t *b, const void *src, size_t n)
+{
+    if (b->failed) return;
+    if (n > b->capacity - b->size) {
+        size_t capacity = b->capacity ? b->capacity : 1024;
+        while (capacity - b->size < n) capacity *= 2;
+        uint8_t *data = (uint8_t *)psd_alloc_realloc(b->allocator, b->data, capacity);
+        if (!data) {
+            b->failed = true;
+            return;
+        }
+        b->data = data;
+        b->capacity = capacity;
+    }
+    if (n) memcpy(b->data + b->size, src, n);
+    b->size += n;
+}
+
+static void psd_buf_be16(psd_writer_buf_t *b, uint16_t v)
+{
+    uint8_t bytes[2];
+    psd_write_be16(bytes, v);
+    psd_buf_put(b, bytes, 2);
+}
+
+static void psd_buf_be32(psd_writer_buf_t *b, uint32_t v)
+{
+    uint8_t bytes[4];
+    psd_write_be32(bytes, v);
+    psd_buf_put(b, bytes, 4);
+}
+
+/* Section length: 8 bytes in PSB files, 4 in PSD files */
+static void psd_write_length(uint8_t *at, bool psb, uint64_t v)
+{
+    if (psb) {
+        psd_write_be64(at, v);
+    } else {
+        psd_write_be32(at, (uint32_t)v);
+    }
+}
+
+/* ----------------------------
+ * Plane compression
+ * ---------------------------- */
+
+/* Bytes of one row of width samples */
+static size_t psd_writer_row_bytes(uint16_t depth, uint64_t width)
+{
+    return (depth == 1) ? (size_t)((width + 7u) / 8u) : (size_t)width * (depth / 8u);
+}
+
+/**
+ * @brief Deflate the rows of one or more planes as one stream
+ *
+ * The rows are gathered into one buffer, predicted in place for
+ * ZIP_PRED, and compressed.
+ */
+static psd_status_t psd_writer_deflate(const psd_writer_t *writer,
+                                       const uint8_t *const *sources,
+                                       size_t source_count,
+                                       size_t stride,
+                                       size_t row_bytes,
+                                       uint32_t rows,
+                                       uint8_t **out,
+                                       size_t *out_length)
+{
+    const psd_allocator_t *allocator = writer->allocator;
+    size_t plane_bytes = row_bytes * rows;
+    size_t total = plane_bytes * source_count;
+    uint8_t *raw = (uint8_t *)psd_alloc_malloc(allocator, total);
+    if (!raw) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    for (size_t s = 0; s < source_count; s++) {
+        for (uint32_t y = 0; y < rows; y++) {
+            memcpy(raw + s * plane_bytes + (size_t)y * row_bytes,
+                   sources[s] + (size_t)y * stride, row_bytes);
+        }
+    }
+
+    psd_status_t status = PSD_OK;
+    if (writer->options.compression == PSD_COMPRESSION_ZIP_PRED) {
+        size_t bytes_per_sample = writer->options.depth / 8u;
+        uint8_t *scratch = NULL;
+        if (bytes_per_sample == 4) {
+            scratch = (uint8_t *)psd_alloc_malloc(allocator, row_bytes);
+            if (!scratch) status = PSD_ERR_OUT_OF_MEMORY;
+        }
+        for (size_t at = 0; status == PSD_OK && at < total; at += row_bytes) {
+            status = psd_zip_predict_row(raw + at, row_bytes, bytes_per_sample, scratch);
+        }
+        psd_alloc_free(allocator, scratch);
+    }
+    if (status == PSD_OK) {
+        status = psd_zip_compress(raw, total, (int)writer->options.compression_level, allocator,
+                                  out, out_length);
+    }
+    psd_alloc_free(allocator, raw);
+    return status;
+}
+
+/**
+ * @brief PackBits-encode a plane as a row counts table followed by the rows
+ *
+ * @return PSD_OK, PSD_ERR_OUT_OF_MEMORY, or PSD_ERR_OUT_OF_RANGE when a row
+ *         does not fit a 16-bit PSD row count
+ */
+static psd_status_t psd_writer_packbits(const psd_writer_t *writer,
+                                        psd_writer_plane_t *plane)
+{
+    const bool psb = writer->options.psb;
+    const size_t count_bytes = psb ? 4u : 2u;
+    size_t table = (size_t)plane->rows * count_bytes;
+    size_t bound = table + (size_t)plane->rows * PSD_RLE_ENCODE_BOUND(plane->row_bytes);
+    uint8_t *out = (uint8_t *)psd_alloc_malloc(writer->allocator, bound);
+    if (!out) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+
+    size_t at = table;
+    for (uint32_t y = 0; y < plane->rows; y++) {
+        size_t n = psd_rle_encode_row(plane->data + (size_t)y * plane->stride,
+                                      plane->row_bytes, out + at);
+        if (psb) {
+            psd_write_be32(out + (size_t)y * 4u, (uint32_t)n);
+        } else if (n > UINT16_MAX) {
+            psd_alloc_free(writer->allocator, out);
+            return PSD_ERR_OUT_OF_RANGE;
+        } else {
+            psd_write_be16(out + (size_t)y * 2u, (uint16_t)n);
+        }
+        at += n;
+    }
+
+    uint8_t *shrunk = (uint8_t *)psd_alloc_realloc(writer->allocator, out, at ? at : 1);
+    plane->payload = shrunk ? shrunk : out;
+    plane->payload_length = at;
+    return PSD_OK;
+}
+
+/**
+ * @brief Compress one layer channel or composite plane
+ *
+ * Empty planes, and RLE planes whose rows overflow the PSD row counts, are
+ * left raw.
+ */
+static psd_status_t psd_writer_encode(const psd_writer_t *writer, psd_writer_plane_t *plane)
+{
+    plane->compression = (uint16_t)writer->options.compression;
+    plane->payload = NULL;
+    plane->payload_length = 0;
+    if (plane->rows == 0 || plane->row_bytes == 0) {
+        plane->compression = PSD_COMPRESSION_RAW;
+        return PSD_OK;
+    }
+
+    switch (writer->options.compression) {
+        case PSD_COMPRESSION_RLE: {
+            psd_status_t status = psd_writer_packbits(writer, plane);
+            if (status == PSD_ERR_OUT_OF_RANGE) {
+                plane->compression = PSD_COMPRESSION_RAW;
+                return PSD_OK;
+            }
+            return status;
+        }
+        case PSD_COMPRESSION_ZIP:
+        case PSD_COMPRESSION_ZIP_PRED:
+            return psd_writer_deflate(writer, &plane->data, 1, plane->stride, plane->row_bytes,
+                                      plane->rows, &plane->payload, &plane->payload_length);
+        default:
+            return PSD_OK;
+    }
+}
+
+/* Bytes the plane takes after its compression field */
+static uint64_t psd_writer_plane_length(const psd_writer_plane_t *plane)
+{
+    return (plane->compression != PSD_COMPRESSION_RAW) ? (uint64_t)plane->payload_length
+                                                       : (uint64_t)plane->row_bytes * plane->rows;
+}
+
+/* Raw rows of a plane, one write per row so strided sources need no copy */
+static psd_status_t psd_writer_put_rows(psd_stream_t *stream, const psd_writer_plane_t *plane)
+{
+    psd_status_t status = PSD_OK;
+    for (uint32_t y = 0; status == PSD_OK && y < plane->rows; y++) {
+        status = psd_writer_put(stream, plane->data + (size_t)y * plane->stride,
+                                plane->row_bytes);
+    }
+    return status;
+}
+
+/* One layer channel: compression field, then its payload or raw rows */
+static psd_status_t psd_writer_put_channel(psd_writer_t *writer, psd_writer_plane_t *plane)
+{
+    uint8_t field[2];
+    psd_write_be16(field, plane->compression);
+    psd_status_t status = psd_writer_put(writer->stream, field, 2);
+    if (status == PSD_OK) {
+        status = plane->payload
+                     ? psd_writer_put(writer->stream, plane->payload, plane->payload_length)
+                     : psd_writer_put_rows(writer->stream, plane);
+    }
+    psd_alloc_free(writer->allocator, plane->payload);
+    plane->payload = NULL;
+    return status;
+}
+
+/**
+ * @brief Write every ready plane in order, unless another task is already
+ *        doing so
+ *
+ * A plane published while the holder is releasing the lock may be left for
+ * the next flush; psd_writer_run() flushes once more after the workers are
+ * done, so nothing is lost.
+ */
+static void psd_writer_flush(psd_writer_run_t *run)
+{
+    while (psd_once_claim(&run->flush)) {
+        size_t next = run->next;
+        while (next < run->count && psd_once_done(&run->planes[next].ready)) {
+            psd_writer_plane_t *plane = &run->planes[next];
+            if (run->status == PSD_OK) run->status = plane->status;
+            if (run->status == PSD_OK) {
+                run->status = psd_writer_put_channel(run->writer, plane);
+            }
+            next++;
+        }
+        run->next = next;
+        psd_once_reset(&run->flush);
+
+        if (next >= run->count || !psd_once_done(&run->planes[next].ready)) {
+            break;
+        }
+    }
+}
+
+static void psd_writer_encode_task(void *task_data, size_t slot, size_t index)
+{
+    (void)slot;
+    psd_writer_run_t *run = (psd_writer_run_t *)task_data;
+    psd_writer_plane_t *plane = &run->planes[index];
+    plane->status = psd_writer_encode(run->writer, plane);
+    psd_once_publish(&plane->ready);
+    if (run->stream_out) {
+        psd_writer_flush(run);
+    }
+}
+
+/**
+ * @brief Compress planes on the workers, writing them out as they are ready
+ *        when stream_out is set
+ */
+static psd_status_t psd_writer_run(psd_writer_t *writer, psd_writer_plane_t *planes,
+                                   size_t count, bool stream_out)
+{
+    psd_writer_run_t run;
+    run.writer = writer;
+    run.planes = planes;
+    run.count = count;
+    run.stream_out = stream_out;
+    run.next = 0;
+    run.status = PSD_OK;
+    psd_once_reset(&run.flush);
+    for (size_t i = 0; i < count; i++) {
+        psd_once_reset(&planes[i].ready);
+    }
+
+    size_t slots = writer->options.pool ? count : psd_builtin_thread_count();
+    psd_parallel_for_slots(writer->options.pool, slots, count, psd_writer_encode_task, &run);
+
+    if (!stream_out) {
+        for (size_t i = 0; i < count && run.status == PSD_OK; i++) {
+            run.status = planes[i].status;
+        }
+        return run.status;
+    }
+    psd_writer_flush(&run);
+    return run.status;
+}
+
+static void psd_writer_free_payloads(const psd_writer_t *writer, psd_writer_plane_t *planes,
+                                     size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        psd_alloc_free(writer->allocator, planes[i].payload);
+        planes[i].payload = NULL;
+    }
+}
+
+/* ----------------------------
+ * Sections
+ * ---------------------------- */
+
+/* Write whatever sections are still open before stage */
+static psd_status_t psd_writer_advance(psd_writer_t *writer, psd_writer_stage_t stage)
+{
+    psd_status_t status = PSD_OK;
+    if (writer->stage == PSD_WRITER_COLOR_MODE && stage > PSD_WRITER_COLOR_MODE) {
+        status = psd_writer_set_color_mode_data(writer, NULL, 0);
+    }
+    if (status == PSD_OK && writer->stage == PSD_WRITER_RESOURCES &&
+        stage > PSD_WRITER_RESOURCES) {
+        int64_t end = psd_stream_tell(writer->stream);
+        if (end < 0) return (psd_status_t)end;
+        uint64_t length = (uint64_t)(end - writer->resources_at - 4);
+        if (length > UINT32_MAX) return PSD_ERR_OUT_OF_RANGE;
+
+        uint8_t field[4];
+        psd_write_be32(field, (uint32_t)length);
+        if (psd_stream_seek(writer->stream, writer->resources_at) < 0) {
+            return PSD_ERR_STREAM_SEEK;
+        }
+        status = psd_writer_put(writer->stream, field, 4);
+        if (status == PSD_OK && psd_stream_seek(writer->stream, end) < 0) {
+            status = PSD_ERR_STREAM_SEEK;
+        }
+        writer->stage = PSD_WRITER_LAYERS;
+    }
+    return status;
+}
+
+/**
+ * @brief Records of every layer, with placeholders for the lengths
+ *
+ * Starts with the section length and layer info length fields. Each
+ * channel's length field offset is stored in its plane.
+ */
+static psd_status_t psd_writer_build_records(psd_writer_t *writer, psd_writer_buf_t *b,
+                                             psd_writer_plane_t *planes)
+{
+    const bool psb = writer->options.psb;
+    const size_t length_bytes = psb ? 8u : 4u;
+    static const uint8_t zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    psd_buf_put(b, zeros, length_bytes);   /* Layer and mask information length */
+    psd_buf_put(b, zeros, length_bytes);   /* Layer info length */
+    psd_buf_be16(b, (uint16_t)writer->layer_count);
+
+    size_t plane_index = 0;
+    for (size_t i = 0; i < writer->layer_count; i++) {
+        const psd_writer_layer_t *layer = &writer->layers[i];
+        psd_buf_be32(b, (uint32_t)layer->bounds.top);
+        psd_buf_be32(b, (uint32_t)layer->bounds.left);
+        psd_buf_be32(b, (uint32_t)layer->bounds.bottom);
+        psd_buf_be32(b, (uint32_t)layer->bounds.right);
+        psd_buf_be16(b, layer->channel_count);
+
+        uint64_t width = (uint64_t)((int64_t)layer->bounds.right - layer->bounds.left);
+        uint32_t height = (uint32_t)((int64_t)layer->bounds.bottom - layer->bounds.top);
+        size_t row_bytes = psd_writer_row_bytes(writer->options.depth, width);
+        for (uint16_t c = 0; c < layer->channel_count; c++) {
+            const psd_writer_channel_t *channel = &layer->channels[c];
+            psd_writer_plane_t *plane = &planes[plane_index++];
+            memset(plane, 0, sizeof(*plane));
+            plane->data = (const uint8_t *)channel->data;
+            plane->stride = channel->stride ? channel->stride : row_bytes;
+            plane->row_bytes = row_bytes;
+            plane->rows = height;
+
+            psd_buf_be16(b, (uint16_t)channel->id);
+            plane->length_at = b->size;
+            psd_buf_put(b, zeros, length_bytes);
+        }
+
+        psd_buf_put(b, "8BIM", 4);
+        psd_buf_be32(b, layer->blend_key ? layer->blend_key : 0x6E6F726Du /* norm */);
+        uint8_t fields[4] = { layer->opacity, layer->clipping, layer->flags, 0 };
+        psd_buf_put(b, fields, 4);
+
+        size_t name_length = layer->name ? strlen(layer->name) : 0;
+        if (name_length > 255) name_length = 255;
+        size_t name_padded = (1u + name_length + 3u) & ~(size_t)3u;
+        psd_buf_be32(b, (uint32_t)(8u + name_padded + layer->blocks_length));
+        psd_buf_be32(b, 0);   /* Layer mask data */
+        psd_buf_be32(b, 0);   /* Blending ranges */
+        uint8_t length_byte = (uint8_t)name_length;
+        psd_buf_put(b, &length_byte, 1);
+        psd_buf_put(b, layer->name, name_length);
+        psd_buf_put(b, zeros, name_padded - 1u - name_length);
+        psd_buf_put(b, layer->blocks, layer->blocks_length);
+    }
+    return b->failed ? PSD_ERR_OUT_OF_MEMORY : PSD_OK;
+}
+
+/**
+ * @brief Layer and mask information: records, streamed channels, padding and
+ *        the global mask length, with the records rewritten at the end
+ */
+static psd_status_t psd_writer_layer_section(psd_writer_t *writer)
+{
+    const bool psb = writer->options.psb;
+    const size_t length_bytes = psb ? 8u : 4u;
+
+    size_t plane_count = 0;
+    for (size_t i = 0; i < writer->layer_count; i++) {
+        plane_count += writer->layers[i].channel_count;
+    }
+    psd_writer_plane_t *planes = NULL;
+    if (plane_count > 0) {
+        planes = (psd_writer_plane_t *)psd_alloc_malloc(writer->allocator,
+                                                        plane_count * sizeof(*planes));
+        if (!planes) return PSD_ERR_OUT_OF_MEMORY;
+    }
+
+    psd_writer_buf_t records = { NULL, 0, 0, writer->allocator, false };
+    psd_status_t status = psd_writer_build_records(writer, &records, planes);
+    int64_t records_at = psd_stream_tell(writer->stream);
+    if (status == PSD_OK && records_at < 0) status = (psd_status_t)records_at;
+    if (status == PSD_OK) status = psd_writer_put(writer->stream, records.data, records.size);
+    if (status == PSD_OK && plane_count > 0) {
+        status = psd_writer_run(writer, planes, plane_count, true);
+    }
+
+    /* Layer info: count, records and channel data, padded to even */
+    uint64_t layer_info = records.size - 2u * length_bytes;
+    for (size_t i = 0; status == PSD_OK && i < plane_count; i++) {
+        uint64_t length = 2u + psd_writer_plane_length(&planes[i]);
+        psd_write_length(records.data + planes[i].length_at, psb, length);
+        layer_info += length;
+        if (!psb && length > UINT32_MAX) status = PSD_ERR_OUT_OF_RANGE;
+    }
+    static const uint8_t zeros[4] = { 0, 0, 0, 0 };
+    if (status == PSD_OK && (layer_info & 1u)) {
+        status = psd_writer_put(writer->stream, zeros, 1);
+        layer_info++;
+    }
+    if (status == PSD_OK) {
+        status = psd_writer_put(writer->stream, zeros, 4);   /* Global layer mask info */
+    }
+
+    uint64_t section = length_bytes + layer_info + 4u;
+    if (status == PSD_OK && !psb && section > UINT32_MAX) status = PSD_ERR_OUT_OF_RANGE;
+    if (status == PSD_OK) {
+        psd_write_length(records.data, psb, section);
+        psd_write_length(records.data + length_bytes, psb, layer_info);
+
+        int64_t end = psd_stream_tell(writer->stream);
+        if (end < 0) {
+            status = (psd_status_t)end;
+        } else if (psd_stream_seek(writer->stream, records_at) < 0) {
+            status = PSD_ERR_STREAM_SEEK;
+        } else {
+            status = psd_writer_put(writer->stream, records.data, records.size);
+            if (status == PSD_OK && psd_stream_seek(writer->stream, end) < 0) {
+                status = PSD_ERR_STREAM_SEEK;
+            }
+        }
+    }
+
+    psd_writer_free_payloads(writer, planes, plane_count);
+    psd_alloc_free(writer->allocator, planes);
+    psd_alloc_free(writer->allocator, records.data);
+    return status;
+}
+
+/**
+ * @brief Image data section
+ *
+ * RLE planes are encoded in parallel and written as one counts table for
+ * all planes followed by all rows. ZIP composites are a single deflate
+ * stream over every plane, so they compress as one task.
+ */
+static psd_status_t psd_writer_composite(psd_writer_t *writer, const void *const *sources,
+                                         size_t stride)
+{
+    const psd_writer_options_t *options = &writer->options;
+    size_t count = options->channels;
+    size_t row_bytes = psd_writer_row_bytes(options->depth, options->width);
+    if (stride == 0) stride = row_bytes;
+
+    psd_writer_plane_t *planes = (psd_writer_plane_t *)psd_alloc_malloc(
+        writer->allocator, count * sizeof(*planes));
+    if (!planes) return PSD_ERR_OUT_OF_MEMORY;
+    memset(planes, 0, count * sizeof(*planes));
+    for (size_t c = 0; c < count; c++) {
+        planes[c].data = (const uint8_t *)sources[c];
+        planes[c].stride = stride;
+        planes[c].row_bytes = row_bytes;
+        planes[c].rows = options->height;
+    }
+
+    psd_status_t status = PSD_OK;
+    uint16_t compression = (uint16_t)options->compression;
+    uint8_t *zip = NULL;
+    size_t zip_length = 0;
+    if (compression == PSD_COMPRESSION_RLE) {
+        status = psd_writer_run(writer, planes, count, false);
+        for (size_t c = 0; status == PSD_OK && c < count; c++) {
+            if (planes[c].compression != PSD_COMPRESSION_RLE) compression = PSD_COMPRESSION_RAW;
+        }
+    } else if (compression != PSD_COMPRESSION_RAW) {
+        status = psd_writer_deflate(writer, (const uint8_t *const *)sources, count, stride,
+                                    row_bytes, options->height, &zip, &zip_length);
+    }
+
+    uint8_t field[2];
+    psd_write_be16(field, compression);
+    if (status == PSD_OK) status = psd_writer_put(writer->stream, field, 2);
+
+    if (compression == PSD_COMPRESSION_RLE) {
+        size_t table = (size_t)options->height * (options->psb ? 4u : 2u);
+        for (size_t c = 0; status == PSD_OK && c < count; c++) {
+            status = psd_writer_put(writer->stream, planes[c].payload, table);
+        }
+        for (size_t c = 0; status == PSD_OK && c < count; c++) {
+            status = psd_writer_put(writer->stream, planes[c].payload + table,
+                                    planes[c].payload_length - table);
+        }
+    } else if (compression != PSD_COMPRESSION_RAW) {
+        if (status == PSD_OK) status = psd_writer_put(writer->stream, zip, zip_length);
+    } else {
+        for (size_t c = 0; status == PSD_OK && c < count; c++) {
+            status = psd_writer_put_rows(writer->stream, &planes[c]);
+        }
+    }
+
+    psd_alloc_free(writer->allocator, zip);
+    psd_writer_free_payloads(writer, planes, count);
+    psd_alloc_free(writer->allocator, planes);
+    return status;
+}
+
+/* ----------------------------
+ * Public API
+ * ---------------------------- */
+
+static bool psd_writer_options_valid(const psd_writer_options_t *options)
+{
+    uint32_t max_side = options->psb ? PSD_WRITER_MAX_PSB_SIDE : PSD_WRITER_MAX_PSD_SIDE;
+    if (options->width == 0 || options->height == 0 || options->width > max_side ||
+        options->height > max_side) {
+        return false;
+    }
+    if (options->channels == 0 || options->channels > PSD_WRITER_MAX_CHANNELS) {
+        return false;
+    }
+    switch (options->depth) {
+        case 1:
+            if (options->color_mode != PSD_COLOR_BITMAP) return false;
+            break;
+        case 8:
+        case 16:
+        case 32:
+            if (options->color_mode == PSD_COLOR_BITMAP) return false;
+            break;
+        default:
+            return false;
+    }
+    if ((unsigned)options->compression > PSD_COMPRESSION_ZIP_PRED) {
+        return false;
+    }
+    if (options->compression == PSD_COMPRESSION_ZIP_PRED && options->depth == 1) {
+        return false;
+    }
+    return options->compression_level >= 0 && options->compression_level <= 9;
+}
+
+PSD_API psd_status_t psd_writer_create(
+    psd_stream_t *stream,
+    const psd_allocator_t *allocator,
+    const psd_writer_options_t *options,
+    psd_writer_t **out_writer)
+{
+    if (!out_writer) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    *out_writer = NULL;
+    if (!stream || !options) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (!psd_writer_options_valid(options)) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+#if !defined(PSD_ENABLE_ZIP)
+    if (options->compression == PSD_COMPRESSION_ZIP ||
+        options->compression == PSD_COMPRESSION_ZIP_PRED) {
+        return PSD_ERR_UNSUPPORTED_COMPRESSION;
+    }
+#endif
+
+    if (!allocator) allocator = psd_allocator_default();
+    psd_writer_t *writer = (psd_writer_t *)psd_alloc_malloc(allocator, sizeof(*writer));
+    if (!writer) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    memset(writer, 0, sizeof(*writer));
+    writer->stream = stream;
+    writer->allocator = allocator;
+    writer->options = *options;
+    writer->stage = PSD_WRITER_COLOR_MODE;
+
+    uint8_t header[26];
+    memcpy(header, "8BPS", 4);
+    psd_write_be16(header + 4, options->psb ? 2 : 1);
+    memset(header + 6, 0, 6);
+    psd_write_be16(header + 12, options->channels);
+    psd_write_be32(header + 14, options->height);
+    psd_write_be32(header + 18, options->width);
+    psd_write_be16(header + 22, options->depth);
+    psd_write_be16(header + 24, (uint16_t)options->color_mode);
+    psd_status_t status = psd_writer_put(stream, header, sizeof(header));
+    if (status != PSD_OK) {
+        psd_alloc_free(allocator, writer);
+        return status;
+    }
+
+    *out_writer = writer;
+    return PSD_OK;
+}
+
+PSD_API void psd_writer_destroy(psd_writer_t *writer)
+{
+    if (!writer) {
+        return;
+    }
+    psd_alloc_free(writer->allocator, writer->layers);
+    psd_alloc_free(writer->allocator, writer);
+}
+
+PSD_API psd_status_t psd_writer_set_color_mode_data(
+    psd_writer_t *writer,
+    const uint8_t *data,
+    size_t length)
+{
+    if (!writer) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (writer->stage != PSD_WRITER_COLOR_MODE || (!data && length > 0) ||
+        (uint64_t)length > UINT32_MAX) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    /* Color mode data length, then the length field of the resources */
+    uint8_t fields[8];
+    psd_write_be32(fields, (uint32_t)length);
+    psd_write_be32(fields + 4, 0);
+    psd_status_t status = psd_writer_put(writer->stream, fields, 4);
+    if (status == PSD_OK) status = psd_writer_put(writer->stream, data, length);
+    if (status == PSD_OK) {
+        writer->resources_at = psd_stream_tell(writer->stream);
+        if (writer->resources_at < 0) return (psd_status_t)writer->resources_at;
+        status = psd_writer_put(writer->stream, fields + 4, 4);
+    }
+    if (status == PSD_OK) writer->stage = PSD_WRITER_RESOURCES;
+    return status;
+}
+
+PSD_API psd_status_t psd_writer_add_resource(
+    psd_writer_t *writer,
+    uint16_t id,
+    const uint8_t *data,
+    size_t length)
+{
+    if (!writer) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (writer->stage > PSD_WRITER_RESOURCES || (!data && length > 0) ||
+        (uint64_t)length > UINT32_MAX - 1u) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    psd_status_t status = psd_writer_advance(writer, PSD_WRITER_RESOURCES);
+    if (status != PSD_OK) return status;
+
+    /* Signature, ID, empty Pascal name padded to even, data length */
+    uint8_t fields[12];
+    memcpy(fields, "8BIM", 4);
+    psd_write_be16(fields + 4, id);
+    psd_write_be16(fields + 6, 0);
+    psd_write_be32(fields + 8, (uint32_t)length);
+    status = psd_writer_put(writer->stream, fields, sizeof(fields));
+    if (status == PSD_OK) status = psd_writer_put(writer->stream, data, length);
+    if (status == PSD_OK && (length & 1u)) status = psd_writer_put(writer->stream, fields + 6, 1);
+    return status;
+}
+
+PSD_API psd_status_t psd_writer_add_layer(
+    psd_writer_t *writer,
+    const psd_writer_layer_t *layer)
+{
+    if (!writer || !layer) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (writer->stage == PSD_WRITER_FINISHED) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    if (writer->layer_count >= PSD_WRITER_MAX_LAYERS) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    int64_t width = (int64_t)layer->bounds.right - layer->bounds.left;
+    int64_t height = (int64_t)layer->bounds.bottom - layer->bounds.top;
+    int64_t max_side = writer->options.psb ? PSD_WRITER_MAX_PSB_SIDE : PSD_WRITER_MAX_PSD_SIDE;
+    if (width < 0 || height < 0 || width > max_side || height > max_side) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    if (layer->channel_count > PSD_WRITER_MAX_CHANNELS ||
+        (layer->channel_count > 0 && !layer->channels)) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    if ((layer->blocks_length & 1u) || (!layer->blocks && layer->blocks_length > 0) ||
+        (uint64_t)layer->blocks_length > UINT32_MAX / 2u) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    size_t row_bytes = psd_writer_row_bytes(writer->options.depth, (uint64_t)width);
+    for (uint16_t c = 0; c < layer->channel_count; c++) {
+        const psd_writer_channel_t *channel = &layer->channels[c];
+        if (channel->id < -1) {
+            return PSD_ERR_INVALID_ARGUMENT;
+        }
+        if (width > 0 && height > 0 &&
+            (!channel->data || (channel->stride != 0 && channel->stride < row_bytes))) {
+            return PSD_ERR_INVALID_ARGUMENT;
+        }
+    }
+
+    psd_status_t status = psd_writer_advance(writer, PSD_WRITER_LAYERS);
+    if (status != PSD_OK) return status;
+
+    if (writer->layer_count == writer->layer_capacity) {
+        size_t capacity = writer->layer_capacity ? writer->layer_capacity * 2
+                                                 : PSD_WRITER_INITIAL_LAYERS;
+        psd_writer_layer_t *layers = (psd_writer_layer_t *)psd_alloc_realloc(
+            writer->allocator, writer->layers, capacity * sizeof(*layers));
+        if (!layers) {
+            return PSD_ERR_OUT_OF_MEMORY;
+        }
+        writer->layers = layers;
+        writer->layer_capacity = capacity;
+    }
+    writer->layers[writer->layer_count++] = *layer;
+    return PSD_OK;
+}
+
+PSD_API psd_status_t psd_writer_finish(
+    psd_writer_t *writer,
+    const void *const *planes,
+    size_t stride)
+{
+    if (!writer || !planes) {
+        return PSD_ERR_NULL_POINTER;
+    }
+    if (writer->stage == PSD_WRITER_FINISHED) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    size_t row_bytes = psd_writer_row_bytes(writer->options.depth, writer->options.width);
+    if (stride != 0 && stride < row_bytes) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    for (uint16_t c = 0; c < writer->options.channels; c++) {
+        if (!planes[c]) return PSD_ERR_NULL_POINTER;
+    }
+
+    psd_status_t status = psd_writer_advance(writer, PSD_WRITER_LAYERS);
+    writer->stage = PSD_WRITER_FINISHED;
+    if (status == PSD_OK) status = psd_writer_layer_section(writer);
+    if (status == PSD_OK) status = psd_writer_composite(writer, planes, stride);
+    return status;
+}
@@ -1,9 +1,9 @@
 /**
  * @file psd_zip.c
- * @brief ZIP and ZIP-with-prediction decompression implementation
- * 
+ * @brief ZIP and ZIP-with-prediction compression and decompression implementation
+ *
  * Part of the OpenPSD library.
- * 
+ *
  * Copyright (c) 2025-2026 Warren Galyen
  *
  * SPDX-License-Identifier: MIT
@@ -14,168 +14,811 @@
  */
 
 #include "psd_zip.h"
+#include "psd_alloc.h"
+#include "../include/openpsd/psd.h"
+#include <stdint.h>
 #include <string.h>
-#include <stdlib.h>
 
-#ifdef PSD_ENABLE_ZIP
+/* Built-in deflate backend (OPENPSD_DEFLATE_BACKEND). zlib and zlib-ng share
+ * the streaming z_stream code; libdeflate only works on whole buffers. */
+#if defined(PSD_ENABLE_ZIP) && defined(PSD_DEFLATE_LIBDEFLATE)
+#include <libdeflate.h>
+#define PSD_ZIP_LIBDEFLATE 1
+#define PSD_ZIP_BACKEND_NAME "libdeflate"
+#define PSD_ZIP_WBITS 15
+#elif defined(PSD_ENABLE_ZIP) && defined(PSD_DEFLATE_ZLIBNG)
+#include <zlib-ng.h>
+#define PSD_ZIP_ZLIB_API 1
+#define PSD_ZIP_BACKEND_NAME "zlib-ng"
+#define PSD_ZIP_WBITS MAX_WBITS
+typedef zng_stream psd_z_stream;
+#define psd_z_inflateInit2 zng_inflateInit2
+#define psd_z_inflateReset2 zng_inflateReset2
+#define psd_z_inflate zng_inflate
+#define psd_z_inflateEnd zng_inflateEnd
+#define psd_z_deflateInit2 zng_deflateInit2
+#define psd_z_deflate zng_deflate
+#define psd_z_deflateEnd zng_deflateEnd
+#elif defined(PSD_ENABLE_ZIP)
 #include <zlib.h>
+#define PSD_ZIP_ZLIB_API 1
+#define PSD_ZIP_BACKEND_NAME "zlib"
+#define PSD_ZIP_WBITS MAX_WBITS
+typedef z_stream psd_z_stream;
+#define psd_z_inflateInit2 inflateInit2
+#define psd_z_inflateReset2 inflateReset2
+#define psd_z_inflate inflate
+#define psd_z_inflateEnd inflateEnd
+#define psd_z_deflateInit2 deflateInit2
+#define psd_z_deflate deflate
+#define psd_z_deflateEnd deflateEnd
+#else
+#define PSD_ZIP_BACKEND_NAME "none"
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PSD_ZIP_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define PSD_ZIP_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* ----------------------------
+ * Prediction (horizontal delta) reversal
+ *
+ * Photoshop's ZIP-with-prediction has no per-row filter byte. Each row holds
+ * differences from the sample to its left: bytes for 8-bit data, big-endian
+ * words for 16-bit data. 32-bit rows are first split into four byte planes
+ * (all most significant bytes, then the next, ...) and delta-coded as one run
+ * of bytes. Reversal is a running sum along the row, done 16 bytes at a time.
+ * ---------------------------- */
 
 /**
- * @brief Decompress ZIP-compressed data using zlib
+ * @brief Running sum of bytes along a row
  */
-psd_status_t psd_zip_decompress(
-    const uint8_t *compressed,
-    size_t compressed_len,
-    uint8_t *decompressed,
-    size_t decompressed_len,
-    const psd_allocator_t *allocator)
+static void psd_zip_prefix_sum8(uint8_t *row, size_t count)
 {
-    (void)allocator;  /* zlib uses its own memory management */
-    
-    if (!compressed || !decompressed) {
-        return PSD_ERR_INVALID_ARGUMENT;
+    size_t i = 0;
+    uint8_t carry = 0;
+
+#if defined(PSD_ZIP_SSE2)
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(const void *)(row + i));
+        x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+        x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+        x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi8(x, _mm_set1_epi8((char)carry));
+        _mm_storeu_si128((__m128i *)(void *)(row + i), x);
+        carry = (uint8_t)(_mm_cvtsi128_si32(_mm_srli_si128(x, 15)) & 0xFF);
+    }
+#elif defined(PSD_ZIP_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t x = vld1q_u8(row + i);
+        x = vaddq_u8(x, vextq_u8(zero, x, 15));
+        x = vaddq_u8(x, vextq_u8(zero, x, 14));
+        x = vaddq_u8(x, vextq_u8(zero, x, 12));
+        x = vaddq_u8(x, vextq_u8(zero, x, 8));
+        x = vaddq_u8(x, vdupq_n_u8(carry));
+        vst1q_u8(row + i, x);
+        carry = vgetq_lane_u8(x, 15);
     }
-    
-    /* PSD/PSB ZIP-compressed data is DEFLATE, but real-world files vary between
-     * raw DEFLATE streams and zlib-wrapped streams. Try both. */
-    for (int attempt = 0; attempt < 2; attempt++) {
-        int wbits = (attempt == 0) ? -MAX_WBITS : MAX_WBITS;
+#endif
 
-        z_stream stream;
-        memset(&stream, 0, sizeof(stream));
+    for (; i < count; i++) {
+        carry = (uint8_t)(carry + row[i]);
+        row[i] = carry;
+    }
+}
 
-        int ret = inflateInit2(&stream, wbits);
-        if (ret != Z_OK) {
-            continue;
-        }
+/**
+ * @brief Running sum of big-endian 16-bit words along a row
+ */
+static void psd_zip_prefix_sum16(uint8_t *row, size_t count)
+{
+    size_t i = 0;
+    uint16_t carry = 0;
+
+#if defined(PSD_ZIP_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(const void *)(row + i * 2));
+        x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+        x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+        x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi16(x, _mm_set1_epi16((short)carry));
+        carry = (uint16_t)_mm_extract_epi16(x, 7);
+        x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+        _mm_storeu_si128((__m128i *)(void *)(row + i * 2), x);
+    }
+#elif defined(PSD_ZIP_NEON)
+    const uint16x8_t zero = vdupq_n_u16(0);
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t x = vreinterpretq_u16_u8(vrev16q_u8(vld1q_u8(row + i * 2)));
+        x = vaddq_u16(x, vextq_u16(zero, x, 7));
+        x = vaddq_u16(x, vextq_u16(zero, x, 6));
+        x = vaddq_u16(x, vextq_u16(zero, x, 4));
+        x = vaddq_u16(x, vdupq_n_u16(carry));
+        carry = vgetq_lane_u16(x, 7);
+        vst1q_u8(row + i * 2, vrev16q_u8(vreinterpretq_u8_u16(x)));
+    }
+#endif
+
+    for (; i < count; i++) {
+        uint8_t *p = row + i * 2;
+        carry = (uint16_t)(carry + (uint16_t)(((uint16_t)p[0] << 8) | p[1]));
+        p[0] = (uint8_t)(carry >> 8);
+        p[1] = (uint8_t)carry;
+    }
+}
+
+/**
+ * @brief Interleave four byte planes of count samples back into 32-bit samples
+ */
+static void psd_zip_interleave32(const uint8_t *planes, size_t count, uint8_t *out)
+{
+    const uint8_t *b0 = planes;
+    const uint8_t *b1 = planes + count;
+    const uint8_t *b2 = planes + count * 2;
+    const uint8_t *b3 = planes + count * 3;
+    size_t i = 0;
+
+#if defined(PSD_ZIP_SSE2)
+    for (; i + 16 <= count; i += 16) {
+        __m128i p0 = _mm_loadu_si128((const __m128i *)(const void *)(b0 + i));
+        __m128i p1 = _mm_loadu_si128((const __m128i *)(const void *)(b1 + i));
+        __m128i p2 = _mm_loadu_si128((const __m128i *)(const void *)(b2 + i));
+        __m128i p3 = _mm_loadu_si128((const __m128i *)(const void *)(b3 + i));
+        __m128i lo01 = _mm_unpacklo_epi8(p0, p1);
+        __m128i hi01 = _mm_unpackhi_epi8(p0, p1);
+        __m128i lo23 = _mm_unpacklo_epi8(p2, p3);
+        __m128i hi23 = _mm_unpackhi_epi8(p2, p3);
+        uint8_t *o = out + i * 4;
+        _mm_storeu_si128((__m128i *)(void *)(o + 0), _mm_unpacklo_epi16(lo01, lo23));
+        _mm_storeu_si128((__m128i *)(void *)(o + 16), _mm_unpackhi_epi16(lo01, lo23));
+        _mm_storeu_si128((__m128i *)(void *)(o + 32), _mm_unpacklo_epi16(hi01, hi23));
+        _mm_storeu_si128((__m128i *)(void *)(o + 48), _mm_unpackhi_epi16(hi01, hi23));
+    }
+#elif defined(PSD_ZIP_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t v;
+        v.val[0] = vld1q_u8(b0 + i);
+        v.val[1] = vld1q_u8(b1 + i);
+        v.val[2] = vld1q_u8(b2 + i);
+        v.val[3] = vld1q_u8(b3 + i);
+        vst4q_u8(out + i * 4, v);
+    }
+#endif
+
+    for (; i < count; i++) {
+        out[i * 4 + 0] = b0[i];
+        out[i * 4 + 1] = b1[i];
+        out[i * 4 + 2] = b2[i];
+        out[i * 4 + 3] = b3[i];
+    }
+}
 
-        stream.avail_in = (uInt)compressed_len;
-        stream.next_in = (uint8_t *)compressed;
+/**
+ * @brief Reverse Photoshop ZIP prediction on one row
+ */
+psd_status_t psd_zip_unpredict_row(
+    uint8_t *row,
+    size_t row_bytes,
+    size_t bytes_per_sample,
+    uint8_t *scratch)
+{
+    if (!row) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
 
-        stream.avail_out = (uInt)decompressed_len;
-        stream.next_out = decompressed;
+    switch (bytes_per_sample) {
+    case 1:
+        psd_zip_prefix_sum8(row, row_bytes);
+        return PSD_OK;
 
-        ret = inflate(&stream, Z_FINISH);
-        inflateEnd(&stream);
+    case 2:
+        if (row_bytes % 2u != 0) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        psd_zip_prefix_sum16(row, row_bytes / 2u);
+        return PSD_OK;
 
-        if (ret == Z_STREAM_END && stream.total_out == decompressed_len) {
-            return PSD_OK;
+    case 4:
+        if (!scratch) {
+            return PSD_ERR_INVALID_ARGUMENT;
+        }
+        if (row_bytes % 4u != 0) {
+            return PSD_ERR_CORRUPT_DATA;
         }
+        psd_zip_prefix_sum8(row, row_bytes);
+        psd_zip_interleave32(row, row_bytes / 4u, scratch);
+        memcpy(row, scratch, row_bytes);
+        return PSD_OK;
+
+    default:
+        return PSD_ERR_INVALID_ARGUMENT;
     }
+}
 
-    return PSD_ERR_CORRUPT_DATA;
+/**
+ * @brief Reverse prediction on every whole row of a buffer
+ */
+static psd_status_t psd_zip_unpredict_rows(uint8_t *data, size_t length,
+                                           size_t row_bytes, size_t bytes_per_sample,
+                                           uint8_t *scratch)
+{
+    for (size_t at = 0; at + row_bytes <= length; at += row_bytes) {
+        psd_status_t status = psd_zip_unpredict_row(data + at, row_bytes,
+                                                    bytes_per_sample, scratch);
+        if (status != PSD_OK) {
+            return status;
+        }
+    }
+    return PSD_OK;
 }
 
 /**
- * @brief Paeth predictor function (from PNG specification)
+ * @brief Whether data starts with a zlib header (RFC 1950 CMF/FLG)
  *
- * Used to reverse the PNG prediction filter.
+ * Deflate method, a window of at most 32K, no preset dictionary, and the
+ * check bits that make the pair a multiple of 31.
  */
-static inline uint8_t paeth_predictor(uint8_t a, uint8_t b, uint8_t c)
-{
-    int p = (int)a + (int)b - (int)c;
-    int pa = abs(p - (int)a);
-    int pb = abs(p - (int)b);
-    int pc = abs(p - (int)c);
-    
-    if (pa <= pb && pa <= pc) {
-        return a;
-    } else if (pb <= pc) {
-        return b;
-    } else {
-        return c;
+static bool psd_zip_has_zlib_header(const uint8_t *data, size_t length)
+{
+    if (!data || length < 2) {
+        return false;
+    }
+    unsigned cmf = data[0];
+    unsigned flg = data[1];
+    return (cmf & 0x0Fu) == 8u && (cmf >> 4) <= 7u && (flg & 0x20u) == 0 &&
+           ((cmf << 8) | flg) % 31u == 0;
+}
+
+/* ----------------------------
+ * Codec selection
+ * ---------------------------- */
+
+/* Caller codec from psd_set_codec(); inflate is NULL for the built-in backend */
+static psd_codec_t psd_zip_custom_codec;
+
+PSD_API psd_status_t psd_set_codec(const psd_codec_t *codec)
+{
+    if (!codec) {
+        memset(&psd_zip_custom_codec, 0, sizeof(psd_zip_custom_codec));
+        return PSD_OK;
+    }
+    if (!codec->inflate) {
+        return PSD_ERR_INVALID_ARGUMENT;
     }
+    psd_zip_custom_codec = *codec;
+    return PSD_OK;
+}
+
+PSD_API const char *psd_get_deflate_backend(void)
+{
+    return PSD_ZIP_BACKEND_NAME;
+}
+
+/* ----------------------------
+ * Inflate states
+ * ---------------------------- */
+
+#if defined(PSD_ZIP_ZLIB_API)
+
+static void *psd_zip_zalloc(void *opaque, unsigned int items, unsigned int size)
+{
+    if (size != 0 && items > SIZE_MAX / size) {
+        return NULL;
+    }
+    return psd_alloc_malloc((const psd_allocator_t *)opaque, (size_t)items * size);
+}
+
+static void psd_zip_zfree(void *opaque, void *address)
+{
+    psd_alloc_free((const psd_allocator_t *)opaque, address);
 }
 
 /**
- * @brief Reverse ZIP prediction filter (PNG prediction)
+ * @brief Create an inflate state that allocates through allocator
+ */
+static void *psd_zip_state_create(const psd_allocator_t *allocator, int wbits)
+{
+    psd_z_stream *zs = (psd_z_stream *)psd_alloc_malloc(allocator, sizeof(*zs));
+    if (!zs) {
+        return NULL;
+    }
+    memset(zs, 0, sizeof(*zs));
+    zs->zalloc = psd_zip_zalloc;
+    zs->zfree = psd_zip_zfree;
+    zs->opaque = (void *)(uintptr_t)allocator;
+    if (psd_z_inflateInit2(zs, wbits) != Z_OK) {
+        psd_alloc_free(allocator, zs);
+        return NULL;
+    }
+    return zs;
+}
+
+static bool psd_zip_state_reset(void *state, int wbits)
+{
+    return psd_z_inflateReset2((psd_z_stream *)state, wbits) == Z_OK;
+}
+
+static void psd_zip_state_free(const psd_allocator_t *allocator, void *state)
+{
+    if (state) {
+        psd_z_inflateEnd((psd_z_stream *)state);
+        psd_alloc_free(allocator, state);
+    }
+}
+
+#elif defined(PSD_ZIP_LIBDEFLATE)
+
+/* libdeflate decompressors carry no per-call settings; they are only reused */
+static void *psd_zip_state_create(const psd_allocator_t *allocator, int wbits)
+{
+    (void)allocator;
+    (void)wbits;
+    return libdeflate_alloc_decompressor();
+}
+
+static bool psd_zip_state_reset(void *state, int wbits)
+{
+    (void)state;
+    (void)wbits;
+    return true;
+}
+
+static void psd_zip_state_free(const psd_allocator_t *allocator, void *state)
+{
+    (void)allocator;
+    if (state) {
+        libdeflate_free_decompressor((struct libdeflate_decompressor *)state);
+    }
+}
+
+#else
+
+static void psd_zip_state_free(const psd_allocator_t *allocator, void *state)
+{
+    (void)allocator;
+    (void)state;
+}
+
+#endif
+
+void psd_zip_pool_init(psd_zip_pool_t *pool, const psd_allocator_t *allocator)
+{
+    for (size_t i = 0; i < PSD_ZIP_POOL_SLOTS; i++) {
+        psd_once_reset(&pool->busy[i]);
+        pool->streams[i] = NULL;
+    }
+    pool->allocator = allocator;
+}
+
+void psd_zip_pool_destroy(psd_zip_pool_t *pool)
+{
+    for (size_t i = 0; i < PSD_ZIP_POOL_SLOTS; i++) {
+        psd_zip_state_free(pool->allocator, pool->streams[i]);
+        pool->streams[i] = NULL;
+    }
+}
+
+#if defined(PSD_ENABLE_ZIP)
+
+/**
+ * @brief A state ready to inflate with wbits: a pool slot reset for reuse,
+ *        or a one-off state when there is no free slot
  *
- * In PSD files with ZIP prediction, each scanline is prefixed with a
- * filter byte that indicates which PNG filter was applied. We must
- * reverse this filter to get the original data.
+ * @param out_slot Receives the claimed slot, or -1 for a one-off state
  */
-psd_status_t psd_zip_reverse_prediction(
-    uint8_t *scanline_data,
-    size_t scanline_length,
-    size_t bytes_per_pixel)
+static void *psd_zip_acquire(psd_zip_pool_t *pool,
+                             const psd_allocator_t *allocator,
+                             int wbits,
+                             int *out_slot)
 {
-    if (!scanline_data || scanline_length == 0) {
-        return PSD_ERR_INVALID_ARGUMENT;
+    *out_slot = -1;
+    if (pool) {
+        for (int i = 0; i < PSD_ZIP_POOL_SLOTS; i++) {
+            if (!psd_once_claim(&pool->busy[i])) {
+                continue;
+            }
+            void *state = pool->streams[i];
+            if (state && !psd_zip_state_reset(state, wbits)) {
+                psd_zip_state_free(pool->allocator, state);
+                state = NULL;
+            }
+            if (!state) {
+                state = psd_zip_state_create(pool->allocator, wbits);
+            }
+            pool->streams[i] = state;
+            if (!state) {
+                psd_once_reset(&pool->busy[i]);
+                return NULL;
+            }
+            *out_slot = i;
+            return state;
+        }
+        allocator = pool->allocator;
     }
-    
-    if (bytes_per_pixel == 0 || bytes_per_pixel > 8) {
-        return PSD_ERR_INVALID_ARGUMENT;
+    return psd_zip_state_create(allocator, wbits);
+}
+
+static void psd_zip_release(psd_zip_pool_t *pool,
+                            const psd_allocator_t *allocator,
+                            void *state,
+                            int slot)
+{
+    if (slot >= 0) {
+        psd_once_reset(&pool->busy[slot]);
+    } else {
+        psd_zip_state_free(pool ? pool->allocator : allocator, state);
     }
-    
-    /* First byte is the filter type */
-    uint8_t filter_type = scanline_data[0];
-    
-    /* Remaining bytes are the filtered scanline data */
-    uint8_t *data = scanline_data + 1;
-    size_t data_len = scanline_length - 1;
-    
-    switch (filter_type) {
-        case 0: {
-            /* Filter type 0 (None) - no prediction applied */
-            /* Move data back one byte to remove filter indicator */
-            memmove(scanline_data, data, data_len);
+}
+
+#endif /* PSD_ENABLE_ZIP */
+
+/* ----------------------------
+ * Inflate driver
+ * ---------------------------- */
+
+/**
+ * @brief Where compressed bytes come from: a buffer or a stream
+ */
+typedef struct {
+    const uint8_t *data;      /**< Whole compressed buffer, or NULL */
+    size_t length;
+    psd_stream_t *stream;     /**< Stream read through window, or NULL */
+    uint8_t *window;
+    size_t pending;           /**< Bytes already in window for the next pass */
+    int64_t start;            /**< Stream offset of the compressed data */
+} psd_zip_input_t;
+
+/**
+ * @brief Row layout of the output: rows to unpredict as inflate completes
+ *        them, and where rows land
+ */
+typedef struct {
+    size_t row_bytes;         /**< 0 = no prediction */
+    size_t bytes_per_sample;
+    uint8_t *scratch;         /**< One row, for 32-bit data */
+    size_t out_row;           /**< Bytes per output row, 0 = rows back to back */
+    size_t out_stride;        /**< Bytes between output rows when out_row > 0 */
+} psd_zip_rows_t;
+
+/**
+ * @brief Read everything left in a stream, for codecs that need whole buffers
+ */
+static psd_status_t psd_zip_read_rest(psd_stream_t *stream,
+                                      const psd_allocator_t *allocator,
+                                      uint8_t **out_data,
+                                      size_t *out_length)
+{
+    uint8_t *buffer = NULL;
+    size_t capacity = 0;
+    size_t used = 0;
+    for (;;) {
+        if (used == capacity) {
+            size_t grow = (capacity < PSD_ZIP_STREAM_WINDOW) ? PSD_ZIP_STREAM_WINDOW : capacity;
+            if (capacity > SIZE_MAX - grow) {
+                psd_alloc_free(allocator, buffer);
+                return PSD_ERR_OUT_OF_RANGE;
+            }
+            uint8_t *grown = (uint8_t *)psd_alloc_realloc(allocator, buffer, capacity + grow);
+            if (!grown) {
+                psd_alloc_free(allocator, buffer);
+                return PSD_ERR_OUT_OF_MEMORY;
+            }
+            buffer = grown;
+            capacity += grow;
+        }
+        int64_t n = psd_stream_read(stream, buffer + used, capacity - used);
+        if (n < 0) {
+            psd_alloc_free(allocator, buffer);
+            return (psd_status_t)n;
+        }
+        if (n == 0) {
             break;
         }
-        
-        case 1: {
-            /* Filter type 1 (Sub) - each byte is delta from left neighbor */
-            for (size_t i = bytes_per_pixel; i < data_len; i++) {
-                data[i] = (uint8_t)((int)data[i] + (int)data[i - bytes_per_pixel]);
+        used += (size_t)n;
+    }
+    *out_data = buffer;
+    *out_length = used;
+    return PSD_OK;
+}
+
+#if defined(PSD_ZIP_ZLIB_API)
+
+/**
+ * @brief One z_stream inflate pass over the whole input
+ *
+ * Prediction is reversed on each row as soon as inflate has written all of
+ * it, while the row is still in cache. Strided output is handed to inflate
+ * one row at a time.
+ *
+ * @return PSD_OK, PSD_ERR_CORRUPT_DATA if the data does not inflate to
+ *         exactly decompressed_len bytes, or a stream error code
+ */
+static psd_status_t psd_zip_backend_pass(void *state,
+                                         psd_zip_input_t *in,
+                                         bool zlib_wrapped,
+                                         uint8_t *decompressed,
+                                         size_t decompressed_len,
+                                         const psd_zip_rows_t *rows)
+{
+    psd_z_stream *zs = (psd_z_stream *)state;
+    (void)zlib_wrapped;  /* Already set by inflateInit2/inflateReset2 */
+
+    /* avail_in/avail_out are 32-bit; hand out input and output in pieces that
+     * fit. Once the destination is full inflate still runs to see the end of
+     * the data, and fails with Z_BUF_ERROR if there is more output than the
+     * planes hold or the input runs out first. */
+    const uint8_t *next_in = in->data;
+    size_t in_left = in->length;
+    uint8_t *out = decompressed;
+    size_t out_left = decompressed_len;
+    size_t rows_out = 0;
+    size_t rows_done = 0;
+    size_t row_step = (rows->out_row > 0) ? rows->out_stride : rows->row_bytes;
+    psd_status_t status = PSD_ERR_CORRUPT_DATA;
+    int ret = Z_OK;
+
+    zs->next_in = NULL;
+    zs->avail_in = 0;
+    zs->next_out = NULL;
+    zs->avail_out = 0;
+
+    if (in->stream && in->pending > 0) {
+        zs->next_in = in->window;
+        zs->avail_in = (unsigned int)in->pending;
+        in->pending = 0;
+    }
+
+    while (ret == Z_OK) {
+        if (zs->avail_in == 0) {
+            if (in->stream) {
+                int64_t n = psd_stream_read(in->stream, in->window, PSD_ZIP_STREAM_WINDOW);
+                if (n < 0) {
+                    status = (psd_status_t)n;
+                    break;
+                }
+                zs->next_in = in->window;
+                zs->avail_in = (unsigned int)n;
+            } else if (in_left > 0) {
+                zs->next_in = (unsigned char *)(uintptr_t)next_in;
+                zs->avail_in = (in_left > (size_t)UINT32_MAX) ? UINT32_MAX
+                                                              : (unsigned int)in_left;
+                next_in += zs->avail_in;
+                in_left -= zs->avail_in;
             }
-            memmove(scanline_data, data, data_len);
-            break;
         }
-        
-        case 2: {
-            /* Filter type 2 (Up) - each byte is delta from above */
-            /* Since we only have one scanline, above is 0 */
-            memmove(scanline_data, data, data_len);
-            break;
+        if (zs->avail_out == 0 && out_left > 0) {
+            if (rows->out_row > 0) {
+                zs->next_out = decompressed + rows_out * rows->out_stride;
+                zs->avail_out = (unsigned int)rows->out_row;
+                rows_out++;
+            } else {
+                zs->avail_out = (out_left > (size_t)UINT32_MAX) ? UINT32_MAX
+                                                                : (unsigned int)out_left;
+                zs->next_out = out;
+                out += zs->avail_out;
+            }
+            out_left -= zs->avail_out;
         }
-        
-        case 3: {
-            /* Filter type 3 (Average) - each byte is delta from average of left and above */
-            for (size_t i = 0; i < bytes_per_pixel; i++) {
-                data[i] = (uint8_t)((int)data[i] + (int)data[i] / 2);
+
+        ret = psd_z_inflate(zs, Z_NO_FLUSH);
+
+        if (rows->row_bytes > 0) {
+            size_t complete;
+            if (rows->out_row > 0) {
+                /* Every row handed out is complete except a partial last one */
+                complete = rows_out - (zs->avail_out > 0 ? 1u : 0u);
+            } else {
+                size_t produced = zs->next_out ? (size_t)(zs->next_out - decompressed) : 0;
+                complete = produced / rows->row_bytes;
             }
-            for (size_t i = bytes_per_pixel; i < data_len; i++) {
-                int left = (int)data[i - bytes_per_pixel];
-                int above = 0;  /* Above is 0 since we only have one scanline */
-                int avg = (left + above) / 2;
-                data[i] = (uint8_t)((int)data[i] + avg);
+            for (; rows_done < complete; rows_done++) {
+                psd_status_t st = psd_zip_unpredict_row(
+                    decompressed + rows_done * row_step, rows->row_bytes,
+                    rows->bytes_per_sample, rows->scratch);
+                if (st != PSD_OK) {
+                    return st;
+                }
+            }
+        }
+    }
+
+    if (ret == Z_STREAM_END && zs->avail_out == 0 && out_left == 0) {
+        status = PSD_OK;
+        /* Leave a stream right after the compressed data */
+        if (in->stream && psd_stream_seek(in->stream, in->start + (int64_t)zs->total_in) < 0) {
+            status = PSD_ERR_STREAM_SEEK;
+        }
+    }
+    return status;
+}
+
+#elif defined(PSD_ZIP_LIBDEFLATE)
+
+/**
+ * @brief One libdeflate call over the whole buffer, then prediction
+ */
+static psd_status_t psd_zip_backend_pass(void *state,
+                                         psd_zip_input_t *in,
+                                         bool zlib_wrapped,
+                                         uint8_t *decompressed,
+                                         size_t decompressed_len,
+                                         const psd_zip_rows_t *rows)
+{
+    struct libdeflate_decompressor *d = (struct libdeflate_decompressor *)state;
+    enum libdeflate_result ret = zlib_wrapped
+        ? libdeflate_zlib_decompress(d, in->data, in->length, decompressed,
+                                     decompressed_len, NULL)
+        : libdeflate_deflate_decompress(d, in->data, in->length, decompressed,
+                                        decompressed_len, NULL);
+    if (ret != LIBDEFLATE_SUCCESS) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+    if (rows->row_bytes == 0) {
+        return PSD_OK;
+    }
+    return psd_zip_unpredict_rows(decompressed, decompressed_len, rows->row_bytes,
+                                  rows->bytes_per_sample, rows->scratch);
+}
+
+#endif
+
+/**
+ * @brief Inflate from either source with the custom codec or the backend
+ *
+ * The first bytes decide between zlib-wrapped and raw DEFLATE (real-world
+ * files use both), so data normally inflates once; the other form is tried
+ * only if that fails. Stream input is inflated through a window when the
+ * backend can stream, and read in full otherwise. Strided rows likewise go
+ * straight to their place with a streaming backend; whole-buffer codecs
+ * inflate into a temporary plane that is then copied out row by row.
+ */
+static psd_status_t psd_zip_inflate(psd_zip_input_t *in,
+                                    uint8_t *decompressed,
+                                    size_t decompressed_len,
+                                    psd_zip_rows_t rows,
+                                    const psd_allocator_t *allocator,
+                                    psd_zip_pool_t *pool)
+{
+    const psd_codec_t codec = psd_zip_custom_codec;
+#if !defined(PSD_ENABLE_ZIP)
+    (void)pool;
+    if (!codec.inflate) {
+        return PSD_ERR_UNSUPPORTED_COMPRESSION;
+    }
+#endif
+
+    rows.scratch = NULL;
+    if (rows.row_bytes > 0) {
+        if (rows.bytes_per_sample != 1 && rows.bytes_per_sample != 2 &&
+            rows.bytes_per_sample != 4) {
+            return PSD_ERR_INVALID_ARGUMENT;
+        }
+        if (rows.bytes_per_sample == 4) {
+            rows.scratch = (uint8_t *)psd_alloc_malloc(allocator, rows.row_bytes);
+            if (!rows.scratch) {
+                return PSD_ERR_OUT_OF_MEMORY;
+            }
+        }
+    }
+
+    psd_status_t status = PSD_OK;
+    uint8_t *owned = NULL;
+#if defined(PSD_ZIP_ZLIB_API)
+    bool whole_buffer = codec.inflate != NULL;
+#else
+    bool whole_buffer = true;
+#endif
+
+    uint8_t *strided = NULL;
+    size_t out_row = rows.out_row;
+    size_t out_stride = rows.out_stride;
+    uint8_t *plane = NULL;
+    if (out_row > 0 && whole_buffer) {
+        plane = (uint8_t *)psd_alloc_malloc(allocator, decompressed_len);
+        if (!plane) {
+            psd_alloc_free(allocator, rows.scratch);
+            return PSD_ERR_OUT_OF_MEMORY;
+        }
+        strided = decompressed;
+        decompressed = plane;
+        rows.out_row = 0;
+    }
+    if (in->stream && whole_buffer) {
+        status = psd_zip_read_rest(in->stream, allocator, &owned, &in->length);
+        in->data = owned;
+        in->stream = NULL;
+    } else if (in->stream) {
+        in->window = (uint8_t *)psd_alloc_malloc(allocator, PSD_ZIP_STREAM_WINDOW);
+        int64_t n = in->window ? psd_stream_read(in->stream, in->window, PSD_ZIP_STREAM_WINDOW)
+                               : (int64_t)PSD_ERR_OUT_OF_MEMORY;
+        if (n < 0) {
+            status = (psd_status_t)n;
+        } else {
+            in->pending = (size_t)n;
+        }
+    }
+
+    const uint8_t *head = in->stream ? in->window : in->data;
+    size_t head_length = in->stream ? in->pending : in->length;
+    bool zlib_first = psd_zip_has_zlib_header(head, head_length);
+
+    for (int attempt = 0; attempt < 2 && status == PSD_OK; attempt++) {
+        bool zlib_wrapped = (attempt == 0) ? zlib_first : !zlib_first;
+
+        if (codec.inflate) {
+            status = codec.inflate(codec.codec_data, in->data, in->length,
+                                   decompressed, decompressed_len, zlib_wrapped);
+            if (status == PSD_OK && rows.row_bytes > 0) {
+                status = psd_zip_unpredict_rows(decompressed, decompressed_len,
+                                                rows.row_bytes, rows.bytes_per_sample,
+                                                rows.scratch);
             }
-            memmove(scanline_data, data, data_len);
-            break;
         }
-        
-        case 4: {
-            /* Filter type 4 (Paeth) - each byte is delta from Paeth predictor */
-            for (size_t i = 0; i < bytes_per_pixel; i++) {
-                data[i] = (uint8_t)((int)data[i] + paeth_predictor(0, 0, 0));
+#if defined(PSD_ENABLE_ZIP)
+        else {
+            int wbits = zlib_wrapped ? PSD_ZIP_WBITS : -PSD_ZIP_WBITS;
+            if (attempt > 0 && in->stream && psd_stream_seek(in->stream, in->start) < 0) {
+                status = PSD_ERR_STREAM_SEEK;
+                break;
             }
-            for (size_t i = bytes_per_pixel; i < data_len; i++) {
-                uint8_t left = data[i - bytes_per_pixel];
-                uint8_t above = 0;  /* Above is 0 */
-                uint8_t diag = 0;   /* Diagonal (above-left) is 0 */
-                uint8_t pred = paeth_predictor(left, above, diag);
-                data[i] = (uint8_t)((int)data[i] + (int)pred);
+            int slot = -1;
+            void *state = psd_zip_acquire(pool, allocator, wbits, &slot);
+            if (!state) {
+                status = PSD_ERR_OUT_OF_MEMORY;
+                break;
             }
-            memmove(scanline_data, data, data_len);
+            status = psd_zip_backend_pass(state, in, zlib_wrapped, decompressed,
+                                          decompressed_len, &rows);
+            psd_zip_release(pool, allocator, state, slot);
+        }
+#endif
+
+        if (status != PSD_ERR_CORRUPT_DATA) {
             break;
         }
-        
-        default: {
-            /* Unknown filter type */
-            return PSD_ERR_CORRUPT_DATA;
+        if (attempt == 0) {
+            status = PSD_OK;
         }
     }
-    
-    return PSD_OK;
+
+    if (plane && status == PSD_OK) {
+        for (size_t r = 0; r < decompressed_len / out_row; r++) {
+            memcpy(strided + r * out_stride, plane + r * out_row, out_row);
+        }
+    }
+
+    psd_alloc_free(allocator, plane);
+    psd_alloc_free(allocator, owned);
+    psd_alloc_free(allocator, in->window);
+    psd_alloc_free(allocator, rows.scratch);
+    return status;
+}
+
+/**
+ * @brief Decompress ZIP-compressed data
+ */
+psd_status_t psd_zip_decompress(
+    const uint8_t *compressed,
+    size_t compressed_len,
+    uint8_t *decompressed,
+    size_t decompressed_len,
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *pool)
+{
+    if (!compressed || !decompressed) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    psd_zip_input_t in = { compressed, compressed_len, NULL, NULL, 0, 0 };
+    psd_zip_rows_t rows = { 0, 0, NULL, 0, 0 };
+    return psd_zip_inflate(&in, decompressed, decompressed_len, rows, allocator, pool);
 }
 
 /**
@@ -187,102 +830,448 @@ psd_status_t psd_zip_decompress_with_prediction(
     uint8_t *decompressed,
     size_t decompressed_len,
     size_t scanline_width,
-    size_t bytes_per_pixel,
-    const psd_allocator_t *allocator)
+    size_t bytes_per_sample,
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *pool)
 {
-    if (scanline_width == 0) {
+    if (!compressed || !decompressed) {
         return PSD_ERR_INVALID_ARGUMENT;
     }
-    
-    /* Decompress first */
-    psd_status_t status = psd_zip_decompress(
-        compressed, compressed_len,
-        decompressed, decompressed_len,
-        allocator);
-    
-    if (status != PSD_OK) {
-        return status;
-    }
-    
-    /* Each scanline is prefixed with a filter byte, so scanline_length includes it */
-    size_t scanline_length = scanline_width + 1;
-    
-    /* Reverse prediction for each scanline */
-    for (size_t offset = 0; offset < decompressed_len; offset += scanline_width) {
-        if (offset + scanline_length > decompressed_len) {
-            break;  /* Incomplete scanline, skip */
-        }
-        
-        status = psd_zip_reverse_prediction(
-            &decompressed[offset],
-            scanline_length,
-            bytes_per_pixel);
-        
-        if (status != PSD_OK) {
-            return status;
-        }
+    if (scanline_width == 0 || decompressed_len % scanline_width != 0) {
+        return PSD_ERR_INVALID_ARGUMENT;
     }
-    
-    return PSD_OK;
-}
 
-#else  /* PSD_ENABLE_ZIP not defined */
+    psd_zip_input_t in = { compressed, compressed_len, NULL, NULL, 0, 0 };
+    psd_zip_rows_t rows = { scanline_width, bytes_per_sample, NULL, 0, 0 };
+    return psd_zip_inflate(&in, decompressed, decompressed_len, rows, allocator, pool);
+}
 
 /**
- * @brief Stub function when zlib is not available
+ * @brief Decompress ZIP data into rows at a stride
  */
-psd_status_t psd_zip_decompress(
+psd_status_t psd_zip_decompress_rows(
     const uint8_t *compressed,
     size_t compressed_len,
-    uint8_t *decompressed,
-    size_t decompressed_len,
-    const psd_allocator_t *allocator)
+    uint8_t *dst,
+    size_t row_count,
+    size_t row_bytes,
+    size_t dst_stride,
+    size_t bytes_per_sample,
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *pool)
 {
-    (void)compressed;
-    (void)compressed_len;
-    (void)decompressed;
-    (void)decompressed_len;
-    (void)allocator;
-    
-    return PSD_ERR_UNSUPPORTED_COMPRESSION;
+    if (!compressed || !dst || row_bytes == 0 || dst_stride < row_bytes) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    if (row_bytes > (size_t)UINT32_MAX || row_count > SIZE_MAX / row_bytes) {
+        return PSD_ERR_OUT_OF_RANGE;
+    }
+
+    psd_zip_input_t in = { compressed, compressed_len, NULL, NULL, 0, 0 };
+    psd_zip_rows_t rows = { bytes_per_sample ? row_bytes : 0, bytes_per_sample, NULL,
+                            (dst_stride == row_bytes) ? 0 : row_bytes, dst_stride };
+    return psd_zip_inflate(&in, dst, row_count * row_bytes, rows, allocator, pool);
 }
 
 /**
- * @brief Stub function when zlib is not available
+ * @brief Inflate from a stream through a fixed-size input window
  */
-psd_status_t psd_zip_reverse_prediction(
-    uint8_t *scanline_data,
-    size_t scanline_length,
-    size_t bytes_per_pixel)
-{
-    (void)scanline_data;
-    (void)scanline_length;
-    (void)bytes_per_pixel;
-    
-    return PSD_ERR_UNSUPPORTED_COMPRESSION;
+psd_status_t psd_zip_inflate_stream(
+    psd_stream_t *stream,
+    uint8_t *decompressed,
+    size_t decompressed_len,
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *pool)
+{
+    if (!stream || !decompressed) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    int64_t start = psd_stream_tell(stream);
+    if (start < 0) {
+        return (psd_status_t)start;
+    }
+
+    psd_zip_input_t in = { NULL, 0, stream, NULL, 0, start };
+    psd_zip_rows_t rows = { 0, 0, NULL, 0, 0 };
+    return psd_zip_inflate(&in, decompressed, decompressed_len, rows, allocator, pool);
 }
 
 /**
- * @brief Stub function when zlib is not available
+ * @brief Inflate from a stream, reversing prediction row by row
  */
-psd_status_t psd_zip_decompress_with_prediction(
-    const uint8_t *compressed,
-    size_t compressed_len,
+psd_status_t psd_zip_inflate_stream_with_prediction(
+    psd_stream_t *stream,
     uint8_t *decompressed,
     size_t decompressed_len,
     size_t scanline_width,
-    size_t bytes_per_pixel,
-    const psd_allocator_t *allocator)
-{
-    (void)compressed;
-    (void)compressed_len;
-    (void)decompressed;
-    (void)decompressed_len;
-    (void)scanline_width;
-    (void)bytes_per_pixel;
+    size_t bytes_per_sample,
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *pool)
+{
+    if (!stream || !decompressed) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    if (scanline_width == 0 || decompressed_len % scanline_width != 0) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    int64_t start = psd_stream_tell(stream);
+    if (start < 0) {
+        return (psd_status_t)start;
+    }
+
+    psd_zip_input_t in = { NULL, 0, stream, NULL, 0, start };
+    psd_zip_rows_t rows = { scanline_width, bytes_per_sample, NULL, 0, 0 };
+    return psd_zip_inflate(&in, decompressed, decompressed_len, rows, allocator, pool);
+}
+
+/* ----------------------------
+ * Incremental inflate
+ * ---------------------------- */
+
+#if defined(PSD_ZIP_ZLIB_API)
+
+struct psd_zip_inflater {
+    const psd_allocator_t *allocator;
+    void *state;             /**< z_stream */
+    bool done;               /**< Z_STREAM_END seen */
+};
+
+psd_status_t psd_zip_inflater_create(
+    const psd_allocator_t *allocator,
+    const uint8_t *head,
+    size_t head_length,
+    psd_zip_inflater_t **out_inflater)
+{
+    if (!out_inflater) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    *out_inflater = NULL;
+    if (psd_zip_custom_codec.inflate) {
+        return PSD_ERR_UNSUPPORTED_FEATURE;
+    }
+
+    psd_zip_inflater_t *inflater =
+        (psd_zip_inflater_t *)psd_alloc_malloc(allocator, sizeof(*inflater));
+    if (!inflater) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    int wbits = psd_zip_has_zlib_header(head, head_length) ? PSD_ZIP_WBITS : -PSD_ZIP_WBITS;
+    inflater->allocator = allocator;
+    inflater->state = psd_zip_state_create(allocator, wbits);
+    inflater->done = false;
+    if (!inflater->state) {
+        psd_alloc_free(allocator, inflater);
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    *out_inflater = inflater;
+    return PSD_OK;
+}
+
+psd_status_t psd_zip_inflater_run(
+    psd_zip_inflater_t *inflater,
+    const uint8_t *in,
+    size_t in_length,
+    size_t *in_used,
+    uint8_t *out,
+    size_t out_length,
+    size_t *out_used)
+{
+    if (!inflater || !in_used || !out_used || (!in && in_length > 0) || (!out && out_length > 0)) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    *in_used = 0;
+    *out_used = 0;
+
+    psd_z_stream *zs = (psd_z_stream *)inflater->state;
+    while (!inflater->done && *out_used < out_length) {
+        /* avail_in/avail_out are 32-bit */
+        size_t in_piece = in_length - *in_used;
+        size_t out_piece = out_length - *out_used;
+        in_piece = (in_piece > (size_t)UINT32_MAX) ? (size_t)UINT32_MAX : in_piece;
+        out_piece = (out_piece > (size_t)UINT32_MAX) ? (size_t)UINT32_MAX : out_piece;
+        zs->next_in = (unsigned char *)(uintptr_t)(in_piece ? in + *in_used : NULL);
+        zs->avail_in = (unsigned int)in_piece;
+        zs->next_out = out + *out_used;
+        zs->avail_out = (unsigned int)out_piece;
+
+        int ret = psd_z_inflate(zs, Z_NO_FLUSH);
+        size_t consumed = in_piece - zs->avail_in;
+        size_t produced = out_piece - zs->avail_out;
+        *in_used += consumed;
+        *out_used += produced;
+
+        if (ret == Z_STREAM_END) {
+            inflater->done = true;
+        } else if (ret == Z_BUF_ERROR || (consumed == 0 && produced == 0)) {
+            /* Needs more input */
+            break;
+        } else if (ret != Z_OK) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+    }
+    return PSD_OK;
+}
+
+bool psd_zip_inflater_done(const psd_zip_inflater_t *inflater)
+{
+    return inflater && inflater->done;
+}
+
+void psd_zip_inflater_destroy(psd_zip_inflater_t *inflater)
+{
+    if (inflater) {
+        psd_zip_state_free(inflater->allocator, inflater->state);
+        psd_alloc_free(inflater->allocator, inflater);
+    }
+}
+
+#else
+
+/* libdeflate and the no-ZIP build have no streaming inflate */
+psd_status_t psd_zip_inflater_create(
+    const psd_allocator_t *allocator,
+    const uint8_t *head,
+    size_t head_length,
+    psd_zip_inflater_t **out_inflater)
+{
+    (void)allocator;
+    (void)head;
+    (void)head_length;
+    if (!out_inflater) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    *out_inflater = NULL;
+#if defined(PSD_ENABLE_ZIP)
+    return PSD_ERR_UNSUPPORTED_FEATURE;
+#else
+    return psd_zip_custom_codec.inflate ? PSD_ERR_UNSUPPORTED_FEATURE
+                                        : PSD_ERR_UNSUPPORTED_COMPRESSION;
+#endif
+}
+
+psd_status_t psd_zip_inflater_run(
+    psd_zip_inflater_t *inflater,
+    const uint8_t *in,
+    size_t in_length,
+    size_t *in_used,
+    uint8_t *out,
+    size_t out_length,
+    size_t *out_used)
+{
+    (void)inflater;
+    (void)in;
+    (void)in_length;
+    (void)out;
+    (void)out_length;
+    if (in_used) {
+        *in_used = 0;
+    }
+    if (out_used) {
+        *out_used = 0;
+    }
+    return PSD_ERR_UNSUPPORTED_FEATURE;
+}
+
+bool psd_zip_inflater_done(const psd_zip_inflater_t *inflater)
+{
+    (void)inflater;
+    return false;
+}
+
+void psd_zip_inflater_destroy(psd_zip_inflater_t *inflater)
+{
+    (void)inflater;
+}
+
+#endif
+
+/* ----------------------------
+ * Compression
+ * ---------------------------- */
+
+psd_status_t psd_zip_predict_row(
+    uint8_t *row,
+    size_t row_bytes,
+    size_t bytes_per_sample,
+    uint8_t *scratch)
+{
+    if (!row) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    if (bytes_per_sample != 1 && bytes_per_sample != 2 && bytes_per_sample != 4) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    if (row_bytes % bytes_per_sample != 0) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+
+    if (bytes_per_sample == 2) {
+        uint16_t prev = 0;
+        for (size_t i = 0; i < row_bytes; i += 2) {
+            uint16_t cur = (uint16_t)(((uint16_t)row[i] << 8) | row[i + 1]);
+            uint16_t delta = (uint16_t)(cur - prev);
+            row[i] = (uint8_t)(delta >> 8);
+            row[i + 1] = (uint8_t)delta;
+            prev = cur;
+        }
+        return PSD_OK;
+    }
+
+    if (bytes_per_sample == 4) {
+        if (!scratch) {
+            return PSD_ERR_INVALID_ARGUMENT;
+        }
+        size_t count = row_bytes / 4u;
+        for (size_t i = 0; i < count; i++) {
+            scratch[i] = row[i * 4 + 0];
+            scratch[count + i] = row[i * 4 + 1];
+            scratch[count * 2 + i] = row[i * 4 + 2];
+            scratch[count * 3 + i] = row[i * 4 + 3];
+        }
+        memcpy(row, scratch, row_bytes);
+    }
+
+    uint8_t prev = 0;
+    for (size_t i = 0; i < row_bytes; i++) {
+        uint8_t cur = row[i];
+        row[i] = (uint8_t)(cur - prev);
+        prev = cur;
+    }
+    return PSD_OK;
+}
+
+#if defined(PSD_ZIP_ZLIB_API)
+
+/* Input and output are handed to z_stream in pieces its counters can hold */
+#define PSD_ZIP_DEFLATE_PIECE ((size_t)1 << 30)
+
+psd_status_t psd_zip_compress(
+    const uint8_t *src,
+    size_t src_len,
+    int level,
+    const psd_allocator_t *allocator,
+    uint8_t **out_data,
+    size_t *out_len)
+{
+    if ((!src && src_len > 0) || !out_data || !out_len) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    *out_data = NULL;
+    *out_len = 0;
+
+    psd_z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    zs.zalloc = psd_zip_zalloc;
+    zs.zfree = psd_zip_zfree;
+    zs.opaque = (void *)(uintptr_t)allocator;
+    if (psd_z_deflateInit2(&zs, level > 0 ? level : Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                           MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+
+    /* Stored blocks cost 5 bytes per 16 KB at worst, plus the wrapper; the
+     * buffer still grows if a backend needs more */
+    size_t capacity = src_len + (src_len >> 12) + (src_len >> 14) + 64;
+    uint8_t *buffer = (uint8_t *)psd_alloc_malloc(allocator, capacity);
+    psd_status_t status = buffer ? PSD_OK : PSD_ERR_OUT_OF_MEMORY;
+    size_t consumed = 0;
+    size_t produced = 0;
+
+    while (status == PSD_OK) {
+        if (produced == capacity) {
+            size_t grown = capacity + capacity / 2;
+            uint8_t *larger = (uint8_t *)psd_alloc_realloc(allocator, buffer, grown);
+            if (!larger) {
+                status = PSD_ERR_OUT_OF_MEMORY;
+                break;
+            }
+            buffer = larger;
+            capacity = grown;
+        }
+        size_t in_piece = src_len - consumed;
+        if (in_piece > PSD_ZIP_DEFLATE_PIECE) in_piece = PSD_ZIP_DEFLATE_PIECE;
+        size_t out_piece = capacity - produced;
+        if (out_piece > PSD_ZIP_DEFLATE_PIECE) out_piece = PSD_ZIP_DEFLATE_PIECE;
+
+        zs.next_in = (src_len > 0) ? (uint8_t *)(uintptr_t)(src + consumed) : NULL;
+        zs.avail_in = (unsigned int)in_piece;
+        zs.next_out = buffer + produced;
+        zs.avail_out = (unsigned int)out_piece;
+        int flush = (consumed + in_piece == src_len) ? Z_FINISH : Z_NO_FLUSH;
+        int ret = psd_z_deflate(&zs, flush);
+        consumed += in_piece - zs.avail_in;
+        produced += out_piece - zs.avail_out;
+        if (ret == Z_STREAM_END) {
+            break;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            status = PSD_ERR_OUT_OF_MEMORY;
+        }
+    }
+    psd_z_deflateEnd(&zs);
+
+    if (status != PSD_OK) {
+        psd_alloc_free(allocator, buffer);
+        return status;
+    }
+    *out_data = buffer;
+    *out_len = produced;
+    return PSD_OK;
+}
+
+#elif defined(PSD_ZIP_LIBDEFLATE)
+
+psd_status_t psd_zip_compress(
+    const uint8_t *src,
+    size_t src_len,
+    int level,
+    const psd_allocator_t *allocator,
+    uint8_t **out_data,
+    size_t *out_len)
+{
+    if ((!src && src_len > 0) || !out_data || !out_len) {
+        return PSD_ERR_INVALID_ARGUMENT;
+    }
+    *out_data = NULL;
+    *out_len = 0;
+
+    struct libdeflate_compressor *compressor = libdeflate_alloc_compressor(level > 0 ? level : 6);
+    if (!compressor) {
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    size_t capacity = libdeflate_zlib_compress_bound(compressor, src_len);
+    uint8_t *buffer = (uint8_t *)psd_alloc_malloc(allocator, capacity);
+    size_t produced = buffer ? libdeflate_zlib_compress(compressor, src, src_len, buffer, capacity)
+                             : 0;
+    libdeflate_free_compressor(compressor);
+    if (produced == 0) {
+        psd_alloc_free(allocator, buffer);
+        return PSD_ERR_OUT_OF_MEMORY;
+    }
+    *out_data = buffer;
+    *out_len = produced;
+    return PSD_OK;
+}
+
+#else
+
+psd_status_t psd_zip_compress(
+    const uint8_t *src,
+    size_t src_len,
+    int level,
+    const psd_allocator_t *allocator,
+    uint8_t **out_data,
+    size_t *out_len)
+{
+    (void)src;
+    (void)src_len;
+    (void)level;
     (void)allocator;
-    
+    if (out_data) *out_data = NULL;
+    if (out_len) *out_len = 0;
     return PSD_ERR_UNSUPPORTED_COMPRESSION;
 }
 
-#endif  /* PSD_ENABLE_ZIP */
+#endif
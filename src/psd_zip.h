@@ -1,9 +1,10 @@
 /**
  * @file psd_zip.h
- * @brief ZIP and ZIP-with-prediction decompression
+ * @brief ZIP and ZIP-with-prediction compression and decompression
  *
  * Implements decompression of ZIP-compressed and ZIP-with-prediction
- * compressed data as used in PSD composite and layer data.
+ * compressed data as used in PSD composite and layer data, and the matching
+ * compression used by the writer.
  * 
  * Part of the OpenPSD library.
  * 
@@ -25,25 +26,58 @@
 #include "../include/openpsd/psd_types.h"
 #include "../include/openpsd/psd_error.h"
 #include "../include/openpsd/psd_export.h"
+#include "../include/openpsd/psd_stream.h"
+#include "psd_once.h"
 
 /**
- * @brief Prediction filter type (used in ZIP with prediction)
+ * @brief Bytes of compressed input held at a time by psd_zip_inflate_stream()
  */
-typedef enum {
-    PSD_ZIP_PREDICTION_NONE = 0,
-    PSD_ZIP_PREDICTION_PAETH = 1,
-} psd_zip_prediction_t;
+#define PSD_ZIP_STREAM_WINDOW ((size_t)256 * 1024)
+
+/**
+ * @brief Number of inflate states a psd_zip_pool_t keeps for reuse
+ */
+#define PSD_ZIP_POOL_SLOTS 16
+
+/**
+ * @brief Inflate states kept across channels of one document
+ *
+ * Setting up zlib costs more than inflating a small channel, so states are
+ * reset and reused instead. Slots are claimed without blocking; when they are
+ * all busy (more concurrent decodes than slots) a one-off state is used. zlib
+ * allocates through the pool's allocator.
+ */
+typedef struct {
+    psd_once_t busy[PSD_ZIP_POOL_SLOTS];  /**< Claimed while a decode uses the slot */
+    void *streams[PSD_ZIP_POOL_SLOTS];    /**< z_stream, NULL until first use */
+    const psd_allocator_t *allocator;
+} psd_zip_pool_t;
+
+/**
+ * @brief Prepare an empty pool (internal)
+ */
+PSD_INTERNAL void psd_zip_pool_init(psd_zip_pool_t *pool, const psd_allocator_t *allocator);
+
+/**
+ * @brief Free every state kept by the pool (internal)
+ *
+ * No decode may be using the pool.
+ */
+PSD_INTERNAL void psd_zip_pool_destroy(psd_zip_pool_t *pool);
 
 /**
  * @brief Decompress ZIP-compressed data (internal)
  *
  * Decompresses zlib/ZIP-compressed data. Requires zlib library support.
+ * The zlib header (CMF/FLG) decides between zlib-wrapped and raw DEFLATE up
+ * front; the other form is only tried if that inflate fails.
  *
  * @param compressed Compressed data buffer
  * @param compressed_len Length of compressed data
  * @param decompressed Output buffer for decompressed data
  * @param decompressed_len Expected length of decompressed data
- * @param allocator Memory allocator
+ * @param allocator Memory allocator (for zlib when there is no pool)
+ * @param pool Inflate states to reuse, or NULL for a one-off state
  * @return PSD_OK on success, error code on failure
  *         PSD_ERR_UNSUPPORTED_COMPRESSION if zlib not available at build time
  */
@@ -52,37 +86,44 @@ PSD_INTERNAL psd_status_t psd_zip_decompress(
     size_t compressed_len,
     uint8_t *decompressed,
     size_t decompressed_len,
-    const psd_allocator_t *allocator);
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *pool);
 
 /**
- * @brief Reverse ZIP prediction filter applied to scanline (internal)
+ * @brief Reverse Photoshop ZIP prediction on one row (internal)
  *
- * Reverses the prediction filter applied during PNG prediction.
- * This must be done scanline-by-scanline after decompression.
+ * Rows carry no filter byte. 8-bit rows are byte deltas and 16-bit rows are
+ * deltas of big-endian words. 32-bit rows hold the samples split into four
+ * byte planes (most significant first), delta-coded as bytes; they are
+ * summed and then interleaved back into big-endian samples.
  *
- * @param scanline_data Compressed scanline data (includes prediction byte)
- * @param scanline_length Length of scanline including prediction byte
- * @param bytes_per_pixel Number of bytes per pixel (depth / 8)
+ * @param row Row data, reversed in place
+ * @param row_bytes Row length in bytes (a multiple of bytes_per_sample)
+ * @param bytes_per_sample 1, 2 or 4
+ * @param scratch row_bytes of scratch space for 32-bit rows, otherwise unused
  * @return PSD_OK on success, error code on failure
  */
-PSD_INTERNAL psd_status_t psd_zip_reverse_prediction(
-    uint8_t *scanline_data,
-    size_t scanline_length,
-    size_t bytes_per_pixel);
+PSD_INTERNAL psd_status_t psd_zip_unpredict_row(
+    uint8_t *row,
+    size_t row_bytes,
+    size_t bytes_per_sample,
+    uint8_t *scratch);
 
 /**
  * @brief Decompress ZIP data with prediction (internal)
  *
  * Decompresses ZIP-compressed data that was compressed with prediction.
- * Automatically applies prediction reversal to output.
+ * Prediction is reversed with psd_zip_unpredict_row() on each scanline as
+ * soon as inflate has produced it.
  *
  * @param compressed Compressed data buffer
  * @param compressed_len Length of compressed data
  * @param decompressed Output buffer for decompressed data
  * @param decompressed_len Expected length of decompressed data
  * @param scanline_width Width of each scanline in bytes
- * @param bytes_per_pixel Number of bytes per pixel (depth / 8)
+ * @param bytes_per_sample Bytes per sample (depth / 8: 1, 2 or 4)
  * @param allocator Memory allocator
+ * @param pool Inflate states to reuse, or NULL
  * @return PSD_OK on success, error code on failure
  */
 PSD_INTERNAL psd_status_t psd_zip_decompress_with_prediction(
@@ -91,7 +132,187 @@ PSD_INTERNAL psd_status_t psd_zip_decompress_with_prediction(
     uint8_t *decompressed,
     size_t decompressed_len,
     size_t scanline_width,
-    size_t bytes_per_pixel,
-    const psd_allocator_t *allocator);
+    size_t bytes_per_sample,
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *pool);
+
+/**
+ * @brief Decompress ZIP data into rows at a stride, with or without
+ *        prediction (internal)
+ *
+ * Row r of the output is written at dst + r * dst_stride and the bytes
+ * between rows are left alone. Streaming backends inflate each row straight
+ * into place; the libdeflate backend and custom codecs need a temporary
+ * plane when dst_stride != row_bytes.
+ *
+ * @param compressed Compressed data buffer
+ * @param compressed_len Length of compressed data
+ * @param dst Output, at least (row_count - 1) * dst_stride + row_bytes long
+ * @param row_count Number of rows
+ * @param row_bytes Bytes per row
+ * @param dst_stride Bytes between output rows (at least row_bytes)
+ * @param bytes_per_sample Prediction sample size (1, 2 or 4), 0 for none
+ * @param allocator Memory allocator
+ * @param pool Inflate states to reuse, or NULL
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT for a short stride, or
+ *         another error code as psd_zip_decompress()
+ */
+PSD_INTERNAL psd_status_t psd_zip_decompress_rows(
+    const uint8_t *compressed,
+    size_t compressed_len,
+    uint8_t *dst,
+    size_t row_count,
+    size_t row_bytes,
+    size_t dst_stride,
+    size_t bytes_per_sample,
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *pool);
+
+/**
+ * @brief Inflate ZIP data read incrementally from a stream (internal)
+ *
+ * Reads the compressed data through a PSD_ZIP_STREAM_WINDOW sized buffer
+ * and inflates straight into the destination, so the compressed payload never
+ * needs to be held in full. On success the stream is left just after the end
+ * of the compressed data.
+ *
+ * @param stream Stream positioned at the start of the compressed data
+ * @param decompressed Output buffer for decompressed data
+ * @param decompressed_len Expected length of decompressed data
+ * @param allocator Memory allocator (used for the input window)
+ * @param pool Inflate states to reuse, or NULL
+ * @return PSD_OK on success, PSD_ERR_CORRUPT_DATA if the data does not
+ *         inflate to exactly decompressed_len bytes, a stream error code, or
+ *         PSD_ERR_UNSUPPORTED_COMPRESSION if zlib not available at build time
+ */
+PSD_INTERNAL psd_status_t psd_zip_inflate_stream(
+    psd_stream_t *stream,
+    uint8_t *decompressed,
+    size_t decompressed_len,
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *pool);
+
+/**
+ * @brief Inflate ZIP data with prediction read incrementally from a stream (internal)
+ *
+ * As psd_zip_inflate_stream(), reversing prediction on each scanline as it
+ * is produced, as psd_zip_decompress_with_prediction() does.
+ *
+ * @param stream Stream positioned at the start of the compressed data
+ * @param decompressed Output buffer for decompressed data
+ * @param decompressed_len Expected length of decompressed data
+ * @param scanline_width Width of each scanline in bytes
+ * @param bytes_per_sample Bytes per sample (depth / 8: 1, 2 or 4)
+ * @param allocator Memory allocator
+ * @param pool Inflate states to reuse, or NULL
+ * @return PSD_OK on success, error code on failure
+ */
+PSD_INTERNAL psd_status_t psd_zip_inflate_stream_with_prediction(
+    psd_stream_t *stream,
+    uint8_t *decompressed,
+    size_t decompressed_len,
+    size_t scanline_width,
+    size_t bytes_per_sample,
+    const psd_allocator_t *allocator,
+    psd_zip_pool_t *pool);
+
+/**
+ * @brief Inflate state fed compressed data as it arrives (internal)
+ */
+typedef struct psd_zip_inflater psd_zip_inflater_t;
+
+/**
+ * @brief Start inflating a stream of unknown length (internal)
+ *
+ * The first bytes of the data choose between zlib-wrapped and raw DEFLATE,
+ * as for the other inflate functions; there is no second attempt.
+ *
+ * @param allocator Allocator for the state
+ * @param head First bytes of the compressed data (at least 2 when available)
+ * @param head_length Bytes at head
+ * @param out_inflater Receives the state, freed with psd_zip_inflater_destroy()
+ * @return PSD_OK on success, PSD_ERR_UNSUPPORTED_FEATURE when the backend or
+ *         a codec set with psd_set_codec() only takes whole buffers,
+ *         PSD_ERR_UNSUPPORTED_COMPRESSION if zlib not available at build
+ *         time, or PSD_ERR_OUT_OF_MEMORY
+ */
+PSD_INTERNAL psd_status_t psd_zip_inflater_create(
+    const psd_allocator_t *allocator,
+    const uint8_t *head,
+    size_t head_length,
+    psd_zip_inflater_t **out_inflater);
+
+/**
+ * @brief Inflate as much of in as fits in out (internal)
+ *
+ * @param inflater State from psd_zip_inflater_create()
+ * @param in Next compressed bytes
+ * @param in_length Bytes at in
+ * @param in_used Receives the bytes of in consumed
+ * @param out Output
+ * @param out_length Bytes available at out
+ * @param out_used Receives the bytes written to out
+ * @return PSD_OK (check psd_zip_inflater_done()), or PSD_ERR_CORRUPT_DATA
+ */
+PSD_INTERNAL psd_status_t psd_zip_inflater_run(
+    psd_zip_inflater_t *inflater,
+    const uint8_t *in,
+    size_t in_length,
+    size_t *in_used,
+    uint8_t *out,
+    size_t out_length,
+    size_t *out_used);
+
+/**
+ * @brief Whether the end of the compressed data has been reached (internal)
+ */
+PSD_INTERNAL bool psd_zip_inflater_done(const psd_zip_inflater_t *inflater);
+
+/**
+ * @brief Free an inflate state (internal; safe to call with NULL)
+ */
+PSD_INTERNAL void psd_zip_inflater_destroy(psd_zip_inflater_t *inflater);
+
+/**
+ * @brief Apply Photoshop ZIP prediction to one row (internal)
+ *
+ * The inverse of psd_zip_unpredict_row(): byte deltas for 8-bit rows,
+ * deltas of big-endian words for 16-bit rows, and for 32-bit rows the four
+ * byte planes (most significant first) delta-coded as bytes.
+ *
+ * @param row Row data, predicted in place
+ * @param row_bytes Row length in bytes (a multiple of bytes_per_sample)
+ * @param bytes_per_sample 1, 2 or 4
+ * @param scratch row_bytes of scratch space for 32-bit rows, otherwise unused
+ * @return PSD_OK on success, PSD_ERR_INVALID_ARGUMENT on bad arguments
+ */
+PSD_INTERNAL psd_status_t psd_zip_predict_row(
+    uint8_t *row,
+    size_t row_bytes,
+    size_t bytes_per_sample,
+    uint8_t *scratch);
+
+/**
+ * @brief Deflate a buffer into a zlib-wrapped stream (internal)
+ *
+ * Uses the built-in backend; a codec set with psd_set_codec() only replaces
+ * inflate.
+ *
+ * @param src Data to compress
+ * @param src_len Length of src
+ * @param level 1 (fastest) to 9 (smallest), 0 for the backend default
+ * @param allocator Allocator for the output and the backend's state
+ * @param out_data Receives the compressed data, freed with allocator
+ * @param out_len Receives the compressed length
+ * @return PSD_OK on success, PSD_ERR_OUT_OF_MEMORY, or
+ *         PSD_ERR_UNSUPPORTED_COMPRESSION if zlib not available at build time
+ */
+PSD_INTERNAL psd_status_t psd_zip_compress(
+    const uint8_t *src,
+    size_t src_len,
+    int level,
+    const psd_allocator_t *allocator,
+    uint8_t **out_data,
+    size_t *out_len);
 
 #endif /* PSD_ZIP_H */
@@ -10,6 +10,30 @@ int main(void)
     failures += run_background_layer_tests();
     failures += run_text_layer_tests();
     failures += run_color_mode_tests();
+    failures += run_stream_tests();
+    failures += run_parse_option_tests();
+    failures += run_composite_tests();
+    failures += run_render_tests();
+    failures += run_decode_all_tests();
+    failures += run_allocator_tests();
+    failures += run_decode_cache_tests();
+    failures += run_decode_into_tests();
+    failures += run_flatten_tests();
+    failures += run_composite_cache_tests();
+    failures += run_thumbnail_tests();
+    failures += run_render_scaled_tests();
+    failures += run_layout_index_tests();
+    failures += run_batch_tests();
+    failures += run_stats_tests();
+    failures += run_layer_names_tests();
+    failures += run_engine_data_tests();
+    failures += run_tagged_blocks_tests();
+    failures += run_layer_content_tests();
+    failures += run_writer_tests();
+    failures += run_push_parser_tests();
+    failures += run_shared_document_tests();
+    failures += run_embedded_file_tests();
+    failures += run_layer_fingerprint_tests();
 
     if (failures == 0) {
         printf("\n========================================\n");
@@ -5,6 +5,30 @@ int run_basic_tests(void);
 int run_background_layer_tests(void);
 int run_text_layer_tests(void);
 int run_color_mode_tests(void);
+int run_stream_tests(void);
+int run_parse_option_tests(void);
+int run_composite_tests(void);
+int run_render_tests(void);
+int run_decode_all_tests(void);
+int run_allocator_tests(void);
+int run_decode_cache_tests(void);
+int run_decode_into_tests(void);
+int run_flatten_tests(void);
+int run_composite_cache_tests(void);
+int run_thumbnail_tests(void);
+int run_render_scaled_tests(void);
+int run_layout_index_tests(void);
+int run_batch_tests(void);
+int run_stats_tests(void);
+int run_layer_names_tests(void);
+int run_engine_data_tests(void);
+int run_tagged_blocks_tests(void);
+int run_layer_content_tests(void);
+int run_writer_tests(void);
+int run_push_parser_tests(void);
+int run_shared_document_tests(void);
+int run_embedded_file_tests(void);
+int run_layer_fingerprint_tests(void);
 
 #endif /* OPENPSD_TESTS_H */
 
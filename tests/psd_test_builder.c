@@ -0,0 +1,484 @@
+/**
+ * @file psd_test_builder.c
+ * @brief Synthetic PSD/PSB documents for tests
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t cap;
+    bool failed;
+} tb_buf_t;
+
+static void tb_put(tb_buf_t *b, const void *src, size_t n)
+{
+    if (b->failed) return;
+    if (b->size + n > b->cap) {
+        size_t cap = b->cap ? b->cap : 1024;
+        while (cap < b->size + n) cap *= 2;
+        uint8_t *p = (uint8_t *)realloc(b->data, cap);
+        if (!p) { b->failed = true; return; }
+        b->data = p;
+        b->cap = cap;
+    }
+    if (n) memcpy(b->data + b->size, src, n);
+    b->size += n;
+}
+
+static void tb_u8(tb_buf_t *b, uint8_t v) { tb_put(b, &v, 1); }
+
+static void tb_be16(tb_buf_t *b, uint16_t v)
+{
+    uint8_t p[2] = { (uint8_t)(v >> 8), (uint8_t)v };
+    tb_put(b, p, 2);
+}
+
+static void tb_be32(tb_buf_t *b, uint32_t v)
+{
+    uint8_t p[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+    tb_put(b, p, 4);
+}
+
+static void tb_be64(tb_buf_t *b, uint64_t v)
+{
+    tb_be32(b, (uint32_t)(v >> 32));
+    tb_be32(b, (uint32_t)v);
+}
+
+static void tb_len(tb_buf_t *b, bool psb, uint64_t v)
+{
+    if (psb) tb_be64(b, v); else tb_be32(b, (uint32_t)v);
+}
+
+static void tb_patch_be32(tb_buf_t *b, size_t at, uint32_t v)
+{
+    if (b->failed) return;
+    b->data[at + 0] = (uint8_t)(v >> 24);
+    b->data[at + 1] = (uint8_t)(v >> 16);
+    b->data[at + 2] = (uint8_t)(v >> 8);
+    b->data[at + 3] = (uint8_t)v;
+}
+
+static void tb_patch_len(tb_buf_t *b, bool psb, size_t at, uint64_t v)
+{
+    if (psb) {
+        tb_patch_be32(b, at, (uint32_t)(v >> 32));
+        tb_patch_be32(b, at + 4, (uint32_t)v);
+    } else {
+        tb_patch_be32(b, at, (uint32_t)v);
+    }
+}
+
+uint8_t psd_test_sample_byte(int32_t channel, uint8_t v, uint32_t k)
+{
+    static const uint8_t masks[4] = { 0x00, 0x5A, 0xA5, 0x3C };
+    if (channel < 0) return v;
+    return (uint8_t)(v ^ masks[k & 3u]);
+}
+
+/* RGB composites keep their alpha in plane 3; other modes have no dedicated
+ * alpha plane here, so every plane gets varying sample data */
+static int32_t tb_composite_channel(const psd_test_doc_spec_t *spec, uint16_t c)
+{
+    return (c == 3 && spec->color_mode == 3) ? -1 : (int32_t)c;
+}
+
+uint8_t psd_test_sample(int32_t layer, int32_t channel, uint32_t x, uint32_t y)
+{
+    if (channel == -1) return 255;
+    return (uint8_t)((x / 4u) * 7u + y * 13u + (uint32_t)(channel + 1) * 31u +
+                     (uint32_t)(layer + 1) * 17u);
+}
+
+/* PackBits-encode one row; returns encoded length */
+static size_t tb_packbits(const uint8_t *src, size_t n, uint8_t *dst)
+{
+    size_t si = 0, di = 0;
+    while (si < n) {
+        size_t run = 1;
+        while (si + run < n && run < 128 && src[si + run] == src[si]) run++;
+        if (run >= 2) {
+            dst[di++] = (uint8_t)(int8_t)(1 - (int)run);
+            dst[di++] = src[si];
+            si += run;
+            continue;
+        }
+        size_t lit = 1;
+        while (si + lit < n && lit < 128) {
+            if (si + lit + 1 < n && src[si + lit] == src[si + lit + 1]) break;
+            lit++;
+        }
+        dst[di++] = (uint8_t)(lit - 1);
+        memcpy(dst + di, src + si, lit);
+        di += lit;
+        si += lit;
+    }
+    return di;
+}
+
+/* DEFLATE made of stored blocks, so no zlib is needed to build it; zlib-wrapped
+ * unless raw is set */
+static void tb_zlib_stored(tb_buf_t *b, const uint8_t *src, size_t n, bool raw)
+{
+    uint32_t s1 = 1, s2 = 0;
+    for (size_t i = 0; i < n; i++) {
+        s1 = (s1 + src[i]) % 65521u;
+        s2 = (s2 + s1) % 65521u;
+    }
+
+    if (!raw) {
+        tb_u8(b, 0x78);
+        tb_u8(b, 0x01);
+    }
+    size_t at = 0;
+    do {
+        size_t len = (n - at > 65535u) ? 65535u : n - at;
+        tb_u8(b, (at + len == n) ? 1 : 0);
+        uint8_t hdr[4] = { (uint8_t)len, (uint8_t)(len >> 8),
+                           (uint8_t)~len, (uint8_t)(~len >> 8) };
+        tb_put(b, hdr, 4);
+        tb_put(b, src + at, len);
+        at += len;
+    } while (at < n);
+    if (!raw) tb_be32(b, (s2 << 16) | s1);
+}
+
+/* Raw big-endian row for one plane */
+static void tb_row(const psd_test_doc_spec_t *spec, int32_t layer, int32_t channel,
+                   uint32_t w, uint32_t y, uint8_t *row)
+{
+    const psd_test_layer_t *info = (spec->layers && layer >= 0) ? &spec->layers[layer] : NULL;
+    const uint32_t bps = spec->depth / 8u;
+    /* Only pattern samples get distinct bytes; solid colors and alpha keep
+     * 0 and 255 at the ends of the range */
+    const bool solid = info && info->solid;
+    for (uint32_t x = 0; x < w; x++) {
+        uint8_t v = (info && info->solid) ? info->color[channel < 0 ? 3 : channel]
+                                          : psd_test_sample(layer, channel, x, y);
+        if (info && info->alpha && channel < 0) v = info->alpha[(size_t)y * w + x];
+        for (uint32_t k = 0; k < bps; k++) {
+            row[(size_t)x * bps + k] = solid ? v : psd_test_sample_byte(channel, v, k);
+        }
+    }
+}
+
+/* Photoshop ZIP prediction of one row: byte deltas, big-endian word deltas,
+ * or for 32-bit samples byte planes (most significant first) then byte deltas */
+static void tb_predict_row(uint8_t *row, size_t row_bytes, size_t bps, uint8_t *tmp)
+{
+    if (bps == 4) {
+        size_t n = row_bytes / 4;
+        for (size_t i = 0; i < n; i++) {
+            for (size_t k = 0; k < 4; k++) tmp[k * n + i] = row[i * 4 + k];
+        }
+        memcpy(row, tmp, row_bytes);
+        bps = 1;
+    }
+    if (bps == 2) {
+        for (size_t i = row_bytes / 2; i-- > 1;) {
+            uint16_t cur = (uint16_t)((row[i * 2] << 8) | row[i * 2 + 1]);
+            uint16_t prev = (uint16_t)((row[i * 2 - 2] << 8) | row[i * 2 - 1]);
+            uint16_t d = (uint16_t)(cur - prev);
+            row[i * 2] = (uint8_t)(d >> 8);
+            row[i * 2 + 1] = (uint8_t)d;
+        }
+    } else {
+        for (size_t i = row_bytes; i-- > 1;) row[i] = (uint8_t)(row[i] - row[i - 1]);
+    }
+}
+
+/* ZIP (2) or ZIP with prediction (3) payload of whole rows */
+static void tb_zip(tb_buf_t *b, const psd_test_doc_spec_t *spec, uint16_t compression,
+                   uint8_t *raw, size_t size, size_t row_bytes)
+{
+    if (compression == 3 && row_bytes > 0) {
+        uint8_t *tmp = (uint8_t *)malloc(row_bytes);
+        if (!tmp) { b->failed = true; return; }
+        for (size_t at = 0; at + row_bytes <= size; at += row_bytes) {
+            tb_predict_row(raw + at, row_bytes, spec->depth / 8u, tmp);
+        }
+        free(tmp);
+    }
+    tb_zlib_stored(b, raw, size, spec->zip_raw_deflate);
+}
+
+/* Encode one w x h plane (payload only, no compression field). RLE planes
+ * carry their own row-count table, as layer channels do. */
+static void tb_plane(tb_buf_t *b, const psd_test_doc_spec_t *spec, uint16_t compression,
+                     int32_t layer, int32_t channel, uint32_t w, uint32_t h)
+{
+    size_t row_bytes = (size_t)w * (spec->depth / 8u);
+    uint8_t *row = (uint8_t *)malloc(row_bytes ? row_bytes : 1);
+    uint8_t *enc = (uint8_t *)malloc(row_bytes * 2 + 16);
+    if (!row || !enc) { b->failed = true; free(row); free(enc); return; }
+
+    if (compression == 1) {
+        size_t counts_at = b->size;
+        for (uint32_t y = 0; y < h; y++) {
+            if (spec->psb) tb_be32(b, 0); else tb_be16(b, 0);
+        }
+        for (uint32_t y = 0; y < h; y++) {
+            tb_row(spec, layer, channel, w, y, row);
+            size_t n = tb_packbits(row, row_bytes, enc);
+            tb_put(b, enc, n);
+            if (b->failed) break;
+            if (spec->psb) {
+                tb_patch_be32(b, counts_at + (size_t)y * 4, (uint32_t)n);
+            } else {
+                b->data[counts_at + (size_t)y * 2] = (uint8_t)(n >> 8);
+                b->data[counts_at + (size_t)y * 2 + 1] = (uint8_t)n;
+            }
+        }
+    } else if (compression >= 2) {
+        tb_buf_t raw = { NULL, 0, 0, false };
+        for (uint32_t y = 0; y < h; y++) {
+            tb_row(spec, layer, channel, w, y, row);
+            tb_put(&raw, row, row_bytes);
+        }
+        if (raw.failed) b->failed = true;
+        else tb_zip(b, spec, compression, raw.data, raw.size, row_bytes);
+        free(raw.data);
+    } else {
+        for (uint32_t y = 0; y < h; y++) {
+            tb_row(spec, layer, channel, w, y, row);
+            tb_put(b, row, row_bytes);
+        }
+    }
+
+    free(row);
+    free(enc);
+}
+
+void psd_test_default_spec(psd_test_doc_spec_t *spec)
+{
+    memset(spec, 0, sizeof(*spec));
+    spec->width = 32;
+    spec->height = 24;
+    spec->depth = 8;
+    spec->channels = 3;
+    spec->color_mode = 3;
+    spec->layer_count = 3;
+    spec->layer_compression = 1;
+    spec->composite_compression = 1;
+}
+
+/* Bounds of layer i: its entry's, or rows [i, height) and columns [i, width) */
+static void tb_layer_bounds(const psd_test_doc_spec_t *spec, uint16_t i, uint32_t *top,
+                            uint32_t *left, uint32_t *bottom, uint32_t *right)
+{
+    const psd_test_layer_t *info = spec->layers ? &spec->layers[i] : NULL;
+    if (info && (info->top | info->left | info->bottom | info->right) != 0) {
+        *top = info->top;
+        *left = info->left;
+        *bottom = info->bottom;
+        *right = info->right;
+        return;
+    }
+    if (info && info->section != 0) {
+        *top = *left = *bottom = *right = 0;
+        return;
+    }
+    *top = i < spec->height ? i : 0;
+    *left = i < spec->width ? i : 0;
+    *bottom = spec->height;
+    *right = spec->width;
+}
+
+uint8_t *psd_test_build_document(const psd_test_doc_spec_t *spec, size_t *out_size)
+{
+    static const int16_t layer_channels[4] = { -1, 0, 1, 2 };
+    tb_buf_t b = { NULL, 0, 0, false };
+    const bool psb = spec->psb;
+
+    /* Header */
+    tb_put(&b, "8BPS", 4);
+    tb_be16(&b, psb ? 2 : 1);
+    for (int i = 0; i < 6; i++) tb_u8(&b, 0);
+    tb_be16(&b, spec->channels);
+    tb_be32(&b, spec->height);
+    tb_be32(&b, spec->width);
+    tb_be16(&b, spec->depth);
+    tb_be16(&b, spec->color_mode);
+
+    /* Color mode data */
+    tb_be32(&b, 0);
+
+    /* Image resources */
+    size_t res_len_at = b.size;
+    tb_be32(&b, 0);
+    for (size_t i = 0; i < spec->resource_count; i++) {
+        const psd_test_resource_t *r = &spec->resources[i];
+        tb_put(&b, "8BIM", 4);
+        tb_be16(&b, r->id);
+        tb_be16(&b, 0); /* empty Pascal name, padded to even */
+        tb_be32(&b, (uint32_t)r->length);
+        tb_put(&b, r->data, r->length);
+        if (r->length & 1u) tb_u8(&b, 0);
+    }
+    tb_patch_be32(&b, res_len_at, (uint32_t)(b.size - res_len_at - 4));
+
+    /* Layer and mask information */
+    size_t section_len_at = b.size;
+    tb_len(&b, psb, 0);
+    size_t layer_info_len_at = b.size;
+    tb_len(&b, psb, 0);
+
+    tb_be16(&b, spec->layer_count);
+
+    size_t *chan_len_at = (size_t *)calloc((size_t)spec->layer_count * 4u + 1u, sizeof(size_t));
+    if (!chan_len_at) { free(b.data); return NULL; }
+
+    for (uint16_t i = 0; i < spec->layer_count; i++) {
+        const psd_test_layer_t *info = spec->layers ? &spec->layers[i] : NULL;
+        uint32_t top, left, bottom, right;
+        tb_layer_bounds(spec, i, &top, &left, &bottom, &right);
+        tb_be32(&b, top);
+        tb_be32(&b, left);
+        tb_be32(&b, bottom);
+        tb_be32(&b, right);
+        tb_be16(&b, 4);
+        for (int c = 0; c < 4; c++) {
+            tb_be16(&b, (uint16_t)layer_channels[c]);
+            chan_len_at[i * 4u + (unsigned)c] = b.size;
+            tb_len(&b, psb, 0);
+        }
+        static const char no_key[4] = { 0, 0, 0, 0 };
+        tb_put(&b, "8BIM", 4);
+        tb_put(&b, (info && memcmp(info->blend_key, no_key, 4) != 0) ? info->blend_key : "norm",
+               4);
+        tb_u8(&b, info ? info->opacity : 255);
+        tb_u8(&b, info ? info->clipping : 0);
+        tb_u8(&b, info ? info->flags : 0);
+        tb_u8(&b, 0);   /* filler */
+
+        char name[32];
+        int name_len = (info && info->name)
+                           ? snprintf(name, sizeof(name), "%s", info->name)
+                           : snprintf(name, sizeof(name), "Layer %u", (unsigned)i);
+        if (name_len >= (int)sizeof(name)) name_len = (int)sizeof(name) - 1;
+        size_t name_total = 1u + (size_t)name_len;
+        size_t name_padded = (name_total + 3u) & ~(size_t)3u;
+        size_t section_len = (info && info->section) ? 16u : 0u;
+        size_t blocks_len = info ? info->blocks_length : 0u;
+        tb_be32(&b, (uint32_t)(4u + 4u + name_padded + section_len + blocks_len));
+        tb_be32(&b, 0); /* layer mask data */
+        tb_be32(&b, 0); /* blending ranges */
+        tb_u8(&b, (uint8_t)name_len);
+        tb_put(&b, name, (size_t)name_len);
+        for (size_t p = name_total; p < name_padded; p++) tb_u8(&b, 0);
+        if (section_len) {
+            tb_put(&b, "8BIMlsct", 8);
+            tb_be32(&b, 4);
+            tb_be32(&b, info->section);
+        }
+        if (blocks_len) {
+            tb_put(&b, info->blocks, blocks_len);
+        }
+    }
+
+    for (uint16_t i = 0; i < spec->layer_count; i++) {
+        uint32_t top, left, bottom, right;
+        tb_layer_bounds(spec, i, &top, &left, &bottom, &right);
+        uint32_t lw = right - left;
+        uint32_t lh = bottom - top;
+        for (int c = 0; c < 4; c++) {
+            size_t start = b.size;
+            tb_be16(&b, spec->layer_compression);
+            tb_plane(&b, spec, spec->layer_compression, (int32_t)i,
+                     layer_channels[c], lw, lh);
+            tb_patch_len(&b, psb, chan_len_at[i * 4u + (unsigned)c], (uint64_t)(b.size - start));
+        }
+    }
+    free(chan_len_at);
+
+    size_t li_start = layer_info_len_at + (psb ? 8u : 4u);
+    if ((b.size - li_start) & 1u) tb_u8(&b, 0);
+    tb_patch_len(&b, psb, layer_info_len_at, (uint64_t)(b.size - li_start));
+
+    tb_be32(&b, 0); /* global layer mask info */
+    if (spec->global_blocks_length) {
+        tb_put(&b, spec->global_blocks, spec->global_blocks_length);
+    }
+    tb_patch_len(&b, psb, section_len_at,
+                 (uint64_t)(b.size - section_len_at - (psb ? 8u : 4u)));
+
+    /* Image data */
+    tb_be16(&b, spec->composite_compression);
+    if (spec->composite_compression == 1) {
+        /* One count table for all planes, then all rows */
+        tb_buf_t rows = { NULL, 0, 0, false };
+        size_t row_bytes = (size_t)spec->width * (spec->depth / 8u);
+        uint8_t *row = (uint8_t *)malloc(row_bytes);
+        uint8_t *enc = (uint8_t *)malloc(row_bytes * 2 + 16);
+        uint16_t count_bytes = spec->composite_count_bytes ? spec->composite_count_bytes
+                                                           : (psb ? 4u : 2u);
+        if (!row || !enc) b.failed = true;
+        for (uint16_t c = 0; c < spec->channels && !b.failed; c++) {
+            int32_t ch = tb_composite_channel(spec, c);
+            for (uint32_t y = 0; y < spec->height; y++) {
+                tb_row(spec, -1, ch, spec->width, y, row);
+                size_t n = tb_packbits(row, row_bytes, enc);
+                if (count_bytes == 4) tb_be32(&b, (uint32_t)n); else tb_be16(&b, (uint16_t)n);
+                tb_put(&rows, enc, n);
+            }
+        }
+        tb_put(&b, rows.data, rows.size);
+        if (rows.failed) b.failed = true;
+        free(rows.data);
+        free(row);
+        free(enc);
+    } else if (spec->composite_compression >= 2) {
+        /* One zlib stream over all planes */
+        tb_buf_t planes = { NULL, 0, 0, false };
+        for (uint16_t c = 0; c < spec->channels; c++) {
+            int32_t ch = tb_composite_channel(spec, c);
+            tb_plane(&planes, spec, 0, -1, ch, spec->width, spec->height);
+        }
+        if (planes.failed) b.failed = true;
+        else tb_zip(&b, spec, spec->composite_compression, planes.data, planes.size,
+                    (size_t)spec->width * (spec->depth / 8u));
+        free(planes.data);
+    } else {
+        size_t plane_bytes = (size_t)spec->width * spec->height * (spec->depth / 8u);
+        for (uint16_t c = 0; c < spec->channels; c++) {
+            if (spec->composite_planes) {
+                tb_put(&b, spec->composite_planes[c], plane_bytes);
+                continue;
+            }
+            int32_t ch = tb_composite_channel(spec, c);
+            tb_plane(&b, spec, 0, -1, ch, spec->width, spec->height);
+        }
+    }
+
+    if (b.failed) {
+        free(b.data);
+        return NULL;
+    }
+    *out_size = b.size;
+    return b.data;
+}
+
+bool psd_test_write_file(const char *path, const uint8_t *data, size_t size)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(data, 1, size, f) == size;
+    if (fclose(f) != 0) ok = false;
+    return ok;
+}
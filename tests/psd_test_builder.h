@@ -0,0 +1,127 @@
+/**
+ * @file psd_test_builder.h
+ * @brief Synthetic PSD/PSB documents for tests
+ *
+ * Builds small, fully deterministic documents in memory so tests do not
+ * depend on the binary samples being present.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#ifndef PSD_TEST_BUILDER_H
+#define PSD_TEST_BUILDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief One image resource block to embed
+ */
+typedef struct {
+    uint16_t id;
+    const uint8_t *data;
+    size_t length;
+} psd_test_resource_t;
+
+/**
+ * @brief Per-layer record fields, for documents that need more than defaults
+ */
+typedef struct {
+    char blend_key[4];      /**< e.g. "mul "; all zero = "norm" */
+    uint8_t opacity;
+    uint8_t clipping;       /**< 1 = clipped to the layer below */
+    uint8_t flags;          /**< Bit 1 set = hidden */
+    uint8_t section;        /**< lsct type: 0 = none, 1 = open folder, 3 = divider */
+    bool solid;             /**< Every pixel is color (alpha = color[3]) */
+    uint8_t color[4];
+    const uint8_t *alpha;   /**< Alpha plane, one byte per pixel of the layer bounds; NULL = default */
+    uint32_t top, left, bottom, right; /**< All zero = the default geometry */
+    const char *name;       /**< Pascal name (up to 31 bytes); NULL = "Layer <i>" */
+    const uint8_t *blocks;  /**< Extra tagged blocks ("8BIM" key length data), written verbatim */
+    size_t blocks_length;
+} psd_test_layer_t;
+
+/**
+ * @brief Description of a synthetic document
+ *
+ * Layer i covers rows [i, height) and columns [i, width) and has channels
+ * -1 (alpha), 0, 1, 2. Sample values come from psd_test_sample(). With
+ * layers set, each layer's record fields and geometry come from its entry.
+ */
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint16_t depth;                 /**< 8, 16 or 32 (see psd_test_sample_byte()) */
+    uint16_t channels;              /**< Composite channel count (3 = RGB) */
+    uint16_t color_mode;            /**< Header color mode (3 = RGB) */
+    uint16_t layer_count;
+    uint16_t layer_compression;     /**< 0 = RAW, 1 = RLE, 2 = ZIP, 3 = ZIP with prediction */
+    uint16_t composite_compression; /**< As layer_compression; ZIP uses stored blocks */
+    uint16_t composite_count_bytes; /**< RLE row count width, 0 = 2 (PSD) / 4 (PSB) */
+    bool zip_raw_deflate;           /**< Write ZIP data without the zlib wrapper */
+    bool psb;
+    const psd_test_resource_t *resources;
+    size_t resource_count;
+    const psd_test_layer_t *layers; /**< layer_count entries, or NULL */
+    const uint8_t *const *composite_planes; /**< RAW composite only: channels planes of
+                                                 big-endian samples written verbatim; NULL = pattern */
+    const uint8_t *global_blocks;   /**< Tagged blocks after the global layer mask info, written verbatim */
+    size_t global_blocks_length;
+} psd_test_doc_spec_t;
+
+/**
+ * @brief Deterministic 8-bit sample value
+ *
+ * @param layer Layer index, or -1 for the composite
+ * @param channel Channel id (-1 = alpha)
+ * @param x Column relative to the layer/composite origin
+ * @param y Row relative to the layer/composite origin
+ */
+uint8_t psd_test_sample(int32_t layer, int32_t channel, uint32_t x, uint32_t y);
+
+/**
+ * @brief Byte k (0 = most significant) of a big-endian 16- or 32-bit sample
+ *
+ * Each byte differs from the others, so byte-order and lane-order bugs show
+ * up in the decoded value: a 16-bit sample is (v << 8) | (v ^ 0x5A), a
+ * 32-bit one v, v ^ 0x5A, v ^ 0xA5, v ^ 0x3C. Byte 0 is always v. Alpha
+ * (channel -1) repeats v in every byte, as do solid layers, so 0 and 255
+ * stay fully transparent and fully opaque.
+ *
+ * @param channel Channel id the sample belongs to
+ * @param v 8-bit value from psd_test_sample() (or a layer's alpha plane)
+ * @param k Byte index
+ */
+uint8_t psd_test_sample_byte(int32_t channel, uint8_t v, uint32_t k);
+
+/**
+ * @brief Build a document in memory
+ *
+ * @param spec Document description
+ * @param out_size Receives the document size in bytes
+ * @return malloc'd bytes (free with free()), NULL on failure
+ */
+uint8_t *psd_test_build_document(const psd_test_doc_spec_t *spec, size_t *out_size);
+
+/**
+ * @brief Fill a spec with defaults: 32x24 RGB 8-bit, 3 RLE layers, RLE composite
+ */
+void psd_test_default_spec(psd_test_doc_spec_t *spec);
+
+/**
+ * @brief Write bytes to a file
+ *
+ * @return true on success
+ */
+bool psd_test_write_file(const char *path, const uint8_t *data, size_t size);
+
+#endif /* PSD_TEST_BUILDER_H */
@@ -0,0 +1,177 @@
+/**
+ * @file test_allocator.c
+ * @brief Tests for how documents use the caller's allocator
+ *
+ * Metadata of large layer trees comes from a per-document arena, so parsing
+ * makes few calls into the caller's allocator, and every block is returned by
+ * psd_document_free(), also when parsing fails half way.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+/* Counts calls and live blocks; fails every allocation after fail_after */
+typedef struct {
+    long calls;
+    long live;
+    long fail_after;   /* -1 = never fail */
+} counting_state_t;
+
+static void *counting_malloc(size_t size, void *user_data)
+{
+    counting_state_t *state = (counting_state_t *)user_data;
+    if (state->fail_after >= 0 && state->calls >= state->fail_after) return NULL;
+    state->calls++;
+    void *p = malloc(size ? size : 1);
+    if (p) state->live++;
+    return p;
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *user_data)
+{
+    counting_state_t *state = (counting_state_t *)user_data;
+    if (state->fail_after >= 0 && state->calls >= state->fail_after) return NULL;
+    state->calls++;
+    void *p = realloc(ptr, size ? size : 1);
+    if (p && !ptr) state->live++;
+    return p;
+}
+
+static void counting_free(void *ptr, void *user_data)
+{
+    if (ptr) ((counting_state_t *)user_data)->live--;
+    free(ptr);
+}
+
+/* Many layers: their metadata costs a handful of allocator calls */
+static void test_large_layer_tree(void)
+{
+    fprintf(stdout, "\n=== Test: metadata of a large layer tree ===\n");
+
+    static const uint8_t resource_data[40] = { 1, 2, 3 };
+    psd_test_resource_t resources[2] = {
+        { 1005, resource_data, sizeof(resource_data) },
+        { 1039, resource_data, 12 },
+    };
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = 301;
+    spec.height = 301;
+    spec.layer_count = 300;
+    spec.layer_compression = 1;
+    spec.composite_compression = 0;
+    spec.resources = resources;
+    spec.resource_count = 2;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+
+    counting_state_t state = { 0, 0, -1 };
+    psd_allocator_t alloc = { counting_malloc, counting_realloc, counting_free, &state };
+    psd_parse_options_t options = { PSD_PARSE_SKIP_LAYER_PIXELS | PSD_PARSE_SKIP_COMPOSITE };
+    psd_document_t *doc = stream ? psd_parse_with_options(stream, &alloc, &options, NULL) : NULL;
+    ASSERT_TRUE(doc != NULL, "300-layer document parsed");
+
+    int32_t count = 0;
+    const uint8_t *name = NULL;
+    size_t name_length = 0;
+    bool names_ok = doc && psd_document_get_layer_count(doc, &count) == PSD_OK &&
+                    count == (int32_t)spec.layer_count;
+    for (int32_t i = 0; names_ok && i < count; i++) {
+        char want[32];
+        int want_len = snprintf(want, sizeof(want), "Layer %d", (int)i);
+        names_ok = psd_document_get_layer_name(doc, i, &name, &name_length) == PSD_OK &&
+                   name_length == (size_t)want_len && memcmp(name, want, name_length) == 0;
+    }
+    ASSERT_TRUE(names_ok, "layer names read back");
+
+    size_t index = 0;
+    uint16_t id = 0;
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    ASSERT_TRUE(doc && psd_document_find_resource(doc, 1005, &index) == PSD_OK &&
+                psd_document_get_resource(doc, index, &id, &data, &length) == PSD_OK &&
+                length == sizeof(resource_data) && data[2] == 3,
+                "resources read back");
+
+    /* One call per layer would be at least 3 * 300 */
+    ASSERT_TRUE(state.calls < 32, "layer metadata comes from a few arena chunks");
+
+    psd_document_free(doc);
+    ASSERT_TRUE(state.live == 0, "document free releases every block");
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+/* Running out of memory at any point of a parse leaks nothing */
+static void test_allocation_failures(void)
+{
+    fprintf(stdout, "\n=== Test: allocation failures while parsing ===\n");
+
+    static const uint8_t resource_data[6] = { 9, 8, 7, 6, 5, 4 };
+    psd_test_resource_t resource = { 1005, resource_data, sizeof(resource_data) };
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.resources = &resource;
+    spec.resource_count = 1;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+
+    bool leaked = false;
+    bool parsed = false;
+    for (long fail_after = 0; fail_after < 64 && bytes && !parsed; fail_after++) {
+        psd_stream_t *stream = psd_stream_create_buffer(NULL, bytes, size);
+        counting_state_t state = { 0, 0, fail_after };
+        psd_allocator_t alloc = { counting_malloc, counting_realloc, counting_free, &state };
+        psd_document_t *doc = stream ? psd_parse(stream, &alloc) : NULL;
+        parsed = doc != NULL;
+        psd_document_free(doc);
+        psd_stream_destroy(stream);
+        if (state.live != 0) leaked = true;
+    }
+    ASSERT_TRUE(parsed, "parse succeeds once enough memory is available");
+    ASSERT_TRUE(!leaked, "failed parses leak nothing");
+
+    free(bytes);
+}
+
+int run_allocator_tests(void)
+{
+    fprintf(stdout, "=== Allocator tests ===\n");
+
+    test_large_layer_tree();
+    test_allocation_failures();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
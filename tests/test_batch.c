@@ -0,0 +1,283 @@
+/**
+ * @file test_batch.c
+ * @brief Tests for batch document processing
+ *
+ * Every queued document is reported once with the same pixels a direct call
+ * produces, failures are reported per document, and a run keeps no more
+ * documents in flight than max_documents.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+#define DOC_COUNT 10
+#define ITEM_COUNT (DOC_COUNT + 3)
+
+/* Filled in per queue index; each callback writes only its own entry */
+typedef struct {
+    int calls;
+    void *item_data;
+    psd_status_t status;
+    bool had_doc;
+    psd_status_t composite_status;
+    uint8_t *composite;
+    size_t composite_size;
+    uint32_t composite_width;
+    psd_status_t thumbnail_status;
+    uint8_t thumbnail[12];
+} batch_record_t;
+
+static void record_result(void *user_data, const psd_batch_result_t *result)
+{
+    batch_record_t *record = &((batch_record_t *)user_data)[result->index];
+    record->calls++;
+    record->item_data = result->item_data;
+    record->status = result->status;
+    record->had_doc = result->doc != NULL;
+    record->composite_status = result->composite_status;
+    if (result->composite_rgba) {
+        record->composite_size = (size_t)result->composite_width * result->composite_height * 4u;
+        record->composite = (uint8_t *)malloc(record->composite_size);
+        if (record->composite) {
+            memcpy(record->composite, result->composite_rgba, record->composite_size);
+        }
+        record->composite_width = result->composite_width;
+    }
+    record->thumbnail_status = result->thumbnail_status;
+    if (result->thumbnail_rgb && result->thumbnail_width * result->thumbnail_height * 3u <=
+                                     sizeof(record->thumbnail)) {
+        memcpy(record->thumbnail, result->thumbnail_rgb,
+               result->thumbnail_width * result->thumbnail_height * 3u);
+    }
+}
+
+static bool expected_composite(const uint8_t *bytes, size_t size, uint32_t level,
+                               const batch_record_t *record)
+{
+    psd_stream_t *stream = psd_stream_create_buffer(NULL, bytes, size);
+    psd_document_t *doc = psd_parse(stream, NULL);
+    size_t required = 0;
+    bool ok = false;
+    if (doc && psd_document_render_composite_rgba8_scaled(doc, level, NULL, 0, &required, NULL,
+                                                          NULL) == PSD_ERR_BUFFER_TOO_SMALL) {
+        uint8_t *rgba = (uint8_t *)malloc(required);
+        psd_status_t st = rgba ? psd_document_render_composite_rgba8_scaled(
+                                     doc, level, rgba, required, NULL, NULL, NULL)
+                               : PSD_ERR_OUT_OF_MEMORY;
+        /* Same failure (e.g. ZIP without zlib) or the same pixels */
+        ok = st == record->composite_status &&
+             (st != PSD_OK || (record->composite && record->composite_size == required &&
+                               memcmp(rgba, record->composite, required) == 0));
+        free(rgba);
+    }
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    return ok;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+/* Serial caller pool that remembers how many tasks it was asked to run */
+static size_t pool_max_count = 0;
+
+static void serial_parallel_for(void *pool_data, size_t count, psd_task_fn fn, void *task_data)
+{
+    (void)pool_data;
+    if (count > pool_max_count) pool_max_count = count;
+    for (size_t i = 0; i < count; i++) fn(task_data, i);
+}
+
+static void test_batch_run(const psd_thread_pool_t *pool, size_t max_documents)
+{
+    fprintf(stdout, "\n=== Test: batch run (%s pool, %zu in flight) ===\n",
+            pool ? "caller" : "built-in", max_documents);
+
+    /* Raw 2x2 thumbnail on every document */
+    uint8_t thumb[28 + 12];
+    memset(thumb, 0, sizeof(thumb));
+    put_be32(thumb, PSD_THUMBNAIL_RAW_RGB);
+    put_be32(thumb + 4, 2);
+    put_be32(thumb + 8, 2);
+    put_be32(thumb + 12, 6);
+    put_be32(thumb + 16, 12);
+    put_be32(thumb + 20, 12);
+    thumb[25] = 24;
+    thumb[27] = 1;
+    for (int i = 0; i < 12; i++) thumb[28 + i] = (uint8_t)(i * 20);
+    psd_test_resource_t res = { 1036, thumb, sizeof(thumb) };
+
+    uint8_t *bytes[DOC_COUNT];
+    size_t sizes[DOC_COUNT];
+    psd_stream_t *streams[DOC_COUNT];
+    bool built = true;
+    for (int i = 0; i < DOC_COUNT; i++) {
+        psd_test_doc_spec_t spec;
+        psd_test_default_spec(&spec);
+        spec.width = 16u + 7u * (uint32_t)i;
+        spec.height = 12u + 5u * (uint32_t)i;
+        spec.layer_count = (uint16_t)(1 + i % 4);
+        spec.composite_compression = (uint16_t)(i % 3);
+        spec.resources = &res;
+        spec.resource_count = 1;
+        bytes[i] = psd_test_build_document(&spec, &sizes[i]);
+        streams[i] = bytes[i] ? psd_stream_create_buffer(NULL, bytes[i], sizes[i]) : NULL;
+        if (!streams[i]) built = false;
+    }
+    ASSERT_TRUE(built, "build synthetic documents");
+
+    char path[512];
+    (void)snprintf(path, sizeof(path), "%s/openpsd_batch_test.psd", OPENPSD_TEST_OUTPUT_DIR);
+    ASSERT_TRUE(bytes[3] && psd_test_write_file(path, bytes[3], sizes[3]),
+                "write synthetic document");
+    static const uint8_t garbage[64] = { 'n', 'o', 'p', 'e' };
+    psd_stream_t *bad = psd_stream_create_buffer(NULL, garbage, sizeof(garbage));
+
+    batch_record_t records[ITEM_COUNT];
+    memset(records, 0, sizeof(records));
+    psd_batch_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.jobs = PSD_BATCH_COMPOSITE | PSD_BATCH_THUMBNAIL;
+    options.composite_level = 1;
+    options.max_documents = max_documents;
+    options.decode_budget = 4096;
+    options.callback = record_result;
+    options.user_data = records;
+
+    psd_batch_t *batch = NULL;
+    ASSERT_TRUE(psd_batch_create(NULL, &options, &batch) == PSD_OK && batch,
+                "create batch");
+    if (!batch) return;
+
+    static int tags[ITEM_COUNT];
+    bool queued = true;
+    for (int i = 0; i < DOC_COUNT; i++) {
+        if (!streams[i] || psd_batch_add_stream(batch, streams[i], &tags[i]) != PSD_OK) {
+            queued = false;
+        }
+    }
+    queued = queued && psd_batch_add_stream(batch, bad, &tags[DOC_COUNT]) == PSD_OK &&
+             psd_batch_add_file(batch, "/nonexistent/openpsd.psd", &tags[DOC_COUNT + 1]) ==
+                 PSD_OK &&
+             psd_batch_add_file(batch, path, &tags[DOC_COUNT + 2]) == PSD_OK;
+    ASSERT_TRUE(queued, "queue streams and files");
+
+    pool_max_count = 0;
+    ASSERT_TRUE(psd_batch_run(batch, pool) == PSD_OK, "run batch");
+
+    bool once = true;
+    for (int i = 0; i < ITEM_COUNT; i++) {
+        if (records[i].calls != 1 || records[i].item_data != &tags[i]) once = false;
+    }
+    ASSERT_TRUE(once, "every document reported once with its item data");
+
+    bool pixels = true;
+    for (int i = 0; i < DOC_COUNT && built; i++) {
+        if (records[i].status != PSD_OK ||
+            !expected_composite(bytes[i], sizes[i], 1, &records[i])) {
+            pixels = false;
+        }
+    }
+    ASSERT_TRUE(pixels, "composites match direct renders");
+    ASSERT_TRUE(records[DOC_COUNT + 2].status == PSD_OK && bytes[3] &&
+                    expected_composite(bytes[3], sizes[3], 1, &records[DOC_COUNT + 2]),
+                "file item is mapped and rendered");
+
+    ASSERT_TRUE(records[0].thumbnail_status == PSD_OK && records[0].thumbnail[0] == 0 &&
+                    records[0].thumbnail[11] == 220,
+                "thumbnail decoded");
+
+    ASSERT_TRUE(records[DOC_COUNT].status != PSD_OK && !records[DOC_COUNT].had_doc &&
+                    records[DOC_COUNT + 1].status == PSD_ERR_STREAM_INVALID &&
+                    !records[DOC_COUNT + 1].had_doc,
+                "unreadable documents reported without stopping the run");
+
+    if (pool) {
+        ASSERT_TRUE(pool_max_count == max_documents, "no more workers than max_documents");
+    }
+
+    /* The queue is empty again */
+    for (int i = 0; i < ITEM_COUNT; i++) free(records[i].composite);
+    memset(records, 0, sizeof(records));
+    ASSERT_TRUE(psd_batch_run(batch, pool) == PSD_OK && records[0].calls == 0,
+                "run empties the queue");
+
+    psd_batch_destroy(batch);
+    for (int i = 0; i < DOC_COUNT; i++) {
+        psd_stream_destroy(streams[i]);
+        free(bytes[i]);
+    }
+    psd_stream_destroy(bad);
+    (void)remove(path);
+}
+
+static void test_batch_errors(void)
+{
+    fprintf(stdout, "\n=== Test: batch argument checks ===\n");
+
+    psd_batch_options_t options;
+    memset(&options, 0, sizeof(options));
+    psd_batch_t *batch = NULL;
+    ASSERT_TRUE(psd_batch_create(NULL, &options, &batch) == PSD_ERR_INVALID_ARGUMENT &&
+                    batch == NULL,
+                "callback is required");
+    ASSERT_TRUE(psd_batch_create(NULL, NULL, &batch) == PSD_ERR_NULL_POINTER,
+                "NULL options rejected");
+
+    options.callback = record_result;
+    ASSERT_TRUE(psd_batch_create(NULL, &options, &batch) == PSD_OK, "create batch");
+    ASSERT_TRUE(psd_batch_add_stream(batch, NULL, NULL) == PSD_ERR_NULL_POINTER &&
+                    psd_batch_add_file(batch, NULL, NULL) == PSD_ERR_NULL_POINTER &&
+                    psd_batch_run(NULL, NULL) == PSD_ERR_NULL_POINTER,
+                "NULL arguments rejected");
+    ASSERT_TRUE(psd_batch_run(batch, NULL) == PSD_OK, "empty run is a no-op");
+    psd_batch_destroy(batch);
+    psd_batch_destroy(NULL);
+}
+
+int run_batch_tests(void)
+{
+    fprintf(stdout, "=== Batch tests ===\n");
+
+    psd_thread_pool_t pool = { serial_parallel_for, NULL };
+    test_batch_run(NULL, 0);
+    test_batch_run(NULL, 3);
+    test_batch_run(&pool, 2);
+    test_batch_errors();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,548 @@
+/**
+ * @file test_composite.c
+ * @brief Tests for composite image loading
+ *
+ * Verifies the lazily decoded composite against the synthetic document's
+ * known samples for each supported compression, depth and file version.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef OPENPSD_TEST_OUTPUT_DIR
+#define OPENPSD_TEST_OUTPUT_DIR "."
+#endif
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+/* Check planar composite samples against psd_test_sample() */
+static bool composite_matches_spec(const psd_test_doc_spec_t *spec,
+                                   const uint8_t *data, uint64_t length)
+{
+    size_t bps = spec->depth / 8u;
+    size_t plane = (size_t)spec->width * spec->height * bps;
+    if (!data || length != plane * spec->channels) return false;
+
+    for (uint16_t c = 0; c < spec->channels; c++) {
+        int32_t ch = (c == 3) ? -1 : (int32_t)c;
+        for (uint32_t y = 0; y < spec->height; y++) {
+            for (uint32_t x = 0; x < spec->width; x++) {
+                uint8_t expected = psd_test_sample(-1, ch, x, y);
+                const uint8_t *p = data + c * plane + ((size_t)y * spec->width + x) * bps;
+                for (size_t k = 0; k < bps; k++) {
+                    if (p[k] != psd_test_sample_byte(ch, expected, (uint32_t)k)) return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static void check_variant(uint16_t compression, uint16_t depth, bool psb)
+{
+    char msg[128];
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.composite_compression = compression;
+    spec.depth = depth;
+    spec.psb = psb;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+
+    /* Parsing must have taken everything it needs from the stream */
+    psd_stream_destroy(stream);
+
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    uint32_t comp = 99;
+    psd_status_t st = doc ? psd_document_get_composite_image(doc, &data, &length, &comp)
+                          : PSD_ERR_NULL_POINTER;
+
+    (void)snprintf(msg, sizeof(msg), "%s %u-bit %s composite decodes on demand",
+                   psb ? "PSB" : "PSD", (unsigned)depth, compression ? "RLE" : "RAW");
+    ASSERT_TRUE(st == PSD_OK && comp == compression &&
+                composite_matches_spec(&spec, data, length), msg);
+
+    /* Repeat access returns the same decoded buffer */
+    const uint8_t *again = NULL;
+    if (doc) psd_document_get_composite_image(doc, &again, NULL, NULL);
+    (void)snprintf(msg, sizeof(msg), "%s %u-bit %s composite decoded once",
+                   psb ? "PSB" : "PSD", (unsigned)depth, compression ? "RLE" : "RAW");
+    ASSERT_TRUE(data && again == data, msg);
+
+    psd_document_free(doc);
+    free(bytes);
+}
+
+static void test_compressions(void)
+{
+    fprintf(stdout, "\n=== Test: composite compression variants ===\n");
+
+    for (uint16_t compression = 0; compression <= 1; compression++) {
+        check_variant(compression, 8, false);
+        check_variant(compression, 16, false);
+        check_variant(compression, 8, true);
+        check_variant(compression, 16, true);
+    }
+}
+
+/* Big enough for the RLE rows to be split over worker threads */
+static void check_large_rle(uint32_t width, uint32_t height, uint16_t depth, bool psb)
+{
+    char msg[128];
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = width;
+    spec.height = height;
+    spec.channels = 4;
+    spec.depth = depth;
+    spec.psb = psb;
+    spec.layer_count = 0;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    psd_status_t st = doc ? psd_document_get_composite_image(doc, &data, &length, NULL)
+                          : PSD_ERR_NULL_POINTER;
+    (void)snprintf(msg, sizeof(msg), "%s %ux%u %u-bit RLE composite decodes in chunks",
+                   psb ? "PSB" : "PSD", (unsigned)width, (unsigned)height, (unsigned)depth);
+    ASSERT_TRUE(st == PSD_OK && composite_matches_spec(&spec, data, length), msg);
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_large_rle_composites(void)
+{
+    fprintf(stdout, "\n=== Test: large RLE composites ===\n");
+
+    check_large_rle(1024, 1024, 8, false);
+    check_large_rle(1000, 613, 16, true);
+}
+
+/* ZIP composites inflate while parsing from a buffer, lazily from a mapping */
+/* Whether ZIP data decodes: built-in backend or a test codec */
+#ifdef OPENPSD_TEST_HAVE_ZIP
+static bool zip_decodes = true;
+#else
+static bool zip_decodes = false;
+#endif
+
+static void check_zip(uint32_t width, uint32_t height, uint16_t depth,
+                      uint16_t compression, bool mapped, bool raw_deflate)
+{
+    char msg[128];
+    char label[80];
+    (void)snprintf(label, sizeof(label), "%ux%u %u-bit %s%s composite%s",
+                   (unsigned)width, (unsigned)height, (unsigned)depth,
+                   compression == 3 ? "ZIP_PRED" : "ZIP", raw_deflate ? " raw" : "",
+                   mapped ? " (mmap)" : "");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = width;
+    spec.height = height;
+    spec.depth = depth;
+    spec.channels = 4;
+    spec.layer_count = 0;
+    spec.composite_compression = compression;
+    spec.zip_raw_deflate = raw_deflate;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    char path[512];
+    (void)snprintf(path, sizeof(path), "%s/openpsd_zip_test.psd", OPENPSD_TEST_OUTPUT_DIR);
+    psd_stream_t *stream = NULL;
+    if (bytes && mapped) {
+        stream = psd_test_write_file(path, bytes, size) ? psd_stream_create_file_mmap(NULL, path)
+                                                        : NULL;
+    } else if (bytes) {
+        stream = psd_stream_create_buffer(NULL, bytes, size);
+    }
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+    psd_stream_destroy(stream);
+    (void)snprintf(msg, sizeof(msg), "%s: document parsed", label);
+    ASSERT_TRUE(doc != NULL, msg);
+
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    uint32_t comp = 99;
+    psd_status_t st = doc ? psd_document_get_composite_image(doc, &data, &length, &comp)
+                          : PSD_ERR_NULL_POINTER;
+    if (zip_decodes) {
+        (void)snprintf(msg, sizeof(msg), "%s: decodes", label);
+        ASSERT_TRUE(st == PSD_OK && comp == compression &&
+                    composite_matches_spec(&spec, data, length), msg);
+
+        /* Known answer: plane 0 at x = 4, sample 0x26 from the builder */
+        static const uint8_t want[4] = { 0x26, 0x7C, 0x83, 0x1A };
+        size_t bps = depth / 8u;
+        (void)snprintf(msg, sizeof(msg), "%s: pixel 4 holds bytes 26 7C 83 1A", label);
+        ASSERT_TRUE(data && memcmp(data + 4u * bps, want, bps) == 0, msg);
+    } else {
+        (void)snprintf(msg, sizeof(msg), "%s: absent without zlib", label);
+        ASSERT_TRUE(st == PSD_OK && data == NULL, msg);
+    }
+
+    psd_document_free(doc);
+    free(bytes);
+    if (mapped) (void)remove(path);
+}
+
+static void test_zip_composites(void)
+{
+    fprintf(stdout, "\n=== Test: ZIP composites ===\n");
+
+    for (uint16_t compression = 2; compression <= 3; compression++) {
+        check_zip(32, 24, 8, compression, false, false);
+        check_zip(32, 24, 16, compression, false, false);
+        check_zip(37, 24, 32, compression, false, false);
+        check_zip(32, 24, 8, compression, true, false);
+        check_zip(37, 24, 16, compression, true, false);
+        check_zip(32, 24, 8, compression, false, true);
+        check_zip(32, 24, 16, compression, true, true);
+        /* Several input windows and stored blocks */
+        check_zip(700, 500, 8, compression, false, false);
+        check_zip(300, 250, 16, compression, true, false);
+        check_zip(301, 250, 32, compression, false, true);
+    }
+
+    /* Truncated data leaves the composite absent but parses */
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = 700;
+    spec.height = 500;
+    spec.composite_compression = 2;
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size - 1000) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+    const uint8_t *data = (const uint8_t *)bytes;
+    if (doc) psd_document_get_composite_image(doc, &data, NULL, NULL);
+    int32_t layers = 0;
+    if (doc) psd_document_get_layer_count(doc, &layers);
+    ASSERT_TRUE(doc && data == NULL && layers == (int32_t)spec.layer_count,
+                "truncated ZIP composite reported as absent");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+typedef struct {
+    size_t calls;
+    size_t zlib_calls;
+} stored_codec_t;
+
+/* Inflates DEFLATE made of stored blocks only, as the test builder writes */
+static psd_status_t stored_inflate(void *codec_data, const uint8_t *src, size_t src_len,
+                                   uint8_t *dst, size_t dst_len, bool zlib_wrapped)
+{
+    stored_codec_t *codec = (stored_codec_t *)codec_data;
+    codec->calls++;
+    size_t pos = 0;
+    size_t out = 0;
+    if (zlib_wrapped) {
+        codec->zlib_calls++;
+        if (src_len < 2 || (src[0] & 0x0F) != 8 || ((src[0] << 8) | src[1]) % 31 != 0) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        pos = 2;
+    }
+    bool final = false;
+    while (!final) {
+        if (src_len - pos < 5 || (src[pos] & 0x06) != 0) return PSD_ERR_CORRUPT_DATA;
+        final = (src[pos] & 1) != 0;
+        size_t len = (size_t)src[pos + 1] | ((size_t)src[pos + 2] << 8);
+        size_t nlen = (size_t)src[pos + 3] | ((size_t)src[pos + 4] << 8);
+        pos += 5;
+        if ((len ^ nlen) != 0xFFFF || len > src_len - pos || len > dst_len - out) {
+            return PSD_ERR_CORRUPT_DATA;
+        }
+        memcpy(dst + out, src + pos, len);
+        pos += len;
+        out += len;
+    }
+    return out == dst_len ? PSD_OK : PSD_ERR_CORRUPT_DATA;
+}
+
+/* Layer channels of a ZIP document hold the builder's sample pattern */
+static bool zip_layers_match(uint16_t compression, bool raw_deflate)
+{
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_compression = compression;
+    spec.composite_compression = 0;
+    spec.zip_raw_deflate = raw_deflate;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+    bool ok = doc != NULL;
+    for (int32_t i = 0; ok && i < (int32_t)spec.layer_count; i++) {
+        uint32_t lw = spec.width - (uint32_t)i;
+        uint32_t lh = spec.height - (uint32_t)i;
+        for (size_t c = 0; ok && c < 4; c++) {
+            int16_t id = 0;
+            const uint8_t *data = NULL;
+            uint64_t length = 0;
+            ok = psd_document_get_layer_channel_data(doc, i, c, &id, &data, &length, NULL) == PSD_OK &&
+                 data && length == (uint64_t)lw * lh;
+            for (uint32_t y = 0; ok && y < lh; y++) {
+                for (uint32_t x = 0; ok && x < lw; x++) {
+                    ok = data[(size_t)y * lw + x] == psd_test_sample(i, id, x, y);
+                }
+            }
+        }
+    }
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+    return ok;
+}
+
+static void test_custom_codec(void)
+{
+    fprintf(stdout, "\n=== Test: custom inflate codec ===\n");
+
+    const char *backend = psd_get_deflate_backend();
+#ifdef OPENPSD_TEST_HAVE_ZIP
+    ASSERT_TRUE(backend && strcmp(backend, "none") != 0, "built-in inflate backend named");
+#else
+    ASSERT_TRUE(backend && strcmp(backend, "none") == 0, "no built-in inflate backend");
+#endif
+
+    psd_codec_t empty = { NULL, NULL };
+    ASSERT_TRUE(psd_set_codec(&empty) == PSD_ERR_INVALID_ARGUMENT, "codec without inflate rejected");
+
+    stored_codec_t state = { 0, 0 };
+    psd_codec_t codec = { stored_inflate, &state };
+    ASSERT_TRUE(psd_set_codec(&codec) == PSD_OK, "custom codec installed");
+
+    bool saved = zip_decodes;
+    zip_decodes = true;
+    for (uint16_t compression = 2; compression <= 3; compression++) {
+        check_zip(32, 24, 8, compression, false, false);
+        check_zip(37, 24, 16, compression, true, false);
+        check_zip(301, 250, 32, compression, false, true);
+    }
+    ASSERT_TRUE(state.calls == 6 && state.zlib_calls == 4,
+                "composites inflated once each by the codec");
+
+    state.calls = 0;
+    ASSERT_TRUE(zip_layers_match(2, false) && zip_layers_match(3, true),
+                "layer channels decode through the codec");
+    ASSERT_TRUE(state.calls > 0, "layer channels inflated by the codec");
+
+    /* Back to the built-in backend (or none) */
+    ASSERT_TRUE(psd_set_codec(NULL) == PSD_OK, "built-in backend restored");
+    zip_decodes = saved;
+    state.calls = 0;
+    check_zip(32, 24, 8, 2, false, false);
+    ASSERT_TRUE(state.calls == 0, "restored backend no longer calls the codec");
+}
+
+/* Row counts of the width the other format uses; trailing bytes optional */
+static void check_count_width(bool psb, uint16_t count_bytes, size_t trailing)
+{
+    char msg[128];
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.psb = psb;
+    spec.composite_count_bytes = count_bytes;
+
+    size_t size = 0;
+    uint8_t *built = psd_test_build_document(&spec, &size);
+    uint8_t *bytes = built ? (uint8_t *)realloc(built, size + trailing) : NULL;
+    if (!bytes) free(built);
+    if (bytes) memset(bytes + size, 0, trailing);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size + trailing) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    psd_status_t st = doc ? psd_document_get_composite_image(doc, &data, &length, NULL)
+                          : PSD_ERR_NULL_POINTER;
+    (void)snprintf(msg, sizeof(msg), "%s with %u-byte RLE counts%s decodes",
+                   psb ? "PSB" : "PSD", (unsigned)count_bytes,
+                   trailing ? " and trailing bytes" : "");
+    ASSERT_TRUE(st == PSD_OK && composite_matches_spec(&spec, data, length), msg);
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_rle_count_widths(void)
+{
+    fprintf(stdout, "\n=== Test: composite RLE count width detection ===\n");
+
+    check_count_width(false, 2, 0);
+    check_count_width(false, 4, 0);
+    check_count_width(true, 4, 0);
+    check_count_width(true, 2, 0);
+    check_count_width(false, 4, 4096);
+    check_count_width(true, 2, 4096);
+}
+
+static void test_render_after_lazy_decode(void)
+{
+    fprintf(stdout, "\n=== Test: render from lazily decoded composite ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+    ASSERT_TRUE(doc != NULL, "parse synthetic document");
+
+    if (doc) {
+        size_t required = 0;
+        psd_status_t st = psd_document_render_composite_rgba8(doc, NULL, 0, &required);
+        ASSERT_TRUE((st == PSD_OK || st == PSD_ERR_BUFFER_TOO_SMALL) &&
+                    required == (size_t)spec.width * spec.height * 4u,
+                    "query composite RGBA size");
+
+        uint8_t *rgba = (uint8_t *)malloc(required);
+        st = rgba ? psd_document_render_composite_rgba8(doc, rgba, required, NULL)
+                  : PSD_ERR_OUT_OF_MEMORY;
+        bool ok = st == PSD_OK;
+        for (uint32_t y = 0; ok && y < spec.height; y++) {
+            for (uint32_t x = 0; ok && x < spec.width; x++) {
+                const uint8_t *px = rgba + ((size_t)y * spec.width + x) * 4u;
+                ok = px[0] == psd_test_sample(-1, 0, x, y) &&
+                     px[1] == psd_test_sample(-1, 1, x, y) &&
+                     px[2] == psd_test_sample(-1, 2, x, y) && px[3] == 255;
+            }
+        }
+        ASSERT_TRUE(ok, "rendered RGBA matches composite samples");
+        free(rgba);
+    }
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_mapped_composite(void)
+{
+    fprintf(stdout, "\n=== Test: composite payload borrowed from mapping ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    ASSERT_TRUE(bytes != NULL, "build synthetic document");
+    if (!bytes) return;
+
+    char path[512];
+    (void)snprintf(path, sizeof(path), "%s/openpsd_composite_test.psd", OPENPSD_TEST_OUTPUT_DIR);
+    ASSERT_TRUE(psd_test_write_file(path, bytes, size), "write synthetic document");
+
+    psd_stream_t *mapped = psd_stream_create_file_mmap(NULL, path);
+    psd_document_t *doc = mapped ? psd_parse(mapped, NULL) : NULL;
+    psd_stream_destroy(mapped);
+    ASSERT_TRUE(doc != NULL, "parse from mmap stream");
+
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    if (doc) psd_document_get_composite_image(doc, &data, &length, NULL);
+    ASSERT_TRUE(composite_matches_spec(&spec, data, length),
+                "composite decodes after stream destroy");
+
+    psd_document_free(doc);
+    free(bytes);
+    (void)remove(path);
+}
+
+static void test_truncated_raw_composite(void)
+{
+    fprintf(stdout, "\n=== Test: truncated RAW composite ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.composite_compression = 0;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    ASSERT_TRUE(bytes != NULL, "build synthetic document");
+    if (!bytes) return;
+
+    /* Drop the last plane: the composite is missing, the layers are not */
+    size_t truncated = size - (size_t)spec.width * spec.height;
+    psd_stream_t *stream = psd_stream_create_buffer(NULL, bytes, truncated);
+    psd_document_t *doc = psd_parse(stream, NULL);
+    ASSERT_TRUE(doc != NULL, "truncated composite does not fail parse");
+
+    if (doc) {
+        const uint8_t *data = (const uint8_t *)bytes;
+        uint64_t length = 1;
+        psd_status_t st = psd_document_get_composite_image(doc, &data, &length, NULL);
+        ASSERT_TRUE(st == PSD_OK && data == NULL && length == 0,
+                    "truncated composite reported as absent");
+
+        int32_t layers = 0;
+        psd_document_get_layer_count(doc, &layers);
+        ASSERT_TRUE(layers == (int32_t)spec.layer_count, "layers still available");
+    }
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+int run_composite_tests(void)
+{
+    fprintf(stdout, "=== Composite tests ===\n");
+
+    test_compressions();
+    test_large_rle_composites();
+    test_rle_count_widths();
+    test_zip_composites();
+    test_custom_codec();
+    test_render_after_lazy_decode();
+    test_mapped_composite();
+    test_truncated_raw_composite();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,305 @@
+/**
+ * @file test_composite_cache.c
+ * @brief Tests for the tiled composite cache
+ *
+ * Cached renders match psd_document_flatten_rgba8() before and after layer
+ * changes, and recomposing after a change reads only the layers from the
+ * changed one's group upward, in the tiles under it.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+/* 3 x 2 tiles of 16, the last column and row partial */
+#define CANVAS_W 40u
+#define CANVAS_H 24u
+#define TILE 16u
+#define LAYER_COUNT 9
+
+static psd_test_layer_t solid(uint8_t r, uint8_t g, uint8_t b, uint8_t a, const char *key,
+                              uint32_t top, uint32_t left, uint32_t bottom, uint32_t right)
+{
+    psd_test_layer_t layer;
+    memset(&layer, 0, sizeof(layer));
+    memcpy(layer.blend_key, key, 4);
+    layer.opacity = 255;
+    layer.solid = true;
+    layer.color[0] = r;
+    layer.color[1] = g;
+    layer.color[2] = b;
+    layer.color[3] = a;
+    layer.top = top;
+    layer.left = left;
+    layer.bottom = bottom;
+    layer.right = right;
+    return layer;
+}
+
+static psd_test_layer_t section(uint8_t type, const char *key)
+{
+    psd_test_layer_t layer;
+    memset(&layer, 0, sizeof(layer));
+    memcpy(layer.blend_key, key, 4);
+    layer.opacity = 255;
+    layer.section = type;
+    return layer;
+}
+
+/* Background, a pass-through group with a layer in the first tile, a layer
+ * on the right edge, then a normal group with a multiply layer at the bottom */
+static void stack_layers(psd_test_layer_t layers[LAYER_COUNT])
+{
+    layers[0] = solid(200, 100, 50, 255, "norm", 0, 0, CANVAS_H, CANVAS_W);
+    layers[1] = section(3, "norm");
+    layers[2] = solid(10, 220, 90, 180, "scrn", 2, 3, 9, 12);
+    layers[3] = section(1, "pass");
+    layers[4] = solid(30, 60, 250, 200, "norm", 0, 34, 10, 40);
+    layers[5] = section(3, "norm");
+    layers[6] = solid(90, 90, 200, 255, "mul ", 18, 20, 24, 40);
+    layers[7] = section(1, "norm");
+    layers[8] = solid(255, 255, 255, 64, "over", 4, 6, 20, 30);
+}
+
+static psd_document_t *build(const psd_test_layer_t *layers, uint32_t flags,
+                             uint8_t **bytes, psd_stream_t **stream)
+{
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = CANVAS_W;
+    spec.height = CANVAS_H;
+    spec.layer_count = LAYER_COUNT;
+    spec.layers = layers;
+
+    size_t size = 0;
+    *bytes = psd_test_build_document(&spec, &size);
+    *stream = *bytes ? psd_stream_create_buffer(NULL, *bytes, size) : NULL;
+    psd_parse_options_t options = { flags };
+    return *stream ? psd_parse_with_options(*stream, NULL, &options, NULL) : NULL;
+}
+
+/* A cached render of rect equals a fresh flatten */
+static bool cache_matches(psd_composite_cache_t *cache, psd_document_t *doc,
+                          const psd_rect_t *rect)
+{
+    uint8_t cached[CANVAS_W * CANVAS_H * 4];
+    uint8_t flat[CANVAS_W * CANVAS_H * 4];
+    memset(cached, 0, sizeof(cached));
+    memset(flat, 0, sizeof(flat));
+    return psd_composite_cache_render(cache, rect, cached, CANVAS_W * 4u) == PSD_OK &&
+           psd_document_flatten_rgba8(doc, rect, flat, CANVAS_W * 4u) == PSD_OK &&
+           memcmp(cached, flat, sizeof(cached)) == 0;
+}
+
+static psd_status_t toggle_hidden(psd_document_t *doc, int32_t index)
+{
+    uint8_t opacity = 0;
+    uint8_t flags = 0;
+    psd_status_t st = psd_document_get_layer_properties(doc, index, &opacity, &flags);
+    if (st != PSD_OK) return st;
+    return psd_document_set_layer_properties(doc, index, opacity, (uint8_t)(flags ^ 0x02u));
+}
+
+static void check_matches_flatten(uint64_t max_bytes, const char *label)
+{
+    char msg[128];
+    psd_test_layer_t layers[LAYER_COUNT];
+    stack_layers(layers);
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(layers, 0, &bytes, &stream);
+    psd_composite_cache_t *cache = NULL;
+    bool ok = doc && psd_composite_cache_create(doc, TILE, max_bytes, &cache) == PSD_OK;
+    (void)snprintf(msg, sizeof(msg), "%s: cache created", label);
+    ASSERT_TRUE(ok, msg);
+    if (!ok) {
+        psd_document_free(doc);
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    (void)snprintf(msg, sizeof(msg), "%s: first render matches flatten", label);
+    ASSERT_TRUE(cache_matches(cache, doc, NULL), msg);
+    psd_rect_t rect = { 5, 7, 21, 37 };
+    (void)snprintf(msg, sizeof(msg), "%s: rect across tiles matches flatten", label);
+    ASSERT_TRUE(cache_matches(cache, doc, &rect), msg);
+
+    /* Each change, then a render, then the next change */
+    static const int32_t changed[] = { 2, 4, 3, 6, 7, 0, 8, 2, 4 };
+    bool all_match = true;
+    for (size_t c = 0; c < sizeof(changed) / sizeof(changed[0]); c++) {
+        all_match = all_match && toggle_hidden(doc, changed[c]) == PSD_OK &&
+                    psd_composite_cache_invalidate_layer(cache, changed[c]) == PSD_OK &&
+                    cache_matches(cache, doc, NULL);
+    }
+    (void)snprintf(msg, sizeof(msg), "%s: visibility changes match flatten", label);
+    ASSERT_TRUE(all_match, msg);
+
+    all_match = psd_document_set_layer_properties(doc, 7, 100, 0) == PSD_OK &&
+                psd_composite_cache_invalidate_layer(cache, 7) == PSD_OK &&
+                cache_matches(cache, doc, NULL) &&
+                psd_document_set_layer_properties(doc, 2, 40, 0) == PSD_OK &&
+                psd_composite_cache_invalidate_layer(cache, 2) == PSD_OK &&
+                cache_matches(cache, doc, &rect);
+    (void)snprintf(msg, sizeof(msg), "%s: opacity changes match flatten", label);
+    ASSERT_TRUE(all_match, msg);
+
+    psd_composite_cache_destroy(cache);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_cache_matches_flatten(void)
+{
+    fprintf(stdout, "\n=== Test: composite cache matches flatten ===\n");
+
+    check_matches_flatten(0, "unlimited snapshots");
+    check_matches_flatten(1, "no room for snapshots");
+}
+
+/* Layer pixels the document holds, after dropping them all */
+static uint64_t release_all(psd_document_t *doc)
+{
+    for (int32_t i = 0; i < LAYER_COUNT; i++) {
+        psd_document_release_layer_pixels(doc, i);
+    }
+    uint64_t usage = 1;
+    psd_document_get_decode_cache_usage(doc, &usage);
+    return usage;
+}
+
+static void test_cache_reads_only_changes(void)
+{
+    fprintf(stdout, "\n=== Test: composite cache reads only what changed ===\n");
+
+    psd_test_layer_t layers[LAYER_COUNT];
+    stack_layers(layers);
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(layers, PSD_PARSE_SKIP_LAYER_PIXELS, &bytes, &stream);
+    psd_composite_cache_t *cache = NULL;
+    uint8_t out[CANVAS_W * CANVAS_H * 4];
+    bool ok = doc && psd_composite_cache_create(doc, TILE, 0, &cache) == PSD_OK &&
+              psd_composite_cache_render(cache, NULL, out, CANVAS_W * 4u) == PSD_OK;
+    ASSERT_TRUE(ok && release_all(doc) == 0, "first render composed");
+
+    uint64_t usage = 1;
+    ok = ok && psd_composite_cache_render(cache, NULL, out, CANVAS_W * 4u) == PSD_OK &&
+         psd_document_get_decode_cache_usage(doc, &usage) == PSD_OK;
+    ASSERT_TRUE(ok && usage == 0, "unchanged tiles read no layer");
+
+    /* Layer 2 sits in a group above the background: its tile restarts from
+     * the snapshot below the group, so only layer 8 above is read again */
+    ok = ok && toggle_hidden(doc, 2) == PSD_OK &&
+         psd_composite_cache_invalidate_layer(cache, 2) == PSD_OK &&
+         psd_composite_cache_render(cache, NULL, out, CANVAS_W * 4u) == PSD_OK &&
+         psd_document_release_layer_pixels(doc, 8) == PSD_OK &&
+         psd_document_get_decode_cache_usage(doc, &usage) == PSD_OK;
+    ASSERT_TRUE(ok && usage == 0, "hiding a layer reads only the layers above it");
+
+    ok = ok && toggle_hidden(doc, 2) == PSD_OK &&
+         psd_composite_cache_invalidate_layer(cache, 2) == PSD_OK &&
+         psd_composite_cache_render(cache, NULL, out, CANVAS_W * 4u) == PSD_OK &&
+         psd_document_get_decode_cache_usage(doc, &usage) == PSD_OK && usage > 0;
+    uint64_t rest = 1;
+    ok = ok && psd_document_release_layer_pixels(doc, 2) == PSD_OK &&
+         psd_document_release_layer_pixels(doc, 8) == PSD_OK &&
+         psd_document_get_decode_cache_usage(doc, &rest) == PSD_OK;
+    ASSERT_TRUE(ok && rest == 0, "showing a layer reads it and the layers above");
+
+    psd_composite_cache_destroy(cache);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_cache_arguments(void)
+{
+    fprintf(stdout, "\n=== Test: composite cache argument checks ===\n");
+
+    psd_test_layer_t layers[LAYER_COUNT];
+    stack_layers(layers);
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(layers, 0, &bytes, &stream);
+    psd_composite_cache_t *cache = NULL;
+    uint8_t out[CANVAS_W * CANVAS_H * 4];
+
+    ASSERT_TRUE(psd_composite_cache_create(NULL, 0, 0, &cache) == PSD_ERR_NULL_POINTER &&
+                psd_composite_cache_create(doc, 0, 0, NULL) == PSD_ERR_NULL_POINTER,
+                "NULL document or result rejected");
+    bool created = doc && psd_composite_cache_create(doc, 0, 0, &cache) == PSD_OK;
+    ASSERT_TRUE(created, "default tile size accepted");
+    ASSERT_TRUE(psd_composite_cache_render(NULL, NULL, out, CANVAS_W * 4u) ==
+                    PSD_ERR_NULL_POINTER &&
+                psd_composite_cache_render(cache, NULL, NULL, CANVAS_W * 4u) ==
+                    PSD_ERR_NULL_POINTER,
+                "NULL cache or output rejected");
+    psd_rect_t outside = { 0, 0, 1, (int32_t)CANVAS_W + 1 };
+    ASSERT_TRUE(created &&
+                psd_composite_cache_render(cache, &outside, out, CANVAS_W * 4u) ==
+                    PSD_ERR_OUT_OF_RANGE &&
+                psd_composite_cache_render(cache, NULL, out, CANVAS_W * 4u - 4u) ==
+                    PSD_ERR_INVALID_ARGUMENT,
+                "bad rect or stride rejected");
+    ASSERT_TRUE(created &&
+                psd_composite_cache_invalidate_layer(cache, -1) == PSD_ERR_OUT_OF_RANGE &&
+                psd_composite_cache_invalidate_layer(cache, LAYER_COUNT) ==
+                    PSD_ERR_OUT_OF_RANGE &&
+                psd_composite_cache_invalidate_layer(NULL, 0) == PSD_ERR_NULL_POINTER,
+                "bad layer index rejected");
+    ASSERT_TRUE(created && psd_composite_cache_invalidate_rect(cache, NULL) == PSD_OK &&
+                    cache_matches(cache, doc, NULL),
+                "render after invalidating everything matches flatten");
+    ASSERT_TRUE(psd_document_set_layer_properties(NULL, 0, 0, 0) == PSD_ERR_NULL_POINTER &&
+                doc && psd_document_set_layer_properties(doc, LAYER_COUNT, 0, 0) ==
+                           PSD_ERR_OUT_OF_RANGE,
+                "set layer properties checks its arguments");
+
+    psd_composite_cache_destroy(cache);
+    psd_composite_cache_destroy(NULL);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+int run_composite_cache_tests(void)
+{
+    fprintf(stdout, "=== Composite cache tests ===\n");
+
+    test_cache_matches_flatten();
+    test_cache_reads_only_changes();
+    test_cache_arguments();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
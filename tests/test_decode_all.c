@@ -0,0 +1,301 @@
+/**
+ * @file test_decode_all.c
+ * @brief Tests for whole-document layer decoding on worker pools
+ *
+ * Decoding every channel up front, on the built-in workers or on a caller
+ * pool, must give the same pixels as decoding each channel on demand, also
+ * when large RLE channels are split into row ranges.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+/* Serial pool that runs tasks back to front and records what it ran */
+typedef struct {
+    size_t calls;
+    size_t tasks;
+    unsigned char seen[64];
+    bool duplicate;
+} recording_pool_t;
+
+static void recording_parallel_for(void *pool_data, size_t count, psd_task_fn fn, void *task_data)
+{
+    recording_pool_t *pool = (recording_pool_t *)pool_data;
+    pool->calls++;
+    pool->tasks += count;
+    for (size_t i = count; i-- > 0;) {
+        if (i < sizeof(pool->seen)) {
+            if (pool->seen[i]) pool->duplicate = true;
+            pool->seen[i] = 1;
+        }
+        fn(task_data, i);
+    }
+}
+
+/* Every channel of every layer holds the builder's sample pattern */
+static bool layer_pixels_match(psd_document_t *doc, const psd_test_doc_spec_t *spec)
+{
+    size_t bps = spec->depth / 8u;
+    for (int32_t i = 0; i < (int32_t)spec->layer_count; i++) {
+        uint32_t lw = spec->width - (uint32_t)i;
+        uint32_t lh = spec->height - (uint32_t)i;
+        for (size_t c = 0; c < 4; c++) {
+            int16_t id = 0;
+            const uint8_t *data = NULL;
+            uint64_t length = 0;
+            if (psd_document_get_layer_channel_data(doc, i, c, &id, &data, &length, NULL) != PSD_OK ||
+                !data || length != (uint64_t)lw * lh * bps) {
+                return false;
+            }
+            for (uint32_t y = 0; y < lh; y++) {
+                for (uint32_t x = 0; x < lw; x++) {
+                    uint8_t want = psd_test_sample(i, id, x, y);
+                    const uint8_t *p = data + ((size_t)y * lw + x) * bps;
+                    for (size_t b = 0; b < bps; b++) {
+                        if (p[b] != psd_test_sample_byte(id, want, (uint32_t)b)) return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static void check_decode_all(uint16_t compression, uint16_t depth, bool psb, uint32_t parse_flags)
+{
+    static const char *const compression_names[] = { "RAW", "RLE", "ZIP", "ZIP_PRED" };
+    char msg[128];
+    char label[64];
+    (void)snprintf(label, sizeof(label), "%s %u-bit %s%s", psb ? "PSB" : "PSD",
+                   (unsigned)depth, compression_names[compression],
+                   parse_flags ? " deferred" : "");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_compression = compression;
+    spec.depth = depth;
+    spec.psb = psb;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *s1 = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_stream_t *s2 = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_parse_options_t options = { parse_flags };
+    psd_document_t *builtin = s1 ? psd_parse_with_options(s1, NULL, &options, NULL) : NULL;
+    psd_document_t *pooled = s2 ? psd_parse_with_options(s2, NULL, &options, NULL) : NULL;
+    (void)snprintf(msg, sizeof(msg), "%s: documents parsed", label);
+    ASSERT_TRUE(builtin && pooled, msg);
+
+    if (builtin && pooled) {
+        psd_status_t st = psd_document_decode_all_layers(builtin, NULL);
+        (void)snprintf(msg, sizeof(msg), "%s: built-in workers decode all layers", label);
+        ASSERT_TRUE(st == PSD_OK && layer_pixels_match(builtin, &spec), msg);
+
+        recording_pool_t record;
+        memset(&record, 0, sizeof(record));
+        psd_thread_pool_t pool = { recording_parallel_for, &record };
+        st = psd_document_decode_all_layers(pooled, &pool);
+        size_t channels = (size_t)spec.layer_count * 4u;
+        (void)snprintf(msg, sizeof(msg), "%s: caller pool runs one task per channel", label);
+        ASSERT_TRUE(st == PSD_OK && record.calls == 1 && record.tasks == channels &&
+                    !record.duplicate, msg);
+        (void)snprintf(msg, sizeof(msg), "%s: caller pool decodes match", label);
+        ASSERT_TRUE(layer_pixels_match(pooled, &spec), msg);
+
+        /* Nothing is left to decode the second time */
+        st = psd_document_decode_all_layers(pooled, &pool);
+        (void)snprintf(msg, sizeof(msg), "%s: repeat call has no work", label);
+        ASSERT_TRUE(st == PSD_OK && record.calls == 1, msg);
+    }
+
+    psd_document_free(builtin);
+    psd_document_free(pooled);
+    psd_stream_destroy(s1);
+    psd_stream_destroy(s2);
+    free(bytes);
+}
+
+static void test_decode_all_layers(void)
+{
+    fprintf(stdout, "\n=== Test: decode all layers ===\n");
+
+#ifdef OPENPSD_TEST_HAVE_ZIP
+    const uint16_t last_compression = 3;
+#else
+    const uint16_t last_compression = 1;
+#endif
+    for (uint16_t compression = 0; compression <= last_compression; compression++) {
+        check_decode_all(compression, 8, false, 0);
+        check_decode_all(compression, 16, false, 0);
+        check_decode_all(compression, 32, false, 0);
+        check_decode_all(compression, 8, true, 0);
+        check_decode_all(compression, 8, false, PSD_PARSE_SKIP_LAYER_PIXELS);
+    }
+}
+
+/* One layer whose channels are big enough to split into row ranges */
+static void test_large_layer(void)
+{
+    fprintf(stdout, "\n=== Test: large RLE layer channels ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = 2048;
+    spec.height = 2049;
+    spec.layer_count = 1;
+    spec.composite_compression = 0;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *s1 = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_stream_t *s2 = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *on_demand = s1 ? psd_parse(s1, NULL) : NULL;
+    psd_document_t *upfront = s2 ? psd_parse(s2, NULL) : NULL;
+
+    ASSERT_TRUE(on_demand && layer_pixels_match(on_demand, &spec),
+                "large channels decode on demand");
+    ASSERT_TRUE(upfront && psd_document_decode_all_layers(upfront, NULL) == PSD_OK &&
+                layer_pixels_match(upfront, &spec),
+                "large channels decode with decode_all_layers");
+
+    psd_document_free(on_demand);
+    psd_document_free(upfront);
+    psd_stream_destroy(s1);
+    psd_stream_destroy(s2);
+    free(bytes);
+}
+
+#ifdef OPENPSD_TEST_HAVE_ZIP
+/* Allocator that counts live blocks */
+static void *counting_malloc(size_t size, void *user_data)
+{
+    void *p = malloc(size);
+    if (p) (*(long *)user_data)++;
+    return p;
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *user_data)
+{
+    void *p = realloc(ptr, size);
+    if (p && !ptr) (*(long *)user_data)++;
+    return p;
+}
+
+static void counting_free(void *ptr, void *user_data)
+{
+    if (ptr) (*(long *)user_data)--;
+    free(ptr);
+}
+
+/* Many small ZIP channels, raw and zlib-wrapped, inflated with the document's allocator */
+static void test_zip_channels(void)
+{
+    fprintf(stdout, "\n=== Test: ZIP layer channels ===\n");
+
+    for (int raw = 0; raw <= 1; raw++) {
+        psd_test_doc_spec_t spec;
+        psd_test_default_spec(&spec);
+        spec.layer_count = 40;
+        spec.width = 48;
+        spec.height = 44;
+        spec.layer_compression = 2;
+        spec.zip_raw_deflate = raw != 0;
+
+        long live = 0;
+        psd_allocator_t alloc = { counting_malloc, counting_realloc, counting_free, &live };
+        size_t size = 0;
+        uint8_t *bytes = psd_test_build_document(&spec, &size);
+        psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+        psd_document_t *doc = stream ? psd_parse(stream, &alloc) : NULL;
+
+        /* Serial pool: the counting allocator is not thread-safe */
+        recording_pool_t record;
+        memset(&record, 0, sizeof(record));
+        psd_thread_pool_t pool = { recording_parallel_for, &record };
+        long before = live;
+        bool ok = doc && psd_document_decode_all_layers(doc, &pool) == PSD_OK &&
+                  layer_pixels_match(doc, &spec);
+        ASSERT_TRUE(ok, raw ? "raw DEFLATE channels decode" : "zlib channels decode");
+        /* Decoded planes plus at least one inflate state kept for reuse;
+         * libdeflate allocates its decompressors itself */
+        if (strcmp(psd_get_deflate_backend(), "libdeflate") != 0) {
+            ASSERT_TRUE(live > before + (long)spec.layer_count * 4,
+                        "inflate states come from the document allocator");
+        }
+
+        psd_document_free(doc);
+        ASSERT_TRUE(live == 0, "document free releases inflate states");
+        psd_stream_destroy(stream);
+        free(bytes);
+    }
+}
+#endif
+
+static void test_decode_all_edge_cases(void)
+{
+    fprintf(stdout, "\n=== Test: decode all layers edge cases ===\n");
+
+    ASSERT_TRUE(psd_document_decode_all_layers(NULL, NULL) == PSD_ERR_NULL_POINTER,
+                "NULL document rejected");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_count = 0;
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+
+    recording_pool_t record;
+    memset(&record, 0, sizeof(record));
+    psd_thread_pool_t pool = { recording_parallel_for, &record };
+    ASSERT_TRUE(doc && psd_document_decode_all_layers(doc, &pool) == PSD_OK && record.calls == 0,
+                "document without layers needs no pool");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+int run_decode_all_tests(void)
+{
+    fprintf(stdout, "=== Decode-all tests ===\n");
+
+    test_decode_all_layers();
+    test_large_layer();
+#ifdef OPENPSD_TEST_HAVE_ZIP
+    test_zip_channels();
+#endif
+    test_decode_all_edge_cases();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
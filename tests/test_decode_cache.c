@@ -0,0 +1,259 @@
+/**
+ * @file test_decode_cache.c
+ * @brief Tests for the decoded layer pixel budget
+ *
+ * Under a budget, least recently used layers give their decoded planes (and
+ * deferred payloads) back and decode again on next use with the same pixels.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+/* Allocator that counts live blocks */
+static void *counting_malloc(size_t size, void *user_data)
+{
+    void *p = malloc(size ? size : 1);
+    if (p) (*(long *)user_data)++;
+    return p;
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *user_data)
+{
+    void *p = realloc(ptr, size ? size : 1);
+    if (p && !ptr) (*(long *)user_data)++;
+    return p;
+}
+
+static void counting_free(void *ptr, void *user_data)
+{
+    if (ptr) (*(long *)user_data)--;
+    free(ptr);
+}
+
+/* Bytes of one decoded plane of layer i */
+static uint64_t plane_bytes(const psd_test_doc_spec_t *spec, int32_t i)
+{
+    return (uint64_t)(spec->width - (uint32_t)i) * (spec->height - (uint32_t)i);
+}
+
+/* Every channel of layer i decodes to the builder's pattern */
+static bool layer_matches(psd_document_t *doc, const psd_test_doc_spec_t *spec, int32_t i)
+{
+    uint32_t lw = spec->width - (uint32_t)i;
+    uint32_t lh = spec->height - (uint32_t)i;
+    for (size_t c = 0; c < 4; c++) {
+        int16_t id = 0;
+        const uint8_t *data = NULL;
+        uint64_t length = 0;
+        if (psd_document_get_layer_channel_data(doc, i, c, &id, &data, &length, NULL) != PSD_OK ||
+            !data || length != (uint64_t)lw * lh) {
+            return false;
+        }
+        for (uint32_t y = 0; y < lh; y++) {
+            for (uint32_t x = 0; x < lw; x++) {
+                if (data[(size_t)y * lw + x] != psd_test_sample(i, id, x, y)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+static psd_document_t *parse_spec(const psd_test_doc_spec_t *spec, uint32_t flags,
+                                  const psd_allocator_t *alloc,
+                                  uint8_t **bytes, psd_stream_t **stream)
+{
+    size_t size = 0;
+    *bytes = psd_test_build_document(spec, &size);
+    *stream = *bytes ? psd_stream_create_buffer(NULL, *bytes, size) : NULL;
+    psd_parse_options_t options = { flags };
+    return *stream ? psd_parse_with_options(*stream, alloc, &options, NULL) : NULL;
+}
+
+static void check_budget(uint32_t flags, const char *label)
+{
+    char msg[128];
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_count = 6;
+
+    long live = 0;
+    psd_allocator_t alloc = { counting_malloc, counting_realloc, counting_free, &live };
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = parse_spec(&spec, flags, &alloc, &bytes, &stream);
+    (void)snprintf(msg, sizeof(msg), "%s: document parsed", label);
+    ASSERT_TRUE(doc != NULL, msg);
+    if (!doc) {
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    /* Room for about two layers' planes */
+    uint64_t budget = plane_bytes(&spec, 0) * 4u * 2u;
+    ASSERT_TRUE(psd_document_set_decode_budget(doc, budget) == PSD_OK, "budget set");
+    long baseline = live;
+
+    bool all_match = true;
+    bool within = true;
+    long most_live = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int32_t i = 0; i < (int32_t)spec.layer_count; i++) {
+            all_match = all_match && layer_matches(doc, &spec, i);
+            uint64_t usage = 0;
+            psd_document_get_decode_cache_usage(doc, &usage);
+            /* The layer just read may exceed what is left of the budget */
+            if (usage > budget + plane_bytes(&spec, i) * 8u) within = false;
+            if (live - baseline > most_live) most_live = live - baseline;
+        }
+    }
+    (void)snprintf(msg, sizeof(msg), "%s: evicted layers decode again", label);
+    ASSERT_TRUE(all_match, msg);
+    (void)snprintf(msg, sizeof(msg), "%s: usage stays near the budget", label);
+    ASSERT_TRUE(within, msg);
+    /* Without eviction 6 layers would keep 24 planes (48 when deferred) */
+    (void)snprintf(msg, sizeof(msg), "%s: released planes go back to the allocator", label);
+    ASSERT_TRUE(most_live <= 16, msg);
+
+    /* A lower budget applies right away */
+    uint64_t usage = 1;
+    ASSERT_TRUE(psd_document_set_decode_budget(doc, 1) == PSD_OK &&
+                psd_document_get_decode_cache_usage(doc, &usage) == PSD_OK && usage == 0,
+                "lower budget releases everything it can");
+    (void)snprintf(msg, sizeof(msg), "%s: pixels come back after lowering the budget", label);
+    ASSERT_TRUE(layer_matches(doc, &spec, 3), msg);
+
+    psd_document_free(doc);
+    ASSERT_TRUE(live == 0, "document free releases cached planes");
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_decode_budget(void)
+{
+    fprintf(stdout, "\n=== Test: decode budget ===\n");
+
+    check_budget(0, "in-memory payloads");
+    check_budget(PSD_PARSE_SKIP_LAYER_PIXELS, "deferred payloads");
+}
+
+static void test_release_layer_pixels(void)
+{
+    fprintf(stdout, "\n=== Test: release layer pixels ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = parse_spec(&spec, PSD_PARSE_SKIP_LAYER_PIXELS, NULL, &bytes, &stream);
+
+    ASSERT_TRUE(psd_document_release_layer_pixels(NULL, 0) == PSD_ERR_NULL_POINTER,
+                "NULL document rejected");
+    ASSERT_TRUE(doc && psd_document_release_layer_pixels(doc, -1) == PSD_ERR_OUT_OF_RANGE &&
+                psd_document_release_layer_pixels(doc, (int32_t)spec.layer_count) ==
+                    PSD_ERR_OUT_OF_RANGE,
+                "bad layer index rejected");
+
+    uint64_t usage = 0;
+    bool decoded = doc && layer_matches(doc, &spec, 0) && layer_matches(doc, &spec, 1);
+    psd_document_get_decode_cache_usage(doc, &usage);
+    /* Decoded planes plus the payloads read from the stream */
+    ASSERT_TRUE(decoded && usage > (plane_bytes(&spec, 0) + plane_bytes(&spec, 1)) * 4u,
+                "decoded layers are accounted");
+
+    uint64_t after = 0;
+    ASSERT_TRUE(doc && psd_document_release_layer_pixels(doc, 0) == PSD_OK &&
+                psd_document_get_decode_cache_usage(doc, &after) == PSD_OK &&
+                after < usage && after > 0,
+                "released layer no longer accounted");
+    ASSERT_TRUE(doc && layer_matches(doc, &spec, 0), "released layer decodes again");
+
+    /* Renders read back released payloads too */
+    size_t size = (size_t)spec.width * spec.height * 4u;
+    uint8_t *before_rgba = (uint8_t *)calloc(size, 1);
+    uint8_t *after_rgba = (uint8_t *)calloc(size, 1);
+    bool rendered = doc && before_rgba && after_rgba &&
+                    psd_document_render_layer_rgba8_rect(doc, 1, NULL, before_rgba,
+                                                         (size_t)(spec.width - 1) * 4u) == PSD_OK &&
+                    psd_document_release_layer_pixels(doc, 1) == PSD_OK &&
+                    psd_document_render_layer_rgba8_rect(doc, 1, NULL, after_rgba,
+                                                         (size_t)(spec.width - 1) * 4u) == PSD_OK &&
+                    memcmp(before_rgba, after_rgba, size) == 0;
+    ASSERT_TRUE(rendered, "render after release matches");
+
+    free(before_rgba);
+    free(after_rgba);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+/* decode_all_layers under a budget keeps only what fits */
+static void test_decode_all_with_budget(void)
+{
+    fprintf(stdout, "\n=== Test: decode all layers under a budget ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_count = 6;
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = parse_spec(&spec, 0, NULL, &bytes, &stream);
+
+    uint64_t budget = plane_bytes(&spec, 0) * 4u;
+    uint64_t usage = 0;
+    bool ok = doc && psd_document_set_decode_budget(doc, budget) == PSD_OK &&
+              psd_document_decode_all_layers(doc, NULL) == PSD_OK &&
+              psd_document_get_decode_cache_usage(doc, &usage) == PSD_OK;
+    ASSERT_TRUE(ok && usage <= budget + plane_bytes(&spec, 0) * 4u, "decoded planes fit the budget");
+
+    bool all_match = ok;
+    for (int32_t i = 0; all_match && i < (int32_t)spec.layer_count; i++) {
+        all_match = layer_matches(doc, &spec, i);
+    }
+    ASSERT_TRUE(all_match, "every layer reads back");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+int run_decode_cache_tests(void)
+{
+    fprintf(stdout, "=== Decode cache tests ===\n");
+
+    test_decode_budget();
+    test_release_layer_pixels();
+    test_decode_all_with_budget();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,257 @@
+/**
+ * @file test_decode_into.c
+ * @brief Tests for decoding layer channels into caller memory
+ *
+ * psd_document_decode_layer_channel_into() writes RAW, RLE and ZIP planes at
+ * the caller's row stride, leaves the bytes between rows alone and keeps no
+ * decoded copy in the document.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+#define PAD 0xA5u
+#define STRIDE_EXTRA 7u
+
+/* Counts allocator calls */
+static void *counting_malloc(size_t size, void *user_data)
+{
+    (*(long *)user_data)++;
+    return malloc(size ? size : 1);
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *user_data)
+{
+    (*(long *)user_data)++;
+    return realloc(ptr, size ? size : 1);
+}
+
+static void counting_free(void *ptr, void *user_data)
+{
+    (void)user_data;
+    free(ptr);
+}
+
+#ifdef OPENPSD_TEST_HAVE_ZIP
+static bool zip_decodes = true;
+#else
+static bool zip_decodes = false;
+#endif
+
+/* Rows of layer i's channel id at stride hold the builder's samples; the
+ * bytes between rows still hold PAD */
+static bool plane_matches(const uint8_t *dst, size_t stride, uint16_t depth,
+                          int32_t i, int16_t id, uint32_t lw, uint32_t lh)
+{
+    size_t bps = depth / 8u;
+    size_t row_bytes = (size_t)lw * bps;
+    for (uint32_t y = 0; y < lh; y++) {
+        const uint8_t *row = dst + (size_t)y * stride;
+        for (uint32_t x = 0; x < lw; x++) {
+            uint8_t want = psd_test_sample(i, id, x, y);
+            for (size_t b = 0; b < bps; b++) {
+                if (row[x * bps + b] != psd_test_sample_byte(id, want, (uint32_t)b)) return false;
+            }
+        }
+        if (y + 1 < lh) {
+            for (size_t b = row_bytes; b < stride; b++) {
+                if (row[b] != PAD) return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void check_decode_into(uint16_t compression, uint16_t depth, uint32_t flags)
+{
+    char msg[128];
+    char label[64];
+    (void)snprintf(label, sizeof(label), "%u-bit compression %u%s", (unsigned)depth,
+                   (unsigned)compression, (flags & PSD_PARSE_SKIP_LAYER_PIXELS) ? " deferred" : "");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.depth = depth;
+    spec.layer_compression = compression;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    long calls = 0;
+    psd_allocator_t alloc = { counting_malloc, counting_realloc, counting_free, &calls };
+    psd_parse_options_t options = { flags };
+    psd_document_t *doc = stream ? psd_parse_with_options(stream, &alloc, &options, NULL) : NULL;
+    (void)snprintf(msg, sizeof(msg), "%s: document parsed", label);
+    ASSERT_TRUE(doc != NULL, msg);
+    if (!doc) {
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    const int32_t layer = 1;
+    uint32_t lw = spec.width - (uint32_t)layer;
+    uint32_t lh = spec.height - (uint32_t)layer;
+    size_t stride = (size_t)lw * (depth / 8u) + STRIDE_EXTRA;
+    size_t plane = stride * lh;
+    uint8_t *dst = (uint8_t *)malloc(plane);
+
+    static const int16_t ids[4] = { -1, 0, 1, 2 };
+    bool all_match = dst != NULL;
+    bool no_alloc = true;
+    psd_status_t status = PSD_OK;
+    for (size_t c = 0; all_match && c < 4; c++) {
+        /* The first pass may set up inflate states and load the payload */
+        for (int pass = 0; pass < 2 && all_match; pass++) {
+            memset(dst, PAD, plane);
+            long before = calls;
+            status = psd_document_decode_layer_channel_into(doc, layer, c, dst, stride);
+            if (pass == 1 && calls != before) no_alloc = false;
+            if (status != PSD_OK) break;
+            all_match = plane_matches(dst, stride, depth, layer, ids[c], lw, lh);
+        }
+    }
+
+    if (compression >= 2 && !zip_decodes) {
+        (void)snprintf(msg, sizeof(msg), "%s: unsupported without zlib", label);
+        ASSERT_TRUE(status == PSD_ERR_UNSUPPORTED_COMPRESSION, msg);
+    } else {
+        (void)snprintf(msg, sizeof(msg), "%s: rows land at the stride", label);
+        ASSERT_TRUE(status == PSD_OK && all_match, msg);
+        /* libdeflate has no streaming output; strided rows go through a
+         * temporary plane */
+        if (compression < 2 || strcmp(psd_get_deflate_backend(), "libdeflate") != 0) {
+            (void)snprintf(msg, sizeof(msg), "%s: decoding allocates nothing", label);
+            ASSERT_TRUE(no_alloc, msg);
+        }
+
+        uint64_t usage = 1;
+        psd_document_get_decode_cache_usage(doc, &usage);
+        (void)snprintf(msg, sizeof(msg), "%s: no decoded copy is kept", label);
+        ASSERT_TRUE((flags & PSD_PARSE_SKIP_LAYER_PIXELS) ? usage > 0 : usage == 0, msg);
+    }
+
+    free(dst);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_decode_into_strides(void)
+{
+    fprintf(stdout, "\n=== Test: decode into caller memory ===\n");
+
+    for (uint16_t compression = 0; compression <= 3; compression++) {
+        check_decode_into(compression, 8, 0);
+        check_decode_into(compression, 16, 0);
+    }
+    check_decode_into(1, 8, PSD_PARSE_SKIP_LAYER_PIXELS);
+    check_decode_into(2, 8, PSD_PARSE_SKIP_LAYER_PIXELS);
+}
+
+/* Planes decoded by get_layer_channel_data are copied at the stride */
+static void test_decode_into_after_decode(void)
+{
+    fprintf(stdout, "\n=== Test: decode into after a lazy decode ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+
+    uint32_t lw = spec.width - 2u;
+    uint32_t lh = spec.height - 2u;
+    size_t stride = lw + STRIDE_EXTRA;
+    uint8_t *dst = (uint8_t *)malloc(stride * lh);
+    const uint8_t *data = NULL;
+    int16_t id = 0;
+    bool ok = doc && dst &&
+              psd_document_get_layer_channel_data(doc, 2, 1, &id, &data, NULL, NULL) == PSD_OK;
+    if (ok) {
+        memset(dst, PAD, stride * lh);
+        ok = psd_document_decode_layer_channel_into(doc, 2, 1, dst, stride) == PSD_OK &&
+             plane_matches(dst, stride, 8, 2, id, lw, lh);
+    }
+    ASSERT_TRUE(ok, "decoded plane copied at the stride");
+
+    free(dst);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_decode_into_arguments(void)
+{
+    fprintf(stdout, "\n=== Test: decode into argument checks ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+    uint8_t dst[32 * 24];
+
+    ASSERT_TRUE(psd_document_decode_layer_channel_into(NULL, 0, 0, dst, 32) ==
+                    PSD_ERR_NULL_POINTER &&
+                psd_document_decode_layer_channel_into(doc, 0, 0, NULL, 32) ==
+                    PSD_ERR_NULL_POINTER,
+                "NULL document or destination rejected");
+    ASSERT_TRUE(doc &&
+                psd_document_decode_layer_channel_into(doc, -1, 0, dst, 32) ==
+                    PSD_ERR_OUT_OF_RANGE &&
+                psd_document_decode_layer_channel_into(doc, (int32_t)spec.layer_count, 0, dst,
+                                                       32) == PSD_ERR_OUT_OF_RANGE &&
+                psd_document_decode_layer_channel_into(doc, 0, 4, dst, 32) ==
+                    PSD_ERR_OUT_OF_RANGE,
+                "bad layer or channel index rejected");
+    ASSERT_TRUE(doc && psd_document_decode_layer_channel_into(doc, 0, 0, dst, 31) ==
+                           PSD_ERR_INVALID_ARGUMENT,
+                "stride shorter than a row rejected");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+int run_decode_into_tests(void)
+{
+    fprintf(stdout, "=== Decode into tests ===\n");
+
+    test_decode_into_strides();
+    test_decode_into_after_decode();
+    test_decode_into_arguments();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
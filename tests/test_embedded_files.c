@@ -0,0 +1,640 @@
+/**
+ * @file test_embedded_files.c
+ * @brief Tests for smart object files embedded in linked layer blocks
+ *
+ * Builds containers whose 'lnk2' block embeds other synthetic documents and
+ * checks that those are found from the layers' SoLd/PlLd blocks and parse
+ * through sub-streams, from buffers, mapped files and custom streams.
+ * Nested documents can be opened, read and freed on several threads while
+ * the parent loads its own deferred pixels.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* pthreads under strict C17 */
+#endif
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(OPENPSD_TEST_HAVE_THREADS)
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+#ifndef OPENPSD_TEST_OUTPUT_DIR
+#define OPENPSD_TEST_OUTPUT_DIR "."
+#endif
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+static const uint8_t fake_png[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n', 0, 0, 0, 13 };
+
+/* Growable byte buffer for hand-written blocks */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} blob_t;
+
+static void blob_put(blob_t *b, const void *data, size_t length)
+{
+    if (b->size + length > b->capacity) {
+        size_t capacity = b->capacity ? b->capacity * 2 : 256;
+        while (capacity < b->size + length) capacity *= 2;
+        uint8_t *grown = (uint8_t *)realloc(b->data, capacity);
+        if (!grown) abort();
+        b->data = grown;
+        b->capacity = capacity;
+    }
+    if (length) memcpy(b->data + b->size, data, length);
+    b->size += length;
+}
+
+static void blob_u8(blob_t *b, uint8_t v) { blob_put(b, &v, 1); }
+
+static void blob_be32(blob_t *b, uint32_t v)
+{
+    uint8_t p[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+    blob_put(b, p, 4);
+}
+
+static void blob_be64(blob_t *b, uint64_t v)
+{
+    blob_be32(b, (uint32_t)(v >> 32));
+    blob_be32(b, (uint32_t)v);
+}
+
+static void blob_patch_be32(blob_t *b, size_t at, uint32_t v)
+{
+    b->data[at] = (uint8_t)(v >> 24);
+    b->data[at + 1] = (uint8_t)(v >> 16);
+    b->data[at + 2] = (uint8_t)(v >> 8);
+    b->data[at + 3] = (uint8_t)v;
+}
+
+static void blob_pad4(blob_t *b, size_t from)
+{
+    while ((b->size - from) & 3u) blob_u8(b, 0);
+}
+
+/* Unicode string: count, UTF-16BE units of an ASCII string, trailing NUL */
+static void blob_unicode(blob_t *b, const char *s)
+{
+    size_t n = strlen(s);
+    blob_be32(b, (uint32_t)n + 1);
+    for (size_t i = 0; i < n; i++) {
+        blob_u8(b, 0);
+        blob_u8(b, (uint8_t)s[i]);
+    }
+    blob_u8(b, 0);
+    blob_u8(b, 0);
+}
+
+static void blob_pascal(blob_t *b, const char *s)
+{
+    blob_u8(b, (uint8_t)strlen(s));
+    blob_put(b, s, strlen(s));
+}
+
+/* Descriptor of class 'null' with 'Idnt' text and a 'Pg  ' long */
+static void blob_descriptor(blob_t *b, const char *id)
+{
+    blob_be32(b, 0);            /* empty class name */
+    blob_be32(b, 0);
+    blob_put(b, "null", 4);
+    blob_be32(b, 2);
+    blob_be32(b, 0);
+    blob_put(b, "Pg  ", 4);
+    blob_put(b, "long", 4);
+    blob_be32(b, 1);
+    blob_be32(b, 0);
+    blob_put(b, "Idnt", 4);
+    blob_put(b, "TEXT", 4);
+    blob_unicode(b, id);
+}
+
+/* One file for a container to embed */
+typedef struct {
+    const char *id;
+    const char *name;
+    const char *type;
+    const uint8_t *data;
+    size_t length;
+    bool placed_by_sold; /* Layer refers to it with SoLd (else PlLd) */
+} embed_t;
+
+/* Container with one smart object layer per file and a plain last layer */
+static uint8_t *build_container(const embed_t *files, size_t count, size_t *out_size)
+{
+    psd_test_layer_t layers[4];
+    blob_t blocks[3];
+    memset(layers, 0, sizeof(layers));
+    memset(blocks, 0, sizeof(blocks));
+    for (size_t i = 0; i < count; i++) {
+        blob_t *b = &blocks[i];
+        size_t len_at = 0;
+        if (files[i].placed_by_sold) {
+            blob_put(b, "8BIMSoLd", 8);
+            len_at = b->size;
+            blob_be32(b, 0);
+            blob_put(b, "soLD", 4);
+            blob_be32(b, 4);
+            blob_be32(b, 16);
+            blob_descriptor(b, files[i].id);
+        } else {
+            blob_put(b, "8BIMPlLd", 8);
+            len_at = b->size;
+            blob_be32(b, 0);
+            blob_put(b, "plcL", 4);
+            blob_be32(b, 3);
+            blob_pascal(b, files[i].id);
+        }
+        blob_pad4(b, len_at + 4);
+        blob_patch_be32(b, len_at, (uint32_t)(b->size - len_at - 4));
+        layers[i].opacity = 255;
+        layers[i].blocks = b->data;
+        layers[i].blocks_length = b->size;
+    }
+    layers[count].opacity = 255;
+
+    /* An unrelated global block first, then the linked layers */
+    blob_t global = { NULL, 0, 0 };
+    blob_put(&global, "8BIMPatt", 8);
+    blob_be32(&global, 4);
+    blob_be32(&global, 0);
+    blob_put(&global, "8BIMlnk2", 8);
+    size_t lnk_len_at = global.size;
+    blob_be32(&global, 0);
+    for (size_t i = 0; i < count; i++) {
+        size_t entry_len_at = global.size;
+        blob_be64(&global, 0);
+        blob_put(&global, "liFD", 4);
+        blob_be32(&global, 7);
+        blob_pascal(&global, files[i].id);
+        blob_unicode(&global, files[i].name);
+        blob_put(&global, files[i].type, 4);
+        blob_put(&global, "8BIM", 4);
+        blob_be64(&global, files[i].length);
+        /* The first file also has a file-open descriptor to step over */
+        blob_u8(&global, i == 0 ? 1 : 0);
+        if (i == 0) {
+            blob_be32(&global, 16);
+            blob_descriptor(&global, "open options");
+        }
+        blob_put(&global, files[i].data, files[i].length);
+        blob_be32(&global, 0);  /* child document ID */
+        blob_be64(&global, 0);  /* asset modification time */
+        blob_u8(&global, 0);    /* asset locked */
+        uint64_t entry_len = global.size - entry_len_at - 8;
+        blob_pad4(&global, entry_len_at + 8);
+        blob_patch_be32(&global, entry_len_at, (uint32_t)(entry_len >> 32));
+        blob_patch_be32(&global, entry_len_at + 4, (uint32_t)entry_len);
+    }
+    blob_patch_be32(&global, lnk_len_at, (uint32_t)(global.size - lnk_len_at - 4));
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_count = (uint16_t)(count + 1);
+    spec.layers = layers;
+    spec.global_blocks = global.data;
+    spec.global_blocks_length = global.size;
+    uint8_t *bytes = psd_test_build_document(&spec, out_size);
+
+    for (size_t i = 0; i < count; i++) free(blocks[i].data);
+    free(global.data);
+    return bytes;
+}
+
+/* Same composite and layer pixels */
+static bool same_rendering(psd_document_t *a, psd_document_t *b)
+{
+    size_t need_a = 0, need_b = 0;
+    if (psd_document_render_composite_rgba8(a, NULL, 0, &need_a) != PSD_ERR_BUFFER_TOO_SMALL ||
+        psd_document_render_composite_rgba8(b, NULL, 0, &need_b) != PSD_ERR_BUFFER_TOO_SMALL ||
+        need_a != need_b) {
+        return false;
+    }
+    uint8_t *pa = (uint8_t *)malloc(need_a);
+    uint8_t *pb = (uint8_t *)malloc(need_a);
+    bool same = pa && pb && psd_document_render_composite_rgba8(a, pa, need_a, NULL) == PSD_OK &&
+                psd_document_render_composite_rgba8(b, pb, need_b, NULL) == PSD_OK &&
+                memcmp(pa, pb, need_a) == 0;
+
+    int32_t count_a = 0, count_b = 0;
+    same = same && psd_document_get_layer_count(a, &count_a) == PSD_OK &&
+           psd_document_get_layer_count(b, &count_b) == PSD_OK && count_a == count_b;
+    for (int32_t i = 0; same && i < count_a; i++) {
+        size_t la = 0, lb = 0;
+        (void)psd_document_render_layer_rgba8(a, i, NULL, 0, &la);
+        (void)psd_document_render_layer_rgba8(b, i, NULL, 0, &lb);
+        if (la != lb || la > need_a) {
+            same = false;
+            break;
+        }
+        same = la == 0 ||
+               (psd_document_render_layer_rgba8(a, i, pa, la, NULL) == PSD_OK &&
+                psd_document_render_layer_rgba8(b, i, pb, lb, NULL) == PSD_OK &&
+                memcmp(pa, pb, la) == 0);
+    }
+    free(pa);
+    free(pb);
+    return same;
+}
+
+static void test_find_embedded_files(void)
+{
+    fprintf(stdout, "\n=== Test: embedded files of smart object layers ===\n");
+
+    psd_test_doc_spec_t inner_spec;
+    psd_test_default_spec(&inner_spec);
+    inner_spec.layer_count = 2;
+    size_t inner_size = 0;
+    uint8_t *inner = psd_test_build_document(&inner_spec, &inner_size);
+    embed_t files[2] = {
+        { "0b5e5f3c-inner", "inner.psd", "8BPS", inner, inner_size, true },
+        { "picture-id", "picture.png", "png ", fake_png, sizeof(fake_png), false },
+    };
+    size_t size = 0;
+    uint8_t *bytes = inner ? build_container(files, 2, &size) : NULL;
+    ASSERT_TRUE(bytes != NULL, "build container");
+    if (!bytes) {
+        free(inner);
+        return;
+    }
+
+    psd_stream_t *stream = psd_stream_create_buffer(NULL, bytes, size);
+    psd_parse_options_t options = { PSD_PARSE_SKIP_LAYER_PIXELS, NULL };
+    psd_document_t *doc = psd_parse_with_options(stream, NULL, &options, NULL);
+    ASSERT_TRUE(doc != NULL, "parse container");
+    if (!doc) {
+        psd_stream_destroy(stream);
+        free(bytes);
+        free(inner);
+        return;
+    }
+
+    psd_embedded_file_t file;
+    memset(&file, 0, sizeof(file));
+    ASSERT_TRUE(psd_document_get_layer_embedded_file(doc, 0, &file) == PSD_OK &&
+                    strcmp(file.unique_id, "0b5e5f3c-inner") == 0 &&
+                    strcmp(file.name, "inner.psd") == 0 && file.file_type == 0x38425053u &&
+                    file.length == inner_size && file.offset + file.length <= size &&
+                    memcmp(bytes + file.offset, inner, inner_size) == 0,
+                "SoLd layer finds its file past the file-open descriptor");
+    ASSERT_TRUE(psd_document_get_layer_embedded_file(doc, 1, &file) == PSD_OK &&
+                    strcmp(file.name, "picture.png") == 0 && file.length == sizeof(fake_png) &&
+                    memcmp(bytes + file.offset, fake_png, sizeof(fake_png)) == 0,
+                "PlLd layer finds its file");
+    ASSERT_TRUE(psd_document_get_layer_embedded_file(doc, 2, &file) == PSD_ERR_INVALID_ARGUMENT &&
+                    psd_document_get_layer_embedded_file(doc, 3, &file) == PSD_ERR_OUT_OF_RANGE &&
+                    psd_document_get_layer_embedded_file(doc, 0, NULL) == PSD_ERR_NULL_POINTER,
+                "plain layers and bad arguments are reported");
+
+    psd_status_t status = PSD_OK;
+    psd_stream_t *png = psd_document_open_embedded_stream(doc, 1, &status);
+    uint8_t head[sizeof(fake_png)];
+    ASSERT_TRUE(png && status == PSD_OK &&
+                    psd_stream_read_exact(png, head, sizeof(head)) == PSD_OK &&
+                    memcmp(head, fake_png, sizeof(head)) == 0 && psd_stream_read(png, head, 1) == 0,
+                "embedded PNG opens as a stream of exactly its bytes");
+    psd_stream_destroy(png);
+    ASSERT_TRUE(psd_document_open_embedded(doc, 1, NULL, &status) == NULL &&
+                    status == PSD_ERR_INVALID_FILE_FORMAT,
+                "a PNG does not parse as a document");
+    ASSERT_TRUE(psd_document_open_embedded(doc, 2, NULL, &status) == NULL &&
+                    status == PSD_ERR_INVALID_ARGUMENT,
+                "a plain layer has no document to open");
+
+    psd_document_t *nested = psd_document_open_embedded(doc, 0, NULL, &status);
+    psd_stream_t *inner_stream = psd_stream_create_buffer(NULL, inner, inner_size);
+    psd_document_t *direct = psd_parse(inner_stream, NULL);
+    ASSERT_TRUE(nested && status == PSD_OK && direct && same_rendering(nested, direct),
+                "nested document renders like the file parsed on its own");
+    psd_document_free(direct);
+    psd_stream_destroy(inner_stream);
+    psd_document_free(nested);
+    psd_document_free(doc);
+
+    /* An eager parse of a buffer keeps no source to read the file from */
+    doc = psd_stream_seek(stream, 0) == 0 ? psd_parse(stream, NULL) : NULL;
+    ASSERT_TRUE(doc && psd_document_get_layer_embedded_file(doc, 0, &file) == PSD_OK &&
+                    psd_document_open_embedded_stream(doc, 0, &status) == NULL &&
+                    status == PSD_ERR_STREAM_INVALID,
+                "eagerly parsed buffer document lists files but cannot open them");
+    psd_document_free(doc);
+
+    psd_stream_destroy(stream);
+    free(bytes);
+    free(inner);
+}
+
+/* Custom stream over memory without positional reads, counting bytes read */
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    size_t position;
+    uint64_t bytes_read;
+} source_t;
+
+static int64_t source_read(psd_stream_t *stream, void *buffer, size_t count, void *user)
+{
+    (void)stream;
+    source_t *src = (source_t *)user;
+    size_t left = src->length - src->position;
+    size_t n = (count < left) ? count : left;
+    memcpy(buffer, src->data + src->position, n);
+    src->position += n;
+    src->bytes_read += n;
+    return (int64_t)n;
+}
+
+static int64_t source_write(psd_stream_t *stream, const void *buffer, size_t count, void *user)
+{
+    (void)stream;
+    (void)buffer;
+    (void)count;
+    (void)user;
+    return PSD_ERR_STREAM_INVALID;
+}
+
+static int64_t source_seek(psd_stream_t *stream, int64_t offset, void *user)
+{
+    (void)stream;
+    source_t *src = (source_t *)user;
+    if (offset < 0 || (uint64_t)offset > src->length) return PSD_ERR_OUT_OF_RANGE;
+    src->position = (size_t)offset;
+    return offset;
+}
+
+static int64_t source_tell(psd_stream_t *stream, void *user)
+{
+    (void)stream;
+    return (int64_t)((source_t *)user)->position;
+}
+
+static const psd_stream_vtable_t source_vtable = {
+    source_read, source_write, source_seek, source_tell, NULL
+};
+
+static void test_nested_levels(void)
+{
+    fprintf(stdout, "\n=== Test: smart objects nested several levels deep ===\n");
+
+    /* Innermost: large RAW layers, so its pixels dominate the file */
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = 512;
+    spec.height = 512;
+    spec.layer_compression = 0;
+    size_t innermost_size = 0;
+    uint8_t *innermost = psd_test_build_document(&spec, &innermost_size);
+    embed_t level2 = { "level-2", "innermost.psd", "8BPS", innermost, innermost_size, true };
+    size_t middle_size = 0;
+    uint8_t *middle = innermost ? build_container(&level2, 1, &middle_size) : NULL;
+    embed_t level1 = { "level-1", "middle.psd", "8BPS", middle, middle_size, false };
+    size_t outer_size = 0;
+    uint8_t *outer = middle ? build_container(&level1, 1, &outer_size) : NULL;
+    ASSERT_TRUE(outer != NULL, "build three nested documents");
+
+    char path[512];
+    (void)snprintf(path, sizeof(path), "%s/openpsd_embedded_test.psd", OPENPSD_TEST_OUTPUT_DIR);
+    bool written = outer && psd_test_write_file(path, outer, outer_size);
+    ASSERT_TRUE(written, "write outer document");
+    psd_stream_t *direct_stream = innermost
+                                      ? psd_stream_create_buffer(NULL, innermost, innermost_size)
+                                      : NULL;
+    psd_document_t *direct = direct_stream ? psd_parse(direct_stream, NULL) : NULL;
+
+    /* Mapped: each level outlives the one it was opened from */
+    psd_stream_t *mapped = written ? psd_stream_create_file_mmap(NULL, path) : NULL;
+    psd_document_t *doc = mapped ? psd_parse(mapped, NULL) : NULL;
+    psd_stream_destroy(mapped);
+    psd_status_t status = PSD_OK;
+    psd_document_t *mid = doc ? psd_document_open_embedded(doc, 0, NULL, &status) : NULL;
+    psd_document_free(doc);
+    psd_document_t *deep = mid ? psd_document_open_embedded(mid, 0, NULL, &status) : NULL;
+    psd_document_free(mid);
+    ASSERT_TRUE(deep && direct && same_rendering(deep, direct),
+                "mapped: innermost document renders after its parents are freed");
+    psd_document_free(deep);
+
+    /* Custom stream: every level reads through the caller's stream */
+    source_t src = { outer, outer_size, 0, 0 };
+    psd_stream_t *stream = outer ? psd_stream_create_custom(NULL, &source_vtable, &src) : NULL;
+    psd_parse_options_t options = { PSD_PARSE_SKIP_LAYER_PIXELS, NULL };
+    doc = stream ? psd_parse_with_options(stream, NULL, &options, NULL) : NULL;
+    uint64_t before = src.bytes_read;
+    mid = doc ? psd_document_open_embedded(doc, 0, NULL, &status) : NULL;
+    deep = mid ? psd_document_open_embedded(mid, 0, NULL, &status) : NULL;
+    uint64_t opening = src.bytes_read - before;
+    ASSERT_TRUE(deep != NULL && opening < innermost_size / 2,
+                "custom stream: opening two levels reads headers, not pixels");
+    ASSERT_TRUE(deep && direct && same_rendering(deep, direct),
+                "custom stream: innermost document renders like the file parsed on its own");
+
+    /* Options are passed through to the nested parse */
+    psd_parse_options_t eager = { 0, NULL };
+    psd_document_t *eager_mid = mid ? psd_document_open_embedded(mid, 0, &eager, &status) : NULL;
+    ASSERT_TRUE(eager_mid && same_rendering(eager_mid, direct),
+                "custom stream: eager nested parse matches too");
+    psd_document_free(eager_mid);
+
+    psd_document_free(deep);
+    psd_document_free(mid);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+
+    psd_document_free(direct);
+    psd_stream_destroy(direct_stream);
+    if (written) (void)remove(path);
+    free(outer);
+    free(middle);
+    free(innermost);
+}
+
+#if defined(OPENPSD_TEST_HAVE_THREADS)
+
+#define OPEN_THREADS 6
+#define OPEN_ROUNDS 4
+
+typedef struct {
+    psd_document_t *doc;           /* Shared parent */
+    psd_document_t *outer;         /* Parent parsed eagerly on its own */
+    psd_document_t *inner;         /* Embedded file parsed eagerly on its own */
+    int index;
+    int mismatches;
+} opener_t;
+
+/* Even threads open, read and free nested documents; odd ones read the
+ * parent, whose deferred loads use the same source */
+static void open_and_read(opener_t *w)
+{
+    for (int round = 0; round < OPEN_ROUNDS; round++) {
+        if (w->index % 2 == 0) {
+            psd_status_t status = PSD_OK;
+            psd_document_t *nested = psd_document_open_embedded(w->doc, 0, NULL, &status);
+            if (!nested || !same_rendering(nested, w->inner)) w->mismatches++;
+            psd_document_free(nested);
+        } else if (!same_rendering(w->doc, w->outer)) {
+            w->mismatches++;
+        }
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI opener_main(LPVOID arg)
+{
+    open_and_read((opener_t *)arg);
+    return 0;
+}
+#else
+static void *opener_main(void *arg)
+{
+    open_and_read((opener_t *)arg);
+    return NULL;
+}
+#endif
+
+/* Race the openers over doc; false if a thread could not start */
+static bool run_openers(psd_document_t *doc, psd_document_t *outer, psd_document_t *inner,
+                        int *mismatches)
+{
+    opener_t workers[OPEN_THREADS];
+#if defined(_WIN32)
+    HANDLE threads[OPEN_THREADS];
+#else
+    pthread_t threads[OPEN_THREADS];
+#endif
+    size_t started = 0;
+    for (; started < OPEN_THREADS; started++) {
+        opener_t w = { doc, outer, inner, (int)started, 0 };
+        workers[started] = w;
+#if defined(_WIN32)
+        threads[started] = CreateThread(NULL, 0, opener_main, &workers[started], 0, NULL);
+        if (!threads[started]) break;
+#else
+        if (pthread_create(&threads[started], NULL, opener_main, &workers[started]) != 0) {
+            break;
+        }
+#endif
+    }
+    for (size_t i = 0; i < started; i++) {
+#if defined(_WIN32)
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+        *mismatches += workers[i].mismatches;
+    }
+    return started == OPEN_THREADS;
+}
+
+static void test_concurrent_opens(void)
+{
+    fprintf(stdout, "\n=== Test: smart objects opened from several threads ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = 96;
+    spec.height = 80;
+    spec.layer_compression = 0;
+    size_t inner_size = 0;
+    uint8_t *inner_bytes = psd_test_build_document(&spec, &inner_size);
+    embed_t file = { "shared", "inner.psd", "8BPS", inner_bytes, inner_size, true };
+    size_t outer_size = 0;
+    uint8_t *outer_bytes = inner_bytes ? build_container(&file, 1, &outer_size) : NULL;
+
+    psd_stream_t *inner_stream = inner_bytes
+                                     ? psd_stream_create_buffer(NULL, inner_bytes, inner_size)
+                                     : NULL;
+    psd_stream_t *outer_stream = outer_bytes
+                                     ? psd_stream_create_buffer(NULL, outer_bytes, outer_size)
+                                     : NULL;
+    psd_document_t *inner = inner_stream ? psd_parse(inner_stream, NULL) : NULL;
+    psd_document_t *outer = outer_stream ? psd_parse(outer_stream, NULL) : NULL;
+    ASSERT_TRUE(inner && outer, "references parsed on one thread");
+
+    /* Unmapped: the parent and every nested document share one stream
+     * without positional reads */
+    psd_parse_options_t options = { PSD_PARSE_SKIP_LAYER_PIXELS | PSD_PARSE_SKIP_COMPOSITE,
+                                    NULL };
+    source_t src = { outer_bytes, outer_size, 0, 0 };
+    psd_stream_t *stream = (inner && outer) ? psd_stream_create_custom(NULL, &source_vtable, &src)
+                                            : NULL;
+    psd_document_t *doc = stream ? psd_parse_with_options(stream, NULL, &options, NULL) : NULL;
+    int mismatches = 0;
+    bool started = doc && run_openers(doc, outer, inner, &mismatches);
+    ASSERT_TRUE(started && mismatches == 0,
+                "custom stream: nested reads and parent deferred loads do not interleave");
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+
+    /* Mapped: nested documents share the mapping with the parent's stream
+     * and are freed on their own threads */
+    char path[512];
+    (void)snprintf(path, sizeof(path), "%s/openpsd_embedded_threads.psd", OPENPSD_TEST_OUTPUT_DIR);
+    bool written = inner && outer && psd_test_write_file(path, outer_bytes, outer_size);
+    psd_stream_t *mapped = written ? psd_stream_create_file_mmap(NULL, path) : NULL;
+    doc = mapped ? psd_parse_with_options(mapped, NULL, &options, NULL) : NULL;
+    mismatches = 0;
+    started = doc && run_openers(doc, outer, inner, &mismatches);
+    ASSERT_TRUE(started && mismatches == 0,
+                "mapped: nested documents opened and freed on several threads");
+    psd_document_free(doc);
+    psd_stream_destroy(mapped);
+    if (written) (void)remove(path);
+
+    psd_document_free(inner);
+    psd_document_free(outer);
+    psd_stream_destroy(inner_stream);
+    psd_stream_destroy(outer_stream);
+    free(outer_bytes);
+    free(inner_bytes);
+}
+
+#endif /* OPENPSD_TEST_HAVE_THREADS */
+
+int run_embedded_file_tests(void)
+{
+    fprintf(stdout, "=== Embedded file tests ===\n");
+
+    test_find_embedded_files();
+    test_nested_levels();
+#if defined(OPENPSD_TEST_HAVE_THREADS)
+    test_concurrent_opens();
+#endif
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,493 @@
+/**
+ * @file test_engine_data.c
+ * @brief Tests for EngineData style and paragraph runs
+ *
+ * Builds text layers whose 'TySh' block carries a known EngineData dictionary
+ * and checks the resolved style runs, paragraph runs and default style,
+ * UTF-16 strings with escaped bytes, the Editor text fallback, descriptors
+ * holding every common value type, and that malformed EngineData is rejected
+ * instead of half-read.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+/* Growable byte buffer for hand-built blocks */
+typedef struct {
+    uint8_t data[4096];
+    size_t size;
+} byte_buf_t;
+
+static void put(byte_buf_t *b, const void *src, size_t n)
+{
+    if (b->size + n <= sizeof(b->data)) {
+        memcpy(b->data + b->size, src, n);
+    }
+    b->size += n;
+}
+
+static void put_str(byte_buf_t *b, const char *s) { put(b, s, strlen(s)); }
+
+static void put_be32(byte_buf_t *b, uint32_t v)
+{
+    uint8_t bytes[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+    put(b, bytes, 4);
+}
+
+static void put_be16(byte_buf_t *b, uint16_t v)
+{
+    uint8_t bytes[2] = { (uint8_t)(v >> 8), (uint8_t)v };
+    put(b, bytes, 2);
+}
+
+/* EngineData string: UTF-16BE with BOM, Latin-1 input, '(' ')' '\' escaped */
+static void put_engine_string(byte_buf_t *b, const char *latin1)
+{
+    put_str(b, "(\xFE\xFF");
+    for (const unsigned char *p = (const unsigned char *)latin1; *p; p++) {
+        uint8_t hi = 0;
+        put(b, &hi, 1);
+        if (*p == '(' || *p == ')' || *p == '\\') {
+            put_str(b, "\\");
+        }
+        put(b, p, 1);
+    }
+    put_str(b, ")");
+}
+
+/* Two style runs over "Hello world\r", one centred paragraph */
+static void build_engine_data(byte_buf_t *b)
+{
+    put_str(b, "\n\n<<\n\t/EngineDict\n\t<<\n\t\t/Editor\n\t\t<<\n\t\t\t/Text ");
+    put_engine_string(b, "Hello world\r");
+    put_str(b,
+            "\n\t\t>>\n"
+            "\t\t/ParagraphRun\n\t\t<<\n"
+            "\t\t\t/RunArray [ << /ParagraphSheet << /DefaultStyleSheet 0 /Properties <<\n"
+            "\t\t\t\t/Justification 2 /FirstLineIndent 4.5 /SpaceAfter 3.0 >> >> >> ]\n"
+            "\t\t\t/RunLengthArray [ 12 ]\n"
+            "\t\t\t/IsJoinable 1\n"
+            "\t\t>>\n"
+            "\t\t/StyleRun\n\t\t<<\n"
+            "\t\t\t/RunArray [\n"
+            "\t\t\t<< /StyleSheet << /StyleSheetData << /Font 1 /FontSize 24.0 /AutoLeading false\n"
+            "\t\t\t\t/Leading 30.0 /FillColor << /Type 1 /Values [ 1.0 1.0 0.0 0.0 ] >> >> >> >>\n"
+            "\t\t\t<< /StyleSheet << /StyleSheetData << /FontSize 12.0 /Tracking 50\n"
+            "\t\t\t\t/FillColor << /Type 1 /Values [ .5 0.0 0.0 1.0 ] >> >> >> >>\n"
+            "\t\t\t]\n"
+            "\t\t\t/RunLengthArray [ 6 6 ]\n"
+            "\t\t>>\n"
+            "\t>>\n"
+            "\t/ResourceDict\n\t<<\n"
+            "\t\t/FontSet [ << /Name ");
+    put_engine_string(b, "Arial");
+    put_str(b, " /Script 0 >> << /Name ");
+    put_engine_string(b, "Caf\xE9 (Pro)");
+    put_str(b,
+            " /Script 0 >> ]\n"
+            "\t\t/StyleSheetSet [ << /Name (Normal RGB) /StyleSheetData << /Font 0 /FontSize 10.0\n"
+            "\t\t\t/AutoLeading true /Tracking 0 >> >> ]\n"
+            "\t\t/ParagraphSheetSet [ << /Name (Normal) /Properties << /Justification 0\n"
+            "\t\t\t/AutoLeading 1.2 /StartIndent 2.0 >> >> ]\n"
+            "\t\t/TheNormalStyleSheet 0\n"
+            "\t\t/TheNormalParagraphSheet 0\n"
+            "\t>>\n"
+            ">>");
+}
+
+/* Descriptor key: 0 length + 4-char id, or explicit length + name */
+static void put_key(byte_buf_t *b, const char *key)
+{
+    size_t len = strlen(key);
+    put_be32(b, len == 4 ? 0u : (uint32_t)len);
+    put(b, key, len);
+}
+
+/*
+ * 8BIM TySh block: transform, text descriptor (prefix_count members from
+ * prefix, "Txt " when with_txt, EngineData), an empty warp descriptor and
+ * the bounds.
+ */
+static void build_tysh_block_with(byte_buf_t *out, const uint8_t *engine, size_t engine_len,
+                                  bool with_txt, const byte_buf_t *prefix, uint32_t prefix_count)
+{
+    byte_buf_t payload;
+    payload.size = 0;
+    static const uint8_t one[8] = { 0x3F, 0xF0, 0, 0, 0, 0, 0, 0 };
+    static const uint8_t zero[8] = { 0 };
+
+    put_be16(&payload, 1);
+    put(&payload, one, 8);
+    put(&payload, zero, 8);
+    put(&payload, zero, 8);
+    put(&payload, one, 8);
+    put(&payload, zero, 8);
+    put(&payload, zero, 8);
+    put_be16(&payload, 50);
+    put_be32(&payload, 16);
+
+    /* Text descriptor: empty name, class 'TxLr' */
+    put_be32(&payload, 1);
+    put_be16(&payload, 0);
+    put_key(&payload, "TxLr");
+    put_be32(&payload, prefix_count + (with_txt ? 2u : 1u));
+    if (prefix) {
+        put(&payload, prefix->data, prefix->size);
+    }
+    if (with_txt) {
+        put_key(&payload, "Txt ");
+        put_str(&payload, "TEXT");
+        put_be32(&payload, 11);
+        for (const char *p = "Hello world"; *p; p++) {
+            put_be16(&payload, (uint16_t)(unsigned char)*p);
+        }
+    }
+    put_key(&payload, "EngineData");
+    put_str(&payload, "tdta");
+    put_be32(&payload, (uint32_t)engine_len);
+    put(&payload, engine, engine_len);
+
+    /* Warp descriptor with no items */
+    put_be16(&payload, 1);
+    put_be32(&payload, 16);
+    put_be32(&payload, 1);
+    put_be16(&payload, 0);
+    put_key(&payload, "warp");
+    put_be32(&payload, 0);
+
+    for (int i = 0; i < 4; i++) {
+        put(&payload, zero, 8);
+    }
+    if (payload.size & 1) {
+        put(&payload, zero, 1);
+    }
+
+    put_str(out, "8BIMTySh");
+    put_be32(out, (uint32_t)payload.size);
+    put(out, payload.data, payload.size);
+}
+
+static void build_tysh_block(byte_buf_t *out, const uint8_t *engine, size_t engine_len,
+                             bool with_txt)
+{
+    build_tysh_block_with(out, engine, engine_len, with_txt, NULL, 0);
+}
+
+/* Descriptor TEXT value: char count + UTF-16BE */
+static void put_text(byte_buf_t *b, const char *ascii)
+{
+    put_be32(b, (uint32_t)strlen(ascii));
+    for (const char *p = ascii; *p; p++) {
+        put_be16(b, (uint16_t)(unsigned char)*p);
+    }
+}
+
+typedef struct {
+    uint8_t *bytes;
+    psd_stream_t *stream;
+    psd_document_t *doc;
+} text_doc_t;
+
+/* Document whose layer i carries blocks[i] */
+static void parse_text_doc(text_doc_t *t, const byte_buf_t *blocks, uint16_t count)
+{
+    psd_test_layer_t layers[4];
+    memset(layers, 0, sizeof(layers));
+    for (uint16_t i = 0; i < count; i++) {
+        layers[i].opacity = 255;
+        layers[i].blocks = blocks[i].data;
+        layers[i].blocks_length = blocks[i].size;
+    }
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_count = count;
+    spec.layers = layers;
+
+    size_t size = 0;
+    t->bytes = psd_test_build_document(&spec, &size);
+    t->stream = t->bytes ? psd_stream_create_buffer(NULL, t->bytes, size) : NULL;
+    psd_parse_options_t options = { PSD_PARSE_SKIP_LAYER_PIXELS, NULL };
+    t->doc = t->stream ? psd_parse_with_options(t->stream, NULL, &options, NULL) : NULL;
+}
+
+static void free_text_doc(text_doc_t *t)
+{
+    psd_document_free(t->doc);
+    psd_stream_destroy(t->stream);
+    free(t->bytes);
+}
+
+static bool near(double a, double b) { return a - b < 1e-9 && b - a < 1e-9; }
+
+static bool color_is(const psd_text_style_t *s, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    return s->color_rgba[0] == r && s->color_rgba[1] == g && s->color_rgba[2] == b &&
+           s->color_rgba[3] == a;
+}
+
+static void test_style_runs(void)
+{
+    fprintf(stdout, "\n=== Test: style and paragraph runs ===\n");
+
+    byte_buf_t engine;
+    engine.size = 0;
+    build_engine_data(&engine);
+    byte_buf_t blocks[2];
+    blocks[0].size = 0;
+    blocks[1].size = 0;
+    build_tysh_block(&blocks[0], engine.data, engine.size, true);
+    build_tysh_block(&blocks[1], engine.data, engine.size, false);
+
+    text_doc_t t;
+    parse_text_doc(&t, blocks, 2);
+    ASSERT_TRUE(t.doc != NULL, "parse document with two text layers");
+    if (!t.doc) {
+        free_text_doc(&t);
+        return;
+    }
+
+    size_t count = 0;
+    ASSERT_TRUE(psd_text_layer_get_style_runs(t.doc, 0, NULL, 0, &count) ==
+                        PSD_ERR_BUFFER_TOO_SMALL && count == 2,
+                "count query reports two style runs");
+
+    psd_text_style_run_t runs[3];
+    memset(runs, 0, sizeof(runs));
+    ASSERT_TRUE(psd_text_layer_get_style_runs(t.doc, 0, runs, 3, &count) == PSD_OK && count == 2,
+                "style runs read");
+    ASSERT_TRUE(runs[0].start == 0 && runs[0].length == 6 && runs[1].start == 6 &&
+                    runs[1].length == 6,
+                "run offsets follow RunLengthArray");
+
+    const psd_text_style_t *a = &runs[0].style;
+    ASSERT_TRUE(strcmp(a->font_name, "Caf\xC3\xA9 (Pro)") == 0,
+                "run 0 font from FontSet, UTF-16 decoded and unescaped");
+    ASSERT_TRUE(near(a->size, 24.0) && near(a->leading, 30.0) && near(a->tracking, 0.0),
+                "run 0 size, explicit leading, tracking from the normal sheet");
+    ASSERT_TRUE(color_is(a, 255, 0, 0, 255), "run 0 FillColor read as ARGB");
+    ASSERT_TRUE(a->justification == PSD_TEXT_JUSTIFY_CENTER, "run 0 justification from paragraph");
+
+    const psd_text_style_t *b = &runs[1].style;
+    ASSERT_TRUE(strcmp(b->font_name, "Arial") == 0, "run 1 font from the normal sheet");
+    ASSERT_TRUE(near(b->size, 12.0) && near(b->tracking, 50.0), "run 1 size and tracking");
+    ASSERT_TRUE(near(b->leading, 12.0 * 1.2), "run 1 auto leading scales the size");
+    ASSERT_TRUE(color_is(b, 0, 0, 255, 128), "run 1 color with half alpha");
+
+    psd_text_style_t style;
+    ASSERT_TRUE(psd_text_layer_get_default_style(t.doc, 0, &style) == PSD_OK &&
+                    memcmp(&style, a, sizeof(style)) == 0,
+                "default style is the first run");
+
+    memset(runs, 0, sizeof(runs));
+    ASSERT_TRUE(psd_text_layer_get_style_runs(t.doc, 0, runs, 1, &count) ==
+                        PSD_ERR_BUFFER_TOO_SMALL &&
+                    count == 2 && runs[0].length == 6 && runs[1].length == 0,
+                "short array filled up to its capacity");
+
+    psd_text_paragraph_run_t para[2];
+    ASSERT_TRUE(psd_text_layer_get_paragraph_runs(t.doc, 0, para, 2, &count) == PSD_OK &&
+                    count == 1,
+                "one paragraph run");
+    ASSERT_TRUE(para[0].start == 0 && para[0].length == 12 &&
+                    para[0].justification == PSD_TEXT_JUSTIFY_CENTER &&
+                    near(para[0].first_line_indent, 4.5) && near(para[0].start_indent, 2.0) &&
+                    near(para[0].end_indent, 0.0) && near(para[0].space_after, 3.0),
+                "paragraph properties over the normal paragraph sheet");
+
+    char text[64];
+    ASSERT_TRUE(psd_text_layer_get_text(t.doc, 0, text, sizeof(text)) == PSD_OK &&
+                    strcmp(text, "Hello world") == 0,
+                "text from the descriptor");
+    ASSERT_TRUE(psd_text_layer_get_text(t.doc, 1, text, sizeof(text)) == PSD_OK &&
+                    strcmp(text, "Hello world\r") == 0,
+                "text falls back to the EngineData editor text");
+
+    ASSERT_TRUE(psd_text_layer_get_style_runs(t.doc, 2, runs, 3, &count) != PSD_OK &&
+                    psd_text_layer_get_style_runs(t.doc, 0, NULL, 3, &count) ==
+                        PSD_ERR_NULL_POINTER &&
+                    psd_text_layer_get_paragraph_runs(t.doc, 0, para, 2, NULL) ==
+                        PSD_ERR_NULL_POINTER,
+                "bad arguments rejected");
+
+    free_text_doc(&t);
+}
+
+/*
+ * Every common value type ahead of the text members: the flat descriptor has
+ * to step over each one exactly, and look-alike keys must not match.
+ */
+static void test_descriptor_values(void)
+{
+    fprintf(stdout, "\n=== Test: descriptor value types ===\n");
+
+    static const uint8_t dbl[8] = { 0x40, 0x59, 0, 0, 0, 0, 0, 0 }; /* 100.0 */
+    byte_buf_t prefix;
+    prefix.size = 0;
+
+    put_key(&prefix, "Ornt");                     /* enum */
+    put_str(&prefix, "enum");
+    put_key(&prefix, "Ornt");
+    put_key(&prefix, "Hrzn");
+    put_key(&prefix, "AntA");                     /* long */
+    put_str(&prefix, "long");
+    put_be32(&prefix, 7);
+    put_key(&prefix, "EngineDataBackup");         /* look-alike raw value */
+    put_str(&prefix, "tdta");
+    put_be32(&prefix, 3);
+    put_str(&prefix, "<< ");
+    put_key(&prefix, "bounds");                   /* nested object */
+    put_str(&prefix, "Objc");
+    put_be32(&prefix, 1);
+    put_be16(&prefix, 0);
+    put_key(&prefix, "bounds");
+    put_be32(&prefix, 3);
+    put_key(&prefix, "Left");
+    put_str(&prefix, "UntF");
+    put_str(&prefix, "#Pxl");
+    put(&prefix, dbl, 8);
+    put_key(&prefix, "Top ");
+    put_str(&prefix, "doub");
+    put(&prefix, dbl, 8);
+    put_key(&prefix, "Nm  ");                     /* nested text before "Txt " */
+    put_str(&prefix, "TEXT");
+    put_text(&prefix, "decoy");
+    put_key(&prefix, "textGridding");             /* list of objects and bools */
+    put_str(&prefix, "VlLs");
+    put_be32(&prefix, 2);
+    put_str(&prefix, "Objc");
+    put_be32(&prefix, 1);
+    put_be16(&prefix, 0);
+    put_key(&prefix, "Pnt ");
+    put_be32(&prefix, 1);
+    put_key(&prefix, "Hrzn");
+    put_str(&prefix, "bool");
+    put(&prefix, "\x01", 1);
+    put_str(&prefix, "bool");
+    put(&prefix, "\x00", 1);
+    put_key(&prefix, "Clss");                     /* class value */
+    put_str(&prefix, "type");
+    put_be32(&prefix, 1);
+    put_be16(&prefix, 0);
+    put_key(&prefix, "TxLr");
+
+    byte_buf_t engine;
+    engine.size = 0;
+    build_engine_data(&engine);
+    byte_buf_t block;
+    block.size = 0;
+    build_tysh_block_with(&block, engine.data, engine.size, true, &prefix, 6);
+    ASSERT_TRUE(block.size <= sizeof(block.data), "test block fits its buffer");
+
+    text_doc_t t;
+    parse_text_doc(&t, &block, 1);
+    char text[64];
+    ASSERT_TRUE(t.doc && psd_text_layer_get_text(t.doc, 0, text, sizeof(text)) == PSD_OK &&
+                    strcmp(text, "Hello world") == 0,
+                "text found after every value type");
+
+    psd_text_style_t style;
+    ASSERT_TRUE(t.doc && psd_text_layer_get_default_style(t.doc, 0, &style) == PSD_OK &&
+                    near(style.size, 24.0),
+                "EngineData found by exact key");
+
+    free_text_doc(&t);
+}
+
+static void test_malformed(void)
+{
+    fprintf(stdout, "\n=== Test: malformed EngineData ===\n");
+
+    static const char *const inputs[] = {
+        "<< /EngineDict << /StyleRun << /RunArray [ ] >>",   /* unterminated dict */
+        "<< /EngineDict [ >> ]",                             /* mismatched close */
+        "<< /Editor << /Text (unterminated >> >>",           /* unterminated string */
+        "]",                                                 /* close with nothing open */
+    };
+    enum { INPUT_COUNT = sizeof(inputs) / sizeof(inputs[0]) };
+
+    byte_buf_t blocks[INPUT_COUNT];
+    for (size_t i = 0; i < INPUT_COUNT; i++) {
+        blocks[i].size = 0;
+        build_tysh_block(&blocks[i], (const uint8_t *)inputs[i], strlen(inputs[i]), true);
+    }
+
+    text_doc_t t;
+    parse_text_doc(&t, blocks, INPUT_COUNT);
+    ASSERT_TRUE(t.doc != NULL, "document with malformed EngineData still parses");
+
+    bool rejected = t.doc != NULL;
+    for (uint32_t i = 0; t.doc && i < INPUT_COUNT; i++) {
+        size_t count = 7;
+        psd_text_style_t style;
+        if (psd_text_layer_get_style_runs(t.doc, i, NULL, 0, &count) != PSD_ERR_CORRUPT_DATA ||
+            count != 0 ||
+            psd_text_layer_get_default_style(t.doc, i, &style) != PSD_ERR_CORRUPT_DATA) {
+            rejected = false;
+        }
+    }
+    ASSERT_TRUE(rejected, "every malformed input reports corrupt data");
+
+    char text[64];
+    ASSERT_TRUE(t.doc && psd_text_layer_get_text(t.doc, 0, text, sizeof(text)) == PSD_OK &&
+                    strcmp(text, "Hello world") == 0,
+                "descriptor text still readable");
+
+    free_text_doc(&t);
+
+    /* Nesting far deeper than any real document */
+    static uint8_t deep[1200];
+    for (size_t i = 0; i < 600; i++) {
+        deep[i] = '[';
+        deep[sizeof(deep) - 1 - i] = ']';
+    }
+    byte_buf_t deep_block;
+    deep_block.size = 0;
+    build_tysh_block(&deep_block, deep, sizeof(deep), true);
+    parse_text_doc(&t, &deep_block, 1);
+    size_t count = 0;
+    ASSERT_TRUE(t.doc && psd_text_layer_get_style_runs(t.doc, 0, NULL, 0, &count) ==
+                             PSD_ERR_CORRUPT_DATA,
+                "excessive nesting rejected");
+    free_text_doc(&t);
+}
+
+int run_engine_data_tests(void)
+{
+    fprintf(stdout, "=== EngineData tests ===\n");
+
+    test_style_runs();
+    test_descriptor_values();
+    test_malformed();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,340 @@
+/**
+ * @file test_flatten.c
+ * @brief Tests for layer compositing
+ *
+ * psd_document_flatten_rgba8() blends solid-color layers with their blend
+ * mode, opacity, visibility, clipping and groups, and leaves layers outside
+ * the requested rect undecoded.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+/* Wide enough for whole SIMD blocks plus a tail */
+#define CANVAS_W 13u
+#define CANVAS_H 5u
+
+static psd_test_layer_t solid(uint8_t r, uint8_t g, uint8_t b, uint8_t a, const char *key)
+{
+    psd_test_layer_t layer;
+    memset(&layer, 0, sizeof(layer));
+    memcpy(layer.blend_key, key, 4);
+    layer.opacity = 255;
+    layer.solid = true;
+    layer.color[0] = r;
+    layer.color[1] = g;
+    layer.color[2] = b;
+    layer.color[3] = a;
+    layer.bottom = CANVAS_H;
+    layer.right = CANVAS_W;
+    return layer;
+}
+
+static psd_test_layer_t section(uint8_t type, const char *key)
+{
+    psd_test_layer_t layer;
+    memset(&layer, 0, sizeof(layer));
+    memcpy(layer.blend_key, key, 4);
+    layer.opacity = 255;
+    layer.section = type;
+    return layer;
+}
+
+static psd_document_t *build(const psd_test_layer_t *layers, uint16_t count, uint32_t flags,
+                             uint8_t **bytes, psd_stream_t **stream)
+{
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = CANVAS_W;
+    spec.height = CANVAS_H;
+    spec.layer_count = count;
+    spec.layers = layers;
+
+    size_t size = 0;
+    *bytes = psd_test_build_document(&spec, &size);
+    *stream = *bytes ? psd_stream_create_buffer(NULL, *bytes, size) : NULL;
+    psd_parse_options_t options = { flags };
+    return *stream ? psd_parse_with_options(*stream, NULL, &options, NULL) : NULL;
+}
+
+/* Flatten the whole canvas; true when every pixel is within 2 of expect,
+ * or, with expect_outside set, where pixels outside the box
+ * [x0, x1) x [y0, y1) match that instead */
+static bool flatten_matches(const psd_test_layer_t *layers, uint16_t count,
+                            const uint8_t expect[4], const uint8_t *expect_outside,
+                            uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+{
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(layers, count, 0, &bytes, &stream);
+    uint8_t out[CANVAS_W * CANVAS_H * 4];
+    bool ok = doc && psd_document_flatten_rgba8(doc, NULL, out, CANVAS_W * 4u) == PSD_OK;
+
+    for (uint32_t y = 0; ok && y < CANVAS_H; y++) {
+        for (uint32_t x = 0; ok && x < CANVAS_W; x++) {
+            bool inside = !expect_outside || (x >= x0 && x < x1 && y >= y0 && y < y1);
+            const uint8_t *want = inside ? expect : expect_outside;
+            const uint8_t *px = out + ((size_t)y * CANVAS_W + x) * 4u;
+            for (int k = 0; k < 4; k++) {
+                int diff = (int)px[k] - (int)want[k];
+                if (diff < -2 || diff > 2) ok = false;
+            }
+        }
+    }
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+    return ok;
+}
+
+static void test_flatten_blend_modes(void)
+{
+    fprintf(stdout, "\n=== Test: flatten blend modes ===\n");
+
+    psd_test_layer_t layers[2] = {
+        solid(200, 100, 50, 255, "norm"),
+        solid(100, 200, 40, 255, "norm"),
+    };
+    const uint8_t top[4] = { 100, 200, 40, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 2, top, NULL, 0, 0, 0, 0), "normal covers the layer below");
+
+    memcpy(layers[1].blend_key, "mul ", 4);
+    const uint8_t mul[4] = { 78, 78, 8, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 2, mul, NULL, 0, 0, 0, 0), "multiply");
+
+    memcpy(layers[1].blend_key, "scrn", 4);
+    const uint8_t scrn[4] = { 222, 222, 82, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 2, scrn, NULL, 0, 0, 0, 0), "screen");
+
+    /* cb 200 > 127: screen(cb, 2cs - 1); cb 100: 2 cb cs; cb 50: 2 cb cs */
+    memcpy(layers[1].blend_key, "over", 4);
+    const uint8_t over[4] = { 189, 157, 16, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 2, over, NULL, 0, 0, 0, 0), "overlay");
+
+    memcpy(layers[1].blend_key, "diff", 4);
+    const uint8_t diff[4] = { 100, 100, 10, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 2, diff, NULL, 0, 0, 0, 0), "difference");
+}
+
+static void test_flatten_opacity(void)
+{
+    fprintf(stdout, "\n=== Test: flatten opacity and transparency ===\n");
+
+    psd_test_layer_t layers[2] = {
+        solid(200, 100, 50, 255, "norm"),
+        solid(100, 200, 40, 255, "norm"),
+    };
+    layers[1].opacity = 128;
+    const uint8_t half[4] = { 150, 150, 45, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 2, half, NULL, 0, 0, 0, 0), "layer opacity");
+
+    layers[1].opacity = 255;
+    layers[1].color[3] = 128;
+    ASSERT_TRUE(flatten_matches(layers, 2, half, NULL, 0, 0, 0, 0), "layer alpha");
+
+    /* Over nothing, colors come back unpremultiplied */
+    const uint8_t alone[4] = { 100, 200, 40, 128 };
+    ASSERT_TRUE(flatten_matches(&layers[1], 1, alone, NULL, 0, 0, 0, 0),
+                "translucent result is straight alpha");
+
+    layers[1].color[3] = 255;
+    layers[1].flags = 0x02;
+    const uint8_t bottom[4] = { 200, 100, 50, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 2, bottom, NULL, 0, 0, 0, 0), "hidden layer skipped");
+}
+
+static void test_flatten_bounds_and_clipping(void)
+{
+    fprintf(stdout, "\n=== Test: flatten bounds and clipping ===\n");
+
+    const uint8_t white[4] = { 255, 255, 255, 255 };
+    const uint8_t red[4] = { 255, 0, 0, 255 };
+    const uint8_t blue[4] = { 0, 0, 255, 255 };
+
+    psd_test_layer_t layers[3] = {
+        solid(255, 255, 255, 255, "norm"),
+        solid(0, 0, 255, 255, "norm"),
+        solid(255, 0, 0, 255, "norm"),
+    };
+    layers[1].top = 1;
+    layers[1].left = 2;
+    layers[1].bottom = 4;
+    layers[1].right = 11;
+    ASSERT_TRUE(flatten_matches(layers, 2, blue, white, 2, 1, 11, 4), "layer placed at its bounds");
+
+    layers[2].clipping = 1;
+    ASSERT_TRUE(flatten_matches(layers, 3, red, white, 2, 1, 11, 4),
+                "clipped layer shows only inside its base");
+
+    layers[1].opacity = 0;
+    ASSERT_TRUE(flatten_matches(layers, 3, white, NULL, 0, 0, 0, 0),
+                "base opacity applies to its clipped layers");
+
+    layers[1].opacity = 255;
+    layers[1].flags = 0x02;
+    ASSERT_TRUE(flatten_matches(layers, 3, white, NULL, 0, 0, 0, 0),
+                "hidden base hides its clipped layers");
+
+    /* Layers partly off the canvas */
+    psd_test_layer_t wide[2] = {
+        solid(255, 255, 255, 255, "norm"),
+        solid(0, 0, 255, 255, "norm"),
+    };
+    wide[1].top = (uint32_t)-3;
+    wide[1].left = (uint32_t)-4;
+    wide[1].bottom = 2;
+    wide[1].right = 6;
+    ASSERT_TRUE(flatten_matches(wide, 2, blue, white, 0, 0, 6, 2), "layer clipped to the canvas");
+}
+
+static void test_flatten_groups(void)
+{
+    fprintf(stdout, "\n=== Test: flatten groups ===\n");
+
+    /* Bottom-up: background, divider, multiply child, folder */
+    psd_test_layer_t layers[4] = {
+        solid(200, 100, 50, 255, "norm"),
+        section(3, "norm"),
+        solid(100, 200, 40, 255, "mul "),
+        section(1, "pass"),
+    };
+    const uint8_t mul[4] = { 78, 78, 8, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 4, mul, NULL, 0, 0, 0, 0),
+                "pass-through group blends onto the layers below");
+
+    /* An isolated group multiplies onto transparency, then blends normally */
+    memcpy(layers[3].blend_key, "norm", 4);
+    const uint8_t child[4] = { 100, 200, 40, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 4, child, NULL, 0, 0, 0, 0), "normal group is isolated");
+
+    layers[3].opacity = 128;
+    const uint8_t half[4] = { 150, 150, 45, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 4, half, NULL, 0, 0, 0, 0), "group opacity");
+
+    memcpy(layers[3].blend_key, "pass", 4);
+    const uint8_t pass_half[4] = { 139, 89, 29, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 4, pass_half, NULL, 0, 0, 0, 0),
+                "pass-through group opacity");
+
+    layers[3].opacity = 255;
+    layers[3].flags = 0x02;
+    const uint8_t bottom[4] = { 200, 100, 50, 255 };
+    ASSERT_TRUE(flatten_matches(layers, 4, bottom, NULL, 0, 0, 0, 0), "hidden group skipped");
+
+    /* Nested: the inner group's screen layer, then the outer multiply */
+    psd_test_layer_t nested[7] = {
+        solid(200, 100, 50, 255, "norm"),
+        section(3, "norm"),
+        section(3, "norm"),
+        solid(100, 200, 40, 255, "scrn"),
+        section(1, "pass"),
+        solid(100, 200, 40, 255, "norm"),
+        section(1, "mul "),
+    };
+    ASSERT_TRUE(flatten_matches(nested, 7, mul, NULL, 0, 0, 0, 0), "nested groups");
+}
+
+/* A rect away from a layer never loads its pixels */
+static void test_flatten_dirty_rect(void)
+{
+    fprintf(stdout, "\n=== Test: flatten dirty rect ===\n");
+
+    psd_test_layer_t layers[2] = {
+        solid(200, 100, 50, 255, "norm"),
+        solid(100, 200, 40, 255, "norm"),
+    };
+    layers[0].bottom = 2;
+    layers[0].right = 4;
+    layers[1].top = 3;
+    layers[1].left = 6;
+
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(layers, 2, PSD_PARSE_SKIP_LAYER_PIXELS, &bytes, &stream);
+    psd_rect_t rect = { 0, 1, 2, 5 };
+    uint8_t out[2 * 4 * 4];
+    memset(out, 0xA5, sizeof(out));
+    bool ok = doc && psd_document_flatten_rgba8(doc, &rect, out, 4u * 4u) == PSD_OK;
+    ASSERT_TRUE(ok && out[0] == 200 && out[1] == 100 && out[2] == 50 && out[3] == 255 &&
+                    out[12] == 0 && out[15] == 0,
+                "rect rows hold the region");
+
+    uint64_t usage = 0;
+    ok = ok && psd_document_release_layer_pixels(doc, 0) == PSD_OK &&
+         psd_document_get_decode_cache_usage(doc, &usage) == PSD_OK;
+    ASSERT_TRUE(ok && usage == 0, "layer outside the rect not loaded");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_flatten_arguments(void)
+{
+    fprintf(stdout, "\n=== Test: flatten argument checks ===\n");
+
+    psd_test_layer_t layers[1] = { solid(1, 2, 3, 255, "norm") };
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(layers, 1, 0, &bytes, &stream);
+    uint8_t out[CANVAS_W * CANVAS_H * 4];
+
+    ASSERT_TRUE(psd_document_flatten_rgba8(NULL, NULL, out, CANVAS_W * 4u) == PSD_ERR_NULL_POINTER &&
+                psd_document_flatten_rgba8(doc, NULL, NULL, CANVAS_W * 4u) == PSD_ERR_NULL_POINTER,
+                "NULL document or output rejected");
+    psd_rect_t outside = { 0, 0, (int32_t)CANVAS_H + 1, 1 };
+    ASSERT_TRUE(doc && psd_document_flatten_rgba8(doc, &outside, out, CANVAS_W * 4u) ==
+                           PSD_ERR_OUT_OF_RANGE,
+                "rect outside the canvas rejected");
+    ASSERT_TRUE(doc && psd_document_flatten_rgba8(doc, NULL, out, CANVAS_W * 4u - 1u) ==
+                           PSD_ERR_INVALID_ARGUMENT,
+                "stride shorter than a row rejected");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+int run_flatten_tests(void)
+{
+    fprintf(stdout, "=== Flatten tests ===\n");
+
+    test_flatten_blend_modes();
+    test_flatten_opacity();
+    test_flatten_bounds_and_clipping();
+    test_flatten_groups();
+    test_flatten_dirty_rect();
+    test_flatten_arguments();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file test_layer_content.c
+ * @brief Tests for layer content bounds
+ *
+ * psd_document_get_layer_content_bounds() finds the same tight box and
+ * empty-row count for every channel compression and depth, reports fully
+ * transparent layers as empty, and compositing with the recorded empty rows
+ * skipped still produces the same canvas.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+/* Wider than one PackBits run, so rows mix repeat and literal runs */
+#define CANVAS_W 160u
+#define CANVAS_H 24u
+
+/* Alpha with a box in rows [5, 10) x columns [7, 150) of varying values, a
+ * single pixel at (row 15, column 151), zero elsewhere */
+static void sparse_alpha(uint8_t *alpha)
+{
+    memset(alpha, 0, CANVAS_W * CANVAS_H);
+    for (uint32_t y = 5; y < 10; y++) {
+        for (uint32_t x = 7; x < 150; x++) {
+            alpha[y * CANVAS_W + x] = (uint8_t)((x * 7u + y) % 5u == 0 ? 0 : 40u + x);
+        }
+    }
+    alpha[15 * CANVAS_W + 151] = 1;
+}
+
+typedef struct {
+    uint8_t *bytes;
+    psd_stream_t *stream;
+    psd_document_t *doc;
+} content_doc_t;
+
+static void build_doc(content_doc_t *t, const psd_test_layer_t *layers, uint16_t count,
+                      uint16_t compression, uint16_t depth)
+{
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = CANVAS_W;
+    spec.height = CANVAS_H;
+    spec.depth = depth;
+    spec.layer_count = count;
+    spec.layers = layers;
+    spec.layer_compression = compression;
+
+    size_t size = 0;
+    t->bytes = psd_test_build_document(&spec, &size);
+    t->stream = t->bytes ? psd_stream_create_buffer(NULL, t->bytes, size) : NULL;
+    t->doc = t->stream ? psd_parse(t->stream, NULL) : NULL;
+}
+
+static void free_doc(content_doc_t *t)
+{
+    psd_document_free(t->doc);
+    psd_stream_destroy(t->stream);
+    free(t->bytes);
+}
+
+static psd_test_layer_t full_layer(const char *key)
+{
+    psd_test_layer_t layer;
+    memset(&layer, 0, sizeof(layer));
+    memcpy(layer.blend_key, key, 4);
+    layer.opacity = 255;
+    layer.bottom = CANVAS_H;
+    layer.right = CANVAS_W;
+    return layer;
+}
+
+static void test_bounds(void)
+{
+    fprintf(stdout, "\n=== Test: content bounds ===\n");
+
+    static uint8_t alpha[CANVAS_W * CANVAS_H];
+    sparse_alpha(alpha);
+
+    psd_test_layer_t layers[2];
+    layers[0] = full_layer("norm");
+    layers[0].alpha = alpha;
+    layers[1] = full_layer("norm");
+    layers[1].solid = true;      /* color 0, alpha 0 */
+    layers[1].top = 2;
+    layers[1].left = 3;
+
+    /* ZIP channels are decoded, so they need a ZIP-enabled build */
+#ifdef OPENPSD_TEST_HAVE_ZIP
+    const uint16_t last_compression = 3;
+#else
+    const uint16_t last_compression = 1;
+#endif
+    static const uint16_t depths[2] = { 8, 16 };
+    for (uint16_t compression = 0; compression <= last_compression; compression++) {
+        for (int d = 0; d < 2; d++) {
+            char msg[96];
+            content_doc_t t;
+            build_doc(&t, layers, 2, compression, depths[d]);
+
+            psd_rect_t box = { -1, -1, -1, -1 };
+            uint32_t empty = 0;
+            (void)snprintf(msg, sizeof(msg), "compression %u, %u-bit: tight box and empty rows",
+                           (unsigned)compression, (unsigned)depths[d]);
+            ASSERT_TRUE(t.doc &&
+                            psd_document_get_layer_content_bounds(t.doc, 0, &box, &empty) ==
+                                PSD_OK &&
+                            box.top == 5 && box.left == 7 && box.bottom == 16 &&
+                            box.right == 152 && empty == CANVAS_H - 6u,
+                        msg);
+
+            (void)snprintf(msg, sizeof(msg), "compression %u, %u-bit: transparent layer is empty",
+                           (unsigned)compression, (unsigned)depths[d]);
+            ASSERT_TRUE(t.doc &&
+                            psd_document_get_layer_content_bounds(t.doc, 1, &box, &empty) ==
+                                PSD_OK &&
+                            box.top == 0 && box.left == 0 && box.bottom == 0 && box.right == 0 &&
+                            empty == CANVAS_H - 2u,
+                        msg);
+            free_doc(&t);
+        }
+    }
+
+    content_doc_t t;
+    build_doc(&t, layers, 1, 1, 8);
+    psd_rect_t box;
+    ASSERT_TRUE(t.doc && psd_document_get_layer_content_bounds(t.doc, 0, &box, NULL) == PSD_OK &&
+                    psd_document_get_layer_content_bounds(t.doc, 0, &box, NULL) == PSD_OK &&
+                    box.top == 5 && box.right == 152,
+                "cached result returned again");
+    ASSERT_TRUE(t.doc &&
+                    psd_document_get_layer_content_bounds(t.doc, 1, &box, NULL) ==
+                        PSD_ERR_OUT_OF_RANGE &&
+                    psd_document_get_layer_content_bounds(t.doc, -1, &box, NULL) ==
+                        PSD_ERR_OUT_OF_RANGE &&
+                    psd_document_get_layer_content_bounds(t.doc, 0, NULL, NULL) ==
+                        PSD_ERR_NULL_POINTER &&
+                    psd_document_get_layer_content_bounds(NULL, 0, &box, NULL) ==
+                        PSD_ERR_NULL_POINTER,
+                "arguments checked");
+    free_doc(&t);
+}
+
+static void test_flatten_skips_empty_rows(void)
+{
+    fprintf(stdout, "\n=== Test: compositing with empty rows skipped ===\n");
+
+    static uint8_t alpha[CANVAS_W * CANVAS_H];
+    sparse_alpha(alpha);
+
+    /* Opaque base, then the sparse layer multiplied over it */
+    psd_test_layer_t layers[2];
+    layers[0] = full_layer("norm");
+    layers[0].solid = true;
+    layers[0].color[0] = 200;
+    layers[0].color[1] = 120;
+    layers[0].color[2] = 40;
+    layers[0].color[3] = 255;
+    layers[1] = full_layer("mul ");
+    layers[1].alpha = alpha;
+
+    content_doc_t t;
+    build_doc(&t, layers, 2, 1, 8);
+    uint8_t *out = (uint8_t *)malloc(CANVAS_W * CANVAS_H * 4u);
+    bool ok = t.doc && out &&
+              psd_document_flatten_rgba8(t.doc, NULL, out, CANVAS_W * 4u) == PSD_OK;
+    ASSERT_TRUE(ok, "flatten document");
+
+    bool base_outside = ok;
+    bool changed_inside = false;
+    for (uint32_t y = 0; ok && y < CANVAS_H; y++) {
+        for (uint32_t x = 0; x < CANVAS_W; x++) {
+            const uint8_t *px = out + ((size_t)y * CANVAS_W + x) * 4u;
+            bool is_base = px[0] == 200 && px[1] == 120 && px[2] == 40 && px[3] == 255;
+            if (alpha[y * CANVAS_W + x] == 0) {
+                base_outside = base_outside && is_base;
+            } else if (!is_base) {
+                changed_inside = true;
+            }
+        }
+    }
+    ASSERT_TRUE(base_outside, "transparent pixels leave the base untouched");
+    ASSERT_TRUE(changed_inside, "content pixels are blended");
+
+    /* A region starting inside the box agrees with the full canvas */
+    psd_rect_t rect = { 7, 100, 17, 160 };
+    uint8_t *part = (uint8_t *)malloc(60u * 10u * 4u);
+    bool same = ok && part && psd_document_flatten_rgba8(t.doc, &rect, part, 60u * 4u) == PSD_OK;
+    for (uint32_t y = 0; same && y < 10u; y++) {
+        same = memcmp(part + (size_t)y * 60u * 4u,
+                      out + ((size_t)(y + 7u) * CANVAS_W + 100u) * 4u, 60u * 4u) == 0;
+    }
+    ASSERT_TRUE(same, "region flatten matches the full canvas");
+
+    free(part);
+    free(out);
+    free_doc(&t);
+}
+
+int run_layer_content_tests(void)
+{
+    fprintf(stdout, "=== Layer content tests ===\n");
+
+    test_bounds();
+    test_flatten_skips_empty_rows();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
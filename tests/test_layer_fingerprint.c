@@ -0,0 +1,343 @@
+/**
+ * @file test_layer_fingerprint.c
+ * @brief Tests for layer fingerprints
+ *
+ * Fingerprints must not depend on how a document was read, must follow any
+ * change to a layer's pixels or placement, and must be computable without
+ * decoding channels.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef OPENPSD_TEST_OUTPUT_DIR
+#define OPENPSD_TEST_OUTPUT_DIR "."
+#endif
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+#define MAX_LAYERS 8
+
+static psd_document_t *parse_bytes(const uint8_t *bytes, size_t size, uint32_t flags,
+                                   psd_stream_t **out_stream)
+{
+    psd_stream_t *stream = psd_stream_create_buffer(NULL, bytes, size);
+    psd_parse_options_t options = { flags, NULL };
+    psd_document_t *doc = stream ? psd_parse_with_options(stream, NULL, &options, NULL) : NULL;
+    if (!doc) {
+        psd_stream_destroy(stream);
+        stream = NULL;
+    }
+    *out_stream = stream;
+    return doc;
+}
+
+/* Fingerprints of every layer, one call per layer; false on any error */
+static bool fingerprint_all(psd_document_t *doc, uint64_t *out, int32_t *out_count)
+{
+    int32_t count = 0;
+    if (psd_document_get_layer_count(doc, &count) != PSD_OK || count > MAX_LAYERS) {
+        return false;
+    }
+    for (int32_t i = 0; i < count; i++) {
+        if (psd_document_get_layer_fingerprint(doc, i, &out[i]) != PSD_OK) {
+            return false;
+        }
+    }
+    *out_count = count;
+    return true;
+}
+
+static bool same_fingerprints(const uint64_t *a, const uint64_t *b, int32_t count)
+{
+    return memcmp(a, b, (size_t)count * sizeof(*a)) == 0;
+}
+
+static void test_stable_across_sources(void)
+{
+    fprintf(stdout, "\n=== Test: fingerprints do not depend on the source ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    ASSERT_TRUE(bytes != NULL, "build document");
+    if (!bytes) {
+        return;
+    }
+
+    psd_stream_t *eager_stream = NULL;
+    psd_stream_t *deferred_stream = NULL;
+    psd_document_t *eager = parse_bytes(bytes, size, 0, &eager_stream);
+    psd_document_t *deferred = parse_bytes(bytes, size, PSD_PARSE_SKIP_LAYER_PIXELS,
+                                           &deferred_stream);
+    ASSERT_TRUE(eager && deferred, "parse eager and deferred");
+
+    uint64_t expected[MAX_LAYERS] = { 0 };
+    uint64_t got[MAX_LAYERS] = { 0 };
+    int32_t count = 0;
+    int32_t got_count = 0;
+    ASSERT_TRUE(eager && fingerprint_all(eager, expected, &count) && count == 3,
+                "fingerprint every layer");
+
+    bool distinct = true;
+    for (int32_t i = 0; i < count; i++) {
+        for (int32_t j = i + 1; j < count; j++) {
+            distinct = distinct && expected[i] != expected[j];
+        }
+    }
+    ASSERT_TRUE(distinct, "layers with different pixels differ");
+
+    ASSERT_TRUE(eager && fingerprint_all(eager, got, &got_count) &&
+                    same_fingerprints(got, expected, count),
+                "repeated calls agree");
+    ASSERT_TRUE(deferred && fingerprint_all(deferred, got, &got_count) &&
+                    got_count == count && same_fingerprints(got, expected, count),
+                "deferred document gives the same fingerprints");
+
+    /* Decoding first must not change anything: the payload is what is hashed */
+    psd_document_t *decoded = NULL;
+    psd_stream_t *decoded_stream = NULL;
+    decoded = parse_bytes(bytes, size, 0, &decoded_stream);
+    ASSERT_TRUE(decoded && psd_document_decode_all_layers(decoded, NULL) == PSD_OK &&
+                    fingerprint_all(decoded, got, &got_count) &&
+                    same_fingerprints(got, expected, count),
+                "decoded document gives the same fingerprints");
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/fingerprint_source.psd", OPENPSD_TEST_OUTPUT_DIR);
+    bool written = psd_test_write_file(path, bytes, size);
+    psd_stream_t *mapped = written ? psd_stream_create_file_mmap(NULL, path) : NULL;
+    psd_parse_options_t options = { PSD_PARSE_SKIP_LAYER_PIXELS, NULL };
+    psd_document_t *from_file = mapped ? psd_parse_with_options(mapped, NULL, &options, NULL)
+                                       : NULL;
+    ASSERT_TRUE(from_file && fingerprint_all(from_file, got, &got_count) &&
+                    same_fingerprints(got, expected, count),
+                "mapped file gives the same fingerprints");
+
+    uint64_t unused = 0;
+    ASSERT_TRUE(eager && psd_document_get_layer_fingerprint(eager, count, &unused) ==
+                             PSD_ERR_OUT_OF_RANGE,
+                "out of range index is rejected");
+    ASSERT_TRUE(psd_document_get_layer_fingerprint(NULL, 0, &unused) == PSD_ERR_NULL_POINTER,
+                "NULL document is rejected");
+
+    psd_document_free(from_file);
+    psd_stream_destroy(mapped);
+    if (written) (void)remove(path);
+    psd_document_free(decoded);
+    psd_stream_destroy(decoded_stream);
+    psd_document_free(deferred);
+    psd_stream_destroy(deferred_stream);
+    psd_document_free(eager);
+    psd_stream_destroy(eager_stream);
+    free(bytes);
+}
+
+/* Two solid layers; variant changes layer 1 in one way */
+static uint8_t *build_solid_pair(int variant, size_t *out_size)
+{
+    psd_test_layer_t layers[2];
+    memset(layers, 0, sizeof(layers));
+    for (int i = 0; i < 2; i++) {
+        layers[i].opacity = 255;
+        layers[i].solid = true;
+        layers[i].color[0] = (uint8_t)(40 + 100 * i);
+        layers[i].color[1] = 90;
+        layers[i].color[2] = 200;
+        layers[i].color[3] = 255;
+        layers[i].top = 2;
+        layers[i].left = 3;
+        layers[i].bottom = 18;
+        layers[i].right = 25;
+    }
+    if (variant == 1) {
+        layers[1].color[2] = 201;
+    } else if (variant == 2) {
+        layers[1].top = 3;
+        layers[1].bottom = 19;
+    } else if (variant == 3) {
+        memcpy(layers[1].blend_key, "mul ", 4);
+    }
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_count = 2;
+    spec.layers = layers;
+    return psd_test_build_document(&spec, out_size);
+}
+
+static void test_changes_are_seen(void)
+{
+    fprintf(stdout, "\n=== Test: fingerprints follow layer changes ===\n");
+
+    uint64_t base[MAX_LAYERS] = { 0 };
+    int32_t count = 0;
+    psd_stream_t *stream = NULL;
+    size_t size = 0;
+    uint8_t *bytes = build_solid_pair(0, &size);
+    psd_document_t *doc = bytes ? parse_bytes(bytes, size, 0, &stream) : NULL;
+    ASSERT_TRUE(doc && fingerprint_all(doc, base, &count) && count == 2, "base document");
+    if (!doc) {
+        free(bytes);
+        return;
+    }
+
+    static const char *const what[] = { NULL, "blue changed", "moved by a row",
+                                        "blend mode changed" };
+    for (int variant = 1; variant <= 3; variant++) {
+        uint64_t got[MAX_LAYERS] = { 0 };
+        int32_t got_count = 0;
+        psd_stream_t *variant_stream = NULL;
+        size_t variant_size = 0;
+        uint8_t *variant_bytes = build_solid_pair(variant, &variant_size);
+        psd_document_t *changed = variant_bytes
+                                      ? parse_bytes(variant_bytes, variant_size, 0, &variant_stream)
+                                      : NULL;
+        char msg[128];
+        snprintf(msg, sizeof(msg), "%s: only that layer's fingerprint changes", what[variant]);
+        ASSERT_TRUE(changed && fingerprint_all(changed, got, &got_count) && got_count == 2 &&
+                        got[0] == base[0] && got[1] != base[1],
+                    msg);
+        psd_document_free(changed);
+        psd_stream_destroy(variant_stream);
+        free(variant_bytes);
+    }
+
+    /* Properties set after parsing count, and setting them back restores it */
+    uint64_t now = 0;
+    ASSERT_TRUE(psd_document_set_layer_properties(doc, 1, 128, 0) == PSD_OK &&
+                    psd_document_get_layer_fingerprint(doc, 1, &now) == PSD_OK && now != base[1],
+                "new opacity changes the fingerprint");
+    ASSERT_TRUE(psd_document_set_layer_properties(doc, 1, 255, 2) == PSD_OK &&
+                    psd_document_get_layer_fingerprint(doc, 1, &now) == PSD_OK && now != base[1],
+                "hiding the layer changes the fingerprint");
+    ASSERT_TRUE(psd_document_set_layer_properties(doc, 1, 255, 0) == PSD_OK &&
+                    psd_document_get_layer_fingerprint(doc, 1, &now) == PSD_OK && now == base[1],
+                "restoring the properties restores the fingerprint");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_all_layers(void)
+{
+    fprintf(stdout, "\n=== Test: fingerprints of all layers at once ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_count = MAX_LAYERS;
+    spec.layer_compression = 2;
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    ASSERT_TRUE(bytes != NULL, "build document");
+    if (!bytes) {
+        return;
+    }
+
+    psd_stream_t *stream = NULL;
+    psd_stream_t *single_stream = NULL;
+    psd_document_t *doc = parse_bytes(bytes, size,
+                                      PSD_PARSE_SKIP_LAYER_PIXELS | PSD_PARSE_COLLECT_STATS,
+                                      &stream);
+    psd_document_t *single = parse_bytes(bytes, size, 0, &single_stream);
+    ASSERT_TRUE(doc && single, "parse documents");
+
+    uint64_t expected[MAX_LAYERS] = { 0 };
+    uint64_t got[MAX_LAYERS] = { 0 };
+    int32_t count = 0;
+    ASSERT_TRUE(single && fingerprint_all(single, expected, &count) && count == MAX_LAYERS,
+                "single calls");
+    ASSERT_TRUE(doc && psd_document_get_layer_fingerprints(doc, NULL, got, MAX_LAYERS - 1) ==
+                           PSD_ERR_BUFFER_TOO_SMALL,
+                "short output array is rejected");
+    ASSERT_TRUE(doc && psd_document_get_layer_fingerprints(doc, NULL, got, MAX_LAYERS) ==
+                           PSD_OK &&
+                    same_fingerprints(got, expected, count),
+                "parallel call matches the single calls");
+
+    psd_stats_t stats;
+    bool decoded = true;
+    if (doc && psd_document_get_stats(doc, &stats) == PSD_OK) {
+        decoded = stats.channels_decoded[0] + stats.channels_decoded[1] +
+                      stats.channels_decoded[2] + stats.channels_decoded[3] != 0;
+    }
+    ASSERT_TRUE(!decoded, "no channel was decoded");
+
+    memset(got, 0, sizeof(got));
+    ASSERT_TRUE(doc && psd_document_get_layer_fingerprints(doc, NULL, got, MAX_LAYERS) ==
+                           PSD_OK &&
+                    same_fingerprints(got, expected, count),
+                "second call reuses the kept hashes");
+
+    psd_document_free(single);
+    psd_stream_destroy(single_stream);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+/* Stored fingerprints stay valid only while the value never changes */
+static void test_known_value(void)
+{
+    fprintf(stdout, "\n=== Test: fingerprint of a known document ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = 64;
+    spec.height = 48;
+    spec.layer_compression = 0;
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = bytes ? parse_bytes(bytes, size, 0, &stream) : NULL;
+
+    uint64_t fingerprint = 0;
+    ASSERT_TRUE(doc && psd_document_get_layer_fingerprint(doc, 0, &fingerprint) == PSD_OK,
+                "fingerprint computed");
+    ASSERT_TRUE(fingerprint == 0x5C0C67ACBC5F5186ULL, "value matches on every platform");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+int run_layer_fingerprint_tests(void)
+{
+    fprintf(stdout, "=== Layer fingerprint tests ===\n");
+
+    test_stable_across_sources();
+    test_changes_are_seen();
+    test_all_layers();
+    test_known_value();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file test_layer_names.c
+ * @brief Tests for finding layers by name
+ *
+ * Every layer is found by its exact name, duplicate names resolve to the
+ * lowest index, and near misses (prefixes, case, unknown names) are not
+ * found. A document with many layers checks the index against a scan.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+static psd_document_t *parse_layers(const psd_test_layer_t *layers, uint16_t count,
+                                    uint8_t **bytes, psd_stream_t **stream)
+{
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_count = count;
+    spec.layers = layers;
+
+    size_t size = 0;
+    *bytes = psd_test_build_document(&spec, &size);
+    *stream = *bytes ? psd_stream_create_buffer(NULL, *bytes, size) : NULL;
+    psd_parse_options_t options = { PSD_PARSE_SKIP_LAYER_PIXELS, NULL };
+    return *stream ? psd_parse_with_options(*stream, NULL, &options, NULL) : NULL;
+}
+
+static void test_named_layers(void)
+{
+    fprintf(stdout, "\n=== Test: named layers ===\n");
+
+    psd_test_layer_t layers[5];
+    memset(layers, 0, sizeof(layers));
+    static const char *const names[5] = { "Background", "Title", "Logo", "Title", "Title copy" };
+    for (int i = 0; i < 5; i++) {
+        layers[i].opacity = 255;
+        layers[i].name = names[i];
+    }
+
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = parse_layers(layers, 5, &bytes, &stream);
+    ASSERT_TRUE(doc != NULL, "parse named layers");
+    if (!doc) {
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    int32_t index = -1;
+    ASSERT_TRUE(psd_document_find_layer_by_name(doc, "Background", &index) == PSD_OK &&
+                    index == 0,
+                "find first layer");
+    ASSERT_TRUE(psd_document_find_layer_by_name(doc, "Logo", &index) == PSD_OK && index == 2,
+                "find middle layer");
+    ASSERT_TRUE(psd_document_find_layer_by_name(doc, "Title copy", &index) == PSD_OK &&
+                    index == 4,
+                "find last layer");
+    ASSERT_TRUE(psd_document_find_layer_by_name(doc, "Title", &index) == PSD_OK && index == 1,
+                "duplicate name resolves to the lowest index");
+
+    index = 42;
+    ASSERT_TRUE(psd_document_find_layer_by_name(doc, "title", &index) == PSD_ERR_INVALID_ARGUMENT &&
+                    psd_document_find_layer_by_name(doc, "Titl", &index) == PSD_ERR_INVALID_ARGUMENT &&
+                    psd_document_find_layer_by_name(doc, "", &index) == PSD_ERR_INVALID_ARGUMENT &&
+                    psd_document_find_layer_by_name(doc, "Missing", &index) ==
+                        PSD_ERR_INVALID_ARGUMENT &&
+                    index == 42,
+                "names must match exactly");
+    ASSERT_TRUE(psd_document_find_layer_by_name(NULL, "Logo", &index) == PSD_ERR_NULL_POINTER &&
+                    psd_document_find_layer_by_name(doc, NULL, &index) == PSD_ERR_NULL_POINTER &&
+                    psd_document_find_layer_by_name(doc, "Logo", NULL) == PSD_ERR_NULL_POINTER,
+                "NULL arguments rejected");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+/* Default names ("Layer <i>") over enough layers to fill many probe chains */
+static void test_many_layers(void)
+{
+    fprintf(stdout, "\n=== Test: many layers ===\n");
+
+    enum { COUNT = 600 };
+    psd_test_layer_t *layers = (psd_test_layer_t *)calloc(COUNT, sizeof(*layers));
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = NULL;
+    if (layers) {
+        for (int i = 0; i < COUNT; i++) {
+            layers[i].opacity = 255;
+            layers[i].top = 0;
+            layers[i].left = 0;
+            layers[i].bottom = 2;
+            layers[i].right = 2;
+        }
+        doc = parse_layers(layers, COUNT, &bytes, &stream);
+    }
+    ASSERT_TRUE(doc != NULL, "parse many layers");
+
+    bool all_found = doc != NULL;
+    for (int i = 0; doc && i < COUNT; i++) {
+        char name[32];
+        int32_t index = -1;
+        (void)snprintf(name, sizeof(name), "Layer %d", i);
+        if (psd_document_find_layer_by_name(doc, name, &index) != PSD_OK || index != i) {
+            all_found = false;
+        }
+    }
+    ASSERT_TRUE(all_found, "every layer found at its own index");
+
+    int32_t index = -1;
+    ASSERT_TRUE(doc && psd_document_find_layer_by_name(doc, "Layer 600", &index) ==
+                           PSD_ERR_INVALID_ARGUMENT,
+                "name past the last layer is not found");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+    free(layers);
+}
+
+static void test_no_layers(void)
+{
+    fprintf(stdout, "\n=== Test: document without layers ===\n");
+
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = parse_layers(NULL, 0, &bytes, &stream);
+    int32_t index = -1;
+    ASSERT_TRUE(doc != NULL &&
+                    psd_document_find_layer_by_name(doc, "Layer 0", &index) ==
+                        PSD_ERR_INVALID_ARGUMENT,
+                "nothing to find");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+int run_layer_names_tests(void)
+{
+    fprintf(stdout, "=== Layer name tests ===\n");
+
+    test_named_layers();
+    test_many_layers();
+    test_no_layers();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
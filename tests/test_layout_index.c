@@ -0,0 +1,343 @@
+/**
+ * @file test_layout_index.c
+ * @brief Tests for saved layout indexes
+ *
+ * A document re-opened with psd_parse_with_index() matches a normal parse,
+ * reads nothing from the channel image data until pixels are asked for, and
+ * refuses indexes that are corrupt or no longer match the file.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+#define SOURCE_TAG 0x1234ABCDull
+
+/* Custom stream that remembers which bytes its callbacks handed out */
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    size_t position;
+    uint8_t *touched;
+} tracking_source_t;
+
+static int64_t tracking_read(psd_stream_t *stream, void *buffer, size_t count, void *user)
+{
+    (void)stream;
+    tracking_source_t *src = (tracking_source_t *)user;
+    size_t left = src->length - src->position;
+    size_t n = (count < left) ? count : left;
+    memcpy(buffer, src->data + src->position, n);
+    memset(src->touched + src->position, 1, n);
+    src->position += n;
+    return (int64_t)n;
+}
+
+static int64_t tracking_write(psd_stream_t *stream, const void *buffer, size_t count, void *user)
+{
+    (void)stream;
+    (void)buffer;
+    (void)count;
+    (void)user;
+    return PSD_ERR_STREAM_INVALID;
+}
+
+static int64_t tracking_seek(psd_stream_t *stream, int64_t offset, void *user)
+{
+    (void)stream;
+    tracking_source_t *src = (tracking_source_t *)user;
+    if (offset < 0 || (uint64_t)offset > src->length) return PSD_ERR_OUT_OF_RANGE;
+    src->position = (size_t)offset;
+    return offset;
+}
+
+static int64_t tracking_tell(psd_stream_t *stream, void *user)
+{
+    (void)stream;
+    return (int64_t)((tracking_source_t *)user)->position;
+}
+
+static const psd_stream_vtable_t tracking_vtable = {
+    tracking_read, tracking_write, tracking_seek, tracking_tell, NULL, NULL, NULL
+};
+
+static uint64_t be64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+    return v;
+}
+
+static bool same_documents(psd_document_t *a, psd_document_t *b)
+{
+    int32_t na = 0, nb = 0;
+    psd_document_get_layer_count(a, &na);
+    psd_document_get_layer_count(b, &nb);
+    if (na != nb) return false;
+
+    for (int32_t i = 0; i < na; i++) {
+        int32_t ba[4], bb[4];
+        psd_document_get_layer_bounds(a, i, &ba[0], &ba[1], &ba[2], &ba[3]);
+        psd_document_get_layer_bounds(b, i, &bb[0], &bb[1], &bb[2], &bb[3]);
+        if (memcmp(ba, bb, sizeof(ba)) != 0) return false;
+
+        const uint8_t *name_a = NULL, *name_b = NULL;
+        size_t len_a = 0, len_b = 0;
+        psd_document_get_layer_name(a, i, &name_a, &len_a);
+        psd_document_get_layer_name(b, i, &name_b, &len_b);
+        if (len_a != len_b || (len_a && memcmp(name_a, name_b, len_a) != 0)) return false;
+
+        size_t ca = 0, cb = 0;
+        psd_document_get_layer_channel_count(a, i, &ca);
+        psd_document_get_layer_channel_count(b, i, &cb);
+        if (ca != cb) return false;
+        for (size_t c = 0; c < ca; c++) {
+            const uint8_t *da = NULL, *db = NULL;
+            uint64_t la = 0, lb = 0;
+            if (psd_document_get_layer_channel_data(a, i, c, NULL, &da, &la, NULL) != PSD_OK ||
+                psd_document_get_layer_channel_data(b, i, c, NULL, &db, &lb, NULL) != PSD_OK) {
+                return false;
+            }
+            if (la != lb || !da || !db || memcmp(da, db, (size_t)la) != 0) return false;
+        }
+    }
+    return true;
+}
+
+/* Parse bytes normally and save their index (malloc'd) */
+static uint8_t *save_index(const uint8_t *bytes, size_t size, size_t *out_size)
+{
+    psd_stream_t *stream = psd_stream_create_buffer(NULL, bytes, size);
+    psd_document_t *doc = psd_parse(stream, NULL);
+    uint8_t *index = NULL;
+    size_t required = 0;
+    if (doc && psd_document_save_index(doc, stream, SOURCE_TAG, NULL, 0, &required) ==
+                   PSD_ERR_BUFFER_TOO_SMALL) {
+        index = (uint8_t *)malloc(required);
+        if (index && psd_document_save_index(doc, stream, SOURCE_TAG, index, required, NULL) !=
+                         PSD_OK) {
+            free(index);
+            index = NULL;
+        }
+    }
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    *out_size = required;
+    return index;
+}
+
+static psd_status_t open_with_index(const uint8_t *bytes, size_t size, const uint8_t *index,
+                                    size_t index_size, uint64_t tag)
+{
+    psd_stream_t *stream = psd_stream_create_buffer(NULL, bytes, size);
+    psd_status_t st = PSD_OK;
+    psd_document_t *doc = psd_parse_with_index(stream, NULL, NULL, index, index_size, tag, &st);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    return st;
+}
+
+static void test_round_trip(bool psb)
+{
+    fprintf(stdout, "\n=== Test: index round trip (%s) ===\n", psb ? "PSB" : "PSD");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.psb = psb;
+    spec.layer_count = 5;
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    ASSERT_TRUE(bytes != NULL, "build synthetic document");
+    if (!bytes) return;
+
+    size_t index_size = 0;
+    uint8_t *index = save_index(bytes, size, &index_size);
+    ASSERT_TRUE(index && index_size == 56u + 5u * 4u * 18u + 8u,
+                "index holds one entry per channel");
+
+    psd_stream_t *s_full = psd_stream_create_buffer(NULL, bytes, size);
+    psd_stream_t *s_index = psd_stream_create_buffer(NULL, bytes, size);
+    psd_document_t *full = psd_parse(s_full, NULL);
+    psd_status_t st = PSD_ERR_INVALID_ARGUMENT;
+    psd_document_t *indexed =
+        index ? psd_parse_with_index(s_index, NULL, NULL, index, index_size, SOURCE_TAG, &st)
+              : NULL;
+    ASSERT_TRUE(full && indexed && st == PSD_OK, "document re-opens from its index");
+    ASSERT_TRUE(full && indexed && same_documents(full, indexed),
+                "indexed layers match a full parse");
+
+    /* The re-opened document can save the same index again */
+    uint8_t *again = index ? (uint8_t *)malloc(index_size) : NULL;
+    ASSERT_TRUE(indexed && again &&
+                    psd_document_save_index(indexed, s_index, SOURCE_TAG, again, index_size,
+                                            NULL) == PSD_OK &&
+                    memcmp(again, index, index_size) == 0,
+                "indexed document saves an identical index");
+
+    free(again);
+    psd_document_free(indexed);
+    psd_document_free(full);
+    psd_stream_destroy(s_index);
+    psd_stream_destroy(s_full);
+    free(index);
+    free(bytes);
+}
+
+static void test_no_channel_data_reads(void)
+{
+    fprintf(stdout, "\n=== Test: indexed open skips the channel data ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_count = 8;
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    size_t index_size = 0;
+    uint8_t *index = bytes ? save_index(bytes, size, &index_size) : NULL;
+    ASSERT_TRUE(bytes && index, "build document and index");
+    if (!bytes || !index) {
+        free(bytes);
+        return;
+    }
+
+    /* Channel image data runs from the end of the records to the last payload */
+    uint64_t data_start = be64(index + 40);
+    uint64_t data_end = data_start;
+    for (uint64_t n = 0; n < be64(index + 48); n++) {
+        const uint8_t *entry = index + 56 + n * 18;
+        if (be64(entry) + be64(entry + 8) > data_end) data_end = be64(entry) + be64(entry + 8);
+    }
+
+    tracking_source_t src = { bytes, size, 0, (uint8_t *)calloc(size, 1) };
+    psd_stream_t *stream = psd_stream_create_custom(NULL, &tracking_vtable, &src);
+    psd_stream_set_read_buffer(stream, 0);
+    psd_document_t *doc =
+        psd_parse_with_index(stream, NULL, NULL, index, index_size, SOURCE_TAG, NULL);
+    ASSERT_TRUE(doc != NULL, "open unbuffered custom stream with index");
+
+    bool untouched = data_end > data_start;
+    for (uint64_t i = data_start; i < data_end; i++) {
+        if (src.touched[i]) untouched = false;
+    }
+    ASSERT_TRUE(untouched, "no compression fields or payloads read while opening");
+
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    ASSERT_TRUE(doc &&
+                    psd_document_get_layer_channel_data(doc, 7, 1, NULL, &data, &length,
+                                                        NULL) == PSD_OK &&
+                    data && length == (uint64_t)(spec.width - 7) * (spec.height - 7),
+                "payloads load on demand from the indexed offsets");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(src.touched);
+    free(index);
+    free(bytes);
+}
+
+static void test_stale_index(void)
+{
+    fprintf(stdout, "\n=== Test: stale and corrupt indexes ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    size_t index_size = 0;
+    uint8_t *index = bytes ? save_index(bytes, size, &index_size) : NULL;
+    ASSERT_TRUE(bytes && index, "build document and index");
+    if (!bytes || !index) {
+        free(bytes);
+        return;
+    }
+
+    ASSERT_TRUE(open_with_index(bytes, size, index, index_size, SOURCE_TAG + 1) ==
+                    PSD_ERR_INVALID_ARGUMENT,
+                "different source tag is refused");
+
+    /* Another layer shifts every payload; same tag, different records */
+    psd_test_doc_spec_t other_spec = spec;
+    other_spec.layer_count = 4;
+    size_t other_size = 0;
+    uint8_t *other = psd_test_build_document(&other_spec, &other_size);
+    ASSERT_TRUE(other && open_with_index(other, other_size, index, index_size, SOURCE_TAG) ==
+                             PSD_ERR_INVALID_ARGUMENT,
+                "edited file is refused despite a matching tag");
+    free(other);
+
+    ASSERT_TRUE(open_with_index(bytes, 200, index, index_size, SOURCE_TAG) ==
+                    PSD_ERR_INVALID_ARGUMENT,
+                "truncated file is refused");
+
+    index[60] ^= 0x01;
+    ASSERT_TRUE(open_with_index(bytes, size, index, index_size, SOURCE_TAG) ==
+                    PSD_ERR_INVALID_FORMAT,
+                "index with a bad checksum is refused");
+    index[60] ^= 0x01;
+    ASSERT_TRUE(open_with_index(bytes, size, index, index_size - 1, SOURCE_TAG) ==
+                        PSD_ERR_INVALID_FORMAT &&
+                    open_with_index(bytes, size, index, 10, SOURCE_TAG) ==
+                        PSD_ERR_INVALID_FORMAT,
+                "short index is refused");
+    ASSERT_TRUE(open_with_index(bytes, size, index, index_size, SOURCE_TAG) == PSD_OK,
+                "intact index still opens");
+
+    /* Nothing to save without the layer section */
+    psd_stream_t *stream = psd_stream_create_buffer(NULL, bytes, size);
+    psd_parse_options_t options = { PSD_PARSE_STOP_AFTER_RESOURCES };
+    psd_document_t *doc = psd_parse_with_options(stream, NULL, &options, NULL);
+    size_t required = 0;
+    ASSERT_TRUE(doc && psd_document_save_index(doc, stream, 0, NULL, 0, &required) ==
+                           PSD_ERR_INVALID_ARGUMENT,
+                "document without layer layout has no index");
+    ASSERT_TRUE(psd_document_save_index(NULL, stream, 0, NULL, 0, &required) ==
+                        PSD_ERR_NULL_POINTER &&
+                    psd_parse_with_index(stream, NULL, NULL, NULL, 0, 0, NULL) == NULL,
+                "NULL arguments are rejected");
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+
+    free(index);
+    free(bytes);
+}
+
+int run_layout_index_tests(void)
+{
+    fprintf(stdout, "=== Layout index tests ===\n");
+
+    test_round_trip(false);
+    test_round_trip(true);
+    test_no_channel_data_reads();
+    test_stale_index();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+/**
+ * @file test_parse_options.c
+ * @brief Tests for psd_parse_with_options()
+ *
+ * Checks that metadata-only parses expose the same structure as a full parse
+ * and that skipped sections load on demand with identical contents.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+static const uint8_t xmp[] = "<x:xmpmeta/>";
+
+static uint8_t *build_sample(size_t *size)
+{
+    static const psd_test_resource_t res = { 1060, xmp, sizeof(xmp) };
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.resources = &res;
+    spec.resource_count = 1;
+    return psd_test_build_document(&spec, size);
+}
+
+static psd_document_t *parse_flags(psd_stream_t *stream, uint32_t flags)
+{
+    psd_parse_options_t options;
+    options.flags = flags;
+    psd_status_t status = PSD_OK;
+    psd_document_t *doc = psd_parse_with_options(stream, NULL, &options, &status);
+    return (status == PSD_OK) ? doc : NULL;
+}
+
+static bool same_structure(psd_document_t *a, psd_document_t *b)
+{
+    int32_t na = 0, nb = 0;
+    psd_document_get_layer_count(a, &na);
+    psd_document_get_layer_count(b, &nb);
+    if (na != nb) return false;
+
+    for (int32_t i = 0; i < na; i++) {
+        const uint8_t *name_a = NULL, *name_b = NULL;
+        size_t len_a = 0, len_b = 0;
+        uint32_t sig_a = 0, key_a = 0, sig_b = 0, key_b = 0;
+        int32_t ta, la, ba, ra, tb, lb, bb, rb;
+        psd_document_get_layer_name(a, i, &name_a, &len_a);
+        psd_document_get_layer_name(b, i, &name_b, &len_b);
+        psd_document_get_layer_blend_mode(a, i, &sig_a, &key_a);
+        psd_document_get_layer_blend_mode(b, i, &sig_b, &key_b);
+        psd_document_get_layer_bounds(a, i, &ta, &la, &ba, &ra);
+        psd_document_get_layer_bounds(b, i, &tb, &lb, &bb, &rb);
+        if (len_a != len_b || (len_a && memcmp(name_a, name_b, len_a) != 0)) return false;
+        if (sig_a != sig_b || key_a != key_b) return false;
+        if (ta != tb || la != lb || ba != bb || ra != rb) return false;
+    }
+    return true;
+}
+
+static bool same_layer_pixels(psd_document_t *a, psd_document_t *b)
+{
+    int32_t n = 0;
+    psd_document_get_layer_count(a, &n);
+    for (int32_t i = 0; i < n; i++) {
+        size_t ca = 0, cb = 0;
+        psd_document_get_layer_channel_count(a, i, &ca);
+        psd_document_get_layer_channel_count(b, i, &cb);
+        if (ca != cb) return false;
+        for (size_t c = 0; c < ca; c++) {
+            const uint8_t *da = NULL, *db = NULL;
+            uint64_t la = 0, lb = 0;
+            if (psd_document_get_layer_channel_data(a, i, c, NULL, &da, &la, NULL) != PSD_OK ||
+                psd_document_get_layer_channel_data(b, i, c, NULL, &db, &lb, NULL) != PSD_OK) {
+                return false;
+            }
+            if (la != lb || !da || !db || memcmp(da, db, (size_t)la) != 0) return false;
+        }
+    }
+    return true;
+}
+
+static bool same_composite(psd_document_t *a, psd_document_t *b)
+{
+    const uint8_t *da = NULL, *db = NULL;
+    uint64_t la = 0, lb = 0;
+    uint32_t comp_a = 0, comp_b = 0;
+    if (psd_document_get_composite_image(a, &da, &la, &comp_a) != PSD_OK ||
+        psd_document_get_composite_image(b, &db, &lb, &comp_b) != PSD_OK) {
+        return false;
+    }
+    return la == lb && la > 0 && comp_a == comp_b && memcmp(da, db, (size_t)la) == 0;
+}
+
+static void test_default_options(void)
+{
+    fprintf(stdout, "\n=== Test: NULL options match psd_parse_ex ===\n");
+
+    size_t size = 0;
+    uint8_t *bytes = build_sample(&size);
+    ASSERT_TRUE(bytes != NULL, "build synthetic document");
+    if (!bytes) return;
+
+    psd_stream_t *s1 = psd_stream_create_buffer(NULL, bytes, size);
+    psd_stream_t *s2 = psd_stream_create_buffer(NULL, bytes, size);
+    psd_status_t status = PSD_ERR_INVALID_ARGUMENT;
+    psd_document_t *full = psd_parse_ex(s1, NULL, NULL);
+    psd_document_t *opts = psd_parse_with_options(s2, NULL, NULL, &status);
+    ASSERT_TRUE(full && opts && status == PSD_OK, "parse with NULL options");
+
+    /* Nothing was deferred, so the stream may go away immediately */
+    psd_stream_destroy(s2);
+    if (full && opts) {
+        ASSERT_TRUE(same_structure(full, opts), "structure matches");
+        ASSERT_TRUE(same_layer_pixels(full, opts), "channel data matches");
+        ASSERT_TRUE(same_composite(full, opts), "composite matches");
+    }
+
+    ASSERT_TRUE(psd_parse_with_options(NULL, NULL, NULL, &status) == NULL &&
+                status == PSD_ERR_NULL_POINTER, "NULL stream rejected");
+
+    psd_document_free(full);
+    psd_document_free(opts);
+    psd_stream_destroy(s1);
+    free(bytes);
+}
+
+static void test_skip_everything(void)
+{
+    fprintf(stdout, "\n=== Test: deferred sections load on demand ===\n");
+
+    size_t size = 0;
+    uint8_t *bytes = build_sample(&size);
+    ASSERT_TRUE(bytes != NULL, "build synthetic document");
+    if (!bytes) return;
+
+    psd_stream_t *s1 = psd_stream_create_buffer(NULL, bytes, size);
+    psd_stream_t *s2 = psd_stream_create_buffer(NULL, bytes, size);
+    psd_document_t *full = psd_parse(s1, NULL);
+    psd_document_t *lazy = parse_flags(s2, PSD_PARSE_SKIP_LAYER_PIXELS |
+                                           PSD_PARSE_SKIP_COMPOSITE |
+                                           PSD_PARSE_SKIP_RESOURCES);
+    ASSERT_TRUE(full && lazy, "parse full and metadata-only");
+
+    if (full && lazy) {
+        uint32_t w = 0, h = 0;
+        psd_document_get_dimensions(lazy, &w, &h);
+        ASSERT_TRUE(w == 32 && h == 24, "dimensions available");
+        ASSERT_TRUE(same_structure(full, lazy), "layer names, bounds and blend modes match");
+
+        /* Scramble the stream position: loads must seek themselves */
+        psd_stream_seek(s2, 0);
+        ASSERT_TRUE(same_layer_pixels(full, lazy), "deferred channel data matches");
+        ASSERT_TRUE(same_composite(full, lazy), "deferred composite matches");
+
+        size_t count = 0, index = 0;
+        uint16_t id = 0;
+        const uint8_t *data = NULL;
+        uint64_t length = 0;
+        ASSERT_TRUE(psd_document_get_resource_count(lazy, &count) == PSD_OK && count == 1,
+                    "deferred resource count");
+        bool found = psd_document_find_resource(lazy, 1060, &index) == PSD_OK &&
+                     psd_document_get_resource(lazy, index, &id, &data, &length) == PSD_OK;
+        ASSERT_TRUE(found && length == sizeof(xmp) && memcmp(data, xmp, sizeof(xmp)) == 0,
+                    "deferred resource data matches");
+
+        /* Second access is served from the loaded copy */
+        ASSERT_TRUE(same_layer_pixels(full, lazy), "repeat channel access");
+    }
+
+    psd_document_free(full);
+    psd_document_free(lazy);
+    psd_stream_destroy(s1);
+    psd_stream_destroy(s2);
+    free(bytes);
+}
+
+static void test_skip_single_flags(void)
+{
+    fprintf(stdout, "\n=== Test: individual skip flags ===\n");
+
+    size_t size = 0;
+    uint8_t *bytes = build_sample(&size);
+    ASSERT_TRUE(bytes != NULL, "build synthetic document");
+    if (!bytes) return;
+
+    static const uint32_t flags[] = {
+        PSD_PARSE_SKIP_LAYER_PIXELS,
+        PSD_PARSE_SKIP_COMPOSITE,
+        PSD_PARSE_SKIP_RESOURCES,
+    };
+
+    psd_stream_t *s1 = psd_stream_create_buffer(NULL, bytes, size);
+    psd_document_t *full = psd_parse(s1, NULL);
+
+    for (size_t f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+        psd_stream_t *s2 = psd_stream_create_buffer(NULL, bytes, size);
+        psd_document_t *lazy = parse_flags(s2, flags[f]);
+        ASSERT_TRUE(full && lazy, "parse with one skip flag");
+        if (full && lazy) {
+            size_t count = 0;
+            psd_document_get_resource_count(lazy, &count);
+            ASSERT_TRUE(same_structure(full, lazy) && same_layer_pixels(full, lazy) &&
+                        same_composite(full, lazy) && count == 1,
+                        "document contents match full parse");
+        }
+        psd_document_free(lazy);
+        psd_stream_destroy(s2);
+    }
+
+    psd_document_free(full);
+    psd_stream_destroy(s1);
+    free(bytes);
+}
+
+int run_parse_option_tests(void)
+{
+    fprintf(stdout, "=== Parse option tests ===\n");
+
+    test_default_options();
+    test_skip_everything();
+    test_skip_single_flags();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,481 @@
+/**
+ * @file test_push_parser.c
+ * @brief Tests for the push parser
+ *
+ * Documents are fed in chunks of various sizes and every event is checked
+ * against what psd_parse() reads from the same bytes: the header and
+ * resources before the layer records, each record before its channels, and
+ * composite rows as their data arrives.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+/* What the events reported, checked against a pulled document */
+typedef struct {
+    psd_document_t *reference;
+    size_t fed;                  /* Bytes fed before the current call */
+    int headers;
+    int resources;
+    size_t resources_at;         /* Bytes fed when resources were reported */
+    int32_t records;
+    size_t first_record_at;
+    bool records_match;
+    int channels;
+    bool channels_match;
+    bool channel_before_record;
+    uint8_t *composite;          /* Planes assembled from the rows */
+    size_t composite_size;
+    size_t row_bytes;
+    uint64_t rows;
+    size_t first_row_at;
+    bool rows_in_order;
+    psd_status_t abort_with;     /* Returned from the first record, if set */
+} recorder_t;
+
+static psd_status_t on_header(void *user_data, psd_document_t *doc)
+{
+    recorder_t *r = (recorder_t *)user_data;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t ref_width = 0;
+    uint32_t ref_height = 0;
+    psd_document_get_dimensions(doc, &width, &height);
+    psd_document_get_dimensions(r->reference, &ref_width, &ref_height);
+    if (width == ref_width && height == ref_height) {
+        r->headers++;
+    }
+    return PSD_OK;
+}
+
+static psd_status_t on_resources(void *user_data, psd_document_t *doc)
+{
+    recorder_t *r = (recorder_t *)user_data;
+    size_t count = 0;
+    size_t ref_count = 0;
+    psd_document_get_resource_count(doc, &count);
+    psd_document_get_resource_count(r->reference, &ref_count);
+    bool same = count == ref_count;
+    for (size_t i = 0; same && i < count; i++) {
+        uint16_t id = 0;
+        uint16_t ref_id = 0;
+        const uint8_t *data = NULL;
+        const uint8_t *ref_data = NULL;
+        uint64_t length = 0;
+        uint64_t ref_length = 0;
+        psd_document_get_resource(doc, i, &id, &data, &length);
+        psd_document_get_resource(r->reference, i, &ref_id, &ref_data, &ref_length);
+        same = id == ref_id && length == ref_length &&
+               (length == 0 || memcmp(data, ref_data, (size_t)length) == 0);
+    }
+    if (same) {
+        r->resources++;
+    }
+    r->resources_at = r->fed;
+    return PSD_OK;
+}
+
+static psd_status_t on_layer_record(void *user_data, psd_document_t *doc, int32_t layer_index)
+{
+    recorder_t *r = (recorder_t *)user_data;
+    if (r->records == 0) {
+        r->first_record_at = r->fed;
+    }
+    if (r->abort_with != PSD_OK) {
+        r->records++;
+        return r->abort_with;
+    }
+
+    int32_t count = 0;
+    psd_document_get_layer_count(doc, &count);
+    int32_t bounds[4];
+    int32_t ref_bounds[4];
+    const uint8_t *name = NULL;
+    const uint8_t *ref_name = NULL;
+    size_t name_length = 0;
+    size_t ref_name_length = 0;
+    bool same = layer_index == r->records && count == layer_index + 1 &&
+                psd_document_get_layer_bounds(doc, layer_index, &bounds[0], &bounds[1],
+                                              &bounds[2], &bounds[3]) == PSD_OK &&
+                psd_document_get_layer_bounds(r->reference, layer_index, &ref_bounds[0],
+                                              &ref_bounds[1], &ref_bounds[2],
+                                              &ref_bounds[3]) == PSD_OK &&
+                memcmp(bounds, ref_bounds, sizeof(bounds)) == 0 &&
+                psd_document_get_layer_name(doc, layer_index, &name, &name_length) == PSD_OK &&
+                psd_document_get_layer_name(r->reference, layer_index, &ref_name,
+                                            &ref_name_length) == PSD_OK &&
+                name_length == ref_name_length && memcmp(name, ref_name, name_length) == 0;
+    if (!same) {
+        r->records_match = false;
+    }
+    r->records++;
+    return PSD_OK;
+}
+
+static psd_status_t on_layer_channel(void *user_data, psd_document_t *doc, int32_t layer_index,
+                                     size_t channel_index)
+{
+    recorder_t *r = (recorder_t *)user_data;
+    r->channels++;
+    if (layer_index >= r->records) {
+        r->channel_before_record = true;
+    }
+
+    int32_t top = 0;
+    int32_t left = 0;
+    int32_t bottom = 0;
+    int32_t right = 0;
+    if (psd_document_get_layer_bounds(doc, layer_index, &top, &left, &bottom, &right) !=
+        PSD_OK) {
+        r->channels_match = false;
+        return PSD_OK;
+    }
+    uint16_t depth = 0;
+    psd_document_get_depth(doc, &depth);
+    size_t row = (size_t)(right - left) * (depth / 8u);
+    size_t size = row * (size_t)(bottom - top);
+    if (size == 0) {
+        return PSD_OK;
+    }
+
+    uint8_t *pushed = (uint8_t *)malloc(size);
+    uint8_t *pulled = (uint8_t *)malloc(size);
+    bool same = pushed && pulled &&
+                psd_document_decode_layer_channel_into(doc, layer_index, channel_index, pushed,
+                                                       row) == PSD_OK &&
+                psd_document_decode_layer_channel_into(r->reference, layer_index, channel_index,
+                                                       pulled, row) == PSD_OK &&
+                memcmp(pushed, pulled, size) == 0;
+    if (!same) {
+        r->channels_match = false;
+    }
+    free(pushed);
+    free(pulled);
+    return PSD_OK;
+}
+
+static psd_status_t on_composite_row(void *user_data, psd_document_t *doc, uint16_t channel,
+                                     uint32_t y, const uint8_t *row, size_t row_bytes)
+{
+    recorder_t *r = (recorder_t *)user_data;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    psd_document_get_dimensions(doc, &width, &height);
+    if (r->rows == 0) {
+        r->first_row_at = r->fed;
+    }
+    if ((uint64_t)channel * height + y != r->rows || row_bytes != r->row_bytes) {
+        r->rows_in_order = false;
+    } else if ((r->rows + 1) * row_bytes <= r->composite_size) {
+        memcpy(r->composite + r->rows * row_bytes, row, row_bytes);
+    }
+    r->rows++;
+    return PSD_OK;
+}
+
+static const psd_parser_callbacks_t recorder_callbacks = {
+    on_header, on_resources, on_layer_record, on_layer_channel, on_composite_row, NULL
+};
+
+static void recorder_init(recorder_t *r, psd_document_t *reference)
+{
+    memset(r, 0, sizeof(*r));
+    r->reference = reference;
+    r->records_match = true;
+    r->channels_match = true;
+    r->rows_in_order = true;
+
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint16_t depth = 0;
+    psd_document_get_dimensions(reference, &width, &height);
+    psd_document_get_depth(reference, &depth);
+    r->row_bytes = (size_t)width * (depth / 8u);
+    if (psd_document_get_composite_image(reference, &data, &length, NULL) == PSD_OK && data) {
+        r->composite_size = (size_t)length;
+        r->composite = (uint8_t *)calloc(1, r->composite_size);
+    }
+}
+
+/**
+ * @brief Feed bytes in chunks of chunk bytes, then finish
+ */
+static psd_status_t push_document(const uint8_t *bytes, size_t size, size_t chunk,
+                                  recorder_t *r, psd_parser_t **out_parser)
+{
+    psd_parser_callbacks_t callbacks = recorder_callbacks;
+    callbacks.user_data = r;
+    psd_parser_t *parser = NULL;
+    psd_status_t status = psd_parser_create(NULL, &callbacks, &parser);
+    for (size_t pos = 0; status == PSD_OK && pos < size; pos += chunk) {
+        size_t n = (size - pos < chunk) ? size - pos : chunk;
+        r->fed = pos;
+        status = psd_parser_feed(parser, bytes + pos, n);
+    }
+    r->fed = size;
+    if (status == PSD_OK) {
+        status = psd_parser_finish(parser);
+    }
+    *out_parser = parser;
+    return status;
+}
+
+/**
+ * @brief Push a built document at several chunk sizes and compare with psd_parse()
+ */
+static void check_round(const psd_test_doc_spec_t *spec, const char *what)
+{
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *reference = stream ? psd_parse(stream, NULL) : NULL;
+    const uint8_t *composite = NULL;
+    uint64_t composite_length = 0;
+    if (reference) {
+        psd_document_get_composite_image(reference, &composite, &composite_length, NULL);
+    }
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "%s: reference parse", what);
+    ASSERT_TRUE(reference != NULL && composite != NULL, msg);
+    if (!reference || !composite) {
+        psd_document_free(reference);
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    int32_t layer_count = 0;
+    psd_document_get_layer_count(reference, &layer_count);
+    int expected_channels = 0;
+    for (int32_t i = 0; i < layer_count; i++) {
+        size_t n = 0;
+        psd_document_get_layer_channel_count(reference, i, &n);
+        expected_channels += (int)n;
+    }
+
+    const size_t chunks[] = { 1, 7, 64, 1000, size };
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        recorder_t r;
+        recorder_init(&r, reference);
+        psd_parser_t *parser = NULL;
+        psd_status_t status = push_document(bytes, size, chunks[c], &r, &parser);
+
+        snprintf(msg, sizeof(msg), "%s, %zu-byte chunks: parsed", what, chunks[c]);
+        ASSERT_TRUE(status == PSD_OK, msg);
+        snprintf(msg, sizeof(msg), "%s, %zu-byte chunks: header and resources once", what,
+                 chunks[c]);
+        ASSERT_TRUE(r.headers == 1 && r.resources == 1, msg);
+        snprintf(msg, sizeof(msg), "%s, %zu-byte chunks: every record matches", what,
+                 chunks[c]);
+        ASSERT_TRUE(r.records == layer_count && r.records_match, msg);
+        snprintf(msg, sizeof(msg), "%s, %zu-byte chunks: every channel decodes the same", what,
+                 chunks[c]);
+        ASSERT_TRUE(r.channels == expected_channels && r.channels_match &&
+                        !r.channel_before_record,
+                    msg);
+        snprintf(msg, sizeof(msg), "%s, %zu-byte chunks: composite rows match", what,
+                 chunks[c]);
+        ASSERT_TRUE(r.rows_in_order && r.rows * r.row_bytes == composite_length &&
+                        r.composite && memcmp(r.composite, composite, r.composite_size) == 0,
+                    msg);
+        if (chunks[c] < size) {
+            /* Backends without streaming inflate deliver ZIP rows at finish */
+            bool rows_early = spec->composite_compression >= 2 || r.first_row_at < size;
+            snprintf(msg, sizeof(msg), "%s, %zu-byte chunks: events before the end", what,
+                     chunks[c]);
+            ASSERT_TRUE(r.resources_at < size && r.first_record_at < size && rows_early, msg);
+        }
+
+        psd_document_t *doc = NULL;
+        int32_t count = -1;
+        ASSERT_TRUE(psd_parser_get_document(parser, &doc) == PSD_OK && doc &&
+                        psd_document_get_layer_count(doc, &count) == PSD_OK &&
+                        count == layer_count,
+                    "document kept after finish");
+
+        free(r.composite);
+        psd_parser_destroy(parser);
+    }
+
+    psd_document_free(reference);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_round_trips(void)
+{
+    fprintf(stdout, "\n=== Test: pushed documents match psd_parse ===\n");
+
+    static const uint8_t resource[5] = { 'h', 'e', 'l', 'l', 'o' };
+    psd_test_resource_t resources[1] = { { 1060, resource, sizeof(resource) } };
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.resources = resources;
+    spec.resource_count = 1;
+    check_round(&spec, "PSD 8-bit RLE");
+
+    psd_test_default_spec(&spec);
+    spec.layer_compression = 0;
+    spec.composite_compression = 0;
+    check_round(&spec, "PSD 8-bit RAW");
+
+    psd_test_default_spec(&spec);
+    spec.psb = true;
+    spec.depth = 16;
+    check_round(&spec, "PSB 16-bit RLE");
+
+    psd_test_default_spec(&spec);
+    spec.layer_count = 0;
+    check_round(&spec, "PSD without layers");
+
+#ifdef OPENPSD_TEST_HAVE_ZIP
+    psd_test_default_spec(&spec);
+    spec.layer_compression = 2;
+    spec.composite_compression = 2;
+    check_round(&spec, "PSD 8-bit ZIP");
+
+    psd_test_default_spec(&spec);
+    spec.depth = 16;
+    spec.layer_compression = 3;
+    spec.composite_compression = 3;
+    spec.zip_raw_deflate = true;
+    check_round(&spec, "PSD 16-bit raw DEFLATE with prediction");
+
+    psd_test_default_spec(&spec);
+    spec.psb = true;
+    spec.depth = 32;
+    spec.composite_compression = 3;
+    check_round(&spec, "PSB 32-bit ZIP with prediction");
+#endif
+}
+
+static void test_errors(void)
+{
+    fprintf(stdout, "\n=== Test: truncated and invalid input ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *reference = stream ? psd_parse(stream, NULL) : NULL;
+    ASSERT_TRUE(reference != NULL, "reference parse");
+    if (!reference) {
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    recorder_t r;
+    recorder_init(&r, reference);
+    psd_parser_t *parser = NULL;
+    psd_status_t status = push_document(bytes, size - 10, 100, &r, &parser);
+    ASSERT_TRUE(status == PSD_ERR_STREAM_EOF && r.records == 3 && r.rows > 0,
+                "truncated composite reported at finish, earlier rows delivered");
+    ASSERT_TRUE(psd_parser_finish(parser) == PSD_ERR_STREAM_EOF &&
+                    psd_parser_feed(parser, bytes, 1) == PSD_ERR_STREAM_EOF,
+                "error is sticky");
+    psd_parser_destroy(parser);
+    free(r.composite);
+
+    recorder_init(&r, reference);
+    status = push_document(bytes, 32, 8, &r, &parser);
+    ASSERT_TRUE(status == PSD_ERR_STREAM_EOF && r.headers == 1 && r.resources == 0,
+                "file ending in the resources");
+    psd_parser_destroy(parser);
+    free(r.composite);
+
+    /* Stop before the composite compression field */
+    int64_t composite_at = -1;
+    for (size_t i = 0; composite_at < 0 && i < size; i++) {
+        recorder_init(&r, reference);
+        status = push_document(bytes, i, size, &r, &parser);
+        if (status == PSD_OK) {
+            composite_at = (int64_t)i;
+        }
+        psd_parser_destroy(parser);
+        free(r.composite);
+    }
+    ASSERT_TRUE(composite_at > 0 && (size_t)composite_at < size,
+                "file may end where the composite starts");
+
+    recorder_init(&r, reference);
+    r.abort_with = PSD_ERR_UNSUPPORTED_FEATURE;
+    status = push_document(bytes, size, size, &r, &parser);
+    ASSERT_TRUE(status == PSD_ERR_UNSUPPORTED_FEATURE && r.records == 1 && r.rows == 0,
+                "callback status stops the parse");
+    psd_parser_destroy(parser);
+    free(r.composite);
+
+    uint8_t bad[32];
+    memcpy(bad, bytes, sizeof(bad));
+    bad[0] = 'X';
+    ASSERT_TRUE(psd_parser_create(NULL, NULL, &parser) == PSD_OK, "create without callbacks");
+    psd_document_t *doc = (psd_document_t *)1;
+    ASSERT_TRUE(psd_parser_get_document(parser, &doc) == PSD_OK && doc == NULL,
+                "no document before the header");
+    ASSERT_TRUE(psd_parser_feed(parser, bad, sizeof(bad)) == PSD_ERR_INVALID_FILE_FORMAT,
+                "bad signature rejected");
+    psd_parser_destroy(parser);
+
+    ASSERT_TRUE(psd_parser_create(NULL, NULL, &parser) == PSD_OK &&
+                    psd_parser_feed(parser, bytes, size) == PSD_OK &&
+                    psd_parser_feed(parser, NULL, 0) == PSD_OK &&
+                    psd_parser_finish(parser) == PSD_OK &&
+                    psd_parser_feed(parser, bytes, 1) == PSD_ERR_INVALID_ARGUMENT,
+                "no events without callbacks; feeding after finish rejected");
+    psd_parser_destroy(parser);
+
+    ASSERT_TRUE(psd_parser_create(NULL, NULL, NULL) == PSD_ERR_NULL_POINTER &&
+                    psd_parser_feed(NULL, bytes, 1) == PSD_ERR_NULL_POINTER &&
+                    psd_parser_finish(NULL) == PSD_ERR_NULL_POINTER,
+                "NULL arguments rejected");
+    psd_parser_destroy(NULL);
+
+    psd_document_free(reference);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+int run_push_parser_tests(void)
+{
+    fprintf(stdout, "=== Push parser tests ===\n");
+
+    test_round_trips();
+    test_errors();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
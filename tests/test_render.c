@@ -0,0 +1,1158 @@
+/**
+ * @file test_render.c
+ * @brief Tests for region and scanline rendering
+ *
+ * Region renders must match the corresponding window of a full render for
+ * composites and layers, across compressions, depths and file versions.
+ * Specialized row kernels must agree with the reference conversion for every
+ * color mode and alpha layout they cover, and render targets must receive
+ * the same pixels swizzled, premultiplied and placed at their offset.
+ * Bitmap rows and indexed palettes (with a transparent index) must expand
+ * correctly from any starting pixel. Uncached layer renders must match cached
+ * ones and leave nothing decoded behind.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+typedef struct {
+    uint8_t *rgba;
+    uint32_t width;
+    uint32_t rows;
+    uint32_t stop_after;
+} scanline_sink_t;
+
+static psd_status_t collect_row(void *user_data, uint32_t y, const uint8_t *rgba, uint32_t width)
+{
+    scanline_sink_t *sink = (scanline_sink_t *)user_data;
+    if (sink->stop_after && sink->rows == sink->stop_after) {
+        return PSD_ERR_STREAM_WRITE;
+    }
+    if (width != sink->width || y != sink->rows) {
+        return PSD_ERR_CORRUPT_DATA;
+    }
+    memcpy(sink->rgba + (size_t)y * width * 4u, rgba, (size_t)width * 4u);
+    sink->rows++;
+    return PSD_OK;
+}
+
+/* Compare a rect render (written with a padded stride) to the full image */
+static bool window_matches(const uint8_t *full, uint32_t full_width,
+                           const psd_rect_t *r, const uint8_t *out, size_t stride)
+{
+    size_t row = (size_t)(r->right - r->left) * 4u;
+    for (int32_t y = r->top; y < r->bottom; y++) {
+        const uint8_t *a = full + ((size_t)y * full_width + (size_t)r->left) * 4u;
+        const uint8_t *b = out + (size_t)(y - r->top) * stride;
+        if (memcmp(a, b, row) != 0) return false;
+    }
+    return true;
+}
+
+/* Render a list of rects with a padded stride and compare each to full */
+static bool rects_match(psd_document_t *doc, int32_t layer_index,
+                        const uint8_t *full, uint32_t full_width,
+                        const psd_rect_t *rects, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const psd_rect_t *r = &rects[i];
+        size_t stride = (size_t)(r->right - r->left) * 4u + 12u;
+        uint8_t *out = (uint8_t *)malloc(stride * (size_t)(r->bottom - r->top) + 1u);
+        psd_status_t st = !out ? PSD_ERR_OUT_OF_MEMORY
+            : (layer_index < 0)
+                ? psd_document_render_composite_rgba8_rect(doc, r, out, stride)
+                : psd_document_render_layer_rgba8_rect(doc, layer_index, r, out, stride);
+        bool ok = st == PSD_OK && window_matches(full, full_width, r, out, stride);
+        free(out);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static void check_composite_regions(uint16_t compression, uint16_t depth, bool psb)
+{
+    char msg[128];
+    char label[48];
+    (void)snprintf(label, sizeof(label), "%s %u-bit %s", psb ? "PSB" : "PSD",
+                   (unsigned)depth, compression ? "RLE" : "RAW");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.composite_compression = compression;
+    spec.depth = depth;
+    spec.psb = psb;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *s1 = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_stream_t *s2 = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *full_doc = s1 ? psd_parse(s1, NULL) : NULL;
+    psd_document_t *doc = s2 ? psd_parse(s2, NULL) : NULL;
+
+    size_t full_size = (size_t)spec.width * spec.height * 4u;
+    uint8_t *full = (uint8_t *)malloc(full_size);
+    bool ready = full_doc && doc && full &&
+                 psd_document_render_composite_rgba8(full_doc, full, full_size, NULL) == PSD_OK;
+    (void)snprintf(msg, sizeof(msg), "%s: full composite render", label);
+    ASSERT_TRUE(ready, msg);
+
+    if (ready) {
+        static const psd_rect_t rects[] = {
+            { 0, 0, 24, 32 },   /* whole image */
+            { 5, 3, 17, 29 },   /* interior */
+            { 23, 31, 24, 32 }, /* last pixel */
+            { 10, 0, 11, 32 },  /* single band */
+        };
+        bool ok = rects_match(doc, -1, full, spec.width, rects, sizeof(rects) / sizeof(rects[0]));
+
+        /* Rows in reverse order make the RLE cursor rewind */
+        for (int32_t y = (int32_t)spec.height - 1; ok && y >= 0; y--) {
+            psd_rect_t band = { y, 0, y + 1, (int32_t)spec.width };
+            ok = rects_match(doc, -1, full, spec.width, &band, 1);
+        }
+        (void)snprintf(msg, sizeof(msg), "%s: composite rects match full render", label);
+        ASSERT_TRUE(ok, msg);
+
+        scanline_sink_t sink = { NULL, spec.width, 0, 0 };
+        sink.rgba = (uint8_t *)malloc(full_size);
+        psd_status_t st = sink.rgba
+            ? psd_document_render_composite_rgba8_scanlines(doc, NULL, collect_row, &sink)
+            : PSD_ERR_OUT_OF_MEMORY;
+        (void)snprintf(msg, sizeof(msg), "%s: composite scanlines match full render", label);
+        ASSERT_TRUE(st == PSD_OK && sink.rows == spec.height &&
+                    memcmp(sink.rgba, full, full_size) == 0, msg);
+        free(sink.rgba);
+    }
+
+    free(full);
+    psd_document_free(full_doc);
+    psd_document_free(doc);
+    psd_stream_destroy(s1);
+    psd_stream_destroy(s2);
+    free(bytes);
+}
+
+static void test_composite_regions(void)
+{
+    fprintf(stdout, "\n=== Test: composite region renders ===\n");
+
+    for (uint16_t compression = 0; compression <= 1; compression++) {
+        check_composite_regions(compression, 8, false);
+        check_composite_regions(compression, 16, false);
+        check_composite_regions(compression, 8, true);
+    }
+}
+
+static void check_layer_regions(uint16_t compression)
+{
+    char msg[128];
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_compression = compression;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *s1 = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_stream_t *s2 = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *full_doc = s1 ? psd_parse(s1, NULL) : NULL;
+
+    /* Region renders also work on payloads deferred at parse time */
+    psd_parse_options_t options = { PSD_PARSE_SKIP_LAYER_PIXELS };
+    psd_document_t *doc = s2 ? psd_parse_with_options(s2, NULL, &options, NULL) : NULL;
+
+    (void)snprintf(msg, sizeof(msg), "%s layers: parse", compression ? "RLE" : "RAW");
+    ASSERT_TRUE(full_doc && doc, msg);
+
+    for (int32_t layer = 0; full_doc && doc && layer < (int32_t)spec.layer_count; layer++) {
+        uint32_t w = spec.width - (uint32_t)layer;
+        uint32_t h = spec.height - (uint32_t)layer;
+        size_t full_size = (size_t)w * h * 4u;
+        uint8_t *full = (uint8_t *)malloc(full_size);
+        bool ok = full && psd_document_render_layer_rgba8(full_doc, layer, full, full_size, NULL) == PSD_OK;
+
+        psd_rect_t rects[] = {
+            { 0, 0, (int32_t)h, (int32_t)w },
+            { 2, 4, (int32_t)h - 3, (int32_t)w - 1 },
+            { (int32_t)h - 1, 0, (int32_t)h, (int32_t)w },
+        };
+        ok = ok && rects_match(doc, layer, full, w, rects, sizeof(rects) / sizeof(rects[0]));
+
+        scanline_sink_t sink = { NULL, w - 4u, 0, 0 };
+        psd_rect_t window = { 1, 2, (int32_t)h, (int32_t)w - 2 };
+        size_t window_size = (size_t)(w - 4u) * (h - 1u) * 4u;
+        sink.rgba = (uint8_t *)malloc(window_size);
+        ok = ok && sink.rgba &&
+             psd_document_render_layer_rgba8_scanlines(doc, layer, &window, collect_row, &sink) == PSD_OK &&
+             sink.rows == h - 1u &&
+             window_matches(full, w, &window, sink.rgba, (size_t)(w - 4u) * 4u);
+
+        (void)snprintf(msg, sizeof(msg), "%s layer %d: rects and scanlines match full render",
+                       compression ? "RLE" : "RAW", (int)layer);
+        ASSERT_TRUE(ok, msg);
+        free(sink.rgba);
+        free(full);
+    }
+
+    psd_document_free(full_doc);
+    psd_document_free(doc);
+    psd_stream_destroy(s1);
+    psd_stream_destroy(s2);
+    free(bytes);
+}
+
+static void test_layer_regions(void)
+{
+    fprintf(stdout, "\n=== Test: layer region renders ===\n");
+
+    check_layer_regions(0);
+    check_layer_regions(1);
+}
+
+static void test_region_arguments(void)
+{
+    fprintf(stdout, "\n=== Test: region render arguments ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+    ASSERT_TRUE(doc != NULL, "parse synthetic document");
+
+    if (doc) {
+        uint8_t out[64 * 4];
+        psd_rect_t outside = { 0, 0, 25, 32 };
+        psd_rect_t negative = { -1, 0, 4, 4 };
+        psd_rect_t inverted = { 4, 4, 2, 8 };
+        psd_rect_t row = { 0, 0, 1, 32 };
+        psd_rect_t empty = { 3, 3, 3, 3 };
+
+        ASSERT_TRUE(psd_document_render_composite_rgba8_rect(doc, &outside, out, sizeof(out)) == PSD_ERR_OUT_OF_RANGE,
+                    "rect past the bottom rejected");
+        ASSERT_TRUE(psd_document_render_composite_rgba8_rect(doc, &negative, out, sizeof(out)) == PSD_ERR_OUT_OF_RANGE,
+                    "negative rect rejected");
+        ASSERT_TRUE(psd_document_render_composite_rgba8_rect(doc, &inverted, out, sizeof(out)) == PSD_ERR_OUT_OF_RANGE,
+                    "inverted rect rejected");
+        ASSERT_TRUE(psd_document_render_composite_rgba8_rect(doc, &row, out, 32u * 4u - 1u) == PSD_ERR_INVALID_ARGUMENT,
+                    "short stride rejected");
+        ASSERT_TRUE(psd_document_render_composite_rgba8_rect(doc, &empty, out, 0) == PSD_OK,
+                    "empty rect is a no-op");
+        ASSERT_TRUE(psd_document_render_layer_rgba8_rect(doc, 99, &row, out, sizeof(out)) == PSD_ERR_OUT_OF_RANGE,
+                    "bad layer index rejected");
+        ASSERT_TRUE(psd_document_render_composite_rgba8_scanlines(doc, NULL, NULL, NULL) == PSD_ERR_NULL_POINTER,
+                    "NULL callback rejected");
+
+        uint8_t *rows = (uint8_t *)malloc((size_t)spec.width * spec.height * 4u);
+        scanline_sink_t sink = { rows, spec.width, 0, 5 };
+        psd_status_t st = rows
+            ? psd_document_render_composite_rgba8_scanlines(doc, NULL, collect_row, &sink)
+            : PSD_ERR_OUT_OF_MEMORY;
+        ASSERT_TRUE(st == PSD_ERR_STREAM_WRITE && sink.rows == 5,
+                    "callback status stops the render");
+        free(rows);
+    }
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+/* Reference conversion of one pixel, straight from the planar composite */
+static void reference_pixel(uint16_t mode, uint16_t channels, const uint8_t *planes,
+                            size_t plane_bytes, size_t offset, uint8_t *px)
+{
+    uint8_t v[5] = { 0, 0, 0, 0, 255 };
+    for (uint16_t c = 0; c < channels && c < 5; c++) {
+        v[c] = planes[(size_t)c * plane_bytes + offset];
+    }
+    if (mode == 1) {
+        px[0] = px[1] = px[2] = v[0];
+        px[3] = (channels > 1) ? v[1] : 255;
+    } else if (mode == 4) {
+        for (int i = 0; i < 3; i++) {
+            unsigned sum = (unsigned)v[i] + v[3];
+            px[i] = (uint8_t)(255u - (sum > 255u ? 255u : sum));
+        }
+        px[3] = (channels > 4) ? v[4] : 255;
+    } else {
+        px[0] = v[0];
+        px[1] = v[1];
+        px[2] = v[2];
+        px[3] = (channels > 3) ? v[3] : 255;
+    }
+}
+
+static void check_kernel_layout(uint16_t mode, uint16_t channels, uint16_t depth)
+{
+    char msg[128];
+    char label[48];
+    (void)snprintf(label, sizeof(label), "mode %u, %u channels, %u-bit",
+                   (unsigned)mode, (unsigned)channels, (unsigned)depth);
+
+    /* Odd width so vector loops leave a scalar tail */
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = 37;
+    spec.color_mode = mode;
+    spec.channels = channels;
+    spec.depth = depth;
+    spec.composite_compression = 0;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+
+    const uint8_t *planes = NULL;
+    uint64_t planes_len = 0;
+    size_t full_size = (size_t)spec.width * spec.height * 4u;
+    uint8_t *full = (uint8_t *)malloc(full_size);
+    uint8_t *expected = (uint8_t *)malloc(full_size);
+    bool ready = doc && full && expected &&
+                 psd_document_get_composite_image(doc, &planes, &planes_len, NULL) == PSD_OK &&
+                 planes != NULL;
+    (void)snprintf(msg, sizeof(msg), "%s: document parsed", label);
+    ASSERT_TRUE(ready, msg);
+
+    if (ready) {
+        /* 16-bit samples convert through their most significant byte */
+        size_t bps = depth / 8u;
+        size_t plane_bytes = (size_t)spec.width * spec.height * bps;
+        for (size_t i = 0; i < (size_t)spec.width * spec.height; i++) {
+            reference_pixel(mode, channels, planes, plane_bytes, i * bps, expected + i * 4u);
+        }
+
+        psd_status_t st = psd_document_render_composite_rgba8(doc, full, full_size, NULL);
+        (void)snprintf(msg, sizeof(msg), "%s: full render matches reference", label);
+        ASSERT_TRUE(st == PSD_OK && memcmp(full, expected, full_size) == 0, msg);
+
+        static const psd_rect_t rects[] = {
+            { 0, 0, 24, 37 },  /* whole rows */
+            { 1, 3, 4, 36 },   /* odd offset, two vector blocks and a tail */
+            { 7, 17, 9, 32 },  /* shorter than one vector block */
+            { 2, 5, 3, 6 },    /* single pixel */
+        };
+        bool ok = rects_match(doc, -1, expected, spec.width, rects, sizeof(rects) / sizeof(rects[0]));
+        (void)snprintf(msg, sizeof(msg), "%s: rect renders match reference", label);
+        ASSERT_TRUE(ok, msg);
+    }
+
+    free(full);
+    free(expected);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_row_kernels(void)
+{
+    fprintf(stdout, "\n=== Test: row conversion kernels ===\n");
+
+    static const uint16_t layouts[][2] = {
+        { 3, 3 }, { 3, 4 },  /* RGB, RGBA */
+        { 1, 1 }, { 1, 2 },  /* gray, gray + alpha */
+        { 4, 4 }, { 4, 5 },  /* CMYK, CMYK + alpha */
+    };
+    for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+        check_kernel_layout(layouts[i][0], layouts[i][1], 8);
+        check_kernel_layout(layouts[i][0], layouts[i][1], 16);
+    }
+}
+
+/* Lab planes with wide coverage. 8-bit: a steps across each row, L and b
+ * step by 5 down the rows, so every a and every fifth L and b (both ends
+ * included) meet. 16-bit: pseudo-random samples. Alpha, if any, is x ^ y. */
+static bool fill_lab_planes(uint8_t **planes, uint16_t channels, uint16_t depth,
+                            uint32_t width, uint32_t height)
+{
+    const size_t bps = depth / 8u;
+    uint32_t seed = 0x2545F491u;
+    for (uint16_t c = 0; c < channels; c++) {
+        planes[c] = (uint8_t *)malloc((size_t)width * height * bps);
+        if (!planes[c]) return false;
+    }
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            size_t at = ((size_t)y * width + x) * bps;
+            for (uint16_t c = 0; c < channels; c++) {
+                uint32_t v;
+                if (c == 3) {
+                    v = (x ^ y) & 0xFFu;
+                    v = (depth == 8) ? v : ((v << 8) | (v ^ 0x5Au));
+                } else if (depth == 8) {
+                    v = (c == 0) ? (y / 52u) * 5u : (c == 1) ? x : (y % 52u) * 5u;
+                } else {
+                    seed = seed * 1664525u + 1013904223u;
+                    v = seed >> 16;
+                }
+                if (depth == 8) {
+                    planes[c][at] = (uint8_t)v;
+                } else {
+                    planes[c][at] = (uint8_t)(v >> 8);
+                    planes[c][at + 1] = (uint8_t)v;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static void check_lab_tables(uint16_t channels, uint16_t depth)
+{
+    char msg[128];
+    char label[48];
+    (void)snprintf(label, sizeof(label), "Lab %u channels, %u-bit",
+                   (unsigned)channels, (unsigned)depth);
+
+    uint8_t *planes[4] = { NULL, NULL, NULL, NULL };
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = 256;
+    spec.height = (depth == 8) ? 52u * 52u : 1024u;
+    spec.color_mode = 9;
+    spec.channels = channels;
+    spec.depth = depth;
+    spec.composite_compression = 0;
+    spec.composite_planes = (const uint8_t *const *)planes;
+
+    size_t size = 0;
+    uint8_t *bytes = fill_lab_planes(planes, channels, depth, spec.width, spec.height)
+                         ? psd_test_build_document(&spec, &size) : NULL;
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+
+    size_t full_size = (size_t)spec.width * spec.height * 4u;
+    uint8_t *fast = (uint8_t *)malloc(full_size);
+    uint8_t *exact = (uint8_t *)malloc(full_size);
+    uint32_t flags = 0xFFu;
+    bool ok = doc && fast && exact &&
+              psd_document_get_render_flags(doc, &flags) == PSD_OK && flags == 0 &&
+              psd_document_render_composite_rgba8(doc, fast, full_size, NULL) == PSD_OK &&
+              psd_document_set_render_flags(doc, PSD_RENDER_EXACT_COLOR) == PSD_OK &&
+              psd_document_render_composite_rgba8(doc, exact, full_size, NULL) == PSD_OK;
+    (void)snprintf(msg, sizeof(msg), "%s: table and exact renders succeed", label);
+    ASSERT_TRUE(ok, msg);
+
+    if (ok) {
+        size_t pixels = full_size / 4u;
+        size_t same = 0, near = 0, alpha_diffs = 0;
+        int max_diff = 0;
+        for (size_t i = 0; i < pixels; i++) {
+            for (size_t c = 0; c < 3; c++) {
+                int d = abs((int)fast[i * 4u + c] - (int)exact[i * 4u + c]);
+                if (d == 0) same++;
+                if (d <= 1) near++;
+                if (d > max_diff) max_diff = d;
+            }
+            if (fast[i * 4u + 3] != exact[i * 4u + 3]) alpha_diffs++;
+        }
+        fprintf(stdout, "  %s: max error %d, %.2f%% exact, %.3f%% within 1\n", label,
+                max_diff, 100.0 * (double)same / (double)(pixels * 3u),
+                100.0 * (double)near / (double)(pixels * 3u));
+
+        if (depth == 8) {
+            (void)snprintf(msg, sizeof(msg), "%s: table error at most 10 levels", label);
+            ASSERT_TRUE(max_diff <= 10, msg);
+            (void)snprintf(msg, sizeof(msg), "%s: over 90%% of channels exact", label);
+            ASSERT_TRUE(same * 10u > pixels * 3u * 9u, msg);
+            (void)snprintf(msg, sizeof(msg), "%s: over 99%% of channels within 1", label);
+            ASSERT_TRUE(near * 100u > pixels * 3u * 99u, msg);
+        } else {
+            (void)snprintf(msg, sizeof(msg), "%s: table error at most 1 level", label);
+            ASSERT_TRUE(max_diff <= 1, msg);
+        }
+        (void)snprintf(msg, sizeof(msg), "%s: alpha passes through unchanged", label);
+        ASSERT_TRUE(alpha_diffs == 0, msg);
+
+        psd_rect_t rect = { 3, 5, 60, 250 };
+        (void)snprintf(msg, sizeof(msg), "%s: exact rect render matches exact math", label);
+        ASSERT_TRUE(rects_match(doc, -1, exact, spec.width, &rect, 1), msg);
+        (void)psd_document_set_render_flags(doc, 0);
+        (void)snprintf(msg, sizeof(msg), "%s: table rect render matches table render", label);
+        ASSERT_TRUE(rects_match(doc, -1, fast, spec.width, &rect, 1), msg);
+    }
+
+    free(fast);
+    free(exact);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+    for (int c = 0; c < 4; c++) free(planes[c]);
+}
+
+static void test_lab_tables(void)
+{
+    fprintf(stdout, "\n=== Test: Lab conversion tables ===\n");
+
+    check_lab_tables(3, 8);
+    check_lab_tables(3, 16);
+    check_lab_tables(4, 8);
+    check_lab_tables(4, 16);
+
+    uint32_t flags = 0;
+    ASSERT_TRUE(psd_document_set_render_flags(NULL, 0) == PSD_ERR_NULL_POINTER,
+                "set_render_flags rejects NULL document");
+    ASSERT_TRUE(psd_document_get_render_flags(NULL, &flags) == PSD_ERR_NULL_POINTER,
+                "get_render_flags rejects NULL document");
+}
+
+/* Expected bytes of a straight RGBA8 pixel in a target layout */
+static void target_pixel(const uint8_t *rgba, psd_pixel_format_t format, bool premultiplied,
+                         uint8_t *out)
+{
+    uint8_t c[4] = { rgba[0], rgba[1], rgba[2], rgba[3] };
+    if (premultiplied) {
+        for (int i = 0; i < 3; i++) {
+            c[i] = (uint8_t)((2u * c[i] * c[3] + 255u) / 510u);
+        }
+    }
+    if (format == PSD_PIXEL_FORMAT_ARGB32) {
+        uint32_t v = ((uint32_t)c[3] << 24) | ((uint32_t)c[0] << 16) |
+                     ((uint32_t)c[1] << 8) | (uint32_t)c[2];
+        memcpy(out, &v, 4);
+    } else if (format == PSD_PIXEL_FORMAT_BGRA8) {
+        out[0] = c[2];
+        out[1] = c[1];
+        out[2] = c[0];
+        out[3] = c[3];
+    } else {
+        memcpy(out, c, 4);
+    }
+}
+
+/* Render into a padded target at an offset; compare the placed region and
+ * check that nothing around it was touched */
+static bool target_matches(psd_document_t *doc, int32_t layer_index, const psd_rect_t *rect,
+                           const uint8_t *full, uint32_t full_width,
+                           psd_pixel_format_t format, bool premultiplied)
+{
+    enum { X = 3, Y = 2, PAD = 8 };
+    uint32_t width = (uint32_t)(rect->right - rect->left);
+    uint32_t height = (uint32_t)(rect->bottom - rect->top);
+    size_t stride = (size_t)(X + width) * 4u + PAD;
+    size_t size = stride * (Y + height + 1u);
+    uint8_t *pixels = (uint8_t *)malloc(size);
+    if (!pixels) return false;
+    memset(pixels, 0xCD, size);
+
+    psd_render_target_t target;
+    memset(&target, 0, sizeof(target));
+    target.pixels = pixels;
+    target.size = size;
+    target.stride = stride;
+    target.format = format;
+    target.premultiplied = premultiplied;
+    target.x = X;
+    target.y = Y;
+    psd_status_t st = (layer_index < 0)
+        ? psd_document_render_composite_to_target(doc, rect, &target)
+        : psd_document_render_layer_to_target(doc, layer_index, rect, &target);
+
+    bool ok = st == PSD_OK;
+    for (size_t y = 0; ok && y < Y + height + 1u; y++) {
+        for (size_t x = 0; ok && x < stride / 4u; x++) {
+            const uint8_t *got = pixels + y * stride + x * 4u;
+            uint8_t want[4] = { 0xCD, 0xCD, 0xCD, 0xCD };
+            if (y >= Y && y < Y + height && x >= X && x < X + width) {
+                size_t src = ((size_t)(rect->top + (int32_t)(y - Y)) * full_width +
+                              (size_t)rect->left + (x - X)) * 4u;
+                target_pixel(full + src, format, premultiplied, want);
+            }
+            ok = memcmp(got, want, 4) == 0;
+        }
+    }
+    free(pixels);
+    return ok;
+}
+
+static void test_render_targets(void)
+{
+    fprintf(stdout, "\n=== Test: render targets ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+    ASSERT_TRUE(doc != NULL, "parse synthetic document");
+    if (!doc) {
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    /* Layer 0 covers the canvas and has a varying alpha channel */
+    size_t full_size = (size_t)spec.width * spec.height * 4u;
+    uint8_t *layer = (uint8_t *)malloc(full_size);
+    uint8_t *composite = (uint8_t *)malloc(full_size);
+    bool ready = layer && composite &&
+                 psd_document_render_layer_rgba8(doc, 0, layer, full_size, NULL) == PSD_OK &&
+                 psd_document_render_composite_rgba8(doc, composite, full_size, NULL) == PSD_OK;
+    ASSERT_TRUE(ready, "reference renders");
+
+    static const psd_pixel_format_t formats[3] = {
+        PSD_PIXEL_FORMAT_RGBA8, PSD_PIXEL_FORMAT_BGRA8, PSD_PIXEL_FORMAT_ARGB32
+    };
+    static const char *const names[3] = { "RGBA8", "BGRA8", "ARGB32" };
+    psd_rect_t whole = { 0, 0, (int32_t)spec.height, (int32_t)spec.width };
+    psd_rect_t inner = { 3, 1, 20, 30 };
+    for (int f = 0; ready && f < 3; f++) {
+        for (int premultiplied = 0; premultiplied < 2; premultiplied++) {
+            char msg[96];
+            (void)snprintf(msg, sizeof(msg), "layer into %s%s target", names[f],
+                           premultiplied ? " premultiplied" : "");
+            ASSERT_TRUE(target_matches(doc, 0, &whole, layer, spec.width, formats[f],
+                                       premultiplied != 0) &&
+                            target_matches(doc, 0, &inner, layer, spec.width, formats[f],
+                                           premultiplied != 0),
+                        msg);
+            (void)snprintf(msg, sizeof(msg), "composite region into %s%s target", names[f],
+                           premultiplied ? " premultiplied" : "");
+            ASSERT_TRUE(target_matches(doc, -1, &inner, composite, spec.width, formats[f],
+                                       premultiplied != 0),
+                        msg);
+        }
+    }
+
+    uint8_t out[64 * 4];
+    psd_render_target_t target;
+    memset(&target, 0, sizeof(target));
+    target.pixels = out;
+    target.size = sizeof(out);
+    psd_rect_t row = { 0, 0, 1, 32 };
+    psd_rect_t two_rows = { 0, 0, 2, 32 };
+    psd_rect_t empty = { 3, 3, 3, 3 };
+    ASSERT_TRUE(psd_document_render_composite_to_target(doc, &two_rows, &target) == PSD_OK,
+                "packed rows by default");
+    target.x = 1;
+    ASSERT_TRUE(psd_document_render_composite_to_target(doc, &two_rows, &target) ==
+                    PSD_ERR_BUFFER_TOO_SMALL &&
+                    psd_document_render_composite_to_target(doc, &row, &target) == PSD_OK,
+                "offset region must fit the buffer");
+    target.stride = 32u * 4u;
+    ASSERT_TRUE(psd_document_render_composite_to_target(doc, &row, &target) ==
+                    PSD_ERR_INVALID_ARGUMENT,
+                "stride narrower than the placed row rejected");
+    target.stride = 0;
+    target.x = 0;
+    target.format = (psd_pixel_format_t)7;
+    ASSERT_TRUE(psd_document_render_composite_to_target(doc, &row, &target) ==
+                    PSD_ERR_INVALID_ARGUMENT,
+                "unknown format rejected");
+    target.format = PSD_PIXEL_FORMAT_BGRA8;
+    target.size = 0;
+    ASSERT_TRUE(psd_document_render_composite_to_target(doc, &empty, &target) == PSD_OK,
+                "empty region is a no-op");
+    target.pixels = NULL;
+    ASSERT_TRUE(psd_document_render_composite_to_target(doc, &row, &target) ==
+                        PSD_ERR_NULL_POINTER &&
+                    psd_document_render_layer_to_target(doc, 0, &row, NULL) ==
+                        PSD_ERR_NULL_POINTER,
+                "NULL target rejected");
+
+    free(layer);
+    free(composite);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+/* One wide reference sample from big-endian sample bytes */
+static void reference_wide(const uint8_t *p, uint16_t depth, uint16_t *out_u16, float *out_f32)
+{
+    if (depth == 8) {
+        *out_u16 = (uint16_t)(p[0] * 257u);
+        *out_f32 = (float)p[0] / 255.0f;
+    } else if (depth == 16) {
+        uint16_t v = (uint16_t)((p[0] << 8) | p[1]);
+        *out_u16 = v;
+        *out_f32 = (float)v / 65535.0f;
+    } else {
+        uint32_t bits = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                        ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+        float v;
+        memcpy(&v, &bits, sizeof(v));
+        *out_f32 = v;
+        float c = (v > 0.0f) ? ((v < 1.0f) ? v : 1.0f) : 0.0f;
+        *out_u16 = (uint16_t)(c * 65535.0f + 0.5f);
+    }
+}
+
+static void check_wide_composite(uint16_t channels, uint16_t depth)
+{
+    char msg[96];
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = 37;
+    spec.channels = channels;
+    spec.depth = depth;
+    spec.composite_compression = 0;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+
+    const size_t pixels = (size_t)spec.width * spec.height;
+    uint16_t *wide = (uint16_t *)malloc(pixels * 4u * sizeof(uint16_t));
+    uint16_t *wide_ref = (uint16_t *)malloc(pixels * 4u * sizeof(uint16_t));
+    float *flt = (float *)malloc(pixels * 4u * sizeof(float));
+    float *flt_ref = (float *)malloc(pixels * 4u * sizeof(float));
+    bool ready = doc && wide && wide_ref && flt && flt_ref;
+    (void)snprintf(msg, sizeof(msg), "%u channels, %u-bit: document parsed",
+                   (unsigned)channels, (unsigned)depth);
+    ASSERT_TRUE(ready, msg);
+
+    if (ready) {
+        /* References come from the builder's sample bytes, not the decoder */
+        for (size_t i = 0; i < pixels; i++) {
+            uint32_t x = (uint32_t)(i % spec.width);
+            uint32_t y = (uint32_t)(i / spec.width);
+            for (uint16_t c = 0; c < 4; c++) {
+                if (c < channels) {
+                    int32_t ch = (c == 3) ? -1 : (int32_t)c;
+                    uint8_t v = psd_test_sample(-1, ch, x, y);
+                    uint8_t sample[4];
+                    for (uint32_t k = 0; k < 4; k++) sample[k] = psd_test_sample_byte(ch, v, k);
+                    reference_wide(sample, depth, &wide_ref[i * 4u + c], &flt_ref[i * 4u + c]);
+                } else {
+                    wide_ref[i * 4u + c] = 65535;
+                    flt_ref[i * 4u + c] = 1.0f;
+                }
+            }
+        }
+
+        size_t required = 0;
+        psd_status_t st = psd_document_render_composite_rgba16(doc, wide,
+                                                               pixels * 4u * sizeof(uint16_t),
+                                                               &required);
+        (void)snprintf(msg, sizeof(msg), "%u channels, %u-bit: RGBA16 matches reference",
+                       (unsigned)channels, (unsigned)depth);
+        ASSERT_TRUE(st == PSD_OK && required == pixels * 8u &&
+                        memcmp(wide, wide_ref, pixels * 4u * sizeof(uint16_t)) == 0,
+                    msg);
+        if (depth == 16) {
+            /* Known answer: red of pixel 4 is stored as bytes 26 7C */
+            (void)snprintf(msg, sizeof(msg), "%u channels, 16-bit: bytes 26 7C render as 0x267C",
+                           (unsigned)channels);
+            ASSERT_TRUE(st == PSD_OK && wide[4u * 4u] == 0x267Cu, msg);
+        }
+
+        st = psd_document_render_composite_rgbaf32(doc, flt, pixels * 4u * sizeof(float),
+                                                   &required);
+        (void)snprintf(msg, sizeof(msg), "%u channels, %u-bit: float RGBA matches reference",
+                       (unsigned)channels, (unsigned)depth);
+        ASSERT_TRUE(st == PSD_OK && required == pixels * 16u &&
+                        memcmp(flt, flt_ref, pixels * 4u * sizeof(float)) == 0,
+                    msg);
+    }
+
+    free(wide);
+    free(wide_ref);
+    free(flt);
+    free(flt_ref);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_wide_renders(void)
+{
+    fprintf(stdout, "\n=== Test: RGBA16 and float renders ===\n");
+
+    static const uint16_t depths[3] = { 8, 16, 32 };
+    for (int d = 0; d < 3; d++) {
+        check_wide_composite(3, depths[d]);
+        check_wide_composite(4, depths[d]);
+    }
+
+    /* Layers widen the same samples the 8-bit path reads */
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+    ASSERT_TRUE(doc != NULL, "parse synthetic document");
+
+    uint32_t w = spec.width - 1u;
+    uint32_t h = spec.height - 1u;
+    size_t pixels = (size_t)w * h;
+    uint8_t *narrow = (uint8_t *)malloc(pixels * 4u);
+    uint16_t *wide = (uint16_t *)malloc(pixels * 4u * sizeof(uint16_t));
+    float *flt = (float *)malloc(pixels * 4u * sizeof(float));
+    bool ready = doc && narrow && wide && flt &&
+                 psd_document_render_layer_rgba8(doc, 1, narrow, pixels * 4u, NULL) == PSD_OK;
+    if (ready) {
+        size_t required = 0;
+        ASSERT_TRUE(psd_document_render_layer_rgba16(doc, 1, NULL, 0, &required) ==
+                            PSD_ERR_BUFFER_TOO_SMALL &&
+                        required == pixels * 8u &&
+                        psd_document_render_layer_rgbaf32(doc, 1, flt, required, &required) ==
+                            PSD_ERR_BUFFER_TOO_SMALL &&
+                        required == pixels * 16u,
+                    "size query reports bytes for each format");
+        ASSERT_TRUE(psd_document_render_composite_rgba16(doc, NULL, 0, &required) ==
+                            PSD_ERR_BUFFER_TOO_SMALL &&
+                        required == (size_t)spec.width * spec.height * 8u,
+                    "composite size query");
+
+        bool ok = psd_document_render_layer_rgba16(doc, 1, wide, pixels * 8u, NULL) == PSD_OK &&
+                  psd_document_render_layer_rgbaf32(doc, 1, flt, pixels * 16u, NULL) == PSD_OK;
+        for (size_t i = 0; ok && i < pixels * 4u; i++) {
+            ok = wide[i] == narrow[i] * 257u && flt[i] == (float)narrow[i] / 255.0f;
+        }
+        ASSERT_TRUE(ok, "layer renders widen the 8-bit samples exactly");
+    }
+    ASSERT_TRUE(psd_document_render_layer_rgba16(doc, 9, wide, pixels * 8u, NULL) ==
+                        PSD_ERR_OUT_OF_RANGE &&
+                    psd_document_render_composite_rgbaf32(NULL, flt, 16, NULL) ==
+                        PSD_ERR_NULL_POINTER,
+                "arguments checked");
+
+    free(narrow);
+    free(wide);
+    free(flt);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+/* Minimal document with a raw composite: header, color mode data, at most
+ * one resource, an empty layer section and the given planes */
+static uint8_t *build_palette_doc(uint16_t mode, uint16_t depth, uint16_t channels,
+                                  uint32_t width, uint32_t height, const uint8_t *color_data,
+                                  uint32_t color_length, const uint8_t *resource,
+                                  uint16_t resource_id, uint32_t resource_length,
+                                  const uint8_t *planes, size_t planes_length, size_t *out_size)
+{
+    size_t size = 26u + 4u + color_length + 4u + (resource ? 12u + resource_length : 0u) +
+                  4u + 2u + planes_length;
+    uint8_t *b = (uint8_t *)calloc(1, size);
+    if (!b) return NULL;
+    uint8_t *p = b;
+    memcpy(p, "8BPS\0\1", 6);
+    p += 12;
+    *p++ = (uint8_t)(channels >> 8); *p++ = (uint8_t)channels;
+    for (int s = 24; s >= 0; s -= 8) *p++ = (uint8_t)(height >> s);
+    for (int s = 24; s >= 0; s -= 8) *p++ = (uint8_t)(width >> s);
+    *p++ = (uint8_t)(depth >> 8); *p++ = (uint8_t)depth;
+    *p++ = (uint8_t)(mode >> 8); *p++ = (uint8_t)mode;
+    for (int s = 24; s >= 0; s -= 8) *p++ = (uint8_t)(color_length >> s);
+    if (color_length) memcpy(p, color_data, color_length);
+    p += color_length;
+    uint32_t res_length = resource ? 12u + resource_length : 0u;
+    for (int s = 24; s >= 0; s -= 8) *p++ = (uint8_t)(res_length >> s);
+    if (resource) {
+        memcpy(p, "8BIM", 4);
+        p[4] = (uint8_t)(resource_id >> 8);
+        p[5] = (uint8_t)resource_id;
+        p += 8; /* empty name, padded */
+        for (int s = 24; s >= 0; s -= 8) *p++ = (uint8_t)(resource_length >> s);
+        memcpy(p, resource, resource_length);
+        p += resource_length;
+    }
+    p += 4; /* empty layer and mask section */
+    p += 2; /* raw composite */
+    memcpy(p, planes, planes_length);
+    *out_size = size;
+    return b;
+}
+
+static void test_bitmap_rows(void)
+{
+    fprintf(stdout, "\n=== Test: 1-bit rows ===\n");
+
+    /* 29 pixels: three whole bytes and a 5-bit tail per row */
+    enum { W = 29, H = 3, ROW = (W + 7) / 8 };
+    uint8_t bits[ROW * H];
+    for (size_t i = 0; i < sizeof(bits); i++) bits[i] = (uint8_t)(i * 0x5Bu + 0x93u);
+    size_t size = 0;
+    uint8_t *bytes = build_palette_doc(0, 1, 1, W, H, NULL, 0, NULL, 0, 0, bits, sizeof(bits),
+                                       &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+    ASSERT_TRUE(doc != NULL, "parse bitmap document");
+
+    uint8_t expected[W * H * 4];
+    for (uint32_t y = 0; y < H; y++) {
+        for (uint32_t x = 0; x < W; x++) {
+            uint8_t v = ((bits[y * ROW + x / 8] >> (7 - x % 8)) & 1u) ? 255 : 0;
+            uint8_t *px = expected + ((size_t)y * W + x) * 4u;
+            px[0] = px[1] = px[2] = v;
+            px[3] = 255;
+        }
+    }
+    uint8_t full[W * H * 4];
+    ASSERT_TRUE(doc && psd_document_render_composite_rgba8(doc, full, sizeof(full), NULL) ==
+                           PSD_OK &&
+                    memcmp(full, expected, sizeof(full)) == 0,
+                "bits expand to white and black");
+
+    static const psd_rect_t rects[] = {
+        { 0, 3, 3, 29 },   /* unaligned start */
+        { 1, 8, 2, 24 },   /* whole bytes only */
+        { 2, 5, 3, 7 },    /* inside one byte */
+    };
+    ASSERT_TRUE(doc && rects_match(doc, -1, expected, W, rects, sizeof(rects) / sizeof(rects[0])),
+                "rect renders start mid-byte");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_indexed_palette(void)
+{
+    fprintf(stdout, "\n=== Test: indexed palette ===\n");
+
+    enum { W = 21, H = 2, N = W * H };
+    uint8_t table[768];
+    for (int i = 0; i < 256; i++) {
+        table[i] = (uint8_t)i;
+        table[256 + i] = (uint8_t)(255 - i);
+        table[512 + i] = (uint8_t)(i * 3);
+    }
+    static const uint8_t transparent[2] = { 0, 5 };
+    uint8_t planes[N * 2];
+    for (int i = 0; i < N; i++) {
+        planes[i] = (uint8_t)(i * 7 % 11);           /* includes index 5 */
+        planes[N + i] = (uint8_t)(200 + i);
+    }
+
+    for (uint16_t channels = 1; channels <= 2; channels++) {
+        char msg[96];
+        size_t size = 0;
+        uint8_t *bytes = build_palette_doc(2, 8, channels, W, H, table, sizeof(table),
+                                           transparent, 1047, sizeof(transparent), planes,
+                                           (size_t)N * channels, &size);
+        psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+        psd_document_t *doc = stream ? psd_parse(stream, NULL) : NULL;
+
+        uint8_t expected[N * 4];
+        uint16_t wide_expected[N * 4];
+        for (int i = 0; i < N; i++) {
+            uint8_t index = planes[i];
+            uint8_t a = (channels > 1) ? planes[N + i] : 255;
+            uint8_t px[4] = { table[index], table[256 + index], table[512 + index],
+                              (index == 5) ? 0 : a };
+            memcpy(expected + i * 4, px, 4);
+            for (int c = 0; c < 4; c++) wide_expected[i * 4 + c] = (uint16_t)(px[c] * 257u);
+        }
+
+        uint8_t full[N * 4];
+        (void)snprintf(msg, sizeof(msg), "%u channel(s): palette with transparent index",
+                       (unsigned)channels);
+        ASSERT_TRUE(doc && psd_document_render_composite_rgba8(doc, full, sizeof(full), NULL) ==
+                               PSD_OK &&
+                        memcmp(full, expected, sizeof(full)) == 0,
+                    msg);
+
+        psd_rect_t rect = { 1, 3, 2, 20 };
+        (void)snprintf(msg, sizeof(msg), "%u channel(s): rect render", (unsigned)channels);
+        ASSERT_TRUE(doc && rects_match(doc, -1, expected, W, &rect, 1), msg);
+
+        uint16_t wide[N * 4];
+        (void)snprintf(msg, sizeof(msg), "%u channel(s): RGBA16 uses the same palette",
+                       (unsigned)channels);
+        ASSERT_TRUE(doc && psd_document_render_composite_rgba16(doc, wide, sizeof(wide), NULL) ==
+                               PSD_OK &&
+                        memcmp(wide, wide_expected, sizeof(wide)) == 0,
+                    msg);
+
+        psd_document_free(doc);
+        psd_stream_destroy(stream);
+        free(bytes);
+    }
+}
+
+/* Reference (cached), uncached and uncached deferred renders of every layer */
+/* RGBA8 layer pixels against the builder's samples. 16-bit samples have
+ * distinct high and low bytes, so this catches a render that takes the
+ * wrong one; 8-bit output is the most significant byte. */
+static bool layer_matches_samples(const uint8_t *rgba, int32_t layer, uint32_t w, uint32_t h,
+                                  uint16_t mode)
+{
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            const uint8_t *px = rgba + ((size_t)y * w + x) * 4u;
+            uint8_t r = psd_test_sample(layer, 0, x, y);
+            uint8_t g = (mode == 1) ? r : psd_test_sample(layer, 1, x, y);
+            uint8_t b = (mode == 1) ? r : psd_test_sample(layer, 2, x, y);
+            if (px[0] != r || px[1] != g || px[2] != b || px[3] != 255) return false;
+        }
+    }
+    return true;
+}
+
+static void check_uncached_layers(uint16_t compression, uint16_t depth, uint16_t mode)
+{
+    static const char *const names[] = { "RAW", "RLE", "ZIP" };
+    char label[48];
+    char msg[128];
+    (void)snprintf(label, sizeof(label), "%s %u-bit %s", names[compression], (unsigned)depth,
+                   mode == 1 ? "gray" : "RGB");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = 37;
+    spec.depth = depth;
+    spec.color_mode = mode;
+    spec.channels = (mode == 1) ? 1 : 3;
+    spec.layer_compression = compression;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    psd_stream_t *s1 = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_stream_t *s2 = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_stream_t *s3 = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_parse_options_t options = { PSD_PARSE_SKIP_LAYER_PIXELS };
+    psd_document_t *cached = s1 ? psd_parse(s1, NULL) : NULL;
+    psd_document_t *docs[2] = {
+        s2 ? psd_parse(s2, NULL) : NULL,
+        s3 ? psd_parse_with_options(s3, NULL, &options, NULL) : NULL,
+    };
+    bool ok = cached && docs[0] && docs[1];
+    for (int d = 0; d < 2 && ok; d++) {
+        ok = psd_document_set_render_flags(docs[d], PSD_RENDER_NO_CACHE) == PSD_OK;
+    }
+    (void)snprintf(msg, sizeof(msg), "%s: parse", label);
+    ASSERT_TRUE(ok, msg);
+
+    bool match = ok;
+    bool exact = ok;
+    bool released = ok;
+    for (int32_t layer = 0; ok && layer < (int32_t)spec.layer_count; layer++) {
+        uint32_t w = spec.width - (uint32_t)layer;
+        uint32_t h = spec.height - (uint32_t)layer;
+        size_t full_size = (size_t)w * h * 4u;
+        uint8_t *expected = (uint8_t *)malloc(full_size);
+        uint8_t *full = (uint8_t *)malloc(full_size);
+        match = match && expected && full &&
+                psd_document_render_layer_rgba8(cached, layer, expected, full_size, NULL) == PSD_OK;
+
+        psd_rect_t rects[] = {
+            { 0, 0, (int32_t)h, (int32_t)w },
+            { 2, 4, (int32_t)h - 3, (int32_t)w - 1 },
+        };
+        psd_rect_t window = { 1, 2, (int32_t)h, (int32_t)w - 2 };
+        scanline_sink_t sink = { NULL, w - 4u, 0, 0 };
+        sink.rgba = (uint8_t *)malloc((size_t)(w - 4u) * (h - 1u) * 4u);
+        for (int d = 0; d < 2 && match; d++) {
+            uint64_t usage = 1;
+            match = psd_document_render_layer_rgba8(docs[d], layer, full, full_size, NULL) == PSD_OK &&
+                    memcmp(full, expected, full_size) == 0 &&
+                    rects_match(docs[d], layer, expected, w, rects, sizeof(rects) / sizeof(rects[0]));
+            exact = exact && match && layer_matches_samples(full, layer, w, h, mode);
+            sink.rows = 0;
+            match = match && sink.rgba &&
+                    psd_document_render_layer_rgba8_scanlines(docs[d], layer, &window, collect_row,
+                                                              &sink) == PSD_OK &&
+                    sink.rows == h - 1u &&
+                    window_matches(expected, w, &window, sink.rgba, (size_t)(w - 4u) * 4u);
+            released = released && psd_document_get_decode_cache_usage(docs[d], &usage) == PSD_OK &&
+                       usage == 0;
+        }
+        free(sink.rgba);
+        free(full);
+        free(expected);
+    }
+    (void)snprintf(msg, sizeof(msg), "%s: uncached renders match cached ones", label);
+    ASSERT_TRUE(match, msg);
+    (void)snprintf(msg, sizeof(msg), "%s: uncached pixels hold the sample MSBs", label);
+    ASSERT_TRUE(exact, msg);
+    (void)snprintf(msg, sizeof(msg), "%s: uncached renders keep no decoded pixels", label);
+    ASSERT_TRUE(released, msg);
+
+    /* What was decoded before the render is the caller's and stays */
+    const uint8_t *data = NULL;
+    uint64_t before = 0;
+    uint64_t after = 0;
+    size_t out_size = (size_t)spec.width * spec.height * 4u;
+    uint8_t *out = (uint8_t *)malloc(out_size);
+    bool kept = ok && out &&
+                psd_document_get_layer_channel_data(docs[1], 0, 1, NULL, &data, NULL, NULL) == PSD_OK &&
+                psd_document_get_decode_cache_usage(docs[1], &before) == PSD_OK &&
+                psd_document_render_layer_rgba8(docs[1], 0, out, out_size, NULL) == PSD_OK &&
+                psd_document_get_decode_cache_usage(docs[1], &after) == PSD_OK &&
+                before > 0 && after == before;
+    (void)snprintf(msg, sizeof(msg), "%s: channels decoded beforehand are kept", label);
+    ASSERT_TRUE(kept, msg);
+    free(out);
+
+    psd_document_free(cached);
+    psd_document_free(docs[0]);
+    psd_document_free(docs[1]);
+    psd_stream_destroy(s1);
+    psd_stream_destroy(s2);
+    psd_stream_destroy(s3);
+    free(bytes);
+}
+
+static void test_uncached_renders(void)
+{
+    fprintf(stdout, "\n=== Test: uncached layer renders ===\n");
+
+#ifdef OPENPSD_TEST_HAVE_ZIP
+    const uint16_t compressions = 3;
+#else
+    const uint16_t compressions = 2;
+#endif
+    for (uint16_t c = 0; c < compressions; c++) {
+        check_uncached_layers(c, 8, 3);
+        check_uncached_layers(c, 16, 3);
+        check_uncached_layers(c, 8, 1);
+        check_uncached_layers(c, 16, 1);
+    }
+}
+
+int run_render_tests(void)
+{
+    fprintf(stdout, "=== Render tests ===\n");
+
+    test_composite_regions();
+    test_layer_regions();
+    test_region_arguments();
+    test_row_kernels();
+    test_lab_tables();
+    test_render_targets();
+    test_wide_renders();
+    test_bitmap_rows();
+    test_indexed_palette();
+    test_uncached_renders();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
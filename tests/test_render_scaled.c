@@ -0,0 +1,209 @@
+/**
+ * @file test_render_scaled.c
+ * @brief Tests for power-of-two downsampled composite renders
+ *
+ * Scaled renders are checked against block averages (and, with
+ * PSD_RENDER_FAST_SCALE, block centers) of the full-size render, including
+ * partial blocks at the right and bottom edges.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+/* Odd sizes, so every level above 0 has partial edge blocks */
+#define DOC_W 37u
+#define DOC_H 22u
+
+static psd_document_t *build(uint16_t color_mode, uint16_t channels, uint16_t compression,
+                             uint8_t **bytes, psd_stream_t **stream)
+{
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.color_mode = color_mode;
+    spec.width = DOC_W;
+    spec.height = DOC_H;
+    spec.channels = channels;
+    spec.composite_compression = compression;
+
+    size_t size = 0;
+    *bytes = psd_test_build_document(&spec, &size);
+    *stream = *bytes ? psd_stream_create_buffer(NULL, *bytes, size) : NULL;
+    return *stream ? psd_parse_ex(*stream, NULL, NULL) : NULL;
+}
+
+/* Alpha-weighted average of one block of the full render */
+static void block_average(const uint8_t *full, uint32_t level, uint32_t ox, uint32_t oy,
+                          uint8_t out[4])
+{
+    uint64_t sum[4] = { 0, 0, 0, 0 };
+    uint64_t count = 0;
+    uint32_t block = 1u << level;
+    for (uint32_t y = oy * block; y < (oy + 1u) * block && y < DOC_H; y++) {
+        for (uint32_t x = ox * block; x < (ox + 1u) * block && x < DOC_W; x++) {
+            const uint8_t *px = full + ((size_t)y * DOC_W + x) * 4u;
+            for (uint32_t c = 0; c < 3; c++) sum[c] += (uint64_t)px[c] * px[3];
+            sum[3] += px[3];
+            count++;
+        }
+    }
+    for (uint32_t c = 0; c < 3; c++) {
+        out[c] = sum[3] ? (uint8_t)((sum[c] + sum[3] / 2u) / sum[3]) : 0u;
+    }
+    out[3] = (uint8_t)((sum[3] + count / 2u) / count);
+}
+
+static bool scaled_matches(psd_document_t *doc, const uint8_t *full, uint32_t level, bool fast)
+{
+    uint32_t block = 1u << level;
+    uint32_t w = 0, h = 0;
+    size_t required = 0;
+    if (psd_document_render_composite_rgba8_scaled(doc, level, NULL, 0, &required, &w, &h) !=
+            PSD_ERR_BUFFER_TOO_SMALL ||
+        w != (DOC_W + block - 1u) / block || h != (DOC_H + block - 1u) / block ||
+        required != (size_t)w * h * 4u) {
+        return false;
+    }
+
+    uint8_t *scaled = (uint8_t *)malloc(required);
+    bool ok = scaled && psd_document_render_composite_rgba8_scaled(
+                            doc, level, scaled, required, NULL, NULL, NULL) == PSD_OK;
+    for (uint32_t oy = 0; ok && oy < h; oy++) {
+        for (uint32_t ox = 0; ok && ox < w; ox++) {
+            uint8_t expect[4];
+            if (fast) {
+                uint32_t x = ox * block + block / 2u;
+                uint32_t y = oy * block + block / 2u;
+                if (x >= DOC_W) x = DOC_W - 1u;
+                if (y >= DOC_H) y = DOC_H - 1u;
+                memcpy(expect, full + ((size_t)y * DOC_W + x) * 4u, 4);
+            } else {
+                block_average(full, level, ox, oy, expect);
+            }
+            ok = memcmp(scaled + ((size_t)oy * w + ox) * 4u, expect, 4) == 0;
+        }
+    }
+    free(scaled);
+    return ok;
+}
+
+static void check_levels(uint16_t color_mode, uint16_t channels, uint16_t compression,
+                         const char *label)
+{
+    char msg[128];
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(color_mode, channels, compression, &bytes, &stream);
+    uint8_t full[DOC_W * DOC_H * 4];
+    bool ok = doc && psd_document_render_composite_rgba8(doc, full, sizeof(full), NULL) == PSD_OK;
+    (void)snprintf(msg, sizeof(msg), "%s: full-size render", label);
+    ASSERT_TRUE(ok, msg);
+    if (!ok) {
+        psd_document_free(doc);
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    static const uint32_t levels[] = { 0, 1, 2, 3, 6 };
+    bool box = true;
+    bool fast = true;
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        box = box && scaled_matches(doc, full, levels[i], false);
+    }
+    fast = psd_document_set_render_flags(doc, PSD_RENDER_FAST_SCALE) == PSD_OK;
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        fast = fast && scaled_matches(doc, full, levels[i], true);
+    }
+    (void)snprintf(msg, sizeof(msg), "%s: box filter matches block averages", label);
+    ASSERT_TRUE(box, msg);
+    (void)snprintf(msg, sizeof(msg), "%s: fast scale matches block centers", label);
+    ASSERT_TRUE(fast, msg);
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_scaled_levels(void)
+{
+    fprintf(stdout, "\n=== Test: scaled composite levels ===\n");
+    check_levels(3, 3, 1, "RGB RLE");
+    check_levels(3, 4, 1, "RGBA RLE");
+    check_levels(3, 4, 0, "RGBA RAW");
+    check_levels(9, 3, 1, "Lab RLE");
+#ifdef OPENPSD_TEST_HAVE_ZIP
+    check_levels(3, 4, 2, "RGBA ZIP");
+#endif
+}
+
+static void test_scaled_arguments(void)
+{
+    fprintf(stdout, "\n=== Test: scaled render arguments ===\n");
+
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(3, 3, 1, &bytes, &stream);
+    uint8_t out[16];
+    size_t required = 0;
+    uint32_t w = 0, h = 0;
+
+    ASSERT_TRUE(psd_document_render_composite_rgba8_scaled(NULL, 1, out, sizeof(out), NULL,
+                                                           NULL, NULL) == PSD_ERR_NULL_POINTER,
+                "NULL document rejected");
+    ASSERT_TRUE(doc && psd_document_render_composite_rgba8_scaled(doc, 32, out, sizeof(out),
+                                                                  NULL, NULL, NULL) ==
+                           PSD_ERR_INVALID_ARGUMENT,
+                "level 32 rejected");
+    ASSERT_TRUE(doc && psd_document_render_composite_rgba8_scaled(doc, 31, out, sizeof(out),
+                                                                  &required, &w, &h) == PSD_OK &&
+                    w == 1 && h == 1 && required == 4 && out[3] == 255,
+                "level 31 gives a single pixel");
+    ASSERT_TRUE(doc && psd_document_render_composite_rgba8_scaled(doc, 2, out, sizeof(out),
+                                                                  &required, &w, &h) ==
+                           PSD_ERR_BUFFER_TOO_SMALL &&
+                    w == 10 && h == 6 && required == 240,
+                "small buffer reports the scaled size");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+int run_render_scaled_tests(void)
+{
+    fprintf(stdout, "=== Scaled render tests ===\n");
+
+    test_scaled_levels();
+    test_scaled_arguments();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
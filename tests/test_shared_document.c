@@ -0,0 +1,361 @@
+/**
+ * @file test_shared_document.c
+ * @brief Tests for one document shared by several threads
+ *
+ * Threads race for the first access to every lazily prepared item of a fresh
+ * document (deferred loads, channel and composite decodes, content bounds)
+ * and must all see what a document prepared on one thread holds.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* pthreads under strict C17 */
+#endif
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(OPENPSD_TEST_HAVE_THREADS)
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+#if defined(OPENPSD_TEST_HAVE_THREADS)
+
+#define SHARED_THREADS 8
+#define SHARED_ROUNDS 12
+
+/* What a document prepared on one thread gives back */
+typedef struct {
+    psd_document_t *reference;
+    int32_t layer_count;
+    uint8_t *composite_rgba;
+    size_t composite_size;
+    uint8_t *layer_rgba[8];
+    size_t layer_size[8];
+} expected_t;
+
+typedef struct {
+    psd_document_t *doc;
+    const expected_t *expected;
+    int first_layer;
+    int mismatches;
+} worker_t;
+
+static uint8_t *render_layer(psd_document_t *doc, int32_t layer, size_t *out_size)
+{
+    size_t size = 0;
+    *out_size = 0;
+    if (psd_document_render_layer_rgba8(doc, layer, NULL, 0, &size) != PSD_ERR_BUFFER_TOO_SMALL) {
+        return NULL;
+    }
+    uint8_t *rgba = (uint8_t *)malloc(size ? size : 1);
+    if (rgba && psd_document_render_layer_rgba8(doc, layer, rgba, size, NULL) != PSD_OK) {
+        free(rgba);
+        return NULL;
+    }
+    *out_size = size;
+    return rgba;
+}
+
+static uint8_t *render_composite(const psd_document_t *doc, size_t *out_size)
+{
+    size_t size = 0;
+    *out_size = 0;
+    if (psd_document_render_composite_rgba8(doc, NULL, 0, &size) != PSD_ERR_BUFFER_TOO_SMALL) {
+        return NULL;
+    }
+    uint8_t *rgba = (uint8_t *)malloc(size);
+    if (rgba && psd_document_render_composite_rgba8(doc, rgba, size, NULL) != PSD_OK) {
+        free(rgba);
+        return NULL;
+    }
+    *out_size = size;
+    return rgba;
+}
+
+/* Every read a request handler might make, on layers from first_layer on */
+static void shared_reads(worker_t *w)
+{
+    const expected_t *e = w->expected;
+    psd_document_t *doc = w->doc;
+
+    size_t resources = 0;
+    size_t ref_resources = 0;
+    if (psd_document_get_resource_count(doc, &resources) != PSD_OK ||
+        psd_document_get_resource_count(e->reference, &ref_resources) != PSD_OK ||
+        resources != ref_resources) {
+        w->mismatches++;
+    }
+
+    for (int32_t n = 0; n < e->layer_count; n++) {
+        int32_t layer = (w->first_layer + n) % e->layer_count;
+
+        size_t channels = 0;
+        psd_document_get_layer_channel_count(doc, layer, &channels);
+        for (size_t c = 0; c < channels; c++) {
+            const uint8_t *data = NULL;
+            const uint8_t *ref_data = NULL;
+            uint64_t length = 0;
+            uint64_t ref_length = 0;
+            if (psd_document_get_layer_channel_data(doc, layer, c, NULL, &data, &length, NULL) !=
+                    PSD_OK ||
+                psd_document_get_layer_channel_data(e->reference, layer, c, NULL, &ref_data,
+                                                    &ref_length, NULL) != PSD_OK ||
+                length != ref_length || memcmp(data, ref_data, (size_t)length) != 0) {
+                w->mismatches++;
+            }
+        }
+
+        psd_rect_t bounds;
+        psd_rect_t ref_bounds;
+        uint32_t empty = 0;
+        uint32_t ref_empty = 0;
+        if (psd_document_get_layer_content_bounds(doc, layer, &bounds, &empty) != PSD_OK ||
+            psd_document_get_layer_content_bounds(e->reference, layer, &ref_bounds,
+                                                  &ref_empty) != PSD_OK ||
+            memcmp(&bounds, &ref_bounds, sizeof(bounds)) != 0 || empty != ref_empty) {
+            w->mismatches++;
+        }
+
+        size_t size = 0;
+        uint8_t *rgba = render_layer(doc, layer, &size);
+        if (!rgba || size != e->layer_size[layer] ||
+            memcmp(rgba, e->layer_rgba[layer], size) != 0) {
+            w->mismatches++;
+        }
+        free(rgba);
+    }
+
+    const uint8_t *planes = NULL;
+    const uint8_t *ref_planes = NULL;
+    uint64_t length = 0;
+    uint64_t ref_length = 0;
+    if (psd_document_get_composite_image(doc, &planes, &length, NULL) != PSD_OK ||
+        psd_document_get_composite_image(e->reference, &ref_planes, &ref_length, NULL) !=
+            PSD_OK ||
+        length != ref_length || memcmp(planes, ref_planes, (size_t)length) != 0) {
+        w->mismatches++;
+    }
+
+    size_t size = 0;
+    uint8_t *rgba = render_composite(doc, &size);
+    if (!rgba || size != e->composite_size || memcmp(rgba, e->composite_rgba, size) != 0) {
+        w->mismatches++;
+    }
+    free(rgba);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI shared_worker_main(LPVOID arg)
+{
+    shared_reads((worker_t *)arg);
+    return 0;
+}
+#else
+static void *shared_worker_main(void *arg)
+{
+    shared_reads((worker_t *)arg);
+    return NULL;
+}
+#endif
+
+/* Run the workers on one document; false if a thread could not start */
+static bool run_workers(worker_t *workers, size_t count)
+{
+#if defined(_WIN32)
+    HANDLE threads[SHARED_THREADS];
+#else
+    pthread_t threads[SHARED_THREADS];
+#endif
+    size_t started = 0;
+    for (; started < count; started++) {
+#if defined(_WIN32)
+        threads[started] = CreateThread(NULL, 0, shared_worker_main, &workers[started], 0, NULL);
+        if (!threads[started]) break;
+#else
+        if (pthread_create(&threads[started], NULL, shared_worker_main, &workers[started]) != 0) {
+            break;
+        }
+#endif
+    }
+    for (size_t i = 0; i < started; i++) {
+#if defined(_WIN32)
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+    return started == count;
+}
+
+static bool expected_init(expected_t *e, const uint8_t *bytes, size_t size,
+                          psd_stream_t **out_stream)
+{
+    memset(e, 0, sizeof(*e));
+    *out_stream = psd_stream_create_buffer(NULL, bytes, size);
+    e->reference = *out_stream ? psd_parse(*out_stream, NULL) : NULL;
+    if (!e->reference) {
+        return false;
+    }
+    psd_document_get_layer_count(e->reference, &e->layer_count);
+    if (e->layer_count < 1 || e->layer_count > 8) {
+        return false;
+    }
+    for (int32_t i = 0; i < e->layer_count; i++) {
+        e->layer_rgba[i] = render_layer(e->reference, i, &e->layer_size[i]);
+        psd_rect_t bounds;
+        if (!e->layer_rgba[i] ||
+            psd_document_get_layer_content_bounds(e->reference, i, &bounds, NULL) != PSD_OK) {
+            return false;
+        }
+    }
+    e->composite_rgba = render_composite(e->reference, &e->composite_size);
+    return e->composite_rgba != NULL;
+}
+
+static void expected_free(expected_t *e, psd_stream_t *stream)
+{
+    for (int32_t i = 0; i < 8; i++) {
+        free(e->layer_rgba[i]);
+    }
+    free(e->composite_rgba);
+    psd_document_free(e->reference);
+    psd_stream_destroy(stream);
+}
+
+/**
+ * @brief Race SHARED_THREADS readers over fresh documents parsed with flags
+ */
+static void check_shared(const psd_test_doc_spec_t *spec, uint32_t flags, const char *what)
+{
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(spec, &size);
+    expected_t expected;
+    memset(&expected, 0, sizeof(expected));
+    psd_stream_t *ref_stream = NULL;
+    char msg[160];
+    bool ready = bytes && expected_init(&expected, bytes, size, &ref_stream);
+    snprintf(msg, sizeof(msg), "%s: reference prepared on one thread", what);
+    ASSERT_TRUE(ready, msg);
+
+    int mismatches = 0;
+    bool started = true;
+    bool parsed = true;
+    for (int round = 0; ready && round < SHARED_ROUNDS; round++) {
+        /* Deferred loads read this stream, so it lives as long as the document */
+        psd_stream_t *stream = psd_stream_create_buffer(NULL, bytes, size);
+        psd_parse_options_t options = { flags, NULL };
+        psd_document_t *doc = stream ? psd_parse_with_options(stream, NULL, &options, NULL)
+                                     : NULL;
+        if (!doc) {
+            parsed = false;
+            psd_stream_destroy(stream);
+            break;
+        }
+
+        worker_t workers[SHARED_THREADS];
+        for (size_t i = 0; i < SHARED_THREADS; i++) {
+            workers[i].doc = doc;
+            workers[i].expected = &expected;
+            workers[i].first_layer = (int)i;
+            workers[i].mismatches = 0;
+        }
+        started = run_workers(workers, SHARED_THREADS) && started;
+        for (size_t i = 0; i < SHARED_THREADS; i++) {
+            mismatches += workers[i].mismatches;
+        }
+
+        psd_document_free(doc);
+        psd_stream_destroy(stream);
+    }
+
+    snprintf(msg, sizeof(msg), "%s: every thread started on parsed documents", what);
+    ASSERT_TRUE(ready && parsed && started, msg);
+    snprintf(msg, sizeof(msg), "%s: every thread reads what one thread reads", what);
+    ASSERT_TRUE(ready && mismatches == 0, msg);
+
+    expected_free(&expected, ref_stream);
+    free(bytes);
+}
+
+static void test_shared_reads(void)
+{
+    fprintf(stdout, "\n=== Test: concurrent first reads of a shared document ===\n");
+
+    static const uint8_t resource[4] = { 0, 1, 2, 3 };
+    psd_test_resource_t resources[1] = { { 1060, resource, sizeof(resource) } };
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.resources = resources;
+    spec.resource_count = 1;
+    check_shared(&spec, 0, "RLE document");
+    check_shared(&spec,
+                 PSD_PARSE_SKIP_LAYER_PIXELS | PSD_PARSE_SKIP_COMPOSITE |
+                     PSD_PARSE_SKIP_RESOURCES,
+                 "RLE document with deferred loads");
+
+    psd_test_default_spec(&spec);
+    spec.depth = 16;
+    spec.layer_compression = 0;
+    spec.composite_compression = 0;
+    check_shared(&spec, PSD_PARSE_SKIP_LAYER_PIXELS, "16-bit RAW document");
+
+#ifdef OPENPSD_TEST_HAVE_ZIP
+    psd_test_default_spec(&spec);
+    spec.layer_compression = 3;
+    spec.composite_compression = 2;
+    check_shared(&spec, 0, "ZIP document");
+    check_shared(&spec, PSD_PARSE_SKIP_LAYER_PIXELS | PSD_PARSE_SKIP_COMPOSITE,
+                 "ZIP document with deferred loads");
+#endif
+}
+
+#endif /* OPENPSD_TEST_HAVE_THREADS */
+
+int run_shared_document_tests(void)
+{
+    fprintf(stdout, "=== Shared document tests ===\n");
+
+#if defined(OPENPSD_TEST_HAVE_THREADS)
+    test_shared_reads();
+#else
+    fprintf(stdout, "Skipped: built without threads\n");
+#endif
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,342 @@
+/**
+ * @file test_stats.c
+ * @brief Tests for parse and decode statistics
+ *
+ * Stats are off unless asked for, phases and stream calls are counted while
+ * parsing, every allocation goes through the counting allocator, channel
+ * decodes are reported by compression and to the trace hooks, and repeated
+ * requests show up as cache hits.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+typedef struct {
+    int begins[PSD_PHASE_COUNT];
+    int ends[PSD_PHASE_COUNT];
+    int channels;
+    int failed_channels;
+    uint32_t last_compression;
+} trace_record_t;
+
+static void on_phase_begin(void *user_data, psd_phase_t phase)
+{
+    ((trace_record_t *)user_data)->begins[phase]++;
+}
+
+static void on_phase_end(void *user_data, psd_phase_t phase, uint64_t elapsed_ns)
+{
+    (void)elapsed_ns;
+    ((trace_record_t *)user_data)->ends[phase]++;
+}
+
+static void on_channel(void *user_data, const psd_trace_channel_t *channel)
+{
+    trace_record_t *record = (trace_record_t *)user_data;
+    record->channels++;
+    if (channel->status != PSD_OK || channel->decoded_bytes == 0) record->failed_channels++;
+    record->last_compression = channel->compression;
+}
+
+static uint8_t *build_document(uint16_t compression, size_t *size)
+{
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_compression = compression;
+    return psd_test_build_document(&spec, size);
+}
+
+static psd_document_t *parse(psd_stream_t *stream, uint32_t flags,
+                             const psd_trace_hooks_t *trace)
+{
+    psd_parse_options_t options = { flags, trace };
+    return psd_parse_with_options(stream, NULL, &options, NULL);
+}
+
+/* Channels of every layer, the number a full decode reports */
+static uint64_t total_channels(const psd_document_t *doc)
+{
+    int32_t layer_count = 0;
+    uint64_t total = 0;
+    (void)psd_document_get_layer_count(doc, &layer_count);
+    for (int32_t i = 0; i < layer_count; i++) {
+        size_t channels = 0;
+        if (psd_document_get_layer_channel_count(doc, i, &channels) == PSD_OK) total += channels;
+    }
+    return total;
+}
+
+static void test_stats_off(void)
+{
+    fprintf(stdout, "\n=== Test: stats are opt-in ===\n");
+
+    size_t size = 0;
+    uint8_t *bytes = build_document(1, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    ASSERT_TRUE(stream != NULL, "build synthetic document");
+    if (!stream) {
+        free(bytes);
+        return;
+    }
+
+    /* Hooks are ignored without PSD_PARSE_COLLECT_STATS */
+    trace_record_t record;
+    memset(&record, 0, sizeof(record));
+    psd_trace_hooks_t hooks = { on_phase_begin, on_phase_end, on_channel, &record };
+    psd_document_t *doc = parse(stream, 0, &hooks);
+    psd_stats_t stats;
+    ASSERT_TRUE(doc != NULL, "parse without stats");
+    ASSERT_TRUE(psd_document_get_stats(doc, &stats) == PSD_ERR_NOT_INITIALIZED &&
+                    psd_document_reset_stats(doc) == PSD_ERR_NOT_INITIALIZED,
+                "no counters without PSD_PARSE_COLLECT_STATS");
+    ASSERT_TRUE(psd_document_decode_all_layers(doc, NULL) == PSD_OK &&
+                    record.begins[PSD_PHASE_HEADER] == 0 && record.channels == 0,
+                "trace hooks need PSD_PARSE_COLLECT_STATS too");
+    ASSERT_TRUE(psd_document_get_stats(NULL, &stats) == PSD_ERR_NULL_POINTER &&
+                    psd_document_get_stats(doc, NULL) == PSD_ERR_NULL_POINTER &&
+                    psd_document_reset_stats(NULL) == PSD_ERR_NULL_POINTER,
+                "NULL arguments rejected");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_parse_counters(void)
+{
+    fprintf(stdout, "\n=== Test: parse counters ===\n");
+
+    size_t size = 0;
+    uint8_t *bytes = build_document(1, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? parse(stream, PSD_PARSE_COLLECT_STATS, NULL) : NULL;
+    ASSERT_TRUE(doc != NULL, "parse with stats");
+    if (!doc) {
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    psd_stats_t stats;
+    ASSERT_TRUE(psd_document_get_stats(doc, &stats) == PSD_OK, "get stats");
+    ASSERT_TRUE(stats.phase_count[PSD_PHASE_HEADER] == 1 &&
+                    stats.phase_count[PSD_PHASE_COLOR_MODE_DATA] == 1 &&
+                    stats.phase_count[PSD_PHASE_RESOURCES] == 1 &&
+                    stats.phase_count[PSD_PHASE_LAYER_INFO] == 1 &&
+                    stats.phase_count[PSD_PHASE_CHANNEL_READ] == 1 &&
+                    stats.phase_count[PSD_PHASE_TEXT_LAYERS] == 1 &&
+                    stats.phase_count[PSD_PHASE_COMPOSITE_READ] == 1 &&
+                    stats.phase_count[PSD_PHASE_LAYER_DECODE] == 0,
+                "each section is timed once and nothing is decoded yet");
+    ASSERT_TRUE(stats.phase_ns[PSD_PHASE_LAYER_INFO] >= stats.phase_ns[PSD_PHASE_CHANNEL_READ],
+                "layer info time includes the channel reads");
+    ASSERT_TRUE(stats.bytes_read > 0 && stats.bytes_read <= size && stats.stream_reads > 0,
+                "stream reads are counted");
+    ASSERT_TRUE(stats.allocations > 0 && stats.bytes_in_use > 0 &&
+                    stats.peak_bytes >= stats.bytes_in_use,
+                "allocations are counted");
+
+    /* Decoding every channel once, then asking for one again */
+    uint64_t channels = total_channels(doc);
+    ASSERT_TRUE(psd_document_decode_all_layers(doc, NULL) == PSD_OK, "decode all layers");
+    ASSERT_TRUE(psd_document_get_stats(doc, &stats) == PSD_OK &&
+                    stats.channels_decoded[1] == channels && stats.channels_decoded[0] == 0 &&
+                    stats.decode_cache_misses == channels && stats.decode_cache_hits == 0 &&
+                    stats.phase_count[PSD_PHASE_LAYER_DECODE] == channels &&
+                    stats.channel_bytes_decoded > 0,
+                "RLE channel decodes are counted as misses");
+
+    const uint8_t *data = NULL;
+    ASSERT_TRUE(psd_document_get_layer_channel_data(doc, 0, 0, NULL, &data, NULL, NULL) == PSD_OK &&
+                    data != NULL,
+                "get decoded channel");
+    ASSERT_TRUE(psd_document_get_stats(doc, &stats) == PSD_OK && stats.decode_cache_hits == 1 &&
+                    stats.decode_cache_misses == channels,
+                "second request is a hit");
+
+    /* Reset keeps the memory still in use */
+    ASSERT_TRUE(psd_document_reset_stats(doc) == PSD_OK, "reset stats");
+    psd_stats_t reset;
+    ASSERT_TRUE(psd_document_get_stats(doc, &reset) == PSD_OK &&
+                    reset.allocations == 0 && reset.bytes_read == 0 &&
+                    reset.decode_cache_hits == 0 && reset.phase_count[PSD_PHASE_HEADER] == 0 &&
+                    reset.bytes_in_use == stats.bytes_in_use &&
+                    reset.peak_bytes == reset.bytes_in_use,
+                "reset zeroes counters but not bytes in use");
+
+    ASSERT_TRUE(psd_document_free(doc) == PSD_OK, "free document");
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_trace_hooks(uint16_t compression, const char *label)
+{
+    fprintf(stdout, "\n=== Test: trace hooks (%s) ===\n", label);
+
+    size_t size = 0;
+    uint8_t *bytes = build_document(compression, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    trace_record_t record;
+    memset(&record, 0, sizeof(record));
+    psd_trace_hooks_t hooks = { on_phase_begin, on_phase_end, on_channel, &record };
+    psd_document_t *doc = stream ? parse(stream, PSD_PARSE_COLLECT_STATS, &hooks) : NULL;
+    ASSERT_TRUE(doc != NULL, "parse with trace hooks");
+    if (!doc) {
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    bool balanced = true;
+    for (int phase = 0; phase < PSD_PHASE_COUNT; phase++) {
+        if (record.begins[phase] != record.ends[phase]) balanced = false;
+    }
+    ASSERT_TRUE(balanced && record.begins[PSD_PHASE_HEADER] == 1 &&
+                    record.begins[PSD_PHASE_COMPOSITE_READ] == 1,
+                "every phase begun during parsing ends");
+
+    psd_stats_t stats;
+    uint64_t channels = total_channels(doc);
+    ASSERT_TRUE(psd_document_decode_all_layers(doc, NULL) == PSD_OK &&
+                    psd_document_get_stats(doc, &stats) == PSD_OK,
+                "decode all layers");
+    ASSERT_TRUE((uint64_t)record.channels == channels && record.failed_channels == 0 &&
+                    record.last_compression == compression &&
+                    stats.channels_decoded[compression] == channels,
+                "each channel decode is reported with its compression");
+    ASSERT_TRUE(record.begins[PSD_PHASE_LAYER_DECODE] == record.ends[PSD_PHASE_LAYER_DECODE],
+                "decode phases are balanced");
+
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_deferred_loads(void)
+{
+    fprintf(stdout, "\n=== Test: deferred loads ===\n");
+
+    size_t size = 0;
+    uint8_t *bytes = build_document(1, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc =
+        stream ? parse(stream, PSD_PARSE_COLLECT_STATS | PSD_PARSE_SKIP_LAYER_PIXELS |
+                                   PSD_PARSE_SKIP_COMPOSITE, NULL)
+               : NULL;
+    ASSERT_TRUE(doc != NULL, "parse without pixels");
+    if (!doc) {
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    psd_stats_t before;
+    psd_stats_t after;
+    ASSERT_TRUE(psd_document_get_stats(doc, &before) == PSD_OK, "get stats");
+    ASSERT_TRUE(psd_document_get_layer_channel_data(doc, 0, 0, NULL, NULL, NULL, NULL) == PSD_OK &&
+                    psd_document_get_stats(doc, &after) == PSD_OK,
+                "load and decode one channel");
+    ASSERT_TRUE(after.phase_count[PSD_PHASE_CHANNEL_READ] ==
+                        before.phase_count[PSD_PHASE_CHANNEL_READ] + 1 &&
+                    after.bytes_read > before.bytes_read &&
+                    after.stream_reads > before.stream_reads &&
+                    after.channels_decoded[1] == 1,
+                "deferred payload reads are counted");
+
+    uint8_t rgba[32 * 24 * 4];
+    ASSERT_TRUE(psd_document_render_composite_rgba8(doc, rgba, sizeof(rgba), NULL) == PSD_OK &&
+                    psd_document_get_stats(doc, &after) == PSD_OK &&
+                    after.phase_count[PSD_PHASE_COMPOSITE_READ] == 2 &&
+                    after.phase_count[PSD_PHASE_COMPOSITE_DECODE] == 1,
+                "deferred composite read and decode are timed");
+
+    psd_document_free(doc);
+
+    /* The stream stops counting once the document is gone */
+    ASSERT_TRUE(psd_stream_seek(stream, 0) == 0, "stream still usable after free");
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void test_tile_cache(void)
+{
+    fprintf(stdout, "\n=== Test: composite cache tiles ===\n");
+
+    size_t size = 0;
+    uint8_t *bytes = build_document(1, &size);
+    psd_stream_t *stream = bytes ? psd_stream_create_buffer(NULL, bytes, size) : NULL;
+    psd_document_t *doc = stream ? parse(stream, PSD_PARSE_COLLECT_STATS, NULL) : NULL;
+    psd_composite_cache_t *cache = NULL;
+    ASSERT_TRUE(doc != NULL && psd_composite_cache_create(doc, 16, 0, &cache) == PSD_OK,
+                "create composite cache");
+    if (!cache) {
+        psd_document_free(doc);
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    /* 32x24 canvas in 16 pixel tiles: 2 x 2 */
+    uint8_t rgba[32 * 24 * 4];
+    psd_stats_t stats;
+    ASSERT_TRUE(psd_composite_cache_render(cache, NULL, rgba, 32 * 4) == PSD_OK &&
+                    psd_document_get_stats(doc, &stats) == PSD_OK &&
+                    stats.tile_cache_misses == 4 && stats.tile_cache_hits == 0,
+                "first render composes every tile");
+    ASSERT_TRUE(psd_composite_cache_render(cache, NULL, rgba, 32 * 4) == PSD_OK &&
+                    psd_document_get_stats(doc, &stats) == PSD_OK &&
+                    stats.tile_cache_misses == 4 && stats.tile_cache_hits == 4,
+                "second render reuses every tile");
+
+    psd_composite_cache_destroy(cache);
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+int run_stats_tests(void)
+{
+    fprintf(stdout, "=== Stats tests ===\n");
+
+    test_stats_off();
+    test_parse_counters();
+    test_trace_hooks(0, "RAW");
+    test_trace_hooks(1, "RLE");
+#ifdef OPENPSD_TEST_HAVE_ZIP
+    test_trace_hooks(2, "ZIP");
+    test_trace_hooks(3, "ZIP with prediction");
+#endif
+    test_deferred_loads();
+    test_tile_cache();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,488 @@
+/**
+ * @file test_streams.c
+ * @brief Tests for built-in stream sources
+ *
+ * Exercises the memory-mapped file stream against the buffer stream using
+ * synthetic documents, including zero-copy payload lifetime, and the
+ * read-ahead window, positional reads and prefetch hints of custom streams.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef OPENPSD_TEST_OUTPUT_DIR
+#define OPENPSD_TEST_OUTPUT_DIR "."
+#endif
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+/* Compare every decoded channel of two documents */
+static bool same_layer_pixels(psd_document_t *a, psd_document_t *b)
+{
+    int32_t na = 0, nb = 0;
+    psd_document_get_layer_count(a, &na);
+    psd_document_get_layer_count(b, &nb);
+    if (na != nb) return false;
+
+    for (int32_t i = 0; i < na; i++) {
+        size_t ca = 0, cb = 0;
+        psd_document_get_layer_channel_count(a, i, &ca);
+        psd_document_get_layer_channel_count(b, i, &cb);
+        if (ca != cb) return false;
+        for (size_t c = 0; c < ca; c++) {
+            const uint8_t *da = NULL, *db = NULL;
+            uint64_t la = 0, lb = 0;
+            if (psd_document_get_layer_channel_data(a, i, c, NULL, &da, &la, NULL) != PSD_OK ||
+                psd_document_get_layer_channel_data(b, i, c, NULL, &db, &lb, NULL) != PSD_OK) {
+                return false;
+            }
+            if (la != lb || !da || !db || memcmp(da, db, (size_t)la) != 0) return false;
+        }
+    }
+    return true;
+}
+
+static void test_mmap_stream(void)
+{
+    fprintf(stdout, "\n=== Test: memory-mapped file stream ===\n");
+
+    static const uint8_t xmp[] = "<x:xmpmeta/>";
+    psd_test_resource_t res = { 1060, xmp, sizeof(xmp) };
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.resources = &res;
+    spec.resource_count = 1;
+
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    ASSERT_TRUE(bytes != NULL, "build synthetic document");
+    if (!bytes) return;
+
+    char path[512];
+    (void)snprintf(path, sizeof(path), "%s/openpsd_mmap_test.psd", OPENPSD_TEST_OUTPUT_DIR);
+    ASSERT_TRUE(psd_test_write_file(path, bytes, size), "write synthetic document");
+
+    ASSERT_TRUE(psd_stream_create_file_mmap(NULL, NULL) == NULL, "NULL path rejected");
+    ASSERT_TRUE(psd_stream_create_file_mmap(NULL, "/nonexistent/openpsd.psd") == NULL,
+                "missing file rejected");
+
+    psd_stream_t *mapped = psd_stream_create_file_mmap(NULL, path);
+    ASSERT_TRUE(mapped != NULL, "create mmap stream");
+    psd_stream_t *buffered = psd_stream_create_buffer(NULL, bytes, size);
+
+    psd_document_t *doc_mapped = mapped ? psd_parse(mapped, NULL) : NULL;
+    psd_document_t *doc_buffered = psd_parse(buffered, NULL);
+    ASSERT_TRUE(doc_mapped != NULL && doc_buffered != NULL, "parse from both streams");
+
+    /* The document keeps the mapping alive on its own */
+    psd_stream_destroy(mapped);
+
+    if (doc_mapped && doc_buffered) {
+        ASSERT_TRUE(same_layer_pixels(doc_mapped, doc_buffered),
+                    "mapped channel data matches buffered after stream destroy");
+
+        size_t index = 0;
+        uint16_t id = 0;
+        const uint8_t *data = NULL;
+        uint64_t length = 0;
+        bool found = psd_document_find_resource(doc_mapped, 1060, &index) == PSD_OK &&
+                     psd_document_get_resource(doc_mapped, index, &id, &data, &length) == PSD_OK;
+        ASSERT_TRUE(found && length == sizeof(xmp) && memcmp(data, xmp, sizeof(xmp)) == 0,
+                    "mapped resource data matches");
+    }
+
+    psd_document_free(doc_mapped);
+    psd_document_free(doc_buffered);
+    psd_stream_destroy(buffered);
+    free(bytes);
+    (void)remove(path);
+}
+
+/* Custom stream over memory that counts its callbacks */
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    size_t position;
+    size_t reads;
+    size_t seeks;
+    size_t largest_read;
+} counting_source_t;
+
+static int64_t counting_read(psd_stream_t *stream, void *buffer, size_t count, void *user)
+{
+    (void)stream;
+    counting_source_t *src = (counting_source_t *)user;
+    size_t left = src->length - src->position;
+    size_t n = (count < left) ? count : left;
+    memcpy(buffer, src->data + src->position, n);
+    src->position += n;
+    src->reads++;
+    if (count > src->largest_read) src->largest_read = count;
+    return (int64_t)n;
+}
+
+static int64_t counting_write(psd_stream_t *stream, const void *buffer, size_t count, void *user)
+{
+    (void)stream;
+    (void)buffer;
+    (void)count;
+    (void)user;
+    return PSD_ERR_STREAM_INVALID;
+}
+
+static int64_t counting_seek(psd_stream_t *stream, int64_t offset, void *user)
+{
+    (void)stream;
+    counting_source_t *src = (counting_source_t *)user;
+    if (offset < 0 || (uint64_t)offset > src->length) return PSD_ERR_OUT_OF_RANGE;
+    src->position = (size_t)offset;
+    src->seeks++;
+    return offset;
+}
+
+static int64_t counting_tell(psd_stream_t *stream, void *user)
+{
+    (void)stream;
+    return (int64_t)((counting_source_t *)user)->position;
+}
+
+static const psd_stream_vtable_t counting_vtable = {
+    counting_read, counting_write, counting_seek, counting_tell, NULL
+};
+
+static void test_custom_stream_read_ahead(void)
+{
+    fprintf(stdout, "\n=== Test: custom stream read-ahead ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.width = 64;
+    spec.height = 48;
+    spec.layer_count = 12;
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    ASSERT_TRUE(bytes != NULL, "build synthetic document");
+    if (!bytes) return;
+
+    counting_source_t plain = { bytes, size, 0, 0, 0, 0 };
+    counting_source_t ahead = { bytes, size, 0, 0, 0, 0 };
+    psd_stream_t *s_plain = psd_stream_create_custom(NULL, &counting_vtable, &plain);
+    psd_stream_t *s_ahead = psd_stream_create_custom(NULL, &counting_vtable, &ahead);
+    ASSERT_TRUE(psd_stream_set_read_buffer(s_plain, 0) == PSD_OK &&
+                    psd_stream_set_read_buffer(NULL, 0) == PSD_ERR_NULL_POINTER,
+                "read-ahead can be turned off");
+
+    psd_document_t *doc_plain = psd_parse(s_plain, NULL);
+    psd_document_t *doc_ahead = psd_parse(s_ahead, NULL);
+    ASSERT_TRUE(doc_plain && doc_ahead && same_layer_pixels(doc_plain, doc_ahead),
+                "buffered parse matches unbuffered parse");
+    ASSERT_TRUE(ahead.reads * 20u < plain.reads,
+                "read-ahead turns many small reads into few callbacks");
+    psd_document_free(doc_plain);
+    psd_document_free(doc_ahead);
+
+    /* Seeks inside the window and short reads/skips stay off the callbacks */
+    uint8_t chunk[64];
+    size_t reads = 0, seeks = 0;
+    bool ok = psd_stream_seek(s_ahead, 100) == 100 && psd_stream_read_exact(s_ahead, chunk, 8) == PSD_OK;
+    reads = ahead.reads;
+    seeks = ahead.seeks;
+    ok = ok && psd_stream_seek(s_ahead, 40 + 100) == 140 &&
+         psd_stream_skip(s_ahead, 20) == PSD_OK && psd_stream_tell(s_ahead) == 160 &&
+         psd_stream_read_exact(s_ahead, chunk, sizeof(chunk)) == PSD_OK &&
+         memcmp(chunk, bytes + 160, sizeof(chunk)) == 0 &&
+         psd_stream_seek(s_ahead, 104) == 104 && psd_stream_read_exact(s_ahead, chunk, 4) == PSD_OK &&
+         memcmp(chunk, bytes + 104, 4) == 0;
+    ASSERT_TRUE(ok && ahead.reads == reads && ahead.seeks == seeks,
+                "seeks and reads inside the window are served from it");
+
+    /* With a 1 KB window, a larger read passes through in one callback */
+    size_t large = size - 200;
+    uint8_t *copy = (uint8_t *)malloc(large);
+    ahead.largest_read = 0;
+    ok = copy && large > 1024 && psd_stream_set_read_buffer(s_ahead, 1024) == PSD_OK &&
+         psd_stream_seek(s_ahead, 200) == 200 &&
+         psd_stream_read_exact(s_ahead, copy, large) == PSD_OK &&
+         memcmp(copy, bytes + 200, large) == 0 && psd_stream_tell(s_ahead) == (int64_t)size;
+    ASSERT_TRUE(ok && ahead.largest_read == large, "large reads bypass the window");
+    free(copy);
+
+    /* Dropping the window puts the callbacks back at the caller's position */
+    ok = psd_stream_seek(s_ahead, 10) == 10 && psd_stream_read_exact(s_ahead, chunk, 2) == PSD_OK &&
+         psd_stream_set_read_buffer(s_ahead, 0) == PSD_OK && ahead.position == 12 &&
+         psd_stream_read_exact(s_ahead, chunk, 4) == PSD_OK && memcmp(chunk, bytes + 12, 4) == 0;
+    ASSERT_TRUE(ok, "turning read-ahead off keeps the position");
+    ASSERT_TRUE(psd_stream_read_exact(s_ahead, chunk, 0) == PSD_OK &&
+                    psd_stream_seek(s_ahead, (int64_t)size) == (int64_t)size &&
+                    psd_stream_skip(s_ahead, 1) == PSD_ERR_STREAM_EOF,
+                "skip past the end still reports EOF");
+
+    psd_stream_destroy(s_plain);
+    psd_stream_destroy(s_ahead);
+    free(bytes);
+}
+
+/* Counting source that also records positional reads and prefetch hints */
+typedef struct {
+    counting_source_t base;
+    size_t prefetch_calls;
+    psd_stream_range_t ranges[16];
+    size_t range_count;
+    size_t read_ats;
+    size_t read_ats_outside;
+} scatter_source_t;
+
+static int64_t scatter_read_at(psd_stream_t *stream, uint64_t offset, void *buffer, size_t count,
+                               void *user)
+{
+    (void)stream;
+    scatter_source_t *src = (scatter_source_t *)user;
+    src->read_ats++;
+    bool inside = false;
+    for (size_t i = 0; i < src->range_count; i++) {
+        inside = inside || (offset >= src->ranges[i].offset &&
+                            offset + count <= src->ranges[i].offset + src->ranges[i].length);
+    }
+    if (!inside) src->read_ats_outside++;
+    if (offset > src->base.length) return PSD_ERR_OUT_OF_RANGE;
+    size_t left = src->base.length - (size_t)offset;
+    size_t n = (count < left) ? count : left;
+    memcpy(buffer, src->base.data + offset, n);
+    return (int64_t)n;
+}
+
+static psd_status_t scatter_prefetch(psd_stream_t *stream, const psd_stream_range_t *ranges,
+                                     size_t count, void *user)
+{
+    (void)stream;
+    scatter_source_t *src = (scatter_source_t *)user;
+    src->prefetch_calls++;
+    src->range_count = (count < 16) ? count : 16;
+    memcpy(src->ranges, ranges, src->range_count * sizeof(*ranges));
+    return PSD_OK;
+}
+
+static const psd_stream_vtable_t scatter_vtable = {
+    counting_read, counting_write, counting_seek, counting_tell, NULL,
+    scatter_read_at, scatter_prefetch
+};
+
+static void test_custom_stream_prefetch(void)
+{
+    fprintf(stdout, "\n=== Test: custom stream prefetch and positional reads ===\n");
+
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_count = 6;
+    size_t size = 0;
+    uint8_t *bytes = psd_test_build_document(&spec, &size);
+    ASSERT_TRUE(bytes != NULL, "build synthetic document");
+    if (!bytes) return;
+
+    scatter_source_t src;
+    memset(&src, 0, sizeof(src));
+    src.base.data = bytes;
+    src.base.length = size;
+    psd_stream_t *stream = psd_stream_create_custom(NULL, &scatter_vtable, &src);
+    psd_parse_options_t options = { PSD_PARSE_SKIP_LAYER_PIXELS };
+    psd_document_t *doc = stream ? psd_parse_with_options(stream, NULL, &options, NULL) : NULL;
+    ASSERT_TRUE(doc != NULL, "deferred parse from a scatter stream");
+    if (!doc) {
+        psd_stream_destroy(stream);
+        free(bytes);
+        return;
+    }
+
+    /* Layer i starts at (i, i): this corner touches layers 0 and 1 only */
+    psd_rect_t corner = { 0, 0, 2, 2 };
+    uint8_t rgba[2 * 2 * 4];
+    size_t seeks = src.base.seeks;
+    ASSERT_TRUE(psd_document_flatten_rgba8(doc, &corner, rgba, 8) == PSD_OK,
+                "flatten a corner");
+    ASSERT_TRUE(src.prefetch_calls == 1 && src.range_count == 1,
+                "the corner's layers are announced as one merged range");
+    ASSERT_TRUE(src.read_ats == 8 && src.read_ats_outside == 0 && src.base.seeks == seeks,
+                "only their payloads are read, positionally, within the hint");
+
+    uint64_t corner_end = src.ranges[0].offset + src.ranges[0].length;
+    ASSERT_TRUE(psd_document_decode_all_layers(doc, NULL) == PSD_OK &&
+                    src.prefetch_calls == 2 && src.range_count == 1 &&
+                    src.ranges[0].offset > corner_end && src.read_ats == 24 &&
+                    src.read_ats_outside == 0,
+                "decoding everything announces just the payloads still on disk");
+    ASSERT_TRUE(psd_document_prefetch_layers(doc, NULL, 0) == PSD_OK && src.prefetch_calls == 2,
+                "nothing left to prefetch once resident");
+
+    int32_t bad = 6;
+    ASSERT_TRUE(psd_document_prefetch_layers(doc, &bad, 1) == PSD_ERR_OUT_OF_RANGE &&
+                    psd_document_prefetch_layers(NULL, NULL, 0) == PSD_ERR_NULL_POINTER &&
+                    psd_document_prefetch_layers(doc, NULL, 1) == PSD_ERR_NULL_POINTER,
+                "prefetch checks its arguments");
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+
+    /* Without a read_at callback, positional reads seek and restore */
+    counting_source_t plain = { bytes, size, 0, 0, 0, 0 };
+    stream = psd_stream_create_custom(NULL, &counting_vtable, &plain);
+    uint8_t chunk[16];
+    bool ok = stream && psd_stream_seek(stream, 5) == 5 &&
+              psd_stream_read_at(stream, 300, chunk, sizeof(chunk)) == (int64_t)sizeof(chunk) &&
+              memcmp(chunk, bytes + 300, sizeof(chunk)) == 0 && psd_stream_tell(stream) == 5 &&
+              psd_stream_read_exact(stream, chunk, 4) == PSD_OK && memcmp(chunk, bytes + 5, 4) == 0;
+    ASSERT_TRUE(ok, "fallback positional read keeps the position");
+    ASSERT_TRUE(stream && psd_stream_read_at(stream, size - 4, chunk, sizeof(chunk)) == 4 &&
+                    psd_stream_prefetch(stream, NULL, 0) == PSD_OK,
+                "short positional read at the end, prefetch without a callback");
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+/* Read a whole stream and compare it with expected bytes */
+static bool stream_reads(psd_stream_t *stream, const uint8_t *expected, size_t length)
+{
+    uint8_t chunk[37];
+    size_t done = 0;
+    while (done < length) {
+        int64_t n = psd_stream_read(stream, chunk, sizeof(chunk));
+        if (n <= 0 || done + (size_t)n > length || memcmp(chunk, expected + done, (size_t)n) != 0) {
+            return false;
+        }
+        done += (size_t)n;
+    }
+    return psd_stream_read(stream, chunk, 1) == 0;
+}
+
+static void test_substreams(void)
+{
+    fprintf(stdout, "\n=== Test: sub-streams ===\n");
+
+    uint8_t bytes[1000];
+    for (size_t i = 0; i < sizeof(bytes); i++) bytes[i] = (uint8_t)(i * 7 + 3);
+    char path[512];
+    (void)snprintf(path, sizeof(path), "%s/openpsd_substream_test.bin", OPENPSD_TEST_OUTPUT_DIR);
+    ASSERT_TRUE(psd_test_write_file(path, bytes, sizeof(bytes)), "write test file");
+
+    psd_stream_t *buffered = psd_stream_create_buffer(NULL, bytes, sizeof(bytes));
+    psd_stream_t *mapped = psd_stream_create_file_mmap(NULL, path);
+    scatter_source_t src;
+    memset(&src, 0, sizeof(src));
+    src.base.data = bytes;
+    src.base.length = sizeof(bytes);
+    psd_stream_t *custom = psd_stream_create_custom(NULL, &scatter_vtable, &src);
+    counting_source_t plain = { bytes, sizeof(bytes), 0, 0, 0, 0 };
+    psd_stream_t *seeking = psd_stream_create_custom(NULL, &counting_vtable, &plain);
+    ASSERT_TRUE(buffered && mapped && custom && seeking, "create parent streams");
+
+    ASSERT_TRUE(psd_stream_create_substream(NULL, 0, 1) == NULL &&
+                    psd_stream_create_substream(buffered, 0, 0) == NULL &&
+                    psd_stream_create_substream(buffered, 900, 101) == NULL &&
+                    psd_stream_create_substream(mapped, 1001, 1) == NULL,
+                "empty and out-of-range windows are rejected");
+
+    psd_stream_t *parents[4] = { buffered, mapped, custom, seeking };
+    const char *names[4] = { "buffer", "mapped", "custom", "seek-and-read" };
+    for (int i = 0; i < 4; i++) {
+        char msg[128];
+        psd_stream_t *sub = psd_stream_create_substream(parents[i], 100, 600);
+        psd_stream_t *inner = sub ? psd_stream_create_substream(sub, 50, 200) : NULL;
+        (void)snprintf(msg, sizeof(msg), "%s: window and window of window created", names[i]);
+        ASSERT_TRUE(sub && inner, msg);
+        if (!sub || !inner) {
+            psd_stream_destroy(inner);
+            psd_stream_destroy(sub);
+            continue;
+        }
+
+        (void)snprintf(msg, sizeof(msg), "%s: window reads its range and stops at the end",
+                       names[i]);
+        ASSERT_TRUE(stream_reads(sub, bytes + 100, 600), msg);
+
+        uint8_t chunk[16];
+        (void)snprintf(msg, sizeof(msg), "%s: seek, tell and positional reads are window-relative",
+                       names[i]);
+        ASSERT_TRUE(psd_stream_seek(sub, 10) == 10 && psd_stream_tell(sub) == 10 &&
+                        psd_stream_read_exact(sub, chunk, 4) == PSD_OK &&
+                        memcmp(chunk, bytes + 110, 4) == 0 &&
+                        psd_stream_read_at(sub, 590, chunk, sizeof(chunk)) == 10 &&
+                        memcmp(chunk, bytes + 690, 10) == 0 && psd_stream_tell(sub) == 14 &&
+                        psd_stream_seek(sub, 601) < 0,
+                    msg);
+
+        (void)snprintf(msg, sizeof(msg), "%s: nested window reads the outer stream directly",
+                       names[i]);
+        ASSERT_TRUE(stream_reads(inner, bytes + 150, 200) &&
+                        psd_stream_create_substream(sub, 500, 101) == NULL,
+                    msg);
+
+        (void)snprintf(msg, sizeof(msg), "%s: windows are read-only", names[i]);
+        ASSERT_TRUE(psd_stream_write(sub, chunk, 1) < 0, msg);
+
+        psd_stream_destroy(sub);
+        (void)snprintf(msg, sizeof(msg), "%s: nested window outlives the window it came from",
+                       names[i]);
+        ASSERT_TRUE(psd_stream_seek(inner, 0) == 0 && stream_reads(inner, bytes + 150, 200), msg);
+        psd_stream_destroy(inner);
+    }
+
+    /* Hints are shifted into parent coordinates and clipped to the window */
+    psd_stream_t *sub = psd_stream_create_substream(custom, 100, 600);
+    psd_stream_range_t hints[2] = { { 0, 50 }, { 550, 100 } };
+    ASSERT_TRUE(sub && psd_stream_prefetch(sub, hints, 2) == PSD_OK && src.prefetch_calls == 1 &&
+                    src.range_count == 2 && src.ranges[0].offset == 100 &&
+                    src.ranges[0].length == 50 && src.ranges[1].offset == 650 &&
+                    src.ranges[1].length == 50,
+                "prefetch hints reach the parent in its coordinates");
+    psd_stream_destroy(sub);
+
+    /* A mapped window keeps the file mapped after its parent is gone */
+    sub = psd_stream_create_substream(mapped, 200, 300);
+    psd_stream_destroy(mapped);
+    ASSERT_TRUE(sub && stream_reads(sub, bytes + 200, 300),
+                "mapped window outlives the mapped stream");
+    psd_stream_destroy(sub);
+
+    psd_stream_destroy(seeking);
+    psd_stream_destroy(custom);
+    psd_stream_destroy(buffered);
+    (void)remove(path);
+}
+
+int run_stream_tests(void)
+{
+    fprintf(stdout, "=== Stream tests ===\n");
+
+    test_mmap_stream();
+    test_custom_stream_read_ahead();
+    test_custom_stream_prefetch();
+    test_substreams();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,292 @@
+/**
+ * @file test_tagged_blocks.c
+ * @brief Tests for looking up a layer's tagged blocks
+ *
+ * Blocks are found by key with their payload in place, odd lengths keep the
+ * following block aligned, descriptors are located inside their blocks only
+ * when asked for, and PSB files read 8-byte lengths for the keys that use
+ * them.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+#define KEY(a, b, c, d) \
+    (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+typedef struct {
+    uint8_t data[1024];
+    size_t size;
+} byte_buf_t;
+
+static void put(byte_buf_t *b, const void *src, size_t n)
+{
+    if (b->size + n <= sizeof(b->data)) {
+        memcpy(b->data + b->size, src, n);
+    }
+    b->size += n;
+}
+
+static void put_be32(byte_buf_t *b, uint32_t v)
+{
+    uint8_t bytes[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+    put(b, bytes, 4);
+}
+
+/* Descriptor with no name, class 'null' and one member 'Md  ' = long value */
+static void put_descriptor(byte_buf_t *b, uint32_t value)
+{
+    put_be32(b, 0);
+    put_be32(b, 0);
+    put(b, "null", 4);
+    put_be32(b, 1);
+    put_be32(b, 0);
+    put(b, "Md  ", 4);
+    put(b, "long", 4);
+    put_be32(b, value);
+}
+
+/* 8BIM block with a 4-byte length, padded to even */
+static void put_block(byte_buf_t *b, const char *key, const byte_buf_t *payload)
+{
+    put(b, "8BIM", 4);
+    put(b, key, 4);
+    put_be32(b, (uint32_t)payload->size);
+    put(b, payload->data, payload->size);
+    if (payload->size & 1u) {
+        put(b, "", 1);
+    }
+}
+
+typedef struct {
+    uint8_t *bytes;
+    psd_stream_t *stream;
+    psd_document_t *doc;
+} block_doc_t;
+
+static void parse_block_doc(block_doc_t *t, const psd_test_layer_t *layers, uint16_t count,
+                            bool psb)
+{
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.layer_count = count;
+    spec.layers = layers;
+    spec.psb = psb;
+
+    size_t size = 0;
+    t->bytes = psd_test_build_document(&spec, &size);
+    t->stream = t->bytes ? psd_stream_create_buffer(NULL, t->bytes, size) : NULL;
+    psd_parse_options_t options = { PSD_PARSE_SKIP_LAYER_PIXELS, NULL };
+    t->doc = t->stream ? psd_parse_with_options(t->stream, NULL, &options, NULL) : NULL;
+}
+
+static void free_block_doc(block_doc_t *t)
+{
+    psd_document_free(t->doc);
+    psd_stream_destroy(t->stream);
+    free(t->bytes);
+}
+
+static void test_lookup(void)
+{
+    fprintf(stdout, "\n=== Test: block lookup ===\n");
+
+    /* lyid, an odd-length unknown block, SoCo (descriptor plus trailing
+     * bytes), a truncated GdFl and lfx2 */
+    byte_buf_t blocks = { { 0 }, 0 };
+    byte_buf_t payload = { { 0 }, 0 };
+    put_be32(&payload, 0x01020304u);
+    put_block(&blocks, "lyid", &payload);
+
+    payload.size = 0;
+    put(&payload, "abc", 3);
+    put_block(&blocks, "xodd", &payload);
+
+    payload.size = 0;
+    put_be32(&payload, 16);
+    put_descriptor(&payload, 7);
+    put(&payload, "\0\0", 2);
+    size_t soco_length = payload.size;
+    put_block(&blocks, "SoCo", &payload);
+
+    payload.size = 0;
+    put_be32(&payload, 16);
+    put_be32(&payload, 0);
+    put_be32(&payload, 0);
+    put(&payload, "nu", 2);
+    put_block(&blocks, "GdFl", &payload);
+
+    payload.size = 0;
+    put_be32(&payload, 0);
+    put_be32(&payload, 16);
+    put_descriptor(&payload, 9);
+    put_block(&blocks, "lfx2", &payload);
+
+    psd_test_layer_t layers[2];
+    memset(layers, 0, sizeof(layers));
+    layers[0].opacity = 255;
+    layers[0].blocks = blocks.data;
+    layers[0].blocks_length = blocks.size;
+    layers[1].opacity = 255;
+    layers[1].section = 1;
+
+    block_doc_t t;
+    parse_block_doc(&t, layers, 2, false);
+    ASSERT_TRUE(t.doc != NULL, "parse document with tagged blocks");
+    if (!t.doc) {
+        free_block_doc(&t);
+        return;
+    }
+
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(t.doc, 0, KEY('l', 'y', 'i', 'd'), &data,
+                                                    &length, NULL, NULL) == PSD_OK &&
+                    length == 4 && data && memcmp(data, "\x01\x02\x03\x04", 4) == 0,
+                "payload returned in place");
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(t.doc, 0, KEY('x', 'o', 'd', 'd'), &data,
+                                                    &length, NULL, NULL) == PSD_OK &&
+                    length == 3 && memcmp(data, "abc", 3) == 0,
+                "odd length reported without the pad byte");
+
+    const uint8_t *desc = NULL;
+    uint64_t desc_length = 0;
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(t.doc, 0, KEY('S', 'o', 'C', 'o'), &data,
+                                                    &length, &desc, &desc_length) == PSD_OK &&
+                    length == soco_length && desc == data + 4 &&
+                    desc_length == soco_length - 6,
+                "block after an odd one found, descriptor located inside it");
+    const uint8_t *again = NULL;
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(t.doc, 0, KEY('S', 'o', 'C', 'o'), NULL,
+                                                    NULL, &again, NULL) == PSD_OK &&
+                    again == desc,
+                "descriptor served again from the cache");
+
+    desc = data;
+    desc_length = 1;
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(t.doc, 0, KEY('l', 'y', 'i', 'd'), NULL,
+                                                    NULL, &desc, &desc_length) == PSD_OK &&
+                    desc == NULL && desc_length == 0,
+                "block without a descriptor");
+
+    data = NULL;
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(t.doc, 0, KEY('G', 'd', 'F', 'l'), &data,
+                                                    &length, &desc, NULL) ==
+                        PSD_ERR_CORRUPT_DATA &&
+                    data != NULL && length == 14 && desc == NULL,
+                "truncated descriptor reported, payload still returned");
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(t.doc, 0, KEY('G', 'd', 'F', 'l'), NULL,
+                                                    NULL, &desc, NULL) == PSD_ERR_CORRUPT_DATA,
+                "truncated descriptor stays an error");
+
+    const uint8_t *effects = NULL;
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(t.doc, 0, KEY('l', 'f', 'x', '2'), &data,
+                                                    NULL, &effects, NULL) == PSD_OK &&
+                    effects == data + 8,
+                "effects descriptor after both version fields");
+    ASSERT_TRUE(psd_document_get_layer_descriptor(t.doc, 0, &desc, &desc_length) == PSD_OK &&
+                    desc == effects && desc_length == soco_length - 6,
+                "layer descriptor prefers effects");
+
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(t.doc, 1, KEY('l', 's', 'c', 't'), &data,
+                                                    &length, NULL, NULL) == PSD_OK &&
+                    length >= 4 && data[3] == 1,
+                "section divider block indexed");
+    ASSERT_TRUE(psd_document_get_layer_descriptor(t.doc, 1, &desc, &desc_length) == PSD_OK &&
+                    desc == NULL && desc_length == 0,
+                "layer without a descriptor");
+
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(t.doc, 0, KEY('l', 's', 'c', 't'), &data,
+                                                    &length, NULL, NULL) ==
+                    PSD_ERR_INVALID_ARGUMENT,
+                "missing key not found");
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(t.doc, 2, KEY('l', 'y', 'i', 'd'), NULL,
+                                                    NULL, NULL, NULL) == PSD_ERR_OUT_OF_RANGE &&
+                    psd_document_get_layer_tagged_block(t.doc, -1, KEY('l', 'y', 'i', 'd'), NULL,
+                                                        NULL, NULL, NULL) == PSD_ERR_OUT_OF_RANGE,
+                "layer index checked");
+    ASSERT_TRUE(psd_document_get_layer_tagged_block(NULL, 0, KEY('l', 'y', 'i', 'd'), NULL,
+                                                    NULL, NULL, NULL) == PSD_ERR_NULL_POINTER,
+                "NULL document rejected");
+
+    free_block_doc(&t);
+}
+
+/* 'FMsk' has an 8-byte length in PSB files; the block after it stays reachable */
+static void test_psb_lengths(void)
+{
+    fprintf(stdout, "\n=== Test: PSB block lengths ===\n");
+
+    byte_buf_t blocks = { { 0 }, 0 };
+    put(&blocks, "8BIMFMsk", 8);
+    put_be32(&blocks, 0);
+    put_be32(&blocks, 6);
+    put(&blocks, "\x00\x01\x02\x03\x04\x05", 6);
+    byte_buf_t payload = { { 0 }, 0 };
+    put_be32(&payload, 42);
+    put_block(&blocks, "lyid", &payload);
+
+    psd_test_layer_t layers[1];
+    memset(layers, 0, sizeof(layers));
+    layers[0].opacity = 255;
+    layers[0].blocks = blocks.data;
+    layers[0].blocks_length = blocks.size;
+
+    block_doc_t t;
+    parse_block_doc(&t, layers, 1, true);
+    ASSERT_TRUE(t.doc != NULL, "parse PSB document");
+
+    const uint8_t *data = NULL;
+    uint64_t length = 0;
+    ASSERT_TRUE(t.doc &&
+                    psd_document_get_layer_tagged_block(t.doc, 0, KEY('F', 'M', 's', 'k'), &data,
+                                                        &length, NULL, NULL) == PSD_OK &&
+                    length == 6 && data[5] == 5,
+                "8-byte length read");
+    ASSERT_TRUE(t.doc &&
+                    psd_document_get_layer_tagged_block(t.doc, 0, KEY('l', 'y', 'i', 'd'), &data,
+                                                        &length, NULL, NULL) == PSD_OK &&
+                    length == 4 && data[3] == 42,
+                "block after a long-length block found");
+
+    free_block_doc(&t);
+}
+
+int run_tagged_blocks_tests(void)
+{
+    fprintf(stdout, "=== Tagged block tests ===\n");
+
+    test_lookup();
+    test_psb_lengths();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
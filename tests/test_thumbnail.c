@@ -0,0 +1,288 @@
+/**
+ * @file test_thumbnail.c
+ * @brief Tests for thumbnail image resources
+ *
+ * JPEG (1036) and raw Photoshop 4.0 (1033) thumbnails are found, their
+ * headers parsed and their pixels decoded, also from documents parsed with
+ * PSD_PARSE_STOP_AFTER_RESOURCES.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+#include "psd_test_builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+#define THUMB_W 8u
+#define THUMB_H 6u
+
+/* 8x6 baseline JPEG, every pixel (200, 40, 90) */
+static const uint8_t jpeg_8x6[] = {
+    0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 0x4A, 0x46, 0x49, 0x46, 0x00, 0x01,
+    0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xFF, 0xDB, 0x00, 0x43,
+    0x00, 0x02, 0x01, 0x01, 0x01, 0x01, 0x01, 0x02, 0x01, 0x01, 0x01, 0x02,
+    0x02, 0x02, 0x02, 0x02, 0x04, 0x03, 0x02, 0x02, 0x02, 0x02, 0x05, 0x04,
+    0x04, 0x03, 0x04, 0x06, 0x05, 0x06, 0x06, 0x06, 0x05, 0x06, 0x06, 0x06,
+    0x07, 0x09, 0x08, 0x06, 0x07, 0x09, 0x07, 0x06, 0x06, 0x08, 0x0B, 0x08,
+    0x09, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x06, 0x08, 0x0B, 0x0C, 0x0B, 0x0A,
+    0x0C, 0x09, 0x0A, 0x0A, 0x0A, 0xFF, 0xDB, 0x00, 0x43, 0x01, 0x02, 0x02,
+    0x02, 0x02, 0x02, 0x02, 0x05, 0x03, 0x03, 0x05, 0x0A, 0x07, 0x06, 0x07,
+    0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A,
+    0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A,
+    0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A,
+    0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A,
+    0x0A, 0x0A, 0xFF, 0xC0, 0x00, 0x11, 0x08, 0x00, 0x06, 0x00, 0x08, 0x03,
+    0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01, 0xFF, 0xC4, 0x00,
+    0x15, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0xFF, 0xC4, 0x00, 0x14,
+    0x10, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xC4, 0x00, 0x15, 0x01, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x04, 0x09, 0xFF, 0xC4, 0x00, 0x14, 0x11, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0xFF, 0xDA, 0x00, 0x0C, 0x03, 0x01, 0x00, 0x02, 0x11,
+    0x03, 0x11, 0x00, 0x3F, 0x00, 0x9D, 0xC0, 0x1D, 0x4C, 0x1F, 0xFF, 0xD9,
+    
+};
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+/* The 28-byte resource header in front of the image data */
+static void put_header(uint8_t *p, uint32_t format, uint32_t width, uint32_t height,
+                       uint32_t width_bytes, uint32_t data_size)
+{
+    memset(p, 0, 28);
+    put_be32(p, format);
+    put_be32(p + 4, width);
+    put_be32(p + 8, height);
+    put_be32(p + 12, width_bytes);
+    put_be32(p + 16, width_bytes * height);
+    put_be32(p + 20, data_size);
+    p[25] = 24;
+    p[27] = 1;
+}
+
+static psd_document_t *build(const psd_test_resource_t *resources, size_t count, uint32_t flags,
+                             uint8_t **bytes, psd_stream_t **stream)
+{
+    psd_test_doc_spec_t spec;
+    psd_test_default_spec(&spec);
+    spec.resources = resources;
+    spec.resource_count = count;
+
+    size_t size = 0;
+    *bytes = psd_test_build_document(&spec, &size);
+    *stream = *bytes ? psd_stream_create_buffer(NULL, *bytes, size) : NULL;
+    psd_parse_options_t options = { flags };
+    return *stream ? psd_parse_with_options(*stream, NULL, &options, NULL) : NULL;
+}
+
+static void release(psd_document_t *doc, psd_stream_t *stream, uint8_t *bytes)
+{
+    psd_document_free(doc);
+    psd_stream_destroy(stream);
+    free(bytes);
+}
+
+static void check_jpeg(uint32_t flags, const char *label)
+{
+    char msg[128];
+    uint8_t resource[28 + sizeof(jpeg_8x6)];
+    put_header(resource, PSD_THUMBNAIL_JPEG_RGB, THUMB_W, THUMB_H, THUMB_W * 3u,
+               (uint32_t)sizeof(jpeg_8x6));
+    memcpy(resource + 28, jpeg_8x6, sizeof(jpeg_8x6));
+    psd_test_resource_t res = { 1036, resource, sizeof(resource) };
+
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(&res, 1, flags, &bytes, &stream);
+    psd_thumbnail_t thumb;
+    memset(&thumb, 0, sizeof(thumb));
+    bool ok = doc && psd_document_get_thumbnail(doc, &thumb) == PSD_OK;
+    (void)snprintf(msg, sizeof(msg), "%s: thumbnail found", label);
+    ASSERT_TRUE(ok, msg);
+    if (!ok) {
+        release(doc, stream, bytes);
+        return;
+    }
+
+    (void)snprintf(msg, sizeof(msg), "%s: header fields parsed", label);
+    ASSERT_TRUE(thumb.resource_id == 1036 && thumb.format == PSD_THUMBNAIL_JPEG_RGB &&
+                    thumb.width == THUMB_W && thumb.height == THUMB_H &&
+                    thumb.width_bytes == THUMB_W * 3u && thumb.bits_per_pixel == 24 &&
+                    thumb.planes == 1,
+                msg);
+    (void)snprintf(msg, sizeof(msg), "%s: JPEG bytes returned as stored", label);
+    ASSERT_TRUE(thumb.length == sizeof(jpeg_8x6) &&
+                    memcmp(thumb.data, jpeg_8x6, sizeof(jpeg_8x6)) == 0,
+                msg);
+
+    uint8_t rgb[THUMB_W * THUMB_H * 3];
+    size_t required = 0;
+    psd_status_t st = psd_document_get_thumbnail_rgb8(doc, rgb, sizeof(rgb), &required);
+#ifdef OPENPSD_TEST_HAVE_JPEG
+    bool close = st == PSD_OK && required == sizeof(rgb);
+    for (size_t i = 0; close && i < sizeof(rgb); i += 3) {
+        close = abs(rgb[i] - 200) <= 6 && abs(rgb[i + 1] - 40) <= 6 &&
+                abs(rgb[i + 2] - 90) <= 6;
+    }
+    (void)snprintf(msg, sizeof(msg), "%s: JPEG decoded to RGB", label);
+    ASSERT_TRUE(close, msg);
+#else
+    (void)snprintf(msg, sizeof(msg), "%s: JPEG decoding reported unsupported", label);
+    ASSERT_TRUE(st == PSD_ERR_UNSUPPORTED_COMPRESSION && required == sizeof(rgb), msg);
+#endif
+
+    release(doc, stream, bytes);
+}
+
+static void test_jpeg_thumbnail(void)
+{
+    fprintf(stdout, "\n=== Test: JPEG thumbnail (1036) ===\n");
+    check_jpeg(0, "full parse");
+    check_jpeg(PSD_PARSE_STOP_AFTER_RESOURCES, "stop after resources");
+}
+
+static void test_raw_ps4_thumbnail(void)
+{
+    fprintf(stdout, "\n=== Test: raw Photoshop 4.0 thumbnail (1033) ===\n");
+
+    /* 3x2 BGR rows padded to 12 bytes */
+    enum { W = 3, H = 2, ROW = 12 };
+    uint8_t resource[28 + ROW * H];
+    put_header(resource, PSD_THUMBNAIL_RAW_RGB, W, H, ROW, ROW * H);
+    memset(resource + 28, 0xEE, ROW * H);
+    for (uint32_t y = 0; y < H; y++) {
+        for (uint32_t x = 0; x < W; x++) {
+            uint8_t *px = resource + 28 + y * ROW + x * 3u;
+            px[0] = (uint8_t)(10 * x);       /* B */
+            px[1] = (uint8_t)(100 + y);      /* G */
+            px[2] = (uint8_t)(200 + x + y);  /* R */
+        }
+    }
+    psd_test_resource_t res = { 1033, resource, sizeof(resource) };
+
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(&res, 1, 0, &bytes, &stream);
+    psd_thumbnail_t thumb;
+    memset(&thumb, 0, sizeof(thumb));
+    ASSERT_TRUE(doc && psd_document_get_thumbnail(doc, &thumb) == PSD_OK &&
+                    thumb.resource_id == 1033 && thumb.format == PSD_THUMBNAIL_RAW_RGB &&
+                    thumb.width == W && thumb.width_bytes == ROW,
+                "1033 thumbnail found");
+
+    uint8_t rgb[W * H * 3];
+    size_t required = 0;
+    bool ok = doc && psd_document_get_thumbnail_rgb8(doc, rgb, sizeof(rgb), &required) == PSD_OK &&
+              required == sizeof(rgb);
+    for (uint32_t y = 0; ok && y < H; y++) {
+        for (uint32_t x = 0; ok && x < W; x++) {
+            const uint8_t *px = rgb + (y * W + x) * 3u;
+            ok = px[0] == 200 + x + y && px[1] == 100 + y && px[2] == 10 * x;
+        }
+    }
+    ASSERT_TRUE(ok, "rows unpadded and swapped to RGB");
+
+    release(doc, stream, bytes);
+}
+
+static void test_stop_after_resources(void)
+{
+    fprintf(stdout, "\n=== Test: stop after resources ===\n");
+
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(NULL, 0, PSD_PARSE_STOP_AFTER_RESOURCES, &bytes, &stream);
+    int32_t count = -1;
+    ASSERT_TRUE(doc && psd_document_get_layer_count(doc, &count) == PSD_OK && count == 0,
+                "no layers read");
+    uint32_t width = 0;
+    uint32_t height = 0;
+    ASSERT_TRUE(doc && psd_document_get_dimensions(doc, &width, &height) == PSD_OK &&
+                    width == 32 && height == 24,
+                "header still parsed");
+    release(doc, stream, bytes);
+}
+
+static void test_thumbnail_errors(void)
+{
+    fprintf(stdout, "\n=== Test: thumbnail errors ===\n");
+
+    uint8_t *bytes = NULL;
+    psd_stream_t *stream = NULL;
+    psd_document_t *doc = build(NULL, 0, 0, &bytes, &stream);
+    psd_thumbnail_t thumb;
+    ASSERT_TRUE(doc && psd_document_get_thumbnail(doc, &thumb) == PSD_ERR_INVALID_ARGUMENT,
+                "missing thumbnail reported as not found");
+    ASSERT_TRUE(psd_document_get_thumbnail(NULL, &thumb) == PSD_ERR_NULL_POINTER &&
+                    psd_document_get_thumbnail(doc, NULL) == PSD_ERR_NULL_POINTER &&
+                    psd_document_get_thumbnail_rgb8(NULL, NULL, 0, NULL) == PSD_ERR_NULL_POINTER,
+                "NULL arguments rejected");
+    release(doc, stream, bytes);
+
+    /* Header claims more rows than the resource holds */
+    uint8_t truncated[28 + 12];
+    put_header(truncated, PSD_THUMBNAIL_RAW_RGB, 4, 2, 12, 24);
+    memset(truncated + 28, 0, 12);
+    psd_test_resource_t res = { 1036, truncated, sizeof(truncated) };
+    doc = build(&res, 1, 0, &bytes, &stream);
+    ASSERT_TRUE(doc && psd_document_get_thumbnail(doc, &thumb) == PSD_ERR_CORRUPT_DATA,
+                "truncated raw thumbnail rejected");
+    release(doc, stream, bytes);
+
+    put_header(truncated, PSD_THUMBNAIL_RAW_RGB, 4, 1, 12, 12);
+    doc = build(&res, 1, 0, &bytes, &stream);
+    uint8_t small[8];
+    size_t required = 0;
+    ASSERT_TRUE(doc &&
+                    psd_document_get_thumbnail_rgb8(doc, small, sizeof(small), &required) ==
+                        PSD_ERR_BUFFER_TOO_SMALL &&
+                    required == 12,
+                "small buffer reports the required size");
+    release(doc, stream, bytes);
+}
+
+int run_thumbnail_tests(void)
+{
+    fprintf(stdout, "=== Thumbnail tests ===\n");
+
+    test_jpeg_thumbnail();
+    test_raw_ps4_thumbnail();
+    test_stop_after_resources();
+    test_thumbnail_errors();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,510 @@
+/**
+ * @file test_writer.c
+ * @brief Tests for writing PSD and PSB files
+ *
+ * Documents are written to a growable memory stream with every compression,
+ * parsed back, and their layer records, channel samples, resources and
+ * composite compared with what was written.
+ *
+ * Part of the OpenPSD library.
+ *
+ * Copyright (c) 2025-2026 Warren Galyen
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ */
+
+#include <openpsd/psd.h>
+#include "openpsd_tests.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(expr, msg) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "FAIL: %s\n", msg); \
+        tests_failed++; \
+    } else { \
+        fprintf(stdout, "PASS: %s\n", msg); \
+        tests_passed++; \
+    } \
+} while(0)
+
+#define KEY(a, b, c, d) \
+    (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+#define CANVAS_W 40u
+#define CANVAS_H 30u
+
+/* Growable in-memory file */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    size_t pos;
+    size_t seeks;
+} mem_file_t;
+
+static int64_t mem_read(psd_stream_t *stream, void *buffer, size_t count, void *user_data)
+{
+    (void)stream;
+    mem_file_t *f = (mem_file_t *)user_data;
+    size_t n = (f->pos < f->size) ? f->size - f->pos : 0;
+    if (n > count) n = count;
+    memcpy(buffer, f->data + f->pos, n);
+    f->pos += n;
+    return (int64_t)n;
+}
+
+static int64_t mem_write(psd_stream_t *stream, const void *buffer, size_t count,
+                         void *user_data)
+{
+    (void)stream;
+    mem_file_t *f = (mem_file_t *)user_data;
+    if (f->pos + count > f->capacity) {
+        size_t capacity = f->capacity ? f->capacity : 4096;
+        while (capacity < f->pos + count) capacity *= 2;
+        uint8_t *data = (uint8_t *)realloc(f->data, capacity);
+        if (!data) return PSD_ERR_OUT_OF_MEMORY;
+        f->data = data;
+        f->capacity = capacity;
+    }
+    memcpy(f->data + f->pos, buffer, count);
+    f->pos += count;
+    if (f->pos > f->size) f->size = f->pos;
+    return (int64_t)count;
+}
+
+static int64_t mem_seek(psd_stream_t *stream, int64_t offset, void *user_data)
+{
+    (void)stream;
+    mem_file_t *f = (mem_file_t *)user_data;
+    if (offset < 0) return PSD_ERR_STREAM_SEEK;
+    f->pos = (size_t)offset;
+    f->seeks++;
+    return offset;
+}
+
+static int64_t mem_tell(psd_stream_t *stream, void *user_data)
+{
+    (void)stream;
+    return (int64_t)((mem_file_t *)user_data)->pos;
+}
+
+static const psd_stream_vtable_t mem_vtable = {
+    mem_read, mem_write, mem_seek, mem_tell, NULL, NULL, NULL
+};
+
+/* Big-endian sample of a plane: smooth enough for RLE runs, varied enough
+ * for literals */
+static void fill_plane(uint8_t *plane, uint32_t w, uint32_t h, size_t stride, size_t bps,
+                       uint32_t seed)
+{
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            uint32_t v = (x < w / 2) ? seed * 40u : (x * 7u + y * 3u + seed * 11u);
+            uint8_t *p = plane + (size_t)y * stride + (size_t)x * bps;
+            for (size_t k = 0; k < bps; k++) {
+                p[k] = (uint8_t)(v >> (8u * (bps - 1u - k))) ^ (uint8_t)(k * 17u);
+            }
+        }
+    }
+}
+
+typedef struct {
+    uint16_t depth;
+    psd_bool_t psb;
+    psd_compression_t compression;
+    const char *label;
+} writer_case_t;
+
+static void test_round_trip(const writer_case_t *tc)
+{
+    char msg[160];
+    fprintf(stdout, "\n=== Test: round trip (%s) ===\n", tc->label);
+
+    const size_t bps = tc->depth / 8u;
+    /* Layer 0 covers the canvas, layer 1 sits partly off canvas and uses a
+     * strided source with a transparency channel */
+    const psd_rect_t bounds[2] = { { 0, 0, (int32_t)CANVAS_H, (int32_t)CANVAS_W },
+                                   { 5, -3, 25, 17 } };
+    uint8_t *layer_planes[2][4];
+    size_t strides[2];
+    psd_writer_channel_t channels[2][4];
+    for (int l = 0; l < 2; l++) {
+        uint32_t w = (uint32_t)(bounds[l].right - bounds[l].left);
+        uint32_t h = (uint32_t)(bounds[l].bottom - bounds[l].top);
+        strides[l] = (size_t)w * bps + (l == 1 ? 6u : 0u);
+        for (int c = 0; c < 4; c++) {
+            layer_planes[l][c] = (uint8_t *)calloc(strides[l] * h, 1);
+            if (layer_planes[l][c]) {
+                fill_plane(layer_planes[l][c], w, h, strides[l], bps, (uint32_t)(l * 4 + c + 1));
+            }
+            channels[l][c].id = (int16_t)(c - 1);
+            channels[l][c].data = layer_planes[l][c];
+            channels[l][c].stride = (l == 1) ? strides[l] : 0;
+        }
+    }
+    uint8_t *composite[3];
+    for (int c = 0; c < 3; c++) {
+        composite[c] = (uint8_t *)malloc((size_t)CANVAS_W * CANVAS_H * bps);
+        if (composite[c]) {
+            fill_plane(composite[c], CANVAS_W, CANVAS_H, CANVAS_W * bps, bps, (uint32_t)(20 + c));
+        }
+    }
+
+    mem_file_t file = { NULL, 0, 0, 0, 0 };
+    psd_stream_t *stream = psd_stream_create_custom(NULL, &mem_vtable, &file);
+
+    psd_writer_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.width = CANVAS_W;
+    options.height = CANVAS_H;
+    options.channels = 3;
+    options.depth = tc->depth;
+    options.color_mode = PSD_COLOR_RGB;
+    options.psb = tc->psb;
+    options.compression = tc->compression;
+    options.compression_level = 1;
+
+    psd_writer_t *writer = NULL;
+    psd_status_t status = stream ? psd_writer_create(stream, NULL, &options, &writer)
+                                 : PSD_ERR_OUT_OF_MEMORY;
+    snprintf(msg, sizeof(msg), "%s: writer created", tc->label);
+    ASSERT_TRUE(status == PSD_OK && writer, msg);
+
+    static const uint8_t resource[3] = { 'a', 'b', 'c' };
+    static const uint8_t blocks[12] = { '8', 'B', 'I', 'M', 'l', 'y', 'i', 'd', 0, 0, 0, 0 };
+    psd_writer_layer_t layers[2];
+    memset(layers, 0, sizeof(layers));
+    for (int l = 0; l < 2; l++) {
+        layers[l].bounds = bounds[l];
+        layers[l].opacity = (uint8_t)(l ? 128 : 255);
+        layers[l].channels = channels[l];
+        layers[l].channel_count = 4;
+    }
+    layers[0].name = "Background";
+    layers[1].name = "Top";
+    layers[1].blend_key = KEY('m', 'u', 'l', ' ');
+    layers[1].flags = 2;
+    layers[1].blocks = blocks;
+    layers[1].blocks_length = sizeof(blocks);
+
+    if (writer) {
+        status = psd_writer_add_resource(writer, 4000, resource, sizeof(resource));
+        if (status == PSD_OK) status = psd_writer_add_layer(writer, &layers[0]);
+        if (status == PSD_OK) status = psd_writer_add_layer(writer, &layers[1]);
+        ASSERT_TRUE(psd_writer_add_resource(writer, 4001, NULL, 0) == PSD_ERR_INVALID_ARGUMENT,
+                    "resources rejected after layers");
+        if (status == PSD_OK) {
+            status = psd_writer_finish(writer, (const void *const *)composite, 0);
+        }
+        snprintf(msg, sizeof(msg), "%s: document written", tc->label);
+        ASSERT_TRUE(status == PSD_OK, msg);
+        ASSERT_TRUE(psd_writer_finish(writer, (const void *const *)composite, 0) ==
+                        PSD_ERR_INVALID_ARGUMENT,
+                    "finish only once");
+        psd_writer_destroy(writer);
+    }
+    psd_stream_destroy(stream);
+
+    psd_stream_t *in = file.data ? psd_stream_create_buffer(NULL, file.data, file.size) : NULL;
+    psd_document_t *doc = in ? psd_parse(in, NULL) : NULL;
+    snprintf(msg, sizeof(msg), "%s: written file parses", tc->label);
+    ASSERT_TRUE(doc != NULL, msg);
+
+    if (doc) {
+        bool is_psb = false;
+        uint32_t w = 0, h = 0;
+        uint16_t depth = 0;
+        int32_t layer_count = 0;
+        psd_document_is_psb(doc, &is_psb);
+        psd_document_get_dimensions(doc, &w, &h);
+        psd_document_get_depth(doc, &depth);
+        psd_document_get_layer_count(doc, &layer_count);
+        ASSERT_TRUE(is_psb == (bool)tc->psb && w == CANVAS_W && h == CANVAS_H &&
+                        depth == tc->depth && layer_count == 2,
+                    "header and layer count read back");
+
+        size_t res_index = 0;
+        const uint8_t *res_data = NULL;
+        uint64_t res_length = 0;
+        uint16_t res_id = 0;
+        ASSERT_TRUE(psd_document_find_resource(doc, 4000, &res_index) == PSD_OK &&
+                        psd_document_get_resource(doc, res_index, &res_id, &res_data,
+                                                  &res_length) == PSD_OK &&
+                        res_length == 3 && memcmp(res_data, "abc", 3) == 0,
+                    "odd-length resource read back");
+
+        psd_rect_t got = { 0, 0, 0, 0 };
+        psd_document_get_layer_bounds(doc, 1, &got.top, &got.left, &got.bottom, &got.right);
+        ASSERT_TRUE(got.top == 5 && got.left == -3 && got.bottom == 25 && got.right == 17,
+                    "layer bounds read back");
+
+        const uint8_t *name = NULL;
+        size_t name_length = 0;
+        psd_document_get_layer_name(doc, 0, &name, &name_length);
+        ASSERT_TRUE(name_length == 10 && memcmp(name, "Background", 10) == 0,
+                    "layer name read back");
+
+        uint32_t sig = 0, key = 0;
+        uint8_t opacity = 0, flags = 0;
+        psd_document_get_layer_blend_mode(doc, 1, &sig, &key);
+        psd_document_get_layer_properties(doc, 1, &opacity, &flags);
+        ASSERT_TRUE(key == KEY('m', 'u', 'l', ' ') && opacity == 128 && (flags & 2u),
+                    "blend mode, opacity and flags read back");
+
+        const uint8_t *block = NULL;
+        ASSERT_TRUE(psd_document_get_layer_tagged_block(doc, 1, KEY('l', 'y', 'i', 'd'), &block,
+                                                        NULL, NULL, NULL) == PSD_OK,
+                    "tagged blocks written after the name");
+
+        bool pixels_match = true;
+        for (int l = 0; l < 2; l++) {
+            uint32_t lw = (uint32_t)(bounds[l].right - bounds[l].left);
+            uint32_t lh = (uint32_t)(bounds[l].bottom - bounds[l].top);
+            size_t row_bytes = (size_t)lw * bps;
+            uint8_t *decoded = (uint8_t *)malloc(row_bytes * lh);
+            for (size_t c = 0; c < 4 && pixels_match; c++) {
+                if (!decoded || psd_document_decode_layer_channel_into(doc, l, c, decoded,
+                                                                       row_bytes) != PSD_OK) {
+                    pixels_match = false;
+                    break;
+                }
+                for (uint32_t y = 0; y < lh; y++) {
+                    if (memcmp(decoded + (size_t)y * row_bytes,
+                               layer_planes[l][c] + (size_t)y * strides[l], row_bytes) != 0) {
+                        pixels_match = false;
+                    }
+                }
+            }
+            free(decoded);
+        }
+        snprintf(msg, sizeof(msg), "%s: layer channels decode to the written samples", tc->label);
+        ASSERT_TRUE(pixels_match, msg);
+
+        /* Samples are written with distinct bytes, so a render reading
+         * anything but the MSB of 16-bit data shows here, cached or not */
+        if (tc->depth <= 16) {
+            size_t rgba_size = (size_t)CANVAS_W * CANVAS_H * 4u;
+            uint8_t *expected = (uint8_t *)malloc(rgba_size);
+            uint8_t *rgba = (uint8_t *)malloc(rgba_size);
+            bool render_match = expected && rgba;
+            for (size_t i = 0; render_match && i < (size_t)CANVAS_W * CANVAS_H; i++) {
+                for (int c = 0; c < 4; c++) {
+                    expected[i * 4u + (size_t)c] = layer_planes[0][(c + 1) % 4][i * bps];
+                }
+            }
+            /* Uncached first: it would otherwise read the planes decoded
+             * by the cached render */
+            static const uint32_t passes[2] = { PSD_RENDER_NO_CACHE, 0 };
+            for (int pass = 0; render_match && pass < 2; pass++) {
+                render_match = psd_document_set_render_flags(doc, passes[pass]) == PSD_OK &&
+                               psd_document_render_layer_rgba8(doc, 0, rgba, rgba_size,
+                                                               NULL) == PSD_OK &&
+                               memcmp(rgba, expected, rgba_size) == 0;
+            }
+            snprintf(msg, sizeof(msg), "%s: layer renders keep the sample MSB", tc->label);
+            ASSERT_TRUE(render_match, msg);
+            free(rgba);
+            free(expected);
+        }
+
+        const uint8_t *image = NULL;
+        uint64_t image_length = 0;
+        uint32_t compression = 99;
+        size_t plane_bytes = (size_t)CANVAS_W * CANVAS_H * bps;
+        bool composite_match =
+            psd_document_get_composite_image(doc, &image, &image_length, &compression) == PSD_OK &&
+            image && image_length == plane_bytes * 3;
+        for (int c = 0; c < 3 && composite_match; c++) {
+            composite_match = memcmp(image + plane_bytes * (size_t)c, composite[c],
+                                     plane_bytes) == 0;
+        }
+        snprintf(msg, sizeof(msg), "%s: composite read back", tc->label);
+        ASSERT_TRUE(composite_match && compression == (uint32_t)tc->compression, msg);
+
+        psd_document_free(doc);
+    }
+    psd_stream_destroy(in);
+
+    for (int l = 0; l < 2; l++) {
+        for (int c = 0; c < 4; c++) free(layer_planes[l][c]);
+    }
+    for (int c = 0; c < 3; c++) free(composite[c]);
+    free(file.data);
+}
+
+/* Many channels compressed in parallel still land in order, and the only
+ * seeks are the patches of the resources and layer section lengths */
+static void test_many_layers(void)
+{
+    fprintf(stdout, "\n=== Test: many layers ===\n");
+
+    enum { LAYERS = 24, SIDE = 64 };
+    uint8_t *planes[LAYERS];
+    psd_writer_channel_t channels[LAYERS];
+    for (int i = 0; i < LAYERS; i++) {
+        planes[i] = (uint8_t *)malloc((size_t)SIDE * SIDE);
+        if (planes[i]) fill_plane(planes[i], SIDE, SIDE, SIDE, 1, (uint32_t)i + 1);
+        channels[i].id = 0;
+        channels[i].data = planes[i];
+        channels[i].stride = 0;
+    }
+    uint8_t *gray = (uint8_t *)calloc((size_t)SIDE * SIDE, 1);
+    const void *composite[1] = { gray };
+
+    psd_writer_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.width = SIDE;
+    options.height = SIDE;
+    options.channels = 1;
+    options.depth = 8;
+    options.color_mode = PSD_COLOR_GRAYSCALE;
+    options.compression = PSD_COMPRESSION_RLE;
+
+    mem_file_t file = { NULL, 0, 0, 0, 0 };
+    psd_stream_t *stream = psd_stream_create_custom(NULL, &mem_vtable, &file);
+    psd_writer_t *writer = NULL;
+    psd_status_t status = psd_writer_create(stream, NULL, &options, &writer);
+    for (int i = 0; i < LAYERS && status == PSD_OK; i++) {
+        psd_writer_layer_t layer;
+        memset(&layer, 0, sizeof(layer));
+        layer.bounds.bottom = SIDE;
+        layer.bounds.right = SIDE;
+        layer.opacity = 255;
+        layer.channels = &channels[i];
+        layer.channel_count = 1;
+        status = psd_writer_add_layer(writer, &layer);
+    }
+    if (status == PSD_OK) status = psd_writer_finish(writer, composite, 0);
+    psd_writer_destroy(writer);
+    psd_stream_destroy(stream);
+    ASSERT_TRUE(status == PSD_OK, "24 layers written");
+    ASSERT_TRUE(file.seeks > 0 && file.seeks <= 4,
+                "lengths patched with one seek back and forth per section");
+
+    psd_stream_t *in = psd_stream_create_buffer(NULL, file.data, file.size);
+    psd_document_t *doc = in ? psd_parse(in, NULL) : NULL;
+    bool match = doc != NULL;
+    uint8_t decoded[SIDE * SIDE];
+    for (int i = 0; i < LAYERS && match; i++) {
+        match = psd_document_decode_layer_channel_into(doc, i, 0, decoded, SIDE) == PSD_OK &&
+                memcmp(decoded, planes[i], sizeof(decoded)) == 0;
+    }
+    ASSERT_TRUE(match, "every channel read back in its own layer");
+
+    psd_document_free(doc);
+    psd_stream_destroy(in);
+    for (int i = 0; i < LAYERS; i++) free(planes[i]);
+    free(gray);
+    free(file.data);
+}
+
+static void test_arguments(void)
+{
+    fprintf(stdout, "\n=== Test: writer arguments ===\n");
+
+    mem_file_t file = { NULL, 0, 0, 0, 0 };
+    psd_stream_t *stream = psd_stream_create_custom(NULL, &mem_vtable, &file);
+    psd_writer_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.width = 8;
+    options.height = 8;
+    options.channels = 1;
+    options.depth = 8;
+    options.color_mode = PSD_COLOR_GRAYSCALE;
+
+    psd_writer_t *writer = NULL;
+    psd_writer_options_t bad = options;
+    bad.depth = 12;
+    ASSERT_TRUE(psd_writer_create(stream, NULL, &bad, &writer) == PSD_ERR_INVALID_ARGUMENT &&
+                    !writer,
+                "unsupported depth rejected");
+    bad = options;
+    bad.width = 30001;
+    ASSERT_TRUE(psd_writer_create(stream, NULL, &bad, &writer) == PSD_ERR_INVALID_ARGUMENT,
+                "PSD width limit enforced");
+    bad = options;
+    bad.compression_level = 10;
+    ASSERT_TRUE(psd_writer_create(stream, NULL, &bad, &writer) == PSD_ERR_INVALID_ARGUMENT,
+                "compression level checked");
+    ASSERT_TRUE(psd_writer_create(NULL, NULL, &options, &writer) == PSD_ERR_NULL_POINTER,
+                "NULL stream rejected");
+
+    ASSERT_TRUE(psd_writer_create(stream, NULL, &options, &writer) == PSD_OK, "writer created");
+    psd_writer_channel_t channel = { -2, NULL, 0 };
+    psd_writer_layer_t layer;
+    memset(&layer, 0, sizeof(layer));
+    layer.bounds.bottom = 4;
+    layer.bounds.right = 4;
+    layer.channels = &channel;
+    layer.channel_count = 1;
+    ASSERT_TRUE(psd_writer_add_layer(writer, &layer) == PSD_ERR_INVALID_ARGUMENT,
+                "mask channels rejected");
+    channel.id = 0;
+    ASSERT_TRUE(psd_writer_add_layer(writer, &layer) == PSD_ERR_INVALID_ARGUMENT,
+                "missing samples rejected");
+    layer.bounds.right = -1;
+    ASSERT_TRUE(psd_writer_add_layer(writer, &layer) == PSD_ERR_INVALID_ARGUMENT,
+                "inverted bounds rejected");
+    ASSERT_TRUE(psd_writer_set_color_mode_data(writer, NULL, 0) == PSD_OK &&
+                    psd_writer_set_color_mode_data(writer, NULL, 0) == PSD_ERR_INVALID_ARGUMENT,
+                "color mode data written once");
+    ASSERT_TRUE(psd_writer_finish(writer, NULL, 0) == PSD_ERR_NULL_POINTER,
+                "composite planes required");
+
+    uint8_t gray[64];
+    memset(gray, 90, sizeof(gray));
+    const void *composite[1] = { gray };
+    ASSERT_TRUE(psd_writer_finish(writer, composite, 0) == PSD_OK, "document without layers");
+    psd_writer_destroy(writer);
+    psd_writer_destroy(NULL);
+    psd_stream_destroy(stream);
+
+    psd_stream_t *in = psd_stream_create_buffer(NULL, file.data, file.size);
+    psd_document_t *doc = in ? psd_parse(in, NULL) : NULL;
+    int32_t layer_count = -1;
+    const uint8_t *image = NULL;
+    uint64_t image_length = 0;
+    ASSERT_TRUE(doc && psd_document_get_layer_count(doc, &layer_count) == PSD_OK &&
+                    layer_count == 0 &&
+                    psd_document_get_composite_image(doc, &image, &image_length, NULL) ==
+                        PSD_OK &&
+                    image_length == sizeof(gray) && image[63] == 90,
+                "document without layers parses");
+    psd_document_free(doc);
+    psd_stream_destroy(in);
+    free(file.data);
+}
+
+int run_writer_tests(void)
+{
+    fprintf(stdout, "=== Writer tests ===\n");
+
+    static const writer_case_t cases[] = {
+        { 8, 0, PSD_COMPRESSION_RAW, "PSD 8-bit raw" },
+        { 8, 0, PSD_COMPRESSION_RLE, "PSD 8-bit RLE" },
+        { 16, 1, PSD_COMPRESSION_RLE, "PSB 16-bit RLE" },
+#ifdef OPENPSD_TEST_HAVE_ZIP
+        { 8, 0, PSD_COMPRESSION_ZIP, "PSD 8-bit ZIP" },
+        { 16, 0, PSD_COMPRESSION_ZIP_PRED, "PSD 16-bit ZIP with prediction" },
+        { 32, 1, PSD_COMPRESSION_ZIP_PRED, "PSB 32-bit ZIP with prediction" },
+#endif
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        test_round_trip(&cases[i]);
+    }
+    test_many_layers();
+    test_arguments();
+
+    fprintf(stdout, "\nTests passed: %d\nTests failed: %d\n", tests_passed, tests_failed);
+    return (tests_failed == 0) ? 0 : 1;
+}